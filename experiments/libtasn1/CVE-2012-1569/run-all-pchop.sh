@@ -18,9 +18,9 @@ for ((idx1=0; idx1<${#singleCore[@]}; ++idx1)); do
       bug=${bugs[idx2]}
       search=${searches[idx3]}
   
-      echo "mpirun -n $(($core+2)) $app $args --output-dir=$search"_"$core"_"$bug --phase1Depth=0 --phase2Depth=0 \
+      echo "mpirun -n $(($core+1)) $app $args --output-dir=$search"_"$core"_"$bug --phase1Depth=0 --phase2Depth=0 \
         --error-location=decoding.c:$bug  --searchPolicy=$search $target"
-      mpirun -n $(($core+2)) $app $args --output-dir=$search"_"$core"_"$bug --phase1Depth=0 --phase2Depth=0 \
+      mpirun -n $(($core+1)) $app $args --output-dir=$search"_"$core"_"$bug --phase1Depth=0 --phase2Depth=0 \
         --error-location=decoding.c:$bug  --searchPolicy=$search $target &> log_$search"_"$core"_"$bug
       rm -rf $search"_"$core"_"$bug*
       rm -rf tt*
@@ -35,9 +35,9 @@ for ((idx1=0; idx1<${#cores[@]}; ++idx1)); do
       bug=${bugs[idx2]}
       search=${searches[idx3]}
    
-      echo "mpirun -n $(($core+2)) $app $args --output-dir=$search"_"$core"_"$bug --phase1Depth=$core --phase2Depth=0 \
+      echo "mpirun -n $(($core+1)) $app $args --output-dir=$search"_"$core"_"$bug --phase1Depth=$core --phase2Depth=0 \
         --error-location=decoding.c:$bug  --searchPolicy=$search $target"
-      mpirun -n $(($core+2)) $app $args --output-dir=$search"_"$core"_"$bug --phase1Depth=$core --phase2Depth=0 \
+      mpirun -n $(($core+1)) $app $args --output-dir=$search"_"$core"_"$bug --phase1Depth=$core --phase2Depth=0 \
         --error-location=decoding.c:$bug  --searchPolicy=$search $target &> log_$search"_"$core"_"$bug
       rm -rf $search"_"$core"_"$bug*
       rm -rf tt*
@@ -0,0 +1,90 @@
+#!/bin/bash
+##
+## Compares a results file of bench-scaling.sh against a stored baseline.
+##
+## For every run of the results it prints the baseline and current wall time
+## and instruction rate, and for every setup the speedup of each worker count
+## over the smallest one, in both files. A run regresses when the baseline
+## reached the bug and the results did not, or when it is slower than the
+## baseline by more than the tolerance (in percent, 10 by default); the exit
+## status is the number of regressions, capped at 1.
+##
+
+usage() {
+  echo "usage: $0 [-t tolerance] baseline.tsv results.tsv" >&2
+  exit 2
+}
+
+TOLERANCE=10
+while getopts "t:h" opt; do
+  case $opt in
+    t) TOLERANCE=$OPTARG ;;
+    *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+[ $# -eq 2 ] || usage
+
+awk -F'\t' -v tolerance="$TOLERANCE" '
+  FNR == 1 { next }
+  {
+    key = $1 "\t" $2 "\t" $3 "\t" $4
+    setup = $1 "\t" $2 "\t" $3
+  }
+  FNR == NR {
+    bfound[key] = $5; bwall[key] = $7; bips[key] = $9
+    bcurve[setup, $4] = $7
+    next
+  }
+  {
+    found[key] = $5; wall[key] = $7; ips[key] = $9
+    curve[setup, $4] = $7
+    if (!(setup in setups)) { setups[setup] = 1; order[++nsetups] = setup }
+    if (!(setup in minw) || $4 + 0 < minw[setup]) minw[setup] = $4 + 0
+    keys[++nkeys] = key
+  }
+  END {
+    printf "%-36s %10s %10s %8s %12s %12s\n", "run", "base wall",
+           "wall", "change", "base ips", "ips"
+    regressions = 0
+    for (i = 1; i <= nkeys; i++) {
+      k = keys[i]
+      name = k; gsub("\t", " ", name)
+      if (!(k in bwall)) {
+        printf "%-36s %10s %10.1f %8s %12s %12s  new\n", name, "-",
+               wall[k], "-", "-", ips[k]
+        continue
+      }
+      change = bwall[k] > 0 ? 100 * (wall[k] - bwall[k]) / bwall[k] : 0
+      verdict = ""
+      if (bfound[k] == 1 && found[k] != 1) verdict = "REGRESSION (bug lost)"
+      else if (change > tolerance) verdict = "REGRESSION"
+      if (verdict != "") regressions++
+      printf "%-36s %10.1f %10.1f %+7.1f%% %12s %12s  %s\n", name, bwall[k],
+             wall[k], change, bips[k], ips[k], verdict
+    }
+
+    printf "\nspeedup over the smallest worker count (baseline -> current)\n"
+    for (i = 1; i <= nsetups; i++) {
+      s = order[i]
+      name = s; gsub("\t", " ", name)
+      line = sprintf("%-28s", name)
+      base = curve[s, minw[s]]
+      bbase = ((s, minw[s]) in bcurve) ? bcurve[s, minw[s]] : ""
+      for (j = 1; j <= nkeys; j++) {
+        split(keys[j], f, "\t")
+        if (f[1] "\t" f[2] "\t" f[3] != s) continue
+        w = f[4]
+        cur = curve[s, w] > 0 ? base / curve[s, w] : 0
+        if (bbase != "" && ((s, w) in bcurve) && bcurve[s, w] > 0)
+          line = line sprintf("  %sw: %.2fx -> %.2fx", w,
+                              bbase / bcurve[s, w], cur)
+        else
+          line = line sprintf("  %sw: %.2fx", w, cur)
+      }
+      print line
+    }
+
+    printf "\n%d regression(s) at a tolerance of %s%%\n", regressions, tolerance
+    exit regressions > 0
+  }' "$1" "$2"
@@ -0,0 +1,130 @@
+#!/bin/bash
+##
+## Runs the libtasn1 CVE setups across worker counts and search policies and
+## appends one line per run to a tab separated results file:
+##
+##   cve bug search workers found time_to_bug wall instructions
+##   instructions_per_sec solver_share offloads
+##
+## time_to_bug is the wall time of a run which reached the bug and NA
+## otherwise. instructions and solver_share are summed over the workers which
+## printed their statistics; solver_share is SolverTime over the replay,
+## exploration, recovery and idle time. offloads counts the offloads the
+## coordinator received. The logs of every run are kept under the work
+## directory.
+##
+## Each CVE-*/bench.cfg holds the arguments, target and bug locations of its
+## setup; the test.bc of a setup is built by its Makefile.
+##
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+
+KLEE=${KLEE:-klee}
+MPIRUN=${MPIRUN:-mpirun}
+WORKERS="1 2 4 8"
+SEARCHES="DFS BFS RAND"
+TIMEOUT=1800
+RESULTS=bench-results.tsv
+WORK=bench-work
+
+usage() {
+  echo "usage: $0 [-k klee] [-w workers] [-s searches] [-t timeout]" \
+       "[-o results] [-d workdir] [CVE-dir...]" >&2
+  exit 1
+}
+
+while getopts "k:w:s:t:o:d:h" opt; do
+  case $opt in
+    k) KLEE=$OPTARG ;;
+    w) WORKERS=$OPTARG ;;
+    s) SEARCHES=$OPTARG ;;
+    t) TIMEOUT=$OPTARG ;;
+    o) RESULTS=$OPTARG ;;
+    d) WORK=$OPTARG ;;
+    *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -eq 0 ]; then
+  set -- "$HERE"/CVE-*
+fi
+
+mkdir -p "$WORK"
+WORK=$(cd "$WORK" && pwd)
+if [ ! -s "$RESULTS" ]; then
+  printf "cve\tbug\tsearch\tworkers\tfound\ttime_to_bug\twall\tinstructions\tinstructions_per_sec\tsolver_share\toffloads\n" > "$RESULTS"
+fi
+
+for dir in "$@"; do
+  dir=$(cd "$dir" && pwd)
+  cve=$(basename "$dir")
+  if [ ! -f "$dir/bench.cfg" ] || [ ! -f "$dir/test.bc" ]; then
+    echo "$cve: missing bench.cfg or test.bc, skipping" >&2
+    continue
+  fi
+  unset ARGS TARGET BUG_FILE BUGS
+  source "$dir/bench.cfg"
+
+  for bug in $BUGS; do
+    for search in $SEARCHES; do
+      for workers in $WORKERS; do
+        ## a single worker runs without the initial split, as before
+        depth=$workers
+        [ "$workers" -eq 1 ] && depth=0
+
+        name=${search}_${workers}_${bug}
+        run=$WORK/$cve/$name
+        rm -rf "$run"
+        mkdir -p "$run"
+
+        echo "$cve: bug $BUG_FILE:$bug search $search workers $workers"
+        start=$(date +%s.%N)
+        (cd "$run" &&
+         $MPIRUN -n $((workers + 1)) "$KLEE" $ARGS --timeOut=$TIMEOUT \
+           --output-dir="$name" --phase1Depth=$depth --phase2Depth=0 \
+           --error-location=$BUG_FILE:$bug --searchPolicy=$search \
+           $dir/$TARGET) > "$run/log" 2>&1
+        end=$(date +%s.%N)
+
+        master="$run/log_master_$name"
+        found=0
+        offloads=NA
+        if [ -f "$master" ]; then
+          grep -q "BUG FOUND" "$master" && found=1
+          offloads=$(grep -c "OFFLOAD RCVD" "$master")
+        fi
+
+        ## time to bug, wall, instructions, instructions/sec, solver share
+        metrics=$(awk -v start=$start -v end=$end -v found=$found '
+          function stat(name) {
+            if (!index($0, "KLEE: done: " name " = ")) return 0
+            sum[name] += $NF; seen[name] = 1; return 1
+          }
+          {
+            stat("total instructions") || stat("SolverTime") ||
+            stat("ReplayTime") || stat("ExplorationTime") ||
+            stat("RecoveryTime") || stat("IdleTime")
+          }
+          END {
+            wall = end - start
+            busy = sum["ReplayTime"] + sum["ExplorationTime"]
+            busy += sum["RecoveryTime"] + sum["IdleTime"]
+            printf "%s\t%.2f", found ? sprintf("%.2f", wall) : "NA", wall
+            if (seen["total instructions"])
+              printf "\t%.0f\t%.1f", sum["total instructions"],
+                     sum["total instructions"] / wall
+            else
+              printf "\tNA\tNA"
+            if (seen["SolverTime"] && busy > 0)
+              printf "\t%.4f", sum["SolverTime"] / busy
+            else
+              printf "\tNA"
+          }' "$run/log")
+
+        printf "%s\t%s\t%s\t%s\t%s\t%s\t%s\n" "$cve" "$bug" "$search" \
+          "$workers" "$found" "$metrics" "$offloads" >> "$RESULTS"
+      done
+    done
+  done
+done
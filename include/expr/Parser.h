@@ -20,6 +20,7 @@ namespace llvm {
 }
 
 namespace klee {
+  class ArrayCache;
   class ExprBuilder;
 
 namespace expr {
@@ -228,8 +229,11 @@ namespace expr {
     /// \arg MB - The input data.
     /// \arg Builder - The expression builder to use for constructing
     /// expressions.
+    /// \arg Arrays - If non-null, the cache arrays are created in; this
+    /// lets parsed arrays be shared with other clients of the cache.
     static Parser *Create(const std::string Name, const llvm::MemoryBuffer *MB,
-                          ExprBuilder *Builder, bool ClearArrayAfterQuery);
+                          ExprBuilder *Builder, bool ClearArrayAfterQuery,
+                          ArrayCache *Arrays = 0);
   };
 }
 }
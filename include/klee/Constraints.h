@@ -11,6 +11,13 @@
 #define KLEE_CONSTRAINTS_H
 
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/System/MemoryUsage.h"
+#include "klee/util/ConstraintPartition.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <iterator>
+#include <vector>
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
@@ -21,21 +28,71 @@ namespace klee {
 class ExprVisitor;
   
 class ConstraintManager {
-public:
-  typedef std::vector< ref<Expr> > constraints_ty;
-  typedef constraints_ty::iterator iterator;
-  typedef constraints_ty::const_iterator const_iterator;
+  /// The constraints are kept in chunks which point to the chunk before
+  /// them, so that the managers of forked states share all of them but the
+  /// ones added since the fork. Every chunk of a manager but its last is
+  /// full.
+  enum { ChunkSize = 64 };
+  /// the most results of simplifyExpr kept
+  enum { MaxSimplified = 1024 };
+
+  struct Chunk : util::MemoryAccounted<util::ConstraintMemory> {
+    unsigned refCount;
+    ref<Chunk> parent;
+    /// the constraints of data in use by some manager
+    unsigned used;
+    ref<Expr> data[ChunkSize];
+
+    Chunk(const ref<Chunk> &_parent) : refCount(0), parent(_parent), used(0) {}
+  };
 
-  ConstraintManager() {}
+public:
+  class const_iterator
+    : public std::iterator<std::forward_iterator_tag, ref<Expr> > {
+    const ConstraintManager *manager;
+    size_t index;
+
+  public:
+    const_iterator() : manager(0), index(0) {}
+    const_iterator(const ConstraintManager *_manager, size_t _index)
+      : manager(_manager), index(_index) {}
+
+    const ref<Expr> &operator*() const { return (*manager)[index]; }
+    const ref<Expr> *operator->() const { return &(*manager)[index]; }
+    const_iterator &operator++() { ++index; return *this; }
+    const_iterator operator++(int) {
+      const_iterator old = *this;
+      ++index;
+      return old;
+    }
+    bool operator==(const const_iterator &other) const {
+      return index == other.index && manager == other.manager;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return !(*this == other);
+    }
+  };
+  typedef const_iterator iterator;
+  typedef const_iterator constraint_iterator;
+
+  ConstraintManager()
+      : count(0), partitionValid(false), equalitiesValid(false) {}
 
   // create from constraints with no optimization
   explicit
-  ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
-
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  ConstraintManager(const std::vector< ref<Expr> > &_constraints)
+      : count(0), partitionValid(false), equalitiesValid(false) {
+    for (unsigned i = 0; i < _constraints.size(); i++)
+      push(_constraints[i]);
+  }
 
-  typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
+  ConstraintManager(const ConstraintManager &cs)
+      : last(cs.last), count(cs.count), chunks(cs.chunks),
+        partitionValid(cs.partitionValid),
+        equalities(cs.equalities), equalitiesValid(cs.equalitiesValid) {
+    if (partitionValid)
+      partition = cs.partition;
+  }
 
   // given a constraint which is known to be valid, attempt to 
   // simplify the existing constraint set
@@ -46,30 +103,60 @@ public:
   void addConstraint(ref<Expr> e);
   
   bool empty() const {
-    return constraints.empty();
+    return count == 0;
   }
   ref<Expr> back() const {
-    return constraints.back();
+    return (*this)[count - 1];
+  }
+  const ref<Expr> &operator[](size_t index) const {
+    assert(index < count && "invalid constraint index");
+    return chunks[index / ChunkSize]->data[index % ChunkSize];
   }
   constraint_iterator begin() const {
-    return constraints.begin();
+    return const_iterator(this, 0);
   }
   constraint_iterator end() const {
-    return constraints.end();
+    return const_iterator(this, count);
   }
   size_t size() const {
-    return constraints.size();
+    return count;
   }
 
-  bool operator==(const ConstraintManager &other) const {
-    return constraints == other.constraints;
-  }
+  bool operator==(const ConstraintManager &other) const;
+
+  /// The independent sets of the constraints, built on the first call and
+  /// then updated as constraints are added.
+  const ConstraintPartition &getPartition() const;
   
 private:
-  std::vector< ref<Expr> > constraints;
-
-  // returns true iff the constraints were modified
-  bool rewriteConstraints(ExprVisitor &visitor);
+  ref<Chunk> last;
+  size_t count;
+  /// the chunks from the first to last
+  std::vector<Chunk *> chunks;
+  mutable ConstraintPartition partition;
+  mutable bool partitionValid;
+
+  typedef ImmutableMap< ref<Expr>, ref<Expr> > EqualityMap;
+  /// The replacements of simplifyExpr: the expressions a constraint equals
+  /// to a constant by the constant, the other constraints by true. Built
+  /// on the first call, then updated as constraints are added; the copies
+  /// of the manager share it.
+  mutable EqualityMap equalities;
+  mutable bool equalitiesValid;
+  /// the results of simplifyExpr since the constraints last changed
+  mutable ExprHashMap< ref<Expr> > simplified;
+
+  void addEquality(const ref<Expr> &e) const;
+
+  /// Append e to the chunks.
+  void push(ref<Expr> e);
+  void clear();
+
+  void pushConstraint(ref<Expr> e);
+
+  // returns true iff the constraints were modified, src is the expression
+  // the visitor replaces
+  bool rewriteConstraints(ExprVisitor &visitor, ref<Expr> src);
 
   void addConstraintInternal(ref<Expr> e);
 };
@@ -15,14 +15,21 @@
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/AllocationRecord.h"
+#include "klee/Internal/ADT/CopyOnWrite.h"
 #include "klee/Internal/ADT/TreeStream.h"
+#include "klee/Internal/Support/BranchPath.h"
+#include "klee/Internal/Support/PrefixTrie.h"
+#include "klee/Internal/Support/WrittenRanges.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/MemoryUsage.h"
+#include "klee/util/Assignment.h"
 
 // FIXME: We do not want to be exposing these? :(
 #include "../../lib/Core/AddressSpace.h"
 #include "klee/Internal/Module/KInstIterator.h"
 #include "klee/Internal/Module/KModule.h"
 
+#include <list>
 #include <map>
 #include <set>
 #include <vector>
@@ -39,13 +46,38 @@ struct InstructionInfo;
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const MemoryMap &mm);
 
+/// FrameLocals - The registers of a stack frame. The frames of forked states
+/// share them until one of the frames is written, and the registers of
+/// returned frames are reused by the frames pushed after them.
+class FrameLocals {
+  unsigned refCount;
+  unsigned size;
+  Cell *cells;
+
+  explicit FrameLocals(unsigned _size);
+  ~FrameLocals();
+
+public:
+  /// Registers of the given size, all of them null.
+  static FrameLocals *create(unsigned size);
+  /// A copy which is not shared.
+  FrameLocals *clone() const;
+
+  void retain() { refCount++; }
+  void release();
+  bool isShared() const { return refCount > 1; }
+  Cell *getCells() const { return cells; }
+};
+
 struct StackFrame {
   KInstIterator caller;
   KFunction *kf;
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+private:
+  FrameLocals *locals;
+public:
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -61,25 +93,48 @@ struct StackFrame {
   // of intrinsic lowering.
   MemoryObject *varargs;
 
+  /// The forks which stayed in a loop of the function (by header) since
+  /// the loop was last left, for --loop-budget.
+  std::map<llvm::BasicBlock*, unsigned> loopForks;
+
   StackFrame(KInstIterator caller, KFunction *kf);
   StackFrame(const StackFrame &s);
+  StackFrame &operator=(const StackFrame &s);
   ~StackFrame();
+
+  const Cell *getLocals() const { return locals->getCells(); }
+  /// The registers for writing, copied first if they are shared.
+  Cell *getWritableLocals() {
+    if (locals->isShared()) {
+      FrameLocals *copy = locals->clone();
+      locals->release();
+      locals = copy;
+    }
+    return locals->getCells();
+  }
 };
 
 #define NORMAL_STATE (1 << 0)
 #define RECOVERY_STATE (1 << 1)
 
-struct Snapshot {
+/* accounted to the snapshots with the shell of their state, the objects of
+   the state are shared with the states it was taken from */
+struct Snapshot : util::MemoryAccounted<util::SnapshotMemory> {
   unsigned int refCount;
   ref<ExecutionState> state;
   llvm::Function *f;
+  /* (slice id, address) -> written value (null if not written), for the
+     recoveries from this snapshot whose result depends only on the snapshot,
+     shared by all the states holding it */
+  std::map<std::pair<uint32_t, uint64_t>, ref<Expr> > recoveredValues;
 
   /* TODO: is it required? */
   Snapshot() :
+    refCount(0),
     state(0),
     f(0)
   {
-
+    liveCount++;
   };
 
   Snapshot(ref<ExecutionState> state, llvm::Function *f) :
@@ -87,9 +142,27 @@ struct Snapshot {
     state(state),
     f(f)
   {
-
+    liveCount++;
+    if (state.get())
+      util::AccountMemory(util::SnapshotMemory, getStateBytes());
   };
 
+  ~Snapshot() {
+    liveCount--;
+    if (state.get())
+      util::AccountMemory(util::SnapshotMemory, -(int64_t) getStateBytes());
+  }
+
+  /* number of snapshots alive, reported when over the memory cap */
+  static unsigned int getLiveCount() {
+    return liveCount;
+  }
+
+private:
+  static unsigned int liveCount;
+
+  static size_t getStateBytes();
+
 };
 
 struct RecoveryInfo {
@@ -106,6 +179,17 @@ struct RecoveryInfo {
     ref<Snapshot> snapshot;
     unsigned int snapshotIndex;
     unsigned int subId;
+    /* the recovery did not fork, allocate or use guiding constraints, so
+       its result can be cached in the snapshot */
+    bool shareable;
+    /* with --recovery-summaries: the concrete values the recovery read from
+       the objects of the snapshot, except those it wrote first, complete
+       while summarizable */
+    std::vector<std::pair<uint64_t, ref<ConstantExpr> > > reads;
+    WrittenRanges written;
+    bool summarizable;
+    /* when the recovery state started, for the event trace */
+    uint64_t traceStart;
 
     RecoveryInfo() :
         refCount(0),
@@ -116,7 +200,10 @@ struct RecoveryInfo {
         sliceId(0),
         snapshot(0),
         snapshotIndex(0),
-        subId(0)
+        subId(0),
+        shareable(true),
+        summarizable(true),
+        traceStart(0)
     {
 
     }
@@ -134,6 +221,16 @@ struct RecoveryResult {
     bool modified;
 };
 
+/// SymbolicList - The symbolic objects of a state with their arrays, which
+/// holds a reference to every object.
+class SymbolicList
+  : public std::vector<std::pair<const MemoryObject *, const Array *> > {
+public:
+  SymbolicList() {}
+  SymbolicList(const SymbolicList &list);
+  ~SymbolicList();
+};
+
 enum {
     PRIORITY_LOW,
     PRIORITY_HIGH,
@@ -150,18 +247,28 @@ private:
   // unsupported, use copy constructor
   ExecutionState &operator=(const ExecutionState &);
 
-  std::map<std::string, std::string> fnAliases;
+  CopyOnWrite< std::map<std::string, std::string> > fnAliases;
 
   unsigned int type;
 
   /* normal state properties */
 
-  typedef std::map<uint64_t, WrittenAddressInfo> WrittenAddresses;
   typedef std::map<uint64_t, ref<Expr> > ValuesCache;
   typedef std::map< std::pair<uint32_t, uint32_t>, ValuesCache> RecoveryCache;
 
+  /* forked states share their recovery cache until one of them writes */
+  struct SharedRecoveryCache {
+    unsigned int refCount;
+    RecoveryCache cache;
+
+    SharedRecoveryCache() : refCount(0) {}
+    SharedRecoveryCache(const RecoveryCache &cache) : refCount(0), cache(cache) {}
+  };
+
   /* a normal state has a suspend status */
   bool suspendStatus;
+  /* wall time of the last suspension */
+  double suspendTime;
   /* history of taken snapshots, which are uses to create recovery states */
   std::vector< ref<Snapshot> > snapshots;
   /* a normal state has a unique recovery state */
@@ -169,17 +276,20 @@ private:
   /* TODO: rename/re-implement */
   bool blockingLoadStatus;
   /* resloved load addresses */
-  std::set<uint64_t> recoveredLoads;
+  CopyOnWrite< std::set<uint64_t> > recoveredLoads;
   /* we have to remember which allocations were executed */
   AllocationRecord allocationRecord;
   /* used for guiding multiple recovery states */
-  std::set< ref<Expr> > guidingConstraints;
-  /* we need to know if an address was written  */
-  WrittenAddresses writtenAddresses;
+  CopyOnWrite< std::set< ref<Expr> > > guidingConstraints;
+  /* the fork conditions of the recovery states, not yet added while
+     suspended (--defer-dependent-constraints), the forks share them */
+  CopyOnWrite< std::vector< ref<Expr> > > deferredConstraints;
+  /* we need to know if an address was written, forks share the ranges */
+  CopyOnWrite<WrittenRanges> writtenAddresses;
   /* we use this to determine which recovery states must be run */
   std::list< ref<RecoveryInfo> > pendingRecoveryInfos;
   /* TODO: add docs */
-  RecoveryCache recoveryCache;
+  ref<SharedRecoveryCache> recoveryCache;
 
   /* recovery state properties */
 
@@ -228,6 +338,17 @@ public:
   /// @brief Costs for all queries issued for this state, in seconds
   mutable double queryCost;
 
+  /// @brief An assignment satisfying the constraints, kept by the solver
+  /// while no added constraint contradicts it (--reuse-branch-models)
+  mutable CopyOnWrite<Assignment> model;
+  mutable bool modelValid;
+
+  /// @brief The values by array name (a SharedSolverCache::Seed) of the
+  /// solution the donor sent with the replayed prefix (--concolic-replay),
+  /// the arrays made symbolic during the replay take theirs in the model
+  typedef std::map<std::string, std::vector<unsigned char> > ReplaySeed;
+  CopyOnWrite<ReplaySeed> replaySeed;
+
   /// @brief Weight assigned for importance of this state.  Can be
   /// used for searchers to decide what paths to explore
   double weight;
@@ -241,15 +362,40 @@ public:
   ///prefix depth
   unsigned int prefixDepth;
   
-  ///prefix depth pairs for this states
-  std::vector<std::pair<char*, int>> prefixes;
+  ///the prefixes this state replays
+  PrefixTrie prefixes;
 
   ///prefix pointer
   char* prefix;
 
-
-  ///branch or not to branch decisions
-  std::vector<char> branchHist;
+  ///branches were taken from a prefix without asking the solver and the
+  ///resulting path has not been checked for feasibility yet
+  bool replayPending;
+
+  ///answer to the branch query on asyncCondition, solved while the state
+  ///was parked (--async-fork-queries); asyncCondition is null if none
+  ref<Expr> asyncCondition;
+  ///Solver::Validity of the answer, or 2 if the query failed
+  int asyncResult;
+
+
+  ///branch or not to branch decisions: the true and false side of a fork
+  ///('0', '1'), of a branch which did not fork ('2', '3'), or both sides of
+  ///a fork merged at its join ('4')
+  BranchPath branchHist;
+
+  ///the join point of the branch the state forked at last, where it waits
+  ///to merge with the other side (--auto-merge); null if none
+  KInstruction *mergeJoin;
+  ///the stack size and the length of the branch history at that branch
+  unsigned mergeFrame;
+  size_t mergeHistory;
+  ///the id both sides of that branch share, 0 if none; it outlives
+  ///mergeJoin, so that the other side stops waiting once this one forked
+  uint64_t mergeId;
+  ///the prefixes left after a merged branch ('4') of the prefixes, replayed
+  ///once both sides of the branch merged
+  PrefixTrie joinPrefixes;
 
   /// @brief History of complete path: represents branches taken to
   /// reach/create this state (both concrete and symbolic)
@@ -266,6 +412,38 @@ public:
   /// @brief Whether a new instruction was covered in this state
   bool coveredNew;
 
+  /// @brief Value of stats::instructions when the state was last selected
+  uint64_t lastScheduled;
+
+  /// @brief Epoch of the distances to uncovered code the minimal distances
+  /// of the stack frames were computed from
+  uint64_t uncoveredEpoch;
+
+  /// @brief Instructions to the nearest --error-location target as of the
+  /// last step, 0 if none is reachable or there are no targets
+  uint64_t targetDistance;
+
+  /// @brief Position of the state in each kind of StateSet of the
+  /// executor, only trusted by a set which holds the state there
+  unsigned stateSetIndex[3];
+
+  /// @brief Depth at which the state is kept for donation (--donate-depth),
+  /// 0 until the state has left its prefix
+  unsigned donateDepth;
+
+  /// @brief Length of the next path prefix the state claims from the
+  /// master (--claim-prefix-depth), 0 until the state has left its prefix
+  unsigned claimDepth;
+
+  /// @brief The prefix subtree the state explores, a new one for every
+  /// state which reaches the end of its prefixes (--fair-share-slice), 0
+  /// while it replays them
+  unsigned subtree;
+
+  /// @brief A loop of the state forked more often than --loop-budget, the
+  /// state is kept for donation until nothing else is left
+  bool overLoopBudget;
+
   /// @brief Disables forking for this state. Set by user code
   bool forkDisabled;
 
@@ -275,14 +453,25 @@ public:
   /// @brief Pointer to the process tree of the current state
   PTreeNode *ptreeNode;
 
-  /// @brief Ordered list of symbolics: used to generate test cases.
-  //
-  // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<const MemoryObject *, const Array *> > symbolics;
+  /// @brief Position of the state in the list of the searcher holding it,
+  /// for constant time removal
+  std::list<ExecutionState *>::iterator searcherPos;
+  /// @brief Depth the BFS searcher files the state under
+  unsigned searcherDepth;
+
+  /// @brief Ordered list of symbolics: used to generate test cases. Shared
+  /// with the states forked from this one until one of them adds to it.
+  CopyOnWrite<SymbolicList> symbolics;
+
+  /// @brief The object each array of the symbolics was made for, so that
+  /// implied value concretization finds the objects a read refers to
+  /// without scanning the address space.
+  CopyOnWrite<std::map<const Array *, const MemoryObject *> > symbolicObjects;
 
   /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  CopyOnWrite< std::set<std::string> > arrayNames;
 
+  bool hasFnAliases() const { return !fnAliases->empty(); }
   std::string getFnAlias(std::string fn);
   void addFnAlias(std::string old_fn, std::string new_fn);
   void removeFnAlias(std::string fn);
@@ -307,7 +496,29 @@ public:
   void popFrame();
 
   void addSymbolic(const MemoryObject *mo, const Array *array);
+  /// @brief The object made symbolic with the array, or null.
+  const MemoryObject *getSymbolicObject(const Array *array) const;
+  bool hasModel() const { return modelValid; }
+  void setModel(const Assignment &assignment) const {
+    model.write() = assignment;
+    modelValid = true;
+  }
+  /// @brief Take the first of the seeds satisfying the constraints as the
+  /// model, an array a seed lacks is zero. Returns false if none does.
+  bool adoptReplaySeed(const std::vector<ReplaySeed> &seeds);
+  /// @brief The value of e under the model, constant if it decides it.
+  ref<Expr> evaluateInModel(ref<Expr> e) const {
+    return model->evaluate(e);
+  }
+
   void addConstraint(ref<Expr> e) {
+    if (modelValid) {
+      ref<Expr> value = evaluateInModel(e);
+      if (!value->isTrue()) {
+        model.clear();
+        modelValid = false;
+      }
+    }
     constraints.addConstraint(e);
 
     if (isNormalState() && !isRecoveryState()) {
@@ -317,7 +528,17 @@ public:
     }
   }
 
-  bool merge(const ExecutionState &b);
+  /// Merge b into the state. maxSelects bounds the values which differ
+  /// between the two, i.e. the selects the merge adds.
+  bool merge(const ExecutionState &b, unsigned maxSelects = ~0u);
+  /// The state merged with the other side of the branch it waited for:
+  /// the branch and the branches since become a merged branch ('4').
+  void joinMerged();
+  /// A hash of the position, the stack, the memory and the constraints.
+  /// States with the same fingerprint continue alike, as far as the hash
+  /// can tell. The ranks agree on the fingerprints of the same state if
+  /// they allocate the objects at the same addresses (--allocate-determ).
+  uint64_t computeFingerprint() const;
   void dumpStack(llvm::raw_ostream &out) const;
 
   void setType(int type) {
@@ -350,6 +571,14 @@ public:
     suspendStatus = false;
   }
 
+  double getSuspendTime() {
+    return suspendTime;
+  }
+
+  void setSuspendTime(double time) {
+    suspendTime = time;
+  }
+
   std::vector< ref<Snapshot> > &getSnapshots() {
     assert(isNormalState());
     return snapshots;
@@ -397,19 +626,19 @@ public:
     blockingLoadStatus = true;
   }
 
-  std::set<uint64_t> &getRecoveredLoads() {
+  const std::set<uint64_t> &getRecoveredLoads() {
     assert(isNormalState());
-    return recoveredLoads;
+    return *recoveredLoads;
   }
 
   void addRecoveredAddress(uint64_t address) {
     assert(isNormalState());
-    recoveredLoads.insert(address);
+    recoveredLoads.write().insert(address);
   }
 
   bool isAddressRecovered(uint64_t address) {
     assert(isNormalState());
-    return recoveredLoads.find(address) != recoveredLoads.end();
+    return recoveredLoads->count(address) != 0;
   }
 
   void clearRecoveredAddresses() {
@@ -481,19 +710,19 @@ public:
     guidingAllocationRecord = record;
   }
 
-  std::set <ref<Expr> > &getGuidingConstraints() {
+  const std::set <ref<Expr> > &getGuidingConstraints() {
     assert(isNormalState());
-    return guidingConstraints;
+    return *guidingConstraints;
   }
 
   void setGuidingConstraints(std::set< ref<Expr> > &constraints) {
     assert(isNormalState());
-    guidingConstraints = constraints;
+    guidingConstraints.write() = constraints;
   }
 
   void addGuidingConstraint(ref<Expr> condition) {
     assert(isNormalState());
-    guidingConstraints.insert(condition);
+    guidingConstraints.write().insert(condition);
   }
 
   void clearGuidingConstraints() {
@@ -501,28 +730,39 @@ public:
     guidingConstraints.clear();
   }
 
+  const std::vector< ref<Expr> > &getDeferredConstraints() {
+    assert(isNormalState());
+    return *deferredConstraints;
+  }
+
+  void addDeferredConstraint(ref<Expr> condition) {
+    assert(isNormalState());
+    deferredConstraints.write().push_back(condition);
+  }
+
+  void clearDeferredConstraints() {
+    assert(isNormalState());
+    deferredConstraints.clear();
+  }
+
   void addWrittenAddress(uint64_t address, size_t size, unsigned int snapshotIndex) {
     assert(isNormalState());
-    WrittenAddressInfo &info = writtenAddresses[address];
-    if (size > info.maxSize) {
-      info.maxSize = size;
-    }
-    info.snapshotIndex = snapshotIndex;
+    writtenAddresses.write().add(address, size, snapshotIndex);
   }
 
   bool getWrittenAddressInfo(uint64_t address, size_t loadSize,
                              WrittenAddressInfo &info) {
     assert(isNormalState());
-    WrittenAddresses::iterator i = writtenAddresses.find(address);
-    if (i == writtenAddresses.end()) {
+    // we have a complete overwrite iff all loaded bytes were written, the
+    // earliest of those writes tells the snapshots they override
+    unsigned snapshotIndex;
+    if (!writtenAddresses->covers(address, loadSize, snapshotIndex)) {
       return false;
     }
 
-    info = i->second;
-
-    // we have a complete overwrite iff we write at least loadSize bits
-    size_t writtenSize = i->second.maxSize;
-    return writtenSize >= loadSize;
+    info.maxSize = loadSize;
+    info.snapshotIndex = snapshotIndex;
+    return true;
   }
 
   unsigned int getStartingIndex(uint64_t address, size_t size) {
@@ -555,12 +795,12 @@ public:
     return !pendingRecoveryInfos.empty();
   }
 
-  RecoveryCache &getRecoveryCache() {
+  ref<SharedRecoveryCache> getRecoveryCache() {
     assert(isNormalState());
     return recoveryCache;
   }
 
-  void setRecoveryCache(RecoveryCache &cache) {
+  void setRecoveryCache(ref<SharedRecoveryCache> cache) {
     assert(isNormalState());
     recoveryCache = cache;
   }
@@ -571,8 +811,14 @@ public:
     uint64_t address,
     ref<Expr> expr
   ) {
+    if (recoveryCache.isNull()) {
+      recoveryCache = new SharedRecoveryCache();
+    } else if (recoveryCache->refCount > 1) {
+      /* copy on write */
+      recoveryCache = new SharedRecoveryCache(recoveryCache->cache);
+    }
     auto key = std::make_pair(index, sliceId);
-    ValuesCache &valuesCache = recoveryCache[key];
+    ValuesCache &valuesCache = recoveryCache->cache[key];
     valuesCache[address] = expr;
   };
 
@@ -582,9 +828,13 @@ public:
     uint64_t address,
     ref<Expr> &expr
   ) {
+    if (recoveryCache.isNull()) {
+      return false;
+    }
+
     auto key = std::make_pair(index, sliceId);
-    RecoveryCache::iterator i = recoveryCache.find(key);
-    if (i == recoveryCache.end()) {
+    RecoveryCache::iterator i = recoveryCache->cache.find(key);
+    if (i == recoveryCache->cache.end()) {
       return false;
     }
 
@@ -646,110 +896,68 @@ public:
   }*/
 
   bool shallIRange() {
-    if(prefixes.size() == 0) {
-      return false;
-    } else {
-      for(auto it=prefixes.begin(); it!=prefixes.end(); it++) {
-        if(depth < it->second) {
-          return true;
-        } //else if(depth == it->second) {
-          //it = prefixes.erase(it);
-        //}
-      }
-      return false;
-    }
+    return prefixes.hasNext();
   }
 
   int branchToTake(bool& forkAndSuspend) {
     //res = 0 -> true, 1 -> false, 2 -> fork
-    assert(depth < prefixes[0].second);
-    for(int x=1; x<prefixes.size(); x++) {
-      if((prefixes[x].first[depth]) != prefixes[0].first[depth]) {
-        if(prefixes[x].first[depth] == '2' && prefixes[x].first[depth] == '3') {
-          //i dont think this should happen
-          assert(false);
-        }
-        if(prefixes[0].first[depth] == '2' && prefixes[0].first[depth] == '3') {
-          //i dont think this should happen
-          assert(false);
-        }
-        //here should just fork
-        forkAndSuspend = false;
-        //if(prefixes[0].second == depth) {
-        //  prefixes.erase(prefixes.begin());
-        //}
-        return 2;
-      } 
+    assert(prefixes.hasNext());
+    unsigned numNext = 0;
+    char next = 0;
+    for(char branch='0'; branch<'0'+PrefixTrie::NumBranches; branch++) {
+      if(prefixes.hasNext(branch)) {
+        numNext++;
+        next = branch;
+      }
     }
-    
-    if(prefixes[0].first[depth] == '0') {
-      forkAndSuspend = true;
-      //if(prefixes[0].second == depth) {
-      //  prefixes.erase(prefixes.begin());
-      //}
-      return 0;
-    } else if(prefixes[0].first[depth] == '1') {
-      forkAndSuspend = true;
-      //if(prefixes[0].second == depth) {
-      //  prefixes.erase(prefixes.begin());
-      //}
-      return 1;
-    } else if(prefixes[0].first[depth] == '2') {
-      forkAndSuspend = false;
-      //if(prefixes[0].second == depth) {
-      //  prefixes.erase(prefixes.begin());
-      //}
-      return 0;
-    } else if(prefixes[0].first[depth] == '3') {
+    //the prefixes part here, or the sides of a merged branch merge again
+    //at its join, so just fork
+    if(numNext > 1 || next == '4') {
       forkAndSuspend = false;
-      //if(prefixes[0].second == depth) {
-      //  prefixes.erase(prefixes.begin());
-      //}
-      return 1;
+      return 2;
     }
-
+    //'0' and '1' were forks, '2' and '3' were not
+    forkAndSuspend = next == '0' || next == '1';
+    return (next == '0' || next == '2') ? 0 : 1;
   }
 
-  void addPrefix(char* inPrefix, unsigned int length) {
-    prefixes.push_back(std::make_pair(inPrefix, length));
+  void addPrefix(const char* inPrefix, unsigned int length) {
+    prefixes.add(inPrefix, length, depth);
+    replayPending = true;
   }
 
   int getNumPrefixes() {
     return prefixes.size();
   }
-  
-  void removeFalsePrefixes() {
-    //mylogFile<<"PrefixLen: "<<prefixes.size()<<"\n";
-    if(prefixes.size() > 1) {
-      for(auto it=prefixes.begin(); it!=prefixes.end();) {
-        if(it->first[depth] == '1') {
-          it = prefixes.erase(it);
-        } else {
-          ++it;
-        }
-      }
-    } else if(prefixes.size() == 1) {
-      if(prefixes[0].first[depth] == '1') {
-        prefixes.pop_back();
-      }
-    }
+
+  /// Record a branch the state took, the prefixes follow it.
+  void addBranch(char branch) {
+    branchHist.push_back(branch);
+    prefixes.advance(branch);
+    //a side which forks again does not merge at the join
+    if (branch == '0' || branch == '1')
+      mergeJoin = 0;
   }
 
-  void removeTruePrefixes() {
-    //mylogFile<<"PrefixLen: "<<prefixes.size()<<"\n";
-    if(prefixes.size() > 1) {
-      for(auto it=prefixes.begin(); it!=prefixes.end();) {
-        if(it->first[depth] == '0') {
-          it = prefixes.erase(it);
-        } else {
-          ++it;
-        }
-      }
-    } else if(prefixes.size() == 1) {
-      if(prefixes[0].first[depth] == '0') {
-        prefixes.pop_back();
-      }
-    }
+  /// Wait at join for the other side of the branch just taken, which has
+  /// the same id.
+  void setMergeJoin(KInstruction *join, uint64_t id) {
+    mergeJoin = join;
+    mergeFrame = stack.size();
+    mergeHistory = branchHist.size() - 1;
+    mergeId = id;
+  }
+
+  bool isAtMergeJoin() const {
+    return mergeJoin && (KInstruction *) pc == mergeJoin &&
+           stack.size() == mergeFrame;
+  }
+
+  /// The branch of the prefixes at the pc is a merged one, its sides
+  /// replay the rest of the prefixes once they merged.
+  void holdJoinPrefixes() {
+    joinPrefixes = prefixes;
+    joinPrefixes.advance('4');
   }
 
   int getPrefixesSize() {
@@ -11,7 +11,9 @@
 #define KLEE_EXPR_H
 
 #include "klee/util/Bits.h"
+#include "klee/util/NodeAllocator.h"
 #include "klee/util/Ref.h"
+#include "klee/util/RefCount.h"
 
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/APFloat.h"
@@ -35,6 +37,7 @@ class Array;
 class ArrayCache;
 class ConstantExpr;
 class ObjectState;
+struct UpdateSnapshot;
 
 template<class T> class ref;
 
@@ -89,7 +92,7 @@ Todo: Shouldn't bool \c Xor just be written as not equal?
 
 class Expr {
 public:
-  static unsigned count;
+  static InstanceCount count;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
   /// The type of an expression is simply its width, in bits. 
@@ -172,11 +175,18 @@ public:
     CmpKindLast=Sge
   };
 
-  unsigned refCount;
+  RefCount refCount;
 
 protected:  
   unsigned hashValue;
 
+private:
+  /// The bits known to be 0 and to be 1 in every value of the expression,
+  /// all set in both until getKnownBits computes them.
+  mutable uint64_t knownZero, knownOne;
+
+protected:
+
   /// Compares `b` to `this` Expr and determines how they are ordered
   /// (ignoring their kid expressions - i.e. those returned by `getKid()`).
   ///
@@ -201,9 +211,44 @@ protected:
   /// `<` and `>` are binary relations that express the partial order.
   virtual int compareContents(const Expr &b) const = 0;
 
+  /// Add e to the intern table, or return the equal expression already in
+  /// it.
+  static ref<Expr> internExpr(Expr *e);
+  /// Remove e from the intern table, if it is there.
+  static void forgetExpr(Expr *e);
+
 public:
-  Expr() : refCount(0) { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  Expr() : refCount(0), hashValue(0), knownZero(~0ULL), knownOne(~0ULL) {
+    Expr::count++;
+  }
+
+  /// Expressions live in the slabs of the NodeAllocator.
+  static void *operator new(size_t bytes) {
+    return NodeAllocator::allocate(bytes);
+  }
+  static void operator delete(void *p, size_t bytes) {
+    NodeAllocator::deallocate(p, bytes);
+  }
+
+  virtual ~Expr() {
+    Expr::count--;
+    if (internExprs)
+      forgetExpr(this);
+  }
+
+  /// With interning (--intern-exprs), expressions are hash-consed: an
+  /// expression structurally equal to a live one is not allocated again, so
+  /// equal expressions are usually the same node.
+  static bool internExprs;
+
+  /// Returns e, or the live expression equal to it when interning. The hash
+  /// of e must be computed.
+  template<class T>
+  static ref<T> intern(const ref<T> &e) {
+    if (!internExprs)
+      return e;
+    return ref<T>(static_cast<T*>(internExpr(e.get()).get()));
+  }
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
@@ -242,6 +287,11 @@ public:
   // but using those children. 
   virtual ref<Expr> rebuild(ref<Expr> kids[/* getNumKids() */]) const = 0;
 
+  /// getKnownBits - The bits known to be 0 and to be 1 in every value of
+  /// the expression, from the known bits of its kids; computed once and
+  /// kept on the node. None are known of expressions wider than 64 bits.
+  void getKnownBits(uint64_t &zero, uint64_t &one) const;
+
   /// isZero - Is this a constant zero.
   bool isZero() const;
   
@@ -418,7 +468,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
@@ -452,7 +502,7 @@ public:
 class UpdateNode {
   friend class UpdateList;  
 
-  mutable unsigned refCount;
+  mutable RefCount refCount;
   // cache instead of recalc
   unsigned hashValue;
 
@@ -463,6 +513,13 @@ public:
 private:
   /// size of this update sequence, including this update
   unsigned size;
+
+  /// the newest update in this sequence, including this update, which has
+  /// a snapshot or is at a symbolic index
+  const UpdateNode *base;
+  /// for some updates at a constant index, the newest update of every
+  /// constant index down to the first update at a symbolic index
+  UpdateSnapshot *snapshot;
   
 public:
   UpdateNode(const UpdateNode *_next, 
@@ -471,14 +528,29 @@ public:
 
   unsigned getSize() const { return size; }
 
+  /// Find the newest update in this sequence which may write index, which is
+  /// either at a symbolic index or at index itself, or null if there is
+  /// none. The runs of updates at constant indices are skipped through their
+  /// snapshots instead of being walked.
+  const UpdateNode *findUpdate(uint64_t index) const;
+
   int compare(const UpdateNode &b) const;  
   unsigned hash() const { return hashValue; }
 
+  /// Update nodes live in the slabs of the NodeAllocator.
+  static void *operator new(size_t bytes) {
+    return NodeAllocator::allocate(bytes);
+  }
+  static void operator delete(void *p, size_t bytes) {
+    NodeAllocator::deallocate(p, bytes);
+  }
+
 private:
-  UpdateNode() : refCount(0) {}
+  UpdateNode() : refCount(0), snapshot(0) {}
   ~UpdateNode();
 
   unsigned computeHash();
+  void buildSnapshot();
 };
 
 class Array {
@@ -578,7 +650,7 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
@@ -623,7 +695,7 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
@@ -686,7 +758,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return intern(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
@@ -753,7 +825,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
@@ -804,7 +876,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
@@ -881,7 +953,7 @@ public:                                                          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return intern(r);                                          \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
     Kind getKind() const { return _class_kind; }                 \
@@ -914,7 +986,7 @@ CAST_EXPR_CLASS(ZExt)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return intern(res);                                                      \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Width getWidth() const { return left->getWidth(); }                        \
@@ -963,7 +1035,7 @@ ARITHMETIC_EXPR_CLASS(AShr)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return intern(res);                                                      \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Kind getKind() const { return _class_kind; }                               \
@@ -1006,6 +1078,39 @@ private:
 
   ConstantExpr(const llvm::APInt &v) : value(v) {}
 
+  /// Constants below numSmallConstants, and the numSmallNegatives ones
+  /// just below 2^w (-1, -2, ...), of the common widths are allocated once
+  /// and shared, so that concrete arithmetic does not allocate them.
+  static const unsigned numSmallConstants = 256;
+  static const unsigned numSmallNegatives = 16;
+
+  /// The index of w among the widths with shared constants, -1 if none.
+  static int getSmallWidthIndex(Width w) {
+    switch (w) {
+    case Bool: return 0;
+    case Int8: return 1;
+    case Int16: return 2;
+    case Int32: return 3;
+    case Int64: return 4;
+    default: return -1;
+    }
+  }
+
+  /// The index of v, truncated to w, among the shared constants of a width,
+  /// -1 if it is not one of them.
+  static int getSmallIndex(uint64_t v, Width w) {
+    if (v < numSmallConstants)
+      return w >= 8 || !(v >> w) ? (int) v : -1;
+    // larger values of Bool and Int8 are left to alloc to truncate
+    if (w < 16)
+      return -1;
+    uint64_t neg = bits64::truncateToNBits(-v, w);
+    return neg && neg <= numSmallNegatives
+               ? (int) (numSmallConstants + neg - 1) : -1;
+  }
+
+  static ref<ConstantExpr> getSmall(int index, int widthIndex);
+
 public:
   ~ConstantExpr() {}
 
@@ -1066,9 +1171,15 @@ public:
   void toMemory(void *address);
 
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+    int widthIndex = getSmallWidthIndex(v.getBitWidth());
+    if (widthIndex != -1) {
+      int index = getSmallIndex(v.getZExtValue(), v.getBitWidth());
+      if (index != -1)
+        return getSmall(index, widthIndex);
+    }
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
-    return r;
+    return intern(r);
   }
 
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
@@ -1076,6 +1187,13 @@ public:
   }
 
   static ref<ConstantExpr> alloc(uint64_t v, Width w) {
+    // the shared constants need no APInt
+    int widthIndex = getSmallWidthIndex(w);
+    if (widthIndex != -1) {
+      int index = getSmallIndex(v, w);
+      if (index != -1)
+        return getSmall(index, widthIndex);
+    }
     return alloc(llvm::APInt(w, v));
   }
 
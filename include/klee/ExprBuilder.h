@@ -86,6 +86,20 @@ namespace klee {
   ///
   /// Base - The base builder to use when constructing expressions.
   ExprBuilder *createSimplifyingExprBuilder(ExprBuilder *Base);
+
+  /// createKnownBitsExprBuilder - Create an expression builder which tracks
+  /// the bits known to be 0 or 1 in every expression, folds expressions
+  /// whose bits are all known, and drops the operations the known bits make
+  /// redundant: masks of bits known to be clear, the side of an Or a mask
+  /// or an extract does not keep, and the extracts of concatenations,
+  /// extensions and constant shifts of the bits of one operand.
+  ///
+  /// Base - The base builder to use when constructing expressions.
+  ExprBuilder *createKnownBitsExprBuilder(ExprBuilder *Base);
+
+  /// simplifyKnownBits - The rewrite of E by a known bits builder, built
+  /// with Builder, or a null reference if it has none.
+  ref<Expr> simplifyKnownBits(ExprBuilder *Builder, const ref<Expr> &E);
 }
 
 #endif
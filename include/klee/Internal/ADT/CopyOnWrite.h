@@ -0,0 +1,56 @@
+//===-- CopyOnWrite.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COPYONWRITE_H
+#define KLEE_COPYONWRITE_H
+
+#include "klee/util/Ref.h"
+
+namespace klee {
+  /// CopyOnWrite - A value which copies share until one of them is written,
+  /// so that copying it is constant time whatever its size.
+  template <class T>
+  class CopyOnWrite {
+    struct Node {
+      unsigned refCount;
+      T value;
+
+      Node() : refCount(0) {}
+      Node(const T &_value) : refCount(0), value(_value) {}
+    };
+
+    ref<Node> node;
+
+    static const T &getEmpty() {
+      static const T empty;
+      return empty;
+    }
+
+  public:
+    const T &operator*() const {
+      return node.isNull() ? getEmpty() : node->value;
+    }
+    const T *operator->() const { return &**this; }
+
+    /// The value for writing, copied first if it is shared.
+    T &write() {
+      if (node.isNull())
+        node = new Node();
+      else if (node->refCount > 1)
+        node = new Node(node->value);
+      return node->value;
+    }
+
+    void clear() { node = 0; }
+
+    bool isShared() const { return !node.isNull() && node->refCount > 1; }
+  };
+}
+
+#endif
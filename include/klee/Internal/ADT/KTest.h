@@ -10,6 +10,7 @@
 #ifndef __COMMON_KTEST_H__
 #define __COMMON_KTEST_H__
 
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,6 +36,11 @@ extern "C" {
 
     unsigned numObjects;
     KTestObject *objects;
+
+    /* the file the object bytes point into, if it was mapped by
+       kTest_mapFile */
+    void *mapping;
+    size_t mappingSize;
   };
 
   
@@ -47,6 +53,11 @@ extern "C" {
   /* returns NULL on (unspecified) error */
   KTest* kTest_fromFile(const char *path);
 
+  /* like kTest_fromFile, but maps the file into memory: the bytes of the
+     objects stay in the mapping, read-only, and are only read from disk
+     when used; returns NULL on (unspecified) error */
+  KTest* kTest_mapFile(const char *path);
+
   /* returns 1 on success, 0 on (unspecified) error */
   int   kTest_toFile(KTest *, const char *path);
   
@@ -55,6 +66,33 @@ extern "C" {
 
   void  kTest_free(KTest *);
 
+  /* A container of test cases (.kpack), appended to one test case at a
+     time, and an index of it in the file of the same name ending in .idx */
+  typedef struct KTestPack KTestPack;
+
+  /* appends the test case with the given id to the container at path,
+     creating it if needed; returns 1 on success, 0 on (unspecified) error */
+  int   kTest_appendToPack(KTest *, unsigned id, const char *path);
+
+  /* maps the container at path into memory; returns NULL on (unspecified)
+     error */
+  KTestPack *kTestPack_open(const char *path);
+
+  unsigned kTestPack_numTests(KTestPack *);
+
+  /* returns the id of the i-th test case */
+  unsigned kTestPack_getId(KTestPack *, unsigned i);
+
+  /* returns the contents of the .ktest file of the i-th test case, valid
+     until the container is closed */
+  const unsigned char *kTestPack_getImage(KTestPack *, unsigned i,
+                                          unsigned *size_out);
+
+  /* returns NULL on (unspecified) error */
+  KTest *kTestPack_getTest(KTestPack *, unsigned i);
+
+  void  kTestPack_close(KTestPack *);
+
 #ifdef __cplusplus
 }
 #endif
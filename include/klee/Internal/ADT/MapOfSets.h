@@ -38,6 +38,10 @@ namespace klee {
 
     void insert(const std::set<K> &set, const V &value);
 
+    /// Remove the set, and the nodes no other set goes through.
+    /// \return false if the set was not in the map.
+    bool erase(const std::set<K> &set);
+
     V *lookup(const std::set<K> &set);
 
     iterator begin();
@@ -194,6 +198,30 @@ namespace klee {
     n->value = value;
   }
 
+  template<class K, class V>
+  bool MapOfSets<K,V>::erase(const std::set<K> &set) {
+    std::vector<Node*> path(1, &root);
+    for (typename std::set<K>::const_iterator it = set.begin(), ie = set.end();
+         it != ie; ++it) {
+      typename Node::children_ty::iterator kit = path.back()->children.find(*it);
+      if (kit==path.back()->children.end())
+        return false;
+      path.push_back(&kit->second);
+    }
+    if (!path.back()->isEndOfSet)
+      return false;
+
+    path.back()->isEndOfSet = false;
+    path.back()->value = V();
+    typename std::set<K>::const_reverse_iterator it = set.rbegin();
+    for (unsigned i = path.size() - 1; i > 0; --i, ++it) {
+      if (path[i]->isEndOfSet || !path[i]->children.empty())
+        break;
+      path[i - 1]->children.erase(*it);
+    }
+    return true;
+  }
+
   template<class K, class V>
   V *MapOfSets<K,V>::lookup(const std::set<K> &set) {
     Node *n = &root;
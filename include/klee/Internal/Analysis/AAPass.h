@@ -5,6 +5,8 @@
 #include <llvm/Analysis/AliasAnalysis.h>
 #include <llvm/Pass.h>
 
+#include <string>
+
 class AAPass : public llvm::ModulePass, public llvm::AliasAnalysis {
 
 public:
@@ -18,7 +20,8 @@ public:
 
   AAPass()
       : llvm::ModulePass(ID), llvm::AliasAnalysis(),
-        type(PointerAnalysis::Default_PTA), _pta(0) {}
+        type(PointerAnalysis::Default_PTA), fieldInsensitive(false), _pta(0),
+        loadPts(false), timeout(0) {}
 
   ~AAPass();
 
@@ -45,13 +48,53 @@ public:
 
   void setPAType(PointerAnalysis::PTATY type) { this->type = type; }
 
+  /// Treat every object as a single field, which is cheaper to solve but
+  /// merges the fields of structs and arrays.
+  void setFieldInsensitive(bool fi) { fieldInsensitive = fi; }
+
+  /// Give the analysis this many seconds (0 = no bound). It is solved in a
+  /// child process; when that runs out of time, the field insensitive
+  /// wave-diff analysis is solved instead and the lost precision reported.
+  void setTimeout(double seconds) { timeout = seconds; }
+
   BVDataPTAImpl *getPTA() { return _pta; }
 
+  /// Share the solved points-to sets through a file: with load set, the
+  /// PAG is built and the sets are read from path instead of being solved
+  /// (falling back to solving if the file is missing or does not match the
+  /// module), otherwise they are written to path after solving.
+  void setPointsToFile(const std::string &path, bool load) {
+    ptsFile = path;
+    loadPts = load;
+  }
+
+  /// Keep the solved points-to sets in dir, keyed by a hash of the module
+  /// being analyzed; a cached entry is loaded instead of solving and a
+  /// missing one is written after solving.
+  void setPointsToCache(const std::string &dir) { cacheDir = dir; }
+
 private:
-  void runPointerAnalysis(llvm::Module &module, u32_t kind);
+  void runPointerAnalysis(llvm::Module &module, u32_t kind, bool fi);
+
+  /// Solve within the timeout, returns false if it ran out of time.
+  bool runBoundedPointerAnalysis(llvm::Module &module);
+
+  /// The average size of the non-empty points-to sets of the pointers.
+  double getAveragePointsToSize();
+
+  bool loadPointsTo(llvm::Module &module);
+
+  bool writePointsTo(llvm::Module &module);
+
+  std::string getCacheFile(llvm::Module &module);
 
   PointerAnalysis::PTATY type;
+  bool fieldInsensitive;
   BVDataPTAImpl *_pta;
+  std::string ptsFile;
+  bool loadPts;
+  std::string cacheDir;
+  double timeout;
 };
 
 #endif /* AAPASS_H */
@@ -22,7 +22,7 @@ public:
   void run();
 
 private:
-  void inlineCalls(llvm::Function *f, std::vector<std::string> functions);
+  void inlineCalls(llvm::Function *f, std::set<llvm::Function *> &inlined);
 
   llvm::Module *module;
   ReachabilityAnalysis *ra;
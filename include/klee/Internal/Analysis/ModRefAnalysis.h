@@ -123,7 +123,10 @@ public:
   void dumpModInfo(const ModInfo &modInfo, const char *prefix = "");
 
 private:
-  typedef std::map<llvm::Function *, bool> ReachabilityCache;
+  typedef std::map<llvm::Function *, std::set<llvm::Function *> >
+  ReachabilityCache;
+  typedef std::vector<std::pair<llvm::Instruction *, NodeID> > StoreSummary;
+  typedef std::map<llvm::Function *, StoreSummary> StoreSummaryMap;
 
   /* priate methods */
 
@@ -131,7 +134,9 @@ private:
 
   void collectModInfo(llvm::Function *f);
 
-  void addStore(llvm::Function *f, llvm::Instruction *store);
+  StoreSummary &getStoreSummary(llvm::Function *f);
+
+  void addStore(llvm::Function *f, llvm::Instruction *store, NodeID nodeId);
 
   bool canIgnoreStackObject(llvm::Function *f, const llvm::Value *value);
 
@@ -186,6 +191,8 @@ private:
 
   ReachabilityCache cache;
 
+  StoreSummaryMap storeSummaries;
+
   llvm::raw_ostream &debugs;
 };
 
@@ -6,6 +6,8 @@
 #include <set>
 #include <map>
 
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instruction.h>
@@ -26,7 +28,7 @@ public:
                        std::vector<std::string> targets,
                        llvm::raw_ostream &debugs)
       : module(module), entry(entry), targets(targets), entryFunction(NULL),
-        aa(NULL), debugs(debugs) {}
+        aa(NULL), closureUsesPA(false), debugs(debugs) {}
 
   ~ReachabilityAnalysis() {};
 
@@ -40,8 +42,17 @@ public:
   void computeReachableFunctions(llvm::Function *entry, bool usePA,
                                  FunctionSet &results);
 
+  /* f must be reachable from the entry or a target */
   FunctionSet &getReachableFunctions(llvm::Function *f);
 
+  /* whether the closure computed by run (with or without the pointer
+     analysis, as given) covers f */
+  bool hasReachabilityInfo(llvm::Function *f, bool usePA);
+
+  /* whether g is reachable from f, a single bit test; f must be covered by
+     the closure */
+  bool isReachable(llvm::Function *f, llvm::Function *g);
+
   void insertIntoReachabilityMap(llvm::Function* entry, FunctionSet inFunctionSet);
 
   void getReachableInstructions(std::vector<llvm::CallInst *> &callSites,
@@ -58,7 +69,11 @@ private:
 
   void computeFunctionTypeMap();
 
-  void updateReachabilityMap(llvm::Function *f, bool usePA);
+  void buildCallGraph(std::vector<llvm::Function *> &roots, bool usePA);
+
+  void computeClosure();
+
+  unsigned getFunctionId(llvm::Function *f);
 
   bool isVirtual(llvm::Function *f);
 
@@ -82,7 +97,17 @@ private:
   std::vector<llvm::Function *> targetFunctions;
   AAPass *aa;
   FunctionTypeMap functionTypeMap;
+  /* the sets handed out by getReachableFunctions, built on demand */
   ReachabilityMap reachabilityMap;
+  /* the functions reachable from the entry and the targets, by id */
+  std::vector<llvm::Function *> functions;
+  llvm::DenseMap<llvm::Function *, unsigned> functionIds;
+  std::vector<std::vector<unsigned> > callees;
+  /* the reachable functions of every strongly connected component of the
+     call graph, and the component of every function */
+  std::vector<llvm::BitVector> sccReachable;
+  std::vector<unsigned> sccOf;
+  bool closureUsesPA;
   CallMap callMap;
   RetMap retMap;
   llvm::raw_ostream &debugs;
@@ -37,6 +37,9 @@ public:
   ~Slicer();
 
   int run();
+  /// Write the module with the slices, on rank 0 only and only with
+  /// -save-sliced-module; the slices are used from memory either way.
+  static int saveModule(llvm::Module *M);
   bool buildDG();
   bool mark();
   void computeEdges();
@@ -12,9 +12,12 @@
 
 #include "klee/Internal/Analysis/Cloner.h"
 
+#include "llvm/ADT/DenseMap.h"
+
 #include <map>
 #include <string>
 #include <set>
+#include <vector>
 
 namespace llvm {
   class Function;
@@ -27,13 +30,13 @@ namespace klee {
   /* Stores debug information for a KInstruction */
   struct InstructionInfo {
     unsigned id;
-    const std::string &file;
+    const std::string *file;
     unsigned line;
     unsigned assemblyLine;
 
   public:
     InstructionInfo(unsigned _id,
-                    const std::string &_file,
+                    const std::string *_file,
                     unsigned _line,
                     unsigned _assemblyLine)
       : id(_id), 
@@ -43,6 +46,13 @@ namespace klee {
     }
   };
 
+  /// The ids and source locations of the instructions of a module.
+  ///
+  /// The infos are stored in a single array indexed by instruction id, and
+  /// the instructions of a cloned function share the entries of the ones
+  /// they were cloned from. Ids are always assigned up front; in lazy mode
+  /// the source locations of a function are only read from its debug
+  /// information when it is loaded, and assembly lines are not computed.
   class InstructionInfoTable {
     struct ltstr { 
       bool operator()(const std::string *a, const std::string *b) const {
@@ -52,21 +62,44 @@ namespace klee {
 
     std::string dummyString;
     InstructionInfo dummyInfo;
-    std::map<const llvm::Instruction*, InstructionInfo> infos;
-    std::set<const std::string *, ltstr> internedStrings;
+    /// Indexed by instruction id.
+    mutable std::vector<InstructionInfo> infos;
+    /// Maps every instruction to its id, or to ~0u for the instructions of
+    /// cloned functions which have no original (these get dummyInfo).
+    llvm::DenseMap<const llvm::Instruction*, unsigned> ids;
+    /// The functions which own ids, in id order, with the first id of each.
+    std::vector<const llvm::Function*> functions;
+    std::vector<unsigned> functionStart;
+    /// Maps a function to its index in functions, or a cloned function to
+    /// ~0u once its originals were loaded.
+    mutable llvm::DenseMap<const llvm::Function*, unsigned> functionIndex;
+    mutable std::vector<bool> loaded;
+    mutable std::set<const std::string *, ltstr> internedStrings;
+    bool lazy;
 
   private:
-    const std::string *internString(std::string s);
+    const std::string *internString(std::string s) const;
     bool getInstructionDebugInfo(const llvm::Instruction *I,
-                                 const std::string *&File, unsigned &Line);
+                                 const std::string *&File,
+                                 unsigned &Line) const;
+    void loadIndex(unsigned index) const;
+    void loadID(unsigned id) const;
 
   public:
-    InstructionInfoTable(llvm::Module *m, bool isSkippingFunctions, Cloner *cloner);
+    InstructionInfoTable(llvm::Module *m, bool isSkippingFunctions,
+                         Cloner *cloner, bool lazy = false);
     ~InstructionInfoTable();
 
     unsigned getMaxID() const;
+    unsigned getID(const llvm::Instruction*) const;
+    /// The info of an instruction, whose source location may not be loaded
+    /// yet in lazy mode.
+    const InstructionInfo &lookup(const llvm::Instruction*) const;
     const InstructionInfo &getInfo(const llvm::Instruction*) const;
     const InstructionInfo &getFunctionInfo(const llvm::Function*) const;
+    /// Load the source locations of a function (or of the originals of a
+    /// cloned function) if that was not done yet.
+    void loadFunction(const llvm::Function *f) const;
     void addClonedInfo(Cloner *cloner, llvm::Function *f);
   };
 
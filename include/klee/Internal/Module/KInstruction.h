@@ -12,10 +12,13 @@
 
 #include "klee/Config/Version.h"
 #include "llvm/Support/DataTypes.h"
+#include <utility>
 #include <vector>
 
 namespace llvm {
+  class Function;
   class Instruction;
+  class Value;
 }
 
 namespace klee {
@@ -23,6 +26,15 @@ namespace klee {
   struct InstructionInfo;
   class KModule;
 
+  /* a skipped function which may modify the object read by a load */
+  struct KModifierInfo {
+    llvm::Function *f;
+    /* allocation site and offset of the modified object */
+    const llvm::Value *allocSite;
+    uint64_t offset;
+    /* 0 if the modifier has no slice */
+    uint32_t sliceId;
+  };
 
   /// KInstruction - Intermediate instruction representation used
   /// during execution.
@@ -37,6 +49,9 @@ namespace klee {
     int *operands;
     /// Destination register index.
     unsigned dest;
+    /// The opcode of inst, kept here so that dispatching an instruction
+    /// does not have to touch the LLVM instruction.
+    unsigned opcode;
 
     /* TODO: add doc... */
     bool isCloned;
@@ -44,6 +59,10 @@ namespace klee {
     llvm::Instruction *origInst;
     /* relevant only for load instructions */
     bool mayBlock;
+    /* the modifiers of a may-blocking load, ordered like the mod-infos of
+       ModRefAnalysis::LoadToModInfoMap */
+    KModifierInfo *modifiers;
+    unsigned numModifiers;
     /* relevant only for store instructions */
     bool mayOverride;
     /* id of the instruction */
@@ -71,6 +90,28 @@ namespace klee {
     /// instruction.
     uint64_t offset;
   };
+
+  /// KCallInstruction - A call or invoke, with what the executor resolves
+  /// about its callee on the first call.
+  struct KCallInstruction : KInstruction {
+    /// The callee of a state without function aliases, 0 if the call is
+    /// indirect. Valid once targetResolved is set.
+    llvm::Function *target;
+    bool targetResolved;
+    /// target is a slicing annotation, which is not executed
+    bool isAnnotation;
+    /// Whether calls to target are skipped at this call site, -1 until it
+    /// is known.
+    int skipTarget;
+    /// The legal targets of an indirect call seen at this call site, by
+    /// address, the first MaxIndirectTargets of them.
+    std::vector<std::pair<uint64_t, llvm::Function *> > indirectTargets;
+    enum { MaxIndirectTargets = 4 };
+
+    KCallInstruction()
+      : target(0), targetResolved(false), isAnnotation(false),
+        skipTarget(-1) {}
+  };
 }
 
 #endif
@@ -63,6 +63,17 @@ namespace klee {
     
     bool isCloned;
 
+    /// LoopExit - A loop which a conditional branch may leave, with the
+    /// successors of the branch outside of it (bit i for successor i).
+    struct LoopExit {
+      llvm::BasicBlock *header;
+      unsigned exitMask;
+    };
+
+    /// The conditional branches which may leave a loop, with the loops they
+    /// may leave, innermost first. Empty until findLoopExits is called.
+    std::map<llvm::Instruction*, std::vector<LoopExit> > loopExits;
+
   private:
     KFunction(const KFunction&);
     KFunction &operator=(const KFunction&);
@@ -72,6 +83,9 @@ namespace klee {
     ~KFunction();
 
     unsigned getArgRegister(unsigned index) { return index; }
+
+    /// Find the loops of the function and fill loopExits.
+    void findLoopExits();
   };
 
 
@@ -126,6 +140,14 @@ namespace klee {
     // Mark function with functionName as part of the KLEE runtime
     void addInternalFunction(const char* functionName);
 
+    /// Run the passes which transform the linked module into the one that
+    /// is interpreted, and link the intrinsic library.
+    void transform(const Interpreter::ModuleOptions &opts,
+                   const std::vector<Interpreter::SkippedFunctionOption> &skippedFunctions);
+
+    /// Write the transformed module to path, see ModuleOptions::CacheFile.
+    void writeModuleCache(const std::string &path);
+
   public:
     KModule(llvm::Module *_module);
     ~KModule();
@@ -143,11 +165,18 @@ namespace klee {
                  Cloner *cloner,
                  SliceGenerator *sliceGenerator);
 
+    /// The options of the transformation passes which are not part of the
+    /// ModuleOptions, to key caches of transformed modules with.
+    static std::string getTransformOptions();
+
     /// Return an id for the given constant, creating a new one if necessary.
     unsigned getConstantID(llvm::Constant *c, KInstruction* ki);
 
     void addFunction(KFunction *kf, bool isSkippingFunctions, Cloner *cloner, ModRefAnalysis *mra);
 
+  private:
+    void addModifiers(KInstruction *ki, ModRefAnalysis *mra);
+
   };
 } // End klee namespace
 
@@ -0,0 +1,51 @@
+//===-- BloomFilter.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BLOOMFILTER_H
+#define KLEE_BLOOMFILTER_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace klee {
+  /// BloomFilter - A set of 64 bit hashes in a fixed number of bits, for
+  /// the master to keep the path prefixes the workers claimed
+  /// (--claim-prefix-depth).
+  ///
+  /// A hash inserted is always found again, a hash never inserted is found
+  /// with the false positive rate of the filter, which grows with the
+  /// hashes inserted.
+  class BloomFilter {
+    std::vector<uint64_t> words;
+    uint64_t numBits;
+    unsigned numProbes;
+    uint64_t numInserted;
+    /// the bits set, which give the false positive rate
+    uint64_t numSet;
+
+    uint64_t getBit(uint64_t hash, unsigned probe) const;
+
+  public:
+    /// A filter of numBits bits (at least 64) which sets numProbes bits per
+    /// hash.
+    BloomFilter(uint64_t numBits, unsigned numProbes);
+
+    /// Returns false if the hash was found already, and leaves the filter
+    /// as it is then.
+    bool insert(uint64_t hash);
+    bool contains(uint64_t hash) const;
+
+    /// The number of hashes inserted that were not found.
+    uint64_t size() const { return numInserted; }
+    /// The probability to find a hash never inserted, at the current fill.
+    double getFalsePositiveRate() const;
+  };
+}
+
+#endif
@@ -0,0 +1,61 @@
+//===-- BranchHistory.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BRANCHHISTORY_H
+#define KLEE_BRANCHHISTORY_H
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace klee {
+  /// BranchHistoryWriter - Writes the branch histories of the terminated
+  /// paths to a gzip compressed file.
+  ///
+  /// Consecutive paths mostly share long prefixes, so each is stored as the
+  /// length of the prefix it shares with the previous one and the branches
+  /// after it, both lengths as LEB128 numbers.
+  class BranchHistoryWriter {
+    llvm::raw_ostream *os;
+    std::vector<char> previous;
+
+  public:
+    /// Open the file at path, error is empty unless that failed.
+    BranchHistoryWriter(const std::string &path, std::string &error);
+    ~BranchHistoryWriter();
+
+    void write(const std::vector<char> &path);
+  };
+
+  /// BranchHistoryReader - Reads the files of BranchHistoryWriter and, for
+  /// older logs, plain files of one path per line.
+  class BranchHistoryReader {
+    /// a gzFile
+    void *file;
+    bool binary;
+    std::vector<char> current;
+
+    bool readNumber(size_t &value);
+
+  public:
+    explicit BranchHistoryReader(const std::string &path);
+    ~BranchHistoryReader();
+
+    bool good() const { return file != 0; }
+
+    /// Read the next path, returns false at the end of the file or if it
+    /// is cut short.
+    bool next(std::vector<char> &path);
+  };
+}
+
+#endif
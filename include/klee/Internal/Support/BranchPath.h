@@ -0,0 +1,63 @@
+//===-- BranchPath.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BRANCHPATH_H
+#define KLEE_BRANCHPATH_H
+
+#include "klee/util/Ref.h"
+
+#include <stddef.h>
+#include <vector>
+
+namespace klee {
+  /// BranchPath - The branches a state took, shared with the states forked
+  /// from it.
+  ///
+  /// The branches are kept in chunks which point to the chunk holding the
+  /// branches before them, so copying a path is constant time and the
+  /// paths of siblings share their common prefix. A path appends into its
+  /// last chunk in place while no other path has appended there.
+  class BranchPath {
+  public:
+    enum { ChunkSize = 32 };
+
+  private:
+    struct Chunk {
+      unsigned refCount;
+      ref<Chunk> parent;
+      /// the index of the first branch of data
+      size_t start;
+      /// the branches of data which are in use by some path
+      unsigned used;
+      char data[ChunkSize];
+
+      Chunk(const ref<Chunk> &_parent, size_t _start)
+        : refCount(0), parent(_parent), start(_start), used(0) {}
+    };
+
+    ref<Chunk> last;
+    size_t length;
+
+  public:
+    BranchPath() : length(0) {}
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    void push_back(char branch);
+    void clear();
+    void assign(const char *begin, const char *end);
+
+    /// The branches, in order.
+    void toVector(std::vector<char> &branches) const;
+    std::vector<char> toVector() const;
+  };
+}
+
+#endif
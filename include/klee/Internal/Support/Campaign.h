@@ -0,0 +1,66 @@
+//===-- Campaign.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CAMPAIGN_H
+#define KLEE_CAMPAIGN_H
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace klee {
+  /// Campaign - Several configurations of one program, run side by side in
+  /// one MPI job, each on a block of the ranks.
+  ///
+  /// A campaign file has a configuration per line, comments start with #:
+  ///
+  ///   <name> <priority> [key=value...] [-- <program arguments>...]
+  ///
+  /// with the keys error-location, search and timeout, which stand for the
+  /// options of the same meaning. A configuration leaves the options it
+  /// does not set as they are on the command line.
+  class Campaign {
+  public:
+    struct Config {
+      std::string name;
+      unsigned priority;
+      std::string errorLocation, search;
+      /// in seconds, 0 if not set
+      unsigned timeOut;
+      bool hasArgs;
+      std::vector<std::string> args;
+
+      Config() : priority(1), timeOut(0), hasArgs(false) {}
+    };
+
+  private:
+    std::vector<Config> configs;
+
+  public:
+    bool empty() const { return configs.empty(); }
+    unsigned size() const { return configs.size(); }
+    const Config &operator[](unsigned i) const { return configs[i]; }
+
+    bool parse(std::istream &is, std::string &error);
+    bool read(const std::string &path, std::string &error);
+
+    /// Split numRanks ranks into a block per configuration, in file order.
+    /// Every block gets minRanks, the ranks left over go to the
+    /// configurations in proportion to their priorities. Returns false if
+    /// there are not enough ranks.
+    bool partition(unsigned numRanks, unsigned minRanks,
+                   std::vector<unsigned> &blocks) const;
+
+    /// The configuration whose block holds rank.
+    static unsigned getConfig(const std::vector<unsigned> &blocks,
+                              unsigned rank);
+  };
+}
+
+#endif
@@ -0,0 +1,76 @@
+//===-- ClusterStats.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CLUSTERSTATS_H
+#define KLEE_CLUSTERSTATS_H
+
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+namespace klee {
+  /// ClusterStats - The statistics the workers report to the master, summed
+  /// over the workers.
+  ///
+  /// Every record holds the current values of a worker, so only the last
+  /// record of each is kept. Instructions covered by several workers are
+  /// counted once by each of them.
+  class ClusterStats {
+  public:
+    enum Field {
+      Instructions,
+      States,
+      SuspendedStates,
+      /// in microseconds
+      SolverTime,
+      Queries,
+      /// answered by the query, counterexample or shared cache
+      CacheHits,
+      CoveredInstructions,
+      /// offloads and steals this worker gave work away in
+      Offloads,
+      /// in microseconds, see the phase statistics of the core
+      ReplayTime,
+      ExplorationTime,
+      RecoveryTime,
+      IdleTime,
+      /// in bytes, the util::MemoryCategory accounting in its order
+      ExprMemory,
+      ObjectMemory,
+      ConstraintMemory,
+      SnapshotMemory,
+      SolverCacheMemory,
+      PTreeMemory,
+      PrefixTreeMemory,
+      NumFields
+    };
+
+  private:
+    /// the last record of every rank, empty until one arrived
+    std::vector< std::vector<uint64_t> > records;
+
+  public:
+    static const char *getName(Field field);
+
+    void update(unsigned rank, const uint64_t *record);
+
+    uint64_t getTotal(Field field) const;
+    /// The number of ranks which sent a record.
+    unsigned getNumReporting() const;
+
+    /// Write the column names of writeRow.
+    void writeHeader(std::ostream &os) const;
+    /// Write the totals as a tab separated row, after the elapsed seconds.
+    void writeRow(std::ostream &os, double elapsed) const;
+    /// Write the totals and the records of every rank as a JSON object.
+    void writeJSON(std::ostream &os, double elapsed) const;
+  };
+}
+
+#endif
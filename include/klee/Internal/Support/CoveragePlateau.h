@@ -0,0 +1,57 @@
+//===-- CoveragePlateau.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COVERAGEPLATEAU_H
+#define KLEE_COVERAGEPLATEAU_H
+
+#include <deque>
+#include <stdint.h>
+#include <utility>
+
+namespace klee {
+  /// CoveragePlateau - Tells the master when the instructions the workers
+  /// newly cover, summed over their heartbeats, have dropped below a
+  /// threshold.
+  ///
+  /// The coverage is summed over a sliding window of seconds. The plateau
+  /// is only reached once a whole window has passed since the start or the
+  /// last reset, so the run or a change of heuristics gets a window before
+  /// it is judged.
+  class CoveragePlateau {
+    double window;
+    uint64_t minCovered;
+    /// the start or the last reset
+    double since;
+    /// the time and the newly covered instructions of every heartbeat in
+    /// the window, oldest first
+    std::deque<std::pair<double, uint64_t> > samples;
+    uint64_t inWindow;
+
+    void expire(double now);
+
+  public:
+    /// A window of 0 seconds disables the detection.
+    CoveragePlateau(double window, uint64_t minCovered, double now);
+
+    bool isEnabled() const { return window > 0; }
+
+    /// A heartbeat reported newly covered instructions.
+    void record(double now, uint64_t newlyCovered);
+    /// The instructions newly covered in the last window.
+    uint64_t getCovered(double now);
+    /// Fewer than minCovered instructions were newly covered in the last
+    /// window, which has passed completely since the start or the last
+    /// reset.
+    bool isReached(double now);
+    /// Forget the coverage so far and judge the next window on its own.
+    void reset(double now);
+  };
+}
+
+#endif
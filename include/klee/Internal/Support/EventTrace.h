@@ -0,0 +1,129 @@
+//===-- EventTrace.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EVENTTRACE_H
+#define KLEE_EVENTTRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+namespace klee {
+  /// EventTrace - A ring buffer of the timed events of a process, for a
+  /// timeline of the run.
+  ///
+  /// Recording an event stores it over the oldest one once the buffer is
+  /// full, so tracing costs a few stores and a bounded amount of memory. A
+  /// trace of capacity 0 is disabled and records nothing. Only the thread
+  /// running the states records events, there is no locking.
+  class EventTrace {
+  public:
+    enum Kind {
+      /// the coordinator asked a worker (arg) for work
+      OffloadRequest,
+      /// the coordinator got the answer of a worker (arg)
+      OffloadResponse,
+      /// a worker ran a task of a mode (arg)
+      Task,
+      /// a state used up its prefix, at a depth (arg)
+      ReplayDone,
+      SolverCall,
+      /// a recovery state ran, at a level (arg)
+      Recovery,
+      /// states (arg) were killed over the memory cap
+      MemoryKill,
+      NumKinds
+    };
+
+    struct Event {
+      /// in microseconds of the wall clock
+      uint64_t start;
+      /// in microseconds, 0 for an instant
+      uint64_t duration;
+      uint32_t kind;
+      uint32_t arg;
+    };
+
+  private:
+    std::vector<Event> ring;
+    /// the events recorded so far, including the overwritten ones
+    uint64_t numRecorded;
+
+  public:
+    explicit EventTrace(size_t capacity = 0) : ring(capacity), numRecorded(0) {}
+
+    /// Drop the events and hold up to capacity of them from now on.
+    void setCapacity(size_t capacity);
+    bool isEnabled() const { return !ring.empty(); }
+
+    void record(Kind kind, uint64_t start, uint64_t duration, uint32_t arg) {
+      if (ring.empty())
+        return;
+      Event &event = ring[numRecorded % ring.size()];
+      event.start = start;
+      event.duration = duration;
+      event.kind = kind;
+      event.arg = arg;
+      ++numRecorded;
+    }
+
+    /// The events held, oldest first.
+    void getEvents(std::vector<Event> &out) const;
+    /// The number of events overwritten by newer ones.
+    uint64_t getNumDropped() const;
+
+    /// Append the events held to out, with the time of the sending clock.
+    void encode(uint64_t now, std::vector<char> &out) const;
+    /// Read a packet written by encode.
+    ///
+    /// \return false if the packet is malformed.
+    static bool decode(const char *buffer, size_t size, uint64_t &sent,
+                       uint64_t &dropped, std::vector<Event> &out);
+
+    static const char *getName(Kind kind);
+    /// The wall clock in microseconds.
+    static uint64_t now();
+
+    /// The trace of this process, disabled until given a capacity.
+    static EventTrace &getProcessTrace();
+  };
+
+  /// TraceMerger - The traces of the ranks of a run, on the clock of the
+  /// rank merging them, written as a Chrome trace (JSON), which Perfetto
+  /// reads too.
+  class TraceMerger {
+    struct RankTrace {
+      unsigned rank;
+      uint64_t dropped;
+      std::vector<EventTrace::Event> events;
+    };
+    std::vector<RankTrace> ranks;
+
+  public:
+    /// Add the events of a rank whose clock is offset microseconds ahead
+    /// of ours.
+    void add(unsigned rank, const std::vector<EventTrace::Event> &events,
+             int64_t offset, uint64_t dropped);
+
+    /// Add a packet of EventTrace::encode received at the time received.
+    /// The clock offset is taken from the send time in the packet, so it
+    /// is off by the time the packet took.
+    ///
+    /// \return false if the packet is malformed.
+    bool addPacket(unsigned rank, const char *buffer, size_t size,
+                   uint64_t received);
+
+    /// Write the events as complete and instant events, a process per
+    /// rank, timed from the earliest event.
+    void writeChromeTrace(std::ostream &os) const;
+  };
+}
+
+#endif
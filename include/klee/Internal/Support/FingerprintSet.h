@@ -0,0 +1,53 @@
+//===-- FingerprintSet.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FINGERPRINTSET_H
+#define KLEE_FINGERPRINTSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_set>
+#include <vector>
+
+namespace klee {
+  /// FingerprintSet - The fingerprints of the states seen so far, here and
+  /// on the other workers (see --prune-equivalent-states).
+  ///
+  /// The fingerprints first seen here are also kept to be sent to the
+  /// other workers, as packets of 64 bit words.
+  class FingerprintSet {
+    std::unordered_set<uint64_t> seen;
+    std::vector<uint64_t> outgoing;
+    size_t capacity;
+
+  public:
+    /// Past capacity fingerprints, new ones are no longer recorded.
+    explicit FingerprintSet(size_t _capacity) : capacity(_capacity) {}
+
+    /// Record a fingerprint of this worker. Returns false if it was seen
+    /// already.
+    bool insert(uint64_t fingerprint);
+
+    bool contains(uint64_t fingerprint) const {
+      return seen.count(fingerprint) != 0;
+    }
+
+    size_t size() const { return seen.size(); }
+
+    /// Move the fingerprints not sent yet into packet. Returns false if
+    /// there are none.
+    bool takeOutgoing(std::vector<char> &packet);
+
+    /// Record the fingerprints of a packet of another worker. Returns false
+    /// if the packet is malformed.
+    bool addPacket(const char *data, size_t n);
+  };
+}
+
+#endif
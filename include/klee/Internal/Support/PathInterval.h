@@ -0,0 +1,69 @@
+//===-- PathInterval.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PATHINTERVAL_H
+#define KLEE_PATHINTERVAL_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace klee {
+  /// PathInterval - A share of the paths of the program, all paths between
+  /// two bounds in lexicographic order.
+  ///
+  /// A path is the sequence of the sides taken at its forks, '0' or '1',
+  /// read as the binary fraction 0.b1b2..., so that the paths below a
+  /// prefix of k forks lie in [0.prefix, 0.prefix + 2^-k). The interval
+  /// holds the paths in [lower, upper); the bounds are bit strings of any
+  /// length, an empty upper bound is 1, past every path.
+  class PathInterval {
+    std::string lower, upper;
+
+  public:
+    /// All paths.
+    PathInterval() {}
+    PathInterval(const std::string &_lower, const std::string &_upper)
+      : lower(_lower), upper(_upper) {}
+
+    const std::string &getLower() const { return lower; }
+    const std::string &getUpper() const { return upper; }
+
+    bool isAll() const;
+
+    /// Whether some path below the prefix of forks is in the interval.
+    bool overlaps(const std::string &prefix) const;
+
+    /// Whether all paths below the prefix of forks are in the interval.
+    bool contains(const std::string &prefix) const;
+
+    /// Whether the path of forks is in the interval. A path which ends
+    /// belongs to the interval holding 0.path, so that of the intervals of
+    /// a split exactly one owns it, even if it overlaps several.
+    bool owns(const std::string &path) const;
+
+    /// The interval as "lower-upper".
+    std::string encode() const;
+
+    /// \return false if the size bytes at data are not an encoded interval.
+    static bool decode(const char *data, size_t size, PathInterval &out);
+
+    /// The forks of a branch history: the '0' and '1' of the branches which
+    /// forked, without the '2' and '3' of those which did not nor the '4'
+    /// of those whose sides merged again.
+    static std::string getForks(const std::vector<char> &history);
+
+    /// Split all paths into n intervals of the same size, in order. The
+    /// bounds have the bits of i/n, as many as it takes to tell the n
+    /// apart and 8 more, so they are balanced to within 1/256 of a share.
+    static void split(unsigned n, std::vector<PathInterval> &out);
+  };
+}
+
+#endif
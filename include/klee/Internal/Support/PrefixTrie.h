@@ -0,0 +1,65 @@
+//===-- PrefixTrie.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PREFIXTRIE_H
+#define KLEE_PREFIXTRIE_H
+
+#include "klee/util/Ref.h"
+
+#include <stddef.h>
+
+namespace klee {
+  /// PrefixTrie - The prefixes a state replays, as a position in a trie of
+  /// their branches ('0' to '4', see ExecutionState::branchHist).
+  ///
+  /// A trie holds the branches of the prefixes after the depth of the
+  /// state it was made for. Copies share the trie, a state advances by
+  /// stepping to the child of the branch it took, and the nodes no state
+  /// can reach any more are freed.
+  class PrefixTrie {
+  public:
+    enum { NumBranches = 5 };
+
+  private:
+    struct Node {
+      unsigned refCount;
+      ref<Node> children[NumBranches];
+      /// the prefixes ending in the subtree of the node
+      unsigned count;
+
+      Node() : refCount(0), count(0) {}
+      Node(const Node &n) : refCount(0), count(n.count) {
+        for (unsigned i = 0; i < NumBranches; i++)
+          children[i] = n.children[i];
+      }
+    };
+
+    ref<Node> node;
+
+  public:
+    /// Add the branches of a prefix after depth, the branches before it are
+    /// the ones the position was reached by.
+    void add(const char *branches, size_t length, size_t depth);
+
+    /// The number of prefixes.
+    unsigned size() const { return node.isNull() ? 0 : node->count; }
+
+    /// Whether a prefix goes on after the position.
+    bool hasNext() const;
+    /// Whether a prefix goes on with branch.
+    bool hasNext(char branch) const;
+
+    /// Step to the prefixes going on with branch.
+    void advance(char branch);
+
+    void clear() { node = 0; }
+  };
+}
+
+#endif
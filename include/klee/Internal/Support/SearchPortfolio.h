@@ -0,0 +1,63 @@
+//===-- SearchPortfolio.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SEARCHPORTFOLIO_H
+#define KLEE_SEARCHPORTFOLIO_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace klee {
+  /// SearchPortfolio - Assigns the search heuristics of a mix to the tasks
+  /// the master hands to the workers.
+  ///
+  /// Every heuristic gets a share of the busy workers proportional to the
+  /// instructions covered per heartbeat by the workers running it, so that
+  /// the mix drifts towards the heuristics which cover the most. Heuristics
+  /// without measurements count as the best one, and no heuristic drops
+  /// below MinShareFactor of the best one.
+  class SearchPortfolio {
+    std::vector<std::string> heuristics;
+    /// the heuristic of every rank, or -1 if it runs none
+    std::vector<int> assigned;
+    /// the covered instructions and heartbeats reported under every
+    /// heuristic
+    std::vector<uint64_t> covered, samples;
+
+    double getWeight(unsigned heuristic) const;
+
+  public:
+    static const double MinShareFactor;
+
+    SearchPortfolio(const std::vector<std::string> &heuristics,
+                    unsigned numRanks);
+
+    bool empty() const { return heuristics.empty(); }
+
+    /// Pick the heuristic of the next task of rank.
+    const std::string &assign(unsigned rank);
+    /// The rank finished its task.
+    void release(unsigned rank);
+    /// Move rank on to the heuristic after the one it runs, to diversify
+    /// the search once the coverage stalls. A rank running none gets one
+    /// as by assign.
+    const std::string &rotate(unsigned rank);
+    /// A heartbeat of rank reported newly covered instructions.
+    void recordCoverage(unsigned rank, unsigned newlyCovered);
+
+    /// The instructions covered per heartbeat under heuristic, 0 if no
+    /// heartbeat was reported.
+    double getRate(unsigned heuristic) const;
+    /// The index of the heuristic rank runs, or -1.
+    int getAssigned(unsigned rank) const;
+  };
+}
+
+#endif
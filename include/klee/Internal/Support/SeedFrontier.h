@@ -0,0 +1,66 @@
+//===-- SeedFrontier.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SEEDFRONTIER_H
+#define KLEE_SEEDFRONTIER_H
+
+#include <string>
+#include <vector>
+
+namespace klee {
+  /// SeedFrontier - The work left after several workers each explored the
+  /// tree from its root along their own seeds.
+  ///
+  /// A frontier is the branch histories of the states a worker did not
+  /// finish, it finished every path not under one of them. The paths left
+  /// are then the ones under the frontiers of all workers, and they are
+  /// kept as the prefixes which cover them, none under another one, so
+  /// that every path is handed out once.
+  class SeedFrontier {
+    /// sorted, none is a prefix of another
+    std::vector<std::string> prefixes;
+    bool started;
+
+    /// Whether one of the sorted prefixes is a prefix of path.
+    static bool covers(const std::vector<std::string> &sorted,
+                       const std::string &path);
+
+  public:
+    SeedFrontier() : started(false) {}
+
+    /// Add the frontier of a worker.
+    void add(std::vector<std::string> frontier);
+
+    /// The prefixes of the paths under every frontier added, sorted.
+    const std::vector<std::string> &getPrefixes() const { return prefixes; }
+  };
+
+  /// GenerationFrontier - The work left after several workers each ran
+  /// their own seeds along a single path (see --generational-seeds).
+  ///
+  /// A worker hands back the branches its seeds did not take and the
+  /// paths they finished. The paths left are the ones under any of those
+  /// branches, except the paths the seeds of another worker finished: a
+  /// branch which such a path goes through is replaced by the branches
+  /// that path did not take below it.
+  class GenerationFrontier {
+    std::vector<std::string> branches;
+    std::vector<std::string> finished;
+
+  public:
+    /// Add the branches not taken and the paths finished by a worker.
+    void add(const std::vector<std::string> &notTaken,
+             const std::vector<std::string> &paths);
+
+    /// The prefixes of the paths left, sorted, none under another one.
+    std::vector<std::string> getPrefixes() const;
+  };
+}
+
+#endif
@@ -0,0 +1,120 @@
+//===-- ShmMPI.h ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The part of the MPI interface klee uses, for the ranks of a single node
+// without an MPI library (cmake -DENABLE_SHM_TRANSPORT=ON, which puts the
+// mpi.h next to this header first on the include path).
+//
+// MPI_Init forks the ranks, KLEE_RANKS of them (default: the online CPUs,
+// at least 2). The process started is rank 0 and waits for the others in
+// MPI_Finalize. The messages go through a ring buffer in shared memory for
+// every pair of ranks, sends of any size complete at once, and a rank
+// waiting for room in a ring takes in the messages sent to it meanwhile,
+// so two ranks sending to each other do not block.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SHMMPI_H
+#define KLEE_SHMMPI_H
+
+typedef int MPI_Comm;
+typedef int MPI_Datatype;
+typedef int MPI_Errhandler;
+typedef int MPI_Info;
+/// a send completes at once, a request only tells that there was one
+typedef int MPI_Request;
+
+typedef struct {
+  int MPI_SOURCE;
+  int MPI_TAG;
+  int MPI_ERROR;
+  /// the bytes received
+  int count;
+} MPI_Status;
+
+#define MPI_SUCCESS 0
+#define MPI_ERR_OTHER 15
+
+#define MPI_COMM_WORLD ((MPI_Comm) 0)
+#define MPI_COMM_NULL ((MPI_Comm) -1)
+#define MPI_ANY_SOURCE (-1)
+#define MPI_ANY_TAG (-1)
+#define MPI_UNDEFINED (-32766)
+#define MPI_STATUS_IGNORE ((MPI_Status *) 0)
+#define MPI_STATUSES_IGNORE ((MPI_Status *) 0)
+#define MPI_REQUEST_NULL ((MPI_Request) 0)
+#define MPI_INFO_NULL ((MPI_Info) 0)
+#define MPI_ERRORS_ARE_FATAL ((MPI_Errhandler) 0)
+#define MPI_ERRORS_RETURN ((MPI_Errhandler) 1)
+#define MPI_COMM_TYPE_SHARED 1
+
+#define MPI_THREAD_SINGLE 0
+#define MPI_THREAD_FUNNELED 1
+#define MPI_THREAD_SERIALIZED 2
+#define MPI_THREAD_MULTIPLE 3
+
+/// a datatype is the size of its elements
+#define MPI_CHAR ((MPI_Datatype) sizeof(char))
+#define MPI_BYTE ((MPI_Datatype) 1)
+#define MPI_INT ((MPI_Datatype) sizeof(int))
+#define MPI_UNSIGNED ((MPI_Datatype) sizeof(unsigned))
+#define MPI_LONG ((MPI_Datatype) sizeof(long))
+#define MPI_UNSIGNED_LONG ((MPI_Datatype) sizeof(unsigned long))
+#define MPI_LONG_LONG ((MPI_Datatype) sizeof(long long))
+#define MPI_UINT64_T ((MPI_Datatype) 8)
+#define MPI_DOUBLE ((MPI_Datatype) sizeof(double))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int MPI_Init(int *argc, char ***argv);
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided);
+int MPI_Initialized(int *flag);
+int MPI_Query_thread(int *provided);
+int MPI_Finalize(void);
+int MPI_Abort(MPI_Comm comm, int errorcode);
+
+int MPI_Comm_rank(MPI_Comm comm, int *rank);
+int MPI_Comm_size(MPI_Comm comm, int *size);
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm);
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info,
+                        MPI_Comm *newcomm);
+int MPI_Comm_free(MPI_Comm *comm);
+int MPI_Comm_set_errhandler(MPI_Comm comm, MPI_Errhandler errhandler);
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest,
+             int tag, MPI_Comm comm);
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest,
+              int tag, MPI_Comm comm, MPI_Request *request);
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source,
+             int tag, MPI_Comm comm, MPI_Status *status);
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status);
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag,
+               MPI_Status *status);
+int MPI_Get_count(const MPI_Status *status, MPI_Datatype datatype,
+                  int *count);
+
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status);
+int MPI_Testall(int count, MPI_Request requests[], int *flag,
+                MPI_Status statuses[]);
+int MPI_Wait(MPI_Request *request, MPI_Status *status);
+int MPI_Request_free(MPI_Request *request);
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root,
+              MPI_Comm comm);
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                  void *recvbuf, int recvcount, MPI_Datatype recvtype,
+                  MPI_Comm comm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+//===-- SubtreeEstimator.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SUBTREEESTIMATOR_H
+#define KLEE_SUBTREEESTIMATOR_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace klee {
+  /// SubtreeEstimator - Estimates the size of the subtree left below a node
+  /// of the execution tree from the fork rates measured at every depth.
+  ///
+  /// Every node either forks into two children or ends its path. The rate
+  /// r(d) is the mean number of children of the nodes at depth d decided so
+  /// far, and the subtree below a node at depth d is estimated as
+  /// 1 + r(d) + r(d) r(d+1) + ..., Knuth's estimator with the random probes
+  /// replaced by the measured rates. The sum ends at the first depth without
+  /// any decided node.
+  class SubtreeEstimator {
+    /// decided nodes and their children at every depth
+    std::vector<uint64_t> nodes, children;
+    /// estimates of every depth, recomputed after new measurements
+    mutable std::vector<double> estimates;
+    mutable bool stale;
+
+  public:
+    /// estimates are capped, deep trees with rates above one overflow
+    static const double MaxEstimate;
+
+    SubtreeEstimator() : stale(false) {}
+
+    /// A node at depth forked into two children.
+    void recordFork(unsigned depth);
+    /// A path ended at a node at depth.
+    void recordLeaf(unsigned depth);
+
+    /// The measured fork rate at depth, 0 if no node there was decided.
+    double getRate(unsigned depth) const;
+
+    /// The estimated number of nodes of the subtree below a node at depth,
+    /// the node included.
+    double estimate(unsigned depth) const;
+  };
+}
+
+#endif
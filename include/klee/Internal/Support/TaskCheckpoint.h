@@ -0,0 +1,61 @@
+//===-- TaskCheckpoint.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_TASKCHECKPOINT_H
+#define KLEE_TASKCHECKPOINT_H
+
+#include <string>
+#include <vector>
+
+namespace klee {
+  /// TaskCheckpoint - The tasks the workers are running, from which the
+  /// coordinator saves the work a run has left so that it can be restarted.
+  ///
+  /// A task is the message which started it, a prefix or a packet of
+  /// states, with its tag. Running tasks are saved as they were handed out,
+  /// so a restart redoes them from their start; a thief is charged with the
+  /// task of the worker it stole from, which covers the stolen subtree.
+  class TaskCheckpoint {
+  public:
+    struct Task {
+      int tag;
+      std::string data;
+
+      Task() : tag(-1) {}
+      Task(int _tag, const std::string &_data) : tag(_tag), data(_data) {}
+    };
+
+  private:
+    /// the task of every rank, tag -1 if none
+    std::vector<Task> running;
+
+  public:
+    TaskCheckpoint(unsigned numRanks) : running(numRanks) {}
+
+    void start(unsigned rank, int tag, const std::string &data);
+    /// thief stole part of the task of victim.
+    void steal(unsigned thief, unsigned victim);
+    void finish(unsigned rank);
+
+    /// The task of rank, tag -1 if none.
+    const Task &getTask(unsigned rank) const { return running[rank]; }
+    unsigned getNumRunning() const;
+
+    /// Write the queued tasks followed by the running ones, replacing the
+    /// file at path only once it is complete.
+    bool write(const std::string &path, const std::vector<Task> &queued,
+               std::string &error) const;
+
+    /// Read the tasks of a checkpoint written by write().
+    static bool read(const std::string &path, std::vector<Task> &tasks,
+                     std::string &error);
+  };
+}
+
+#endif
@@ -0,0 +1,61 @@
+//===-- WorkTree.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_WORKTREE_H
+#define KLEE_WORKTREE_H
+
+#include <string>
+#include <vector>
+
+namespace klee {
+  class RNG;
+
+  /// WorkTree - The tree of the prefixes the master has not handed out yet,
+  /// from which the next one is picked by a random path from the root.
+  ///
+  /// Like the random-path searcher, every branch with outstanding work
+  /// below it is taken with the same probability, so that no subtree is
+  /// favoured for holding many prefixes. Prefixes are branch histories,
+  /// '0' and '2' go left, '1' and '3' go right and anything else is
+  /// skipped.
+  class WorkTree {
+    struct Node {
+      Node *children[2];
+      /// the prefixes ending here
+      std::vector<unsigned> ids;
+      /// the prefixes in the subtree
+      unsigned count;
+
+      Node() : count(0) { children[0] = children[1] = 0; }
+    };
+
+    Node *root;
+
+    static void destroy(Node *node);
+
+  public:
+    WorkTree() : root(new Node()) {}
+    ~WorkTree() { destroy(root); }
+
+    bool empty() const { return root->count == 0; }
+    unsigned size() const { return root->count; }
+
+    /// Add the prefix path under id.
+    void add(const std::string &path, unsigned id);
+
+    /// Remove a prefix picked by a random path and return its id.
+    unsigned takeRandomPath(RNG &rng);
+
+  private:
+    WorkTree(const WorkTree &);
+    void operator=(const WorkTree &);
+  };
+}
+
+#endif
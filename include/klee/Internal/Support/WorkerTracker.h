@@ -0,0 +1,171 @@
+//===-- WorkerTracker.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_WORKERTRACKER_H
+#define KLEE_WORKERTRACKER_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace klee {
+  /// WorkerTracker - The coordinator's view of the workers.
+  ///
+  /// Every worker is idle or busy. Busy workers may have announced that
+  /// they can give work away (ready) and may have an offload request in
+  /// flight. Idle workers and ready workers without a request are kept in
+  /// FIFO queues threaded through per-rank arrays, so every update is O(1).
+  /// Workers which died or were never used are lost and no longer count.
+  ///
+  /// The prefixes handed to the workers are kept in a binary trie, so that
+  /// a prefix can go to the idle worker holding the states suspended
+  /// nearest to it.
+  ///
+  /// Ranks on the same node (shared memory) are cheaper to move work
+  /// between, so donors and receivers are paired within a node first.
+  class WorkerTracker {
+    /// Intrusive FIFO of ranks.
+    class RankQueue {
+      std::vector<int> prev, next;
+      std::vector<bool> queued;
+      int head, tail;
+      unsigned count;
+
+    public:
+      RankQueue(unsigned numRanks);
+
+      void push(unsigned rank);
+      void remove(unsigned rank);
+      bool contains(unsigned rank) const { return queued[rank]; }
+      bool empty() const { return count == 0; }
+      unsigned size() const { return count; }
+      unsigned front() const { return head; }
+      /// The rank queued after rank, -1 for the last one.
+      int after(unsigned rank) const { return next[rank]; }
+    };
+
+    unsigned firstWorker;
+    std::vector<bool> busy, ready, offloadActive, lost;
+    unsigned numLost;
+    /// the remaining work the workers last reported, 0 if unknown
+    std::vector<unsigned> workEstimate;
+    /// the distance of the state nearest to an --error-location target the
+    /// workers last reported, 0 if none
+    std::vector<unsigned> targetDistance;
+    /// the node of every rank, all on one node unless told otherwise
+    std::vector<unsigned> node;
+    /// a donor on the node of an idle worker is taken before any other
+    /// one if it has at least this much work left
+    unsigned minLocalWork;
+    RankQueue idleQueue, readyQueue;
+
+    /// Node of the trie of the prefixes handed out, with the workers whose
+    /// prefixes pass through it.
+    struct PathNode {
+      int children[2];
+      std::vector<unsigned> ranks;
+
+      PathNode() { children[0] = children[1] = -1; }
+    };
+    /// the root is pathNodes[0]
+    std::vector<PathNode> pathNodes;
+
+    /// Whether donor a goes before donor b: the nearer to a target, then
+    /// the one with more work left.
+    bool isBetterDonor(unsigned a, unsigned b) const;
+
+  public:
+    /// Workers are the ranks in [firstWorker, numRanks), all idle.
+    WorkerTracker(unsigned firstWorker, unsigned numRanks);
+
+    unsigned getNumWorkers() const {
+      return busy.size() - firstWorker - numLost;
+    }
+    unsigned getNumIdle() const { return idleQueue.size(); }
+    bool allIdle() const { return getNumIdle() == getNumWorkers(); }
+    bool isBusy(unsigned rank) const { return busy[rank]; }
+    bool isReady(unsigned rank) const { return ready[rank]; }
+    bool isOffloadActive(unsigned rank) const { return offloadActive[rank]; }
+    bool isLost(unsigned rank) const { return lost[rank]; }
+    /// Returns true if some ready worker has no offload request in flight.
+    bool hasDonor() const { return !readyQueue.empty(); }
+
+    /// The worker was handed a task.
+    void markBusy(unsigned rank);
+
+    /// The worker finished all its work (FINISH), which also withdraws its
+    /// ready announcement.
+    ///
+    /// \return true if an offload request to it was still in flight.
+    bool markIdle(unsigned rank);
+
+    /// The worker is gone for good, its messages are to be ignored.
+    ///
+    /// \return true if an offload request to it was still in flight.
+    bool markLost(unsigned rank);
+
+    /// A lost worker which was held in standby joins the run, idle.
+    void markJoined(unsigned rank);
+
+    /// The worker can (READY_TO_OFFLOAD) or can no longer
+    /// (NOT_READY_TO_OFFLOAD) give work away.
+    void markReady(unsigned rank);
+    void markNotReady(unsigned rank);
+
+    /// Take the idle worker that has waited the longest.
+    ///
+    /// \return false if no worker is idle.
+    bool popIdle(unsigned &rank);
+
+    /// Take the idle worker whose prefixes share the longest beginning
+    /// with prefix, the one idle the longest among equals. Replaying the
+    /// prefix there only costs the branches past the divergence.
+    ///
+    /// \return false if no worker is idle.
+    bool popIdleNearest(const char *prefix, size_t size, unsigned &rank);
+
+    /// The worker was handed prefix, a branch history ('0'-'3' per branch),
+    /// and keeps the states suspended beside its path.
+    void addPrefix(unsigned rank, const char *prefix, size_t size);
+
+    /// The worker estimates it has work nodes left to explore.
+    void setWorkEstimate(unsigned rank, unsigned work);
+    unsigned getWorkEstimate(unsigned rank) const { return workEstimate[rank]; }
+
+    /// The nearest state of the worker is distance instructions from a
+    /// target, 0 if it has none which can reach one.
+    void setTargetDistance(unsigned rank, unsigned distance) {
+      targetDistance[rank] = distance;
+    }
+
+    /// The rank runs on the given node, e.g. the lowest rank of its shared
+    /// memory group.
+    void setNode(unsigned rank, unsigned nodeId) { node[rank] = nodeId; }
+    unsigned getNode(unsigned rank) const { return node[rank]; }
+    void setMinLocalWork(unsigned work) { minLocalWork = work; }
+
+    /// Pick the ready worker nearest to a target, else with the most
+    /// estimated work left, and no offload request in flight, the one ready
+    /// the longest among equals, and record a request to it. Donors on the
+    /// node of an idle worker with at least minLocalWork left go first.
+    ///
+    /// \return false if there is none.
+    bool pickDonor(unsigned &rank);
+
+    /// Take the idle worker for the work of donor: the one idle the longest
+    /// on the node of the donor, else the one idle the longest.
+    ///
+    /// \return false if no worker is idle.
+    bool popIdleNear(unsigned donor, unsigned &rank);
+
+    /// The donor answered its offload request (OFFLOAD_RESP).
+    void offloadDone(unsigned rank);
+  };
+}
+
+#endif
@@ -0,0 +1,49 @@
+//===-- WrittenRanges.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_WRITTENRANGES_H
+#define KLEE_WRITTENRANGES_H
+
+#include <map>
+#include <stdint.h>
+
+namespace klee {
+  /// WrittenRanges - The bytes a normal state overwrote in dependent mode,
+  /// each with the snapshot index (epoch) of its last write.
+  ///
+  /// The ranges are disjoint, and adjacent ranges of the same epoch are
+  /// merged, so that a buffer written byte by byte is a single range and a
+  /// query only visits the ranges it overlaps. A write replaces the epoch
+  /// of the bytes it covers.
+  class WrittenRanges {
+    struct Range {
+      uint64_t end;
+      unsigned epoch;
+
+      Range() : end(0), epoch(0) {}
+      Range(uint64_t _end, unsigned _epoch) : end(_end), epoch(_epoch) {}
+    };
+
+    /// by their first byte
+    std::map<uint64_t, Range> ranges;
+
+  public:
+    void add(uint64_t address, uint64_t size, unsigned epoch);
+
+    /// Whether all bytes of [address, address + size) were written, then
+    /// epoch is the earliest epoch among them.
+    bool covers(uint64_t address, uint64_t size, unsigned &epoch) const;
+
+    bool empty() const { return ranges.empty(); }
+    /// The number of ranges after merging.
+    unsigned size() const { return ranges.size(); }
+  };
+}
+
+#endif
@@ -0,0 +1,14 @@
+//===-- mpi.h ---------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Found before the mpi.h of an MPI library with -DENABLE_SHM_TRANSPORT=ON.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/ShmMPI.h"
@@ -10,11 +10,85 @@
 #ifndef KLEE_UTIL_MEMORYUSAGE_H
 #define KLEE_UTIL_MEMORYUSAGE_H
 
+#include "klee/Config/config.h"
+
 #include <cstddef>
+#include <new>
+#include <stdint.h>
+#ifdef KLEE_ATOMIC_REFCOUNT
+#include <atomic>
+#endif
 
 namespace klee {
   namespace util {
     size_t GetTotalMallocUsage();
+
+    /// The structures whose memory is accounted apart from the malloc
+    /// total, so that the memory cap can tell what is taking it.
+    enum MemoryCategory {
+      /// the expression and update nodes
+      ExprMemory,
+      /// the object states, their contents and chunks
+      ObjectMemory,
+      /// the chunks of the constraint managers
+      ConstraintMemory,
+      /// the snapshots and the states they hold
+      SnapshotMemory,
+      /// the entries of the query and counterexample caches
+      SolverCacheMemory,
+      /// the nodes of the process tree
+      PTreeMemory,
+      /// the nodes of the tree of suspended prefixes
+      PrefixTreeMemory,
+      NumMemoryCategories
+    };
+
+    /* plain counters in the headers, the expression library accounts its
+       nodes without the support library, during static initialization too;
+       relaxed atomics when threads share the expressions */
+#ifdef KLEE_ATOMIC_REFCOUNT
+    typedef std::atomic<int64_t> MemoryCounter;
+#else
+    typedef int64_t MemoryCounter;
+#endif
+    inline MemoryCounter *getMemoryCounters() {
+      static MemoryCounter counters[NumMemoryCategories];
+      return counters;
+    }
+
+    inline void AccountMemory(MemoryCategory category, int64_t bytes) {
+#ifdef KLEE_ATOMIC_REFCOUNT
+      getMemoryCounters()[category].fetch_add(bytes,
+                                              std::memory_order_relaxed);
+#else
+      getMemoryCounters()[category] += bytes;
+#endif
+    }
+
+    /// The bytes currently accounted to the category.
+    inline size_t GetMemoryUsage(MemoryCategory category) {
+      int64_t bytes = getMemoryCounters()[category];
+      return bytes > 0 ? (size_t) bytes : 0;
+    }
+
+    const char *GetMemoryCategoryName(MemoryCategory category);
+
+    /// The category holding the most bytes.
+    MemoryCategory GetLargestMemoryCategory();
+
+    /// MemoryAccounted - A base accounting the objects of a class allocated
+    /// with new to a category.
+    template <MemoryCategory Category>
+    struct MemoryAccounted {
+      static void *operator new(size_t size) {
+        AccountMemory(Category, size);
+        return ::operator new(size);
+      }
+      static void operator delete(void *p, size_t size) {
+        AccountMemory(Category, -(int64_t) size);
+        ::operator delete(p);
+      }
+    };
   }
 }
 
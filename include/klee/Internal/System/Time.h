@@ -21,6 +21,10 @@ namespace klee {
     /// Wall time in seconds.
     double getWallTime();
 
+    /// Monotonic time in seconds, from a coarse clock which is cheap to
+    /// read. Only differences of it are meaningful.
+    double getMonotonicTime();
+
     /// Wall time as TimeValue object.
     llvm::sys::TimeValue getWallTimeVal();
   }
@@ -14,6 +14,7 @@
 #include <map>
 #include <set>
 #include <deque>
+#include <stdint.h>
 #include "klee/Internal/Analysis/ModRefAnalysis.h"
 #include "klee/Internal/Analysis/Annotator.h"
 
@@ -66,12 +67,20 @@ public:
     bool Optimize;
     bool CheckDivZero;
     bool CheckOvershift;
+    /// The module was transformed and linked by an earlier run, the
+    /// transformation passes are not run again.
+    bool Prepared;
+    /// If not empty, the transformed module is written to this file.
+    std::string CacheFile;
+    /// Find the loops of the functions, for the loop budgets.
+    bool FindLoops;
 
     ModuleOptions(const std::string &_LibraryDir,
                   const std::string &_EntryPoint, bool _Optimize,
                   bool _CheckDivZero, bool _CheckOvershift)
         : LibraryDir(_LibraryDir), EntryPoint(_EntryPoint), Optimize(_Optimize),
-          CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift) {}
+          CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift),
+          Prepared(false), FindLoops(false) {}
   };
 
   enum LogType
@@ -115,10 +124,16 @@ public:
     std::vector<std::string> inlinedFunctions;
     ErrorLocations errorLocations;
     unsigned int maxErrorCount;
+    /// Answer the offload requests of the master from a separate thread,
+    /// MPI has to be initialized with MPI_THREAD_MULTIPLE.
+    bool offloadProgressThread;
+    /// The node of every MPI rank, ranks of a node share memory.
+    std::vector<unsigned> rankNodes;
 
     InterpreterOptions() : 
       MakeConcreteSymbolic(false),
-      maxErrorCount(0)
+      maxErrorCount(0),
+      offloadProgressThread(false)
     {
 
     }
@@ -172,6 +187,14 @@ public:
                                  char **envp,
                                  bool branchLevelHalt=false) = 0;
 
+  /// The estimated subtree size of every prefix runFunctionAsMain2
+  /// returned, in the same order.
+  virtual void getWorkListEstimates(std::vector<double> &estimates) = 0;
+
+  /// The distance of every prefix runFunctionAsMain2 returned to the
+  /// nearest --error-location target, 0 if it can reach none.
+  virtual void getWorkListDistances(std::vector<uint64_t> &distances) = 0;
+
   virtual char** runFunctionAsMain2(llvm::Function *f,
                                   int argc,
                                   char **argv,
@@ -189,6 +212,30 @@ public:
   virtual void setLogFile(std::string inLogFile) = 0;
   virtual void enableLoadBalancing(bool inLB) = 0;
   virtual void setTestPrefixDepth(unsigned inPD) = 0;
+  /// Start from serialized states received from another worker instead of
+  /// the initial state (see --offload-state-snapshots).
+  virtual void setStartStates(const char *packet, unsigned size) = 0;
+  /// Grow the frontier of a replayed prefix until explorationDepth states
+  /// exist and hand them back from runFunctionAsMain2, like the coordinator
+  /// does in phase 1 (see --phase1-split).
+  virtual void enableSplitting() = 0;
+  /// With seeds and enableSplitting, run the seeds without solver queries
+  /// at the branches they agree on and stop once they are done. The
+  /// branches they did not take are handed back from runFunctionAsMain2
+  /// with the states left (see --generational-seeds).
+  virtual void enableGenerations() = 0;
+  /// The branch histories of the paths the seeds finished.
+  virtual void getSeedPaths(std::vector<std::string> &paths) = 0;
+  /// Let idle workers steal prefixes from random peers (see --work-stealing).
+  virtual void enableWorkStealing(bool inStealing) = 0;
+  /// Start without any state and steal the first work from a peer.
+  virtual void setStartIdle() = 0;
+  /// Explore only the paths of the PathInterval encoded in data (see
+  /// --path-intervals).
+  virtual void setPathRange(const char *data, unsigned size) = 0;
+  /// DEFAULT uses fixed offload thresholds, ADAPTIVE sizes them from the
+  /// measured path rate and the number of idle workers.
+  virtual void setOffloadPolicy(std::string inOffloadPolicy) = 0;
 
   /*** Runtime options ***/
 
@@ -0,0 +1,107 @@
+//===-- SharedSolverCache.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SHAREDSOLVERCACHE_H
+#define KLEE_SHAREDSOLVERCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace klee {
+
+/// SharedSolverCache - Counterexample results which are exchanged between
+/// processes solving queries over the same program.
+///
+/// Entries are keyed by the QueryHasher hash of the query (constraints,
+/// query expression and the requested arrays), so they do not depend on the
+/// expressions of the process that solved them. The cache only stores and
+/// encodes the entries; moving the packets between processes is left to
+/// the owner.
+///
+/// The cache also holds seeds: solutions of the path constraints of states
+/// received from another process, which are tried before the solver while
+/// the states replay their prefixes.
+class SharedSolverCache {
+public:
+  typedef std::pair<uint64_t, uint64_t> Key;
+
+  struct Entry {
+    bool hasSolution;
+    std::vector< std::vector<unsigned char> > values;
+  };
+
+  /// array name -> contents
+  typedef std::map<std::string, std::vector<unsigned char> > Seed;
+
+private:
+  std::map<Key, Entry> entries;
+  /// entries solved by this process since the last takeOutgoing
+  std::vector<Key> outgoing;
+  unsigned maxEntries;
+  bool publish;
+  /// the latest seeds, oldest first
+  std::deque<Seed> seeds;
+
+public:
+  SharedSolverCache(unsigned _maxEntries, bool _publish = true)
+      : maxEntries(_maxEntries), publish(_publish) {}
+
+  bool lookup(const Key &key, Entry &entry) const;
+
+  /// Record an entry solved by this process, to be published unless
+  /// publishing is disabled.
+  void insert(const Key &key, const Entry &entry);
+
+  /// Append a packet with the entries recorded since the last call to out.
+  ///
+  /// \return false if there was nothing to publish.
+  bool takeOutgoing(std::vector<char> &out);
+
+  /// Add the entries of a packet written by takeOutgoing in another process.
+  ///
+  /// \return false if the packet is malformed.
+  bool addPacket(const char *buffer, size_t size);
+
+  size_t size() const { return entries.size(); }
+
+  /// Add the entries of a cache file written by appendToFile for the
+  /// program of the given hash, which is memory-mapped while it is read.
+  /// A record cut short, by a crash while appending, ends the file.
+  ///
+  /// \return false if the file can not be read or is for another program.
+  bool loadFile(const std::string &path, uint64_t programHash);
+
+  /// Append a packet written by takeOutgoing to the cache file at path,
+  /// under a lock against the other processes appending to it. A missing
+  /// file, or one for another program, is started anew.
+  static bool appendToFile(const std::string &path, uint64_t programHash,
+                           const std::vector<char> &packet);
+
+  void addSeed(const Seed &seed);
+
+  const std::deque<Seed> &getSeeds() const { return seeds; }
+
+  /// Append a section holding the given seeds to out.
+  static void encodeSeeds(const std::vector<Seed> &seeds,
+                          std::vector<char> &out);
+
+  /// Read a section written by encodeSeeds at the start of buffer.
+  ///
+  /// \return the size of the section, or 0 if buffer does not start with a
+  /// well-formed one.
+  static size_t decodeSeeds(const char *buffer, size_t size,
+                            std::vector<Seed> &out);
+};
+}
+
+#endif
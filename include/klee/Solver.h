@@ -18,6 +18,7 @@
 namespace klee {
   class ConstraintManager;
   class Expr;
+  class SharedSolverCache;
   class SolverImpl;
 
   struct Query {
@@ -289,6 +290,13 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createFastCexSolver(Solver *s);
 
+  /// createKnownBitsSolver - Create a solver which tries to answer truth and
+  /// validity queries by evaluating them over known bits and intervals,
+  /// after narrowing the subexpressions bounded by the constraints.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createKnownBitsSolver(Solver *s);
+
   /// createIndependentSolver - Create a solver which will eliminate any
   /// unnecessary constraints before propogating the query to the underlying
   /// solver.
@@ -296,6 +304,23 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createIndependentSolver(Solver *s);
   
+  /// createSharedCacheSolver - Create a solver which answers counterexample
+  /// queries from a cache shared with other processes, and records the
+  /// results computed by the underlying solver in it.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param cache - The cache to use, owned by the caller.
+  Solver *createSharedCacheSolver(Solver *s, SharedSolverCache &cache);
+
+  /// createPortfolioSolver - Create a solver which races the given core
+  /// solvers on slow queries and routes each query shape to the solver which
+  /// usually wins on it.
+  ///
+  /// \param solvers - The core solvers to use, owned by the new solver.
+  /// \param names - The names of the solvers, for the messages.
+  Solver *createPortfolioSolver(const std::vector<Solver *> &solvers,
+                                const std::vector<std::string> &names);
+
   /// createKQueryLoggingSolver - Create a solver which will forward all queries
   /// after writing them to the given path in .kquery format.
   Solver *createKQueryLoggingSolver(Solver *s, std::string path,
@@ -306,6 +331,12 @@ namespace klee {
   Solver *createSMTLIBLoggingSolver(Solver *s, std::string path,
                                     int minQueryTimeToLog);
 
+  /// createBinaryQueryLoggingSolver - Create a solver which will forward all
+  /// queries after writing them to the given path in the binary query log
+  /// format, see BinaryQueryLog.h.
+  Solver *createBinaryQueryLoggingSolver(Solver *s, std::string path,
+                                         int minQueryTimeToLog);
+
 
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
@@ -313,6 +344,14 @@ namespace klee {
 
   // Create a solver based on the supplied ``CoreSolverType``.
   Solver *createCoreSolver(CoreSolverType cst);
+
+  /// setSolverInterruptCheck - While a query runs in the solver process
+  /// (--forked-solver-server), check is called about every 100ms; if it
+  /// returns true the query is abandoned and fails. Null turns it off.
+  void setSolverInterruptCheck(bool (*check)());
+
+  /// getSolverInterruptCheck - The check set by setSolverInterruptCheck.
+  bool (*getSolverInterruptCheck())();
 }
 
 #endif
@@ -23,10 +23,22 @@ namespace stats {
   extern Statistic queryCacheMisses;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
+  extern Statistic queryCexCacheEvictions;
+  /// The queries the known bits solver answered, and those it passed on.
+  extern Statistic queryKnownBitsHits;
+  extern Statistic queryKnownBitsMisses;
+  extern Statistic querySharedCacheHits;
+  extern Statistic querySharedCacheMisses;
+  extern Statistic queryPortfolioRaces;
+  extern Statistic queryPortfolioRouted;
   extern Statistic queryConstructTime;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
   extern Statistic queryTime;
+  /// The queries cut off by the short timeout of --adaptive-solver-timeout,
+  /// and the retries with a longer one.
+  extern Statistic queryTimeouts;
+  extern Statistic queryEscalations;
   
 #ifdef DEBUG
   extern Statistic arrayHashTime;
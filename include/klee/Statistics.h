@@ -12,6 +12,8 @@
 
 #include "Statistic.h"
 
+#include <atomic>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <string.h>
@@ -37,11 +39,40 @@ namespace klee {
     StatisticRecord &operator +=(const StatisticRecord &sr);
   };
 
+  /// StatisticSlot - The global values a thread added to the statistics.
+  ///
+  /// Only its thread writes a slot, so it adds with a relaxed load and
+  /// store instead of a locked add, and the padding keeps the slots of two
+  /// threads off a common cache line.
+  struct StatisticSlot {
+    enum { MaxStatistics = 256 };
+
+    char padBefore[64];
+    std::atomic<uint64_t> values[MaxStatistics];
+    char padAfter[64];
+
+    StatisticSlot();
+  };
+
+  /// The slot of the running thread, null until it adds to a statistic.
+  extern thread_local StatisticSlot *threadStatisticSlot;
+
   class StatisticManager {
+  public:
+    enum { MaxThreads = 256 };
+
   private:
     bool enabled;
     std::vector<Statistic*> stats;
-    uint64_t *globalStats;
+    /// The slots of all threads so far, the global value of a statistic is
+    /// their sum. A slot lives on after its thread for the next one.
+    std::atomic<StatisticSlot*> slots[MaxThreads];
+    std::atomic<unsigned> numSlots;
+    std::vector<StatisticSlot*> freeSlots;
+    std::mutex slotLock;
+    /// The indexed and context statistics are only kept for the thread
+    /// which called useIndexedStats, the one running the states.
+    StatisticSlot *indexedSlot;
     uint64_t *indexedStats;
     StatisticRecord *contextStats;
     unsigned index;
@@ -61,6 +92,10 @@ namespace klee {
     Statistic &getStatistic(unsigned i) { return *stats[i]; }
     
     void registerStatistic(Statistic &s);
+    /// Give the running thread its slot.
+    StatisticSlot *acquireSlot();
+    /// Take back the slot of an exiting thread.
+    void releaseSlot(StatisticSlot *slot);
     void incrementStatistic(Statistic &s, uint64_t addend);
     uint64_t getValue(const Statistic &s) const;
     void incrementIndexedValue(const Statistic &s, unsigned index, 
@@ -76,8 +111,13 @@ namespace klee {
   inline void StatisticManager::incrementStatistic(Statistic &s, 
                                                    uint64_t addend) {
     if (enabled) {
-      globalStats[s.id] += addend;
-      if (indexedStats) {
+      StatisticSlot *slot = threadStatisticSlot;
+      if (!slot)
+        slot = acquireSlot();
+      std::atomic<uint64_t> &value = slot->values[s.id];
+      value.store(value.load(std::memory_order_relaxed) + addend,
+                  std::memory_order_relaxed);
+      if (indexedStats && slot == indexedSlot) {
         indexedStats[index*stats.size() + s.id] += addend;
         if (contextStats)
           contextStats->data[s.id] += addend;
@@ -130,7 +170,12 @@ namespace klee {
   }
 
   inline uint64_t StatisticManager::getValue(const Statistic &s) const {
-    return globalStats[s.id];
+    uint64_t sum = 0;
+    unsigned n = numSlots.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < n; i++)
+      sum += slots[i].load(std::memory_order_acquire)->values[s.id]
+        .load(std::memory_order_relaxed);
+    return sum;
   }
 
   inline void StatisticManager::incrementIndexedValue(const Statistic &s, 
@@ -77,6 +77,11 @@ extern "C" {
   
   /* called by checking code to get size of memory. */
   size_t klee_get_obj_size(void *ptr);
+
+  /* copy nbytes from src to dest in the interpreter, if the arguments are
+   * concrete and both ranges lie within one object each. Returns 0 if
+   * nothing was copied and the caller has to copy them itself. */
+  int klee_copy_memory(void *dest, const void *src, size_t nbytes);
   
   /* print the tree associated w/ a given expression. */
   void klee_print_expr(const char *msg, ...);
@@ -22,6 +22,7 @@
 #define unordered_set std::tr1::unordered_set
 #endif
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -36,6 +37,9 @@ struct EquivArrayCmpFn {
 };
 
 /// Provides an interface for creating and destroying Array objects.
+///
+/// Threads may create arrays in a shared cache, the cache is locked while
+/// an array is looked up or added. Arrays are immutable once created.
 class ArrayCache {
 public:
   ArrayCache() {}
@@ -73,6 +77,7 @@ private:
   ArrayHashMap cachedSymbolicArrays;
   typedef std::vector<const Array *> ArrayPtrVec;
   ArrayPtrVec concreteArrays;
+  std::mutex lock;
 };
 }
 
@@ -15,6 +15,7 @@
 #include "klee/SolverStats.h"
 
 #include <map>
+#include <vector>
 
 #include <ciso646>
 #ifdef _LIBCPP_VERSION
@@ -66,6 +67,16 @@ public:
   
   bool lookupUpdateNodeExpr(const UpdateNode* un, T& exp) const;
   void hashUpdateNodeExpr(const UpdateNode* un, T& exp);  
+
+  /// the number of update nodes with a hashed expression
+  size_t getNumUpdateNodes() const { return _update_node_hash.size(); }
+
+  /// Drop the expressions of the update nodes. Extend this as the
+  /// destructor if they need to be explicitly destroyed.
+  virtual void clearUpdateNodes() {
+    _update_node_hash.clear();
+    _update_node_refs.clear();
+  }
   
 protected:
   typedef unordered_map<const Array*, T, ArrayHashFn, ArrayCmpFn> ArrayHash;
@@ -78,6 +89,9 @@ protected:
   
   ArrayHash      _array_hash;
   UpdateNodeHash _update_node_hash;  
+  /// references to the hashed update nodes, which are hashed by address and
+  /// so must not be freed and reused while they are in the hash
+  std::vector<UpdateList> _update_node_refs;
 };
 
 
@@ -135,7 +149,12 @@ void ArrayExprHash<T>::hashUpdateNodeExpr(const UpdateNode* un, T& exp)
 #endif
   
   assert(un);
-  _update_node_hash[un] = exp;
+  if (_update_node_hash.insert(std::make_pair(un, exp)).second) {
+    // The root is not needed to hold the nodes.
+    _update_node_refs.push_back(UpdateList(0, un));
+  } else {
+    _update_node_hash[un] = exp;
+  }
 }
 
 }
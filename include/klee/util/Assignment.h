@@ -12,6 +12,7 @@
 
 #include <map>
 
+#include "klee/util/ConcreteEvaluator.h"
 #include "klee/util/ExprEvaluator.h"
 
 // FIXME: Rename?
@@ -45,7 +46,7 @@ namespace klee {
     }
     
     ref<Expr> evaluate(const Array *mo, unsigned index) const;
-    ref<Expr> evaluate(ref<Expr> e);
+    ref<Expr> evaluate(ref<Expr> e) const;
 
     template<typename InputIterator>
     bool satisfies(InputIterator begin, InputIterator end);
@@ -82,13 +83,30 @@ namespace klee {
     }
   }
 
-  inline ref<Expr> Assignment::evaluate(ref<Expr> e) { 
+  inline ref<Expr> Assignment::evaluate(ref<Expr> e) const { 
+    if (!allowFreeValues) {
+      ref<ConstantExpr> value = ConcreteEvaluator(*this).evaluate(e);
+      if (!value.isNull())
+        return value;
+    }
     AssignmentEvaluator v(*this);
     return v.visit(e); 
   }
 
   template<typename InputIterator>
   inline bool Assignment::satisfies(InputIterator begin, InputIterator end) {
+    if (!allowFreeValues) {
+      // the sub-expressions the constraints share are evaluated once
+      ConcreteEvaluator concrete(*this);
+      AssignmentEvaluator v(*this);
+      uint64_t value;
+      for (; begin!=end; ++begin) {
+        if (concrete.evaluate(*begin, value) ? value != 1
+                                             : !v.visit(*begin)->isTrue())
+          return false;
+      }
+      return true;
+    }
     AssignmentEvaluator v(*this);
     for (; begin!=end; ++begin)
       if (!v.visit(*begin)->isTrue())
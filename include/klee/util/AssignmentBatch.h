@@ -0,0 +1,115 @@
+//===-- AssignmentBatch.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_ASSIGNMENTBATCH_H
+#define KLEE_UTIL_ASSIGNMENTBATCH_H
+
+#include "klee/Expr.h"
+#include "klee/util/Assignment.h"
+
+#include "llvm/Support/MathExtras.h"
+
+#include <map>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+  /// AssignmentBatch - Up to MaxLanes assignments, one per lane, evaluated
+  /// together against an expression in a single traversal.
+  ///
+  /// Every node of the expression is evaluated once for all lanes, as a
+  /// fixed-length loop over the lanes which the compiler can vectorize,
+  /// instead of once per assignment by an ExprEvaluator. The bindings are
+  /// not copied: the batch keeps, per array, a pointer into the bytes of
+  /// each assignment, so the assignments must not change while they are in
+  /// the batch.
+  ///
+  /// Nodes wider than 64 bits, and lanes dividing by zero, are left to
+  /// Assignment::satisfies, so the batch answers exactly as the assignments
+  /// would one by one.
+  class AssignmentBatch {
+  public:
+    enum { MaxLanes = 64 };
+
+  private:
+    /// The value of a node in every lane, zero-extended to 64 bits.
+    struct Lanes {
+      uint64_t v[MaxLanes];
+      /// the lanes whose value is undefined (division by zero)
+      uint64_t undefined;
+    };
+
+    /// The bindings of an array in every lane, 0 if the lane has none.
+    struct ArrayLanes {
+      const unsigned char *bytes[MaxLanes];
+      unsigned size[MaxLanes];
+      ArrayLanes();
+    };
+
+    std::vector<const Assignment*> assignments;
+    /// the lanes holding an assignment
+    uint64_t live;
+    std::map<const Array*, ArrayLanes> arrays;
+
+    /// the values of the nodes evaluated by the current call
+    std::vector<Lanes> values;
+    std::unordered_map<const Expr*, unsigned> slots;
+
+    bool evaluate(const ref<Expr> &e, unsigned &slot);
+    bool evaluateRead(const ReadExpr &re, unsigned &slot);
+    unsigned newSlot();
+
+  public:
+    AssignmentBatch() : live(0) {}
+
+    bool isFull() const { return assignments.size() == MaxLanes; }
+    bool empty() const { return !live; }
+    unsigned getNumLanes() const { return assignments.size(); }
+    const Assignment *getAssignment(unsigned lane) const {
+      return assignments[lane];
+    }
+
+    /// Add an assignment, which must not allow free values, to the next
+    /// lane.
+    ///
+    /// \return the lane.
+    unsigned add(const Assignment *a);
+
+    /// Empty the lane of an assignment; the lane is not reused.
+    void remove(const Assignment *a);
+
+    /// The lanes (bit i for lane i) whose assignment satisfies all of the
+    /// expressions.
+    template<typename InputIterator>
+    uint64_t satisfying(InputIterator begin, InputIterator end) {
+      uint64_t lanes = live;
+      for (; begin != end && lanes; ++begin)
+        lanes &= satisfying(*begin);
+      slots.clear();
+      values.clear();
+      return lanes;
+    }
+
+    /// The first lane whose assignment satisfies all of the expressions,
+    /// -1 if none does.
+    template<typename InputIterator>
+    int findSatisfying(InputIterator begin, InputIterator end) {
+      uint64_t lanes = satisfying(begin, end);
+      return lanes ? (int) llvm::countTrailingZeros(lanes) : -1;
+    }
+
+  private:
+    /// The live lanes satisfying e, the nodes evaluated stay memoized for
+    /// the next expressions of the same call.
+    uint64_t satisfying(const ref<Expr> &e);
+  };
+}
+
+#endif
@@ -0,0 +1,127 @@
+//===-- BinaryQueryLog.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BINARYQUERYLOG_H
+#define KLEE_BINARYQUERYLOG_H
+
+#include "klee/Expr.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class MemoryBuffer;
+}
+
+namespace klee {
+  class ArrayCache;
+  class ExprBuilder;
+  struct Query;
+
+namespace expr {
+  class Parser;
+  class QueryCommand;
+}
+
+/// The binary query log keeps the sharing of the logged expressions: every
+/// array, update node and expression node is written once, when a query
+/// first refers to it, and later records refer to it by its index.
+///
+/// The log starts with BinaryQueryLogMagic, followed by records which each
+/// start with a tag byte. All integers are unsigned LEB128, references to
+/// update nodes are 0 for none or the index plus one.
+///
+///  'A' array:   name, size, domain, range, #values, value expressions
+///  'U' update:  next update, index expression, value expression
+///  'E' expr:    kind, width, then by kind
+///               Constant: the 64 bit words of the value, low first
+///               Read: array, update list head, index
+///               Extract: offset, kid; ZExt, SExt: kid
+///               otherwise: the kids
+///  'Q' query:   type, #constraints, constraints, expression, #objects,
+///               objects
+///  'R' result:  success, elapsed time in microseconds, answer
+///  'Z' reset:   forget all arrays, update nodes and expressions
+///
+/// Strings are a length followed by their bytes. The answer of a result is
+/// the validity of a Truth query (0 or 1), the Solver::Validity of a
+/// Validity query plus one, and whether an InitialValues query has a
+/// solution; it is 0 for Value queries.
+extern const char BinaryQueryLogMagic[4];
+
+class BinaryQueryLogWriter {
+public:
+  enum QueryType { Truth, Validity, Value, InitialValues };
+
+private:
+  llvm::DenseMap<const Array*, unsigned> arrays;
+  llvm::DenseMap<const UpdateNode*, unsigned> updates;
+  llvm::DenseMap<const Expr*, unsigned> exprs;
+  /// The written update nodes and expressions are kept alive, so that their
+  /// addresses are not reused while they are in the tables.
+  std::vector<UpdateList> updateRefs;
+  std::vector<ref<Expr> > exprRefs;
+
+  void writeArray(std::string &out, const Array *array);
+  void writeUpdates(std::string &out, const UpdateNode *head);
+  void writeExpr(std::string &out, const ref<Expr> &e);
+  unsigned getExpr(std::string &out, const ref<Expr> &e);
+  unsigned getArray(std::string &out, const Array *array);
+
+public:
+  /// Append the definitions the query needs to defs and the query record
+  /// to out. Keeping them apart lets a logger drop the query record while
+  /// still writing the definitions later queries refer to.
+  void writeQuery(std::string &defs, std::string &out, QueryType type,
+                  const Query &query,
+                  const std::vector<const Array*> *objects = 0);
+
+  /// Append the result record of the last query to out.
+  static void writeResult(std::string &out, bool success, double elapsed,
+                          unsigned answer);
+
+  /// If the tables grew past their limit, clear them and append a reset
+  /// record to out. Call this between queries only.
+  void resetIfFull(std::string &out);
+
+  static void writeHeader(std::string &out);
+};
+
+/// Reads the records of a BinaryQueryLogWriter which arrive in chunks,
+/// without the log header, e.g. the queries sent to a solver process. The
+/// definitions read from one chunk stay known for the later ones.
+class BinaryQueryLogReader {
+  expr::Parser *parser;
+
+public:
+  BinaryQueryLogReader(ExprBuilder *builder, ArrayCache *arrays);
+  ~BinaryQueryLogReader();
+
+  /// Read the n bytes at data, which end with a query record, and return
+  /// the query, or null if the records are invalid. The reader stays
+  /// invalid after an error.
+  expr::QueryCommand *readQuery(const char *data, size_t n);
+};
+
+/// Whether the buffer holds a binary query log.
+bool isBinaryQueryLog(const llvm::MemoryBuffer *MB);
+
+namespace expr {
+  /// Create a parser which returns the queries of a binary query log as
+  /// QueryCommands, in the form the .kquery logs print them.
+  Parser *createBinaryQueryLogParser(const std::string &Filename,
+                                     const llvm::MemoryBuffer *MB,
+                                     ExprBuilder *Builder,
+                                     ArrayCache *Arrays);
+}
+}
+
+#endif
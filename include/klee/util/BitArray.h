@@ -18,23 +18,70 @@ namespace klee {
 class BitArray {
 private:
   uint32_t *bits;
+  /// whether bits was allocated here, rather than given to a constructor
+  bool ownsBits;
   
 protected:
   static uint32_t length(unsigned size) { return (size+31)/32; }
 
+  /// the bits of word idx/32 from idx on, at most n of them
+  static uint32_t wordMask(unsigned idx, unsigned n) {
+    unsigned bit = idx & 0x1F;
+    if (n >= 32 - bit)
+      return ~0u << bit;
+    return ((1u << n) - 1) << bit;
+  }
+
 public:
-  BitArray(unsigned size, bool value = false) : bits(new uint32_t[length(size)]) {
+  BitArray(unsigned size, bool value = false)
+    : bits(new uint32_t[length(size)]), ownsBits(true) {
     memset(bits, value?0xFF:0, sizeof(*bits)*length(size));
   }
-  BitArray(const BitArray &b, unsigned size) : bits(new uint32_t[length(size)]) {
+  BitArray(const BitArray &b, unsigned size)
+    : bits(new uint32_t[length(size)]), ownsBits(true) {
+    memcpy(bits, b.bits, sizeof(*bits)*length(size));
+  }
+  /// Copy b into the getStorageSize(size) bytes at storage, which must
+  /// outlive this.
+  BitArray(const BitArray &b, unsigned size, uint32_t *storage)
+    : bits(storage), ownsBits(false) {
     memcpy(bits, b.bits, sizeof(*bits)*length(size));
   }
-  ~BitArray() { delete[] bits; }
+  ~BitArray() { if (ownsBits) delete[] bits; }
+
+  static size_t getStorageSize(unsigned size) {
+    return sizeof(uint32_t)*length(size);
+  }
 
   bool get(unsigned idx) { return (bool) ((bits[idx/32]>>(idx&0x1F))&1); }
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  /// Whether the bits of [begin, end) are all set, checked a word at a time.
+  bool isAllSet(unsigned begin, unsigned end) const {
+    for (unsigned idx = begin; idx < end; idx = (idx | 0x1F) + 1) {
+      uint32_t mask = wordMask(idx, end - idx);
+      if ((bits[idx/32] & mask) != mask)
+        return false;
+    }
+    return true;
+  }
+  /// Whether none of the bits of [begin, end) is set.
+  bool isAllUnset(unsigned begin, unsigned end) const {
+    for (unsigned idx = begin; idx < end; idx = (idx | 0x1F) + 1)
+      if (bits[idx/32] & wordMask(idx, end - idx))
+        return false;
+    return true;
+  }
+  void setRange(unsigned begin, unsigned end) {
+    for (unsigned idx = begin; idx < end; idx = (idx | 0x1F) + 1)
+      bits[idx/32] |= wordMask(idx, end - idx);
+  }
+  void unsetRange(unsigned begin, unsigned end) {
+    for (unsigned idx = begin; idx < end; idx = (idx | 0x1F) + 1)
+      bits[idx/32] &= ~wordMask(idx, end - idx);
+  }
 };
 
 } // End klee namespace
@@ -0,0 +1,58 @@
+//===-- ConcreteEvaluator.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_CONCRETEEVALUATOR_H
+#define KLEE_UTIL_CONCRETEEVALUATOR_H
+
+#include "klee/Expr.h"
+
+#include <stdint.h>
+#include <unordered_map>
+
+namespace klee {
+  class Assignment;
+
+  /// ConcreteEvaluator - Evaluates expressions under an assignment without
+  /// free values to a number, without building an expression per node as
+  /// an ExprEvaluator does.
+  ///
+  /// The value of every node is memoized by its address for the lifetime of
+  /// the evaluator, so the sub-expressions shared within and across the
+  /// expressions given to it are evaluated once. The operations on 1, 8, 16,
+  /// 32 and 64 bits run on the matching machine type; other widths are
+  /// masked.
+  ///
+  /// Nodes wider than 64 bits and divisions by zero, which an ExprEvaluator
+  /// leaves unevaluated, are refused, so the caller falls back to it and
+  /// the answers are the same.
+  class ConcreteEvaluator {
+    const Assignment &assignment;
+    std::unordered_map<const Expr*, uint64_t> values;
+
+    bool evaluateRead(const ReadExpr &re, uint64_t &value);
+    bool evaluateNode(const ref<Expr> &e, uint64_t &value);
+
+  public:
+    /// The assignment must not allow free values, nor change while the
+    /// evaluator is in use.
+    explicit ConcreteEvaluator(const Assignment &_assignment);
+
+    /// The value of e, zero-extended to 64 bits. Returns false if e needs
+    /// an ExprEvaluator.
+    bool evaluate(const ref<Expr> &e, uint64_t &value);
+
+    /// The value of e as a constant, null if e needs an ExprEvaluator.
+    ref<ConstantExpr> evaluate(const ref<Expr> &e);
+
+    /// Forget the memoized nodes, which may be freed afterwards.
+    void clear() { values.clear(); }
+  };
+}
+
+#endif
@@ -0,0 +1,61 @@
+//===-- ConstraintPartition.h -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CONSTRAINTPARTITION_H
+#define KLEE_CONSTRAINTPARTITION_H
+
+#include "klee/Expr.h"
+
+#include <map>
+#include <vector>
+
+namespace klee {
+
+/// ConstraintPartition - The independent sets of a list of constraints,
+/// kept up to date as constraints are appended.
+///
+/// Two constraints depend on each other if they read the same element of
+/// an array, or if one of them reads an array at a symbolic index and the
+/// other reads the same array at all; the sets are the transitive closure
+/// of this relation, kept in a union-find over the constraint indices.
+class ConstraintPartition {
+  /// union-find over the constraint indices
+  mutable std::vector<unsigned> parent;
+  /// the constraints of each set, indexed by its root
+  std::vector< std::vector<unsigned> > members;
+  /// a constraint reading each constant index of an array
+  std::map<const Array *, std::map<unsigned, unsigned> > elements;
+  /// a constraint reading each array at a symbolic index, such arrays are
+  /// no longer split into elements
+  std::map<const Array *, unsigned> wholeObjects;
+
+  unsigned find(unsigned index) const;
+  void unite(unsigned a, unsigned b);
+
+public:
+  void clear();
+
+  /// Add a constraint, index must be the number of constraints added so far.
+  void add(unsigned index, ref<Expr> e);
+
+  /// Get the indices of the constraints e depends on, in increasing order.
+  /// Returns false if e reads no array the sets are kept for, then any
+  /// constraint may contain it.
+  bool getDependent(ref<Expr> e, std::vector<unsigned> &result) const;
+
+  /// Get the indices of the constraints of every set, each in increasing
+  /// order.
+  void getSets(std::vector< std::vector<unsigned> > &result) const;
+
+  size_t size() const { return parent.size(); }
+};
+
+}
+
+#endif
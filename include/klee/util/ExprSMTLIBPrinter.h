@@ -228,6 +228,26 @@ protected:
   /// Exprs in orderedBindings[0] have no dependencies.
   std::vector<BindingMap> orderedBindings;
 
+  /// Set of update nodes seen during scan.
+  std::set<const UpdateNode *> seenUpdates;
+
+  typedef std::map<const UpdateNode *, std::pair<const Array *, int> >
+      UpdateBindingMap;
+
+  /// Binding numbers of the update list suffixes used by more than one read
+  /// or longer update list, with the array they update. They are abbreviated
+  /// like the expressions in bindings.
+  UpdateBindingMap updateBindings;
+
+  /// The update list bindings of each level of orderedBindings, in the order
+  /// they were found.
+  std::vector<std::vector<const UpdateNode *> > orderedUpdateBindings;
+
+  /// The highest binding level used by each expression and update node
+  /// visited by scanBindingExprDeps().
+  std::map<const Expr *, unsigned> exprLevels;
+  std::map<const UpdateNode *, unsigned> updateLevels;
+
   /// Output stream to write to
   llvm::raw_ostream *o;
 
@@ -297,6 +317,12 @@ protected:
   /// printing in the let abbreviation mode.
   void scanBindingExprDeps();
 
+  /// \return The level of the let that can define a term using e, that is
+  /// the highest level of the bindings e is or uses, or 0 if it uses none.
+  /// Each node is visited once.
+  unsigned getBindingLevel(const ref<Expr> &e);
+  unsigned getBindingLevel(const UpdateNode *un);
+
   /* Rules of recursion for "Special Expression handlers" and
    *printSortArgsExpr()
    *
@@ -336,6 +362,9 @@ protected:
   /// Recursively prints updatesNodes
   void printUpdatesAndArray(const UpdateNode *un, const Array *root);
 
+  /// Print the store of un without abbreviating it
+  void printStore(const UpdateNode *un, const Array *root);
+
   /// This method does the translation between Expr classes and SMTLIBv2
   /// keywords
   /// \return A C-string of the SMTLIBv2 keyword
@@ -343,8 +372,8 @@ protected:
 
   void printSeperator();
 
-  /// Helper function for scan() that scans the expressions of an update node
-  void scanUpdates(const UpdateNode *un);
+  /// Helper function for scan() that scans the expressions of an update list
+  void scanUpdates(const UpdateNode *un, const Array *root);
 
   /// Helper printer class
   PrintContext *p;
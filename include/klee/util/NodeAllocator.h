@@ -0,0 +1,38 @@
+//===-- NodeAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_NODEALLOCATOR_H
+#define KLEE_NODEALLOCATOR_H
+
+#include <stddef.h>
+
+namespace klee {
+
+/// NodeAllocator - Slab allocation for the expression and update nodes.
+///
+/// Nodes are taken from slabs of a size class (a multiple of 16 bytes, so
+/// every expression class has its own class or shares it with classes of
+/// the same size), and freed nodes are kept on a list per class for the
+/// next node of that size. Nodes built one after the other, like a node
+/// and its kids, end up next to each other. Slabs are never returned.
+/// With KLEE_ATOMIC_REFCOUNT, the threads share the slabs under a lock.
+class NodeAllocator {
+public:
+  static void *allocate(size_t size);
+  static void deallocate(void *p, size_t size);
+
+  /// The bytes of the live nodes.
+  static size_t getLiveBytes();
+  /// The bytes of all the slabs, including the free nodes.
+  static size_t getSlabBytes();
+};
+
+}
+
+#endif
@@ -0,0 +1,59 @@
+//===-- QueryHash.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_QUERYHASH_H
+#define KLEE_QUERYHASH_H
+
+#include "klee/Expr.h"
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+namespace klee {
+
+class ConstraintManager;
+
+/// QueryHasher - A 128-bit structural hash of the canonical form of a query.
+///
+/// In the canonical form, the constraints are a set, the operands of
+/// commutative operators are unordered, and the symbolic arrays are numbered
+/// in the order the canonical form reads them, so their names do not
+/// matter. Queries which only differ in these respects hash the same,
+/// within and across processes.
+class QueryHasher {
+public:
+  typedef std::pair<uint64_t, uint64_t> Hash;
+
+private:
+  /// hashes with all symbolic arrays alike, which order the constraints
+  /// and operands before the arrays are numbered
+  std::map<const Expr *, Hash> shapes;
+  std::map<const Expr *, Hash> hashes;
+  std::map<const Array *, unsigned> arrayIds;
+  /// the hashed expressions, kept alive while they are memoized by address
+  std::vector< ref<Expr> > hashed;
+  Hash constraintsHash;
+
+  Hash hashArray(const Array *array, bool numbered);
+  Hash hashExpr(const ref<Expr> &e, bool numbered);
+
+public:
+  explicit QueryHasher(const ConstraintManager &constraints);
+
+  /// The hash of the query of expr under the constraints.
+  Hash getHash(ref<Expr> expr);
+
+  /// The hash of the counterexample query of expr for the given objects.
+  Hash getHash(ref<Expr> expr, const std::vector<const Array *> &objects);
+};
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+//===-- RefCount.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_REFCOUNT_H
+#define KLEE_REFCOUNT_H
+
+#include "klee/Config/config.h"
+
+#ifdef KLEE_ATOMIC_REFCOUNT
+#include <atomic>
+#endif
+
+namespace klee {
+
+#ifdef KLEE_ATOMIC_REFCOUNT
+  /// RefCount - The reference count of the expressions and update nodes,
+  /// which threads may share when built with KLEE_ATOMIC_REFCOUNT.
+  ///
+  /// A reference is taken with a relaxed increment, as the taker already
+  /// holds one; it is dropped with a release decrement, and the thread
+  /// dropping the last one acquires the writes of the others before it
+  /// deletes the object.
+  class RefCount {
+    std::atomic<unsigned> count;
+
+  public:
+    RefCount(unsigned c = 0) : count(c) {}
+    RefCount(const RefCount &r)
+      : count(r.count.load(std::memory_order_relaxed)) {}
+
+    unsigned operator++() {
+      return count.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    unsigned operator--() {
+      unsigned n = count.fetch_sub(1, std::memory_order_release) - 1;
+      if (n == 0)
+        std::atomic_thread_fence(std::memory_order_acquire);
+      return n;
+    }
+    operator unsigned() const { return count.load(std::memory_order_relaxed); }
+
+    /// Take a reference unless the last one is gone already, for a table
+    /// which finds objects that may be dying in another thread.
+    bool retainIfLive() {
+      unsigned n = count.load(std::memory_order_relaxed);
+      while (n != 0)
+        if (count.compare_exchange_weak(n, n + 1, std::memory_order_relaxed))
+          return true;
+      return false;
+    }
+  };
+
+  typedef std::atomic<unsigned> InstanceCount;
+#else
+  typedef unsigned RefCount;
+  typedef unsigned InstanceCount;
+#endif
+
+}
+
+#endif
@@ -2,10 +2,98 @@
 #include <WPA/Andersen.h>
 #include <WPA/FlowSensitive.h>
 
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <sstream>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
 #include "klee/Internal/Analysis/AAPass.h"
 
 using namespace llvm;
 
+namespace {
+
+/* Andersen whose points-to sets are read from a file instead of solved */
+class LoadedAndersen : public Andersen {
+public:
+    void build(llvm::Module& module) {
+        initialize(module);
+    }
+};
+
+/* an Andersen variant which treats every object as a single field */
+template <class Base>
+class FieldInsensitive : public Base {
+protected:
+    virtual void initialize(llvm::Module& module) {
+        Base::initialize(module);
+        SymbolTableInfo::IDToMemMapTy& objs =
+            SymbolTableInfo::Symbolnfo()->idToObjMap();
+        for (SymbolTableInfo::IDToMemMapTy::iterator i = objs.begin();
+             i != objs.end(); ++i) {
+            i->second->setFieldInsensitive();
+        }
+    }
+};
+
+double getTime() {
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+struct GepRecord {
+    uint32_t id;
+    uint32_t base;
+    uint32_t offset;
+    uint32_t accOffset;
+
+    bool operator<(const GepRecord& other) const {
+        return id < other.id;
+    }
+};
+
+const char ptsMagic[4] = {'K', 'P', 'T', 'S'};
+const uint32_t ptsVersion = 1;
+
+/* the file is only used for the (inlined) module it was written for */
+void getFingerprint(llvm::Module& module, uint32_t fp[4]) {
+    fp[0] = fp[1] = fp[2] = fp[3] = 0;
+    for (Module::iterator f = module.begin(); f != module.end(); ++f) {
+        fp[0]++;
+        for (Function::iterator bb = f->begin(); bb != f->end(); ++bb) {
+            fp[1]++;
+            fp[2] += bb->size();
+        }
+    }
+    for (Module::global_iterator g = module.global_begin(); g != module.global_end(); ++g) {
+        fp[3]++;
+    }
+}
+
+void writeU32(std::ostream& os, uint32_t v) {
+    os.write((const char *)&v, sizeof(v));
+}
+
+bool readU32(std::istream& is, uint32_t& v) {
+    return is.read((char *)&v, sizeof(v)).good();
+}
+
+}
+
 char AAPass::ID = 0;
 
 static RegisterPass<AAPass> WHOLEPROGRAMPA("AAPass",
@@ -16,23 +104,142 @@ AAPass::~AAPass() {
 }
 
 bool AAPass::runOnModule(llvm::Module& module) {
-    runPointerAnalysis(module, type);
+    bool load = loadPts;
+    bool store = !loadPts && !ptsFile.empty();
+    if (!cacheDir.empty()) {
+        ptsFile = getCacheFile(module);
+        load = store = !ptsFile.empty();
+    }
+
+    if (load && loadPointsTo(module)) {
+        return false;
+    }
+
+    if (timeout > 0) {
+        /* a fallback result must not be taken for the precise one later */
+        if (!runBoundedPointerAnalysis(module)) {
+            return false;
+        }
+    } else {
+        runPointerAnalysis(module, type, fieldInsensitive);
+    }
+
+    if (store) {
+        writePointsTo(module);
+    }
     return false;
 }
 
-void AAPass::runPointerAnalysis(llvm::Module& module, u32_t kind) {
+bool AAPass::runBoundedPointerAnalysis(llvm::Module& module) {
+    std::string file = ptsFile;
+    std::stringstream tmpName;
+    tmpName << "/tmp/klee-pts-" << getpid();
+    ptsFile = tmpName.str();
+
+    /* the child writes the solved sets, which are loaded like a cache */
+    double start = getTime();
+    pid_t pid = fork();
+    if (pid == 0) {
+        runPointerAnalysis(module, type, fieldInsensitive);
+        _exit(writePointsTo(module) ? 0 : 1);
+    }
+
+    bool solved = false;
+    if (pid > 0) {
+        int status;
+        while (true) {
+            pid_t res = waitpid(pid, &status, WNOHANG);
+            if (res == pid) {
+                solved = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                break;
+            } else if (res < 0 && errno != EINTR) {
+                break;
+            }
+            if (getTime() - start > timeout) {
+                kill(pid, SIGKILL);
+                waitpid(pid, &status, 0);
+                break;
+            }
+            usleep(10000);
+        }
+        solved = solved && loadPointsTo(module);
+    } else {
+        llvm::errs() << "Unable to fork the pointer analysis, solving it "
+                     << "without a bound\n";
+    }
+    remove(ptsFile.c_str());
+    ptsFile = file;
+
+    if (pid < 0) {
+        runPointerAnalysis(module, type, fieldInsensitive);
+        return true;
+    }
+    if (solved) {
+        return true;
+    }
+
+    start = getTime();
+    runPointerAnalysis(module, PointerAnalysis::AndersenWaveDiff_WPA, true);
+    llvm::errs() << "Pointer analysis did not finish in " << timeout
+                 << "s, using the field insensitive wave-diff analysis "
+                 << "(solved in " << getTime() - start
+                 << "s, average points-to set size "
+                 << getAveragePointsToSize() << ")\n";
+    return false;
+}
+
+double AAPass::getAveragePointsToSize() {
+    PAG* pag = _pta->getPAG();
+    uint64_t pointers = 0, targets = 0;
+    for (PAG::iterator i = pag->begin(); i != pag->end(); ++i) {
+        if (!isa<ValPN>(i->second)) {
+            continue;
+        }
+        PointsTo &pts = _pta->getPts(i->first);
+        if (!pts.empty()) {
+            pointers++;
+            targets += pts.count();
+        }
+    }
+    return pointers ? (double) targets / pointers : 0;
+}
+
+std::string AAPass::getCacheFile(llvm::Module& module) {
+    if (mkdir(cacheDir.c_str(), 0775) != 0 && errno != EEXIST) {
+        llvm::errs() << "Unable to create analysis cache " << cacheDir << "\n";
+        return "";
+    }
+
+    /* the module is already inlined, so this covers the inlining options */
+    std::string bitcode;
+    raw_string_ostream os(bitcode);
+    WriteBitcodeToFile(&module, os);
+    os.flush();
+
+    MD5 hash;
+    hash.update(bitcode);
+    MD5::MD5Result result;
+    hash.final(result);
+    SmallString<32> key;
+    MD5::stringifyResult(result, key);
+
+    return cacheDir + "/pts-" + key.str().str();
+}
+
+void AAPass::runPointerAnalysis(llvm::Module& module, u32_t kind, bool fi) {
     switch (kind) {
     case PointerAnalysis::Andersen_WPA:
-        _pta = new Andersen();
+        _pta = fi ? new FieldInsensitive<Andersen>() : new Andersen();
         break;
     case PointerAnalysis::AndersenLCD_WPA:
-        _pta = new AndersenLCD();
+        _pta = fi ? new FieldInsensitive<AndersenLCD>() : new AndersenLCD();
         break;
     case PointerAnalysis::AndersenWave_WPA:
-        _pta = new AndersenWave();
+        _pta = fi ? new FieldInsensitive<AndersenWave>() : new AndersenWave();
         break;
     case PointerAnalysis::AndersenWaveDiff_WPA:
-        _pta = new AndersenWaveDiff();
+        _pta = fi ? new FieldInsensitive<AndersenWaveDiff>()
+                  : new AndersenWaveDiff();
         break;
     case PointerAnalysis::FSSPARSE_WPA:
         _pta = new FlowSensitive();
@@ -45,6 +252,170 @@ void AAPass::runPointerAnalysis(llvm::Module& module, u32_t kind) {
     _pta->analyze(module);
 }
 
+bool AAPass::loadPointsTo(llvm::Module& module) {
+    std::ifstream is(ptsFile.c_str(), std::ios::binary);
+    if (!is.good()) {
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version, fp[4], expected[4];
+    if (!is.read(magic, sizeof(magic)).good() ||
+        !std::equal(magic, magic + 4, ptsMagic) ||
+        !readU32(is, version) || version != ptsVersion) {
+        llvm::errs() << "Ignoring malformed points-to file " << ptsFile << "\n";
+        return false;
+    }
+    getFingerprint(module, expected);
+    for (unsigned i = 0; i < 4; i++) {
+        if (!readU32(is, fp[i]) || fp[i] != expected[i]) {
+            llvm::errs() << "Ignoring points-to file " << ptsFile
+                         << " written for another module\n";
+            return false;
+        }
+    }
+
+    uint32_t numGeps;
+    std::vector<GepRecord> geps;
+    if (!readU32(is, numGeps)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < numGeps; i++) {
+        GepRecord r;
+        if (!readU32(is, r.id) || !readU32(is, r.base) ||
+            !readU32(is, r.offset) || !readU32(is, r.accOffset)) {
+            return false;
+        }
+        geps.push_back(r);
+    }
+
+    /* build the PAG, then recreate the field objects the solver added */
+    LoadedAndersen *pta = new LoadedAndersen();
+    pta->build(module);
+    _pta = pta;
+
+    PAG* pag = _pta->getPAG();
+    bool ok = true;
+    for (std::vector<GepRecord>::iterator i = geps.begin(); ok && i != geps.end(); ++i) {
+        NodeID id = i->id;
+        if (!pag->hasGNode(id)) {
+            if (!pag->hasGNode(i->base)) {
+                ok = false;
+                break;
+            }
+            id = pag->getGepObjNode(i->base, LocationSet(i->offset));
+        }
+        GepObjPN *gep = dyn_cast<GepObjPN>(pag->getPAGNode(id));
+        ok = id == i->id && gep &&
+             pag->getBaseObjNode(id) == i->base &&
+             gep->getLocationSet().getAccOffset() == i->accOffset;
+    }
+
+    uint32_t numPts;
+    ok = ok && readU32(is, numPts);
+    for (uint32_t i = 0; ok && i < numPts; i++) {
+        uint32_t id, size;
+        if (!readU32(is, id) || !readU32(is, size) || !pag->hasGNode(id)) {
+            ok = false;
+            break;
+        }
+        PointsTo pts;
+        for (uint32_t j = 0; j < size; j++) {
+            uint32_t target;
+            if (!readU32(is, target) || !pag->hasGNode(target)) {
+                ok = false;
+                break;
+            }
+            pts.set(target);
+        }
+        _pta->getPts(id) |= pts;
+    }
+
+    if (!ok) {
+        llvm::errs() << "Points-to file " << ptsFile
+                     << " does not match the PAG, solving locally\n";
+        delete _pta;
+        _pta = 0;
+        return false;
+    }
+
+    llvm::errs() << "Loaded points-to sets from " << ptsFile << "\n";
+    return true;
+}
+
+bool AAPass::writePointsTo(llvm::Module& module) {
+    PAG* pag = _pta->getPAG();
+    std::vector<GepRecord> geps;
+    std::vector<NodeID> ids;
+    for (PAG::iterator i = pag->begin(); i != pag->end(); ++i) {
+        NodeID id = i->first;
+        ids.push_back(id);
+        if (GepObjPN *gep = dyn_cast<GepObjPN>(i->second)) {
+            GepRecord r;
+            r.id = id;
+            r.base = pag->getBaseObjNode(id);
+            r.offset = gep->getLocationSet().getOffset();
+            r.accOffset = gep->getLocationSet().getAccOffset();
+            geps.push_back(r);
+        }
+    }
+    std::sort(geps.begin(), geps.end());
+    std::sort(ids.begin(), ids.end());
+
+    /* write to a temporary file first, readers never see a partial file */
+    std::stringstream tmpName;
+    tmpName << ptsFile << ".tmp" << getpid();
+    std::string tmpFile = tmpName.str();
+    std::ofstream os(tmpFile.c_str(), std::ios::binary | std::ios::trunc);
+    if (!os.good()) {
+        llvm::errs() << "Unable to write points-to file " << tmpFile << "\n";
+        return false;
+    }
+
+    uint32_t fp[4];
+    getFingerprint(module, fp);
+    os.write(ptsMagic, sizeof(ptsMagic));
+    writeU32(os, ptsVersion);
+    for (unsigned i = 0; i < 4; i++) {
+        writeU32(os, fp[i]);
+    }
+
+    writeU32(os, geps.size());
+    for (std::vector<GepRecord>::iterator i = geps.begin(); i != geps.end(); ++i) {
+        writeU32(os, i->id);
+        writeU32(os, i->base);
+        writeU32(os, i->offset);
+        writeU32(os, i->accOffset);
+    }
+
+    uint32_t numPts = 0;
+    for (std::vector<NodeID>::iterator i = ids.begin(); i != ids.end(); ++i) {
+        if (!_pta->getPts(*i).empty()) {
+            numPts++;
+        }
+    }
+    writeU32(os, numPts);
+    for (std::vector<NodeID>::iterator i = ids.begin(); i != ids.end(); ++i) {
+        PointsTo &pts = _pta->getPts(*i);
+        if (pts.empty()) {
+            continue;
+        }
+        writeU32(os, *i);
+        writeU32(os, pts.count());
+        for (PointsTo::iterator j = pts.begin(); j != pts.end(); ++j) {
+            writeU32(os, *j);
+        }
+    }
+
+    os.close();
+    if (!os.good() || rename(tmpFile.c_str(), ptsFile.c_str()) != 0) {
+        llvm::errs() << "Unable to write points-to file " << ptsFile << "\n";
+        remove(tmpFile.c_str());
+        return false;
+    }
+    return true;
+}
+
 llvm::AliasAnalysis::AliasResult AAPass::alias(const Value* V1, const Value* V2) {
     llvm::AliasAnalysis::AliasResult result = MayAlias;
 
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <iostream>
+#include <set>
 #include <vector>
 
 #include <llvm/IR/Module.h>
@@ -23,24 +24,33 @@ void Inliner::run() {
         return;
     }
 
+    set<Function *> inlined;
+    for (vector<string>::iterator i = functions.begin(); i != functions.end(); i++) {
+        if (Function *f = module->getFunction(*i)) {
+            inlined.insert(f);
+        }
+    }
+
+    /* we can't use pointer analysis at this point... */
+    set<Function *> reachable;
     for (vector<string>::iterator i = targets.begin(); i != targets.end(); i++) {
         Function *entry = module->getFunction(*i);
         assert(entry);
 
-        /* we can't use pointer analysis at this point... */
-        set<Function *> reachable;
+        /* functions reachable from several targets are handled once */
         ra->computeReachableFunctions(entry, false, reachable);
-        for (set<Function *>::iterator i = reachable.begin(); i != reachable.end(); i++) {
-            Function *f = *i;
-            if (f->isDeclaration()) {
-                continue;
-            }
-            inlineCalls(f, functions);
+    }
+
+    for (set<Function *>::iterator i = reachable.begin(); i != reachable.end(); i++) {
+        Function *f = *i;
+        if (f->isDeclaration()) {
+            continue;
         }
+        inlineCalls(f, inlined);
     }
 }
 
-void Inliner::inlineCalls(Function *f, vector<string> functions) {
+void Inliner::inlineCalls(Function *f, set<Function *> &inlined) {
     vector<CallInst *> calls;
 
     for (inst_iterator i = inst_begin(f); i != inst_end(f); i++) {
@@ -56,7 +66,7 @@ void Inliner::inlineCalls(Function *f, vector<string> functions) {
             continue;
         }
 
-        if (find(functions.begin(), functions.end(), calledFunction->getName().str()) == functions.end()) {
+        if (inlined.find(calledFunction) == inlined.end()) {
             continue;
         }
 
@@ -81,6 +81,10 @@ void ModRefAnalysis::run() {
     /* for each modified object compute the modifying store instructions */
     computeModInfoToStoreMap();
 
+    /* we don't need them any more... */
+    storeSummaries.clear();
+    cache.clear();
+
     /* debug */
     //dumpModSetMap();
     //dumpDependentLoads();
@@ -148,58 +152,71 @@ void ModRefAnalysis::collectModInfo(Function *entry) {
             continue;
         }
 
-        for (inst_iterator j = inst_begin(f); j != inst_end(f); j++) {
-            Instruction *inst = &*j;
-            if (inst->getOpcode() == Instruction::Store) {
-                addStore(entry, inst);
-            } 
+        /* functions reachable from several targets are scanned once */
+        StoreSummary &summary = getStoreSummary(f);
+        for (StoreSummary::iterator j = summary.begin(); j != summary.end(); j++) {
+            addStore(entry, j->first, j->second);
         }
     }
+}
 
-    /* we don't need it any more... */
-    cache.clear();
+ModRefAnalysis::StoreSummary &ModRefAnalysis::getStoreSummary(Function *f) {
+    StoreSummaryMap::iterator i = storeSummaries.find(f);
+    if (i != storeSummaries.end()) {
+        return i->second;
+    }
+
+    StoreSummary &summary = storeSummaries[f];
+    for (inst_iterator j = inst_begin(f); j != inst_end(f); j++) {
+        Instruction *inst = &*j;
+        if (inst->getOpcode() != Instruction::Store) {
+            continue;
+        }
+
+        AliasAnalysis::Location storeLocation = getStoreLocation(dyn_cast<StoreInst>(inst));
+        NodeID id = aa->getPTA()->getPAG()->getValueNode(storeLocation.Ptr);
+        PointsTo &pts = aa->getPTA()->getPts(id);
+
+        for (PointsTo::iterator k = pts.begin(); k != pts.end(); ++k) {
+            summary.push_back(make_pair(inst, *k));
+        }
+    }
+
+    return summary;
 }
 
 void ModRefAnalysis::addStore(
     Function *f,
-    Instruction *store
+    Instruction *store,
+    NodeID nodeId
 ) {
-    AliasAnalysis::Location storeLocation = getStoreLocation(dyn_cast<StoreInst>(store));
-    NodeID id = aa->getPTA()->getPAG()->getValueNode(storeLocation.Ptr);
-    PointsTo &pts = aa->getPTA()->getPts(id);
-
     PointsTo &modPts = modPtsMap[f];
 
-    for (PointsTo::iterator i = pts.begin(); i != pts.end(); ++i) {
-        NodeID nodeId = *i;
-
-        /* get allocation site */
-        PAGNode *pagNode = aa->getPTA()->getPAG()->getPAGNode(nodeId);
-        ObjPN *obj = dyn_cast<ObjPN>(pagNode);
-        if (!obj) {
-            /* TODO: handle */
-            assert(false);
-        }
+    /* get allocation site */
+    PAGNode *pagNode = aa->getPTA()->getPAG()->getPAGNode(nodeId);
+    ObjPN *obj = dyn_cast<ObjPN>(pagNode);
+    if (!obj) {
+        /* TODO: handle */
+        assert(false);
+    }
 
-        /* TODO: check static objects? */
-        if (obj->getMemObj()->isStack()) {
-            const Value *value = obj->getMemObj()->getRefVal();
-            if (canIgnoreStackObject(f, value)) {
-                continue;
-            }
+    /* TODO: check static objects? */
+    if (obj->getMemObj()->isStack()) {
+        const Value *value = obj->getMemObj()->getRefVal();
+        if (canIgnoreStackObject(f, value)) {
+            return;
         }
-
-        pair<Function *, NodeID> k = make_pair(f, nodeId);
-        objToStoreMap[k].insert(store);
-        modPts.set(nodeId);
     }
+
+    pair<Function *, NodeID> k = make_pair(f, nodeId);
+    objToStoreMap[k].insert(store);
+    modPts.set(nodeId);
 }
 
 bool ModRefAnalysis::canIgnoreStackObject(
     Function *f,
     const Value *value
 ) {
-    bool result;
     AllocaInst *alloca = dyn_cast<AllocaInst>((Value *)(value));
     if (!alloca) {
         return false;
@@ -208,21 +225,21 @@ bool ModRefAnalysis::canIgnoreStackObject(
     /* get the allocating function */
     Function *allocatingFunction = dyn_cast<Function>(alloca->getParent()->getParent());
 
+    /* a single bit test if the closure covers the allocating function */
+    if (ra->hasReachabilityInfo(allocatingFunction, true)) {
+        return !ra->isReachable(allocatingFunction, f);
+    }
+
+    /* the reachable functions do not depend on the target, keep them for all */
     ReachabilityCache::iterator i = cache.find(allocatingFunction);
     if (i == cache.end()) {
-        /* check if the entry reachable from the allocating function */
-        set<Function *> reachable;
-        ra->computeReachableFunctions(allocatingFunction, true, reachable);
-
-        /* save result */
-        result = reachable.find(f) != reachable.end();
-        cache.insert(make_pair(allocatingFunction, result));
-    } else {
-        result = i->second;
+        i = cache.insert(make_pair(allocatingFunction, set<Function *>())).first;
+        ra->computeReachableFunctions(allocatingFunction, true, i->second);
     }
 
-    /* if reachable, then the stack object can't be ignored */
-    return !result;
+    /* if the target is reachable from the allocating function, then the
+       stack object can't be ignored */
+    return i->second.find(f) == i->second.end();
 }
 
 void ModRefAnalysis::collectRefInfo(Function *entry) {
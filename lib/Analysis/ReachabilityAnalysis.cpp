@@ -3,6 +3,7 @@
 #include <vector>
 #include <stack>
 #include <set>
+#include <algorithm>
 
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Function.h>
@@ -110,10 +111,10 @@ bool ReachabilityAnalysis::run(bool usePA) {
     all.push_back(f);
   }
 
-  /* build reachability map */
-  for (vector<Function *>::iterator i = all.begin(); i != all.end(); i++) {
-    updateReachabilityMap(*i, usePA);
-  }
+  /* build the call graph once and close it over its components */
+  buildCallGraph(all, usePA);
+  closureUsesPA = usePA;
+  computeClosure();
 
   /* debug */
   dumpReachableFunctions();
@@ -121,14 +122,168 @@ bool ReachabilityAnalysis::run(bool usePA) {
   return true;
 }
 
-void ReachabilityAnalysis::updateReachabilityMap(Function *f, bool usePA) {
-  FunctionSet &functions = reachabilityMap[f];
-  computeReachableFunctions(f, usePA, functions);
+unsigned ReachabilityAnalysis::getFunctionId(Function *f) {
+  DenseMap<Function *, unsigned>::iterator i = functionIds.find(f);
+  if (i != functionIds.end()) {
+    return i->second;
+  }
+
+  unsigned id = functions.size();
+  functionIds[f] = id;
+  functions.push_back(f);
+  callees.push_back(vector<unsigned>());
+  return id;
+}
+
+void ReachabilityAnalysis::buildCallGraph(vector<Function *> &roots,
+                                          bool usePA) {
+  stack<Function *> stack;
+
+  for (vector<Function *>::iterator i = roots.begin(); i != roots.end(); i++) {
+    if (functionIds.find(*i) == functionIds.end()) {
+      getFunctionId(*i);
+      stack.push(*i);
+    }
+  }
+
+  while (!stack.empty()) {
+    Function *f = stack.top();
+    stack.pop();
+    unsigned id = functionIds[f];
+
+    for (inst_iterator iter = inst_begin(f); iter != inst_end(f); iter++) {
+      Instruction *inst = &*iter;
+      if (inst->getOpcode() != Instruction::Call) {
+        continue;
+      }
+
+      CallInst *callInst = dyn_cast<CallInst>(inst);
+
+      /* potential call targets */
+      FunctionSet targets;
+      resolveCallTargets(callInst, usePA, targets);
+
+      for (FunctionSet::iterator i = targets.begin(); i != targets.end(); i++) {
+        Function *target = *i;
+        bool known = functionIds.find(target) != functionIds.end();
+        callees[id].push_back(getFunctionId(target));
+
+        if (!known && !target->isDeclaration()) {
+          stack.push(target);
+        }
+      }
+
+      if (usePA) {
+        updateCallMap(callInst, targets);
+        updateRetMap(callInst, targets);
+      }
+    }
+  }
+}
+
+void ReachabilityAnalysis::computeClosure() {
+  /* Tarjan's algorithm, which completes the components of the callees
+     before the components of their callers */
+  unsigned n = functions.size();
+  const unsigned unvisited = ~0u;
+  vector<unsigned> index(n, unvisited), lowlink(n, 0);
+  vector<bool> onStack(n, false);
+  vector<unsigned> sccStack;
+  /* (function, next callee) frames of the depth first search */
+  vector<pair<unsigned, unsigned> > dfs;
+  unsigned counter = 0;
+
+  sccOf.assign(n, 0);
+  sccReachable.clear();
+
+  for (unsigned root = 0; root < n; root++) {
+    if (index[root] != unvisited) {
+      continue;
+    }
+
+    index[root] = lowlink[root] = counter++;
+    sccStack.push_back(root);
+    onStack[root] = true;
+    dfs.push_back(make_pair(root, 0));
+
+    while (!dfs.empty()) {
+      unsigned v = dfs.back().first;
+      if (dfs.back().second < callees[v].size()) {
+        unsigned w = callees[v][dfs.back().second++];
+        if (index[w] == unvisited) {
+          index[w] = lowlink[w] = counter++;
+          sccStack.push_back(w);
+          onStack[w] = true;
+          dfs.push_back(make_pair(w, 0));
+        } else if (onStack[w]) {
+          lowlink[v] = min(lowlink[v], index[w]);
+        }
+        continue;
+      }
+
+      dfs.pop_back();
+      if (!dfs.empty()) {
+        unsigned u = dfs.back().first;
+        lowlink[u] = min(lowlink[u], lowlink[v]);
+      }
+      if (lowlink[v] != index[v]) {
+        continue;
+      }
+
+      /* v is the root of a component */
+      unsigned scc = sccReachable.size();
+      sccReachable.push_back(BitVector(n));
+      BitVector &reachable = sccReachable.back();
+      vector<unsigned> members;
+      unsigned w;
+      do {
+        w = sccStack.back();
+        sccStack.pop_back();
+        onStack[w] = false;
+        sccOf[w] = scc;
+        members.push_back(w);
+        reachable.set(w);
+      } while (w != v);
+
+      for (vector<unsigned>::iterator i = members.begin(); i != members.end();
+           i++) {
+        vector<unsigned> &edges = callees[*i];
+        for (vector<unsigned>::iterator j = edges.begin(); j != edges.end();
+             j++) {
+          if (sccOf[*j] != scc) {
+            reachable |= sccReachable[sccOf[*j]];
+          }
+        }
+      }
+    }
+  }
+}
+
+bool ReachabilityAnalysis::hasReachabilityInfo(Function *f, bool usePA) {
+  return usePA == closureUsesPA && !sccReachable.empty() &&
+         functionIds.find(f) != functionIds.end();
+}
+
+bool ReachabilityAnalysis::isReachable(Function *f, Function *g) {
+  DenseMap<Function *, unsigned>::iterator i = functionIds.find(f);
+  assert(i != functionIds.end());
+  DenseMap<Function *, unsigned>::iterator j = functionIds.find(g);
+  if (j == functionIds.end()) {
+    return false;
+  }
+
+  return sccReachable[sccOf[i->second]].test(j->second);
 }
 
 void ReachabilityAnalysis::computeReachableFunctions(Function *entry,
                                                      bool usePA,
                                                      FunctionSet &results) {
+  if (hasReachabilityInfo(entry, usePA)) {
+    FunctionSet &reachable = getReachableFunctions(entry);
+    results.insert(reachable.begin(), reachable.end());
+    return;
+  }
+
   stack<Function *> stack;
   FunctionSet pushed;
 
@@ -323,11 +478,21 @@ void ReachabilityAnalysis::updateRetMap(Instruction *callInst,
 ReachabilityAnalysis::FunctionSet &
 ReachabilityAnalysis::getReachableFunctions(Function *f) {
   ReachabilityMap::iterator i = reachabilityMap.find(f);
-  if (i == reachabilityMap.end()) {
+  if (i != reachabilityMap.end()) {
+    return i->second;
+  }
+
+  DenseMap<Function *, unsigned>::iterator id = functionIds.find(f);
+  if (id == functionIds.end()) {
     assert(false);
   }
 
-  return i->second;
+  FunctionSet &result = reachabilityMap[f];
+  BitVector &reachable = sccReachable[sccOf[id->second]];
+  for (int j = reachable.find_first(); j != -1; j = reachable.find_next(j)) {
+    result.insert(functions[j]);
+  }
+  return result;
 }
 
 void
@@ -46,6 +46,7 @@ void SliceGenerator::generate() {
     for (ModRefAnalysis::SideEffects::iterator i = sideEffects.begin(); i != sideEffects.end(); i++) {
         generateSlice(i->getFunction(), i->id, i->type);
     }
+    Slicer::saveModule(module);
 }
 
 void SliceGenerator::generateSlice(Function *f, uint32_t sliceId, ModRefAnalysis::SideEffectType type) {
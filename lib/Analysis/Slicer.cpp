@@ -112,10 +112,17 @@ enum PtaType {
 llvm::cl::OptionCategory SlicingOpts("Slicer options", "");
 
 llvm::cl::opt<std::string> output("o",
-    llvm::cl::desc("Save the output to given file. If not specified,\n"
-                   "a .sliced suffix is used with the original module name."),
+    llvm::cl::desc("Save the sliced module to given file (-save-sliced-module).\n"
+                   "If not specified, a .sliced suffix is used with the original\n"
+                   "module name."),
     llvm::cl::value_desc("filename"), llvm::cl::init(""), llvm::cl::cat(SlicingOpts));
 
+llvm::cl::opt<bool> save_sliced_module("save-sliced-module",
+    llvm::cl::desc("Save the module with the generated slices (see -o). Only\n"
+                   "rank 0 writes it, once the slices are generated. By default\n"
+                   "the slices are only kept in memory.\n"),
+                   llvm::cl::init(false), llvm::cl::cat(SlicingOpts));
+
 //llvm::cl::opt<std::string> llvmfile(llvm::cl::Positional, llvm::cl::Required,
 //    llvm::cl::desc("<input file>"), llvm::cl::init("test"), llvm::cl::cat(SlicingOpts));
 std::string llvmfile = "test";
@@ -210,11 +217,9 @@ static bool write_module(llvm::Module *M)
     // compose name if not given
     std::string fl;
     if (!output.empty()) {
-        int world_rank;
-        MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
-        fl = output+std::to_string(world_rank);
+        fl = output;
     } else {
-        fl = llvmfile;
+        fl = M->getModuleIdentifier();
         replace_suffix(fl, ".sliced");
     }
 
@@ -326,6 +331,21 @@ int Slicer::run()
     // fix linkage of declared functions (if needs to be fixed)
     make_declarations_external();
 
+    // the slices stay in the module, see saveModule
+    return 0;
+}
+
+int Slicer::saveModule(llvm::Module *M)
+{
+    if (!save_sliced_module)
+        return 0;
+
+    // the ranks generate the same slices, one copy is enough
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    if (world_rank != 0)
+        return 0;
+
     return save_module(M, false);
 }
 
@@ -21,6 +21,13 @@ UseFastCexSolver("use-fast-cex-solver",
 		 llvm::cl::init(false),
 		 llvm::cl::desc("(default=off)"));
 
+llvm::cl::opt<bool>
+UseKnownBitsSolver("use-known-bits-solver",
+                   llvm::cl::init(false),
+                   llvm::cl::desc("Answer the queries decided by the known "
+                                  "bits and intervals of their expressions "
+                                  "without the core solver (default=off)"));
+
 llvm::cl::opt<bool>
 UseCexCache("use-cex-cache",
             llvm::cl::init(true),
@@ -36,6 +43,11 @@ UseIndependentSolver("use-independent-solver",
                      llvm::cl::init(true),
                      llvm::cl::desc("Use constraint independence (default=on)"));
 
+llvm::cl::opt<unsigned>
+IndependentSolverJobs("independent-solver-jobs",
+                      llvm::cl::desc("Solve the independent factors of a query for initial values in up to this many processes, forked for the query (default=1)"),
+                      llvm::cl::init(1));
+
 llvm::cl::opt<bool>
 DebugValidateSolver("debug-validate-solver",
 		             llvm::cl::init(false));
@@ -59,11 +71,26 @@ UseForkedCoreSolver("use-forked-solver",
              llvm::cl::desc("Run the core SMT solver in a forked process (default=on)"),
              llvm::cl::init(false));
 
+llvm::cl::opt<bool>
+UseIncrementalCoreSolver("use-incremental-solver",
+             llvm::cl::desc("Keep the constraints of the last query asserted in the core SMT solver (STP or Z3) and only pop and push the ones the next query does not share (default=off)"),
+             llvm::cl::init(false));
+
 llvm::cl::opt<bool>
 CoreSolverOptimizeDivides("solver-optimize-divides", 
                  llvm::cl::desc("Optimize constant divides into add/shift/multiplies before passing to core SMT solver (default=off)"),
                  llvm::cl::init(false));
 
+llvm::cl::opt<unsigned>
+MaxSolverTermCache("max-solver-term-cache",
+             llvm::cl::desc("Keep the terms the core SMT solver (STP or Z3) built for expressions and update lists across queries, until there are more than this many of either (default=100000, 0=drop them after every query)"),
+             llvm::cl::init(100000));
+
+llvm::cl::opt<unsigned>
+BitvectorArraySize("bitvector-array-size",
+             llvm::cl::desc("Encode the symbolic arrays of at most this many bytes as one bitvector variable per byte in the core SMT solver (STP or Z3), so reads at constant indices need no array theory (default=0 (off))"),
+             llvm::cl::init(0));
+
 
 /* Using cl::list<> instead of cl::bits<> results in quite a bit of ugliness when it comes to checking
  * if an option is set. Unfortunately with gcc4.7 cl::bits<> is broken with LLVM2.9 and I doubt everyone
@@ -77,6 +104,8 @@ llvm::cl::list<QueryLoggingSolverType> queryLoggingOptions(
         clEnumValN(ALL_SMTLIB,"all:smt2","All queries in .smt2 (SMT-LIBv2) format"),
         clEnumValN(SOLVER_KQUERY,"solver:kquery","All queries reaching the solver in .kquery (KQuery) format"),
         clEnumValN(SOLVER_SMTLIB,"solver:smt2","All queries reaching the solver in .smt2 (SMT-LIBv2) format"),
+        clEnumValN(ALL_BINARY,"all:binary","All queries in the binary query log format (.kqb)"),
+        clEnumValN(SOLVER_BINARY,"solver:binary","All queries reaching the solver in the binary query log format (.kqb)"),
         clEnumValEnd
 	),
     llvm::cl::CommaSeparated
@@ -137,9 +166,22 @@ llvm::cl::opt<CoreSolverType> CoreSolverToUse(
                      clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT" METASMT_IS_DEFAULT_STR),
                      clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
                      clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR),
+                     clEnumValN(PORTFOLIO_SOLVER, "portfolio",
+                                "Race the STP and Z3 backends which are compiled in"),
                      clEnumValEnd),
     llvm::cl::init(DEFAULT_CORE_SOLVER));
 
+llvm::cl::opt<double>
+PortfolioRaceThreshold("portfolio-race-threshold",
+           llvm::cl::desc("With --solver-backend=portfolio, race the backends on the queries of a shape which took this long on average (default=0.5s)"),
+           llvm::cl::init(0.5),
+           llvm::cl::value_desc("seconds"));
+
+llvm::cl::opt<unsigned>
+PortfolioRouteAfter("portfolio-route-after",
+           llvm::cl::desc("With --solver-backend=portfolio, stop racing on a query shape once one backend won three quarters of at least this many races on it (default=16)"),
+           llvm::cl::init(16));
+
 llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
     "debug-crosscheck-core-solver",
     llvm::cl::desc(
@@ -16,11 +16,22 @@
 #include "llvm/Support/raw_ostream.h"
 
 namespace klee {
+/// The binary logs go next to the .kquery logs, see -use-query-log.
+static std::string getBinaryLogPath(const std::string &kqueryPath) {
+  std::string suffix = ".kquery";
+  if (kqueryPath.size() >= suffix.size() &&
+      kqueryPath.compare(kqueryPath.size() - suffix.size(), suffix.size(),
+                         suffix) == 0)
+    return kqueryPath.substr(0, kqueryPath.size() - suffix.size()) + ".kqb";
+  return kqueryPath + ".kqb";
+}
+
 Solver *constructSolverChain(Solver *coreSolver,
                              std::string querySMT2LogPath,
                              std::string baseSolverQuerySMT2LogPath,
                              std::string queryKQueryLogPath,
-                             std::string baseSolverQueryKQueryLogPath) {
+                             std::string baseSolverQueryKQueryLogPath,
+                             SharedSolverCache *sharedCache) {
   Solver *solver = coreSolver;
 
   if (optionIsSet(queryLoggingOptions, SOLVER_KQUERY)) {
@@ -37,6 +48,19 @@ Solver *constructSolverChain(Solver *coreSolver,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (optionIsSet(queryLoggingOptions, SOLVER_BINARY)) {
+    std::string path = getBinaryLogPath(baseSolverQueryKQueryLogPath);
+    solver = createBinaryQueryLoggingSolver(solver, path, MinQueryTimeToLog);
+    klee_message("Logging queries that reach solver in binary format to %s\n",
+                 path.c_str());
+  }
+
+  if (sharedCache)
+    solver = createSharedCacheSolver(solver, *sharedCache);
+
+  if (UseKnownBitsSolver)
+    solver = createKnownBitsSolver(solver);
+
   if (UseFastCexSolver)
     solver = createFastCexSolver(solver);
 
@@ -65,6 +89,13 @@ Solver *constructSolverChain(Solver *coreSolver,
     klee_message("Logging all queries in .smt2 format to %s\n",
                  querySMT2LogPath.c_str());
   }
+
+  if (optionIsSet(queryLoggingOptions, ALL_BINARY)) {
+    std::string path = getBinaryLogPath(queryKQueryLogPath);
+    solver = createBinaryQueryLoggingSolver(solver, path, MinQueryTimeToLog);
+    klee_message("Logging all queries in binary format to %s\n",
+                 path.c_str());
+  }
   if (DebugCrossCheckCoreSolverWith != NO_SOLVER) {
     Solver *oracleSolver = createCoreSolver(DebugCrossCheckCoreSolverWith);
     solver = createValidatingSolver(/*s=*/solver, /*oracle=*/oracleSolver);
@@ -9,9 +9,14 @@
 
 #include "klee/Internal/ADT/KTest.h"
 
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define KTEST_VERSION 3
 #define KTEST_MAGIC_SIZE 5
@@ -20,6 +25,16 @@
 // for compatibility reasons
 #define BOUT_MAGIC "BOUT\n"
 
+#define KPACK_VERSION 1
+#define KPACK_MAGIC_SIZE 5
+#define KPACK_MAGIC "KPACK"
+/* magic and version */
+#define KPACK_HEADER_SIZE (KPACK_MAGIC_SIZE + 4)
+/* id and size of a record */
+#define KPACK_RECORD_HEADER_SIZE 8
+/* id and offset of a record */
+#define KPACK_INDEX_ENTRY_SIZE 12
+
 /***/
 
 static int read_uint32(FILE *f, unsigned *value_out) {
@@ -30,6 +45,10 @@ static int read_uint32(FILE *f, unsigned *value_out) {
   return 1;
 }
 
+static unsigned get_uint32(const unsigned char *data) {
+  return (((((data[0]<<8) + data[1])<<8) + data[2])<<8) + data[3];
+}
+
 static int write_uint32(FILE *f, unsigned value) {
   unsigned char data[4];
   data[0] = value>>24;
@@ -91,13 +110,10 @@ int kTest_isKTestFile(const char *path) {
   return res;
 }
 
-KTest *kTest_fromFile(const char *path) {
-  FILE *f = fopen(path, "rb");
+static KTest *kTest_fromStream(FILE *f) {
   KTest *res = 0;
   unsigned i, version;
 
-  if (!f) 
-    goto error;
   if (!kTest_checkHeader(f)) 
     goto error;
 
@@ -146,8 +162,6 @@ KTest *kTest_fromFile(const char *path) {
       goto error;
   }
 
-  fclose(f);
-
   return res;
  error:
   if (res) {
@@ -170,53 +184,193 @@ KTest *kTest_fromFile(const char *path) {
     free(res);
   }
 
-  if (f) fclose(f);
-
   return 0;
 }
 
-int kTest_toFile(KTest *bo, const char *path) {
-  FILE *f = fopen(path, "wb");
+KTest *kTest_fromFile(const char *path) {
+  FILE *f = fopen(path, "rb");
+  KTest *res;
+
+  if (!f)
+    return 0;
+  res = kTest_fromStream(f);
+  fclose(f);
+
+  return res;
+}
+
+/* reads a number of the image of a .ktest file at *pos */
+static int take_uint32(const unsigned char *data, size_t size, size_t *pos,
+                       unsigned *value_out) {
+  if (size - *pos < 4)
+    return 0;
+  *value_out = get_uint32(data + *pos);
+  *pos += 4;
+  return 1;
+}
+
+/* returns the bytes of the field at *pos, which follow their number */
+static const unsigned char *take_field(const unsigned char *data, size_t size,
+                                       size_t *pos, unsigned *len_out) {
+  if (!take_uint32(data, size, pos, len_out) || size - *pos < *len_out)
+    return 0;
+  const unsigned char *field = data + *pos;
+  *pos += *len_out;
+  return field;
+}
+
+/* walks the image of a .ktest file; with strings, fills in the arguments
+   and objects of res, copying their strings there, and otherwise only
+   checks the image and adds up the bytes of the strings */
+static int kTest_walkImage(const unsigned char *data, size_t size, KTest *res,
+                           char *strings, size_t *stringBytes_out) {
+  size_t pos = KTEST_MAGIC_SIZE, used = 0;
+  const unsigned char *field;
+  unsigned i, len;
+
+  if (size < KTEST_MAGIC_SIZE ||
+      (memcmp(data, KTEST_MAGIC, KTEST_MAGIC_SIZE) &&
+       memcmp(data, BOUT_MAGIC, KTEST_MAGIC_SIZE)))
+    return 0;
+  if (!take_uint32(data, size, &pos, &res->version) ||
+      res->version > kTest_getCurrentVersion())
+    return 0;
+
+  if (!take_uint32(data, size, &pos, &res->numArgs))
+    return 0;
+  for (i=0; i<res->numArgs; i++) {
+    if (!(field = take_field(data, size, &pos, &len)))
+      return 0;
+    if (strings) {
+      res->args[i] = strings + used;
+      memcpy(res->args[i], field, len);
+      res->args[i][len] = 0;
+    }
+    used += len + 1;
+  }
+
+  if (res->version >= 2) {
+    if (!take_uint32(data, size, &pos, &res->symArgvs) ||
+        !take_uint32(data, size, &pos, &res->symArgvLen))
+      return 0;
+  }
+
+  if (!take_uint32(data, size, &pos, &res->numObjects))
+    return 0;
+  for (i=0; i<res->numObjects; i++) {
+    if (!(field = take_field(data, size, &pos, &len)))
+      return 0;
+    if (strings) {
+      KTestObject *o = &res->objects[i];
+      o->name = strings + used;
+      memcpy(o->name, field, len);
+      o->name[len] = 0;
+    }
+    used += len + 1;
+    unsigned numBytes;
+    const unsigned char *bytes = take_field(data, size, &pos, &numBytes);
+    if (!bytes)
+      return 0;
+    if (strings) {
+      res->objects[i].numBytes = numBytes;
+      res->objects[i].bytes = (unsigned char*) bytes;
+    }
+  }
+
+  *stringBytes_out = used;
+  return 1;
+}
+
+KTest *kTest_mapFile(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  struct stat st;
+  if (fstat(fd, &st) || !st.st_size) {
+    close(fd);
+    return 0;
+  }
+  size_t size = st.st_size;
+  void *base = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return 0;
+  const unsigned char *data = (const unsigned char*) base;
+
+  KTest *res = (KTest*) calloc(1, sizeof(*res));
+  size_t stringBytes;
+  if (!res || !kTest_walkImage(data, size, res, 0, &stringBytes)) {
+    free(res);
+    munmap(base, size);
+    return 0;
+  }
+
+  /* a single block holds the objects, the arguments and their strings */
+  size_t objectBytes = res->numObjects * sizeof(*res->objects);
+  size_t argBytes = res->numArgs * sizeof(*res->args);
+  size_t blockBytes = objectBytes + argBytes + stringBytes;
+  char *block = (char*) malloc(blockBytes);
+  if (!block && blockBytes) {
+    free(res);
+    munmap(base, size);
+    return 0;
+  }
+  res->objects = (KTestObject*) block;
+  res->args = (char**) (block + objectBytes);
+  kTest_walkImage(data, size, res, block + objectBytes + argBytes,
+                  &stringBytes);
+  res->mapping = base;
+  res->mappingSize = size;
+
+  return res;
+}
+
+static int kTest_toStream(KTest *bo, FILE *f) {
   unsigned i;
 
-  if (!f) 
-    goto error;
   if (fwrite(KTEST_MAGIC, strlen(KTEST_MAGIC), 1, f)!=1)
-    goto error;
+    return 0;
   if (!write_uint32(f, KTEST_VERSION))
-    goto error;
+    return 0;
       
   if (!write_uint32(f, bo->numArgs))
-    goto error;
+    return 0;
   for (i=0; i<bo->numArgs; i++) {
     if (!write_string(f, bo->args[i]))
-      goto error;
+      return 0;
   }
 
   if (!write_uint32(f, bo->symArgvs))
-    goto error;
+    return 0;
   if (!write_uint32(f, bo->symArgvLen))
-    goto error;
+    return 0;
   
   if (!write_uint32(f, bo->numObjects))
-    goto error;
+    return 0;
   for (i=0; i<bo->numObjects; i++) {
     KTestObject *o = &bo->objects[i];
     if (!write_string(f, o->name))
-      goto error;
+      return 0;
     if (!write_uint32(f, o->numBytes))
-      goto error;
+      return 0;
     if (fwrite(o->bytes, o->numBytes, 1, f)!=1)
-      goto error;
+      return 0;
   }
 
-  fclose(f);
-
   return 1;
- error:
-  if (f) fclose(f);
-  
-  return 0;
+}
+
+int kTest_toFile(KTest *bo, const char *path) {
+  FILE *f = fopen(path, "wb");
+  int res;
+
+  if (!f)
+    return 0;
+  res = kTest_toStream(bo, f);
+  if (fclose(f))
+    res = 0;
+
+  return res;
 }
 
 unsigned kTest_numBytes(KTest *bo) {
@@ -228,6 +382,12 @@ unsigned kTest_numBytes(KTest *bo) {
 
 void kTest_free(KTest *bo) {
   unsigned i;
+  if (bo->mapping) {
+    munmap(bo->mapping, bo->mappingSize);
+    free(bo->objects);
+    free(bo);
+    return;
+  }
   for (i=0; i<bo->numArgs; i++)
     free(bo->args[i]);
   free(bo->args);
@@ -238,3 +398,208 @@ void kTest_free(KTest *bo) {
   free(bo->objects);
   free(bo);
 }
+
+/***/
+
+/* A container is a header followed by records, each the id and size of a
+   test case and then its .ktest image; records are only ever appended, and
+   the index file next to it lists the id and offset of every record. The
+   index may lag behind the container after a crash, the records past its
+   end are then found by walking the container. */
+
+struct KTestPack {
+  unsigned char *base;
+  size_t size;
+  unsigned numTests;
+  unsigned capacity;
+  unsigned *ids;
+  size_t *offsets;
+};
+
+static int kTestPack_push(KTestPack *pack, unsigned id, size_t offset) {
+  if (pack->numTests == pack->capacity) {
+    unsigned capacity = pack->capacity ? 2 * pack->capacity : 64;
+    unsigned *ids = (unsigned*) realloc(pack->ids, capacity * sizeof(*ids));
+    if (!ids)
+      return 0;
+    pack->ids = ids;
+    size_t *offsets = (size_t*) realloc(pack->offsets,
+                                        capacity * sizeof(*offsets));
+    if (!offsets)
+      return 0;
+    pack->offsets = offsets;
+    pack->capacity = capacity;
+  }
+  pack->ids[pack->numTests] = id;
+  pack->offsets[pack->numTests] = offset;
+  pack->numTests++;
+  return 1;
+}
+
+/* the offset past the record at offset, or 0 if it is cut short */
+static size_t kTestPack_next(KTestPack *pack, size_t offset) {
+  if (pack->size - offset < KPACK_RECORD_HEADER_SIZE)
+    return 0;
+  size_t size = get_uint32(pack->base + offset + 4);
+  if (pack->size - offset - KPACK_RECORD_HEADER_SIZE < size)
+    return 0;
+  return offset + KPACK_RECORD_HEADER_SIZE + size;
+}
+
+static void kTestPack_readIndex(KTestPack *pack, const char *path) {
+  char *indexPath = (char*) malloc(strlen(path) + 5);
+  if (!indexPath)
+    return;
+  strcpy(indexPath, path);
+  strcat(indexPath, ".idx");
+  FILE *f = fopen(indexPath, "rb");
+  free(indexPath);
+  if (!f)
+    return;
+
+  size_t end = KPACK_HEADER_SIZE;
+  unsigned id, hi, lo;
+  while (read_uint32(f, &id) && read_uint32(f, &hi) && read_uint32(f, &lo)) {
+    size_t offset = ((uint64_t) hi << 32) | lo;
+    /* only trust entries which follow the records found so far */
+    if (offset != end)
+      break;
+    size_t next = kTestPack_next(pack, offset);
+    if (!next || get_uint32(pack->base + offset) != id ||
+        !kTestPack_push(pack, id, offset))
+      break;
+    end = next;
+  }
+  fclose(f);
+}
+
+int kTest_appendToPack(KTest *bo, unsigned id, const char *path) {
+  char *image = 0;
+  size_t size = 0;
+  FILE *f = open_memstream(&image, &size);
+  if (!f)
+    return 0;
+  int res = kTest_toStream(bo, f);
+  if (fclose(f) || !res) {
+    free(image);
+    return 0;
+  }
+
+  char *indexPath = (char*) malloc(strlen(path) + 5);
+  if (!indexPath) {
+    free(image);
+    return 0;
+  }
+  strcpy(indexPath, path);
+  strcat(indexPath, ".idx");
+
+  f = fopen(path, "ab");
+  FILE *index = fopen(indexPath, "ab");
+  free(indexPath);
+  res = f && index;
+  if (res) {
+    /* in append mode the position is only known after seeking to the end */
+    res = !fseek(f, 0, SEEK_END);
+    long offset = ftell(f);
+    res = res && offset >= 0;
+    if (res && !offset) {
+      res = fwrite(KPACK_MAGIC, KPACK_MAGIC_SIZE, 1, f)==1 &&
+            write_uint32(f, KPACK_VERSION);
+      offset = KPACK_HEADER_SIZE;
+    }
+    res = res && write_uint32(f, id) && write_uint32(f, size) &&
+          fwrite(image, size, 1, f)==1;
+    /* the record must be complete before it is indexed */
+    res = res && !fflush(f) &&
+          write_uint32(index, id) &&
+          write_uint32(index, (uint64_t) offset >> 32) &&
+          write_uint32(index, (uint64_t) offset);
+  }
+  if (f && fclose(f))
+    res = 0;
+  if (index && fclose(index))
+    res = 0;
+  free(image);
+
+  return res;
+}
+
+KTestPack *kTestPack_open(const char *path) {
+  KTestPack *pack = (KTestPack*) calloc(1, sizeof(*pack));
+  if (!pack)
+    return 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    free(pack);
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || (size_t) st.st_size < KPACK_HEADER_SIZE) {
+    close(fd);
+    free(pack);
+    return 0;
+  }
+  pack->size = st.st_size;
+  void *base = mmap(0, pack->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    free(pack);
+    return 0;
+  }
+  pack->base = (unsigned char*) base;
+
+  if (memcmp(pack->base, KPACK_MAGIC, KPACK_MAGIC_SIZE) ||
+      get_uint32(pack->base + KPACK_MAGIC_SIZE) > KPACK_VERSION) {
+    kTestPack_close(pack);
+    return 0;
+  }
+
+  kTestPack_readIndex(pack, path);
+  size_t offset = KPACK_HEADER_SIZE;
+  if (pack->numTests)
+    offset = kTestPack_next(pack, pack->offsets[pack->numTests - 1]);
+  for (size_t next; (next = kTestPack_next(pack, offset)); offset = next) {
+    if (!kTestPack_push(pack, get_uint32(pack->base + offset), offset))
+      break;
+  }
+
+  return pack;
+}
+
+unsigned kTestPack_numTests(KTestPack *pack) {
+  return pack->numTests;
+}
+
+unsigned kTestPack_getId(KTestPack *pack, unsigned i) {
+  return pack->ids[i];
+}
+
+const unsigned char *kTestPack_getImage(KTestPack *pack, unsigned i,
+                                        unsigned *size_out) {
+  const unsigned char *record = pack->base + pack->offsets[i];
+  *size_out = get_uint32(record + 4);
+  return record + KPACK_RECORD_HEADER_SIZE;
+}
+
+KTest *kTestPack_getTest(KTestPack *pack, unsigned i) {
+  unsigned size;
+  const unsigned char *image = kTestPack_getImage(pack, i, &size);
+  if (!size)
+    return 0;
+  FILE *f = fmemopen((void*) image, size, "rb");
+  if (!f)
+    return 0;
+  KTest *res = kTest_fromStream(f);
+  fclose(f);
+
+  return res;
+}
+
+void kTestPack_close(KTestPack *pack) {
+  if (pack->base)
+    munmap(pack->base, pack->size);
+  free(pack->ids);
+  free(pack->offsets);
+  free(pack);
+}
@@ -9,35 +9,81 @@
 
 #include "klee/Statistics.h"
 
+#include <cassert>
 #include <vector>
 
 using namespace klee;
 
+thread_local StatisticSlot *klee::threadStatisticSlot = 0;
+
+namespace {
+  /// Hands the slot of an exiting thread back to the manager.
+  struct SlotReleaser {
+    ~SlotReleaser() {
+      if (threadStatisticSlot && theStatisticManager)
+        theStatisticManager->releaseSlot(threadStatisticSlot);
+      threadStatisticSlot = 0;
+    }
+  };
+}
+
+StatisticSlot::StatisticSlot() {
+  for (unsigned i = 0; i < MaxStatistics; i++)
+    values[i].store(0, std::memory_order_relaxed);
+}
+
 StatisticManager::StatisticManager()
   : enabled(true),
-    globalStats(0),
+    numSlots(0),
+    indexedSlot(0),
     indexedStats(0),
     contextStats(0),
     index(0) {
 }
 
 StatisticManager::~StatisticManager() {
-  if (globalStats) delete[] globalStats;
+  // the slots are left to the other threads, which may still add to them
   if (indexedStats) delete[] indexedStats;
 }
 
+StatisticSlot *StatisticManager::acquireSlot() {
+  static thread_local SlotReleaser releaser;
+  (void) releaser;
+
+  std::lock_guard<std::mutex> guard(slotLock);
+  if (!freeSlots.empty()) {
+    // its values stay counted, the thread goes on adding to them
+    threadStatisticSlot = freeSlots.back();
+    freeSlots.pop_back();
+    return threadStatisticSlot;
+  }
+  unsigned n = numSlots.load(std::memory_order_relaxed);
+  assert(n < MaxThreads && "too many threads add to the statistics");
+  threadStatisticSlot = new StatisticSlot();
+  slots[n].store(threadStatisticSlot, std::memory_order_release);
+  numSlots.store(n + 1, std::memory_order_release);
+  return threadStatisticSlot;
+}
+
+void StatisticManager::releaseSlot(StatisticSlot *slot) {
+  std::lock_guard<std::mutex> guard(slotLock);
+  if (slot == indexedSlot)
+    return;
+  freeSlots.push_back(slot);
+}
+
 void StatisticManager::useIndexedStats(unsigned totalIndices) {  
+  indexedSlot = threadStatisticSlot ? threadStatisticSlot : acquireSlot();
   if (indexedStats) delete[] indexedStats;
   indexedStats = new uint64_t[totalIndices * stats.size()];
   memset(indexedStats, 0, sizeof(*indexedStats) * totalIndices * stats.size());
 }
 
 void StatisticManager::registerStatistic(Statistic &s) {
-  if (globalStats) delete[] globalStats;
+  assert(stats.size() < StatisticSlot::MaxStatistics &&
+         "too many statistics for a slot");
   s.id = stats.size();
   stats.push_back(&s);
-  globalStats = new uint64_t[stats.size()];
-  memset(globalStats, 0, sizeof(*globalStats)*stats.size());
 }
 
 int StatisticManager::getStatisticID(const std::string &name) const {
@@ -14,7 +14,11 @@
 
 #include "klee/Expr.h"
 #include "klee/TimerStatIncrementer.h"
+
+#include <algorithm>
 #include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
 
 
 using namespace klee;
@@ -25,14 +29,29 @@ void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
   objects = objects.replace(std::make_pair(mo, os));
+  invalidateResolveCache();
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
   objects = objects.remove(mo);
+  invalidateResolveCache();
+}
+
+void AddressSpace::bindConstant(const MemoryObject *mo, ObjectState *os) {
+  assert(os->readOnly && "constant object is writable");
+  constants = constants.replace(std::make_pair(mo, os));
+  objects = objects.remove(mo);
+  invalidateResolveCache();
+
+  // never written again, so externals only need the contents once
+  if (!mo->isUserSpecified)
+    os->readStore(0, (uint8_t*) (unsigned long) mo->address, mo->size);
 }
 
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
   const MemoryMap::value_type *res = objects.lookup(mo);
+  if (!res)
+    res = constants.lookup(mo);
   
   return res ? res->second : 0;
 }
@@ -47,31 +66,134 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
     ObjectState *n = new ObjectState(*os);
     n->copyOnWriteOwner = cowKey;
     objects = objects.replace(std::make_pair(mo, n));
+    invalidateResolveCache();
     return n;    
   }
 }
 
 /// 
 
+bool AddressSpace::ResolveCacheEntry::contains(uint64_t address,
+                                               unsigned current) const {
+  if (generation != current)
+    return false;
+  const MemoryObject *mo = op.first;
+  return (mo->size==0 && address==mo->address) ||
+         (address - mo->address < mo->size);
+}
+
 bool AddressSpace::resolveOne(const ref<ConstantExpr> &addr, 
                               ObjectPair &result) {
   uint64_t address = addr->getZExtValue();
+
+  if (lastResolved.contains(address, generation)) {
+    result = lastResolved.op;
+    return true;
+  }
+  ResolveCacheEntry &entry = resolveCache[(address >> 4) % ResolveCacheSize];
+  if (entry.contains(address, generation)) {
+    lastResolved = entry;
+    result = entry.op;
+    return true;
+  }
+
   MemoryObject hack(address);
 
-  if (const MemoryMap::value_type *res = objects.lookup_previous(&hack)) {
-    const MemoryObject *mo = res->first;
-    // Check if the provided address is between start and end of the object
-    // [mo->address, mo->address + mo->size) or the object is a 0-sized object.
-    if ((mo->size==0 && address==mo->address) ||
-        (address - mo->address < mo->size)) {
-      result = *res;
-      return true;
+  for (unsigned i = 0; i < 2; ++i) {
+    const MemoryMap &m = i ? constants : objects;
+    if (const MemoryMap::value_type *res = m.lookup_previous(&hack)) {
+      const MemoryObject *mo = res->first;
+      // Check if the provided address is between start and end of the
+      // object [mo->address, mo->address + mo->size) or the object is a
+      // 0-sized object.
+      if ((mo->size==0 && address==mo->address) ||
+          (address - mo->address < mo->size)) {
+        result = *res;
+        entry.op = *res;
+        entry.generation = generation;
+        lastResolved = entry;
+        return true;
+      }
     }
   }
 
   return false;
 }
 
+/// Conservative bounds of the value of e, found from its structure alone
+/// down to a small depth.
+static void getBounds(const ref<Expr> &e, uint64_t &min, uint64_t &max,
+                      unsigned depth = 0) {
+  Expr::Width width = e->getWidth();
+  min = 0;
+  max = width >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << width) - 1;
+  if (width > 64 || depth > 8)
+    return;
+
+  uint64_t lo, hi, lo2, hi2;
+  switch (e->getKind()) {
+  case Expr::Constant:
+    min = max = cast<ConstantExpr>(e)->getZExtValue();
+    return;
+
+  case Expr::ZExt:
+    getBounds(e->getKid(0), min, max, depth + 1);
+    return;
+
+  case Expr::Add:
+    getBounds(e->getKid(0), lo, hi, depth + 1);
+    getBounds(e->getKid(1), lo2, hi2, depth + 1);
+    if (hi > max - hi2)
+      return;
+    min = lo + lo2;
+    max = hi + hi2;
+    return;
+
+  case Expr::Mul:
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(0))) {
+      uint64_t factor = CE->getZExtValue();
+      getBounds(e->getKid(1), lo, hi, depth + 1);
+      if (factor && hi > max / factor)
+        return;
+      min = lo * factor;
+      max = hi * factor;
+    }
+    return;
+
+  case Expr::Shl:
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1))) {
+      uint64_t shift = CE->getZExtValue();
+      getBounds(e->getKid(0), lo, hi, depth + 1);
+      if (shift >= width || hi > max >> shift)
+        return;
+      min = lo << shift;
+      max = hi << shift;
+    }
+    return;
+
+  case Expr::And:
+    getBounds(e->getKid(0), lo, hi, depth + 1);
+    getBounds(e->getKid(1), lo2, hi2, depth + 1);
+    max = std::min(hi, hi2);
+    return;
+
+  case Expr::Select:
+    getBounds(e->getKid(1), lo, hi, depth + 1);
+    getBounds(e->getKid(2), lo2, hi2, depth + 1);
+    min = std::min(lo, lo2);
+    max = std::max(hi, hi2);
+    return;
+
+  default:
+    return;
+  }
+}
+
+/// the end of mo, counting a 0-sized object as one byte
+static uint64_t getObjectEnd(const MemoryObject *mo) {
+  return mo->address + (mo->size ? mo->size : 1);
+}
+
 bool AddressSpace::resolveOne(ExecutionState &state,
                               TimingSolver *solver,
                               ref<Expr> address,
@@ -90,76 +212,100 @@ bool AddressSpace::resolveOne(ExecutionState &state,
       return false;
     uint64_t example = cex->getZExtValue();
     MemoryObject hack(example);
-    const MemoryMap::value_type *res = objects.lookup_previous(&hack);
-    
-    if (res) {
-      const MemoryObject *mo = res->first;
-      if (example - mo->address < mo->size) {
-        result = *res;
-        success = true;
-        return true;
+    for (unsigned i = 0; i < 2; ++i) {
+      const MemoryMap &m = i ? constants : objects;
+      const MemoryMap::value_type *res = m.lookup_previous(&hack);
+      if (res) {
+        const MemoryObject *mo = res->first;
+        if (example - mo->address < mo->size) {
+          result = *res;
+          success = true;
+          return true;
+        }
       }
     }
 
     // didn't work, now we have to search
-       
-    MemoryMap::iterator oi = objects.upper_bound(&hack);
-    MemoryMap::iterator begin = objects.begin();
-    MemoryMap::iterator end = objects.end();
+    if (!searchOne(objects, state, solver, address, example, result,
+                   success))
+      return false;
+    if (success)
+      return true;
+    return searchOne(constants, state, solver, address, example, result,
+                     success);
+  }
+}
+
+bool AddressSpace::searchOne(const MemoryMap &m, ExecutionState &state,
+                             TimingSolver *solver, ref<Expr> address,
+                             uint64_t example, ObjectPair &result,
+                             bool &success) {
+  MemoryObject hack(example);
+  MemoryMap::iterator oi = m.upper_bound(&hack);
+  MemoryMap::iterator begin = m.begin();
+  MemoryMap::iterator end = m.end();
+    
+  // The objects outside the bounds of the address are pruned without
+  // asking the solver.
+  uint64_t minAddress, maxAddress;
+  getBounds(address, minAddress, maxAddress);
+
+  MemoryMap::iterator start = oi;
+  while (oi!=begin) {
+    --oi;
+    const MemoryObject *mo = oi->first;
+    if (getObjectEnd(mo) <= minAddress)
+      break;
       
-    MemoryMap::iterator start = oi;
-    while (oi!=begin) {
-      --oi;
-      const MemoryObject *mo = oi->first;
-        
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(state, 
+                           mo->getBoundsCheckPointer(address), mayBeTrue))
+      return false;
+    if (mayBeTrue) {
+      result = *oi;
+      success = true;
+      return true;
+    } else {
+      bool mustBeTrue = true;
+      if (mo->address > minAddress &&
+          !solver->mustBeTrue(state, 
+                              UgeExpr::create(address, mo->getBaseExpr()),
+                              mustBeTrue))
+        return false;
+      if (mustBeTrue)
+        break;
+    }
+  }
+
+  // search forwards
+  for (oi=start; oi!=end; ++oi) {
+    const MemoryObject *mo = oi->first;
+
+    bool mustBeTrue = true;
+    if (mo->address <= maxAddress &&
+        !solver->mustBeTrue(state, 
+                            UltExpr::create(address, mo->getBaseExpr()),
+                            mustBeTrue))
+      return false;
+    if (mustBeTrue) {
+      break;
+    } else {
       bool mayBeTrue;
+
       if (!solver->mayBeTrue(state, 
-                             mo->getBoundsCheckPointer(address), mayBeTrue))
+                             mo->getBoundsCheckPointer(address),
+                             mayBeTrue))
         return false;
       if (mayBeTrue) {
         result = *oi;
         success = true;
         return true;
-      } else {
-        bool mustBeTrue;
-        if (!solver->mustBeTrue(state, 
-                                UgeExpr::create(address, mo->getBaseExpr()),
-                                mustBeTrue))
-          return false;
-        if (mustBeTrue)
-          break;
-      }
-    }
-
-    // search forwards
-    for (oi=start; oi!=end; ++oi) {
-      const MemoryObject *mo = oi->first;
-
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state, 
-                              UltExpr::create(address, mo->getBaseExpr()),
-                              mustBeTrue))
-        return false;
-      if (mustBeTrue) {
-        break;
-      } else {
-        bool mayBeTrue;
-
-        if (!solver->mayBeTrue(state, 
-                               mo->getBoundsCheckPointer(address),
-                               mayBeTrue))
-          return false;
-        if (mayBeTrue) {
-          result = *oi;
-          success = true;
-          return true;
-        }
       }
     }
-
-    success = false;
-    return true;
   }
+
+  success = false;
+  return true;
 }
 
 bool AddressSpace::resolve(ExecutionState &state,
@@ -196,90 +342,118 @@ bool AddressSpace::resolve(ExecutionState &state,
     if (!solver->getValue(state, p, cex))
       return true;
     uint64_t example = cex->getZExtValue();
-    MemoryObject hack(example);
+    bool unique = false;
+    if (search(objects, state, solver, p, example, rl, maxResolutions,
+               timeout_us, timer, unique))
+      return true;
+    if (unique)
+      return false;
+    return search(constants, state, solver, p, example, rl, maxResolutions,
+                  timeout_us, timer, unique);
+  }
+}
+
+bool AddressSpace::search(const MemoryMap &m, ExecutionState &state,
+                          TimingSolver *solver, ref<Expr> p, uint64_t example,
+                          ResolutionList &rl, unsigned maxResolutions,
+                          uint64_t timeout_us, TimerStatIncrementer &timer,
+                          bool &unique) {
+  MemoryObject hack(example);
+
+  MemoryMap::iterator oi = m.upper_bound(&hack);
+  MemoryMap::iterator begin = m.begin();
+  MemoryMap::iterator end = m.end();
     
-    MemoryMap::iterator oi = objects.upper_bound(&hack);
-    MemoryMap::iterator begin = objects.begin();
-    MemoryMap::iterator end = objects.end();
-      
-    MemoryMap::iterator start = oi;
-      
-    // XXX in the common case we can save one query if we ask
-    // mustBeTrue before mayBeTrue for the first result. easy
-    // to add I just want to have a nice symbolic test case first.
-      
-    // search backwards, start with one minus because this
-    // is the object that p *should* be within, which means we
-    // get write off the end with 4 queries (XXX can be better,
-    // no?)
-    while (oi!=begin) {
-      --oi;
-      const MemoryObject *mo = oi->first;
-      if (timeout_us && timeout_us < timer.check())
-        return true;
+  MemoryMap::iterator start = oi;
 
-      // XXX I think there is some query wasteage here?
-      ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
-      bool mayBeTrue;
-      if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
-        return true;
-      if (mayBeTrue) {
-        rl.push_back(*oi);
-        
-        // fast path check
-        unsigned size = rl.size();
-        if (size==1) {
-          bool mustBeTrue;
-          if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
-            return true;
-          if (mustBeTrue)
-            return false;
-        } else if (size==maxResolutions) {
+  // The objects outside the bounds of p are pruned without asking the
+  // solver.
+  uint64_t minAddress, maxAddress;
+  getBounds(p, minAddress, maxAddress);
+    
+  // XXX in the common case we can save one query if we ask
+  // mustBeTrue before mayBeTrue for the first result. easy
+  // to add I just want to have a nice symbolic test case first.
+    
+  // search backwards, start with one minus because this
+  // is the object that p *should* be within, which means we
+  // get write off the end with 4 queries (XXX can be better,
+  // no?)
+  while (oi!=begin) {
+    --oi;
+    const MemoryObject *mo = oi->first;
+    if (timeout_us && timeout_us < timer.check())
+      return true;
+    if (getObjectEnd(mo) <= minAddress)
+      break;
+
+    // XXX I think there is some query wasteage here?
+    ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
+      return true;
+    if (mayBeTrue) {
+      rl.push_back(*oi);
+      
+      // fast path check
+      unsigned size = rl.size();
+      if (size==1) {
+        bool mustBeTrue;
+        if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
           return true;
+        if (mustBeTrue) {
+          unique = true;
+          return false;
         }
-      }
-        
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state, 
-                              UgeExpr::create(p, mo->getBaseExpr()),
-                              mustBeTrue))
+      } else if (size==maxResolutions) {
         return true;
-      if (mustBeTrue)
-        break;
+      }
     }
-    // search forwards
-    for (oi=start; oi!=end; ++oi) {
-      const MemoryObject *mo = oi->first;
-      if (timeout_us && timeout_us < timer.check())
-        return true;
+      
+    bool mustBeTrue = true;
+    if (mo->address > minAddress &&
+        !solver->mustBeTrue(state, 
+                            UgeExpr::create(p, mo->getBaseExpr()),
+                            mustBeTrue))
+      return true;
+    if (mustBeTrue)
+      break;
+  }
+  // search forwards
+  for (oi=start; oi!=end; ++oi) {
+    const MemoryObject *mo = oi->first;
+    if (timeout_us && timeout_us < timer.check())
+      return true;
 
-      bool mustBeTrue;
-      if (!solver->mustBeTrue(state, 
-                              UltExpr::create(p, mo->getBaseExpr()),
-                              mustBeTrue))
-        return true;
-      if (mustBeTrue)
-        break;
+    bool mustBeTrue = true;
+    if (mo->address <= maxAddress &&
+        !solver->mustBeTrue(state, 
+                            UltExpr::create(p, mo->getBaseExpr()),
+                            mustBeTrue))
+      return true;
+    if (mustBeTrue)
+      break;
+    
+    // XXX I think there is some query wasteage here?
+    ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
+      return true;
+    if (mayBeTrue) {
+      rl.push_back(*oi);
       
-      // XXX I think there is some query wasteage here?
-      ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
-      bool mayBeTrue;
-      if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
-        return true;
-      if (mayBeTrue) {
-        rl.push_back(*oi);
-        
-        // fast path check
-        unsigned size = rl.size();
-        if (size==1) {
-          bool mustBeTrue;
-          if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
-            return true;
-          if (mustBeTrue)
-            return false;
-        } else if (size==maxResolutions) {
+      // fast path check
+      unsigned size = rl.size();
+      if (size==1) {
+        bool mustBeTrue;
+        if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
           return true;
+        if (mustBeTrue) {
+          unique = true;
+          return false;
         }
+      } else if (size==maxResolutions) {
+        return true;
       }
     }
   }
@@ -303,11 +477,23 @@ void AddressSpace::copyOutConcretes() {
       uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
       if (!os->readOnly)
-        memcpy(address, os->concreteStore, mo->size);
+        os->readStore(0, address, mo->size);
     }
   }
 }
 
+bool AddressSpace::sameObjects(const AddressSpace &b) const {
+  if (objects.size() != b.objects.size())
+    return false;
+  for (MemoryMap::iterator it = objects.begin(), ie = objects.end(),
+       bit = b.objects.begin(); it != ie; ++it, ++bit) {
+    if (it->first != bit->first ||
+        (const ObjectState *) it->second != (const ObjectState *) bit->second)
+      return false;
+  }
+  return true;
+}
+
 bool AddressSpace::copyInConcretes() {
   for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
        it != ie; ++it) {
@@ -317,12 +503,12 @@ bool AddressSpace::copyInConcretes() {
       const ObjectState *os = it->second;
       uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
-      if (memcmp(address, os->concreteStore, mo->size)!=0) {
+      if (!os->storeEquals(address)) {
         if (os->readOnly) {
           return false;
         } else {
           ObjectState *wos = getWriteable(mo, os);
-          memcpy(wos->concreteStore, address, mo->size);
+          wos->writeStore(0, address, mo->size);
         }
       }
     }
@@ -331,6 +517,33 @@ bool AddressSpace::copyInConcretes() {
   return true;
 }
 
+bool AddressSpace::protectSymbolics(std::vector<std::pair<uint64_t, uint64_t> >
+                                      &protectedPages) const {
+  uint64_t pageSize = getpagesize();
+  for (MemoryMap::iterator it = objects.begin(), ie = objects.end();
+       it != ie; ++it) {
+    const MemoryObject *mo = it->first;
+    const ObjectState *os = it->second;
+    if (mo->isUserSpecified || !mo->size ||
+        (os->isRangeConcrete(0, mo->size) && os->overlay.empty()))
+      continue;
+
+    uint64_t begin = mo->address & ~(pageSize - 1);
+    uint64_t end = (mo->address + mo->size + pageSize - 1) & ~(pageSize - 1);
+    if (mprotect((void*) (uintptr_t) begin, end - begin, PROT_NONE) != 0)
+      return false;
+    protectedPages.push_back(std::make_pair(begin, end - begin));
+  }
+  return true;
+}
+
+void AddressSpace::unprotect(const std::vector<std::pair<uint64_t, uint64_t> >
+                               &protectedPages) {
+  for (unsigned i = 0; i < protectedPages.size(); i++)
+    mprotect((void*) (uintptr_t) protectedPages[i].first,
+             protectedPages[i].second, PROT_READ | PROT_WRITE);
+}
+
 /***/
 
 bool MemoryObjectLT::operator()(const MemoryObject *a, const MemoryObject *b) const {
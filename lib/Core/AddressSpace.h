@@ -15,10 +15,14 @@
 #include "klee/Expr.h"
 #include "klee/Internal/ADT/ImmutableMap.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace klee {
   class ExecutionState;
   class MemoryObject;
   class ObjectState;
+  class TimerStatIncrementer;
   class TimingSolver;
 
   template<class T> class ref;
@@ -38,6 +42,40 @@ namespace klee {
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// A resolution of a concrete address, valid while its generation is
+    /// the current one.
+    struct ResolveCacheEntry {
+      ObjectPair op;
+      unsigned generation;
+
+      ResolveCacheEntry() : op(0, 0), generation(0) {}
+      bool contains(uint64_t address, unsigned current) const;
+    };
+    enum { ResolveCacheSize = 64 };
+
+    /// Bumped by every change of the bindings, which invalidates the
+    /// resolution cache.
+    unsigned generation;
+    /// the last resolution, then a direct-mapped table of the recent ones
+    /// indexed by address / 16
+    ResolveCacheEntry lastResolved;
+    ResolveCacheEntry resolveCache[ResolveCacheSize];
+
+    void invalidateResolveCache() { ++generation; }
+
+    /// The search of resolveOne among the objects of m.
+    bool searchOne(const MemoryMap &m, ExecutionState &state,
+                   TimingSolver *solver, ref<Expr> address, uint64_t example,
+                   ObjectPair &result, bool &success);
+
+    /// The search of resolve among the objects of m, unique is set if the
+    /// address can only be in the first object found.
+    bool search(const MemoryMap &m, ExecutionState &state,
+                TimingSolver *solver, ref<Expr> p, uint64_t example,
+                ResolutionList &rl, unsigned maxResolutions,
+                uint64_t timeout_us, TimerStatIncrementer &timer,
+                bool &unique);
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace&); 
     
@@ -50,10 +88,22 @@ namespace klee {
     ///
     /// \invariant forall o in objects, o->copyOnWriteOwner <= cowKey
     MemoryMap objects;
+
+    /// The read-only objects every state shares, as the constant globals.
+    /// They are resolved as the others, but never written and never part
+    /// of the per-state walks over objects: the copies to and from
+    /// externals, merging and serialization.
+    MemoryMap constants;
     
   public:
-    AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace() : cowKey(1), generation(1) {}
+    AddressSpace(const AddressSpace &b)
+      : cowKey(++b.cowKey), generation(b.generation),
+        lastResolved(b.lastResolved), objects(b.objects),
+        constants(b.constants) {
+      std::copy(b.resolveCache, b.resolveCache + ResolveCacheSize,
+                resolveCache);
+    }
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
@@ -94,6 +144,10 @@ namespace klee {
     /// Add a binding to the address space.
     void bindObject(const MemoryObject *mo, ObjectState *os);
 
+    /// Move a read-only object to the constants, and copy its contents
+    /// to the memory of externals once and for all.
+    void bindConstant(const MemoryObject *mo, ObjectState *os);
+
     /// Remove a binding from the address space.
     void unbindObject(const MemoryObject *mo);
 
@@ -112,6 +166,10 @@ namespace klee {
     /// \return A writeable ObjectState (\a os or a copy).
     ObjectState *getWriteable(const MemoryObject *mo, const ObjectState *os);
 
+    /// Whether both address spaces bind the same object states, as the
+    /// copies of an address space do until one of them is written.
+    bool sameObjects(const AddressSpace &b) const;
+
     /// Copy the concrete values of all managed ObjectStates into the
     /// actual system memory location they were allocated at.
     void copyOutConcretes();
@@ -125,6 +183,18 @@ namespace klee {
     /// \retval true The copy succeeded. 
     /// \retval false The copy failed because a read-only object was modified.
     bool copyInConcretes();
+
+    /// Take all access to the pages of the objects with symbolic bytes, so
+    /// that native code touching them faults rather than using their
+    /// concrete store. The pages are added to protected, also if it fails.
+    ///
+    /// \retval false A page could not be protected.
+    bool protectSymbolics(std::vector<std::pair<uint64_t, uint64_t> >
+                            &protectedPages) const;
+
+    /// Give the pages of protectSymbolics back.
+    static void unprotect(const std::vector<std::pair<uint64_t, uint64_t> >
+                            &protectedPages);
   };
 } // End klee namespace
 
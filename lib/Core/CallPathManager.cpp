@@ -13,6 +13,7 @@
 
 #include <map>
 #include <vector>
+#include <stdint.h>
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include "llvm/IR/Function.h"
 #else
@@ -49,12 +50,8 @@ void CallPathNode::print() {
 ///
 
 CallPathManager::CallPathManager() : root(0, 0, 0) {
-}
-
-CallPathManager::~CallPathManager() {
-  for (std::vector<CallPathNode*>::iterator it = paths.begin(),
-         ie = paths.end(); it != ie; ++it)
-    delete *it;
+  CacheEntry empty = { 0, 0, 0, 0 };
+  cache.assign(CacheSize, empty);
 }
 
 void CallPathManager::getSummaryStatistics(CallSiteSummaryTable &results) {
@@ -84,7 +81,8 @@ CallPathNode *CallPathManager::computeCallPath(CallPathNode *parent,
     if (cs==p->callSite && f==p->function)
       return p;
   
-  CallPathNode *cp = new CallPathNode(parent, cs, f);
+  pool.push_back(CallPathNode(parent, cs, f));
+  CallPathNode *cp = &pool.back();
   paths.push_back(cp);
   return cp;
 }
@@ -92,17 +90,30 @@ CallPathNode *CallPathManager::computeCallPath(CallPathNode *parent,
 CallPathNode *CallPathManager::getCallPath(CallPathNode *parent, 
                                            Instruction *cs,
                                            Function *f) {
-  std::pair<Instruction*,Function*> key(cs, f);
   if (!parent)
     parent = &root;
-  
+
+  uintptr_t hash = (reinterpret_cast<uintptr_t>(parent) >> 4) ^
+                   (reinterpret_cast<uintptr_t>(cs) >> 3) ^
+                   (reinterpret_cast<uintptr_t>(f) >> 5);
+  CacheEntry &entry = cache[(hash ^ (hash >> 12)) & (CacheSize - 1)];
+  if (entry.parent == parent && entry.callSite == cs && entry.function == f)
+    return entry.node;
+
+  std::pair<Instruction*,Function*> key(cs, f);
+  CallPathNode *cp;
   CallPathNode::children_ty::iterator it = parent->children.find(key);
   if (it==parent->children.end()) {
-    CallPathNode *cp = computeCallPath(parent, cs, f);
+    cp = computeCallPath(parent, cs, f);
     parent->children.insert(std::make_pair(key, cp));
-    return cp;
   } else {
-    return it->second;
+    cp = it->second;
   }
+
+  entry.parent = parent;
+  entry.callSite = cs;
+  entry.function = f;
+  entry.node = cp;
+  return cp;
 }
 
@@ -12,6 +12,7 @@
 
 #include "klee/Statistics.h"
 
+#include <deque>
 #include <map>
 #include <vector>
 
@@ -60,8 +61,22 @@ namespace klee {
   };
 
   class CallPathManager {
+    /// A direct mapped cache of recent (parent, callSite, function)
+    /// lookups, so that most calls do not search the children map.
+    struct CacheEntry {
+      CallPathNode *parent;
+      llvm::Instruction *callSite;
+      llvm::Function *function;
+      CallPathNode *node;
+    };
+    static const unsigned CacheSize = 1 << 12;
+
     CallPathNode root;
+    /// The nodes in creation order, which is a topological order.
     std::vector<CallPathNode*> paths;
+    /// Storage of the nodes, allocated in blocks.
+    std::deque<CallPathNode> pool;
+    std::vector<CacheEntry> cache;
 
   private:
     CallPathNode *computeCallPath(CallPathNode *parent, 
@@ -70,7 +85,6 @@ namespace klee {
     
   public:
     CallPathManager();
-    ~CallPathManager();
 
     void getSummaryStatistics(CallSiteSummaryTable &result);
     
@@ -0,0 +1,243 @@
+//===-- ConcreteBlock.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConcreteBlock.h"
+#include "Context.h"
+
+#include "klee/Config/Version.h"
+#include "klee/Internal/Module/Cell.h"
+#include "klee/Internal/Module/KInstruction.h"
+
+#if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
+#include "llvm/IR/Instructions.h"
+#else
+#include "llvm/Instructions.h"
+#endif
+
+using namespace klee;
+using namespace llvm;
+
+/// The width of an integer or pointer type, 0 for any other type.
+static Expr::Width getWidth(Type *t) {
+  if (t->isPointerTy())
+    return Context::get().getPointerWidth();
+  if (t->isIntegerTy() && t->getIntegerBitWidth() <= 64)
+    return t->getIntegerBitWidth();
+  return 0;
+}
+
+static uint64_t truncate(uint64_t v, Expr::Width width) {
+  return width >= 64 ? v : v & ((1ULL << width) - 1);
+}
+
+static int64_t signExtend(uint64_t v, Expr::Width width) {
+  return width >= 64 ? (int64_t) v :
+      (int64_t) (v << (64 - width)) >> (64 - width);
+}
+
+/// The value of a constant register or module constant.
+static bool read(int vnumber, const Cell *locals, const Cell *constants,
+                 uint64_t &value) {
+  const Cell &c = vnumber < 0 ? constants[-vnumber - 2] : locals[vnumber];
+  const klee::ConstantExpr *ce =
+    dyn_cast_or_null<klee::ConstantExpr>(c.value.get());
+  if (!ce)
+    return false;
+  value = ce->getZExtValue();
+  return true;
+}
+
+ConcreteBlock::ConcreteBlock(KInstIterator first) {
+  for (KInstIterator it = first; ; ++it) {
+    Op op;
+    if (!decode(it, op))
+      break;
+    ops.push_back(op);
+  }
+}
+
+bool ConcreteBlock::decode(const KInstruction *ki, Op &op) const {
+  Instruction *i = ki->inst;
+  op.opcode = ki->opcode;
+  op.predicate = 0;
+  op.width = getWidth(i->getType());
+  op.operandWidth = i->getNumOperands() ? getWidth(i->getOperand(0)->getType())
+                                        : 0;
+  op.numOperands = 0;
+  op.dest = ki->dest;
+  op.offset = 0;
+  if (!op.width || !op.operandWidth)
+    return false;
+
+  switch (ki->opcode) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+    op.numOperands = 2;
+    break;
+
+  case Instruction::ICmp:
+    op.predicate = cast<ICmpInst>(i)->getPredicate();
+    op.numOperands = 2;
+    break;
+
+  case Instruction::Select:
+    op.numOperands = 3;
+    break;
+
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::IntToPtr:
+  case Instruction::PtrToInt:
+  case Instruction::BitCast:
+    op.numOperands = 1;
+    break;
+
+  case Instruction::GetElementPtr: {
+    const KGEPInstruction *kgepi = static_cast<const KGEPInstruction*>(ki);
+    for (unsigned j = 0; j < kgepi->indices.size(); j++) {
+      Index index;
+      unsigned operand = kgepi->indices[j].first;
+      index.operand = ki->operands[operand];
+      index.width = getWidth(i->getOperand(operand)->getType());
+      index.elementSize = kgepi->indices[j].second;
+      if (!index.width)
+        return false;
+      op.indices.push_back(index);
+    }
+    op.offset = kgepi->offset;
+    op.numOperands = 1;
+    break;
+  }
+
+  default:
+    return false;
+  }
+
+  for (unsigned j = 0; j < op.numOperands; j++)
+    op.operands[j] = ki->operands[j];
+  return true;
+}
+
+bool ConcreteBlock::execute(unsigned index, Cell *locals,
+                            const Cell *constants) const {
+  const Op &op = ops[index];
+  uint64_t v[3];
+  for (unsigned j = 0; j < op.numOperands; j++)
+    if (!read(op.operands[j], locals, constants, v[j]))
+      return false;
+  uint64_t x = v[0], y = op.numOperands > 1 ? v[1] : 0;
+
+  uint64_t result;
+  switch (op.opcode) {
+  case Instruction::Add: result = x + y; break;
+  case Instruction::Sub: result = x - y; break;
+  case Instruction::Mul: result = x * y; break;
+  case Instruction::And: result = x & y; break;
+  case Instruction::Or: result = x | y; break;
+  case Instruction::Xor: result = x ^ y; break;
+
+  case Instruction::UDiv:
+  case Instruction::URem:
+    if (!y)
+      return false;
+    result = op.opcode == Instruction::UDiv ? x / y : x % y;
+    break;
+
+  case Instruction::SDiv:
+  case Instruction::SRem: {
+    int64_t sx = signExtend(x, op.width), sy = signExtend(y, op.width);
+    if (!sy || sy == -1)
+      return false;
+    result = (uint64_t) (op.opcode == Instruction::SDiv ? sx / sy : sx % sy);
+    break;
+  }
+
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+    if (y >= op.width)
+      return false;
+    if (op.opcode == Instruction::Shl)
+      result = x << y;
+    else if (op.opcode == Instruction::LShr)
+      result = x >> y;
+    else
+      result = (uint64_t) (signExtend(x, op.width) >> y);
+    break;
+
+  case Instruction::ICmp: {
+    int64_t sx = signExtend(x, op.operandWidth);
+    int64_t sy = signExtend(y, op.operandWidth);
+    switch (op.predicate) {
+    case ICmpInst::ICMP_EQ: result = x == y; break;
+    case ICmpInst::ICMP_NE: result = x != y; break;
+    case ICmpInst::ICMP_UGT: result = x > y; break;
+    case ICmpInst::ICMP_UGE: result = x >= y; break;
+    case ICmpInst::ICMP_ULT: result = x < y; break;
+    case ICmpInst::ICMP_ULE: result = x <= y; break;
+    case ICmpInst::ICMP_SGT: result = sx > sy; break;
+    case ICmpInst::ICMP_SGE: result = sx >= sy; break;
+    case ICmpInst::ICMP_SLT: result = sx < sy; break;
+    case ICmpInst::ICMP_SLE: result = sx <= sy; break;
+    default:
+      return false;
+    }
+    break;
+  }
+
+  case Instruction::Select:
+    result = x ? y : v[2];
+    break;
+
+  case Instruction::SExt:
+    result = (uint64_t) signExtend(x, op.operandWidth);
+    break;
+
+  // truncations and extensions of pointers are the ZExtExpr of the
+  // interpreter, which extracts to a smaller width
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::IntToPtr:
+  case Instruction::PtrToInt:
+  case Instruction::BitCast:
+    result = x;
+    break;
+
+  case Instruction::GetElementPtr: {
+    result = x + op.offset;
+    for (unsigned j = 0; j < op.indices.size(); j++) {
+      const Index &index = op.indices[j];
+      uint64_t value;
+      if (!read(index.operand, locals, constants, value))
+        return false;
+      result += (uint64_t) signExtend(value, index.width) * index.elementSize;
+    }
+    break;
+  }
+
+  default:
+    return false;
+  }
+
+  locals[op.dest].value =
+    klee::ConstantExpr::alloc(truncate(result, op.width), op.width);
+  return true;
+}
@@ -0,0 +1,71 @@
+//===-- ConcreteBlock.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CONCRETEBLOCK_H
+#define KLEE_CONCRETEBLOCK_H
+
+#include "klee/Expr.h"
+#include "klee/Internal/Module/KInstIterator.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace klee {
+  struct Cell;
+
+  /// ConcreteBlock - The register instructions from the entry of a hot
+  /// basic block up to its first other instruction, decoded into
+  /// operations on machine integers (--concrete-block-threshold).
+  ///
+  /// An operation runs while its operands are constants, and binds the
+  /// constant the interpreter would. At the first symbolic operand, and at
+  /// a division by zero, a division by -1 or an overshift, which the
+  /// interpreter folds itself, the rest of the block is left to it.
+  class ConcreteBlock {
+    /// A variable index of a GetElementPtr, scaled by its element size.
+    struct Index {
+      int operand;
+      Expr::Width width;
+      uint64_t elementSize;
+    };
+
+    struct Op {
+      unsigned opcode;
+      /// the predicate of an ICmp
+      unsigned predicate;
+      /// the widths of the result and of the first operand
+      Expr::Width width, operandWidth;
+      /// the value numbers of the operands, as KInstruction::operands
+      int operands[3];
+      unsigned numOperands;
+      unsigned dest;
+      /// the indices and the constant offset of a GetElementPtr
+      std::vector<Index> indices;
+      uint64_t offset;
+    };
+
+    std::vector<Op> ops;
+
+    bool decode(const KInstruction *ki, Op &op) const;
+
+  public:
+    /// Decode the instructions from first on, up to the first one that is
+    /// not an integer or pointer computation on registers.
+    explicit ConcreteBlock(KInstIterator first);
+
+    /// The number of instructions decoded.
+    unsigned size() const { return ops.size(); }
+
+    /// Run the index-th instruction on the registers locals of its frame.
+    /// Returns false, and changes nothing, if the interpreter must run it.
+    bool execute(unsigned index, Cell *locals, const Cell *constants) const;
+  };
+}
+
+#endif
@@ -12,18 +12,46 @@
 using namespace klee;
 
 Statistic stats::allocations("Allocations", "Alloc");
+Statistic stats::allocationsReused("AllocationsReused", "AllocReused");
+Statistic stats::asyncQueries("AsyncQueries", "AQ");
+Statistic stats::asyncQueriesJoined("AsyncQueriesJoined", "AQjoined");
+Statistic stats::backgroundReplays("BackgroundReplays", "BgReplays");
+Statistic stats::blockedTime("BlockedTime", "Btime");
+Statistic stats::concolicBranches("ConcolicBranches", "Bconc");
+Statistic stats::concreteBlockInstructions("ConcreteBlockInstructions",
+                                           "Iblock");
+Statistic stats::constantAccesses("ConstantAccesses", "Mconst");
+Statistic stats::copyOnWriteBytes("CopyOnWriteBytes", "CowBytes");
+Statistic stats::copyOnWriteCopies("CopyOnWriteCopies", "CowCopies");
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
 Statistic stats::forks("Forks", "Forks");
+Statistic stats::deferredStates("DeferredStates", "Deferred");
+Statistic stats::equivalentStates("EquivalentStates", "Equiv");
+Statistic stats::explorationTime("ExplorationTime", "Etime");
+Statistic stats::idleTime("IdleTime", "Idle");
 Statistic stats::instructionRealTime("InstructionRealTimes", "Ireal");
 Statistic stats::instructionTime("InstructionTimes", "Itime");
 Statistic stats::instructions("Instructions", "I");
+Statistic stats::joinMerges("JoinMerges", "Jmerges");
+Statistic stats::loopBudgetParks("LoopBudgetParks", "LoopParks");
 Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
+Statistic stats::modelBranches("ModelBranches", "Bmodel");
+Statistic stats::nativeCallFallbacks("NativeCallFallbacks", "NnatFail");
+Statistic stats::nativeCalls("NativeCalls", "Nnat");
+Statistic stats::overlappingPrefixes("OverlappingPrefixes", "Poverlap");
 Statistic stats::reachableUncovered("ReachableUncovered", "IuncovReach");
+Statistic stats::parkedDemotions("ParkedDemotions", "Pdemoted");
+Statistic stats::recoveryTime("RecoveryTime", "RecTime");
+Statistic stats::replayTime("ReplayTime", "Rptime");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
+Statistic stats::shippedQueries("ShippedQueries", "Shipped");
 Statistic stats::solverTime("SolverTime", "Stime");
 Statistic stats::states("States", "States");
+Statistic stats::subtreeSlices("SubtreeSlices", "Slices");
+Statistic stats::suspensions("Suspensions", "Susp");
+Statistic stats::targetUnreachableStates("TargetUnreachableStates", "TUnreach");
 Statistic stats::trueBranches("TrueBranches", "Bt");
 Statistic stats::uncoveredInstructions("UncoveredInstructions", "Iuncov");
@@ -16,6 +16,7 @@ namespace klee {
 namespace stats {
 
   extern Statistic allocations;
+  extern Statistic allocationsReused;
   extern Statistic resolveTime;
   extern Statistic instructions;
   extern Statistic instructionTime;
@@ -27,9 +28,91 @@ namespace stats {
   extern Statistic forkTime;
   extern Statistic solverTime;
 
+  /// Time (in microseconds) the normal states spent suspended on
+  /// recovery states, and the number of these suspensions.
+  extern Statistic blockedTime;
+  extern Statistic suspensions;
+
+  /// The number of branch queries solved while their state was parked,
+  /// and of the states parked on a query another state had in flight.
+  extern Statistic asyncQueries;
+  extern Statistic asyncQueriesJoined;
+
+  /// The number of queued prefix tasks started from the states a forked
+  /// process replayed them to meanwhile (--background-replay).
+  extern Statistic backgroundReplays;
+
+  /// The number of branch conditions the model of their state decided
+  /// one side of, so that only the other side went to the solver.
+  extern Statistic modelBranches;
+
+  /// The number of branches of a replayed prefix the donor's solution
+  /// decided, without the solver (--concolic-replay).
+  extern Statistic concolicBranches;
+
+  /// The number of internal calls run natively, and of those that touched
+  /// a symbolic object and were interpreted instead
+  /// (--native-internal-calls).
+  extern Statistic nativeCalls;
+  extern Statistic nativeCallFallbacks;
+
+  /// The number of instructions run by the decoded entries of the hot
+  /// blocks (--concrete-block-threshold).
+  extern Statistic concreteBlockInstructions;
+
+  /// The number of memory accesses through constant pointers, whose
+  /// bounds were checked without the solver.
+  extern Statistic constantAccesses;
+
   /// The number of process forks.
   extern Statistic forks;
 
+  /// The number of branches whose sides merged at their join
+  /// (--auto-merge).
+  extern Statistic joinMerges;
+
+  /// The number of states kept for donation over their --loop-budget.
+  extern Statistic loopBudgetParks;
+
+  /// The number of times a state was set aside for the expected cost of its
+  /// next query (--defer-query-cost).
+  extern Statistic deferredStates;
+
+  /// The number of time slices one prefix subtree of a merged prefix packet
+  /// handed to another (--fair-share-slice).
+  extern Statistic subtreeSlices;
+
+  /// The number of suspended states freed down to their prefix (see
+  /// --parked-state-ttl and --demote-parked-states).
+  extern Statistic parkedDemotions;
+
+  /// The number of queries sent to a solver rank.
+  extern Statistic shippedQueries;
+
+  /// The number of states terminated at a join point an equivalent state
+  /// reached before (--prune-equivalent-states).
+  extern Statistic equivalentStates;
+
+  /// The path prefixes this worker claimed that another worker, or this
+  /// one, had claimed before (--claim-prefix-depth).
+  extern Statistic overlappingPrefixes;
+
+  /// The number of states terminated once they could reach no
+  /// --error-location target (--prune-target-unreachable).
+  extern Statistic targetUnreachableStates;
+
+  /// The object states copied on write, and the bytes of the copies.
+  extern Statistic copyOnWriteCopies;
+  extern Statistic copyOnWriteBytes;
+
+  /// Time (in microseconds) spent running states along received prefixes,
+  /// running the other normal states, running recovery states, and
+  /// waiting for work. The solver time is part of the first three.
+  extern Statistic replayTime;
+  extern Statistic explorationTime;
+  extern Statistic recoveryTime;
+  extern Statistic idleTime;
+
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
@@ -22,6 +22,7 @@
 #else
 #include "llvm/Function.h"
 #endif
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -42,10 +43,67 @@ namespace {
 
 /***/
 
+unsigned int Snapshot::liveCount = 0;
+
+size_t Snapshot::getStateBytes() {
+  return sizeof(ExecutionState);
+}
+
+/***/
+
+/* the released registers, by size, never destroyed since states may be
+   released at exit */
+static std::vector< std::vector<FrameLocals *> > &freeLocals =
+  *new std::vector< std::vector<FrameLocals *> >();
+static unsigned freeCells = 0;
+/* bounds the registers kept for reuse */
+static const unsigned maxFreeCells = 1 << 20;
+
+FrameLocals::FrameLocals(unsigned _size)
+  : refCount(1), size(_size), cells(new Cell[_size]) {}
+
+FrameLocals::~FrameLocals() {
+  delete[] cells;
+}
+
+FrameLocals *FrameLocals::create(unsigned size) {
+  if (size < freeLocals.size() && !freeLocals[size].empty()) {
+    FrameLocals *fl = freeLocals[size].back();
+    freeLocals[size].pop_back();
+    freeCells -= size;
+    fl->refCount = 1;
+    return fl;
+  }
+  return new FrameLocals(size);
+}
+
+FrameLocals *FrameLocals::clone() const {
+  FrameLocals *fl = create(size);
+  for (unsigned i = 0; i < size; i++)
+    fl->cells[i] = cells[i];
+  return fl;
+}
+
+void FrameLocals::release() {
+  assert(refCount > 0 && "released too often");
+  if (--refCount)
+    return;
+  if (freeCells + size > maxFreeCells) {
+    delete this;
+    return;
+  }
+  for (unsigned i = 0; i < size; i++)
+    cells[i].value = 0;
+  if (size >= freeLocals.size())
+    freeLocals.resize(size + 1);
+  freeLocals[size].push_back(this);
+  freeCells += size;
+}
+
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
     minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
+  locals = FrameLocals::create(kf->numRegisters);
 }
 
 StackFrame::StackFrame(const StackFrame &s) 
@@ -53,15 +111,29 @@ StackFrame::StackFrame(const StackFrame &s)
     kf(s.kf),
     callPathNode(s.callPathNode),
     allocas(s.allocas),
+    locals(s.locals),
     minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
-    varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+    varargs(s.varargs),
+    loopForks(s.loopForks) {
+  locals->retain();
+}
+
+StackFrame &StackFrame::operator=(const StackFrame &s) {
+  s.locals->retain();
+  locals->release();
+  caller = s.caller;
+  kf = s.kf;
+  callPathNode = s.callPathNode;
+  allocas = s.allocas;
+  locals = s.locals;
+  minDistToUncoveredOnReturn = s.minDistToUncoveredOnReturn;
+  varargs = s.varargs;
+  loopForks = s.loopForks;
+  return *this;
 }
 
 StackFrame::~StackFrame() { 
-  delete[] locals; 
+  locals->release();
 }
 
 /***/
@@ -73,6 +145,7 @@ ExecutionState::ExecutionState(KFunction *kf) :
 
     /* state properties */
     suspendStatus(false),
+    suspendTime(0),
     recoveryState(0),
     blockingLoadStatus(true),
 
@@ -88,31 +161,62 @@ ExecutionState::ExecutionState(KFunction *kf) :
     prevPC(pc),
 
     queryCost(0.), 
+    modelValid(false),
     weight(1),
     depth(0),
     actDepth(0),
     prefixDepth(0),
+    replayPending(false),
+    asyncResult(0),
+    mergeJoin(0),
+    mergeFrame(0),
+    mergeHistory(0),
+    mergeId(0),
 
     instsSinceCovNew(0),
     coveredNew(false),
+    lastScheduled(0),
+    uncoveredEpoch(0),
+    targetDistance(0),
+    stateSetIndex(),
+    donateDepth(0),
+    claimDepth(0),
+    subtree(0),
+    overLoopBudget(false),
     forkDisabled(false),
     ptreeNode(0) {
   pushFrame(0, kf);
 }
 
 ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
-    : constraints(assumptions), queryCost(0.), ptreeNode(0) {}
+    : constraints(assumptions), queryCost(0.), modelValid(false),
+      replayPending(false),
+      asyncResult(0), mergeJoin(0), mergeFrame(0), mergeHistory(0),
+      mergeId(0), lastScheduled(0), uncoveredEpoch(0), targetDistance(0),
+      stateSetIndex(), donateDepth(0), claimDepth(0), subtree(0),
+      overLoopBudget(false),
+      ptreeNode(0) {}
+
+SymbolicList::SymbolicList(const SymbolicList &list)
+  : std::vector<std::pair<const MemoryObject *, const Array *> >(list) {
+  for (unsigned int i=0; i<size(); i++)
+    (*this)[i].first->refCount++;
+}
 
-ExecutionState::~ExecutionState() {
-  for (unsigned int i=0; i<symbolics.size(); i++)
+SymbolicList::~SymbolicList() {
+  for (unsigned int i=0; i<size(); i++)
   {
-    const MemoryObject *mo = symbolics[i].first;
+    const MemoryObject *mo = (*this)[i].first;
     assert(mo->refCount > 0);
     mo->refCount--;
     if (mo->refCount == 0)
       delete mo;
   }
+}
+
+/***/
 
+ExecutionState::~ExecutionState() {
   while (!stack.empty()) popFrame();
 }
 
@@ -124,6 +228,7 @@ ExecutionState::ExecutionState(const ExecutionState& state):
 
     /* state properties */
     suspendStatus(state.suspendStatus),
+    suspendTime(state.suspendTime),
     snapshots(state.snapshots),
     recoveryState(state.recoveryState),
     blockingLoadStatus(state.blockingLoadStatus),
@@ -131,6 +236,7 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     allocationRecord(state.allocationRecord),
     /* TODO: copy only for originating states */
     //guidingConstraints(state.guidingConstraints),
+    deferredConstraints(state.deferredConstraints),
     writtenAddresses(state.writtenAddresses),
     pendingRecoveryInfos(state.pendingRecoveryInfos),
     recoveryCache(state.recoveryCache),
@@ -155,27 +261,44 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     branchHist(state.branchHist),
 
     queryCost(state.queryCost),
+    model(state.model),
+    modelValid(state.modelValid),
+    replaySeed(state.replaySeed),
     weight(state.weight),
     depth(state.depth),
     actDepth(state.actDepth),
     prefixDepth(state.prefixDepth),
     prefix(state.prefix),
     prefixes(state.prefixes),
+    replayPending(state.replayPending),
+    asyncCondition(state.asyncCondition),
+    asyncResult(state.asyncResult),
+    mergeJoin(state.mergeJoin),
+    mergeFrame(state.mergeFrame),
+    mergeHistory(state.mergeHistory),
+    mergeId(state.mergeId),
+    joinPrefixes(state.joinPrefixes),
 
     pathOS(state.pathOS),
     symPathOS(state.symPathOS),
 
     instsSinceCovNew(state.instsSinceCovNew),
     coveredNew(state.coveredNew),
+    lastScheduled(state.lastScheduled),
+    uncoveredEpoch(state.uncoveredEpoch),
+    targetDistance(state.targetDistance),
+    stateSetIndex(),
+    donateDepth(state.donateDepth),
+    claimDepth(state.claimDepth),
+    subtree(state.subtree),
+    overLoopBudget(state.overLoopBudget),
     forkDisabled(state.forkDisabled),
     coveredLines(state.coveredLines),
     ptreeNode(state.ptreeNode),
     symbolics(state.symbolics),
+    symbolicObjects(state.symbolicObjects),
     arrayNames(state.arrayNames)
 {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-    symbolics[i].first->refCount++;
-
   /* TODO: possibly not required if snapshots are cleared */
   if (isNormalState() && !isRecoveryState()) {
     guidingConstraints = state.guidingConstraints;
@@ -186,9 +309,12 @@ ExecutionState *ExecutionState::branch() {
   //depth++;
   actDepth++;
 
+  /* the false state starts with no covered lines, do not copy them */
+  std::map<const std::string *, std::set<unsigned> > lines;
+  lines.swap(coveredLines);
   ExecutionState *falseState = new ExecutionState(*this);
+  coveredLines.swap(lines);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
 
   weight *= .5;
   falseState->weight -= weight;
@@ -215,25 +341,60 @@ void ExecutionState::popFrame() {
   stack.pop_back();
 }
 
+/// The value of the array in the seed, zero if the seed lacks it.
+static std::vector<unsigned char>
+getSeedValue(const ExecutionState::ReplaySeed &seed, const Array *array) {
+  ExecutionState::ReplaySeed::const_iterator value = seed.find(array->name);
+  if (value == seed.end() || value->second.size() != array->size)
+    return std::vector<unsigned char>(array->size, 0);
+  return value->second;
+}
+
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) { 
   mo->refCount++;
-  symbolics.push_back(std::make_pair(mo, array));
+  symbolics.write().push_back(std::make_pair(mo, array));
+  symbolicObjects.write()[array] = mo;
+  //a concolic replay keeps the model a solution with the donor's values
+  if (modelValid && !replaySeed->empty())
+    model.write().bindings[array] = getSeedValue(*replaySeed, array);
+}
+
+bool ExecutionState::adoptReplaySeed(const std::vector<ReplaySeed> &seeds) {
+  for (unsigned i = 0; i < seeds.size(); ++i) {
+    Assignment assignment;
+    for (unsigned j = 0; j < symbolics->size(); ++j) {
+      const Array *array = (*symbolics)[j].second;
+      assignment.bindings[array] = getSeedValue(seeds[i], array);
+    }
+    if (assignment.satisfies(constraints.begin(), constraints.end())) {
+      setModel(assignment);
+      replaySeed.write() = seeds[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+const MemoryObject *ExecutionState::getSymbolicObject(const Array *array) const {
+  std::map<const Array *, const MemoryObject *>::const_iterator it =
+      symbolicObjects->find(array);
+  return it == symbolicObjects->end() ? 0 : it->second;
 }
 ///
 
 std::string ExecutionState::getFnAlias(std::string fn) {
-  std::map < std::string, std::string >::iterator it = fnAliases.find(fn);
-  if (it != fnAliases.end())
+  std::map < std::string, std::string >::const_iterator it = fnAliases->find(fn);
+  if (it != fnAliases->end())
     return it->second;
   else return "";
 }
 
 void ExecutionState::addFnAlias(std::string old_fn, std::string new_fn) {
-  fnAliases[old_fn] = new_fn;
+  fnAliases.write()[old_fn] = new_fn;
 }
 
 void ExecutionState::removeFnAlias(std::string fn) {
-  fnAliases.erase(fn);
+  fnAliases.write().erase(fn);
 }
 
 /**/
@@ -251,7 +412,7 @@ llvm::raw_ostream &klee::operator<<(llvm::raw_ostream &os, const MemoryMap &mm)
   return os;
 }
 
-bool ExecutionState::merge(const ExecutionState &b) {
+bool ExecutionState::merge(const ExecutionState &b, unsigned maxSelects) {
   if (DebugLogStateMerge)
     llvm::errs() << "-- attempting merge of A:" << this << " with B:" << &b
                  << "--\n";
@@ -260,7 +421,7 @@ bool ExecutionState::merge(const ExecutionState &b) {
 
   // XXX is it even possible for these to differ? does it matter? probably
   // implies difference in object states?
-  if (symbolics!=b.symbolics)
+  if (*symbolics!=*b.symbolics)
     return false;
 
   {
@@ -353,6 +514,35 @@ bool ExecutionState::merge(const ExecutionState &b) {
       llvm::errs() << "\t\tmappings differ\n";
     return false;
   }
+
+  if (maxSelects != ~0u) {
+    unsigned selects = 0;
+    std::vector<StackFrame>::const_iterator itA = stack.begin();
+    std::vector<StackFrame>::const_iterator itB = b.stack.begin();
+    for (; itA!=stack.end(); ++itA, ++itB) {
+      const Cell *aLocals = itA->getLocals();
+      const Cell *bLocals = itB->getLocals();
+      for (unsigned i=0; i<itA->kf->numRegisters; i++) {
+        const ref<Expr> &av = aLocals[i].value;
+        const ref<Expr> &bv = bLocals[i].value;
+        if (!av.isNull() && !bv.isNull() && av != bv)
+          selects++;
+      }
+    }
+    for (std::set<const MemoryObject*>::iterator it = mutated.begin(),
+           ie = mutated.end(); it != ie && selects <= maxSelects; ++it) {
+      const ObjectState *os = addressSpace.findObject(*it);
+      const ObjectState *otherOS = b.addressSpace.findObject(*it);
+      for (unsigned i=0; i<(*it)->size && selects <= maxSelects; i++)
+        if (os->read8(i) != otherOS->read8(i))
+          selects++;
+    }
+    if (selects > maxSelects) {
+      if (DebugLogStateMerge)
+        llvm::errs() << "\t\ttoo many values differ\n";
+      return false;
+    }
+  }
   
   // merge stack
 
@@ -374,9 +564,11 @@ bool ExecutionState::merge(const ExecutionState &b) {
   for (; itA!=stack.end(); ++itA, ++itB) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
+    Cell *aLocals = af.getWritableLocals();
+    const Cell *bLocals = bf.getLocals();
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      ref<Expr> &av = aLocals[i].value;
+      const ref<Expr> &bv = bLocals[i].value;
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
@@ -412,6 +604,65 @@ bool ExecutionState::merge(const ExecutionState &b) {
   return true;
 }
 
+void ExecutionState::joinMerged() {
+  std::vector<char> branches = branchHist.toVector();
+  assert(mergeHistory < branches.size() && "merged before the branch");
+  depth -= branches.size() - mergeHistory - 1;
+  branches.resize(mergeHistory);
+  branches.push_back('4');
+  branchHist.assign(&branches[0], &branches[0] + branches.size());
+  prefixes = joinPrefixes;
+  joinPrefixes.clear();
+  if (prefixes.hasNext())
+    replayPending = true;
+  mergeJoin = 0;
+  mergeId = 0;
+}
+
+/// splitmix64, spreads the parts over the 64 bits before they are combined
+static uint64_t mixFingerprint(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+uint64_t ExecutionState::computeFingerprint() const {
+  uint64_t h = mixFingerprint(pc->info->id);
+
+  // the frames in order, each with its locals
+  for (unsigned i = 0; i != stack.size(); ++i) {
+    const StackFrame &sf = stack[i];
+    uint64_t frame = mixFingerprint(
+        llvm::hash_value(sf.kf->function->getName()) ^
+        ((uint64_t) (sf.caller ? sf.caller->info->id + 1 : 0) << 32));
+    const Cell *locals = sf.getLocals();
+    for (unsigned r = 0; r != sf.kf->numRegisters; ++r)
+      if (locals[r].value.get())
+        frame = mixFingerprint(frame ^ ((uint64_t) r << 32) ^
+                               locals[r].value->hash());
+    h = mixFingerprint(h ^ frame);
+  }
+
+  // the objects and the constraints in any order
+  uint64_t memory = 0;
+  for (MemoryMap::iterator it = addressSpace.objects.begin(),
+       ie = addressSpace.objects.end(); it != ie; ++it) {
+    const MemoryObject *mo = it->first;
+    const ObjectState *os = it->second;
+    memory ^= mixFingerprint(mo->address ^
+                             mixFingerprint(os->getContentHash()));
+  }
+  uint64_t path = constraints.size();
+  for (ConstraintManager::const_iterator it = constraints.begin(),
+       ie = constraints.end(); it != ie; ++it)
+    path += mixFingerprint((*it)->hash());
+
+  return mixFingerprint(h ^ mixFingerprint(memory) ^
+                        mixFingerprint(path ^ ((uint64_t) symbolics->size()
+                                               << 48)));
+}
+
 void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
   unsigned idx = 0;
   const KInstruction *target = prevPC;
@@ -434,13 +685,13 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      ref<Expr> value = sf.getLocals()[sf.kf->getArgRegister(index++)].value;
       if (value.get() && isa<ConstantExpr>(value))
         out << "=" << value;
     }
     out << ")";
-    if (ii.file != "")
-      out << " at " << ii.file << ":" << ii.line;
+    if (*ii.file != "")
+      out << " at " << *ii.file << ":" << ii.line;
     out << "\n";
     target = sf.caller;
   }
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "Executor.h"
+#include "ConcreteBlock.h"
 #include "Context.h"
 #include "CoreStats.h"
 #include "ExternalDispatcher.h"
@@ -15,9 +16,15 @@
 #include "Memory.h"
 #include "MemoryManager.h"
 #include "PTree.h"
+#include "PrefixCodec.h"
+#include "InstructionSampler.h"
+#include "QueryProfiler.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
+#include "SolverService.h"
 #include "SpecialFunctionHandler.h"
+#include "StateSerializer.h"
+#include "TargetDistance.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
@@ -29,6 +36,7 @@
 #include "klee/TimerStatIncrementer.h"
 #include "klee/CommandLine.h"
 #include "klee/Common.h"
+#include "klee/SharedSolverCache.h"
 #include "klee/ASContext.h"
 #include "klee/util/Assignment.h"
 #include "klee/util/ExprPPrinter.h"
@@ -43,6 +51,7 @@
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/FingerprintSet.h"
 #include "klee/Internal/Support/FloatEvaluation.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/System/MemoryUsage.h"
@@ -80,15 +89,19 @@
 #endif
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+#include "llvm/Analysis/Dominators.h"
 #include "llvm/Support/CallSite.h"
 #else
 #include "llvm/IR/CallSite.h"
+#include "llvm/IR/Dominators.h"
 #endif
 
 #include "llvm/PassManager.h"
@@ -101,10 +114,13 @@
 #include "klee/Internal/Analysis/SliceGenerator.h"
 
 #ifdef HAVE_ZLIB_H
+#include "klee/Internal/Support/BranchHistory.h"
 #include "klee/Internal/Support/CompressionStream.h"
+#include "klee/Internal/Support/EventTrace.h"
 #endif
 
 #include <cassert>
+#include <climits>
 #include <algorithm>
 #include <iomanip>
 #include <iosfwd>
@@ -114,9 +130,16 @@
 #include <string>
 
 #include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
 
 #include <errno.h>
 #include <cxxabi.h>
+#include <cstring>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #define ENABLE_LOGGING false
 #define ENABLE_OFFLOAD_LOGGING false
@@ -132,12 +155,33 @@
 #define KILL_COMP 8
 #define READY_TO_OFFLOAD 9
 #define NOT_READY_TO_OFFLOAD 10
+#define OFFLOAD_STATE_RESP 11
+#define START_STATE_TASK 12
+#define START_SPLIT_TASK 13
+#define SPLIT_RESP 14
+#define STEAL_REQ 15
+#define STEAL_RESP 16
+#define STEAL_GIVEN 17
+#define START_STEAL_TASK 18
+#define HEARTBEAT 19
+#define SOLVER_CACHE 20
+#define SHARED_COVERAGE 21
+#define SEARCH_MODE 22
+#define TEST_HASH 23
+#define CLUSTER_STATS 24
+#define WORK_REQUEST 26
+#define LEAVE 27
+#define LEAVE_RESP 28
+#define START_RANGE_TASK 29
+#define STATE_FINGERPRINTS 33
+#define PREFIX_CLAIM 34
 
 #define PREFIX_MODE 101
 #define RANGE_MODE 102
 #define NO_MODE 103
 
 #define MASTER_NODE 0
+#define FIRST_WORKER 1
 
 #define OFFLOAD_READY_THRESH 8
 #define OFFLOAD_NOT_READY_THRESH 4
@@ -193,11 +237,22 @@ namespace {
   cl::opt<bool> DebugCompressInstructions(
       "debug-compress-instructions", cl::init(false),
       cl::desc("Compress the logged instructions in gzip format."));
+
+  cl::opt<bool> CompressBranchHistory(
+      "compress-branch-history", cl::init(false),
+      cl::desc("Log the branch histories of the terminated paths with each "
+               "one stored as its difference to the previous one, in gzip "
+               "format (default=off)"));
 #endif
 
   cl::opt<bool>
   DebugCheckForImpliedValues("debug-check-for-implied-values");
 
+  cl::opt<bool>
+  UseImpliedValueConcretization("use-implied-value-concretization",
+                                cl::init(false),
+                                cl::desc("Write the byte values a new constraint implies into the symbolic objects (default=off)"));
+
 
   cl::opt<bool>
   SimplifySymIndices("simplify-sym-indices",
@@ -209,10 +264,23 @@ namespace {
 		       cl::init(true),
 		       cl::desc("Simplify equality expressions before querying the solver (default=on)."));
 
+  cl::opt<bool>
+  ReuseBranchModels("reuse-branch-models",
+                    cl::init(false),
+                    cl::desc("Keep a model of the constraints of each state and "
+                             "evaluate branch conditions under it first, so "
+                             "that the solver is asked only about the side "
+                             "the model does not satisfy (default=off)."));
+
   cl::opt<unsigned>
   MaxSymArraySize("max-sym-array-size",
                   cl::init(0));
 
+  cl::opt<bool>
+  NativeInternalCalls("native-internal-calls",
+                      cl::init(false),
+                      cl::desc("Run the calls with concrete arguments of internal functions that only compute on integers and pointers, and cannot block or override, natively (default=off)"));
+
   cl::opt<bool>
   SuppressExternalWarnings("suppress-external-warnings",
 			   cl::init(false),
@@ -248,6 +316,14 @@ namespace {
 		  cl::init(false),
                   cl::desc("Discard states that do not have a seed (default=off)."));
  
+  cl::opt<bool>
+  FastReplay("fast-replay",
+             cl::init(false),
+             cl::desc("With -replay-path, take the branches of the path "
+                      "without checking that they are feasible. The "
+                      "constraints of the path are only solved for its test "
+                      "case (default=off)."));
+
   cl::opt<bool>
   OnlySeed("only-seed",
 	   cl::init(false),
@@ -367,6 +443,410 @@ namespace {
   llvm::cl::opt<bool> UseSlicer("use-slicer",
                       llvm::cl::desc("Slice skipped functions"),
                       llvm::cl::init(false));
+
+  // PSE options
+
+  cl::opt<bool>
+  OffloadStateSnapshots("offload-state-snapshots", cl::init(false),
+                        cl::desc("On offload, ship the complete states to the "
+                                 "receiving worker instead of branch-history "
+                                 "prefixes to replay. States carrying Chopper "
+                                 "snapshots or recoveries are still sent as "
+                                 "prefixes. Requires deterministic "
+                                 "allocation (default=off)"));
+
+  cl::opt<bool>
+  OffloadDependentStates("offload-dependent-states", cl::init(false),
+                         cl::desc("Also offload the states suspended on a "
+                                  "Chopper recovery, with their recoveries, "
+                                  "as one prefix. The receiver replays it and "
+                                  "recovers the blocking load again. Only "
+                                  "groups whose recoveries did not fork are "
+                                  "offloaded (default=off)"));
+
+  cl::opt<Searcher::OffloadCriteria>
+  OffloadCriterion("offload-criteria",
+                   cl::desc("Which states a worker donates on offload"),
+                   cl::values(
+                     clEnumValN(Searcher::OC_ShortestHistory,
+                                "shortest-history",
+                                "The states with the shortest branch "
+                                "history, cheapest to replay (default)"),
+                     clEnumValN(Searcher::OC_LargestSubtree,
+                                "largest-subtree",
+                                "The states with the fewest forks on their "
+                                "path, heading the largest subtrees"),
+                     clEnumValN(Searcher::OC_LeastRecentlyScheduled,
+                                "least-recent",
+                                "The states scheduled least recently"),
+                     clEnumValN(Searcher::OC_NearestTarget,
+                                "nearest-target",
+                                "The states nearest to an --error-location "
+                                "target"),
+                     clEnumValEnd),
+                   cl::init(Searcher::OC_ShortestHistory));
+
+  cl::opt<unsigned>
+  DonateDepth("donate-depth", cl::init(0),
+              cl::desc("Keep the states this many branches below the end "
+                       "of their prefix for donation, and explore them "
+                       "only once nothing else is left. Only in workers "
+                       "with load balancing or work stealing (default=0, "
+                       "off)"));
+
+  cl::opt<unsigned>
+  ClaimPrefixDepth("claim-prefix-depth", cl::init(0),
+                   cl::desc("Claim the path prefix of a state from the "
+                            "master every this many branches past the end "
+                            "of its prefix, so that the work the workers "
+                            "explore twice is counted (default=0, off)"));
+
+  cl::opt<bool>
+  RefuseClaimedPrefixes("refuse-claimed-prefixes", cl::init(true),
+                        cl::desc("Terminate a state whose path prefix "
+                                 "another worker claimed first "
+                                 "(default=on)"));
+
+  cl::opt<unsigned>
+  LoopBudget("loop-budget", cl::init(0),
+             cl::desc("Keep the states which forked more than this many "
+                      "times at the exits of a loop without leaving it for "
+                      "donation, and explore them only once nothing else "
+                      "is left, with a new budget (default=0, off)"));
+
+  cl::opt<bool>
+  DemoteParkedStates("demote-parked-states", cl::init(true),
+                     cl::desc("Over the memory cap, free the states a worker "
+                              "suspended to resume later prefixes from, "
+                              "before spilling or killing running states; "
+                              "the prefixes are replayed from their nearest "
+                              "ancestor left instead (default=on)"));
+
+  cl::opt<bool>
+  SpillStates("spill-states", cl::init(true),
+              cl::desc("Over the memory cap, spill states to a file in the "
+                       "output directory and resume them when nothing else "
+                       "is left to run, instead of killing them. Only in "
+                       "workers, for states which could be shipped whole "
+                       "(default=on)"));
+
+  cl::opt<bool>
+  StartupSnapshot("startup-snapshot", cl::init(false),
+                  cl::desc("Keep a copy of the state at the first symbolic "
+                           "input of a worker and replay the prefixes which "
+                           "have no suspended state from there, instead of "
+                           "running the program startup again. Only in "
+                           "workers (default=off)"));
+
+  cl::opt<bool>
+  CheckPrefixReplay("check-prefix-replay", cl::init(true),
+                    cl::desc("Branches of a received prefix are replayed "
+                             "without solver queries, check once that the "
+                             "replayed path is feasible when the prefix is "
+                             "used up (default=on)"));
+
+  cl::opt<double>
+  OffloadMinDrainTime("offload-min-drain-time", cl::init(2.0),
+                      cl::desc("With -offloadPolicy=ADAPTIVE, only offer work "
+                               "when the local queue would take at least this "
+                               "many seconds to drain at the measured path "
+                               "rate (default=2.0)"));
+
+  cl::opt<unsigned>
+  OffloadMaxStates("offload-max-states", cl::init(64),
+                   cl::desc("With -offloadPolicy=ADAPTIVE, the most states "
+                            "given away by one offload (default=64)"));
+
+  cl::opt<unsigned>
+  HeartbeatInterval("heartbeat-interval", cl::init(0),
+                    cl::desc("Report queue size, readiness and progress to "
+                             "the master with a non-blocking send at most "
+                             "every this many milliseconds. With -lb this "
+                             "replaces the READY/NOT_READY message whenever "
+                             "a threshold is crossed (0=off, default)"));
+
+  cl::opt<unsigned>
+  ClusterStatsInterval("cluster-stats-interval", cl::init(0),
+                       cl::desc("Send instructions, states, solver time, "
+                                "queries, cache hits, coverage and offloads "
+                                "to the master every this many milliseconds, "
+                                "it sums them up in cluster_stats_<output "
+                                "dir> (0=off, default)"));
+
+  cl::opt<unsigned>
+  TraceSolverThreshold("trace-solver-threshold", cl::init(100),
+                       cl::desc("With --trace-events, trace the solver "
+                                "calls taking at least this many "
+                                "milliseconds (default=100)"));
+
+  cl::opt<std::string>
+  SharedAnalysisFile("shared-analysis-file", cl::init(""),
+                     cl::desc("With -skip-functions, the coordinator writes "
+                              "its pointer analysis results to this file and "
+                              "the workers load them instead of rerunning "
+                              "Andersen. Must be visible to all ranks "
+                              "(default=off)"));
+
+  cl::opt<std::string>
+  AnalysisCacheDir("analysis-cache-dir", cl::init(""),
+                   cl::desc("With -skip-functions, keep pointer analysis "
+                            "results in this directory, keyed by a hash of "
+                            "the analyzed module, and reuse them in later "
+                            "runs (default=off)"));
+
+  enum PointerAnalysisKind {
+    PA_Andersen, PA_AndersenLCD, PA_AndersenWave, PA_AndersenWaveDiff
+  };
+
+  cl::opt<PointerAnalysisKind>
+  PointerAnalysisOpt("pointer-analysis",
+                     cl::desc("The Andersen solver of the pointer analysis "
+                              "used with -skip-functions"),
+                     cl::values(
+                       clEnumValN(PA_Andersen, "andersen",
+                                  "Plain Andersen (default)"),
+                       clEnumValN(PA_AndersenLCD, "lcd",
+                                  "Andersen with lazy cycle detection"),
+                       clEnumValN(PA_AndersenWave, "wave",
+                                  "Andersen with wave propagation"),
+                       clEnumValN(PA_AndersenWaveDiff, "wave-diff",
+                                  "Wave propagation of points-to differences"),
+                       clEnumValEnd),
+                     cl::init(PA_Andersen));
+
+  cl::opt<bool>
+  FieldInsensitivePA("field-insensitive-pa", cl::init(false),
+                     cl::desc("Merge the fields of every object in the "
+                              "pointer analysis, cheaper but less precise "
+                              "(default=off)"));
+
+  cl::opt<double>
+  PointerAnalysisTimeout("pointer-analysis-timeout", cl::init(0),
+                         cl::desc("Fall back to the field insensitive "
+                                  "wave-diff pointer analysis if the chosen "
+                                  "one takes longer than this many seconds "
+                                  "(default=0 (off))"));
+
+  cl::opt<std::string>
+  SliceProfile("slice-profile", cl::init(""),
+               cl::desc("With -lazy-slicing, count how often each slice is "
+                        "needed in this file across runs and generate the "
+                        "slices needed in earlier runs, most needed first, "
+                        "while the worker is idle (default=off)"));
+
+  cl::opt<bool>
+  BatchRecoveries("batch-recoveries", cl::init(false),
+                  cl::desc("When a load depends on several skipped calls, "
+                           "recover from the latest call first and drop the "
+                           "remaining recoveries once one of them writes the "
+                           "loaded location (default=off)"));
+
+  cl::opt<bool>
+  DeferDependentConstraints("defer-dependent-constraints", cl::init(false),
+                            cl::desc("When a recovery state forks, keep the "
+                                     "condition for its suspended dependent "
+                                     "states, shared by their forks, and add "
+                                     "it only when they resume instead of at "
+                                     "every fork (default=off)"));
+
+  cl::opt<bool>
+  ShareSnapshots("share-snapshots", cl::init(false),
+                 cl::desc("Let the states reaching a skipped call with the "
+                          "same stack, memory and constraints, as forks do "
+                          "until they write, share one snapshot and the "
+                          "recovered values cached in it (default=off)"));
+
+  cl::opt<bool>
+  RecoverySummaries("recovery-summaries", cl::init(false),
+                    cl::desc("Remember the concrete inputs and the result of "
+                             "the slice runs which depend only on their "
+                             "snapshot, and reuse the result for a snapshot "
+                             "of the same skipped call holding the same "
+                             "inputs instead of running the slice again "
+                             "(default=off)"));
+
+  cl::opt<bool>
+  SharedSolverCacheOpt("shared-solver-cache", cl::init(false),
+                       cl::desc("Publish the counterexamples computed by the "
+                                "core solver to the other workers, and check "
+                                "theirs before calling it (default=off)"));
+
+  cl::opt<unsigned>
+  SharedSolverCacheSize("shared-solver-cache-size", cl::init(100000),
+                        cl::desc("Maximum number of entries kept by "
+                                 "--shared-solver-cache (default=100000)"));
+
+  cl::opt<unsigned>
+  SharedSolverCacheInterval("shared-solver-cache-interval", cl::init(1000),
+                            cl::desc("Minimum time in ms between two "
+                                     "publications of --shared-solver-cache "
+                                     "entries (default=1000)"));
+
+  cl::opt<std::string>
+  PersistentSolverCache("persistent-solver-cache", cl::init(""),
+                        cl::desc("Load the counterexamples of earlier runs "
+                                 "on the same bitcode from this file before "
+                                 "calling the core solver, and append the "
+                                 "new ones to it. All ranks may share it "
+                                 "(default=off)"));
+
+  cl::opt<unsigned>
+  ConcreteBlockThreshold("concrete-block-threshold", cl::init(0),
+                         cl::desc("Once a basic block was entered this many "
+                                  "times, run the integer and pointer "
+                                  "instructions at its entry on machine "
+                                  "integers while their operands are "
+                                  "concrete (default=0, off)"));
+
+  cl::opt<unsigned>
+  StepQuantum("step-quantum", cl::init(1),
+              cl::desc("Run the selected state for up to this many "
+                       "instructions before selecting again; the state is "
+                       "given back early when it forks, terminates or is "
+                       "suspended (default=1)"));
+
+  cl::opt<bool>
+  SharedCoverage("shared-coverage", cl::init(false),
+                 cl::desc("Exchange the covered instructions with the other "
+                          "workers, so that the coverage-guided searchers "
+                          "weigh states by the coverage of all of them "
+                          "(default=off)"));
+
+  cl::opt<unsigned>
+  SharedCoverageInterval("shared-coverage-interval", cl::init(1000),
+                         cl::desc("Minimum time in ms between two exchanges "
+                                  "of --shared-coverage bitmaps "
+                                  "(default=1000)"));
+
+  cl::opt<bool>
+  PruneEquivalentStates("prune-equivalent-states", cl::init(false),
+                        cl::desc("Terminate the states reaching a join point "
+                                 "in a state whose fingerprint an earlier "
+                                 "state had there already (default=off)"));
+
+  cl::opt<bool>
+  PruneTargetUnreachable("prune-target-unreachable", cl::init(false),
+                         cl::desc("Terminate the states which can no longer "
+                                  "reach any --error-location target "
+                                  "through the CFG and the calls, also "
+                                  "returning to their callers "
+                                  "(default=off)"));
+
+  cl::opt<unsigned>
+  StateFingerprintLimit("state-fingerprint-limit", cl::init(1000000),
+                        cl::desc("Stop recording new fingerprints for "
+                                 "--prune-equivalent-states after this many "
+                                 "(default=1000000)"));
+
+  cl::opt<unsigned>
+  SharedFingerprintInterval("shared-fingerprint-interval", cl::init(1000),
+                            cl::desc("Minimum time in ms between two "
+                                     "exchanges of the fingerprints of "
+                                     "--prune-equivalent-states with the "
+                                     "other workers, 0 to keep them to the "
+                                     "worker (default=1000)"));
+
+  cl::opt<unsigned>
+  PrefetchBelow("prefetch-below", cl::init(0),
+                cl::desc("A worker asks the master for its next task once "
+                         "fewer than this many of its states are active, and "
+                         "starts it as soon as it runs dry (default=0 (off))"));
+
+  cl::opt<bool>
+  BackgroundReplay("background-replay", cl::init(false),
+                   cl::desc("Replay the prefix task queued by "
+                            "--prefetch-below in a forked process while the "
+                            "current one runs, and start it from the states "
+                            "at the end of its prefixes (default=off)"));
+
+  cl::opt<bool>
+  OffloadSolverSeeds("offload-solver-seeds", cl::init(false),
+                     cl::desc("Send a solution of the path constraints of "
+                              "every offloaded state along with its prefix, "
+                              "so the receiver answers the queries of the "
+                              "replay from it (default=off)"));
+
+  cl::opt<bool>
+  ConcolicReplay("concolic-replay", cl::init(false),
+                 cl::desc("Replay an offloaded prefix on the solution sent "
+                          "with it (--offload-solver-seeds): its branches are "
+                          "decided by evaluating them in the solution and "
+                          "their constraints added without the solver "
+                          "(default=off)"));
+
+  cl::opt<bool>
+  AsyncForkQueries("async-fork-queries", cl::init(false),
+                   cl::desc("Solve the queries of branches which were slow "
+                            "before in a forked process, and run the other "
+                            "states meanwhile (default=off)"));
+
+  cl::opt<double>
+  AsyncQueryThreshold("async-query-threshold", cl::init(0.5),
+                      cl::value_desc("seconds"),
+                      cl::desc("With --async-fork-queries, a branch is slow "
+                               "if its last query took this long (default=0.5)"));
+
+  cl::opt<double>
+  AdaptiveSolverTimeout("adaptive-solver-timeout", cl::init(0),
+                        cl::value_desc("seconds"),
+                        cl::desc("Give a branch query this long first, then "
+                                 "retry it with twice the time up to "
+                                 "--max-solver-time, if its state covered new "
+                                 "code or is a recovery state, or its branch "
+                                 "never timed out before. The states of "
+                                 "branches which time out are charged for it "
+                                 "in their query cost (default=0, off)"));
+
+  cl::opt<bool>
+  SharedConstantGlobals("shared-constant-globals", cl::init(false),
+                        cl::desc("Make the constant globals read-only and "
+                                 "keep them apart from the objects of the "
+                                 "states, so that writes to them are errors "
+                                 "and externals, merging and offloaded "
+                                 "states do not go over them (default=off)"));
+
+  cl::opt<bool>
+  AutoMerge("auto-merge", cl::init(false),
+            cl::desc("Merge the two sides of a conditional branch at its "
+                     "immediate post-dominator if neither forked again, "
+                     "with selects on the values they differ in. Merged "
+                     "branches are '4' in the branch histories, which "
+                     "workers replay by merging again, so all ranks need "
+                     "the option (default=off)"));
+
+  cl::opt<unsigned>
+  AutoMergeMaxSelects("auto-merge-max-selects", cl::init(64),
+                      cl::desc("With --auto-merge, merge only if at most "
+                               "this many locals and bytes differ between "
+                               "the sides, which bounds the selects the "
+                               "queries of the merged state grow by "
+                               "(default=64)"));
+
+  cl::opt<unsigned>
+  MaxAsyncQueries("max-async-queries", cl::init(4),
+                  cl::desc("With --async-fork-queries, the number of queries "
+                           "solved at the same time (default=4)"));
+
+  cl::opt<bool>
+  ProfileQueries("profile-queries", cl::init(false),
+                 cl::desc("Attribute the time of the solver queries and the "
+                          "cache layer answering them to the instructions "
+                          "issuing them, written to run.qprof and "
+                          "run.qprof.functions (default=off)"));
+
+  cl::opt<unsigned>
+  SampleInstructions("sample-instructions", cl::init(0),
+                     cl::desc("Count every this many executed instructions "
+                              "by opcode and function, written to "
+                              "run.sprof.opcodes and run.sprof.functions "
+                              "every --sample-dump-interval seconds and at "
+                              "the end (0=off, default)"));
+
+  cl::opt<bool>
+  SampleStacks("sample-stacks", cl::init(false),
+               cl::desc("With --sample-instructions, charge the time between "
+                        "samples to the interpreted call stack, written to "
+                        "run.sprof.stacks for flamegraph.pl (default=off)"));
 }
 
 
@@ -393,16 +873,18 @@ const char *Executor::TerminateReasonNames[] = {
 
 Executor::Executor(InterpreterOptions &opts, InterpreterHandler *ih)
     : Interpreter(opts), kmodule(0), interpreterHandler(ih), searcher(0),
-      externalDispatcher(new ExternalDispatcher()), statsTracker(0),
+      externalDispatcher(new ExternalDispatcher()), states(StateSet::All),
+      statsTracker(0),
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0),
       processTree(0), replayKTest(0), replayPath(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
-      ivcEnabled(false), enableBranchHalt(false), haltFromMaster(false),
+      ivcEnabled(UseImpliedValueConcretization), enableBranchHalt(false), haltFromMaster(false),
       ready2Offload(false),
       coreSolverTimeout(MaxCoreSolverTime != 0 && MaxInstructionTime != 0
                             ? std::min(MaxCoreSolverTime, MaxInstructionTime)
                             : std::max(MaxCoreSolverTime, MaxInstructionTime)),
-      debugInstFile(0), debugLogBuffer(debugBufferString),
+      debugInstFile(0), nonRecoveryStates(StateSet::NonRecovery),
+      state2Offload(StateSet::Offload), debugLogBuffer(debugBufferString),
       errorCount(0),
       logFile(0) {
 
@@ -412,14 +894,53 @@ Executor::Executor(InterpreterOptions &opts, InterpreterHandler *ih)
     klee_error("Failed to create core solver\n");
   }
 
+  sharedSolverCache = 0;
+  stateFingerprints = 0;
+  lastFingerprintTime = 0;
+  brhistWriter = 0;
+  upperBound = 0;
+  lowerBound = 0;
+  numSuspendedStates = 0;
+  lastSubtree = 0;
+  lastSolverCacheTime = 0;
+  persistentCacheKey = 0;
+  lastCoverageTime = 0;
+  lastSharedCovered = 0;
+  lastMergeId = 0;
+  if (SharedSolverCacheOpt || OffloadSolverSeeds || PersistentSolverCache != "") {
+    sharedSolverCache = new SharedSolverCache(SharedSolverCacheSize,
+        SharedSolverCacheOpt || PersistentSolverCache != "");
+  }
+  if (PruneEquivalentStates) {
+    stateFingerprints = new FingerprintSet(StateFingerprintLimit);
+  }
+
+  SolverServiceClient *solverService = 0;
+  if (getNumSolverRanks() > 0) {
+    solverService = new SolverServiceClient();
+    coreSolver = createSolverServiceSolver(coreSolver, solverService);
+  }
+
   Solver *solver = constructSolverChain(
       coreSolver,
       interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(ALL_QUERIES_KQUERY_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME));
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME),
+      sharedSolverCache);
 
   this->solver = new TimingSolver(solver, EqualitySubstitution);
+  this->solver->setReuseModels(ReuseBranchModels);
+  if (EventTrace::getProcessTrace().isEnabled())
+    this->solver->setTraceThreshold((uint64_t) TraceSolverThreshold * 1000);
+  queryProfiler = 0;
+  instructionSampler = 0;
+  targetDistance = 0;
+  if (ProfileQueries || userSearcherRequiresQueryProfile() || solverService) {
+    queryProfiler = new QueryProfiler();
+    this->solver->setProfiler(queryProfiler);
+  }
+  this->solver->setService(solverService);
   prefixTree =  new PrefixTree();
   memory = new MemoryManager(&arrayCache);
 
@@ -466,15 +987,48 @@ Executor::Executor(InterpreterOptions &opts, InterpreterHandler *ih)
   branchLevel2Halt = 0;
   searchMode = "BFS";
   enableLB = false;
+  enableStealing = false;
+  startIdle = false;
+  adaptiveOffload = false;
+  completedPaths = 0;
+  idleWorkers = 1;
+  heartbeatPending = false;
+  lastHeartbeatTime = 0;
+  numOffloadsSent = 0;
+  offloadSnapshotValid = false;
+  offloadClaimed = false;
+  progressThreadDone = false;
+  lastOffloadSnapshotTime = 0;
+  workRequested = false;
+  queuedTaskTag = -1;
+  replayPid = 0;
+  replayFd = -1;
+  replayComplete = false;
+  inReplayProcess = false;
+  clusterStatsPending = false;
+  lastClusterStatsTime = 0;
+  lastHeartbeatInstructions = 0;
+  lastHeartbeatCovered = 0;
+  splitMode = false;
+  generationMode = false;
   numOffloadStates = 0;
   numPrefixes = 1;
-  MPI_Comm_rank(MPI_COMM_WORLD, &coreId);
+  shippedStateTemplate = 0;
+  startupSnapshot = 0;
+  MPI_Comm_rank(runComm, &coreId);
+
+  if (OffloadStateSnapshots && !memory->isDeterministic())
+    klee_error("--offload-state-snapshots requires deterministic allocation");
 }
 
 const Module *Executor::setModule(llvm::Module *module, const ModuleOptions &opts) {
   assert(!kmodule && module && "can only register one module"); // XXX gross
   
   kmodule = new KModule(module);
+
+  if (PersistentSolverCache != "") {
+    loadPersistentSolverCache(module);
+  }
   
   // Initialize the context.
 #if LLVM_VERSION_CODE <= LLVM_VERSION(3, 1)
@@ -499,7 +1053,29 @@ const Module *Executor::setModule(llvm::Module *module, const ModuleOptions &opt
     ra = new ReachabilityAnalysis(module, opts.EntryPoint, targets, *logFile);
     inliner = new Inliner(module, ra, targets, interpreterOpts.inlinedFunctions, *logFile);
     aa = new AAPass();
-    aa->setPAType(PointerAnalysis::Andersen_WPA);
+    switch (PointerAnalysisOpt) {
+    case PA_AndersenLCD:
+      aa->setPAType(PointerAnalysis::AndersenLCD_WPA);
+      break;
+    case PA_AndersenWave:
+      aa->setPAType(PointerAnalysis::AndersenWave_WPA);
+      break;
+    case PA_AndersenWaveDiff:
+      aa->setPAType(PointerAnalysis::AndersenWaveDiff_WPA);
+      break;
+    default:
+      aa->setPAType(PointerAnalysis::Andersen_WPA);
+      break;
+    }
+    aa->setFieldInsensitive(FieldInsensitivePA);
+    aa->setTimeout(PointerAnalysisTimeout);
+    if (SharedAnalysisFile != "") {
+      //workers start after phase 1, when the coordinator has written it
+      aa->setPointsToFile(SharedAnalysisFile, coreId != 0);
+    }
+    if (AnalysisCacheDir != "") {
+      aa->setPointsToCache(AnalysisCacheDir);
+    }
 
     mra = new ModRefAnalysis(kmodule->module, ra, aa, opts.EntryPoint, targets, *logFile);
     cloner = new Cloner(module, ra, *logFile);
@@ -508,10 +1084,17 @@ const Module *Executor::setModule(llvm::Module *module, const ModuleOptions &opt
     }
   }
 
-  kmodule->prepare(opts, interpreterOpts.skippedFunctions, interpreterHandler, ra, inliner, 
+  ModuleOptions moduleOpts(opts);
+  moduleOpts.FindLoops = LoopBudget != 0;
+  kmodule->prepare(moduleOpts, interpreterOpts.skippedFunctions, interpreterHandler, ra, inliner, 
     aa, mra, cloner, sliceGenerator);
 
+  if (sliceGenerator && LazySlicing && SliceProfile != "") {
+    loadSliceProfile();
+  }
+
   specialFunctionHandler->bind();
+  prepareExternalCalls();
 
   if (StatsTracker::useStatistics() || userSearcherRequiresMD2U()) {
   //if(false) {
@@ -519,19 +1102,43 @@ const Module *Executor::setModule(llvm::Module *module, const ModuleOptions &opt
                   interpreterHandler->getOutputFilename("assembly.ll"),
                   userSearcherRequiresMD2U());
   }
+
+  if (!interpreterOpts.errorLocations.empty()) {
+    targetDistance = new TargetDistance(kmodule, interpreterOpts.errorLocations,
+                                        ra);
+    if (!targetDistance->getNumTargets())
+      klee_warning("no instructions at the --error-location lines");
+  }
   return module;
 }
 
 Executor::~Executor() {
+  if (progressThread.joinable()) {
+    progressThreadDone = true;
+    progressThread.join();
+  }
   delete memory;
   delete externalDispatcher;
   if (processTree)
     delete processTree;
+  delete prefixTree;
   if (specialFunctionHandler)
     delete specialFunctionHandler;
   if (statsTracker)
     delete statsTracker;
   delete solver;
+  if (queryProfiler) delete queryProfiler;
+  if (instructionSampler) delete instructionSampler;
+  for (std::map<KInstruction *, ConcreteBlockSite>::iterator
+         it = concreteBlocks.begin(), ie = concreteBlocks.end();
+       it != ie; ++it)
+    delete it->second.block;
+  if (targetDistance) delete targetDistance;
+  if (sharedSolverCache) delete sharedSolverCache;
+  if (stateFingerprints) delete stateFingerprints;
+#ifdef HAVE_ZLIB_H
+  if (brhistWriter) delete brhistWriter;
+#endif
   /* TODO: is it the right place? */
   if (sliceGenerator) delete sliceGenerator;
   if (cloner) delete cloner;
@@ -767,6 +1374,13 @@ void Executor::initializeGlobals(ExecutionState &state) {
     globalAddresses.insert(std::make_pair(i, evalConstant(i->getAliasee())));
   }
 
+  if (NativeInternalCalls)
+    for (std::map<const llvm::GlobalValue*, ref<ConstantExpr> >::iterator
+           it = globalAddresses.begin(), ie = globalAddresses.end();
+         it != ie; ++it)
+      externalDispatcher->setGlobalAddress(it->first,
+                                           it->second->getZExtValue());
+
   // once all objects are allocated, do the actual initialization
   for (Module::const_global_iterator i = m->global_begin(),
          e = m->global_end();
@@ -778,7 +1392,10 @@ void Executor::initializeGlobals(ExecutionState &state) {
       ObjectState *wos = state.addressSpace.getWriteable(mo, os);
       
       initializeGlobalObject(state, wos, i->getInitializer(), 0);
-      // if(i->isConstant()) os->setReadOnly(true);
+      if (SharedConstantGlobals && i->isConstant()) {
+        wos->setReadOnly(true);
+        state.addressSpace.bindConstant(mo, wos);
+      }
     }
   }
 }
@@ -791,7 +1408,22 @@ int Executor::branch(ExecutionState &state,
   unsigned N = conditions.size();
   assert(N);
 
-  if (MaxForks!=~0u && stats::forks >= MaxForks) {
+  if (replayPath && FastReplay) {
+    // The cases were split off one after the other, the path of case k
+    // is k false branches and then a true one (none for the last case).
+    unsigned taken = 0;
+    for (; taken < N - 1; ++taken) {
+      if (replayPosition >= replayPath->size())
+        break;
+      bool branch = (*replayPath)[replayPosition++];
+      state.depth++;
+      state.addBranch(branch ? '0' : '1');
+      if (branch)
+        break;
+    }
+    for (unsigned i=0; i<N; ++i)
+      result.push_back(i == taken ? &state : NULL);
+  } else if (MaxForks!=~0u && stats::forks >= MaxForks) {
     unsigned next = theRNG.getInt32() % N;
     for (unsigned i=0; i<N; ++i) {
       if (i == next) {
@@ -850,8 +1482,8 @@ int Executor::branch(ExecutionState &state,
           //ns->pathOS << "1";
           es->depth++;
           ns->depth++;
-          es->branchHist.push_back('0');
-          ns->branchHist.push_back('1');
+          es->addBranch('0');
+          ns->addBranch('1');
         //}
       } 
     } else {
@@ -883,8 +1515,8 @@ int Executor::branch(ExecutionState &state,
 					//ns->pathOS << "1";
           es->depth++;
           ns->depth++;
-          es->branchHist.push_back('0');
-          ns->branchHist.push_back('1');
+          es->addBranch('0');
+          ns->addBranch('1');
 				//}
 			}
 			int satCase = 0;
@@ -892,6 +1524,7 @@ int Executor::branch(ExecutionState &state,
 			for(unsigned i=0; i<N; ++i) {
 				bool match = true;
 				std::vector <unsigned char> casePath;
+				std::vector<char> caseHist = result[i]->branchHist.toVector();
 				//pathWriter->readStream(getPathStreamID(*result[i]), casePath);
         if(ENABLE_LOGGING) {
           mylogFile<<"Result[0] depth: "<<result[0]->depth<<"Case depth: "<<result[i]->depth<<"\n";
@@ -899,7 +1532,7 @@ int Executor::branch(ExecutionState &state,
           //printPath(upperBound, mylogFile, "Upper bound: ");
         }  
 				for(int xid=result[0]->depth-1; xid<result[i]->depth; xid++) {
-					if(upperBound[xid] != result[i]->branchHist[xid]) {
+					if(upperBound[xid] != caseHist[xid]) {
 						match = false;
 						break;	
 					}
@@ -936,7 +1569,7 @@ int Executor::branch(ExecutionState &state,
         //numOffloadStates--;
 				auto ii = states.find(result[0]);
 				assert(ii != states.end()); //can not be case as the state has to exist
-				states.erase(ii); //remove the state from states vector	
+				eraseState(ii); //remove the state from states vector	
 			} else {
 				if(ENABLE_LOGGING) mylogFile << "Suspending all but switch case state:"<<satCase<<"\n";
 				for(int i=0; i<N; ++i) {
@@ -992,7 +1625,7 @@ int Executor::branch(ExecutionState &state,
             }
             auto ii = states.find(curr);
             assert(ii != states.end());
-            states.erase(ii);
+            eraseState(ii);
             curr = next;
           }
 				}
@@ -1089,6 +1722,9 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     seedMap.find(&current);
   bool isSeeding = it != seedMap.end();
 
+  if (replayPath && FastReplay && !isSeeding && !isInternal)
+    return replayBranch(current, condition);
+
   if (!isSeeding && !isa<ConstantExpr>(condition) && 
       (MaxStaticForkPct!=1. || MaxStaticSolvePct != 1. ||
        MaxStaticCPForkPct!=1. || MaxStaticCPSolvePct != 1.) &&
@@ -1117,6 +1753,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   }
 
   bool forkAndSuspend = false;
+  bool parked = false;
   double timeout = coreSolverTimeout;
   if (isSeeding)
     timeout *= it->second.size();
@@ -1131,9 +1768,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       mylogFile.flush();
     }
 
-    solver->setTimeout(timeout);
-    bool success = solver->evaluate(current, condition, res);
-    solver->setTimeout(0);
+    bool success = evaluateBranch(current, condition, timeout, false, res, parked);
     if (!success) {
       current.pc = current.prevPC;
       terminateStateEarly(current, "Query timed out (fork).");
@@ -1163,7 +1798,17 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
           <<current.branchToTake(forkAndSuspend)<<" Id:"<<ii.line<<"\n";
       	mylogFile.flush();
       }
-      if(isInternal) {
+      ref<Expr> modelValue;
+      if(ConcolicReplay && current.hasModel()) {
+        modelValue = current.evaluateInModel(condition);
+      }
+      if(isInternal && !modelValue.isNull() && isa<ConstantExpr>(modelValue)) {
+        //the donor's solution took this side, the other one is the donor's
+        res = modelValue->isTrue() ? Solver::True : Solver::False;
+        addConstraint(current, res == Solver::True ? condition
+                                                   : Expr::createIsZero(condition));
+        ++stats::concolicBranches;
+      } else if(isInternal) {
         //check to see if execution would have forked without the test  
         solver->setTimeout(timeout);
         bool success = solver->evaluate(current, condition, res);
@@ -1179,11 +1824,28 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
         else if(solverRes == 1) { res = Solver::False; }
         else { res = Solver::Unknown; }
         //else res = Solver::False;
+        //collect the constraint of the side the prefix takes, a model which
+        //disagrees with the prefix is dropped by it
+        if(!modelValue.isNull() && !forkAndSuspend && res != Solver::Unknown) {
+          addConstraint(current, res == Solver::True ? condition
+                                                     : Expr::createIsZero(condition));
+          ++stats::concolicBranches;
+        }
       }
     } else {
-      solver->setTimeout(timeout);
-      bool success = solver->evaluate(current, condition, res);
-      solver->setTimeout(0);
+      //the seeds of a generational task pick the side themselves
+      if (generationMode && isSeeding && !isInternal &&
+          !isa<ConstantExpr>(condition)) {
+        res = seedBranch(current, it->second, condition);
+        if (res != Solver::Unknown)
+          return followSeeds(current, condition, res == Solver::True);
+      }
+      bool success = evaluateBranch(current, condition, timeout,
+                                    !isInternal && !isSeeding, res, parked);
+      if (parked) {
+        //the branch runs again once the query is answered
+        return StatePair(0, 0);
+      }
       if (!success) {
         current.pc = current.prevPC;
         terminateStateEarly(current, "Query timed out (fork).");
@@ -1302,8 +1964,8 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
 					//falseState->pathOS << "1";
           trueState->depth++;
           falseState->depth++;
-          trueState->branchHist.push_back('0');
-          falseState->branchHist.push_back('1');
+          trueState->addBranch('0');
+          falseState->addBranch('1');
 				}
 			//}
 			if (symPathWriter) {
@@ -1333,7 +1995,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   			if (!isInternal) {
     			//current.pathOS << "0";
           current.depth++;
-          current.branchHist.push_back('2');
+          current.addBranch('2');
   			}
 			//}
       return StatePair(&current, 0);
@@ -1366,8 +2028,8 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
 					//falseState->pathOS << "1";
           trueState->depth++;
           falseState->depth++;
-          trueState->branchHist.push_back('0');
-          falseState->branchHist.push_back('1');
+          trueState->addBranch('0');
+          falseState->addBranch('1');
 				}
 			//}
 			if (symPathWriter) {
@@ -1396,7 +2058,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   			if (!isInternal) {
     			//current.pathOS << "1";
 			    current.depth++;
-          current.branchHist.push_back('3');
+          current.addBranch('3');
   			}
 			//}
       return StatePair(0, &current);
@@ -1412,6 +2074,10 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
 
     ++stats::forks;
 
+    //the sides of a merged branch of the prefixes replay the rest of them
+    //once they merged
+    if (current.shallIRange() && current.prefixes.hasNext('4'))
+      current.holdJoinPrefixes();
     falseState = trueState->branch();
     
 
@@ -1421,10 +2087,6 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
 
     addedStates.push_back(falseState);
    
-    if(coreId != 0) { 
-      trueState->removeFalsePrefixes();
-      falseState->removeTruePrefixes();
-    }
 
     if (it != seedMap.end()) {
       std::vector<SeedInfo> seeds = it->second;
@@ -1472,9 +2134,11 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
         //falseState->pathOS << "1";
         trueState->depth++;
         falseState->depth++;
-        trueState->branchHist.push_back('0');
-        falseState->branchHist.push_back('1');
+        trueState->addBranch('0');
+        falseState->addBranch('1');
       //}
+      if (AutoMerge)
+        markMergeJoin(*trueState, *falseState);
     }
     if (symPathWriter) {
       falseState->symPathOS = symPathWriter->open(current.symPathOS);
@@ -1500,6 +2164,383 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   }
 }
 
+bool Executor::evaluateBranch(ExecutionState &current, ref<Expr> condition,
+                              double timeout, bool mayPark,
+                              Solver::Validity &res, bool &parked) {
+  parked = false;
+  //the answer of the query the state was parked on
+  if (!current.asyncCondition.isNull()) {
+    bool answered = current.asyncCondition == condition;
+    current.asyncCondition = 0;
+    if (answered) {
+      if (current.asyncResult == 2) {
+        return false;
+      }
+      res = (Solver::Validity) current.asyncResult;
+      return true;
+    }
+  }
+
+  //the prefix replay and the branch halt of the master need the states
+  //in order
+  KInstruction *ki = current.prevPC;
+  mayPark = mayPark && AsyncForkQueries && coreId != 0 && !enableBranchHalt &&
+            current.isNormalState() && !current.isRecoveryState();
+  if (mayPark && (joinAsyncQuery(current, condition) ||
+                  (asyncQueries.size() < MaxAsyncQueries &&
+                   slowBranches.count(ki) &&
+                   startAsyncQuery(current, condition, timeout)))) {
+    current.pc = current.prevPC;
+    markSuspended(current, true);
+    suspendedStates.push_back(&current);
+    parked = true;
+    return true;
+  }
+
+  double start = util::getWallTime();
+  bool success = evaluateEscalating(current, condition, timeout, res);
+  if (mayPark && util::getWallTime() - start >= AsyncQueryThreshold) {
+    slowBranches.insert(ki);
+  }
+  return success;
+}
+
+bool Executor::evaluateEscalating(ExecutionState &current, ref<Expr> condition,
+                                  double timeout, Solver::Validity &res) {
+  //only below a global timeout, there is nothing to escalate to else
+  double budget = timeout;
+  if (AdaptiveSolverTimeout > 0 && AdaptiveSolverTimeout < timeout)
+    budget = AdaptiveSolverTimeout;
+  KInstruction *ki = current.prevPC;
+  for (;;) {
+    solver->setTimeout(budget);
+    bool success = solver->evaluate(current, condition, res);
+    solver->setTimeout(0);
+    if (success || budget >= timeout)
+      return success;
+
+    ++stats::queryTimeouts;
+    unsigned timeouts = ++timedOutBranches[ki];
+    //the QueryCost searcher puts the states of such branches last
+    current.queryCost += budget * timeouts;
+    bool rankedHigh = current.coveredNew ||
+                      current.getPriority() == PRIORITY_HIGH;
+    if (!rankedHigh && timeouts > 1)
+      return false;
+    ++stats::queryEscalations;
+    budget = std::min(2 * budget, timeout);
+  }
+}
+
+/// The child owns a copy of the solver chain, so the query runs on its own
+/// solver instance; the answer comes back as one byte, Validity + 1.
+bool Executor::startAsyncQuery(ExecutionState &current, ref<Expr> condition,
+                               double timeout) {
+  int pipefd[2];
+  if (pipe(pipefd) < 0) {
+    klee_warning("pipe failed (for async query) - %s", strerror(errno));
+    return false;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for async query) - %s", strerror(errno));
+    close(pipefd[0]);
+    close(pipefd[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(pipefd[0]);
+    //the copy must not take the messages of the master
+    setSolverInterruptCheck(0);
+    Solver::Validity validity;
+    solver->setTimeout(timeout);
+    char result = solver->evaluate(current, condition, validity) ? validity + 1 : 3;
+    ssize_t n;
+    do {
+      n = write(pipefd[1], &result, 1);
+    } while (n < 0 && errno == EINTR);
+    _exit(0);
+  }
+
+  close(pipefd[1]);
+  AsyncQuery query;
+  query.state = &current;
+  query.ki = current.prevPC;
+  query.condition = condition;
+  getRequiredConstraints(current, condition, query.required);
+  query.pid = pid;
+  query.fd = pipefd[0];
+  query.startTime = util::getWallTime();
+  asyncQueries.push_back(query);
+  ++stats::asyncQueries;
+  return true;
+}
+
+void Executor::getRequiredConstraints(ExecutionState &state,
+                                      ref<Expr> condition,
+                                      std::vector<ref<Expr> > &required) {
+  std::vector<unsigned> dependent;
+  state.constraints.getPartition().getDependent(condition, dependent);
+  for (unsigned i = 0; i < dependent.size(); i++)
+    required.push_back(state.constraints[dependent[i]]);
+}
+
+/// the siblings of a fork ask the same about a condition which does not
+/// depend on the fork, though their constraints differ
+bool Executor::joinAsyncQuery(ExecutionState &current, ref<Expr> condition) {
+  std::vector<ref<Expr> > required;
+  bool computed = false;
+  for (unsigned i = 0; i < asyncQueries.size(); i++) {
+    AsyncQuery &query = asyncQueries[i];
+    if (query.ki != current.prevPC || query.condition != condition)
+      continue;
+    if (!computed) {
+      getRequiredConstraints(current, condition, required);
+      computed = true;
+    }
+    if (required.size() != query.required.size() ||
+        !std::equal(required.begin(), required.end(), query.required.begin()))
+      continue;
+    query.waiters.push_back(&current);
+    ++stats::asyncQueriesJoined;
+    return true;
+  }
+  return false;
+}
+
+bool Executor::checkAsyncQueries(bool block) {
+  std::vector<struct pollfd> fds;
+  for (unsigned i = 0; i < asyncQueries.size(); i++) {
+    struct pollfd fd = { asyncQueries[i].fd, POLLIN, 0 };
+    fds.push_back(fd);
+  }
+  int n;
+  do {
+    n = poll(&fds[0], fds.size(), block ? -1 : 0);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    return false;
+  }
+
+  for (unsigned i = fds.size(); i-- > 0;) {
+    if (!fds[i].revents) {
+      continue;
+    }
+    AsyncQuery &query = asyncQueries[i];
+    char result = 3;
+    ssize_t r;
+    do {
+      r = read(query.fd, &result, 1);
+    } while (r < 0 && errno == EINTR);
+    //a crashed child is a failed query
+    if (r != 1 || result < 0 || result > 3) {
+      result = 3;
+    }
+    close(query.fd);
+    int status;
+    while (waitpid(query.pid, &status, 0) < 0 && errno == EINTR)
+      ;
+
+    if (util::getWallTime() - query.startTime < AsyncQueryThreshold) {
+      slowBranches.erase(query.ki);
+    }
+    query.waiters.push_back(query.state);
+    for (unsigned j = 0; j < query.waiters.size(); j++) {
+      ExecutionState &state = *query.waiters[j];
+      state.asyncCondition = query.condition;
+      state.asyncResult = result - 1;
+      markSuspended(state, false);
+      resumedStates.push_back(&state);
+    }
+    asyncQueries.erase(asyncQueries.begin() + i);
+  }
+  return true;
+}
+
+/// the parked states stay on their branch instruction and ask again if they
+/// are run later
+void Executor::cancelAsyncQueries() {
+  for (unsigned i = 0; i < asyncQueries.size(); i++) {
+    AsyncQuery &query = asyncQueries[i];
+    kill(query.pid, SIGKILL);
+    close(query.fd);
+    int status;
+    while (waitpid(query.pid, &status, 0) < 0 && errno == EINTR)
+      ;
+    markSuspended(*query.state, false);
+    for (unsigned j = 0; j < query.waiters.size(); j++)
+      markSuspended(*query.waiters[j], false);
+  }
+  asyncQueries.clear();
+}
+
+/// the first instruction of the immediate post-dominator of bb, where both
+/// sides of a branch at its end arrive unless they exit
+KInstruction *Executor::getMergeJoin(KFunction *kf, BasicBlock *bb) {
+  std::map<BasicBlock *, KInstruction *> &joins = mergeJoins[kf];
+  if (joins.empty()) {
+    DominatorTreeBase<BasicBlock> pdt(true);
+    pdt.recalculate(*kf->function);
+    for (Function::iterator it = kf->function->begin(),
+           ie = kf->function->end(); it != ie; ++it) {
+      DomTreeNodeBase<BasicBlock> *node = pdt.getNode(it);
+      DomTreeNodeBase<BasicBlock> *idom = node ? node->getIDom() : 0;
+      //the root of several exits is no block
+      joins[it] = idom && idom->getBlock() ?
+          kf->instructions[kf->basicBlockEntry[idom->getBlock()]] : 0;
+    }
+  }
+  return joins[bb];
+}
+
+void Executor::markMergeJoin(ExecutionState &trueState,
+                             ExecutionState &falseState) {
+  //only the sides of conditional branches of normal states merge, and not
+  //while they follow different prefixes or own part of the paths between
+  //the branch and the join
+  BranchInst *bi = dyn_cast<BranchInst>(trueState.prevPC->inst);
+  if (!bi || !trueState.isNormalState() || trueState.isRecoveryState() ||
+      trueState.isInDependentMode() || trueState.shallIRange() ||
+      falseState.shallIRange())
+    return;
+  if (!pathRange.isAll()) {
+    std::vector<char> branches = trueState.branchHist.toVector();
+    branches.pop_back();
+    if (!pathRange.contains(PathInterval::getForks(branches)))
+      return;
+  }
+  KInstruction *join = getMergeJoin(trueState.stack.back().kf,
+                                    bi->getParent());
+  if (!join)
+    return;
+  ++lastMergeId;
+  trueState.setMergeJoin(join, lastMergeId);
+  falseState.setMergeJoin(join, lastMergeId);
+}
+
+bool Executor::mergeAtJoin(ExecutionState &state) {
+  if (!state.mergeJoin) {
+    //the state forked again, the other side waits for nothing
+    releaseMergeJoin(state.mergeId);
+    state.mergeId = 0;
+    return false;
+  }
+  if (!state.isAtMergeJoin())
+    return false;
+
+  std::map<uint64_t, ExecutionState *>::iterator it =
+      statesAtJoin.find(state.mergeId);
+  if (it == statesAtJoin.end()) {
+    statesAtJoin[state.mergeId] = &state;
+    markSuspended(state, true);
+    suspendedStates.push_back(&state);
+    return true;
+  }
+
+  ExecutionState &other = *it->second;
+  statesAtJoin.erase(it);
+  markSuspended(other, false);
+  resumedStates.push_back(&other);
+  //the merge replaces the constraints the guiding constraints of the
+  //snapshots follow
+  if (other.getSnapshots().empty() && state.getSnapshots().empty() &&
+      other.merge(state, AutoMergeMaxSelects)) {
+    other.joinMerged();
+    ++stats::joinMerges;
+    state.mergeJoin = 0;
+    state.mergeId = 0;
+    terminateState(state);
+    return true;
+  }
+  other.mergeJoin = 0;
+  other.mergeId = 0;
+  state.mergeJoin = 0;
+  state.mergeId = 0;
+  return false;
+}
+
+void Executor::releaseMergeJoin(uint64_t id) {
+  std::map<uint64_t, ExecutionState *>::iterator it = statesAtJoin.find(id);
+  if (it == statesAtJoin.end())
+    return;
+  ExecutionState &state = *it->second;
+  statesAtJoin.erase(it);
+  state.mergeJoin = 0;
+  state.mergeId = 0;
+  markSuspended(state, false);
+  resumedStates.push_back(&state);
+}
+
+Executor::StatePair
+Executor::replayBranch(ExecutionState &current, ref<Expr> condition) {
+  if (replayPosition >= replayPath->size()) {
+    current.pc = current.prevPC;
+    terminateStateEarly(current, "Ran out of branches in the replay path.");
+    return StatePair(0, 0);
+  }
+  bool branch = (*replayPath)[replayPosition++];
+  if (!branch)
+    condition = Expr::createIsZero(condition);
+
+  // not a feasibility check, only the constraints rewriting the condition
+  // to false catch a path which does not match the program
+  condition = current.constraints.simplifyExpr(condition);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(condition)) {
+    if (!CE->isTrue()) {
+      current.pc = current.prevPC;
+      terminateStateEarly(current, "Replay path takes an infeasible branch.");
+      return StatePair(0, 0);
+    }
+  } else {
+    addConstraint(current, condition);
+  }
+
+  current.depth++;
+  current.addBranch(branch ? '2' : '3');
+  return branch ? StatePair(&current, 0) : StatePair(0, &current);
+}
+
+Solver::Validity Executor::seedBranch(ExecutionState &current,
+                                      std::vector<SeedInfo> &seeds,
+                                      ref<Expr> condition) {
+  bool trueSeed = false, falseSeed = false;
+  for (std::vector<SeedInfo>::iterator siit = seeds.begin(),
+         siie = seeds.end(); siit != siie; ++siit) {
+    // constant unless the seed leaves some input unbound
+    ref<ConstantExpr> res;
+    bool success =
+      solver->getValue(current, siit->assignment.evaluate(condition), res);
+    assert(success && "FIXME: Unhandled solver failure");
+    (void) success;
+    if (res->isTrue()) {
+      trueSeed = true;
+    } else {
+      falseSeed = true;
+    }
+    if (trueSeed && falseSeed)
+      return Solver::Unknown;
+  }
+  return trueSeed ? Solver::True : Solver::False;
+}
+
+Executor::StatePair
+Executor::followSeeds(ExecutionState &current, ref<Expr> condition,
+                      bool branch) {
+  // the other side, if feasible at all, is explored by whoever gets the
+  // prefix; its replay checks the path once
+  std::vector<char> flip = current.branchHist.toVector();
+  flip.push_back(branch ? '1' : '0');
+  seedFlips.push_back(flip);
+
+  addConstraint(current, branch ? condition : Expr::createIsZero(condition));
+  current.depth++;
+  current.addBranch(branch ? '0' : '1');
+  return branch ? StatePair(&current, 0) : StatePair(0, &current);
+}
+
 void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(condition)) {
     if (!CE->isTrue())
@@ -1609,8 +2650,8 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
     return kmodule->constantTable[index];
   } else {
     unsigned index = vnumber;
-    StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    const StackFrame &sf = state.stack.back();
+    return sf.getLocals()[index];
   }
 }
 
@@ -1662,7 +2703,7 @@ Executor::toConstant(ExecutionState &state,
   std::string str;
   llvm::raw_string_ostream os(str);
   os << "silently concretizing (reason: " << reason << ") expression " << e
-     << " to value " << value << " (" << (*(state.pc)).info->file << ":"
+     << " to value " << value << " (" << *(*(state.pc)).info->file << ":"
      << (*(state.pc)).info->line << ")";
 
   if (AllExternalWarnings)
@@ -1757,6 +2798,8 @@ void Executor::stepInstruction(ExecutionState &state) {
     statsTracker->stepInstruction(state);
 
   ++stats::instructions;
+  if (instructionSampler)
+    instructionSampler->step(state);
   state.prevPC = state.pc;
   ++state.pc;
 
@@ -1777,7 +2820,8 @@ void Executor::executeCall(ExecutionState &state,
     switch(f->getIntrinsicID()) {
     case Intrinsic::not_intrinsic:
       // state may be destroyed by this call, cannot touch
-      callExternalFunction(state, ki, f, arguments);
+      if (!specialFunctionHandler->handleNative(state, f, ki, arguments))
+        callExternalFunction(state, ki, f, arguments);
       break;
         
       // va_arg is handled by caller and intrinsic lowering, see comment for
@@ -1856,10 +2900,19 @@ void Executor::executeCall(ExecutionState &state,
           DEBUG_BASIC,
           klee_message("%p: adding snapshot (index = %u)", &state, index)
         );
-        ref<ExecutionState> snapshotState(createSnapshotState(state));
-        ref<Snapshot> snapshot(new Snapshot(snapshotState, f));
+        ref<Snapshot> snapshot;
+        if (ShareSnapshots && index == 0) {
+          snapshot = findSharedSnapshot(state, f);
+        }
+        if (snapshot.isNull()) {
+          ref<ExecutionState> snapshotState(createSnapshotState(state));
+          snapshot = new Snapshot(snapshotState, f);
+          interpreterHandler->incSnapshotsCount();
+          if (ShareSnapshots && index == 0) {
+            sharedSnapshots[state.prevPC->inst].push_back(snapshot);
+          }
+        }
         state.addSnapshot(snapshot);
-        interpreterHandler->incSnapshotsCount();
 
         /* TODO: will be replaced later... */
         state.clearRecoveredAddresses();
@@ -1877,6 +2930,13 @@ void Executor::executeCall(ExecutionState &state,
       return;
     }
 
+    if (specialFunctionHandler->handleNative(state, f, ki, arguments) ||
+        (NativeInternalCalls && callNatively(state, ki, f, arguments))) {
+      if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
+        transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
+      return;
+    }
+
     /* inject the sliced function if needed */
     if (state.isRecoveryState()) {
       ref<RecoveryInfo> recoveryInfo = state.getRecoveryInfo();
@@ -1905,6 +2965,7 @@ void Executor::executeCall(ExecutionState &state,
     }
 
     KFunction *kf = kmodule->functionMap[f];
+    kmodule->infos->loadFunction(f);
     state.pushFrame(state.prevPC, kf);
     state.pc = kf->instructions;
 
@@ -2003,12 +3064,38 @@ void Executor::executeCall(ExecutionState &state,
   }
 }
 
-void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src, 
-                                    ExecutionState &state) {
-  // Note that in general phi nodes can reuse phi values from the same
-  // block but the incoming value is the eval() result *before* the
-  // execution of any phi nodes. this is pathological and doesn't
-  // really seem to occur, but just in case we run the PhiCleanerPass
+void Executor::countLoopForks(BranchInst *bi, ExecutionState *trueState,
+                              ExecutionState *falseState) {
+  ExecutionState *sides[2] = { trueState, falseState };
+  KFunction *kf = (trueState ? trueState : falseState)->stack.back().kf;
+  std::map<Instruction*, std::vector<KFunction::LoopExit> >::iterator it =
+    kf->loopExits.find(bi);
+  if (it == kf->loopExits.end())
+    return;
+
+  for (unsigned i = 0; i < it->second.size(); i++) {
+    const KFunction::LoopExit &exit = it->second[i];
+    for (unsigned side = 0; side < 2; side++) {
+      if (!sides[side])
+        continue;
+      std::map<BasicBlock*, unsigned> &loopForks =
+        sides[side]->stack.back().loopForks;
+      if (exit.exitMask & (1 << side)) {
+        // the loop is left, the next time it runs has a new budget
+        loopForks.erase(exit.header);
+      } else if (sides[!side] && ++loopForks[exit.header] > LoopBudget) {
+        sides[side]->overLoopBudget = true;
+      }
+    }
+  }
+}
+
+void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src, 
+                                    ExecutionState &state) {
+  // Note that in general phi nodes can reuse phi values from the same
+  // block but the incoming value is the eval() result *before* the
+  // execution of any phi nodes. this is pathological and doesn't
+  // really seem to occur, but just in case we run the PhiCleanerPass
   // which makes sure this cannot happen and so it is safe to just
   // eval things in order. The PhiCleanerPass also makes sure that all
   // incoming blocks have the same order for each PHINode so we only
@@ -2021,17 +3108,33 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
   KFunction *kf = state.stack.back().kf;
   unsigned entry = kf->basicBlockEntry[dst];
   state.pc = &kf->instructions[entry];
-  if (state.pc->inst->getOpcode() == Instruction::PHI) {
+  if (state.pc->opcode == Instruction::PHI) {
     PHINode *first = static_cast<PHINode*>(state.pc->inst);
     state.incomingBBIndex = first->getBasicBlockIndex(src);
+  } else if (stateFingerprints && !dst->getSinglePredecessor()) {
+    // a join point, the blocks with PHIs are checked after them
+    pruneIfEquivalent(state);
   }
 }
 
+bool Executor::pruneIfEquivalent(ExecutionState &state) {
+  // the states replaying a path must reach its end
+  if (state.isRecoveryState() || state.isSuspended() || state.shallIRange() ||
+      state.replayPending)
+    return false;
+  if (stateFingerprints->insert(state.computeFingerprint()))
+    return false;
+
+  ++stats::equivalentStates;
+  terminateState(state);
+  return true;
+}
+
 void Executor::printFileLine(ExecutionState &state, KInstruction *ki,
                              llvm::raw_ostream &debugFile) {
   const InstructionInfo &ii = *ki->info;
-  if (ii.file != "")
-    debugFile << "     " << ii.file << ":" << ii.line << ":";
+  if (*ii.file != "")
+    debugFile << "     " << *ii.file << ":" << ii.line << ":";
   else
     debugFile << "     [no debug info]:";
 }
@@ -2077,6 +3180,20 @@ Function* Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
   }
 }
 
+Function *Executor::getIndirectTarget(KCallInstruction *kci, uint64_t addr) {
+  std::vector<std::pair<uint64_t, Function*> > &targets = kci->indirectTargets;
+  for (unsigned i = 0; i < targets.size(); ++i)
+    if (targets[i].first == addr)
+      return targets[i].second;
+
+  if (!legalFunctions.count(addr))
+    return 0;
+  Function *f = (Function*) addr;
+  if (targets.size() < KCallInstruction::MaxIndirectTargets)
+    targets.push_back(std::make_pair(addr, f));
+  return f;
+}
+
 /// TODO remove?
 static bool isDebugIntrinsic(const Function *f, KModule *KM) {
   return false;
@@ -2103,7 +3220,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     return;
   }
 
-  switch (i->getOpcode()) {
+  switch (ki->opcode) {
     // Control flow
   case Instruction::Ret: {
     ReturnInst *ri = cast<ReturnInst>(i);
@@ -2212,6 +3329,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       if (statsTracker && state.stack.back().kf->trackCoverage)
         statsTracker->markBranchVisited(branches.first, branches.second);
 
+      if (LoopBudget)
+        countLoopForks(bi, branches.first, branches.second);
+
       if (branches.first)
         transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), *branches.first);
       if (branches.second)
@@ -2360,10 +3480,26 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     unsigned numArgs = cs.arg_size();
     Value *fp = cs.getCalledValue();
-    Function *f = getTargetFunction(fp, state);
+    KCallInstruction *kci = static_cast<KCallInstruction*>(ki);
+    Function *f;
+    bool isAnnotation;
+    if (!state.hasFnAliases()) {
+      /* the target does not depend on the state, resolve it once */
+      if (!kci->targetResolved) {
+        kci->target = getTargetFunction(fp, state);
+        kci->isAnnotation = kci->target &&
+          kci->target->getName().startswith(StringRef("__crit"));
+        kci->targetResolved = true;
+      }
+      f = kci->target;
+      isAnnotation = kci->isAnnotation;
+    } else {
+      f = getTargetFunction(fp, state);
+      isAnnotation = f && f->getName().startswith(StringRef("__crit"));
+    }
 
     /* skip slicing annotations */
-    if (f && f->getName().startswith(StringRef("__crit"))) {
+    if (isAnnotation) {
         break;
     }
 
@@ -2429,13 +3565,42 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     } else {
       ref<Expr> v = eval(ki, 0, state).value;
 
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(v)) {
+        f = getIndirectTarget(kci, CE->getZExtValue());
+        if (f)
+          executeCall(state, ki, f, arguments);
+        else
+          terminateStateOnExecError(state, "invalid function pointer");
+        break;
+      }
+
       ExecutionState *free = &state;
       bool hasInvalid = false, first = true;
 
+      /* the targets seen at the call site are tried first, they only take
+         the query of the fork */
+      std::vector<std::pair<uint64_t, Function*> > cached =
+        kci->indirectTargets;
+      for (unsigned j = 0; j < cached.size() && free; ++j) {
+        ref<Expr> target = ConstantExpr::create(cached[j].first,
+                                                v->getWidth());
+        StatePair res = fork(*free, EqExpr::create(v, target), true);
+        if (res.first) {
+          f = cached[j].second;
+          if (res.second || !first)
+            klee_warning_once((void*) (unsigned long) cached[j].first,
+                              "resolved symbolic function pointer to: %s",
+                              f->getName().data());
+          executeCall(*res.first, ki, f, arguments);
+        }
+        first = false;
+        free = res.second;
+      }
+
       /* XXX This is wasteful, no need to do a full evaluate since we
          have already got a value. But in the end the caches should
          handle it for us, albeit with some overhead. */
-      do {
+      while (free) {
         ref<ConstantExpr> value;
         bool success = solver->getValue(*free, v, value);
         assert(success && "FIXME: Unhandled solver failure");
@@ -2443,9 +3608,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         StatePair res = fork(*free, EqExpr::create(v, value), true);
         if (res.first) {
           uint64_t addr = value->getZExtValue();
-          if (legalFunctions.count(addr)) {
-            f = (Function*) addr;
-
+          if ((f = getIndirectTarget(kci, addr))) {
             // Don't give warning on unique resolution
             if (res.second || !first)
               klee_warning_once((void*) (unsigned long) addr, 
@@ -2463,7 +3626,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
         first = false;
         free = res.second;
-      } while (free);
+      }
     }
     break;
   }
@@ -2474,6 +3637,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).value;
 #endif
     bindLocal(ki, state, result);
+    if (stateFingerprints && state.pc->opcode != Instruction::PHI)
+      pruneIfEquivalent(state);
     break;
   }
 
@@ -3166,268 +4331,1176 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 }
 
 void Executor::newCheck2Offload() {
+	//the progress thread must not take a request between the probe and
+	//the receive
+	std::unique_lock<std::mutex> lock(offloadLock, std::defer_lock);
+	if(progressThread.joinable()) {
+		lock.lock();
+		if(offloadClaimed) {
+			detachClaimedStates();
+		}
+	}
 	int flag;
 	MPI_Status status;
-	MPI_Iprobe(MASTER_NODE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+	MPI_Iprobe(MASTER_NODE, MPI_ANY_TAG, runComm, &flag, &status);
 	waiting4OffloadReq = true;
 	if(flag) {
 		if(status.MPI_TAG == OFFLOAD) {
-			int count;
-			char buffer;
-			MPI_Get_count(&status, MPI_CHAR, &count);
-			MPI_Recv(&buffer, count, MPI_CHAR, MASTER_NODE, OFFLOAD, MPI_COMM_WORLD, &status);
+			//the request carries the number of idle workers
+			int idle;
+			MPI_Recv(&idle, 1, MPI_INT, MASTER_NODE, OFFLOAD, runComm, &status);
+			idleWorkers = idle > 0 ? idle : 1;
+			//the snapshot may hold the states picked below
+			offloadSnapshotValid = false;
+			offloadSnapshot.clear();
 			if(ENABLE_OFFLOAD_LOGGING) {
 				mylogFile << "Offload Request\n";
 				mylogFile.flush();
 			}
 			bool valid;
 			std::vector<ExecutionState*> states2Offload;
-			int minSize = offloadFromStatesVector(states2Offload);
+			offloadFromStatesVector(states2Offload);
 				
 			//found some states
 			if(states2Offload.size() > 0) {
-				std::vector<unsigned char> commonPref;
-				for(int x=0; x<minSize; x++) {
-					int val = ((states2Offload[0])->branchHist)[x];
-					bool match = true;
-					for(int y=1; y<states2Offload.size(); y++) {
-						if(val != ((states2Offload[y])->branchHist)[x]) {
-							match = false;
-							break;
-						}
-					}
-					if(match) {
-						commonPref.push_back(val);
-					} else {
-						break;
-					}
-				}
-				if(ENABLE_OFFLOAD_LOGGING) {
-					mylogFile<<"Common Prefix Length: "<<commonPref.size()<<"\n";
-				}
-
-				//now combine the prefixes
-				//commonPref.push_back('-');
-				int start = commonPref.size();
-				for(int x=0; x<states2Offload.size(); x++) {
-					commonPref.push_back('-');
-					for(int y=start; y<states2Offload[x]->branchHist.size(); y++) {
-						commonPref.push_back(states2Offload[x]->branchHist[y]);
+				//ship the complete states if possible, else fall back to the prefixes
+				if(!OffloadStateSnapshots || !sendStateSnapshots(states2Offload)) {
+					std::vector<std::vector<char> > prefixes;
+					for(int x=0; x<states2Offload.size(); x++) {
+						prefixes.push_back(states2Offload[x]->branchHist.toVector());
 					}
-				}
-	
-				if(ENABLE_OFFLOAD_LOGGING) {
-					mylogFile<<"Combined Prefix Length: "<<commonPref.size()<<"\n";
-					mylogFile<<"Prefix: ";
-					for(int x=0; x<commonPref.size(); x++) {
-						mylogFile<<commonPref[x];
+					std::vector<char> packet;
+					if(OffloadSolverSeeds) {
+						encodeSolverSeeds(states2Offload, packet);
 					}
-					mylogFile<<"\n";
-					mylogFile.flush();
-				}
-	
-				char* pkt2Send = (char*)malloc(commonPref.size()*sizeof(char));
-				for(int x=0; x<commonPref.size(); x++) {
-					pkt2Send[x] = commonPref[x];
-				}
-				//if(ENABLE_LOGGING) printPath(pkt2Send, mylogFile, "Packet to Send: ");
-				MPI_Send(pkt2Send, commonPref.size(), MPI_CHAR, 0, OFFLOAD_RESP, MPI_COMM_WORLD);
-
-				searcher->update(nullptr, std::vector<ExecutionState *>(), states2Offload);
-				for(auto it=states2Offload.begin(); it!=states2Offload.end(); ++it) {
-					auto ii = states.find(*it);
-					assert(ii != states.end()); //can not be case as the state has to exist
-					states.erase(ii); //remove the state from states vector
-				
-					rangingSuspendedStates.push_back(*it);
-					auto hit = std::find(removedStates.begin(), removedStates.end(), *it);
-					if(hit != removedStates.end()) {
-						removedStates.erase(hit);
+					PrefixCodec::encode(prefixes, packet);
+					if(ENABLE_OFFLOAD_LOGGING) {
+						mylogFile<<"Offloading "<<prefixes.size()<<" prefixes, Packet Length: "
+							<<packet.size()<<"\n";
+						mylogFile.flush();
 					}
+					MPI_Send(&packet[0], packet.size(), MPI_CHAR, 0, OFFLOAD_RESP, runComm);
+					numOffloadsSent++;
 				}
+
+				suspendOffloadedStates(states2Offload);
 			} else {
 				char offloadFailed = 'x';
-				MPI_Send(&offloadFailed, 1, MPI_CHAR, 0, OFFLOAD_RESP, MPI_COMM_WORLD);
+				MPI_Send(&offloadFailed, 1, MPI_CHAR, 0, OFFLOAD_RESP, runComm);
 			}
 			waiting4OffloadReq = false;
 		} else if(status.MPI_TAG == KILL) {
 			char dummyRecv;
-			MPI_Recv(&dummyRecv, 1, MPI_CHAR, MASTER_NODE, KILL, MPI_COMM_WORLD, &status);
+			MPI_Recv(&dummyRecv, 1, MPI_CHAR, MASTER_NODE, KILL, runComm, &status);
 			haltExecution = true;
 			haltFromMaster = true;
+		} else if(status.MPI_TAG == SEARCH_MODE) {
+			//the master diversifies the search once the coverage stalls
+			//(--plateau-diversify)
+			int count;
+			MPI_Get_count(&status, MPI_CHAR, &count);
+			std::vector<char> policy(count+1);
+			MPI_Recv(&policy[0], count, MPI_CHAR, MASTER_NODE, SEARCH_MODE,
+			         runComm, &status);
+			switchSearchMode(std::string(&policy[0], count));
+		} else if(status.MPI_TAG == LEAVE) {
+			char dummyRecv;
+			MPI_Recv(&dummyRecv, 1, MPI_CHAR, MASTER_NODE, LEAVE, runComm, &status);
+			offloadSnapshotValid = false;
+			offloadSnapshot.clear();
+			leaveRun();
+		} else if((status.MPI_TAG == START_PREFIX_TASK ||
+		           status.MPI_TAG == START_STATE_TASK ||
+		           status.MPI_TAG == START_RANGE_TASK) && queuedTaskTag == -1) {
+			//the answer to a work request, kept until this task runs dry
+			int count;
+			MPI_Get_count(&status, MPI_CHAR, &count);
+			queuedTask.resize(count);
+			MPI_Recv(&queuedTask[0], count, MPI_CHAR, MASTER_NODE, status.MPI_TAG,
+			         runComm, &status);
+			queuedTaskTag = status.MPI_TAG;
 		}
 	}
 }
 
-void Executor::check2Offload() {
-  int flag;
-  MPI_Status status;
-  MPI_Iprobe(MASTER_NODE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
-  waiting4OffloadReq = true;
-	if(flag) {
-  	if(status.MPI_TAG == OFFLOAD) {
-    	int count;
-      char buffer;
-    	MPI_Get_count(&status, MPI_CHAR, &count);
-    	MPI_Recv(&buffer, count, MPI_CHAR, MASTER_NODE, OFFLOAD, MPI_COMM_WORLD, &status);
-    	if(ENABLE_LOGGING) {
-        mylogFile << "Offload Request\n";
-        mylogFile.flush();
-      }
-    	bool valid;
-    	ExecutionState* state2Remove = offloadFromStatesVector(valid);
+bool Executor::checkKill() {
+	if(haltFromMaster) {
+		return true;
+	}
+	int flag = 0;
+	MPI_Status status;
+	MPI_Iprobe(MASTER_NODE, KILL, runComm, &flag, &status);
+	if(!flag) {
+		return false;
+	}
+	char dummyRecv;
+	MPI_Recv(&dummyRecv, 1, MPI_CHAR, MASTER_NODE, KILL, runComm, &status);
+	haltExecution = true;
+	haltFromMaster = true;
+	return true;
+}
 
-    	if(valid) {
-        assert(state2Remove);
-        //pathWriter->readStream(getPathStreamID(*state2Remove), packet2send);
-        char* pkt2Send = (char*)malloc(state2Remove->branchHist.size()*sizeof(char));
-        for(int x=0; x<state2Remove->branchHist.size();  x++) {
-          pkt2Send[x] = state2Remove->branchHist[x];
-        }
-        //if(ENABLE_LOGGING) printPath(pkt2Send, mylogFile, "Packet to Send: ");
-        MPI_Send(pkt2Send, state2Remove->branchHist.size(), MPI_CHAR, 0, OFFLOAD_RESP, MPI_COMM_WORLD);
-        if(ENABLE_LOGGING) {
-          mylogFile << "Offloading State Act Depth"<<state2Remove->actDepth<<" Prefix Depth: "<<state2Remove->depth<<"\n";
-          mylogFile.flush();
-        }
-        std::vector<ExecutionState *> remStates;
-        remStates.push_back(state2Remove);
-        searcher->update(nullptr, std::vector<ExecutionState *>(), remStates);
-        auto ii = states.find(state2Remove);
-        assert(ii != states.end()); //can not be case as the state has to exist
-        states.erase(ii); //remove the state from states vector
-        rangingSuspendedStates.push_back(state2Remove);
-        auto hit = std::find(removedStates.begin(), removedStates.end(), state2Remove);
-        if(hit != removedStates.end()) {
-          removedStates.erase(hit);
-        }
-   		} else {
-        char offloadFailed = 'x';
-        MPI_Send(&offloadFailed, 1, MPI_CHAR, 0, OFFLOAD_RESP, MPI_COMM_WORLD);
-      }
-    	waiting4OffloadReq = false;
-  	} else if(status.MPI_TAG == KILL) {
-      char dummyRecv;
-      MPI_Recv(&dummyRecv, 1, MPI_CHAR, MASTER_NODE, KILL, MPI_COMM_WORLD, &status);
-      haltExecution = true;
-      haltFromMaster = true;
-    }
+//the worker whose solver queries the KILL of the master interrupts
+static Executor *interruptedWorker = 0;
+
+static bool checkWorkerKill() {
+	return interruptedWorker->checkKill();
+}
+
+void Executor::leaveRun() {
+	//the spilled states go back too
+	while(reloadSpilledStates()) {
+	}
+	std::vector<std::vector<char> > prefixes;
+	for(auto it=states.begin(); it!=states.end(); ++it) {
+		if(!(*it)->isRecoveryState()) {
+			prefixes.push_back((*it)->branchHist.toVector());
+		}
+	}
+	for(unsigned i=0; i<donatedStates.size(); i++) {
+		prefixes.push_back(donatedStates[i]->branchHist.toVector());
 	}
+	std::vector<char> packet;
+	if(prefixes.empty()) {
+		packet.push_back('x');
+	} else {
+		PrefixCodec::encode(prefixes, packet);
+	}
+	std::cout << "Process: "<<coreId<<" Leaving: States:"<<prefixes.size()<<"\n";
+	MPI_Send(&packet[0], packet.size(), MPI_CHAR, MASTER_NODE, LEAVE_RESP, runComm);
+	haltExecution = true;
+	haltFromMaster = true;
 }
 
-void Executor::updateStates(ExecutionState *current) {
-  
-  if (searcher) {
-    if (!removedStates.empty()) {
-      /* we don't want to pass suspended states to the searcher */
-      std::vector<ExecutionState *> filteredStates;
-      for (std::vector<ExecutionState *>::iterator i = removedStates.begin(); i != removedStates.end(); i++) {
-        ExecutionState *removedState = *i;
-        if (removedState->isNormalState() && removedState->isSuspended()) {
-            continue;
-        }
-        filteredStates.push_back(removedState);
-        //numOffloadStates--;
+void Executor::startProgressThread() {
+  int provided;
+  MPI_Query_thread(&provided);
+  if(provided < MPI_THREAD_MULTIPLE) {
+    klee_warning_once(0, "MPI does not support threads, offload requests are "
+                         "answered between steps");
+    return;
+  }
+  if(OffloadStateSnapshots) {
+    klee_warning_once(0, "--offload-state-snapshots ships the states from the "
+                         "interpreter, not starting the offload progress "
+                         "thread");
+    return;
+  }
+  progressThreadDone = false;
+  progressThread = std::thread(&Executor::runProgressThread, this);
+}
+
+void Executor::stopProgressThread() {
+  if(!progressThread.joinable()) {
+    return;
+  }
+  progressThreadDone = true;
+  progressThread.join();
+  std::lock_guard<std::mutex> lock(offloadLock);
+  if(offloadClaimed) {
+    detachClaimedStates();
+  }
+  offloadSnapshotValid = false;
+  offloadSnapshot.clear();
+}
+
+void Executor::runProgressThread() {
+  while(!progressThreadDone) {
+    {
+      std::lock_guard<std::mutex> lock(offloadLock);
+      int flag = 0;
+      MPI_Status status;
+      if(offloadSnapshotValid) {
+        MPI_Iprobe(MASTER_NODE, OFFLOAD, runComm, &flag, &status);
+      }
+      if(flag) {
+        //the snapshot was sized for the idle workers of an earlier request
+        int idle;
+        MPI_Recv(&idle, 1, MPI_INT, MASTER_NODE, OFFLOAD, runComm, &status);
+        MPI_Send(&offloadSnapshotPacket[0], offloadSnapshotPacket.size(), MPI_CHAR,
+                 MASTER_NODE, OFFLOAD_RESP, runComm);
+        offloadSnapshotValid = false;
+        offloadClaimed = true;
       }
-      searcher->update(current, addedStates, filteredStates);
-    } else {
-      searcher->update(current, addedStates, removedStates);
     }
+    usleep(1000);
+  }
+}
 
-    /* handle suspended states */
-    for (std::vector<ExecutionState *>::iterator i = suspendedStates.begin(); i != suspendedStates.end(); i++) {
-      searcher->removeState(*i);
-      //numOffloadStates--;
-    }
-    suspendedStates.clear();
+void Executor::publishOffloadSnapshot() {
+  if(offloadSnapshotValid || offloadClaimed || !ready2Offload ||
+     haltExecution || haltFromMaster) {
+    return;
+  }
+  //building it costs a pass over the searcher, not worth it every step
+  double now = util::getMonotonicTime();
+  if(now - lastOffloadSnapshotTime < 0.01) {
+    return;
+  }
+  lastOffloadSnapshotTime = now;
 
-    /* handle resumed states */
-    for (std::vector<ExecutionState *>::iterator i = resumedStates.begin(); i != resumedStates.end(); i++) {
-      searcher->addState(*i);
-      //numOffloadStates++;
+  std::vector<ExecutionState*> snapshot;
+  unsigned n = numStates2Donate(getNumActiveStates() + donatedStates.size());
+  if(n == 0) {
+    return;
+  }
+  if(!donatedStates.empty()) {
+    snapshot.assign(donatedStates.begin(),
+        donatedStates.begin() + std::min<size_t>(n, donatedStates.size()));
+  } else if(searcher) {
+    searcher->selectStatesToOffload(n, OffloadCriterion, snapshot);
+  }
+  if(snapshot.empty()) {
+    return;
+  }
+  if(snapshot.size() > n) {
+    snapshot.resize(n);
+  }
+  keepInsidePathRange(snapshot);
+  if(snapshot.empty()) {
+    return;
+  }
+  std::vector<std::vector<char> > prefixes;
+  for(unsigned x = 0; x < snapshot.size(); x++) {
+    prefixes.push_back(snapshot[x]->branchHist.toVector());
+  }
+  std::vector<char> packet;
+  PrefixCodec::encode(prefixes, packet);
+
+  std::lock_guard<std::mutex> lock(offloadLock);
+  offloadSnapshot.swap(snapshot);
+  offloadSnapshotPacket.swap(packet);
+  offloadSnapshotValid = true;
+}
+
+void Executor::detachClaimedStates() {
+  //the donated states join the others first, so that they are suspended
+  //like them
+  std::vector<ExecutionState*> donated;
+  for(unsigned x = 0; x < offloadSnapshot.size(); x++) {
+    auto it = std::find(donatedStates.begin(), donatedStates.end(),
+                        offloadSnapshot[x]);
+    if(it != donatedStates.end()) {
+      donatedStates.erase(it);
+      insertState(offloadSnapshot[x]);
+      donated.push_back(offloadSnapshot[x]);
     }
-    resumedStates.clear();
   }
-  
-  states.insert(addedStates.begin(), addedStates.end());
-  //numOffloadStates = numOffloadStates + addedStates.size();
+  if(!donated.empty()) {
+    searcher->update(0, donated, std::vector<ExecutionState *>());
+  }
+  if(ENABLE_OFFLOAD_LOGGING) {
+    mylogFile<<"Offloaded "<<offloadSnapshot.size()<<" prefixes from the progress thread\n";
+    mylogFile.flush();
+  }
+  suspendOffloadedStates(offloadSnapshot);
+  numOffloadsSent++;
+  offloadSnapshot.clear();
+  offloadClaimed = false;
+}
 
-	//adding states to the suspended states prefix map
-  for(auto it = rangingSuspendedStates.begin(); it != rangingSuspendedStates.end(); ++it) {
-   	std::vector<unsigned char> recvP;
-		for(unsigned int x=0;x<((*it)->branchHist).size();x++) {
-  		//std::cout<<recv_prefix[x];
-			unsigned char dd = ((*it)->branchHist)[x];
-  		if(dd == '2') {
-    		recvP.push_back('0');
-  		} else if(dd == '3') {
-    		recvP.push_back('1');
-  		} else if(dd == '-') {
-    		continue;
-  		} else {
-    		recvP.push_back(dd);
-  		}
-		}
+bool Executor::holdOffloadState(ExecutionState *state) {
+  if(!offloadSnapshotValid && !offloadClaimed) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(offloadLock);
+  bool inSnapshot = !state || std::find(offloadSnapshot.begin(),
+      offloadSnapshot.end(), state) != offloadSnapshot.end();
+  if(!inSnapshot) {
+    return true;
+  }
+  if(offloadClaimed) {
+    detachClaimedStates();
+    return !state;
+  }
+  offloadSnapshotValid = false;
+  offloadSnapshot.clear();
+  return true;
+}
 
-    (*it)->clearPrefixes();
- 
-		//pathWriter->readStream(getPathStreamID(**it), suspendedStatePath);
-    std::string path(recvP.begin(), recvP.end());
-    prefixSuspendedStatesMap.insert(std::make_pair(path, *it));
-    prefixTree->addToTree(recvP);
+bool Executor::isOffloadableGroup(ExecutionState &state) {
+  if(!state.isNormalState() || state.isRecoveryState() || !state.isSuspended()) {
+    return false;
   }
-	
-  addedStates.clear();
-	rangingSuspendedStates.clear();
+  ExecutionState *dependent = &state;
+  ExecutionState *recovery = state.getRecoveryState();
+  if(!recovery) {
+    return false;
+  }
+  while(recovery) {
+    //a recovery which forked leaves a copy of the group behind
+    if(!states.count(recovery) || recovery->depth != dependent->depth) {
+      return false;
+    }
+    if(!recovery->isNormalState() || !recovery->isSuspended()) {
+      return true;
+    }
+    dependent = recovery;
+    recovery = recovery->getRecoveryState();
+  }
+  return false;
+}
 
-  for (std::vector<ExecutionState *>::iterator it = removedStates.begin(),
-                                               ie = removedStates.end();
-       it != ie; ++it) {
-    ExecutionState *es = *it;
-    std::set<ExecutionState*>::iterator it2 = states.find(es);
-    if (it2 == states.end()) {
-      /* TODO: trying to handle removal of suspended states. Find a better solution... */
-      assert(es->isNormalState() && es->isSuspended());
-      continue;
+void Executor::dropDependentGroup(ExecutionState &state) {
+  ExecutionState *recovery = state.getRecoveryState();
+  while(recovery) {
+    ExecutionState *next = recovery->isNormalState() ?
+                           recovery->getRecoveryState() : 0;
+    terminateState(*recovery);
+    recovery = next;
+  }
+  state.setRecoveryState(0);
+  //the receiver explores its paths, they are not counted here
+  nonRecoveryStates.erase(&state);
+  removedStates.push_back(&state);
+}
+
+void Executor::suspendOffloadedStates(std::vector<ExecutionState*>& offloadVec) {
+  //the groups are not in the searcher and can not be parked while blocked,
+  //they go as their prefixes only
+  for(unsigned x = 0; x < offloadVec.size(); ) {
+    if(offloadVec[x]->isSuspended() && !offloadVec[x]->isRecoveryState()) {
+      dropDependentGroup(*offloadVec[x]);
+      offloadVec.erase(offloadVec.begin() + x);
     } else {
-      //numOffloadStates--;
-      states.erase(it2);
+      x++;
+    }
+  }
+  searcher->update(nullptr, std::vector<ExecutionState *>(), offloadVec);
+  for(auto it=offloadVec.begin(); it!=offloadVec.end(); ++it) {
+    auto ii = states.find(*it);
+    assert(ii != states.end()); //can not be case as the state has to exist
+    eraseState(ii); //remove the state from states vector
+
+    rangingSuspendedStates.push_back(*it);
+    auto hit = std::find(removedStates.begin(), removedStates.end(), *it);
+    if(hit != removedStates.end()) {
+      removedStates.erase(hit);
     }
-    std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
-      seedMap.find(es);
-    if (it3 != seedMap.end())
-      seedMap.erase(it3);
-    processTree->remove(es->ptreeNode);
-    delete es;
   }
-  removedStates.clear();
-  
-  if(enableLB) newCheck2Offload();
 }
 
-ExecutionState* Executor::offloadOriginatingStates(bool &valid) {
-  valid = false;
-  if(haltExecution || haltFromMaster) return NULL;
-  if(states.size() > 1) {
-    //look for the first non recovery and non suspended state
-    for(auto it=states.begin(); it!=states.end(); ++it) {
-      if((*it)->isNormalState() && (!((*it)->isRecoveryState())) &&
-        ((!(*it)->isSuspended()))) {
-        //continue;
-        bool isRemoved=false;
-        for(auto it2=removedStates.begin(); it2!=removedStates.end(); ++it2) {
-          if(*it == *it2) {
-            isRemoved=true;
-            break;
-          }
-        }
-        if(isRemoved)
-          continue;
-        valid = true;
-        return *it;
-			} else if((*it)->isRecoveryState() && (!(*it)->isSuspended())) {
-				bool isRemoved=false;
-				for(auto it2=removedStates.begin(); it2!=removedStates.end(); ++it2) {
+void Executor::serveStealRequests() {
+  int flag;
+  MPI_Status status;
+  MPI_Iprobe(MPI_ANY_SOURCE, STEAL_REQ, runComm, &flag, &status);
+  if(!flag) {
+    return;
+  }
+  char dummy;
+  int thief = status.MPI_SOURCE;
+  MPI_Recv(&dummy, 1, MPI_CHAR, thief, STEAL_REQ, runComm, &status);
+
+  std::vector<ExecutionState*> states2Offload;
+  if(searcher) {
+    idleWorkers = 1;
+    holdOffloadState(0);
+    offloadFromStatesVector(states2Offload);
+  }
+  if(states2Offload.empty()) {
+    char stealFailed = 'x';
+    MPI_Send(&stealFailed, 1, MPI_CHAR, thief, STEAL_RESP, runComm);
+    return;
+  }
+
+  std::vector<std::vector<char> > prefixes;
+  for(int x=0; x<states2Offload.size(); x++) {
+    prefixes.push_back(states2Offload[x]->branchHist.toVector());
+  }
+  std::vector<char> packet;
+  if(OffloadSolverSeeds) {
+    encodeSolverSeeds(states2Offload, packet);
+  }
+  PrefixCodec::encode(prefixes, packet);
+  //the master has to know the thief is busy before this worker can finish
+  MPI_Send(&thief, 1, MPI_INT, MASTER_NODE, STEAL_GIVEN, runComm);
+  MPI_Send(&packet[0], packet.size(), MPI_CHAR, thief, STEAL_RESP, runComm);
+  numOffloadsSent++;
+  if(ENABLE_OFFLOAD_LOGGING) {
+    mylogFile<<"Stolen by "<<thief<<": "<<prefixes.size()<<" prefixes\n";
+    mylogFile.flush();
+  }
+  suspendOffloadedStates(states2Offload);
+}
+
+void Executor::switchSearchMode(const std::string &mode) {
+  if(mode == searchMode) {
+    return;
+  }
+  searchMode = mode;
+  if(!searcher) {
+    return;
+  }
+  delete searcher;
+  searcher = constructUserSearcher(*this, searchMode);
+  //mid-task the new searcher takes over the states of the old one, the
+  //suspended states were never in it
+  std::vector<ExecutionState *> held;
+  for(StateSet::iterator it = states.begin(); it != states.end(); ++it) {
+    if(!(*it)->isSuspended()) {
+      held.push_back(*it);
+    }
+  }
+  if(!held.empty()) {
+    searcher->update(0, held, std::vector<ExecutionState *>());
+  }
+}
+
+void Executor::stealWork() {
+  char result;
+  MPI_Send(&result, 1, MPI_CHAR, MASTER_NODE, FINISH, runComm);
+
+  int numCores = getNumInterpreterRanks();
+  int numPeers = numCores - FIRST_WORKER - 1;
+  bool waiting4Steal = false;
+  bool gotWork = false;
+  int victim = 0;
+  //peers on this node are asked first, another node only once as many
+  //of them in a row had nothing to give
+  std::vector<int> localPeers;
+  const std::vector<unsigned> &nodes = interpreterOpts.rankNodes;
+  if(nodes.size() == (unsigned)numCores) {
+    for(int r = FIRST_WORKER; r < numCores; ++r) {
+      if(r != coreId && nodes[r] == nodes[coreId]) {
+        localPeers.push_back(r);
+      }
+    }
+  }
+  unsigned localMisses = 0;
+  while(true) {
+    //idle workers still have to answer, or two thieves wait on each other
+    serveStealRequests();
+    if(SharedSolverCacheOpt) {
+      exchangeSolverCache();
+    }
+
+    int flag, count;
+    MPI_Status status;
+    MPI_Iprobe(MASTER_NODE, MPI_ANY_TAG, runComm, &flag, &status);
+    if(flag) {
+      MPI_Get_count(&status, MPI_CHAR, &count);
+      std::vector<char> buffer(count+1);
+      MPI_Recv(&buffer[0], count, MPI_CHAR, MASTER_NODE, status.MPI_TAG, runComm, &status);
+      if(status.MPI_TAG == KILL) {
+        haltFromMaster = true;
+        haltExecution = true;
+        return;
+      }
+      if(status.MPI_TAG == SEARCH_MODE) {
+        switchSearchMode(std::string(&buffer[0], count));
+        continue;
+      }
+      assert(status.MPI_TAG == START_PREFIX_TASK && "illegal tag while stealing");
+      std::cout << "Process: "<<coreId<<" Prefix Task: Length:"<<count<<"\n";
+      resumeFromPrefixPacket(&buffer[0], count);
+      gotWork = true;
+    }
+
+    if(waiting4Steal) {
+      MPI_Iprobe(victim, STEAL_RESP, runComm, &flag, &status);
+      if(flag) {
+        MPI_Get_count(&status, MPI_CHAR, &count);
+        std::vector<char> buffer(count+1);
+        MPI_Recv(&buffer[0], count, MPI_CHAR, victim, STEAL_RESP, runComm, &status);
+        waiting4Steal = false;
+        if(count <= 1) {
+          if(std::find(localPeers.begin(), localPeers.end(), victim) !=
+             localPeers.end()) {
+            ++localMisses;
+          }
+          //victim had nothing to give, back off before the next try
+          if(!pregenerateSlice()) {
+            usleep(1000);
+          }
+        } else {
+          if(ENABLE_LOGGING) {
+            mylogFile << "Process: "<<coreId<<" Stole from: "<<victim<<" Length:"<<count<<"\n";
+            mylogFile.flush();
+          }
+          resumeFromPrefixPacket(&buffer[0], count);
+          gotWork = true;
+        }
+      }
+    } else if(gotWork) {
+      return;
+    } else if(numPeers > 0) {
+      if(!localPeers.empty() && (localMisses < localPeers.size() ||
+                                 (int)localPeers.size() == numPeers)) {
+        victim = localPeers[theRNG.getInt32() % localPeers.size()];
+      } else {
+        victim = FIRST_WORKER + theRNG.getInt32() % numPeers;
+        if(victim >= coreId) {
+          ++victim;
+        }
+        localMisses = 0;
+      }
+      char dummy;
+      MPI_Send(&dummy, 1, MPI_CHAR, victim, STEAL_REQ, runComm);
+      waiting4Steal = true;
+    }
+  }
+}
+
+void Executor::encodeSolverSeeds(std::vector<ExecutionState*>& offloadVec, std::vector<char>& out) {
+  std::vector<SharedSolverCache::Seed> seeds;
+  for(auto it=offloadVec.begin(); it!=offloadVec.end(); ++it) {
+    ExecutionState &es = **it;
+    if(es.isNormalState()) {
+      applyDeferredConstraints(es);
+    }
+    std::vector<const Array*> objects;
+    for(unsigned i=0; i<es.symbolics->size(); i++) {
+      objects.push_back((*es.symbolics)[i].second);
+    }
+    //usually answered by the cex cache, the state just took its last branch
+    std::vector<std::vector<unsigned char> > values;
+    if(objects.empty() || !solver->getInitialValues(es, objects, values)) {
+      continue;
+    }
+    SharedSolverCache::Seed seed;
+    for(unsigned i=0; i<objects.size(); i++) {
+      seed[objects[i]->name] = values[i];
+    }
+    seeds.push_back(seed);
+  }
+  if(!seeds.empty()) {
+    SharedSolverCache::encodeSeeds(seeds, out);
+  }
+}
+
+size_t Executor::takeSolverSeeds(const char* packet, size_t count,
+                                 std::vector<ExecutionState::ReplaySeed>& seeds) {
+  size_t seedBytes = SharedSolverCache::decodeSeeds(packet, count, seeds);
+  for(unsigned i=0; sharedSolverCache && i<seeds.size(); i++) {
+    sharedSolverCache->addSeed(seeds[i]);
+  }
+  return seedBytes;
+}
+
+void Executor::resumeFromPrefixPacket(const char* packet, int count) {
+  //the donor may send a solution of every offloaded path first
+  std::vector<ExecutionState::ReplaySeed> seeds;
+  size_t seedBytes = takeSolverSeeds(packet, count, seeds);
+  packet += seedBytes;
+  count -= seedBytes;
+
+  enablePrefixChecking();
+  setTestPrefixDepth(count);
+
+  //offloaded prefixes come packed, phase 1 prefixes raw
+  std::vector<std::vector<unsigned char> > recvPrefixes;
+  if(PrefixCodec::isPrefixPacket(packet, count)) {
+    if(!PrefixCodec::decode(packet, count, recvPrefixes)) {
+      klee_warning("dropping malformed prefix packet of size %d", count);
+    }
+  } else if(count > 0) {
+    recvPrefixes.push_back(std::vector<unsigned char>(packet, packet+count));
+  }
+  
+  std::vector<ExecutionState*> rangingResumedStates;
+  std::vector<PrefixTree::Node*> resumeNodes;
+  ExecutionState* replayState = 0;
+
+  for(int pref=0; pref<recvPrefixes.size(); pref++) {
+    std::vector<unsigned char> &recvP = recvPrefixes[pref];
+    if(ENABLE_OFFLOAD_LOGGING) {
+      mylogFile<<"PPrefix: "<<recvP.size()<<"\n";
+      for(int c=0; c<recvP.size(); c++) {
+        mylogFile<<recvP[c];  
+      }
+      mylogFile.flush();
+      mylogFile<<"\n";
+    }
+
+    //coverting it to 101010... format
+    std::vector<unsigned char> resP;
+    PrefixCodec::toTreePath(recvP, resP);
+
+    //the nearest state on the path, the deeper ones may have been demoted
+    size_t resumeLength;
+    PrefixTree::Node* resumeNode = prefixTree->getNearestToResume(resP,
+                                                                  resumeLength);
+    if(ENABLE_OFFLOAD_LOGGING) {
+      mylogFile << "Path to Resume: ";
+      for(unsigned int x=0;x<resumeLength;x++) {
+        mylogFile<<resP[x];
+      }
+      mylogFile<<"\n";
+    }
+
+    ExecutionState* resumedState;
+    if(resumeNode && resumeNode->state) {
+      resumedState = resumeNode->state;
+    } else {
+      //nothing suspended on this path (e.g. a stolen prefix), replay it
+      //from a fresh copy of the initial state
+      assert(shippedStateTemplate && "no suspended state to resume from");
+      if(!replayState) {
+        replayState = copyStartState();
+        replayState->ptreeNode = processTree->attach(replayState);
+        if(pathWriter) {
+          replayState->pathOS = pathWriter->open();
+        }
+        if(symPathWriter) {
+          replayState->symPathOS = symPathWriter->open();
+        }
+        nonRecoveryStates.insert(replayState);
+      }
+      resumedState = replayState;
+    }
+    if(ENABLE_OFFLOAD_LOGGING) {
+      mylogFile << "Resume states prefix lists size: "<<resumedState->getPrefixesSize()<<"\n";
+      mylogFile.flush();
+    }
+
+    resumedState->addPrefix(reinterpret_cast<const char*>(recvP.data()),
+                            recvP.size());
+    if(ENABLE_OFFLOAD_LOGGING) {
+      mylogFile<<"Adding prefix: "<<recvP.size()<<"\n";
+      mylogFile.flush();
+    }
+    
+    auto iu = std::find(rangingResumedStates.begin(), rangingResumedStates.end(),
+        resumedState);
+    if(iu == rangingResumedStates.end()) {
+      rangingResumedStates.push_back(resumedState);
+      if(resumedState != replayState) {
+        resumeNodes.push_back(resumeNode);
+      }
+    }
+  }
+
+  if(ENABLE_OFFLOAD_LOGGING) {
+    mylogFile << "Number of states ot resume: "<<rangingResumedStates.size()<<"\n";
+    mylogFile.flush();
+    for(int jj=0; jj<rangingResumedStates.size(); ++jj) {
+      mylogFile<<"resume state prefix list: "<<rangingResumedStates[jj]->getPrefixesSize()<<" State depth: "
+        <<rangingResumedStates[jj]->depth<<"\n";
+      mylogFile.flush();
+    }
+  }
+  
+  for(unsigned i = 0; i < rangingResumedStates.size(); i++) {
+    //the seeds do not come in the order of the prefixes, a state takes the
+    //first its constraints agree with. The internal branches follow the
+    //model, so a state replaying several prefixes keeps asking the solver.
+    if(ConcolicReplay && rangingResumedStates[i]->getPrefixesSize() == 1) {
+      rangingResumedStates[i]->adoptReplaySeed(seeds);
+    }
+    insertState(rangingResumedStates[i]);
+  }
+  std::vector<ExecutionState *> resumedStates(states.begin(), states.end());
+  searcher->update(0, resumedStates, std::vector<ExecutionState *>());
+  for(auto hh = resumeNodes.begin(); hh != resumeNodes.end(); ++hh) {
+    (*hh)->state = 0;
+  }
+
+  rangingResumedStates.clear();
+  resumeNodes.clear();
+}
+
+bool Executor::isReplayedPathFeasible(ExecutionState &state) {
+  //the model of a concolic replay is a witness
+  if(ConcolicReplay && state.hasModel())
+    return true;
+
+  std::vector<const Array*> objects;
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    objects.push_back((*state.symbolics)[i].second);
+  std::vector< std::vector<unsigned char> > values;
+
+  solver->setTimeout(coreSolverTimeout);
+  bool feasible = solver->getInitialValues(state, objects, values);
+  solver->setTimeout(0);
+  if(ENABLE_LOGGING) {
+    mylogFile<<"Prefix replay check at depth "<<state.depth<<": "<<feasible<<"\n";
+    mylogFile.flush();
+  }
+  return feasible;
+}
+
+bool Executor::replaysFromStart(const char* packet, int count) {
+  std::vector<ExecutionState::ReplaySeed> seeds;
+  size_t seedBytes = SharedSolverCache::decodeSeeds(packet, count, seeds);
+  packet += seedBytes;
+  count -= seedBytes;
+
+  std::vector<std::vector<unsigned char> > prefixes;
+  if(PrefixCodec::isPrefixPacket(packet, count)) {
+    if(!PrefixCodec::decode(packet, count, prefixes)) {
+      return false;
+    }
+  } else if(count > 0) {
+    prefixes.push_back(std::vector<unsigned char>(packet, packet+count));
+  }
+  for(unsigned i=0; i<prefixes.size(); i++) {
+    std::vector<unsigned char> path;
+    PrefixCodec::toTreePath(prefixes[i], path);
+    size_t length;
+    PrefixTree::Node* node = prefixTree->getNearestToResume(path, length);
+    if(node && node->state) {
+      return false;
+    }
+  }
+  return !prefixes.empty();
+}
+
+/// The child replays the prefixes as the run loop would and sends the
+/// states at their ends back serialized; it exits with 1 if the worker has
+/// to replay the task itself after all.
+void Executor::startBackgroundReplay() {
+  replayPid = -1;
+  //the path streams are the worker's, the child would write into them
+  if(!shippedStateTemplate || pathWriter || symPathWriter ||
+     !replaysFromStart(&queuedTask[0], queuedTask.size())) {
+    return;
+  }
+  int pipefd[2];
+  if (pipe(pipefd) < 0) {
+    klee_warning("pipe failed (for background replay) - %s", strerror(errno));
+    return;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for background replay) - %s", strerror(errno));
+    close(pipefd[0]);
+    close(pipefd[1]);
+    return;
+  }
+
+  if (pid == 0) {
+    close(pipefd[0]);
+    std::vector<char> packet;
+    if (!replayToFrontier(&queuedTask[0], queuedTask.size(), packet)) {
+      _exit(1);
+    }
+    for (size_t sent = 0; sent < packet.size(); ) {
+      ssize_t n = write(pipefd[1], &packet[sent], packet.size() - sent);
+      if (n < 0 && errno != EINTR) {
+        _exit(1);
+      }
+      sent += std::max<ssize_t>(n, 0);
+    }
+    _exit(0);
+  }
+
+  close(pipefd[1]);
+  replayPid = pid;
+  replayFd = pipefd[0];
+  replayedStates.clear();
+  replayComplete = false;
+}
+
+bool Executor::replayToFrontier(const char* packet, int count,
+                                std::vector<char>& out) {
+  //the copy must not take the messages of the master, nor park states on
+  //queries of processes of its own
+  setSolverInterruptCheck(0);
+  inReplayProcess = true;
+  AsyncForkQueries = false;
+  //the searcher only sees the states to keep the bookkeeping of the
+  //interpreter, they are stepped in order here
+  searcher = new DFSSearcher();
+  std::set<ExecutionState*> running(states.begin(), states.end());
+  resumeFromPrefixPacket(packet, count);
+
+  std::vector<ExecutionState*> replaying, replayed;
+  for(auto it=states.begin(); it!=states.end(); ++it) {
+    if(!running.count(*it)) {
+      replaying.push_back(*it);
+    }
+  }
+  while(!replaying.empty()) {
+    ExecutionState &state = *replaying.back();
+    if(!state.shallIRange()) {
+      replaying.pop_back();
+      state.replayPending = false;
+      if(CheckPrefixReplay && !isReplayedPathFeasible(state)) {
+        return false;
+      }
+      replayed.push_back(&state);
+      continue;
+    }
+    KInstruction *ki = state.pc;
+    stepInstruction(state);
+    executeInstruction(state, ki);
+    //an ended path, a recovery and a parked state are the worker's
+    if(haltExecution || !removedStates.empty() || !suspendedStates.empty() ||
+       !rangingSuspendedStates.empty() || state.isSuspended()) {
+      return false;
+    }
+    for(auto it=addedStates.begin(); it!=addedStates.end(); ++it) {
+      if((*it)->isRecoveryState()) {
+        return false;
+      }
+      replaying.push_back(*it);
+    }
+    updateStates(&state);
+  }
+
+  for(auto it=replayed.begin(); it!=replayed.end(); ++it) {
+    if(!StateSerializer::canSerialize(**it)) {
+      return false;
+    }
+  }
+  StateSerializer serializer(*this);
+  serializer.serializeStates(replayed, out);
+  return !replayed.empty();
+}
+
+void Executor::readBackgroundReplay(bool block) {
+  char buffer[65536];
+  while(replayPid > 0) {
+    struct pollfd fd = { replayFd, POLLIN, 0 };
+    int n;
+    do {
+      n = poll(&fd, 1, block ? -1 : 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+      return;
+    }
+    ssize_t r;
+    do {
+      r = read(replayFd, buffer, sizeof(buffer));
+    } while (r < 0 && errno == EINTR);
+    if (r > 0) {
+      replayedStates.insert(replayedStates.end(), buffer, buffer + r);
+      continue;
+    }
+
+    //the pipe closed, the child is done
+    close(replayFd);
+    replayFd = -1;
+    int status;
+    while (waitpid(replayPid, &status, 0) < 0 && errno == EINTR)
+      ;
+    replayPid = -1;
+    replayComplete = r == 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+                     !replayedStates.empty();
+  }
+}
+
+bool Executor::adoptBackgroundReplay(const char* packet, int count) {
+  //the child is ahead of a replay started now, wait for it
+  if(replayPid > 0) {
+    readBackgroundReplay(true);
+  }
+  bool complete = replayComplete;
+  std::vector<char> replayed;
+  replayed.swap(replayedStates);
+  replayPid = 0;
+  replayComplete = false;
+  if(!complete) {
+    return false;
+  }
+
+  std::vector<ExecutionState::ReplaySeed> seeds;
+  size_t seedBytes = SharedSolverCache::decodeSeeds(packet, count, seeds);
+  enablePrefixChecking();
+  if(!addShippedStates(&replayed[0], replayed.size())) {
+    return false;
+  }
+  //the prefixes were replayed, as if here
+  setTestPrefixDepth(count - seedBytes);
+  for(unsigned i=0; sharedSolverCache && i<seeds.size(); i++) {
+    sharedSolverCache->addSeed(seeds[i]);
+  }
+  ++stats::backgroundReplays;
+  if(ENABLE_LOGGING) {
+    mylogFile<<"Replayed in the background: "<<replayed.size()<<" bytes\n";
+    mylogFile.flush();
+  }
+  return true;
+}
+
+void Executor::cancelBackgroundReplay() {
+  if(replayPid > 0) {
+    kill(replayPid, SIGKILL);
+    close(replayFd);
+    int status;
+    while (waitpid(replayPid, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+  replayPid = 0;
+  replayFd = -1;
+  replayComplete = false;
+  replayedStates.clear();
+}
+
+bool Executor::sendStateSnapshots(std::vector<ExecutionState*>& offloadVec) {
+  for(auto it=offloadVec.begin(); it!=offloadVec.end(); ++it) {
+    if(!StateSerializer::canSerialize(**it)) {
+      return false;
+    }
+  }
+
+  std::vector<char> packet;
+  StateSerializer serializer(*this);
+  serializer.serializeStates(offloadVec, packet);
+  if(ENABLE_OFFLOAD_LOGGING) {
+    mylogFile<<"Shipping "<<offloadVec.size()<<" states: "<<packet.size()<<" bytes\n";
+    mylogFile.flush();
+  }
+  MPI_Send(&packet[0], packet.size(), MPI_CHAR, 0, OFFLOAD_STATE_RESP, runComm);
+  numOffloadsSent++;
+  return true;
+}
+
+bool Executor::addShippedStates(const char* packet, unsigned size) {
+  assert(shippedStateTemplate && "no template to rebuild the states from");
+  std::vector<ExecutionState*> shipped;
+  StateSerializer serializer(*this);
+  if(!serializer.deserializeStates(packet, size, *shippedStateTemplate, shipped)) {
+    return false;
+  }
+
+  unsigned maxDepth = 0;
+  for(auto it=shipped.begin(); it!=shipped.end(); ++it) {
+    ExecutionState *es = *it;
+    es->ptreeNode = processTree->attach(es);
+    if(pathWriter) {
+      es->pathOS = pathWriter->open();
+    }
+    if(symPathWriter) {
+      es->symPathOS = symPathWriter->open();
+    }
+    maxDepth = std::max(maxDepth, es->depth);
+    if(userSearcherRequiresSubtrees()) {
+      es->subtree = ++lastSubtree;
+    }
+    insertState(es);
+    nonRecoveryStates.insert(es);
+  }
+  //the states continue where the donor stopped, nothing to range over
+  setTestPrefixDepth(std::max(maxDepth, 1u));
+  searcher->update(0, shipped, std::vector<ExecutionState *>());
+  if(ENABLE_OFFLOAD_LOGGING) {
+    mylogFile<<"Received "<<shipped.size()<<" shipped states\n";
+    mylogFile.flush();
+  }
+  return true;
+}
+
+void Executor::check2Offload() {
+  int flag;
+  MPI_Status status;
+  MPI_Iprobe(MASTER_NODE, MPI_ANY_TAG, runComm, &flag, &status);
+  waiting4OffloadReq = true;
+	if(flag) {
+  	if(status.MPI_TAG == OFFLOAD) {
+    	int count;
+      char buffer;
+    	MPI_Get_count(&status, MPI_CHAR, &count);
+    	MPI_Recv(&buffer, count, MPI_CHAR, MASTER_NODE, OFFLOAD, runComm, &status);
+    	if(ENABLE_LOGGING) {
+        mylogFile << "Offload Request\n";
+        mylogFile.flush();
+      }
+    	bool valid;
+    	ExecutionState* state2Remove = offloadFromStatesVector(valid);
+
+    	if(valid) {
+        assert(state2Remove);
+        //pathWriter->readStream(getPathStreamID(*state2Remove), packet2send);
+        std::vector<char> hist = state2Remove->branchHist.toVector();
+        char* pkt2Send = (char*)malloc(hist.size()*sizeof(char));
+        for(int x=0; x<hist.size();  x++) {
+          pkt2Send[x] = hist[x];
+        }
+        //if(ENABLE_LOGGING) printPath(pkt2Send, mylogFile, "Packet to Send: ");
+        MPI_Send(pkt2Send, hist.size(), MPI_CHAR, 0, OFFLOAD_RESP, runComm);
+        numOffloadsSent++;
+        if(ENABLE_LOGGING) {
+          mylogFile << "Offloading State Act Depth"<<state2Remove->actDepth<<" Prefix Depth: "<<state2Remove->depth<<"\n";
+          mylogFile.flush();
+        }
+        std::vector<ExecutionState *> remStates;
+        remStates.push_back(state2Remove);
+        searcher->update(nullptr, std::vector<ExecutionState *>(), remStates);
+        auto ii = states.find(state2Remove);
+        assert(ii != states.end()); //can not be case as the state has to exist
+        eraseState(ii); //remove the state from states vector
+        rangingSuspendedStates.push_back(state2Remove);
+        auto hit = std::find(removedStates.begin(), removedStates.end(), state2Remove);
+        if(hit != removedStates.end()) {
+          removedStates.erase(hit);
+        }
+   		} else {
+        char offloadFailed = 'x';
+        MPI_Send(&offloadFailed, 1, MPI_CHAR, 0, OFFLOAD_RESP, runComm);
+      }
+    	waiting4OffloadReq = false;
+  	} else if(status.MPI_TAG == KILL) {
+      char dummyRecv;
+      MPI_Recv(&dummyRecv, 1, MPI_CHAR, MASTER_NODE, KILL, runComm, &status);
+      haltExecution = true;
+      haltFromMaster = true;
+    }
+	}
+}
+
+void Executor::updateStates(ExecutionState *current) {
+  //the forks which left the share of this worker (--path-intervals) end
+  //here, without a test case
+  if (!pathRange.isAll() && !addedStates.empty()) {
+    std::vector<ExecutionState *> forked(addedStates);
+    if (current && std::find(removedStates.begin(), removedStates.end(),
+                             current) == removedStates.end())
+      forked.push_back(current);
+    for (unsigned i = 0; i < forked.size(); i++) {
+      if (!forked[i]->isRecoveryState() && !checkRange(*forked[i]))
+        terminateState(*forked[i]);
+    }
+  }
+
+  //the searcher and the offload order read the distances
+  if (targetDistance) {
+    if (current)
+      current->targetDistance = targetDistance->getDistance(*current);
+    for (unsigned i = 0; i < addedStates.size(); i++)
+      addedStates[i]->targetDistance = targetDistance->getDistance(*addedStates[i]);
+  }
+
+  //the states which left the region reaching a target end here, before
+  //the searcher or the offloader see them
+  if (targetDistance && PruneTargetUnreachable &&
+      targetDistance->getNumTargets()) {
+    std::vector<ExecutionState *> checked(addedStates);
+    if (current && std::find(removedStates.begin(), removedStates.end(),
+                             current) == removedStates.end())
+      checked.push_back(current);
+    for (unsigned i = 0; i < checked.size(); i++) {
+      ExecutionState *es = checked[i];
+      if (es->targetDistance || es->isRecoveryState() || es->isSuspended() ||
+          std::find(removedStates.begin(), removedStates.end(), es) !=
+              removedStates.end())
+        continue;
+      ++stats::targetUnreachableStates;
+      terminateState(*es);
+    }
+  }
+
+  if (searcher) {
+    if (!removedStates.empty()) {
+      /* we don't want to pass suspended states to the searcher */
+      std::vector<ExecutionState *> filteredStates;
+      for (std::vector<ExecutionState *>::iterator i = removedStates.begin(); i != removedStates.end(); i++) {
+        ExecutionState *removedState = *i;
+        if (removedState->isNormalState() && removedState->isSuspended()) {
+            continue;
+        }
+        filteredStates.push_back(removedState);
+        //numOffloadStates--;
+      }
+      searcher->update(current, addedStates, filteredStates);
+    } else {
+      searcher->update(current, addedStates, removedStates);
+    }
+
+    /* handle suspended states */
+    for (std::vector<ExecutionState *>::iterator i = suspendedStates.begin(); i != suspendedStates.end(); i++) {
+      searcher->removeState(*i);
+      //numOffloadStates--;
+    }
+    suspendedStates.clear();
+
+    /* handle resumed states */
+    for (std::vector<ExecutionState *>::iterator i = resumedStates.begin(); i != resumedStates.end(); i++) {
+      searcher->addState(*i);
+      //numOffloadStates++;
+    }
+    resumedStates.clear();
+  }
+  
+  states.reserve(addedStates.size());
+  for (std::vector<ExecutionState *>::iterator it = addedStates.begin(),
+                                               ie = addedStates.end();
+       it != ie; ++it)
+    insertState(*it);
+  //numOffloadStates = numOffloadStates + addedStates.size();
+
+	//adding states to the suspended states prefix map
+  for(auto it = rangingSuspendedStates.begin(); it != rangingSuspendedStates.end(); ++it) {
+   	std::vector<unsigned char> recvP;
+		std::vector<char> branches = (*it)->branchHist.toVector();
+		std::vector<unsigned char> hist(branches.begin(), branches.end());
+		PrefixCodec::toTreePath(hist, recvP);
+
+    (*it)->clearPrefixes();
+ 
+		//pathWriter->readStream(getPathStreamID(**it), suspendedStatePath);
+    if(!prefixTree->addToTree(recvP, *it, util::getWallTime())) {
+      //a replay from an ancestor parked the path again
+      if(!(*it)->isRecoveryState() && !(*it)->isSuspended()) {
+        freeParkedState(*it);
+      }
+      continue;
+    }
+    //the parked state leaves the process tree until it is resumed
+    if(!(*it)->isRecoveryState() && (*it)->ptreeNode) {
+      (*it)->ptreeNode = processTree->detach((*it)->ptreeNode);
+    }
+  }
+	
+  addedStates.clear();
+	rangingSuspendedStates.clear();
+
+  for (std::vector<ExecutionState *>::iterator it = removedStates.begin(),
+                                               ie = removedStates.end();
+       it != ie; ++it) {
+    ExecutionState *es = *it;
+    StateSet::iterator it2 = states.find(es);
+    if (it2 == states.end()) {
+      /* TODO: trying to handle removal of suspended states. Find a better solution... */
+      assert(es->isNormalState() && es->isSuspended());
+      continue;
+    } else {
+      //numOffloadStates--;
+      eraseState(it2);
+    }
+    std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
+      seedMap.find(es);
+    if (it3 != seedMap.end()) {
+      if (generationMode)
+        seedPaths.push_back(es->branchHist.toVector());
+      seedMap.erase(it3);
+    }
+    processTree->remove(es->ptreeNode);
+    delete es;
+  }
+  removedStates.clear();
+  
+  if(enableLB) newCheck2Offload();
+  else if(coreId != 0) checkKill();
+  if(enableStealing) serveStealRequests();
+  if(progressThread.joinable()) publishOffloadSnapshot();
+}
+
+ExecutionState* Executor::offloadOriginatingStates(bool &valid) {
+  valid = false;
+  if(haltExecution || haltFromMaster) return NULL;
+  if(states.size() > 1) {
+    //look for the first non recovery and non suspended state
+    for(auto it=states.begin(); it!=states.end(); ++it) {
+      if((*it)->isNormalState() && (!((*it)->isRecoveryState())) &&
+        ((!(*it)->isSuspended()))) {
+        //continue;
+        bool isRemoved=false;
+        for(auto it2=removedStates.begin(); it2!=removedStates.end(); ++it2) {
+          if(*it == *it2) {
+            isRemoved=true;
+            break;
+          }
+        }
+        if(isRemoved)
+          continue;
+        valid = true;
+        return *it;
+			} else if((*it)->isRecoveryState() && (!(*it)->isSuspended())) {
+				bool isRemoved=false;
+				for(auto it2=removedStates.begin(); it2!=removedStates.end(); ++it2) {
   				if(*it == *it2) {
     				isRemoved=true;
    					break;
@@ -3445,71 +5518,376 @@ ExecutionState* Executor::offloadOriginatingStates(bool &valid) {
   return NULL;
 }
 
+void Executor::sendHeartbeat() {
+  double now = util::getWallTime();
+  if(now - lastHeartbeatTime < HeartbeatInterval/1000.0) {
+    return;
+  }
+  //the buffer belongs to the last send until it completes
+  if(heartbeatPending) {
+    int done;
+    MPI_Test(&heartbeatReq, &done, MPI_STATUS_IGNORE);
+    if(!done) {
+      return;
+    }
+  }
+  uint64_t instructions = stats::instructions;
+  uint64_t covered = stats::coveredInstructions;
+  heartbeat[0] = numOffloadStates;
+  heartbeat[1] = ready2Offload;
+  heartbeat[2] = instructions - lastHeartbeatInstructions;
+  heartbeat[3] = covered - lastHeartbeatCovered;
+  heartbeat[4] = estimateRemainingWork();
+  heartbeat[5] = nearestTargetDistance();
+  MPI_Isend(heartbeat, 6, MPI_UNSIGNED, MASTER_NODE, HEARTBEAT, runComm,
+      &heartbeatReq);
+  heartbeatPending = true;
+  lastHeartbeatTime = now;
+  lastHeartbeatInstructions = instructions;
+  lastHeartbeatCovered = covered;
+}
+
+void Executor::sendClusterStats() {
+  double now = util::getWallTime();
+  if(now - lastClusterStatsTime < ClusterStatsInterval/1000.0) {
+    return;
+  }
+  if(clusterStatsPending) {
+    int done;
+    MPI_Test(&clusterStatsReq, &done, MPI_STATUS_IGNORE);
+    if(!done) {
+      return;
+    }
+  }
+  clusterStats[ClusterStats::Instructions] = stats::instructions;
+  clusterStats[ClusterStats::States] = getNumActiveStates();
+  clusterStats[ClusterStats::SuspendedStates] = getNumSuspendedStates();
+  clusterStats[ClusterStats::SolverTime] = stats::solverTime;
+  clusterStats[ClusterStats::Queries] = stats::queries;
+  clusterStats[ClusterStats::CacheHits] = stats::queryCacheHits +
+      stats::queryCexCacheHits + stats::querySharedCacheHits;
+  clusterStats[ClusterStats::CoveredInstructions] = stats::coveredInstructions;
+  clusterStats[ClusterStats::Offloads] = numOffloadsSent;
+  clusterStats[ClusterStats::ReplayTime] = stats::replayTime;
+  clusterStats[ClusterStats::ExplorationTime] = stats::explorationTime;
+  clusterStats[ClusterStats::RecoveryTime] = stats::recoveryTime;
+  clusterStats[ClusterStats::IdleTime] = stats::idleTime;
+  for (unsigned i = 0; i < util::NumMemoryCategories; i++)
+    clusterStats[ClusterStats::ExprMemory + i] =
+        util::GetMemoryUsage((util::MemoryCategory) i);
+  MPI_Isend(clusterStats, ClusterStats::NumFields, MPI_UINT64_T, MASTER_NODE,
+      CLUSTER_STATS, runComm, &clusterStatsReq);
+  clusterStatsPending = true;
+  lastClusterStatsTime = now;
+}
+
+unsigned Executor::estimateRemainingWork() {
+  double work = 0;
+  for(auto it=states.begin(); it!=states.end(); ++it) {
+    if(!(*it)->isSuspended() && (*it)->ptreeNode) {
+      work += processTree->forkRates.estimate((*it)->ptreeNode->depth);
+    }
+  }
+  return work < UINT_MAX ? (unsigned) work : UINT_MAX;
+}
+
+unsigned Executor::nearestTargetDistance() {
+  uint64_t nearest = 0;
+  if(!targetDistance) {
+    return 0;
+  }
+  for(auto it=states.begin(); it!=states.end(); ++it) {
+    uint64_t dist = (*it)->targetDistance;
+    if(!(*it)->isSuspended() && dist && (!nearest || dist < nearest)) {
+      nearest = dist;
+    }
+  }
+  return nearest < UINT_MAX ? (unsigned) nearest : UINT_MAX;
+}
+
+void Executor::exchangeSolverCache() {
+  //the master is never sent entries, it probes any source
+  assert(coreId != MASTER_NODE);
+  double now = util::getWallTime();
+  if(now - lastSolverCacheTime < SharedSolverCacheInterval/1000.0) {
+    return;
+  }
+  lastSolverCacheTime = now;
+
+  int flag, count;
+  MPI_Status status;
+  MPI_Iprobe(MPI_ANY_SOURCE, SOLVER_CACHE, runComm, &flag, &status);
+  while(flag) {
+    MPI_Get_count(&status, MPI_CHAR, &count);
+    std::vector<char> buffer(count);
+    MPI_Recv(&buffer[0], count, MPI_CHAR, status.MPI_SOURCE, SOLVER_CACHE, runComm, &status);
+    if(!sharedSolverCache->addPacket(&buffer[0], count)) {
+      klee_warning("ignoring a malformed solver cache packet from %d", status.MPI_SOURCE);
+    }
+    MPI_Iprobe(MPI_ANY_SOURCE, SOLVER_CACHE, runComm, &flag, &status);
+  }
+
+  //the packet belongs to the last sends until they complete
+  if(!solverCacheReqs.empty()) {
+    MPI_Testall(solverCacheReqs.size(), &solverCacheReqs[0], &flag, MPI_STATUSES_IGNORE);
+    if(!flag) {
+      return;
+    }
+    solverCacheReqs.clear();
+  }
+  solverCachePacket.clear();
+  if(!sharedSolverCache->takeOutgoing(solverCachePacket)) {
+    return;
+  }
+  if(PersistentSolverCache != "") {
+    appendPersistentSolverCache(solverCachePacket);
+  }
+  int numCores = getNumInterpreterRanks();
+  for(int peer = FIRST_WORKER; peer < numCores; peer++) {
+    if(peer == coreId) {
+      continue;
+    }
+    solverCacheReqs.push_back(MPI_Request());
+    MPI_Isend(&solverCachePacket[0], solverCachePacket.size(), MPI_CHAR, peer,
+        SOLVER_CACHE, runComm, &solverCacheReqs.back());
+  }
+}
+
+/* the entries are keyed by the MD5 of the bitcode, as the analysis cache */
+void Executor::loadPersistentSolverCache(llvm::Module *module) {
+  std::string bitcode;
+  raw_string_ostream os(bitcode);
+  WriteBitcodeToFile(module, os);
+  os.flush();
+  MD5 hash;
+  hash.update(bitcode);
+  MD5::MD5Result result;
+  hash.final(result);
+  memcpy(&persistentCacheKey, result, sizeof(persistentCacheKey));
+
+  if(sharedSolverCache->loadFile(PersistentSolverCache, persistentCacheKey)) {
+    klee_message("loaded %u solver cache entries from %s",
+                 (unsigned) sharedSolverCache->size(),
+                 PersistentSolverCache.c_str());
+  }
+}
+
+void Executor::persistSolverCache(bool final) {
+  double now = util::getWallTime();
+  if(!final && now - lastSolverCacheTime < SharedSolverCacheInterval/1000.0) {
+    return;
+  }
+  lastSolverCacheTime = now;
+
+  std::vector<char> packet;
+  if(sharedSolverCache->takeOutgoing(packet)) {
+    appendPersistentSolverCache(packet);
+  }
+}
+
+void Executor::appendPersistentSolverCache(const std::vector<char> &packet) {
+  if(!SharedSolverCache::appendToFile(PersistentSolverCache,
+                                      persistentCacheKey, packet)) {
+    klee_warning_once(0, "unable to append to the solver cache %s",
+                      PersistentSolverCache.c_str());
+  }
+}
+
+void Executor::exchangeCoverage() {
+  assert(coreId != MASTER_NODE);
+  double now = util::getWallTime();
+  if(now - lastCoverageTime < SharedCoverageInterval/1000.0) {
+    return;
+  }
+  lastCoverageTime = now;
+
+  int flag, count;
+  MPI_Status status;
+  MPI_Iprobe(MPI_ANY_SOURCE, SHARED_COVERAGE, runComm, &flag, &status);
+  while(flag) {
+    MPI_Get_count(&status, MPI_CHAR, &count);
+    std::vector<char> buffer(count ? count : 1);
+    MPI_Recv(&buffer[0], count, MPI_CHAR, status.MPI_SOURCE, SHARED_COVERAGE, runComm, &status);
+    unsigned merged;
+    if(!statsTracker->mergeCoverage(&buffer[0], count, merged)) {
+      klee_warning("ignoring a coverage bitmap of %d bytes from %d", count, status.MPI_SOURCE);
+    }
+    MPI_Iprobe(MPI_ANY_SOURCE, SHARED_COVERAGE, runComm, &flag, &status);
+  }
+
+  if(!coverageReqs.empty()) {
+    MPI_Testall(coverageReqs.size(), &coverageReqs[0], &flag, MPI_STATUSES_IGNORE);
+    if(!flag) {
+      return;
+    }
+    coverageReqs.clear();
+  }
+  //only send once this worker covered new code itself
+  uint64_t covered = stats::coveredInstructions;
+  if(covered == lastSharedCovered) {
+    return;
+  }
+  lastSharedCovered = covered;
+  statsTracker->getCoverage(coveragePacket);
+  if(coveragePacket.empty()) {
+    return;
+  }
+  int numCores = getNumInterpreterRanks();
+  for(int peer = FIRST_WORKER; peer < numCores; peer++) {
+    if(peer == coreId) {
+      continue;
+    }
+    coverageReqs.push_back(MPI_Request());
+    MPI_Isend(&coveragePacket[0], coveragePacket.size(), MPI_CHAR, peer,
+        SHARED_COVERAGE, runComm, &coverageReqs.back());
+  }
+}
+
+void Executor::exchangeFingerprints() {
+  assert(coreId != MASTER_NODE);
+  double now = util::getWallTime();
+  if(now - lastFingerprintTime < SharedFingerprintInterval/1000.0) {
+    return;
+  }
+  lastFingerprintTime = now;
+
+  int flag, count;
+  MPI_Status status;
+  MPI_Iprobe(MPI_ANY_SOURCE, STATE_FINGERPRINTS, runComm, &flag, &status);
+  while(flag) {
+    MPI_Get_count(&status, MPI_CHAR, &count);
+    std::vector<char> buffer(count ? count : 1);
+    MPI_Recv(&buffer[0], count, MPI_CHAR, status.MPI_SOURCE, STATE_FINGERPRINTS, runComm, &status);
+    if(!stateFingerprints->addPacket(&buffer[0], count)) {
+      klee_warning("ignoring %d bytes of fingerprints from %d", count, status.MPI_SOURCE);
+    }
+    MPI_Iprobe(MPI_ANY_SOURCE, STATE_FINGERPRINTS, runComm, &flag, &status);
+  }
+
+  if(!fingerprintReqs.empty()) {
+    MPI_Testall(fingerprintReqs.size(), &fingerprintReqs[0], &flag, MPI_STATUSES_IGNORE);
+    if(!flag) {
+      return;
+    }
+    fingerprintReqs.clear();
+  }
+  if(!stateFingerprints->takeOutgoing(fingerprintPacket)) {
+    return;
+  }
+  int numCores = getNumInterpreterRanks();
+  for(int peer = FIRST_WORKER; peer < numCores; peer++) {
+    if(peer == coreId) {
+      continue;
+    }
+    fingerprintReqs.push_back(MPI_Request());
+    MPI_Isend(&fingerprintPacket[0], fingerprintPacket.size(), MPI_CHAR, peer,
+        STATE_FINGERPRINTS, runComm, &fingerprintReqs.back());
+  }
+}
+
+double Executor::getQueueDrainTime(unsigned queueSize) {
+  double elapsed = util::getWallTime() - offloadStartTime;
+  if(completedPaths == 0 || elapsed <= 0) {
+    //no path finished yet, paths are expensive
+    return -1;
+  }
+  return queueSize * elapsed / completedPaths;
+}
+
+bool Executor::isReady2Offload(unsigned queueSize) {
+  if(!adaptiveOffload) {
+    //hysteresis between the two thresholds
+    return ready2Offload ? (queueSize >= OFFLOAD_NOT_READY_THRESH)
+                         : (queueSize >= OFFLOAD_READY_THRESH);
+  }
+  if(queueSize < 2) {
+    return false;
+  }
+  double drainTime = getQueueDrainTime(queueSize);
+  if(drainTime < 0) {
+    return true;
+  }
+  //cheap paths are not worth a replay elsewhere
+  return ready2Offload ? (drainTime >= OffloadMinDrainTime)
+                       : (drainTime >= 2*OffloadMinDrainTime);
+}
+
+unsigned Executor::numStates2Donate(unsigned available) {
+  if(!adaptiveOffload) {
+    //give away 1/4, at most 16, none if fewer than 4
+    if(available < 4) {
+      return 0;
+    } else if(available > 64) {
+      return 16;
+    }
+    return available/4;
+  }
+  if(available < 2) {
+    return 0;
+  }
+  //share the queue evenly with the idle workers
+  unsigned n = (available*idleWorkers)/(idleWorkers+1);
+  if(n < 1) {
+    n = 1;
+  }
+  if(n > OffloadMaxStates) {
+    n = OffloadMaxStates;
+  }
+  return n;
+}
+
 int Executor::offloadFromStatesVector(std::vector<ExecutionState*>& offloadVec) {
-	int minSize;	
-  if(!haltExecution && !haltFromMaster && ready2Offload) {
-		//first calculate the number of states that can be offloaded
-		//right now offloading 1/4 of the states
-		//for(auto it=states.begin(); it!=states.end(); ++it) {
-		//	if(!(*it)->isSuspended()) {
-		//		numStates2Offload++;
-		//	}
-		//}
-		//numStates2Offload = numStates2Offload/4;
-		//if(numStates2Offload > 16) {
-		//	numStates2Offload = 16;
-		//}
-
-    //if(numStates2Offload < 1) {
-    //  return 0;
-    //}
-    assert(removedStates.size() == 0);
-		for(auto it=states.begin(); it!=states.end(); ++it) {
-			if(!(*it)->isSuspended()) {
-      	//bool isRemoved=false;
-				//for(auto it2=removedStates.begin(); it2!=removedStates.end(); ++it2) {
-  			//	if(*it == *it2) {
-    	  //			isRemoved=true;
-    		//		break;
-  			//	}
-				//}
-				//if(isRemoved)
-  			//	continue;
-				if(offloadVec.size() == 0) {
-					minSize = (*it)->branchHist.size();
-				}	else {
-					if((*it)->branchHist.size() < minSize) {
-						minSize = (*it)->branchHist.size();
-					}
-				}
-				offloadVec.push_back(*it);
-			}
-			//if(offloadVec.size() == numStates2Offload) {
-			//	break;
-			//}
-		}		
-		int numStates2Offload = 0;
-    if(offloadVec.size() < 4) {
+	int minSize = 0;
+  if(!haltExecution && !haltFromMaster && ready2Offload) {
+    assert(removedStates.size() == 0);
+		int numStates2Offload = numStates2Donate(getNumActiveStates() +
+		                                         donatedStates.size() +
+		                                         (OffloadDependentStates ?
+		                                          numSuspendedStates : 0));
+    if(numStates2Offload == 0) {
       offloadVec.clear();
       return 0;
-    } else if(offloadVec.size() > 64) {
-      //numStates2Offload = offloadVec.size()/4;
-      numStates2Offload = 16;
-      offloadVec.erase(offloadVec.begin()+16, offloadVec.end());
-      minSize = (offloadVec[0]->branchHist).size();
-      for(int x=1; x < offloadVec.size(); x++) {
-        if((offloadVec[x]->branchHist).size() < minSize) {
-          minSize = (offloadVec[x]->branchHist).size();
+    }
+    //the states kept for donation go first, they are handed to the
+    //searcher again so that they are suspended like the others
+    if(searcher && !donatedStates.empty()) {
+      unsigned n = std::min<size_t>(numStates2Offload, donatedStates.size());
+      offloadVec.assign(donatedStates.begin(), donatedStates.begin() + n);
+      donatedStates.erase(donatedStates.begin(), donatedStates.begin() + n);
+      for(unsigned x = 0; x < offloadVec.size(); x++) {
+        insertState(offloadVec[x]);
+      }
+      searcher->update(0, offloadVec, std::vector<ExecutionState *>());
+    } else if(searcher) {
+      //the searcher picks the best states to donate, else take the first ones
+      searcher->selectStatesToOffload(numStates2Offload, OffloadCriterion,
+                                      offloadVec);
+    }
+    for(auto it=states.begin(); offloadVec.empty() && it!=states.end(); ++it) {
+      if(!(*it)->isSuspended()) {
+        offloadVec.push_back(*it);
+      }
+    }
+    //the states waiting on their recoveries make up the rest
+    if(OffloadDependentStates) {
+      for(auto it=states.begin();
+          offloadVec.size() < numStates2Offload && it!=states.end(); ++it) {
+        if(isOffloadableGroup(**it)) {
+          offloadVec.push_back(*it);
         }
       }
-    } else {
-      numStates2Offload = offloadVec.size()/4;
+    }
+    if(offloadVec.size() > numStates2Offload) {
       offloadVec.erase(offloadVec.begin()+numStates2Offload, offloadVec.end());
-      minSize = (offloadVec[0]->branchHist).size();
-      for(int x=1; x < offloadVec.size(); x++) {
-        if((offloadVec[x]->branchHist).size() < minSize) {
-          minSize = (offloadVec[x]->branchHist).size();
-        }
+    }
+    keepInsidePathRange(offloadVec);
+    if(offloadVec.empty()) {
+      return 0;
+    }
+    minSize = (offloadVec[0]->branchHist).size();
+    for(int x=1; x < offloadVec.size(); x++) {
+      if((offloadVec[x]->branchHist).size() < minSize) {
+        minSize = (offloadVec[x]->branchHist).size();
       }
     }
 		if(ENABLE_OFFLOAD_LOGGING) {
@@ -3554,7 +5932,7 @@ ExecutionState* Executor::offLoad(bool &valid) {
   valid = false;
   if(haltExecution || haltFromMaster) return NULL;
   if(searchMode == "DFS" || searchMode == "BFS" || searchMode == "RAND" ||
-      searchMode == "COVNEW") {
+      searchMode == "COVNEW" || searchMode == "DIST") {
     if(searcher->atleast2states()) {
       ExecutionState* resp = searcher->getState2Offload();
       assert(!resp->isRecoveryState());
@@ -3647,19 +6025,37 @@ void Executor::checkMemoryUsage() {
                    (memory->getUsedDeterministicSize() >> 20);
 
     if (mbs > MaxMemory) {
-      if (mbs > MaxMemory + 100) {
+      // the suspended states can be rebuilt by replaying, they go first
+      unsigned demoted = DemoteParkedStates ?
+                         demoteParkedStates(util::getWallTime()) : 0;
+      if (demoted) {
+        klee_warning("freed %u suspended states (over memory cap), their "
+                     "prefixes will be replayed", demoted);
+      } else if (mbs > MaxMemory + 100) {
         // just guess at how many to kill
         unsigned numStates = states.size();
         unsigned toKill = std::max(1U, numStates - numStates * MaxMemory / mbs);
-        klee_warning("killing %d states (over memory cap)", toKill);
         std::vector<ExecutionState *> arr;
-        for (std::set<ExecutionState *>::iterator i = states.begin(); i != states.end(); i++) {
+        for (StateSet::iterator i = states.begin(); i != states.end(); i++) {
           ExecutionState *toremove = *i;
           if ((toremove->isNormalState() && toremove->isSuspended()) || toremove->isRecoveryState())  {
             continue;
           }
+          if (std::find(removedStates.begin(), removedStates.end(), toremove) !=
+              removedStates.end()) {
+            continue;
+          }
+          // the progress thread may be sending it away
+          if (std::find(offloadSnapshot.begin(), offloadSnapshot.end(),
+                        toremove) != offloadSnapshot.end()) {
+            continue;
+          }
           arr.push_back(toremove);
         }
+        // Spill the states which can be rebuilt, kill the others.
+        bool canSpill = SpillStates && shippedStateTemplate &&
+                        memory->isDeterministic();
+        std::vector<ExecutionState *> toSpill, toTerminate;
         for (unsigned i = 0, N = arr.size(); N && i < toKill; ++i, --N) {
           unsigned idx = rand() % N;
           // Make two pulls to try and not hit a state that
@@ -3668,8 +6064,27 @@ void Executor::checkMemoryUsage() {
             idx = rand() % N;
 
           std::swap(arr[idx], arr[N - 1]);
-          terminateStateEarly(*arr[N - 1], "Memory limit exceeded.");
+          if (canSpill && StateSerializer::canSerialize(*arr[N - 1]))
+            toSpill.push_back(arr[N - 1]);
+          else
+            toTerminate.push_back(arr[N - 1]);
         }
+        if (!toSpill.empty() && !spillStates(toSpill)) {
+          toTerminate.insert(toTerminate.end(), toSpill.begin(), toSpill.end());
+          toSpill.clear();
+        }
+        EventTrace::getProcessTrace().record(EventTrace::MemoryKill,
+                                             EventTrace::now(), 0,
+                                             toTerminate.size());
+        util::MemoryCategory largest = util::GetLargestMemoryCategory();
+        klee_warning("killing %d and spilling %d states (over memory cap, "
+                     "%u snapshots, %s memory largest at %u MB)",
+                     (int) toTerminate.size(), (int) toSpill.size(),
+                     Snapshot::getLiveCount(),
+                     util::GetMemoryCategoryName(largest),
+                     (unsigned) (util::GetMemoryUsage(largest) >> 20));
+        for (unsigned i = 0; i < toTerminate.size(); ++i)
+          terminateStateEarly(*toTerminate[i], "Memory limit exceeded.");
       }
       atMemoryLimit = true;
     } else {
@@ -3678,11 +6093,153 @@ void Executor::checkMemoryUsage() {
   }
 }
 
+void Executor::freeParkedState(ExecutionState *es) {
+  nonRecoveryStates.erase(es);
+  seedMap.erase(es);
+  if (es->ptreeNode)
+    processTree->remove(es->ptreeNode);
+  delete es;
+}
+
+unsigned Executor::demoteParkedStates(double before) {
+  // without the initial state a prefix can only resume from its own state
+  if (!shippedStateTemplate)
+    return 0;
+  std::vector<PrefixTree::Node*> parked;
+  prefixTree->getParkedNodes(parked);
+  unsigned demoted = 0;
+  for (std::vector<PrefixTree::Node*>::iterator it = parked.begin(),
+         ie = parked.end(); it != ie && (*it)->parkedAt < before; ++it) {
+    ExecutionState *es = (*it)->state;
+    // recovery states and the states waiting on them are kept
+    if (es->isRecoveryState() || es->isSuspended())
+      continue;
+    (*it)->state = 0;
+    freeParkedState(es);
+    ++demoted;
+  }
+  stats::parkedDemotions += demoted;
+  return demoted;
+}
+
+bool Executor::spillStates(std::vector<ExecutionState*>& spillVec) {
+  if (!spillFile.is_open()) {
+    std::string path =
+        interpreterHandler->getOutputFilename("spilled-states.bin");
+    spillFile.open(path.c_str(), std::ios::in | std::ios::out |
+                                     std::ios::trunc | std::ios::binary);
+    if (!spillFile.is_open()) {
+      klee_warning_once(0, "could not open %s, killing states instead",
+                        path.c_str());
+      return false;
+    }
+  }
+
+  std::vector<char> packet;
+  StateSerializer serializer(*this);
+  serializer.serializeStates(spillVec, packet);
+  // the space of reloaded packets is reused
+  std::streamoff offset = 0;
+  if (!spilledPackets.empty())
+    offset = spilledPackets.back().first + spilledPackets.back().second;
+  spillFile.seekp(offset);
+  spillFile.write(&packet[0], packet.size());
+  spillFile.flush();
+  if (!spillFile) {
+    spillFile.clear();
+    klee_warning_once(0, "could not write the spill file, killing states "
+                         "instead");
+    return false;
+  }
+  spilledPackets.push_back(std::make_pair(offset, packet.size()));
+
+  // the states are gone without having finished their paths
+  for (auto it = spillVec.begin(); it != spillVec.end(); ++it) {
+    nonRecoveryStates.erase(*it);
+    removedStates.push_back(*it);
+  }
+  if (ENABLE_OFFLOAD_LOGGING) {
+    mylogFile << "Spilled " << spillVec.size() << " states: " << packet.size()
+              << " bytes\n";
+    mylogFile.flush();
+  }
+  return true;
+}
+
+bool Executor::claimPrefix(const ExecutionState &state, unsigned length) {
+  //FNV-1a, as the hashes of the test case paths
+  uint64_t hash = 14695981039346656037ULL;
+  std::vector<char> hist = state.branchHist.toVector();
+  for (unsigned i = 0; i < length; i++) {
+    hash ^= (unsigned char) hist[i];
+    hash *= 1099511628211ULL;
+  }
+  unsigned packet[2] = { (unsigned) (hash >> 32), (unsigned) hash };
+  MPI_Send(packet, 2, MPI_UNSIGNED, MASTER_NODE, PREFIX_CLAIM, runComm);
+
+  //the master stops answering once it kills the workers, keep the state
+  //then and leave the KILL to the interpreter
+  while (true) {
+    int flag;
+    MPI_Status status;
+    MPI_Iprobe(MASTER_NODE, PREFIX_CLAIM, runComm, &flag, &status);
+    if (flag) {
+      char isNew;
+      MPI_Recv(&isNew, 1, MPI_CHAR, MASTER_NODE, PREFIX_CLAIM, runComm,
+               &status);
+      if (!isNew)
+        ++stats::overlappingPrefixes;
+      return isNew;
+    }
+    MPI_Iprobe(MASTER_NODE, KILL, runComm, &flag, &status);
+    if (flag)
+      return true;
+  }
+}
+
+bool Executor::restoreDonatedStates() {
+  if (donatedStates.empty())
+    return false;
+  holdOffloadState(0);
+  if (donatedStates.empty())
+    return !states.empty();
+  for (unsigned i = 0; i < donatedStates.size(); i++) {
+    ExecutionState *es = donatedStates[i];
+    es->donateDepth = es->depth + DonateDepth;
+    if (es->overLoopBudget) {
+      es->overLoopBudget = false;
+      for (unsigned j = 0; j < es->stack.size(); j++)
+        es->stack[j].loopForks.clear();
+    }
+    insertState(es);
+  }
+  searcher->update(0, donatedStates, std::vector<ExecutionState *>());
+  donatedStates.clear();
+  return true;
+}
+
+bool Executor::reloadSpilledStates() {
+  if (spilledPackets.empty())
+    return false;
+  std::pair<std::streamoff, size_t> last = spilledPackets.back();
+  spilledPackets.pop_back();
+
+  std::vector<char> packet(last.second);
+  spillFile.seekg(last.first);
+  spillFile.read(&packet[0], packet.size());
+  if (!spillFile || !addShippedStates(&packet[0], packet.size())) {
+    spillFile.clear();
+    klee_warning("could not reload %u bytes of spilled states",
+                 (unsigned) last.second);
+  }
+  return true;
+}
+
 void Executor::doDumpStates() {
   if (!DumpStatesOnHalt || states.empty())
     return;
   klee_message("halting execution, dumping remaining states");
-  for (std::set<ExecutionState *>::iterator it = states.begin(),
+  for (StateSet::iterator it = states.begin(),
                                             ie = states.end();
        it != ie; ++it) {
     ExecutionState &state = **it;
@@ -3695,17 +6252,54 @@ void Executor::doDumpStates() {
 void Executor::run(ExecutionState &initialState, bool branchLevelHalt, bool pathPrefix) {
   bindModuleConstants();
 
+  if (SampleInstructions && !instructionSampler)
+    instructionSampler = new InstructionSampler(SampleInstructions,
+                                                kmodule->infos->getMaxID(),
+                                                SampleStacks);
+
   // Delay init till now so that ticks don't accrue during
   // optimization and such.
   initTimers();
 
   enableBranchHalt = branchLevelHalt;
 
-  states.insert(&initialState);
-  nonRecoveryStates.insert(&initialState);
-  initialState.setPrefix(upperBound);
-  initialState.setPrefixDepth(prefixDepth);
-  initialState.addPrefix(upperBound, prefixDepth);
+  //shipped states and prefixes without a suspended state to resume from
+  //are rebuilt on top of the untouched initial state
+  if (coreId != 0) {
+    shippedStateTemplate = new ExecutionState(initialState);
+    shippedStateTemplate->ptreeNode = 0;
+  }
+  bool startFromShippedStates = !startStatesPacket.empty();
+  bool skipInitialState = startFromShippedStates || startIdle;
+  offloadStartTime = util::getWallTime();
+
+  if (!skipInitialState) {
+    std::vector<ExecutionState::ReplaySeed> seeds;
+    if(upperBound) {
+      size_t seedBytes = takeSolverSeeds(upperBound, prefixDepth, seeds);
+      upperBound += seedBytes;
+      prefixDepth -= seedBytes;
+    }
+    insertState(&initialState);
+    nonRecoveryStates.insert(&initialState);
+    initialState.setPrefix(upperBound);
+    initialState.setPrefixDepth(prefixDepth);
+    //a fresh worker can start on a packet offloaded by another worker
+    if(upperBound && PrefixCodec::isPrefixPacket(upperBound, prefixDepth)) {
+      std::vector<std::vector<unsigned char> > offloaded;
+      if(!PrefixCodec::decode(upperBound, prefixDepth, offloaded))
+        klee_error("malformed prefix packet of size %u", prefixDepth);
+      for(auto it=offloaded.begin(); it!=offloaded.end(); ++it) {
+        initialState.addPrefix(reinterpret_cast<const char*>(it->data()),
+                               it->size());
+      }
+    } else {
+      initialState.addPrefix(upperBound, prefixDepth);
+    }
+    if(ConcolicReplay && initialState.getPrefixesSize() == 1) {
+      initialState.adoptReplaySeed(seeds);
+    }
+  }
   numOffloadStates = 1;
 
   if (usingSeeds) {
@@ -3734,8 +6328,9 @@ void Executor::run(ExecutionState &initialState, bool branchLevelHalt, bool path
       KInstruction *ki = state.pc;
       stepInstruction(state);
 
+      double instStart = util::getMonotonicTime();
       executeInstruction(state, ki);
-      processTimers(&state, MaxInstructionTime * numSeeds);
+      processTimers(&state, MaxInstructionTime * numSeeds, instStart);
       updateStates(&state);
 
       if ((stats::instructions % 1000) == 0) {
@@ -3765,13 +6360,17 @@ void Executor::run(ExecutionState &initialState, bool branchLevelHalt, bool path
 
     // XXX total hack, just because I like non uniform better but want
     // seed results to be equally weighted.
-    for (std::set<ExecutionState*>::iterator
+    for (StateSet::iterator
            it = states.begin(), ie = states.end();
          it != ie; ++it) {
       (*it)->weight = 1.;
     }
 
-    if (OnlySeed) {
+    //the states left and the branches the seeds did not take are the
+    //frontier of a generational task
+    if (generationMode) {
+      haltFromMaster = true;
+    } else if (OnlySeed) {
       doDumpStates();
       return;
     }
@@ -3781,16 +6380,49 @@ void Executor::run(ExecutionState &initialState, bool branchLevelHalt, bool path
 
   std::vector<ExecutionState *> newStates(states.begin(), states.end());
   searcher->update(0, newStates, std::vector<ExecutionState *>());
+
+  if (startFromShippedStates) {
+    if (!addShippedStates(&startStatesPacket[0], startStatesPacket.size()))
+      klee_warning("could not rebuild the shipped states, nothing to explore");
+    startStatesPacket.clear();
+  }
   
   branchLevel2Halt = explorationDepth;
   haltExecution = false;
+  if ((coreId != 0) && enableLB && interpreterOpts.offloadProgressThread)
+    startProgressThread();
+  //a KILL of the master cuts a long query short
+  if (coreId != 0) {
+    interruptedWorker = this;
+    setSolverInterruptCheck(checkWorkerKill);
+  }
   while (!haltFromMaster) {
     int prev_statedepth = 0;
     int prev_recStatedepth = 0;
     while (!states.empty() && !haltExecution) {
       //std::cout << "States Size: "<< states.size() << std::endl;
+      //wait for a parked state if there is nothing else to run
+      if (!asyncQueries.empty() && checkAsyncQueries(searcher->empty())) {
+        updateStates(0);
+      }
+      //the other sides of the states waiting at joins went elsewhere
+      if (searcher->empty() &&
+          (!statesAtJoin.empty() || !resumedStates.empty())) {
+        while (!statesAtJoin.empty())
+          releaseMergeJoin(statesAtJoin.begin()->first);
+        updateStates(0);
+      }
       assert(!searcher->empty());
       ExecutionState &state = searcher->selectState();
+      //the progress thread may have given the state away
+      if(!holdOffloadState(&state)) {
+        continue;
+      }
+      if(state.mergeId && mergeAtJoin(state)) {
+        updateStates(0);
+        continue;
+      }
+      state.lastScheduled = stats::instructions;
       if(false) mylogFile<<"Selected State Addr: "<<&state<<" NormalState: "
                                   <<state.isNormalState()<<" Recovery State: "
                                   <<state.isRecoveryState()<<" CoreId: "
@@ -3808,13 +6440,8 @@ void Executor::run(ExecutionState &initialState, bool branchLevelHalt, bool path
       //just do states equal to the numner of workers,
       //phase1depth in this case is the number of workers
       if(enableBranchHalt) {
-        if(coreId == 0) {
-          cntNumStates2Offload = 0;
-          for(auto it = states.begin(); it != states.end(); ++it) {
-            if(!(*it)->isSuspended()) {
-              cntNumStates2Offload++;
-            }
-          }
+        if((coreId == 0) || splitMode) {
+          cntNumStates2Offload = getNumActiveStates();
           if(cntNumStates2Offload >= branchLevel2Halt) {
             haltExecution = true;
             haltFromMaster = true;
@@ -3838,37 +6465,133 @@ void Executor::run(ExecutionState &initialState, bool branchLevelHalt, bool path
               //find the state that we came in with in the states vector
               auto ii = states.find(&state);
               assert(ii != states.end()); //can not be case as the state has to exist
-              states.erase(ii); //remove the state from states vector
+              eraseState(ii); //remove the state from states vector
               //nonRecoveryStates.erase(ii);
               continue;
             }
           }
         }
       }
-      KInstruction *ki = state.pc;
+      //the prefix is used up, make sure the replay did not diverge
+      if(state.replayPending && !state.shallIRange()) {
+        state.replayPending = false;
+        if(EventTrace::getProcessTrace().isEnabled()) {
+          EventTrace::getProcessTrace().record(EventTrace::ReplayDone,
+                                               EventTrace::now(), 0,
+                                               state.depth);
+        }
+        if(CheckPrefixReplay && !isReplayedPathFeasible(state)) {
+          terminateStateEarly(state, "Infeasible path after prefix replay.");
+          updateStates(&state);
+          continue;
+        }
+        //the state roots a prefix subtree of its own, readded to the
+        //searcher so that it lands in the subtree
+        if(userSearcherRequiresSubtrees()) {
+          std::vector<ExecutionState *> moved(1, &state);
+          std::vector<ExecutionState *> none;
+          searcher->update(nullptr, none, moved);
+          state.subtree = ++lastSubtree;
+          searcher->update(nullptr, moved, none);
+        }
+      }
+      //below its --donate-depth the state is kept for donation
+      if(DonateDepth && (coreId != 0) && !enableBranchHalt &&
+         (enableLB || enableStealing) && state.isNormalState() &&
+         !state.isRecoveryState() && !state.shallIRange()) {
+        if(!state.donateDepth) {
+          state.donateDepth = state.depth + DonateDepth;
+        } else if(state.depth >= state.donateDepth) {
+          std::vector<ExecutionState *> parked(1, &state);
+          searcher->update(nullptr, std::vector<ExecutionState *>(), parked);
+          eraseState(states.find(&state));
+          donatedStates.push_back(&state);
+          continue;
+        }
+      }
+      //the subtree below a --claim-prefix-depth-th branch is explored by
+      //the first worker to claim its prefix
+      if(ClaimPrefixDepth && (coreId != 0) && state.isNormalState() &&
+         !state.isRecoveryState() && !state.shallIRange()) {
+        unsigned length = state.branchHist.size() / ClaimPrefixDepth *
+                          ClaimPrefixDepth;
+        if(!state.claimDepth) {
+          state.claimDepth = length + ClaimPrefixDepth;
+        } else if(length >= state.claimDepth) {
+          state.claimDepth = length + ClaimPrefixDepth;
+          if(!claimPrefix(state, length) && RefuseClaimedPrefixes) {
+            terminateState(state);
+            updateStates(&state);
+            continue;
+          }
+        }
+      }
+      //a state over its --loop-budget waits until nothing else is left
+      if(state.overLoopBudget && state.isNormalState() &&
+         !state.isRecoveryState() && !state.shallIRange()) {
+        ++stats::loopBudgetParks;
+        std::vector<ExecutionState *> parked(1, &state);
+        searcher->update(nullptr, std::vector<ExecutionState *>(), parked);
+        eraseState(states.find(&state));
+        donatedStates.push_back(&state);
+        continue;
+      }
       //printStatePath(state, std::cout, "Selected State Path: ");
-      stepInstruction(state);
-      executeInstruction(state, ki);
-      processTimers(&state, MaxInstructionTime);
-      checkMemoryUsage();
+      //keep stepping the state until the searcher and the checks above
+      //have to see it again
+      unsigned depth = state.depth, actDepth = state.actDepth;
+      //the quantum ends with the replay, so it runs in one phase
+      Statistic &phaseTime = state.isRecoveryState() ? stats::recoveryTime :
+          (state.shallIRange() ? stats::replayTime : stats::explorationTime);
+      WallTimer phaseTimer;
+      double quantumStart = util::getMonotonicTime();
+      for(unsigned steps = 0; ; ) {
+        KInstruction *ki = state.pc;
+        stepInstruction(state);
+        executeInstruction(state, ki);
+        //a block is entered by a branch, after its phis
+        if (ConcreteBlockThreshold && (ki->opcode == Instruction::Br ||
+                                       ki->opcode == Instruction::Switch ||
+                                       ki->opcode == Instruction::PHI) &&
+            state.pc->opcode != Instruction::PHI &&
+            addedStates.empty() && removedStates.empty())
+          steps += executeConcreteBlock(state);
+        checkMemoryUsage();
+        if(++steps >= StepQuantum || haltExecution || !addedStates.empty() ||
+           !removedStates.empty() || !suspendedStates.empty() ||
+           !resumedStates.empty() || !rangingSuspendedStates.empty() ||
+           state.isSuspended() || state.depth != depth ||
+           state.actDepth != actDepth || state.isAtMergeJoin() ||
+           (state.replayPending && !state.shallIRange())) {
+          break;
+        }
+      }
+      processTimers(&state, MaxInstructionTime, quantumStart);
+      phaseTime += phaseTimer.check();
       updateStates(&state);
 
 			//Look at the states size, and see if anything changes regards to 
 			//offload situation of this worker
-			if((coreId!=0) && enableLB && (prefixDepth!=0)) {
+			//thieves are served without telling the master
+			if((coreId!=0) && (enableLB || enableStealing) &&
+			   (prefixDepth!=0 || !pathRange.isAll())) {
   			char dummy;
-        numOffloadStates = searcher->getSize();
-  			if(ready2Offload && (numOffloadStates<OFFLOAD_NOT_READY_THRESH)) {
+        numOffloadStates = searcher->getSize() + donatedStates.size();
+        if(OffloadDependentStates) {
+          numOffloadStates += numSuspendedStates;
+        }
+        bool canOffload = isReady2Offload(numOffloadStates);
+  			if(ready2Offload && !canOffload) {
     			//can not offload now
-    			MPI_Send(&dummy, 1, MPI_CHAR, 0, NOT_READY_TO_OFFLOAD, MPI_COMM_WORLD);
+    			if(enableLB && !HeartbeatInterval) MPI_Send(&dummy, 1, MPI_CHAR, 0, NOT_READY_TO_OFFLOAD, runComm);
     			ready2Offload=false;
     			if(ENABLE_LOGGING) {
       			mylogFile<<"NOT READY2OFF\n";
       			mylogFile.flush();
     			}
-  			} else if(!ready2Offload && (numOffloadStates>=OFFLOAD_READY_THRESH)) {
+  			} else if(!ready2Offload && canOffload) {
     			//can offload now
-    			MPI_Send(&dummy, 1, MPI_CHAR, 0, READY_TO_OFFLOAD, MPI_COMM_WORLD);
+    			if(enableLB && !HeartbeatInterval) MPI_Send(&dummy, 1, MPI_CHAR, 0, READY_TO_OFFLOAD, runComm);
     			ready2Offload=true;
     			if(ENABLE_LOGGING) {
      				mylogFile<<"READY2OFF\n";
@@ -3876,31 +6599,102 @@ void Executor::run(ExecutionState &initialState, bool branchLevelHalt, bool path
     			}
   			}
 			}
+			//ask for the next task before running dry
+			if((coreId!=0) && enableLB && PrefetchBelow && !workRequested &&
+			   (queuedTaskTag == -1) && (getNumActiveStates() < PrefetchBelow)) {
+				char dummy;
+				MPI_Send(&dummy, 1, MPI_CHAR, 0, WORK_REQUEST, runComm);
+				workRequested = true;
+			}
+			//replay the queued prefix task meanwhile
+			if((coreId!=0) && BackgroundReplay &&
+			   (queuedTaskTag == START_PREFIX_TASK)) {
+				if(replayPid == 0) startBackgroundReplay();
+				else if(replayPid > 0) readBackgroundReplay(false);
+			}
+			//also the liveness signal for the master's --worker-timeout
+			if((coreId!=0) && HeartbeatInterval) sendHeartbeat();
+			if((coreId!=0) && SharedSolverCacheOpt) exchangeSolverCache();
+			else if(PersistentSolverCache != "") persistSolverCache(false);
+			if((coreId!=0) && SharedCoverage && statsTracker) exchangeCoverage();
+			if((coreId!=0) && stateFingerprints && SharedFingerprintInterval) exchangeFingerprints();
+			if((coreId!=0) && ClusterStatsInterval) sendClusterStats();
+    }
+
+    //explore the states nobody took
+    if(restoreDonatedStates() && !haltExecution) {
+      continue;
+    }
+
+    //resume the states spilled over the memory cap before finishing
+    if(!haltExecution && reloadSpilledStates()) {
+      continue;
     }
 
-    if((coreId != 0) && (!haltFromMaster)) {
+    //a split subtree that runs dry hands back what is left
+    if(splitMode && !haltFromMaster) {
+      break;
+    }
+
+    if((coreId != 0) && (!haltFromMaster) && enableStealing) {
+      TimerStatIncrementer idleTimer(stats::idleTime);
+      stealWork();
+    } else if((coreId != 0) && (!haltFromMaster)) {
+      WallTimer idleTimer;
       //tell the master the you have finished working on your prefix
       char result;
       if(ENABLE_LOGGING) {
         mylogFile << "Finish:  "<<coreId<<"\n";
         mylogFile.flush();
       }
-      MPI_Send(&result, 1, MPI_CHAR, 0, FINISH, MPI_COMM_WORLD);
-      //receive some message from the master
+      MPI_Send(&result, 1, MPI_CHAR, 0, FINISH, runComm);
+      workRequested = false;
+      //receive some message from the master, unless a task is queued
       MPI_Status status;
-      MPI_Probe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
-      int count;
-      MPI_Get_count(&status, MPI_CHAR, &count);
+      int count = 0;
+      if(queuedTaskTag != -1) {
+        status.MPI_TAG = queuedTaskTag;
+        count = queuedTask.size();
+      } else {
+        int flag = 0;
+        MPI_Iprobe(0, MPI_ANY_TAG, runComm, &flag, &status);
+        while(!flag && pregenerateSlice()) {
+          MPI_Iprobe(0, MPI_ANY_TAG, runComm, &flag, &status);
+        }
+        MPI_Probe(0, MPI_ANY_TAG, runComm, &status);
+        MPI_Get_count(&status, MPI_CHAR, &count);
+        //the master picks the policy of the next task (--search-portfolio)
+        while(status.MPI_TAG == SEARCH_MODE) {
+          std::vector<char> policy(count+1);
+          MPI_Recv(&policy[0], count, MPI_CHAR, 0, SEARCH_MODE, runComm, &status);
+          switchSearchMode(std::string(&policy[0], count));
+          MPI_Probe(0, MPI_ANY_TAG, runComm, &status);
+          MPI_Get_count(&status, MPI_CHAR, &count);
+        }
+      }
+      stats::idleTime += idleTimer.check();
+      //the wait is no function's time
+      if(instructionSampler) instructionSampler->skipTime();
       if(status.MPI_TAG == KILL) {
         char dummy2;
-        MPI_Recv(&dummy2, 1, MPI_CHAR, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        MPI_Recv(&dummy2, 1, MPI_CHAR, 0, MPI_ANY_TAG, runComm, &status);
         //std::cout << "Killing Process: "<<coreId<<"\n";
         haltFromMaster = true;
         haltExecution = true;
+      } else if(status.MPI_TAG == LEAVE) {
+        char dummy2;
+        MPI_Recv(&dummy2, 1, MPI_CHAR, 0, LEAVE, runComm, &status);
+        leaveRun();
       } else if (status.MPI_TAG == START_PREFIX_TASK) {
         char* recv_prefix;
         recv_prefix = (char*)malloc(count*sizeof(char));
-        MPI_Recv(recv_prefix, count, MPI_CHAR, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        if(queuedTaskTag != -1) {
+          std::copy(queuedTask.begin(), queuedTask.end(), recv_prefix);
+          queuedTask.clear();
+          queuedTaskTag = -1;
+        } else {
+          MPI_Recv(recv_prefix, count, MPI_CHAR, 0, MPI_ANY_TAG, runComm, &status);
+        }
         std::cout << "Process: "<<coreId<<" Prefix Task: Length:"<<count<<"\n";
         if(ENABLE_LOGGING) {
           mylogFile << "Process: "<<coreId<<" Prefix Task: Length:"<<count<<"\n";
@@ -3915,133 +6709,50 @@ void Executor::run(ExecutionState &initialState, bool branchLevelHalt, bool path
 
         setLowerBound(recv_prefix);
         setUpperBound(recv_prefix);
-        enablePrefixChecking();
-				setTestPrefixDepth(count);
-
-        //first, conunt the hyphens
-        std::vector<int> dashLoc;
-        for(int x=0; x<count; x++) {
-          if(recv_prefix[x] == '-') {
-            if(ENABLE_OFFLOAD_LOGGING) {
-              mylogFile << "Found dash at : "<<x<<"\n";
-              mylogFile.flush();
-            }
-            dashLoc.push_back(x);
-          }
+        //an offloaded subtree lies in the share of its donor
+        pathRange = PathInterval();
+        if(!adoptBackgroundReplay(recv_prefix, count)) {
+          resumeFromPrefixPacket(recv_prefix, count);
         }
-        
-        std::vector<unsigned char> recvP;
-        std::vector<ExecutionState*> rangingResumedStates;
-        std::vector<std::string> resumePaths;
-
-        for(int pref=0; pref<dashLoc.size(); pref++) {
-          for(int loc=0; loc<dashLoc[0]; loc++) {
-            recvP.push_back(recv_prefix[loc]);
-          }
-          if(ENABLE_OFFLOAD_LOGGING) {
-            mylogFile << "Initial Size: "<<recvP.size()<<"\n";
-            mylogFile << "Doing offload at loc: "<<dashLoc[pref]<<"\n";
-          }
-          for(int pl=dashLoc[pref]+1; pl<count; pl++) {
-            if(recv_prefix[pl] == '-') {
-              if(ENABLE_OFFLOAD_LOGGING) {
-                mylogFile<<"Found terminating - at: "<<pl<<"\n";
-                mylogFile.flush();
-              }
-              break;
-            }
-            recvP.push_back(recv_prefix[pl]);
-          }
-
-          if(ENABLE_OFFLOAD_LOGGING) {
-            mylogFile<<"PPrefix: "<<recvP.size()<<"\n";
-            for(int c=0; c<recvP.size(); c++) {
-              mylogFile<<recvP[c];  
-            }
-            mylogFile.flush();
-            mylogFile<<"\n";
-          }
-
-          //coverting it to 101010... format
-          std::vector<unsigned char> resP;
-          for(unsigned int x=0;x<recvP.size();x++) {
-  					//std::cout<<recv_prefix[x];
-  					unsigned char dd = recvP[x];
-  					if(dd == '2') {
-    					resP.push_back('0');
-  					} else if(dd == '3') {
-    					resP.push_back('1');
-  					} else if(dd == '-') {
-    					continue;
-  					} else {
-              resP.push_back(dd);
-            }
-					}
-
-          std::vector<unsigned char> prefixToResume;
-          prefixTree->getPathToResume(resP, prefixToResume, mylogFile);
-          if(ENABLE_OFFLOAD_LOGGING) {
-            mylogFile << "Path to Resume: ";
-            for(unsigned int x=0;x<prefixToResume.size();x++) {
-              mylogFile<<prefixToResume[x];
-            }
-            mylogFile<<"\n";
-          }
-
-          std::string resumePath(prefixToResume.begin(), prefixToResume.end());
-          assert(prefixSuspendedStatesMap.find(resumePath) != prefixSuspendedStatesMap.end());
-          ExecutionState* resumedState = prefixSuspendedStatesMap[resumePath];
-          if(ENABLE_OFFLOAD_LOGGING) {
-            mylogFile << "Resume states prefix lists size: "<<resumedState->getPrefixesSize()<<"\n";
-            mylogFile.flush();
-          }
-
-          char* stPref = (char*)malloc(recvP.size()*sizeof(char));
-          for(int x=0; x<recvP.size(); x++) {
-            stPref[x] = recvP[x];
-          }
-          resumedState->addPrefix(stPref, recvP.size());
-          if(ENABLE_OFFLOAD_LOGGING) {
-            mylogFile<<"Adding prefix: "<<recvP.size()<<"\n";
-            mylogFile.flush();
-          }
-          
-          auto iu = std::find(rangingResumedStates.begin(), rangingResumedStates.end(),
-              resumedState);
-          if(iu == rangingResumedStates.end()) {
-            rangingResumedStates.push_back(resumedState);
-            resumePaths.push_back(resumePath);
-          }
-
-          recvP.clear();
+      } else if (status.MPI_TAG == START_RANGE_TASK) {
+        std::vector<char> packet(count);
+        if(queuedTaskTag != -1) {
+          packet.swap(queuedTask);
+          queuedTaskTag = -1;
+        } else {
+          MPI_Recv(&packet[0], count, MPI_CHAR, 0, START_RANGE_TASK, runComm, &status);
         }
-
-        if(ENABLE_OFFLOAD_LOGGING) {
-          mylogFile << "Number of states ot resume: "<<rangingResumedStates.size()<<"\n";
-          mylogFile.flush();
-          for(int jj=0; jj<rangingResumedStates.size(); ++jj) {
-            mylogFile<<"resume state prefix list: "<<rangingResumedStates[jj]->getPrefixesSize()<<" State depth: "
-              <<rangingResumedStates[jj]->depth<<"\n";
-            mylogFile.flush();
-          }
+        std::cout << "Process: "<<coreId<<" Range Task: "<<std::string(packet.begin(), packet.end())<<"\n";
+        startPathRange(&packet[0], count);
+      } else if (status.MPI_TAG == START_STATE_TASK) {
+        std::vector<char> packet(count);
+        if(queuedTaskTag != -1) {
+          packet.swap(queuedTask);
+          queuedTaskTag = -1;
+        } else {
+          MPI_Recv(&packet[0], count, MPI_CHAR, 0, START_STATE_TASK, runComm, &status);
         }
-        
-        states.insert(rangingResumedStates.begin(), rangingResumedStates.end());
-        std::vector<ExecutionState *> resumedStates(states.begin(), states.end());
-        searcher->update(0, resumedStates, std::vector<ExecutionState *>());
-        for(auto hh = resumePaths.begin(); hh != resumePaths.end(); ++hh) {
-          prefixSuspendedStatesMap.erase(*hh);
+        std::cout << "Process: "<<coreId<<" State Task: Size:"<<count<<"\n";
+        if(ENABLE_LOGGING) {
+          mylogFile << "Process: "<<coreId<<" State Task: Size:"<<count<<"\n";
         }
-
-        rangingResumedStates.clear();
-        resumePaths.clear();
+        pathRange = PathInterval();
+        addShippedStates(&packet[0], count);
       }
     }
   }
 	
+	stopProgressThread();
+	if(coreId != 0) {
+		setSolverInterruptCheck(0);
+		interruptedWorker = 0;
+	}
+
 	//here empty out all the states into the worklist
-	if(enableBranchHalt && (coreId==0)) {
-    workList = (char **)malloc(cntNumStates2Offload*sizeof(char*));
+	if(enableBranchHalt && ((coreId==0) || splitMode)) {
+    //the count is stale if the last states terminated
+    cntNumStates2Offload = getNumActiveStates();
+    workList = (char **)malloc((cntNumStates2Offload+seedFlips.size())*sizeof(char*));
     unsigned int stateNum=0;
     for(auto it=states.begin(); it!=states.end(); ++it) {
       if(!(*it)->isSuspended()) {
@@ -4049,23 +6760,102 @@ void Executor::run(ExecutionState &initialState, bool branchLevelHalt, bool path
         stateNum++;
       }
     }
+    for(unsigned i=0; i<seedFlips.size(); ++i) {
+      const std::vector<char> &flip = seedFlips[i];
+      char* newPath = (char*)malloc(flip.size()*sizeof(char));
+      std::copy(flip.begin(), flip.end(), newPath);
+      workList[stateNum++] = newPath;
+      workListPathSize.push_back(flip.size());
+      workListEstimates.push_back(1);
+      workListDistances.push_back(0);
+    }
+    seedFlips.clear();
 	}
 	
+  cancelAsyncQueries();
+  cancelBackgroundReplay();
   delete searcher;
   searcher = 0;
+
+  if (heartbeatPending) {
+    MPI_Wait(&heartbeatReq, MPI_STATUS_IGNORE);
+    heartbeatPending = false;
+  }
+  if (clusterStatsPending) {
+    MPI_Wait(&clusterStatsReq, MPI_STATUS_IGNORE);
+    clusterStatsPending = false;
+  }
+  //the peers may have stopped receiving, do not wait for them
+  for (unsigned i = 0; i < solverCacheReqs.size(); i++) {
+    MPI_Request_free(&solverCacheReqs[i]);
+  }
+  solverCacheReqs.clear();
+  for (unsigned i = 0; i < coverageReqs.size(); i++) {
+    MPI_Request_free(&coverageReqs[i]);
+  }
+  coverageReqs.clear();
+  for (unsigned i = 0; i < fingerprintReqs.size(); i++) {
+    MPI_Request_free(&fingerprintReqs[i]);
+  }
+  fingerprintReqs.clear();
+
+  //before KILL_COMP, the master aborts once all workers sent it
+  if (SliceProfile != "") {
+    saveSliceProfile();
+  }
+  if (PersistentSolverCache != "") {
+    persistSolverCache(true);
+  }
+
+  if (shippedStateTemplate) {
+    delete shippedStateTemplate;
+    shippedStateTemplate = 0;
+  }
+  if (startupSnapshot) {
+    delete startupSnapshot;
+    startupSnapshot = 0;
+  }
+  //the initial state was never scheduled
+  if (skipInitialState) {
+    processTree->remove(initialState.ptreeNode);
+    processTree->root = 0;
+    delete &initialState;
+  }
   
   //doDumpStates();
   
 }
 
+void Executor::setBrHistFile(std::string inBrHistFile) {
+  brhistFileName = inBrHistFile;
+#ifdef HAVE_ZLIB_H
+  if (CompressBranchHistory) {
+    std::string ErrorInfo;
+    brhistWriter = new BranchHistoryWriter(brhistFileName + ".gz", ErrorInfo);
+    if (ErrorInfo != "") {
+      klee_error("Could not open file %s.gz : %s", brhistFileName.c_str(),
+                 ErrorInfo.c_str());
+    }
+    return;
+  }
+#endif
+  brhistFile.open(brhistFileName);
+}
+
 bool Executor::addState2WorkList(ExecutionState &state, int count) {
 
-  char* newPath = (char*)malloc(state.branchHist.size()*sizeof(char));
-  for (int I = 0; I < state.branchHist.size(); ++I) {
-    newPath[I] = state.branchHist[I];
+  std::vector<char> hist = state.branchHist.toVector();
+  char* newPath = (char*)malloc(hist.size()*sizeof(char));
+  for (int I = 0; I < hist.size(); ++I) {
+    newPath[I] = hist[I];
   }
   workList[count] = newPath;
   workListPathSize.push_back(state.branchHist.size());
+  workListEstimates.push_back(
+      state.ptreeNode ? processTree->forkRates.estimate(state.ptreeNode->depth)
+                      : 1);
+  workListDistances.push_back(
+      targetDistance ? targetDistance->getDistance(state) : 0);
   return true;
 }
 
@@ -4127,6 +6917,9 @@ void Executor::terminateState(ExecutionState &state) {
 
   if (!state.isRecoveryState()) {
     interpreterHandler->incPathsExplored();
+    completedPaths++;
+    if (state.ptreeNode)
+      processTree->forkRates.recordLeaf(state.ptreeNode->depth);
   }
 
   auto fit = nonRecoveryStates.find(&state);
@@ -4143,8 +6936,11 @@ void Executor::terminateState(ExecutionState &state) {
     // never reached searcher, just delete immediately
     std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
       seedMap.find(&state);
-    if (it3 != seedMap.end())
+    if (it3 != seedMap.end()) {
+      if (generationMode)
+        seedPaths.push_back(state.branchHist.toVector());
       seedMap.erase(it3);
+    }
     addedStates.erase(it);
     processTree->remove(state.ptreeNode);
     delete &state;
@@ -4157,8 +6953,8 @@ void Executor::terminateState(ExecutionState &state) {
 
 void Executor::terminateStateEarly(ExecutionState &state, 
                                    const Twine &message) {
-  if (!OnlyOutputStatesCoveringNew || state.coveredNew ||
-      (AlwaysOutputSeeds && seedMap.count(&state)))
+  if ((!OnlyOutputStatesCoveringNew || state.coveredNew ||
+       (AlwaysOutputSeeds && seedMap.count(&state))) && ownsPath(state))
     interpreterHandler->processTestCase(state, (message + "\n").str().c_str(),
                                         "early");
   if (state.isRecoveryState()) {
@@ -4169,8 +6965,8 @@ void Executor::terminateStateEarly(ExecutionState &state,
 }
 
 void Executor::terminateStateOnExit(ExecutionState &state) {
-  if (!OnlyOutputStatesCoveringNew || state.coveredNew || 
-      (AlwaysOutputSeeds && seedMap.count(&state)))
+  if ((!OnlyOutputStatesCoveringNew || state.coveredNew ||
+       (AlwaysOutputSeeds && seedMap.count(&state))) && ownsPath(state))
     interpreterHandler->processTestCase(state, 0, 0);
   
 
@@ -4181,9 +6977,14 @@ void Executor::terminateStateOnExit(ExecutionState &state) {
     //if(ENABLE_LOGGING) //printStatePath(state, brhistFile, "");
     //if(ENABLE_LOGGING) //brhistFile.flush();
     
-    if(ENABLE_LOGGING) {
-      for(int x=0; x<(state.branchHist).size(); x++) {
-        brhistFile<<state.branchHist[x];
+    if(ENABLE_LOGGING && brhistWriter) {
+#ifdef HAVE_ZLIB_H
+      brhistWriter->write(state.branchHist.toVector());
+#endif
+    } else if(ENABLE_LOGGING) {
+      std::vector<char> hist = state.branchHist.toVector();
+      for(int x=0; x<hist.size(); x++) {
+        brhistFile<<hist[x];
       }
       brhistFile<<"\n";
       brhistFile.flush();
@@ -4263,8 +7064,8 @@ void Executor::terminateStateOnError(ExecutionState &state,
     if (shouldExitOn(termReason)) {
       errorCount++;
     }
-    if (ii.file != "") {
-      klee_message("ERROR: %s:%d: %s", ii.file.c_str(), ii.line, message.c_str());
+    if (*ii.file != "") {
+      klee_message("ERROR: %s:%d: %s", ii.file->c_str(), ii.line, message.c_str());
     } else {
       klee_message("ERROR: (location information missing) %s", message.c_str());
     }
@@ -4274,8 +7075,8 @@ void Executor::terminateStateOnError(ExecutionState &state,
     std::string MsgString;
     llvm::raw_string_ostream msg(MsgString);
     msg << "Error: " << message << "\n";
-    if (ii.file != "") {
-      msg << "File: " << ii.file << "\n";
+    if (*ii.file != "") {
+      msg << "File: " << *ii.file << "\n";
       msg << "Line: " << ii.line << "\n";
       msg << "assembly.ll line: " << ii.assemblyLine << "\n";
     }
@@ -4293,7 +7094,8 @@ void Executor::terminateStateOnError(ExecutionState &state,
       suffix = suffix_buf.c_str();
     }
 
-    interpreterHandler->processTestCase(state, msg.str().c_str(), suffix);
+    if (ownsPath(state))
+      interpreterHandler->processTestCase(state, msg.str().c_str(), suffix);
   }
 
   if (state.isRecoveryState()) {
@@ -4309,10 +7111,10 @@ void Executor::terminateStateOnError(ExecutionState &state,
       if (maxCount == 0 || maxCount == errorCount) {
         haltExecution = true;
       }
-    } else if (ii.file != "") {
+    } else if (*ii.file != "") {
       InterpreterOptions::ErrorLocations &errorLocations = interpreterOpts.errorLocations;
       for (std::vector<ErrorLocationOption>::size_type i = 0; i < errorLocations.size(); ++i) {
-        std::string basename = ii.file.substr(ii.file.find_last_of("/\\") + 1);
+        std::string basename = ii.file->substr(ii.file->find_last_of("/\\") + 1);
         InterpreterOptions::ErrorLocations::iterator entry = errorLocations.find(basename);
         if (entry != errorLocations.end()) {
           entry->second.erase(std::remove(entry->second.begin(), entry->second.end(), ii.line), entry->second.end());
@@ -4329,27 +7131,235 @@ void Executor::terminateStateOnError(ExecutionState &state,
           haltFromMaster = true;
         } else {
           char dummySend;
-          MPI_Send(&dummySend, 1, MPI_CHAR, 0, BUG_FOUND, MPI_COMM_WORLD);
+          MPI_Send(&dummySend, 1, MPI_CHAR, 0, BUG_FOUND, runComm);
         }
       }
     }
   }
-}
+}
+
+// XXX shoot me
+static const char *okExternalsList[] = { "printf", 
+                                         "fprintf", 
+                                         "puts",
+                                         "getpid" };
+static std::set<std::string> okExternals(okExternalsList,
+                                         okExternalsList + 
+                                         (sizeof(okExternalsList)/sizeof(okExternalsList[0])));
+
+void Executor::prepareExternalCalls() {
+  /* compile the stubs of the external calls once, at load */
+  for (std::vector<KFunction*>::iterator it = kmodule->functions.begin(),
+         ie = kmodule->functions.end(); it != ie; ++it) {
+    KFunction *kf = *it;
+    for (unsigned i = 0; i < kf->numInstructions; i++) {
+      Instruction *inst = kf->instructions[i]->inst;
+      if (!isa<CallInst>(inst) && !isa<InvokeInst>(inst))
+        continue;
+      CallSite cs(inst);
+      Function *f =
+        dyn_cast<Function>(cs.getCalledValue()->stripPointerCasts());
+      if (!f || !f->isDeclaration() || f->isIntrinsic() ||
+          specialFunctionHandler->isHandled(f) ||
+          (NoExternals && !okExternals.count(f->getName())))
+        continue;
+      externalDispatcher->prepareCall(f, inst);
+    }
+  }
+}
+
+unsigned Executor::executeConcreteBlock(ExecutionState &state) {
+  // the exit of a recovery is checked by the interpreter on every
+  // instruction
+  if (state.isRecoveryState() || state.isSuspended() || state.isAtMergeJoin())
+    return 0;
+
+  ConcreteBlockSite &site = concreteBlocks[state.pc];
+  if (!site.block) {
+    if (++site.count != ConcreteBlockThreshold)
+      return 0;
+    site.block = new ConcreteBlock(state.pc);
+  }
+
+  const ConcreteBlock &block = *site.block;
+  if (!block.size())
+    return 0;
+  Cell *locals = state.stack.back().getWritableLocals();
+  const Cell *constants = &kmodule->constantTable[0];
+  unsigned n = 0;
+  while (n < block.size() && !haltExecution &&
+         block.execute(n, locals, constants)) {
+    stepInstruction(state);
+    n++;
+  }
+  stats::concreteBlockInstructions += n;
+  return n;
+}
+
+static bool isNativeType(LLVM_TYPE_Q Type *t) {
+  return t->isVoidTy() || t->isPointerTy() ||
+    (t->isIntegerTy() && t->getIntegerBitWidth() <= 64);
+}
+
+/// Whether a constant operand takes the address of code, which is the
+/// llvm::Function in the executor but not in native code.
+static bool referencesCode(const Value *v) {
+  if (isa<Function>(v) || isa<GlobalAlias>(v))
+    return true;
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(v))
+    for (unsigned i = 0; i < ce->getNumOperands(); i++)
+      if (referencesCode(ce->getOperand(i)))
+        return true;
+  return false;
+}
+
+bool Executor::isNativeCandidate(Function *f) {
+  std::map<const Function*, bool>::iterator it = nativeFunctions.find(f);
+  if (it != nativeFunctions.end())
+    return it->second;
+
+  bool candidate = !f->isVarArg() && isNativeType(f->getReturnType());
+  for (Function::arg_iterator ai = f->arg_begin(), ae = f->arg_end();
+       candidate && ai != ae; ++ai)
+    candidate = isNativeType(ai->getType());
+  if (candidate) {
+    std::set<Function*> visiting;
+    candidate = isNativeCandidate(f, visiting);
+  }
+  nativeFunctions[f] = candidate;
+  return candidate;
+}
+
+bool Executor::isNativeCandidate(Function *f, std::set<Function*> &visiting) {
+  if (f->isDeclaration() || f->isVarArg() ||
+      specialFunctionHandler->isHandled(f))
+    return false;
+  if (!visiting.insert(f).second)
+    return true;
+  std::map<const Function*, bool>::iterator known = nativeFunctions.find(f);
+  if (known != nativeFunctions.end() && !known->second)
+    return false;
+
+  KFunction *kf = kmodule->functionMap[f];
+  if (!kf)
+    return false;
+  for (unsigned i = 0; i < kf->numInstructions; i++) {
+    KInstruction *ki = kf->instructions[i];
+    Instruction *inst = ki->inst;
+    // the instructions whose effects the chopped execution must observe
+    if (ki->mayBlock || ki->mayOverride)
+      return false;
+    if (isa<VAArgInst>(inst) || isa<InvokeInst>(inst) ||
+        isa<LandingPadInst>(inst) || isa<ResumeInst>(inst))
+      return false;
+
+    if (CallInst *ci = dyn_cast<CallInst>(inst)) {
+      Function *callee = ci->getCalledFunction();
+      if (!callee)
+        return false;
+      switch (callee->getIntrinsicID()) {
+      case Intrinsic::not_intrinsic:
+        if (!isNativeCandidate(callee, visiting))
+          return false;
+        break;
+      case Intrinsic::memcpy:
+      case Intrinsic::memmove:
+      case Intrinsic::memset:
+      case Intrinsic::dbg_declare:
+      case Intrinsic::dbg_value:
+      case Intrinsic::lifetime_start:
+      case Intrinsic::lifetime_end:
+      case Intrinsic::bswap:
+      case Intrinsic::ctpop:
+      case Intrinsic::ctlz:
+      case Intrinsic::cttz:
+      case Intrinsic::sadd_with_overflow:
+      case Intrinsic::uadd_with_overflow:
+      case Intrinsic::ssub_with_overflow:
+      case Intrinsic::usub_with_overflow:
+      case Intrinsic::smul_with_overflow:
+      case Intrinsic::umul_with_overflow:
+        break;
+      default:
+        return false;
+      }
+      for (unsigned j = 0; j < ci->getNumArgOperands(); j++)
+        if (referencesCode(ci->getArgOperand(j)))
+          return false;
+      continue;
+    }
+
+    for (unsigned j = 0; j < inst->getNumOperands(); j++)
+      if (referencesCode(inst->getOperand(j)))
+        return false;
+  }
+  return true;
+}
+
+bool Executor::callNatively(ExecutionState &state, KInstruction *ki,
+                            Function *f, std::vector<ref<Expr> > &arguments) {
+  // the states whose reads and writes the chopping keeps track of, and the
+  // address space the progress thread reads
+  if (state.isRecoveryState() || !state.isNormalState() ||
+      state.isInDependentMode() || progressThread.joinable())
+    return false;
+  if (arguments.size() != f->arg_size() || !isNativeCandidate(f))
+    return false;
+
+  uint64_t *args = (uint64_t*) alloca(2*sizeof(*args) * (arguments.size() + 1));
+  memset(args, 0, 2 * sizeof(*args) * (arguments.size() + 1));
+  unsigned wordIndex = 2;
+  for (unsigned i = 0; i < arguments.size(); i++) {
+    ConstantExpr *ce = dyn_cast<ConstantExpr>(arguments[i]);
+    if (!ce)
+      return false;
+    ce->toMemory(&args[wordIndex]);
+    wordIndex += (ce->getWidth()+63)/64;
+  }
+
+  if (!externalDispatcher->prepareNativeCall(f, ki->inst)) {
+    nativeFunctions[f] = false;
+    return false;
+  }
 
-// XXX shoot me
-static const char *okExternalsList[] = { "printf", 
-                                         "fprintf", 
-                                         "puts",
-                                         "getpid" };
-static std::set<std::string> okExternals(okExternalsList,
-                                         okExternalsList + 
-                                         (sizeof(okExternalsList)/sizeof(okExternalsList[0])));
+  // native code touching a symbolic object faults on its pages, and the
+  // call is interpreted from the start; the copies out are left behind
+  state.addressSpace.copyOutConcretes();
+  std::vector<std::pair<uint64_t, uint64_t> > protectedPages;
+  bool success = state.addressSpace.protectSymbolics(protectedPages) &&
+    externalDispatcher->executeCall(f, ki->inst, args);
+  AddressSpace::unprotect(protectedPages);
+  if (!success) {
+    ++stats::nativeCallFallbacks;
+    if (++nativeFaults[f] >= 3)
+      nativeFunctions[f] = false;
+    return false;
+  }
+
+  if (!state.addressSpace.copyInConcretes()) {
+    terminateStateOnError(state, "native call modified read-only object",
+                          External);
+    return true;
+  }
+
+  LLVM_TYPE_Q Type *resultType = ki->inst->getType();
+  if (!resultType->isVoidTy())
+    bindLocal(ki, state,
+              ConstantExpr::fromMemory((void*) args,
+                                       getWidthForLLVMType(resultType)));
+  ++stats::nativeCalls;
+  return true;
+}
 
 void Executor::callExternalFunction(ExecutionState &state,
                                     KInstruction *target,
                                     Function *function,
                                     std::vector< ref<Expr> > &arguments) {
   //std::cout <<"External Function: " << function->getName().str() <<"\n";
+  // neither the handlers nor the externals report what they read
+  if (state.isRecoveryState())
+    state.getRecoveryInfo()->summarizable = false;
+
   // check if specialFunctionHandler wants it
   if (specialFunctionHandler->handle(state, function, target, arguments))
     return;
@@ -4693,18 +7703,27 @@ void Executor::executeMemoryOperation(ExecutionState &state,
       address = toConstant(state, address, "max-sym-array-size");
     }
     
-    ref<Expr> offset = mo->getOffsetExpr(address);
-
+    // a constant access is checked, read and written without expressions
+    ConstantExpr *constantAddress = dyn_cast<ConstantExpr>(address);
+    uint64_t constantOffset = 0;
+    ref<Expr> offset;
     bool inBounds;
-    solver->setTimeout(coreSolverTimeout);
-    bool success = solver->mustBeTrue(state, 
-                                      mo->getBoundsCheckOffset(offset, bytes),
-                                      inBounds);
-    solver->setTimeout(0);
-    if (!success) {
-      state.pc = state.prevPC;
-      terminateStateEarly(state, "Query timed out (bounds check).");
-      return;
+    if (constantAddress) {
+      constantOffset = constantAddress->getZExtValue() - mo->address;
+      inBounds = mo->isInBounds(constantOffset, bytes);
+      ++stats::constantAccesses;
+    } else {
+      offset = mo->getOffsetExpr(address);
+      solver->setTimeout(coreSolverTimeout);
+      bool success = solver->mustBeTrue(state,
+                                        mo->getBoundsCheckOffset(offset, bytes),
+                                        inBounds);
+      solver->setTimeout(0);
+      if (!success) {
+        state.pc = state.prevPC;
+        terminateStateEarly(state, "Query timed out (bounds check).");
+        return;
+      }
     }
 
     if (inBounds) {
@@ -4715,8 +7734,13 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                 ReadOnly);
         } else {
           ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-          wos->write(offset, value);
+          if (constantAddress)
+            wos->write(constantOffset, value);
+          else
+            wos->write(offset, value);
           if (state.isRecoveryState()) {
+            if (constantAddress)
+              offset = mo->getOffsetExpr(address);
             onRecoveryStateWrite(state, address, mo, offset, value);
           }
           if (state.isNormalState()) {
@@ -4724,10 +7748,14 @@ void Executor::executeMemoryOperation(ExecutionState &state,
           }
         }
       } else {
-        ref<Expr> result = os->read(offset, type);
+        ref<Expr> result = constantAddress ? os->read(constantOffset, type)
+                                           : os->read(offset, type);
         if (state.isNormalState()) {
           onNormalStateRead(state, address, type);
         }
+        if (state.isRecoveryState()) {
+          onRecoveryStateRead(state, address, mo, result);
+        }
         
         if (interpreterOpts.MakeConcreteSymbolic)
           result = replaceReadWithSymbolic(state, result);
@@ -4772,6 +7800,9 @@ void Executor::executeMemoryOperation(ExecutionState &state,
       } else {
         ref<Expr> result = os->read(mo->getOffsetExpr(address), type);
         bindLocal(target, *bound, result);
+        if (bound->isRecoveryState()) {
+          bound->getRecoveryInfo()->summarizable = false;
+        }
       }
     }
 
@@ -4794,13 +7825,17 @@ void Executor::executeMemoryOperation(ExecutionState &state,
 void Executor::executeMakeSymbolic(ExecutionState &state, 
                                    const MemoryObject *mo,
                                    const std::string &name) {
+  if (StartupSnapshot && shippedStateTemplate && !startupSnapshot &&
+      state.depth == 0 && !state.isRecoveryState() && !seedMap.count(&state))
+    takeStartupSnapshot(state);
+
   // Create a new object state for the memory object (instead of a copy).
   if (!replayKTest) {
     // Find a unique name for this array.  First try the original name,
     // or if that fails try adding a unique identifier.
     unsigned id = 0;
     std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
+    while (!state.arrayNames.write().insert(uniqueName).second) {
       uniqueName = name + "_" + llvm::utostr(++id);
     }
     const Array *array = arrayCache.CreateArray(uniqueName, mo->size);
@@ -4876,6 +7911,7 @@ char** Executor::runFunctionAsMain2(Function *f,
   if(explorationDepth > 0) {
     runFunctionAsMain(f, argc, argv, envp, true);
     states.clear();
+    numSuspendedStates = 0;
     workListPathSize_main = workListPathSize;
     //workList_main = workList;
     return workList;
@@ -4886,11 +7922,48 @@ char** Executor::runFunctionAsMain2(Function *f,
 
   if (statsTracker)
     statsTracker->done();
+  if (queryProfiler)
+    writeQueryProfile();
+  if (instructionSampler)
+    writeInstructionSamples();
 	enablePathPrefixFilter=false;
   return NULL;
 }
 
 
+void Executor::writeQueryProfile() {
+  llvm::raw_ostream *os = interpreterHandler->openOutputFile("run.qprof");
+  if (os) {
+    queryProfiler->writeSites(*os);
+    delete os;
+  }
+  os = interpreterHandler->openOutputFile("run.qprof.functions");
+  if (os) {
+    queryProfiler->writeFunctions(*os);
+    delete os;
+  }
+}
+
+void Executor::writeInstructionSamples() {
+  llvm::raw_ostream *os = interpreterHandler->openOutputFile("run.sprof.opcodes");
+  if (os) {
+    instructionSampler->writeOpcodes(*os);
+    delete os;
+  }
+  os = interpreterHandler->openOutputFile("run.sprof.functions");
+  if (os) {
+    instructionSampler->writeFunctions(*os);
+    delete os;
+  }
+  if (!SampleStacks)
+    return;
+  os = interpreterHandler->openOutputFile("run.sprof.stacks");
+  if (os) {
+    instructionSampler->writeStacks(*os);
+    delete os;
+  }
+}
+
 void Executor::runFunctionAsMain(Function *f,
 				int argc,
 				char **argv,
@@ -4957,6 +8030,7 @@ void Executor::runFunctionAsMain(Function *f,
     }
   }
 
+  kmodule->infos->loadFunction(f);
   ExecutionState *state = new ExecutionState(kmodule->functionMap[f]);
   
   /*if (pathWriter) 
@@ -5079,8 +8153,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
   // the preferred constraints.  See test/Features/PreferCex.c for
   // an example) While this process can be very expensive, it can
   // also make understanding individual test cases much easier.
-  for (unsigned i = 0; i != state.symbolics.size(); ++i) {
-    const MemoryObject *mo = state.symbolics[i].first;
+  for (unsigned i = 0; i != state.symbolics->size(); ++i) {
+    const MemoryObject *mo = (*state.symbolics)[i].first;
     std::vector< ref<Expr> >::const_iterator pi = 
       mo->cexPreferences.begin(), pie = mo->cexPreferences.end();
     for (; pi != pie; ++pi) {
@@ -5102,8 +8176,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
 
   std::vector< std::vector<unsigned char> > values;
   std::vector<const Array*> objects;
-  for (unsigned i = 0; i != state.symbolics.size(); ++i)
-    objects.push_back(state.symbolics[i].second);
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    objects.push_back((*state.symbolics)[i].second);
   bool success = solver->getInitialValues(tmp, objects, values);
   solver->setTimeout(0);
   if (!success) {
@@ -5113,8 +8187,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
     return false;
   }
   
-  for (unsigned i = 0; i != state.symbolics.size(); ++i)
-    res.push_back(std::make_pair(state.symbolics[i].first->name, values[i]));
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    res.push_back(std::make_pair((*state.symbolics)[i].first->name, values[i]));
   return true;
 }
 
@@ -5126,8 +8200,6 @@ void Executor::getCoveredLines(const ExecutionState &state,
 void Executor::doImpliedValueConcretization(ExecutionState &state,
                                             ref<Expr> e,
                                             ref<ConstantExpr> value) {
-  abort(); // FIXME: Broken until we sort out how to do the write back.
-
   if (DebugCheckForImpliedValues)
     ImpliedValue::checkForImpliedValues(solver->solver, e, value);
 
@@ -5136,24 +8208,33 @@ void Executor::doImpliedValueConcretization(ExecutionState &state,
   for (ImpliedValueList::iterator it = results.begin(), ie = results.end();
        it != ie; ++it) {
     ReadExpr *re = it->first.get();
-    
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
-      // FIXME: This is the sole remaining usage of the Array object
-      // variable. Kill me.
-      const MemoryObject *mo = 0; //re->updates.root->object;
-      const ObjectState *os = state.addressSpace.findObject(mo);
+    ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index);
+    // Only a read of the initial contents of an array made symbolic in
+    // this state can be traced back to its object.
+    if (!CE || re->updates.head)
+      continue;
 
-      if (!os) {
-        // object has been free'd, no need to concretize (although as
-        // in other cases we would like to concretize the outstanding
-        // reads, but we have no facility for that yet)
-      } else {
-        assert(!os->readOnly && 
-               "not possible? read only object with static read?");
-        ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-        wos->write(CE, it->second);
-      }
+    const MemoryObject *mo = state.getSymbolicObject(re->updates.root);
+    if (!mo)
+      continue;
+
+    const ObjectState *os = state.addressSpace.findObject(mo);
+    if (!os) {
+      // object has been free'd, no need to concretize (although as
+      // in other cases we would like to concretize the outstanding
+      // reads, but we have no facility for that yet)
+      continue;
     }
+
+    // The byte may have been overwritten since the object was made
+    // symbolic, in which case the implied value is not its value.
+    uint64_t offset = CE->getZExtValue();
+    if (os->readOnly || offset >= os->size ||
+        os->read8(offset) != ref<Expr>(re))
+      continue;
+
+    ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+    wos->write(offset, it->second);
   }
 }
 
@@ -5275,9 +8356,9 @@ bool Executor::getAllRecoveryInfo(ExecutionState &state, KInstruction *ki,
   if (!getLoadInfo(state, ki, loadAddr, loadSize, preciseAllocSite))
     return false;
   
-	/* get the allocation site computed by static analysis */
-  std::set<ModRefAnalysis::ModInfo> approximateModInfos;
-  mra->getApproximateModInfos(ki->getOrigInst(), preciseAllocSite, approximateModInfos);
+	/* the modifiers computed by static analysis, see KModule::addModifiers */
+  KModifierInfo *modifiers = ki->modifiers;
+  unsigned numModifiers = ki->numModifiers;
 
   /* all the recovery information which may be required  */
   std::list< ref<RecoveryInfo> > required;
@@ -5296,29 +8377,30 @@ bool Executor::getAllRecoveryInfo(ExecutionState &state, KInstruction *ki,
 
     ref<Snapshot> snapshot = snapshots[index];
     Function *snapshotFunction = snapshot->f;
-    for (std::set<ModRefAnalysis::ModInfo>::iterator j = approximateModInfos.begin(); 
-        j != approximateModInfos.end(); j++) {
-      ModRefAnalysis::ModInfo modInfo = *j;
-      if (modInfo.first != snapshotFunction) {
+    for (unsigned j = 0; j < numModifiers; j++) {
+      KModifierInfo &modifier = modifiers[j];
+      /* compare only the allocation sites (values) */
+      if (modifier.allocSite != preciseAllocSite.first) {
+        continue;
+      }
+      if (modifier.f != snapshotFunction) {
         /* the function of the snapshot must match the modifier */
         continue;
       }
 
       /* get the corresponding slice id */
-      ModRefAnalysis::ModInfoToIdMap &modInfoToIdMap = mra->getModInfoToIdMap();
-      ModRefAnalysis::ModInfoToIdMap::iterator entry = modInfoToIdMap.find(modInfo);
-      if (entry == modInfoToIdMap.end()) {
+      if (modifier.sliceId == 0) {
         llvm_unreachable("ModInfoToIdMap is empty");
       }
 
-      uint32_t sliceId = entry->second;
+      uint32_t sliceId = modifier.sliceId;
 
       /* initialize... */
       ref<RecoveryInfo> recoveryInfo(new RecoveryInfo());
       recoveryInfo->loadInst = loadInst;
       recoveryInfo->loadAddr = loadAddr;
       recoveryInfo->loadSize = loadSize;
-      recoveryInfo->f = modInfo.first;
+      recoveryInfo->f = modifier.f;
       recoveryInfo->sliceId = sliceId;
       recoveryInfo->snapshot = snapshot;
       recoveryInfo->snapshotIndex = index;
@@ -5348,7 +8430,31 @@ bool Executor::getAllRecoveryInfo(ExecutionState &state, KInstruction *ki,
     );
 
     ref<Expr> expr;
-    if (state.getRecoveredValue(index, sliceId, loadAddr, expr)) {
+    bool isRecovered = state.getRecoveredValue(index, sliceId, loadAddr, expr);
+    if (!isRecovered) {
+      /* a state sharing the snapshot may have already run this slice */
+      std::map<std::pair<uint32_t, uint64_t>, ref<Expr> > &recoveredValues =
+        recoveryInfo->snapshot->recoveredValues;
+      auto cached = recoveredValues.find(std::make_pair(sliceId, loadAddr));
+      if (cached != recoveredValues.end()) {
+        expr = cached->second;
+        state.updateRecoveredValue(index, sliceId, loadAddr, expr);
+        isRecovered = true;
+      }
+    }
+    if (!isRecovered && RecoverySummaries) {
+      /* or the slice ran on the same inputs from another snapshot, as long
+         as this run would depend only on the snapshot too */
+      ExecutionState *originatingState =
+        state.isRecoveryState() ? state.getOriginatingState() : &state;
+      if (index == 0 && originatingState->getGuidingConstraints().empty() &&
+          findRecoverySummary(*recoveryInfo, expr)) {
+        recoveryInfo->snapshot->recoveredValues[std::make_pair(sliceId, loadAddr)] = expr;
+        state.updateRecoveredValue(index, sliceId, loadAddr, expr);
+        isRecovered = true;
+      }
+    }
+    if (isRecovered) {
       /* this slice was already executed from this snapshot,
          and we know which value was written (or not) */
       state.addRecoveredAddress(loadAddr);
@@ -5394,9 +8500,14 @@ bool Executor::getAllRecoveryInfo(ExecutionState &state, KInstruction *ki,
           sliceId
         )
       );
-      /* TODO: add docs */
-      state.updateRecoveredValue(index, sliceId, loadAddr, NULL);
-      result.push_front(recoveryInfo);
+      if (BatchRecoveries) {
+        /* latest first, marked as executed when started */
+        result.push_back(recoveryInfo);
+      } else {
+        /* TODO: add docs */
+        state.updateRecoveredValue(index, sliceId, loadAddr, NULL);
+        result.push_front(recoveryInfo);
+      }
     }
   }
   return true;
@@ -5488,9 +8599,49 @@ bool Executor::getLoadInfo(ExecutionState &state, KInstruction *ki,
   return true;
 }
 
+void Executor::insertState(ExecutionState *es) {
+  if (states.insert(es) && es->isSuspended())
+    ++numSuspendedStates;
+}
+
+void Executor::eraseState(StateSet::iterator it) {
+  ExecutionState &state = **it;
+  if (state.isSuspended()) {
+    assert(numSuspendedStates > 0);
+    --numSuspendedStates;
+  }
+  //the other side of its branch does not wait for it at the join
+  if (state.mergeId) {
+    std::map<uint64_t, ExecutionState *>::iterator jit =
+        statesAtJoin.find(state.mergeId);
+    if (jit != statesAtJoin.end() && jit->second == &state)
+      statesAtJoin.erase(jit);
+    else
+      releaseMergeJoin(state.mergeId);
+  }
+  states.erase(it);
+}
+
+void Executor::markSuspended(ExecutionState &state, bool suspended) {
+  if (state.isSuspended() != suspended && states.count(&state)) {
+    if (suspended)
+      ++numSuspendedStates;
+    else
+      --numSuspendedStates;
+  }
+  if (suspended)
+    state.setSuspended();
+  else
+    state.setResumed();
+}
+
 void Executor::suspendState(ExecutionState &state) {
   DEBUG_WITH_TYPE(DEBUG_BASIC, klee_message("suspending: %p", &state));
-  state.setSuspended();
+  markSuspended(state, true);
+  if (!state.isRecoveryState()) {
+    state.setSuspendTime(util::getWallTime());
+    ++stats::suspensions;
+  }
   suspendedStates.push_back(&state);
 
   auto fit = nonRecoveryStates.find(&state);
@@ -5505,10 +8656,12 @@ void Executor::resumeState(ExecutionState &state, bool implicitlyCreated, Execut
 
   if(!state.isRecoveryState()) {
     nonRecoveryStates.insert(&state);
+    stats::blockedTime += (util::getWallTime() - state.getSuspendTime()) * 1000000.;
   }
 
   DEBUG_WITH_TYPE(DEBUG_BASIC, klee_message("resuming: %p", &state));
-  state.setResumed();
+  applyDeferredConstraints(state);
+  markSuspended(state, false);
   state.setRecoveryState(0);
   state.markLoadAsUnrecovered();
   if (implicitlyCreated) {
@@ -5541,8 +8694,36 @@ void Executor::onRecoveryStateExit(ExecutionState &state) {
   }
   DEBUG_WITH_TYPE(DEBUG_BASIC, klee_message("%p: recovery state reached exit instruction", &state));
   ExecutionState *dependentState = state.getDependentState();
+
+  /* the result depends only on the snapshot, let the other states reuse it */
+  ref<RecoveryInfo> recoveryInfo = state.getRecoveryInfo();
+  EventTrace &trace = EventTrace::getProcessTrace();
+  if (trace.isEnabled()) {
+    trace.record(EventTrace::Recovery, recoveryInfo->traceStart,
+                 EventTrace::now() - recoveryInfo->traceStart,
+                 state.getLevel());
+  }
+  ref<Expr> expr;
+  if (recoveryInfo->shareable &&
+      dependentState->getRecoveredValue(recoveryInfo->snapshotIndex, recoveryInfo->sliceId,
+                                        recoveryInfo->loadAddr, expr)) {
+    recoveryInfo->snapshot->recoveredValues[std::make_pair(recoveryInfo->sliceId,
+                                                           recoveryInfo->loadAddr)] = expr;
+    if (RecoverySummaries && recoveryInfo->summarizable) {
+      addRecoverySummary(*recoveryInfo, expr);
+    }
+  }
   //dumpConstrains(*dependentState);
 
+  /* the latest writer determines the loaded value, skip the earlier ones */
+  if (BatchRecoveries && dependentState->hasPendingRecoveryInfo()) {
+    ref<Expr> written;
+    if (dependentState->getRecoveredValue(recoveryInfo->snapshotIndex, recoveryInfo->sliceId,
+                                          recoveryInfo->loadAddr, written) && !written.isNull()) {
+      dependentState->getPendingRecoveryInfos().clear();
+    }
+  }
+
   /* check if we need to run another recovery state */
   if (dependentState->hasPendingRecoveryInfo()) {
     ref<RecoveryInfo> ri = dependentState->getPendingRecoveryInfo();
@@ -5587,6 +8768,13 @@ void Executor::startRecoveryState(ExecutionState &state, ref<RecoveryInfo> recov
 
   ref<ExecutionState> snapshotState = recoveryInfo->snapshot->state;
 
+  if (BatchRecoveries) {
+    /* the earlier recoveries are still unknown to this one, so its nested
+       loads from the same location are recovered instead of read as unwritten */
+    state.updateRecoveredValue(recoveryInfo->snapshotIndex, recoveryInfo->sliceId,
+                               recoveryInfo->loadAddr, NULL);
+  }
+
   /* TODO: non-first snapshots hold normal state properties! */
 
   /* initialize recovery state */
@@ -5601,7 +8789,7 @@ void Executor::startRecoveryState(ExecutionState &state, ref<RecoveryInfo> recov
     recoveryState->setType(NORMAL_STATE | RECOVERY_STATE);
 
     /* initialize... */
-    recoveryState->setResumed();
+    markSuspended(*recoveryState, false);
     /* not linked to any recovery state at this point */
     recoveryState->setRecoveryState(0);
     /* TODO: we need only a prefix of the snapshots... */
@@ -5635,6 +8823,8 @@ void Executor::startRecoveryState(ExecutionState &state, ref<RecoveryInfo> recov
   recoveryState->setOriginatingState(originatingState);
 
   /* set recovery information */
+  if (EventTrace::getProcessTrace().isEnabled())
+    recoveryInfo->traceStart = EventTrace::now();
   recoveryState->setRecoveryInfo(recoveryInfo);
 
   /* pass allocation record to recovery state */
@@ -5645,8 +8835,11 @@ void Executor::startRecoveryState(ExecutionState &state, ref<RecoveryInfo> recov
   recoveryState->setLevel(level);
 
   /* add the guiding constraints to the recovery state */
-  std::set< ref<Expr> > &constraints = originatingState->getGuidingConstraints();
-  for (std::set< ref<Expr> >::iterator i = constraints.begin(); i != constraints.end(); i++) {
+  const std::set< ref<Expr> > &constraints = originatingState->getGuidingConstraints();
+  if (recoveryInfo->snapshotIndex != 0 || !constraints.empty()) {
+    recoveryInfo->shareable = false;
+  }
+  for (std::set< ref<Expr> >::const_iterator i = constraints.begin(); i != constraints.end(); i++) {
     addConstraint(*recoveryState, *i);
   }
   DEBUG_WITH_TYPE(
@@ -5726,6 +8919,10 @@ void Executor::onRecoveryStateWrite(
 
   uint64_t storeAddr = dyn_cast<ConstantExpr>(address)->getZExtValue();
   ref<RecoveryInfo> recoveryInfo = state.getRecoveryInfo();
+  if (RecoverySummaries && recoveryInfo->summarizable) {
+    /* what the slice reads back is not an input */
+    recoveryInfo->written.add(storeAddr, Expr::getMinBytesForWidth(value->getWidth()), 0);
+  }
   if (storeAddr != recoveryInfo->loadAddr) {
     return;
   }
@@ -5759,6 +8956,128 @@ void Executor::onRecoveryStateWrite(
   );
 }
 
+void Executor::onRecoveryStateRead(
+  ExecutionState &state,
+  ref<Expr> address,
+  const MemoryObject *mo,
+  ref<Expr> value) {
+  ref<RecoveryInfo> recoveryInfo = state.getRecoveryInfo();
+  if (!RecoverySummaries || !recoveryInfo->summarizable) {
+    return;
+  }
+
+  /* the objects the slice allocated itself are not inputs */
+  if (!recoveryInfo->snapshot->state->addressSpace.findObject(mo)) {
+    return;
+  }
+
+  ConstantExpr *ca = dyn_cast<ConstantExpr>(address);
+  ConstantExpr *cv = dyn_cast<ConstantExpr>(value);
+  if (!ca || !cv) {
+    recoveryInfo->summarizable = false;
+    recoveryInfo->reads.clear();
+    return;
+  }
+  unsigned epoch;
+  if (recoveryInfo->written.covers(ca->getZExtValue(),
+                                   Expr::getMinBytesForWidth(cv->getWidth()), epoch)) {
+    return;
+  }
+  recoveryInfo->reads.push_back(std::make_pair(ca->getZExtValue(), ref<ConstantExpr>(cv)));
+}
+
+/* the arguments of the skipped call, false unless all are concrete */
+bool Executor::getSliceArguments(ExecutionState &snapshotState,
+                                 std::vector<ref<Expr> > &args) {
+  KInstruction *ki = snapshotState.prevPC;
+  CallSite cs(ki->inst);
+  for (unsigned i = 0; i < cs.arg_size(); i++) {
+    ref<Expr> arg = eval(ki, i + 1, snapshotState).value;
+    if (!isa<ConstantExpr>(arg)) {
+      return false;
+    }
+    args.push_back(arg);
+  }
+  return true;
+}
+
+void Executor::addRecoverySummary(RecoveryInfo &recoveryInfo, ref<Expr> value) {
+  if (!value.isNull() && !isa<ConstantExpr>(value)) {
+    return;
+  }
+
+  RecoverySummary summary;
+  if (!getSliceArguments(*recoveryInfo.snapshot->state, summary.args)) {
+    return;
+  }
+  summary.reads.swap(recoveryInfo.reads);
+  summary.value = value;
+
+  std::deque<RecoverySummary> &summaries =
+    recoverySummaries[std::make_pair(recoveryInfo.sliceId, recoveryInfo.loadAddr)];
+  summaries.push_front(summary);
+  /* a few inputs per call site are hot, the rest is not worth keeping */
+  if (summaries.size() > 16) {
+    summaries.pop_back();
+  }
+}
+
+bool Executor::findRecoverySummary(RecoveryInfo &recoveryInfo, ref<Expr> &value) {
+  std::map<std::pair<uint32_t, uint64_t>, std::deque<RecoverySummary> >::iterator i =
+    recoverySummaries.find(std::make_pair(recoveryInfo.sliceId, recoveryInfo.loadAddr));
+  if (i == recoverySummaries.end()) {
+    return false;
+  }
+
+  ExecutionState &snapshotState = *recoveryInfo.snapshot->state;
+  std::vector<ref<Expr> > args;
+  if (!getSliceArguments(snapshotState, args)) {
+    return false;
+  }
+
+  for (std::deque<RecoverySummary>::iterator j = i->second.begin(); j != i->second.end(); j++) {
+    if (j->args != args) {
+      continue;
+    }
+
+    /* the slice runs the same way if it reads the same values */
+    bool matches = true;
+    for (unsigned k = 0; k < j->reads.size() && matches; k++) {
+      uint64_t addr = j->reads[k].first;
+      ref<ConstantExpr> expected = j->reads[k].second;
+      ObjectPair op;
+      if (!snapshotState.addressSpace.resolveOne(
+              ConstantExpr::create(addr, Context::get().getPointerWidth()), op)) {
+        matches = false;
+        break;
+      }
+      uint64_t offset = addr - op.first->address;
+      if (offset + Expr::getMinBytesForWidth(expected->getWidth()) > op.first->size) {
+        matches = false;
+        break;
+      }
+      ref<Expr> actual = op.second->read(offset, expected->getWidth());
+      matches = actual == ref<Expr>(expected);
+    }
+    if (!matches) {
+      continue;
+    }
+
+    DEBUG_WITH_TYPE(
+      DEBUG_BASIC,
+      klee_message(
+        "summarized recovery (slice id = %u, addr = %lx, %lu reads)",
+        recoveryInfo.sliceId,
+        recoveryInfo.loadAddr,
+        j->reads.size()
+      )
+    );
+    value = j->value;
+    return true;
+  }
+  return false;
+}
+
 void Executor::onNormalStateWrite(
   ExecutionState &state,
   ref<Expr> address,
@@ -5768,7 +9087,7 @@ void Executor::onNormalStateWrite(
     return;
   }
 
-  if (state.prevPC->inst->getOpcode() != Instruction::Store) {
+  if (state.prevPC->opcode != Instruction::Store) {
     /* TODO: this must be a vastart call, check! */
     return;
   }
@@ -5848,6 +9167,7 @@ MemoryObject *Executor::onExecuteAlloc(ExecutionState &state, uint64_t size, boo
 
     ExecutionState *dependentState = state.getDependentState();
     AllocationRecord &guidingAllocationRecord = state.getGuidingAllocationRecord();
+    state.getRecoveryInfo()->shareable = false;
     AllocationRecord &allocationRecord = dependentState->getAllocationRecord();
 
     if (guidingAllocationRecord.exists(context)) {
@@ -5944,10 +9264,45 @@ void Executor::terminateStateRecursively(ExecutionState &state) {
 
 void Executor::mergeConstraints(ExecutionState &dependentState, ref<Expr> condition) {
     assert(dependentState.isNormalState());
+    if (DeferDependentConstraints) {
+        /* suspended, nothing asks the solver about it until it resumes */
+        dependentState.addDeferredConstraint(condition);
+        return;
+    }
     addConstraint(dependentState, condition);
 }
 
+void Executor::applyDeferredConstraints(ExecutionState &state) {
+    const std::vector< ref<Expr> > &deferred = state.getDeferredConstraints();
+    if (deferred.empty()) {
+        return;
+    }
+    /* the forks of the chain may still share them, so copy first */
+    std::vector< ref<Expr> > conditions(deferred);
+    state.clearDeferredConstraints();
+    for (unsigned i = 0; i < conditions.size(); i++) {
+        addConstraint(state, conditions[i]);
+    }
+}
+
 bool Executor::isFunctionToSkip(ExecutionState &state, Function *f) {
+    if (interpreterOpts.skippedFunctions.empty()) {
+        return false;
+    }
+
+    /* the decision depends only on the call site and the callee */
+    KCallInstruction *kci = static_cast<KCallInstruction*>((KInstruction *)state.prevPC);
+    if (kci->targetResolved && f == kci->target) {
+        if (kci->skipTarget == -1) {
+            kci->skipTarget = matchSkippedFunction(state, f);
+        }
+        return kci->skipTarget;
+    }
+
+    return matchSkippedFunction(state, f);
+}
+
+bool Executor::matchSkippedFunction(ExecutionState &state, Function *f) {
     for (auto i = interpreterOpts.skippedFunctions.begin(), e = interpreterOpts.skippedFunctions.end(); i != e; i++) {
         const SkippedFunctionOption &option = *i;
         if ((option.name == f->getName().str())) {
@@ -6015,6 +9370,7 @@ void Executor::unbindAll(ExecutionState *state, const MemoryObject *mo) {
 
 void Executor::forkDependentStates(ExecutionState *trueState, ExecutionState *falseState) {
     ExecutionState *current = trueState->getDependentState();
+    trueState->getRecoveryInfo()->shareable = false;
     ExecutionState *forked = NULL;
     ExecutionState *prevForked = falseState;
     ExecutionState *forkedOriginatingState = NULL;
@@ -6065,6 +9421,7 @@ void Executor::forkDependentStates(ExecutionState *trueState, ExecutionState *fa
 
 void Executor::mergeConstraintsForAll(ExecutionState &recoveryState, ref<Expr> condition) {
     ExecutionState *next = recoveryState.getDependentState();
+    recoveryState.getRecoveryInfo()->shareable = false;
     do {
         mergeConstraints(*next, condition);
 
@@ -6085,61 +9442,164 @@ Function *Executor::getSlice(Function *target, uint32_t sliceId, ModRefAnalysis:
     uint32_t subId) {
     Cloner::SliceInfo *sliceInfo = NULL;
 
+    if (SliceProfile != "") {
+        sliceHits[SliceKey(target->getName().str(), sliceId)]++;
+    }
+
     sliceInfo = cloner->getSliceInfo(target, sliceId);
     if (!sliceInfo || !sliceInfo->isSliced) {
-        DEBUG_WITH_TYPE(DEBUG_BASIC,
-            klee_message("generating slice for: %s (id = %u)", target->getName().data(), sliceId)
-        );
-        sliceGenerator->generateSlice(target, sliceId, type);
-        sliceGenerator->dumpSlice(target, sliceId, true);
-
-        /* update statistics */
-        interpreterHandler->incGeneratedSlicesCount();
-
+        addSlice(target, sliceId, type);
         if (!sliceInfo) {
             sliceInfo = cloner->getSliceInfo(target, sliceId);
             assert(sliceInfo);
         }
+    }
 
-        std::set<Function *> &reachable = ra->getReachableFunctions(target);
-        for (std::set<Function *>::iterator i = reachable.begin(); i != reachable.end(); i++) {
-            /* original function */
-            Function *f = *i;
-            if (f->isDeclaration()) {
-                continue;
-            }
+    return sliceInfo->f;
+}
 
-            /* get the cloned function (using the slice id) */
-            Function *cloned = cloner->getSliceInfo(f, sliceId)->f;
-            if (cloned->isDeclaration()) {
-                /* a sliced function can become empty (a decleration) */
-                continue;
-            }
+void Executor::addSlice(Function *target, uint32_t sliceId, ModRefAnalysis::SideEffectType type) {
+    DEBUG_WITH_TYPE(DEBUG_BASIC,
+        klee_message("generating slice for: %s (id = %u)", target->getName().data(), sliceId)
+    );
+    sliceGenerator->generateSlice(target, sliceId, type);
+    sliceGenerator->dumpSlice(target, sliceId, true);
 
-            /* initialize KFunction */
-            KFunction *kcloned = new KFunction(cloned, kmodule);
-            kcloned->isCloned = true;
-
-            DEBUG_WITH_TYPE(DEBUG_BASIC, klee_message("adding function: %s", cloned->getName().data()));
-            /* update debug info */
-            kmodule->infos->addClonedInfo(cloner, cloned);
-            /* update function map */
-            kmodule->addFunction(kcloned, true, cloner, mra);
-            /* update the instruction constants of the new KFunction */
-            for (unsigned i = 0; i < kcloned->numInstructions; ++i) {
-                bindInstructionConstants(kcloned->instructions[i]);
-            }
-            /* when we add a KFunction, additional constants might be added */
-            for (unsigned i = kmodule->constantTable.size(); i < kmodule->constants.size(); ++i) {
-                Cell c = {
-                    .value = evalConstant(kmodule->constants[i])
-                };
-                kmodule->constantTable.push_back(c);
-            }
+    /* update statistics */
+    interpreterHandler->incGeneratedSlicesCount();
+
+    std::set<Function *> &reachable = ra->getReachableFunctions(target);
+    for (std::set<Function *>::iterator i = reachable.begin(); i != reachable.end(); i++) {
+        /* original function */
+        Function *f = *i;
+        if (f->isDeclaration()) {
+            continue;
+        }
+
+        /* get the cloned function (using the slice id) */
+        Function *cloned = cloner->getSliceInfo(f, sliceId)->f;
+        if (cloned->isDeclaration()) {
+            /* a sliced function can become empty (a decleration) */
+            continue;
+        }
+
+        /* initialize KFunction */
+        KFunction *kcloned = new KFunction(cloned, kmodule);
+        kcloned->isCloned = true;
+
+        DEBUG_WITH_TYPE(DEBUG_BASIC, klee_message("adding function: %s", cloned->getName().data()));
+        /* update debug info */
+        kmodule->infos->addClonedInfo(cloner, cloned);
+        /* update function map */
+        kmodule->addFunction(kcloned, true, cloner, mra);
+        /* update the instruction constants of the new KFunction */
+        for (unsigned i = 0; i < kcloned->numInstructions; ++i) {
+            bindInstructionConstants(kcloned->instructions[i]);
+        }
+        /* when we add a KFunction, additional constants might be added */
+        for (unsigned i = kmodule->constantTable.size(); i < kmodule->constants.size(); ++i) {
+            Cell c = {
+                .value = evalConstant(kmodule->constants[i])
+            };
+            kmodule->constantTable.push_back(c);
         }
     }
+}
 
-    return sliceInfo->f;
+/* the profile holds "<count> <function> <slice id>" lines */
+static void readSliceProfile(std::istream &is,
+                             std::map<std::pair<std::string, uint32_t>, unsigned> &counts) {
+    unsigned count;
+    std::string name;
+    uint32_t sliceId;
+    while (is >> count >> name >> sliceId) {
+        counts[std::make_pair(name, sliceId)] += count;
+    }
+}
+
+void Executor::loadSliceProfile() {
+    std::ifstream is(SliceProfile.c_str());
+    std::map<SliceKey, unsigned> counts;
+    readSliceProfile(is, counts);
+
+    /* only keep the slices that exist in this module */
+    std::set<SliceKey> sideEffects;
+    ModRefAnalysis::SideEffects &se = mra->getSideEffects();
+    for (ModRefAnalysis::SideEffects::iterator i = se.begin(); i != se.end(); i++) {
+        if (i->type == ModRefAnalysis::Modifier) {
+            sideEffects.insert(SliceKey(i->getFunction()->getName().str(), i->id));
+        }
+    }
+
+    std::vector<std::pair<unsigned, SliceKey> > ordered;
+    for (std::map<SliceKey, unsigned>::iterator i = counts.begin(); i != counts.end(); i++) {
+        if (sideEffects.count(i->first)) {
+            ordered.push_back(std::make_pair(i->second, i->first));
+        }
+    }
+    std::sort(ordered.begin(), ordered.end());
+
+    //pendingSlices is consumed from the back, most needed last
+    pendingSlices.clear();
+    for (unsigned i = 0; i < ordered.size(); ++i) {
+        pendingSlices.push_back(ordered[i].second);
+    }
+}
+
+void Executor::saveSliceProfile() {
+    if (sliceHits.empty()) {
+        return;
+    }
+
+    //all ranks merge into the same file
+    int fd = open(SliceProfile.c_str(), O_RDWR | O_CREAT, 0664);
+    if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+        klee_warning("unable to update slice profile %s", SliceProfile.c_str());
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+
+    std::map<SliceKey, unsigned> counts = sliceHits;
+    {
+        std::ifstream is(SliceProfile.c_str());
+        readSliceProfile(is, counts);
+    }
+
+    std::ostringstream os;
+    for (std::map<SliceKey, unsigned>::iterator i = counts.begin(); i != counts.end(); i++) {
+        os << i->second << " " << i->first.first << " " << i->first.second << "\n";
+    }
+    std::string out = os.str();
+    if (ftruncate(fd, 0) != 0 || write(fd, out.data(), out.size()) != (ssize_t)out.size()) {
+        klee_warning("unable to update slice profile %s", SliceProfile.c_str());
+    }
+
+    flock(fd, LOCK_UN);
+    close(fd);
+    sliceHits.clear();
+}
+
+/* generate one slice needed in earlier runs, returns false if none is left */
+bool Executor::pregenerateSlice() {
+    while (!pendingSlices.empty()) {
+        SliceKey key = pendingSlices.back();
+        pendingSlices.pop_back();
+
+        Function *target = kmodule->module->getFunction(key.first);
+        if (!target) {
+            continue;
+        }
+        Cloner::SliceInfo *sliceInfo = cloner->getSliceInfo(target, key.second);
+        if (sliceInfo && sliceInfo->isSliced) {
+            continue;
+        }
+
+        addSlice(target, key.second, ModRefAnalysis::Modifier);
+        return true;
+    }
+    return false;
 }
 
 ExecutionState *Executor::createSnapshotState(ExecutionState &state) {
@@ -6148,49 +9608,134 @@ ExecutionState *Executor::createSnapshotState(ExecutionState &state) {
     /* remove guiding constraints */
     snapshotState->clearGuidingConstraints();
 
+    /* the address space and the constraints are already shared with the
+       live state (copy on write), drop what the recovery states replace
+       anyway so that long lived snapshots stay small */
+    snapshotState->branchHist.clear();
+    snapshotState->clearPrefixes();
+    snapshotState->coveredLines.clear();
+    snapshotState->clearRecoveredAddresses();
+    snapshotState->setRecoveryCache(0);
+
     return snapshotState;
 }
 
-bool Executor::checkRange(std::vector<unsigned char> inPath) {
-  bool violatePrefix = false;
-  if(ENABLE_LOGGING) {
-    mylogFile << "Checking feasibility of Path: ";
-    for (auto I = inPath.begin(); I != inPath.end(); ++I) {
-      mylogFile << *I;
+/// whether a recovery started from one state would run as from the other
+static bool sameSnapshotState(ExecutionState &a, ExecutionState &b) {
+  if (a.pc != b.pc || a.prevPC != b.prevPC || a.stack.size() != b.stack.size())
+    return false;
+  for (unsigned i = 0; i < a.stack.size(); i++) {
+    const StackFrame &fa = a.stack[i], &fb = b.stack[i];
+    if (fa.kf != fb.kf || fa.caller != fb.caller ||
+        fa.allocas != fb.allocas || fa.varargs != fb.varargs)
+      return false;
+    /* the forks write their own copies of the registers, compare values */
+    const Cell *la = fa.getLocals(), *lb = fb.getLocals();
+    for (unsigned j = 0; la != lb && j < fa.kf->numRegisters; j++) {
+      if (la[j].value.isNull() != lb[j].value.isNull() ||
+          (!la[j].value.isNull() && la[j].value != lb[j].value))
+        return false;
+    }
+  }
+  return a.constraints == b.constraints &&
+         a.addressSpace.sameObjects(b.addressSpace);
+}
+
+ref<Snapshot> Executor::findSharedSnapshot(ExecutionState &state, Function *f) {
+  std::vector<ref<Snapshot> > &candidates = sharedSnapshots[state.prevPC->inst];
+  ref<Snapshot> found;
+  for (unsigned i = 0; i < candidates.size(); ) {
+    /* held only here, no state can share it any more */
+    if (candidates[i]->refCount == 1) {
+      candidates.erase(candidates.begin() + i);
+      continue;
     }
-    mylogFile << "\n";
+    if (found.isNull() && candidates[i]->f == f &&
+        sameSnapshotState(*candidates[i]->state, state)) {
+      found = candidates[i];
+    }
+    i++;
+  }
+  return found;
+}
+
+bool Executor::checkRange(const ExecutionState &state) {
+  if(pathRange.isAll()) {
+    return true;
+  }
+  std::string forks = PathInterval::getForks(state.branchHist.toVector());
+  if(ENABLE_LOGGING) {
+    mylogFile << "Checking range of Path: " << forks << "\n";
     mylogFile.flush();
-  } 
+  }
+  return pathRange.overlaps(forks);
+}
 
-  int minLen = (inPath.size()<prefixDepth)?inPath.size():prefixDepth;
-  if (convertPath2Number(inPath, minLen) != convertPath2Number(upperBound, minLen)) {
-    violatePrefix = true;
+bool Executor::ownsPath(const ExecutionState &state) const {
+  //the worker writes the tests of the paths its replay process ends
+  if(inReplayProcess) {
+    return false;
   }
-  return violatePrefix;
+  return pathRange.isAll() ||
+         pathRange.owns(PathInterval::getForks(state.branchHist.toVector()));
 }
 
-int Executor::convertPath2Number(std::vector<unsigned char> inPath, int upto) {
-  int limit = (upto==0)?(inPath.size()-1):(upto-1);
-  int sum = 0, index=0;
-  for(int it=limit; it >= 0; it--) {
-    if(inPath[it]=='1') {
-      sum = sum+pow(2,index);
+void Executor::keepInsidePathRange(std::vector<ExecutionState*> &offloadVec) const {
+  if(pathRange.isAll()) {
+    return;
+  }
+  for(unsigned x = 0; x < offloadVec.size(); ) {
+    if(pathRange.contains(PathInterval::getForks(offloadVec[x]->branchHist.toVector()))) {
+      x++;
+    } else {
+      offloadVec.erase(offloadVec.begin() + x);
     }
-    index++;
   }
-  return sum;
 }
 
-int Executor::convertPath2Number(char* inPath, int upto) {
-  int limit = (upto==0)?(prefixDepth-1):(upto-1);
-  int sum = 0, index=0;
-  for(int it=limit; it >= 0; it--) {
-    if(inPath[it]=='1') {
-      sum = sum+pow(2,index);
-    }
-    index++;
+void Executor::setPathRange(const char *data, unsigned size) {
+  if(!PathInterval::decode(data, size, pathRange)) {
+    klee_error("malformed path interval of size %u", size);
+  }
+}
+
+void Executor::startPathRange(const char *packet, unsigned size) {
+  setPathRange(packet, size);
+  assert(shippedStateTemplate && "no initial state to start the range from");
+  ExecutionState *es = copyStartState();
+  es->ptreeNode = processTree->attach(es);
+  if(pathWriter) {
+    es->pathOS = pathWriter->open();
+  }
+  if(symPathWriter) {
+    es->symPathOS = symPathWriter->open();
+  }
+  nonRecoveryStates.insert(es);
+  insertState(es);
+  searcher->update(0, std::vector<ExecutionState *>(1, es),
+                   std::vector<ExecutionState *>());
+}
+
+ExecutionState *Executor::copyStartState() const {
+  return new ExecutionState(startupSnapshot ? *startupSnapshot
+                                            : *shippedStateTemplate);
+}
+
+void Executor::takeStartupSnapshot(ExecutionState &state) {
+  //no fork before the first symbolic input, so the snapshot lies on every
+  //path and a prefix from the root applies to it as to the initial state
+  startupSnapshot = new ExecutionState(state);
+  startupSnapshot->ptreeNode = 0;
+  startupSnapshot->clearPrefixes();
+  startupSnapshot->replayPending = false;
+  startupSnapshot->setPrefix(0);
+  startupSnapshot->setPrefixDepth(0);
+  //the call is not made yet in the copy, it runs it again
+  startupSnapshot->pc = startupSnapshot->prevPC;
+  if(ENABLE_LOGGING) {
+    mylogFile<<"Startup snapshot at stack depth "<<state.stack.size()<<"\n";
+    mylogFile.flush();
   }
-  return sum;
 }
 
 //adding a utility to print paths
@@ -6213,9 +9758,10 @@ void Executor::printStatePath(ExecutionState& state, std::ostream& log, std::str
 
 void Executor::replicateBranchHist(ExecutionState* state, ExecutionState* recState) {
   assert(recState->depth <= state->depth);
-  for(int x=(recState->branchHist).size(); x<(state->branchHist).size(); x++) {
+  std::vector<char> hist = state->branchHist.toVector();
+  for(int x=(recState->branchHist).size(); x<hist.size(); x++) {
   //for(int x=0; x<(state->branchHist).size(); x++) {
-    (recState->branchHist).push_back((state->branchHist)[x]);
+    (recState->branchHist).push_back(hist[x]);
   }
   recState->depth = state->depth;
   recState->prefixes = state->prefixes;
@@ -6223,8 +9769,9 @@ void Executor::replicateBranchHist(ExecutionState* state, ExecutionState* recSta
 
 void Executor::printBranchHist(ExecutionState* state) {
   mylogFile<<"Branch History: ";
-  for(int x=0; x<(state->branchHist).size(); x++) {
-    mylogFile<<state->branchHist[x];
+  std::vector<char> hist = state->branchHist.toVector();
+  for(int x=0; x<hist.size(); x++) {
+    mylogFile<<hist[x];
   }
   mylogFile<<"\n";
   mylogFile.flush();
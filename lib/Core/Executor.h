@@ -17,12 +17,16 @@
 
 #include "klee/ExecutionState.h"
 #include "klee/Interpreter.h"
+#include "klee/Solver.h"
 #include "klee/Internal/Module/Cell.h"
+#include "klee/Internal/Support/ClusterStats.h"
+#include "klee/Internal/Support/PathInterval.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/util/ArrayCache.h"
 #include "llvm/Support/raw_ostream.h"
 #include "PrefixTree.h"
+#include "StateSet.h"
 
 #include "llvm/ADT/Twine.h"
 
@@ -34,13 +38,18 @@
 #include "klee/Internal/Analysis/SliceGenerator.h"
 #include "klee/Internal/Analysis/Annotator.h"
 
+#include <atomic>
+#include <deque>
 #include <vector>
 #include <string>
 #include <map>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <fstream>
 #include <ostream>
 #include <mpi.h>
+#include <sys/types.h>
 
 struct KTest;
 
@@ -64,12 +73,16 @@ namespace llvm {
 
 namespace klee {  
   class Array;
+  class BranchHistoryWriter;
+  class ConcreteBlock;
   struct Cell;
   class ExecutionState;
   class ExternalDispatcher;
+  class FingerprintSet;
   class Expr;
   class InstructionInfoTable;
   struct KFunction;
+  struct KCallInstruction;
   struct KInstruction;
   class KInstIterator;
   class KModule;
@@ -77,9 +90,13 @@ namespace klee {
   class MemoryObject;
   class ObjectState;
   class PTree;
+  class InstructionSampler;
+  class QueryProfiler;
   class Searcher;
   class SeedInfo;
+  class SharedSolverCache;
   class SpecialFunctionHandler;
+  class TargetDistance;
   struct StackFrame;
   class StatsTracker;
   class TimingSolver;
@@ -95,10 +112,12 @@ class Executor : public Interpreter {
   friend class MergingSearcher;
   friend class RandomPathSearcher;
   friend class OwningSearcher;
+  friend class QueryCostSearcher;
   friend class WeightedRandomSearcher;
   friend class RandomRecoveryPath;
   friend class SpecialFunctionHandler;
   friend class StatsTracker;
+  friend class StateSerializer;
 
 public:
   class Timer {
@@ -139,10 +158,11 @@ private:
   ExternalDispatcher *externalDispatcher;
   TimingSolver *solver;
   MemoryManager *memory;
-  std::set<ExecutionState*> states;
+  StateSet states;
   StatsTracker *statsTracker;
   TreeStreamWriter *pathWriter, *symPathWriter;
   SpecialFunctionHandler *specialFunctionHandler;
+  /// Min-heap of the timers by their next firing.
   std::vector<TimerInfo*> timers;
   PTree *processTree;
   PrefixTree *prefixTree;
@@ -158,11 +178,8 @@ private:
   /// \invariant \ref addedStates and \ref removedStates are disjoint.
   std::vector<ExecutionState *> removedStates;
 
-  /// Suspended because of prefix ranging  
+  /// Suspended because of prefix ranging, prefixTree holds them by path
   std::vector<ExecutionState *> rangingSuspendedStates;
-  
-  /// map from the prefix to the suspended states
-  std::map<std::string, ExecutionState*> prefixSuspendedStatesMap;
 
   /// When non-empty the Executor is running in "seed" mode. The
   /// states in this map will be executed in an arbitrary order
@@ -184,6 +201,11 @@ private:
   /// pointers. We use the actual Function* address as the function address.
   std::set<uint64_t> legalFunctions;
 
+  /// The verdicts of isNativeCandidate, and the number of native calls of
+  /// a function that had to be interpreted after all.
+  std::map<const llvm::Function*, bool> nativeFunctions;
+  std::map<const llvm::Function*, unsigned> nativeFaults;
+
   /// When non-null the bindings that will be used for calls to
   /// klee_make_symbolic in order replay.
   const struct KTest *replayKTest;
@@ -238,12 +260,16 @@ private:
   unsigned int numPrefixes;
 
   /// set for non recovery states
-  std::set<ExecutionState*> nonRecoveryStates;
+  StateSet nonRecoveryStates;
+
+  /// number of suspended states in states, kept up to date by insertState,
+  /// eraseState and markSuspended
+  unsigned numSuspendedStates;
 
   int cntNumStates2Offload;
 
   /// set of states to offload
-  std::set<ExecutionState*> state2Offload;
+  StateSet state2Offload;
 
   // @brief buffer to store logs before flushing to file
   llvm::raw_string_ostream debugLogBuffer;
@@ -271,6 +297,139 @@ private:
   unsigned int branchLevel2Halt;
   bool enableLB;
   bool ready2Offload;
+  /// worker expands a subtree of phase 1 instead of exploring it
+  bool splitMode;
+  /// seeds run without solver queries where they agree, and each branch
+  /// they do not take is handed back as a prefix (--generational-seeds)
+  bool generationMode;
+  /// the histories of those branches
+  std::vector<std::vector<char> > seedFlips;
+  /// the histories of the paths the seeds finished
+  std::vector<std::vector<char> > seedPaths;
+  /// idle workers steal from random peers instead of asking the master
+  bool enableStealing;
+  /// worker starts without states and steals its first work
+  bool startIdle;
+  /// size offloads from the measured path rate (-offloadPolicy=ADAPTIVE)
+  bool adaptiveOffload;
+  /// paths finished by this worker since offloadStartTime
+  unsigned completedPaths;
+  double offloadStartTime;
+  /// idle workers the current offload request is for
+  unsigned idleWorkers;
+  /// status sent to the master (--heartbeat-interval): queue size, ready
+  /// flag, instructions and newly covered instructions since the last one,
+  /// the estimated number of nodes left to explore, and the distance of the
+  /// state nearest to an --error-location target (0 for none)
+  unsigned heartbeat[6];
+  MPI_Request heartbeatReq;
+  bool heartbeatPending;
+  double lastHeartbeatTime;
+  uint64_t lastHeartbeatInstructions;
+  uint64_t lastHeartbeatCovered;
+  /// offloads and steals served by this worker
+  unsigned numOffloadsSent;
+  /// With --offload-progress-thread the offload requests of the master are
+  /// answered by progressThread from a snapshot of the states to donate,
+  /// which the interpreter publishes between steps. The states of a valid
+  /// snapshot are not stepped; once the thread sent them away (claimed),
+  /// the interpreter only detaches them. offloadLock guards the snapshot
+  /// and the receipt of OFFLOAD requests.
+  std::thread progressThread;
+  std::mutex offloadLock;
+  std::vector<ExecutionState*> offloadSnapshot;
+  std::vector<char> offloadSnapshotPacket;
+  std::atomic<bool> offloadSnapshotValid, offloadClaimed, progressThreadDone;
+  double lastOffloadSnapshotTime;
+  /// the next task was asked for (--prefetch-below)
+  bool workRequested;
+  /// the task the master answered with, -1 or its tag
+  int queuedTaskTag;
+  std::vector<char> queuedTask;
+  /// the process replaying the queued prefix task (--background-replay),
+  /// 0 before it started and -1 once it is over or was not started, and
+  /// the pipe the states at the ends of the prefixes come back through
+  pid_t replayPid;
+  int replayFd;
+  std::vector<char> replayedStates;
+  /// all of replayedStates arrived and the process succeeded
+  bool replayComplete;
+  /// this is the replay process, which writes no tests
+  bool inReplayProcess;
+  /// statistics record sent to the master (--cluster-stats-interval)
+  uint64_t clusterStats[ClusterStats::NumFields];
+  MPI_Request clusterStatsReq;
+  bool clusterStatsPending;
+  double lastClusterStatsTime;
+  /// slices requested by recovery states in this run, and the slices most
+  /// requested in earlier runs, to be generated while idle (--slice-profile)
+  typedef std::pair<std::string, uint32_t> SliceKey;
+  std::map<SliceKey, unsigned> sliceHits;
+  std::vector<SliceKey> pendingSlices;
+  /// solver results exchanged with the other workers (--shared-solver-cache)
+  SharedSolverCache *sharedSolverCache;
+  std::vector<char> solverCachePacket;
+  std::vector<MPI_Request> solverCacheReqs;
+  double lastSolverCacheTime;
+  /// the hash of the bitcode the --persistent-solver-cache entries hold for
+  uint64_t persistentCacheKey;
+  /// covered instructions exchanged with the other workers (--shared-coverage)
+  std::vector<char> coveragePacket;
+  std::vector<MPI_Request> coverageReqs;
+  double lastCoverageTime;
+  uint64_t lastSharedCovered;
+  /// the fingerprints of the states at join points, here and on the other
+  /// workers (--prune-equivalent-states)
+  FingerprintSet *stateFingerprints;
+  std::vector<char> fingerprintPacket;
+  std::vector<MPI_Request> fingerprintReqs;
+  double lastFingerprintTime;
+  /// branch queries solved in forked processes (--async-fork-queries)
+  struct AsyncQuery {
+    ExecutionState *state;
+    KInstruction *ki;
+    ref<Expr> condition;
+    /// the constraints the condition depends on
+    std::vector<ref<Expr> > required;
+    /// the other states parked on the same query
+    std::vector<ExecutionState *> waiters;
+    pid_t pid;
+    int fd;
+    double startTime;
+  };
+  std::vector<AsyncQuery> asyncQueries;
+  /// branches whose last query took at least --async-query-threshold
+  std::set<KInstruction *> slowBranches;
+  /// the first instruction of the immediate post-dominator of every block
+  /// of the functions branched in so far, null for none (--auto-merge)
+  std::map<KFunction *, std::map<llvm::BasicBlock *, KInstruction *> >
+      mergeJoins;
+  /// the side of every branch which waits at the join for the other one,
+  /// by the id of the branch
+  std::map<uint64_t, ExecutionState *> statesAtJoin;
+  uint64_t lastMergeId;
+  /// the number of queries of every branch cut off by the short timeout
+  /// (--adaptive-solver-timeout)
+  std::map<KInstruction *, unsigned> timedOutBranches;
+  /// the cost of the queries of every instruction (--profile-queries)
+  QueryProfiler *queryProfiler;
+
+  /// every --sample-instructions-th instruction, or null
+  InstructionSampler *instructionSampler;
+
+  /// the executions of every block entry, and the decoded instructions of
+  /// the hot ones (--concrete-block-threshold)
+  struct ConcreteBlockSite {
+    unsigned count;
+    ConcreteBlock *block;
+    ConcreteBlockSite() : count(0), block(0) {}
+  };
+  std::map<KInstruction *, ConcreteBlockSite> concreteBlocks;
+
+  /// the distances to the --error-location targets, or null without any
+  TargetDistance *targetDistance;
+
+  void writeQueryProfile();
 
   ///MPI_WorkerID
   int coreId;
@@ -287,6 +446,8 @@ private:
   // branch history
   std::string brhistFileName;
   std::ofstream brhistFile;
+  /// the compressed log replacing brhistFile (--compress-branch-history)
+  BranchHistoryWriter *brhistWriter;
 
   //flag to prevent
   bool coreInitialized; 
@@ -294,19 +455,71 @@ private:
   char* pathPrefix;
   char* upperBound;
   char* lowerBound;
+  /// the share of the paths this worker explores (--path-intervals), the
+  /// forks leaving it are dropped
+  PathInterval pathRange;
 
   //logFile
   std::string logFileName;
   std::ofstream mylogFile;
 
+  /// the result of a slice run which depended only on the snapshot: the
+  /// value it wrote to the load address (null if none) and its inputs
+  struct RecoverySummary {
+    std::vector<ref<Expr> > args;
+    std::vector<std::pair<uint64_t, ref<ConstantExpr> > > reads;
+    ref<Expr> value;
+  };
+  /// the summaries by (slice id, load address), latest first
+  /// (--recovery-summaries)
+  std::map<std::pair<uint32_t, uint64_t>, std::deque<RecoverySummary> >
+      recoverySummaries;
+
+  /// the first snapshots of the states at each skipped call site, for the
+  /// states reaching it with the same memory and constraints
+  /// (--share-snapshots)
+  std::map<const llvm::Instruction *, std::vector<ref<Snapshot> > >
+      sharedSnapshots;
+
+  /// copy of the initial state, the base of states and prefixes received
+  /// from other workers (only kept in workers)
+  ExecutionState *shippedStateTemplate;
+
+  /// copy of the first state of this worker to make an input symbolic,
+  /// taken before it did (--startup-snapshot); prefixes and ranges
+  /// replayed from the root start from it instead of the initial state
+  ExecutionState *startupSnapshot;
+
+  /// serialized states to start from instead of the initial state
+  std::vector<char> startStatesPacket;
+
+  /// states spilled to disk over the memory cap, reloaded last in first
+  /// out when nothing else is left to run (only in workers)
+  std::fstream spillFile;
+  /// the offset and size of every packet in the spill file
+  std::vector<std::pair<std::streamoff, size_t> > spilledPackets;
+  /// states which reached their --donate-depth, out of states and the
+  /// searcher until they are offloaded or nothing else is left
+  std::vector<ExecutionState *> donatedStates;
+  /// the last prefix subtree handed to a state done with its prefixes
+  unsigned lastSubtree;
+
 	//worklist of states which were halted cause they reached a certain depth
   //each element in the worklist is a vector which contains the halted branch
   //histories
   char** workList;
   std::vector<unsigned int> workListPathSize;
+  /// estimated size of the subtree of every worklist entry
+  std::vector<double> workListEstimates;
+  /// distance of every worklist entry to the targets, 0 for none
+  std::vector<uint64_t> workListDistances;
  
   llvm::Function* getTargetFunction(llvm::Value *calledVal,
                                     ExecutionState &state);
+
+  /// The function at addr as the target of an indirect call, through the
+  /// targets cached at the call site; 0 if addr is no function.
+  llvm::Function *getIndirectTarget(KCallInstruction *kci, uint64_t addr);
   
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
@@ -332,6 +545,34 @@ private:
   void transferToBasicBlock(llvm::BasicBlock *dst, 
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
+  /// Terminate the state if an earlier state reached its join point with
+  /// the same fingerprint (--prune-equivalent-states).
+  bool pruneIfEquivalent(ExecutionState &state);
+  /// Count the forks of a branch which stay in its loops, for
+  /// --loop-budget; a side is null if the branch did not go there.
+  void countLoopForks(llvm::BranchInst *bi, ExecutionState *trueState,
+                      ExecutionState *falseState);
+
+  /// Count the block the state entered, and run the register instructions
+  /// at its entry natively while their operands are concrete, once it is
+  /// hot. Returns the number of instructions run.
+  unsigned executeConcreteBlock(ExecutionState &state);
+
+  /// Compile the dispatch stubs of all external calls of the module.
+  void prepareExternalCalls();
+
+  /// Whether f, and the functions it calls, may run natively
+  /// (--native-internal-calls): they only compute on integers and
+  /// pointers, and no instruction of theirs may block or override.
+  bool isNativeCandidate(llvm::Function *f);
+  bool isNativeCandidate(llvm::Function *f,
+                         std::set<llvm::Function*> &visiting);
+
+  /// Run the internal call of f at ki natively if its arguments are
+  /// concrete. Returns false if the call is to be interpreted, also when
+  /// the native code touched a symbolic object.
+  bool callNatively(ExecutionState &state, KInstruction *ki,
+                    llvm::Function *f, std::vector<ref<Expr> > &arguments);
 
   void callExternalFunction(ExecutionState &state,
                             KInstruction *target,
@@ -416,6 +657,56 @@ private:
   // current state, and one of the states may be null.
   StatePair fork(ExecutionState &current, ref<Expr> condition, bool isInternal);
 
+  /// Take the next branch of the replay path in current without asking
+  /// the solver (--fast-replay).
+  StatePair replayBranch(ExecutionState &current, ref<Expr> condition);
+
+  /// The side of a branch which all seeds of current take, Unknown if
+  /// they disagree.
+  Solver::Validity seedBranch(ExecutionState &current,
+                              std::vector<SeedInfo> &seeds,
+                              ref<Expr> condition);
+
+  /// Follow the side of a branch the seeds take without asking the solver
+  /// whether the other one is feasible, and keep that one as a prefix
+  /// (--generational-seeds).
+  StatePair followSeeds(ExecutionState &current, ref<Expr> condition,
+                        bool branch);
+
+  /// Evaluate the condition of a branch of current. With
+  /// --async-fork-queries, a branch whose query was slow before is solved
+  /// in a forked process, and current is parked on the branch instruction
+  /// until the answer arrives.
+  bool evaluateBranch(ExecutionState &current, ref<Expr> condition,
+                      double timeout, bool mayPark,
+                      Solver::Validity &res, bool &parked);
+  bool startAsyncQuery(ExecutionState &current, ref<Expr> condition,
+                       double timeout);
+  /// Park current on a query in flight with the same condition and the
+  /// same constraints it depends on. \return false if there is none.
+  bool joinAsyncQuery(ExecutionState &current, ref<Expr> condition);
+  void getRequiredConstraints(ExecutionState &state, ref<Expr> condition,
+                              std::vector<ref<Expr> > &required);
+  /// Evaluate with --adaptive-solver-timeout first, then with doubled
+  /// timeouts up to timeout for the states worth it.
+  bool evaluateEscalating(ExecutionState &current, ref<Expr> condition,
+                          double timeout, Solver::Validity &res);
+  /// Resume the states whose queries were answered, waiting for one if
+  /// block is set. \return true if a state was resumed.
+  bool checkAsyncQueries(bool block);
+  void cancelAsyncQueries();
+
+  KInstruction *getMergeJoin(KFunction *kf, llvm::BasicBlock *bb);
+  /// Make the two sides of the branch just forked wait for each other at
+  /// its join, if they may merge there.
+  void markMergeJoin(ExecutionState &trueState, ExecutionState &falseState);
+  /// Park the state at the join of its branch until the other side arrives,
+  /// or merge the two. \return true if the state may not run now.
+  bool mergeAtJoin(ExecutionState &state);
+  /// Resume the side waiting at the join of the branch with the id, if
+  /// any; it runs on unmerged.
+  void releaseMergeJoin(uint64_t id);
+
   /// Add the given (boolean) condition as a constraint on state. This
   /// function is a wrapper around the state's addConstraint function
   /// which also manages propagation of implied values,
@@ -432,12 +723,12 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.back().getWritableLocals()[kf->getArgRegister(index)];
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().getWritableLocals()[target->dest];
   }
 
   void bindLocal(KInstruction *target, 
@@ -524,8 +815,11 @@ private:
   void addTimer(Timer *timer, double rate);
 
   void initTimers();
-  void processTimers(ExecutionState *current,
-                     double maxInstTime);
+  /// Fire the due timers and terminate current if the instructions it ran
+  /// since startTime (a util::getMonotonicTime) took longer than
+  /// maxInstTime. Called once per instruction quantum.
+  void processTimers(ExecutionState *current, double maxInstTime,
+                     double startTime);
   void checkMemoryUsage();
   void printDebugInstructions(ExecutionState &state);
   void doDumpStates();
@@ -539,6 +833,9 @@ private:
   bool getLoadInfo(ExecutionState &state, KInstruction *kinst,
                    uint64_t &loadAddr, uint64_t &loadSize,
                    ModRefAnalysis::AllocSite &allocSite);
+  void insertState(ExecutionState *es);
+  void eraseState(StateSet::iterator it);
+  void markSuspended(ExecutionState &state, bool suspended);
   void suspendState(ExecutionState &state);
   void resumeState(ExecutionState &state, bool implicitlyCreated, ExecutionState &recState);
   void notifyDependentState(ExecutionState &recoveryState);
@@ -551,6 +848,16 @@ private:
     ref<Expr> offset,
     ref<Expr> value
   );
+  void onRecoveryStateRead(
+    ExecutionState &state,
+    ref<Expr> address,
+    const MemoryObject *mo,
+    ref<Expr> value
+  );
+  bool getSliceArguments(ExecutionState &snapshotState,
+                         std::vector<ref<Expr> > &args);
+  void addRecoverySummary(RecoveryInfo &recoveryInfo, ref<Expr> value);
+  bool findRecoverySummary(RecoveryInfo &recoveryInfo, ref<Expr> &value);
   void onNormalStateWrite(
     ExecutionState &state,
     ref<Expr> address,
@@ -569,19 +876,39 @@ private:
   void onExecuteFree(ExecutionState *state, const MemoryObject *mo);
   void terminateStateRecursively(ExecutionState &state);
   void mergeConstraints(ExecutionState &dependedState, ref<Expr> condition);
+  /// add the constraints deferred while the state was suspended
+  void applyDeferredConstraints(ExecutionState &state);
   bool isFunctionToSkip(ExecutionState &state, llvm::Function *f);
+  bool matchSkippedFunction(ExecutionState &state, llvm::Function *f);
   bool canSkipCallSite(ExecutionState &state, llvm::Function *f);
   void bindAll(ExecutionState *state, MemoryObject *mo, bool isLocal, bool zeroMemory);
   void unbindAll(ExecutionState *state, const MemoryObject *mo);
   void forkDependentStates(ExecutionState *trueState, ExecutionState *falseState);
   void mergeConstraintsForAll(ExecutionState &recoveryState, ref<Expr> condition);
   llvm::Function *getSlice(llvm::Function *target, uint32_t sliceId, ModRefAnalysis::SideEffectType type, uint32_t subId);
+  void addSlice(llvm::Function *target, uint32_t sliceId, ModRefAnalysis::SideEffectType type);
+  void loadSliceProfile();
+  void saveSliceProfile();
+  bool pregenerateSlice();
   ExecutionState *createSnapshotState(ExecutionState &state);
+  /// a first snapshot of another state which the state can use as its own
+  ref<Snapshot> findSharedSnapshot(ExecutionState &state, llvm::Function *f);
 
   //PSE Functions
-  bool checkRange(std::vector<unsigned char> inPath);
-  int convertPath2Number(std::vector<unsigned char> inPath, int upto=0);
-  int convertPath2Number(char* inPath, int upto=0);
+  /// whether some path below the state is in pathRange
+  bool checkRange(const ExecutionState &state);
+  /// whether the path of the state, if it ends here, is in pathRange and
+  /// its test is written by this process
+  bool ownsPath(const ExecutionState &state) const;
+  /// drop the states with paths out of pathRange below them, another
+  /// worker would explore those twice
+  void keepInsidePathRange(std::vector<ExecutionState*> &offloadVec) const;
+  /// start over from the initial state on the interval of a
+  /// START_RANGE_TASK
+  void startPathRange(const char *packet, unsigned size);
+  /// a fresh state to replay from the root, the startup snapshot if any
+  ExecutionState *copyStartState() const;
+  void takeStartupSnapshot(ExecutionState &state);
   void printPath(char* path, std::ostream& log, std::string message);
   void printStatePath(ExecutionState& state, std::ostream& log, std::string message);
   void replicateBranchHist(ExecutionState* state, ExecutionState* recState);
@@ -592,6 +919,80 @@ private:
   ExecutionState* offloadOriginatingStates(bool &valid);
   void check2Offload();
   void newCheck2Offload();
+  bool isReplayedPathFeasible(ExecutionState &state);
+  bool sendStateSnapshots(std::vector<ExecutionState*>& offloadVec);
+  bool addShippedStates(const char* packet, unsigned size);
+  /// whether every prefix of the packet replays from the initial state,
+  /// none resumes a state suspended here
+  bool replaysFromStart(const char* packet, int count);
+  /// fork a process replaying the queued prefix task (--background-replay)
+  void startBackgroundReplay();
+  /// in the forked process: replay the prefixes of the packet and
+  /// serialize the states at their ends into out, false if the worker has
+  /// to replay them itself
+  bool replayToFrontier(const char* packet, int count, std::vector<char>& out);
+  /// take what the replay process sent, until it is done if block
+  void readBackgroundReplay(bool block);
+  /// start the queued prefix task from the states its replay process
+  /// sent, false if it did not finish the replay
+  bool adoptBackgroundReplay(const char* packet, int count);
+  void cancelBackgroundReplay();
+  bool spillStates(std::vector<ExecutionState*>& spillVec);
+  /// free a state suspended in the prefixTree, whose path is kept there
+  void freeParkedState(ExecutionState *es);
+  bool reloadSpilledStates();
+  void encodeSolverSeeds(std::vector<ExecutionState*>& offloadVec, std::vector<char>& out);
+  /// decode the seeds at the start of the packet into seeds and the shared
+  /// solver cache, returns their size
+  size_t takeSolverSeeds(const char* packet, size_t count,
+                         std::vector<ExecutionState::ReplaySeed>& seeds);
+  void resumeFromPrefixPacket(const char* packet, int count);
+  void suspendOffloadedStates(std::vector<ExecutionState*>& offloadVec);
+  /// a normal state suspended on recoveries which did not fork, so that
+  /// its prefix stands for the whole group (--offload-dependent-states)
+  bool isOffloadableGroup(ExecutionState &state);
+  /// drop an offloaded group without counting its path
+  void dropDependentGroup(ExecutionState &state);
+  void startProgressThread();
+  void stopProgressThread();
+  void runProgressThread();
+  /// build a new snapshot of the states to donate for the progress thread
+  void publishOffloadSnapshot();
+  /// suspend the states the progress thread sent away, under offloadLock
+  void detachClaimedStates();
+  /// Take the state (all states if null) out of the offload snapshot, so
+  /// that it can be stepped or moved.
+  ///
+  /// \return false if the progress thread already sent it away.
+  bool holdOffloadState(ExecutionState *state);
+  /// hand all states back to the master as prefixes (LEAVE) and stop
+  void leaveRun();
+  void serveStealRequests();
+  void sendHeartbeat();
+  void sendClusterStats();
+  /// estimated number of nodes left below the states of this process
+  unsigned estimateRemainingWork();
+  /// the distance of the state nearest to a target, 0 for none
+  unsigned nearestTargetDistance();
+  void exchangeSolverCache();
+  void loadPersistentSolverCache(llvm::Module *module);
+  /// append the entries solved since the last call to the
+  /// --persistent-solver-cache file, at most every interval unless final
+  void persistSolverCache(bool final);
+  void appendPersistentSolverCache(const std::vector<char> &packet);
+  void exchangeCoverage();
+  void exchangeFingerprints();
+  void switchSearchMode(const std::string &mode);
+  /// put the states kept for donation back into states and the searcher
+  bool restoreDonatedStates();
+  /// Claim the subtree below the first length branches of the state from
+  /// the master (--claim-prefix-depth). Returns false if it was claimed
+  /// before.
+  bool claimPrefix(const ExecutionState &state, unsigned length);
+  double getQueueDrainTime(unsigned queueSize);
+  bool isReady2Offload(unsigned queueSize);
+  unsigned numStates2Donate(unsigned available);
+  void stealWork();
   void printBranchHist(ExecutionState* state);
 
 public:
@@ -602,6 +1003,16 @@ public:
     return *interpreterHandler;
   }
 
+  /// the states which are not suspended
+  unsigned getNumActiveStates() const {
+    return states.size() - numSuspendedStates;
+  }
+  unsigned getNumSuspendedStates() const { return numSuspendedStates; }
+
+  /// take a KILL of the master if one arrived, without taking any other
+  /// message, and halt; true if the master asked to stop
+  bool checkKill();
+
   // XXX should just be moved out to utility module
   ref<klee::ConstantExpr> evalConstant(const llvm::Constant *c);
 
@@ -635,10 +1046,7 @@ public:
       explorationDepth = inExplorationDepth;
   }
 
-  virtual void setBrHistFile(std::string inBrHistFile) {
-  	brhistFileName = inBrHistFile;
-   	brhistFile.open(brhistFileName);
-  }
+  virtual void setBrHistFile(std::string inBrHistFile);
 
   virtual void enableLoadBalancing(bool inLB) {
     enableLB = inLB;
@@ -648,6 +1056,37 @@ public:
       prefixDepth = inPD;
   }
 
+  virtual void setStartStates(const char *packet, unsigned size) {
+    startStatesPacket.assign(packet, packet + size);
+  }
+
+  virtual void enableSplitting() {
+    splitMode = true;
+  }
+
+  virtual void enableGenerations() {
+    generationMode = true;
+  }
+
+  virtual void getSeedPaths(std::vector<std::string> &paths) {
+    for (unsigned i = 0; i < seedPaths.size(); i++)
+      paths.push_back(std::string(seedPaths[i].begin(), seedPaths[i].end()));
+  }
+
+  virtual void enableWorkStealing(bool inStealing) {
+    enableStealing = inStealing;
+  }
+
+  virtual void setStartIdle() {
+    startIdle = true;
+  }
+
+  virtual void setPathRange(const char *data, unsigned size);
+
+  virtual void setOffloadPolicy(std::string inOffloadPolicy) {
+    adaptiveOffload = (inOffloadPolicy == "ADAPTIVE");
+  }
+
   typedef std::pair<unsigned, uint64_t> PSEAllocSite;
   typedef std::pair<std::string, PSEAllocSite> PSEModInfo;
   typedef std::map<PSEModInfo, uint32_t> PSEModInfoToIdMap;
@@ -699,6 +1138,14 @@ public:
                                   //char **workList_main,
                                   std::vector<unsigned int> &workListPathSize_main);
 
+  virtual void getWorkListEstimates(std::vector<double> &estimates) {
+    estimates = workListEstimates;
+  }
+
+  virtual void getWorkListDistances(std::vector<uint64_t> &distances) {
+    distances = workListDistances;
+  }
+
 
   virtual void setLogFile(std::string inLogFile) {
     logFileName = inLogFile;
@@ -715,6 +1162,15 @@ public:
     inhibitForking = value;
   }
 
+  /// Write the --sample-instructions profile so far.
+  void writeInstructionSamples();
+
+  /// Free the states suspended in the prefixTree before the given wall
+  /// time, keeping their paths; a prefix through one of them is replayed
+  /// from its nearest ancestor left, or from the initial state. Returns the
+  /// number of states freed.
+  unsigned demoteParkedStates(double before);
+
   virtual void setDataFlowAnalysisStructures(PSEModInfoToIdMap& inPseModInfoToIdMap,
                                             PSEModInfoToIdMapG& inPseModInfoToIdMapG,
                                             PSEModSetMap& inPseModSetMap,
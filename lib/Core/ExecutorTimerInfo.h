@@ -24,15 +24,22 @@ public:
 
   /// Approximate delay per timer firing.
   double rate;
-  /// Wall time for next firing.
+  /// Monotonic time for next firing.
   double nextFireTime;
 
 public:
   TimerInfo(Timer *_timer, double _rate)
     : timer(_timer),
       rate(_rate),
-      nextFireTime(util::getWallTime() + rate) {}
+      nextFireTime(util::getMonotonicTime() + rate) {}
   ~TimerInfo() { delete timer; }
+
+  /// Orders the timers heap so that the earliest firing is at the front.
+  struct Later {
+    bool operator()(const TimerInfo *a, const TimerInfo *b) const {
+      return a->nextFireTime > b->nextFireTime;
+    }
+  };
 };
 
 
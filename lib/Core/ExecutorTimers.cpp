@@ -28,10 +28,7 @@
 
 #include "llvm/Support/CommandLine.h"
 
-#include <unistd.h>
-#include <signal.h>
-#include <sys/time.h>
-#include <math.h>
+#include <algorithm>
 
 
 using namespace llvm;
@@ -42,6 +39,20 @@ MaxTime("max-time",
         cl::desc("Halt execution after the specified number of seconds (default=0 (off))"),
         cl::init(0));
 
+cl::opt<double>
+SampleDumpInterval("sample-dump-interval",
+                   cl::desc("Rewrite the --sample-instructions profile every "
+                            "this many seconds (default=60, 0=only at the end)"),
+                   cl::init(60));
+
+cl::opt<double>
+ParkedStateTTL("parked-state-ttl",
+               cl::desc("Free the states a worker suspended to resume later "
+                        "prefixes from once they have been unused for this "
+                        "many seconds; the prefixes are replayed from their "
+                        "nearest ancestor left instead (default=0 (off))"),
+               cl::init(0));
+
 ///
 
 class HaltTimer : public Executor::Timer {
@@ -59,42 +70,48 @@ public:
 
 ///
 
-static const double kSecondsPerTick = .1;
-static volatile unsigned timerTicks = 0;
+class SampleDumpTimer : public Executor::Timer {
+  Executor *executor;
 
-// XXX hack
-extern "C" unsigned dumpStates, dumpPTree;
-unsigned dumpStates = 0, dumpPTree = 0;
+public:
+  SampleDumpTimer(Executor *_executor) : executor(_executor) {}
+  ~SampleDumpTimer() {}
 
-static void onAlarm(int) {
-  ++timerTicks;
-}
+  void run() { executor->writeInstructionSamples(); }
+};
 
-// oooogalay
-static void setupHandler() {
-  struct itimerval t;
-  struct timeval tv;
-  
-  tv.tv_sec = (long) kSecondsPerTick;
-  tv.tv_usec = (long) (fmod(kSecondsPerTick, 1.)*1000000);
-  
-  t.it_interval = t.it_value = tv;
-  
-  ::setitimer(ITIMER_REAL, &t, 0);
-  ::signal(SIGALRM, onAlarm);
-}
+///
 
-void Executor::initTimers() {
-  static bool first = true;
+class ParkedStateTimer : public Executor::Timer {
+  Executor *executor;
+
+public:
+  ParkedStateTimer(Executor *_executor) : executor(_executor) {}
+  ~ParkedStateTimer() {}
 
-  if (first) {
-    first = false;
-    setupHandler();
+  void run() {
+    executor->demoteParkedStates(util::getWallTime() - ParkedStateTTL);
   }
+};
+
+///
 
+// XXX hack
+extern "C" unsigned dumpStates, dumpPTree;
+unsigned dumpStates = 0, dumpPTree = 0;
+
+void Executor::initTimers() {
   if (MaxTime) {
     addTimer(new HaltTimer(this), MaxTime.getValue());
   }
+
+  if (instructionSampler && SampleDumpInterval) {
+    addTimer(new SampleDumpTimer(this), SampleDumpInterval.getValue());
+  }
+
+  if (ParkedStateTTL) {
+    addTimer(new ParkedStateTimer(this), ParkedStateTTL.getValue());
+  }
 }
 
 ///
@@ -105,19 +122,30 @@ Executor::Timer::~Timer() {}
 
 void Executor::addTimer(Timer *timer, double rate) {
   timers.push_back(new TimerInfo(timer, rate));
+  std::push_heap(timers.begin(), timers.end(), TimerInfo::Later());
 }
 
-void Executor::processTimers(ExecutionState *current,
-                             double maxInstTime) {
-  static unsigned callsWithoutCheck = 0;
-  unsigned ticks = timerTicks;
+void Executor::processTimers(ExecutionState *current, double maxInstTime,
+                             double startTime) {
+  double now = util::getMonotonicTime();
+
+  if (maxInstTime > 0 && current && now - startTime > maxInstTime &&
+      std::find(removedStates.begin(), removedStates.end(), current) ==
+          removedStates.end()) {
+    klee_warning("max-instruction-time exceeded: %.2fs", now - startTime);
+    terminateStateEarly(*current, "max-instruction-time exceeded");
+  }
 
-  if (!ticks && ++callsWithoutCheck > 1000) {
-    setupHandler();
-    ticks = 1;
+  // only the earliest deadline is compared on the common path
+  while (!timers.empty() && now >= timers.front()->nextFireTime) {
+    std::pop_heap(timers.begin(), timers.end(), TimerInfo::Later());
+    TimerInfo *ti = timers.back();
+    ti->timer->run();
+    ti->nextFireTime = now + ti->rate;
+    std::push_heap(timers.begin(), timers.end(), TimerInfo::Later());
   }
 
-  if (ticks || dumpPTree || dumpStates) {
+  if (dumpPTree || dumpStates) {
     if (dumpPTree && processTree->changed) {
       llvm::raw_ostream *os = interpreterHandler->openOutputFile("ptree.dot");
       if (os) {
@@ -150,6 +178,7 @@ void Executor::processTimers(ExecutionState *current,
           }
           *os << "], ";
 
+          updateMinDistToUncovered(*es);
           StackFrame &sf = es->stack.back();
           uint64_t md2u = computeMinDistToUncovered(es->pc,
                                                     sf.minDistToUncoveredOnReturn);
@@ -175,33 +204,6 @@ void Executor::processTimers(ExecutionState *current,
 
       dumpStates = 0;
     }
-
-    if (maxInstTime > 0 && current &&
-        std::find(removedStates.begin(), removedStates.end(), current) ==
-            removedStates.end()) {
-      if (timerTicks*kSecondsPerTick > maxInstTime) {
-        klee_warning("max-instruction-time exceeded: %.2fs",
-                     timerTicks*kSecondsPerTick);
-        terminateStateEarly(*current, "max-instruction-time exceeded");
-      }
-    }
-
-    if (!timers.empty()) {
-      double time = util::getWallTime();
-
-      for (std::vector<TimerInfo*>::iterator it = timers.begin(), 
-             ie = timers.end(); it != ie; ++it) {
-        TimerInfo *ti = *it;
-        
-        if (time >= ti->nextFireTime) {
-          ti->timer->run();
-          ti->nextFireTime = time + ti->rate;
-        }
-      }
-    }
-
-    timerTicks = 0;
-    callsWithoutCheck = 0;
   }
 }
 
@@ -27,6 +27,7 @@
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 0)
 #include "llvm/Target/TargetSelect.h"
@@ -36,8 +37,10 @@
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/InstIterator.h"
 #else
 #include "llvm/IR/CallSite.h"
+#include "llvm/IR/InstIterator.h"
 #endif
 
 #include <setjmp.h>
@@ -101,6 +104,10 @@ ExternalDispatcher::ExternalDispatcher() {
 
   // from ExecutionEngine::create
   if (executionEngine) {
+    // the internal functions of a native call are compiled before it, the
+    // compiler must not run while it has memory protected
+    executionEngine->DisableLazyCompilation(true);
+
     // Make sure we can resolve symbols in the program as well. The zero arg
     // to the function tells DynamicLibrary to load the program, not a library.
     sys::DynamicLibrary::LoadLibraryPermanently(0);
@@ -119,54 +126,190 @@ ExternalDispatcher::~ExternalDispatcher() {
   delete executionEngine;
 }
 
-bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args) {
+bool ExternalDispatcher::prepareCall(Function *f, Instruction *i) {
   dispatchers_ty::iterator it = dispatchers.find(i);
-  Function *dispatcher;
+  if (it != dispatchers.end())
+    return it->second.stub != 0;
 
-  if (it == dispatchers.end()) {
+  void *target = 0;
 #ifdef WINDOWS
-    std::map<std::string, void*>::iterator it2 = 
-      preboundFunctions.find(f->getName()));
-
-    if (it2 != preboundFunctions.end()) {
-      // only bind once
-      if (it2->second) {
-        executionEngine->addGlobalMapping(f, it2->second);
-        it2->second = 0;
-      }
-    }
+  std::map<std::string, void*>::iterator it2 = 
+    preboundFunctions.find(f->getName());
+  if (it2 != preboundFunctions.end())
+    target = it2->second;
 #endif
+  if (!target)
+    target = resolveSymbol(f->getName());
+
+  Dispatch dispatch;
+  if (target)
+    dispatch = Dispatch(getStub(f, i), target);
+  dispatchers[i] = dispatch;
+  return dispatch.stub != 0;
+}
+
+bool ExternalDispatcher::prepareNativeCall(Function *f, Instruction *i) {
+  dispatchers_ty::iterator it = dispatchers.find(i);
+  if (it != dispatchers.end())
+    return it->second.stub != 0;
 
-    dispatcher = createDispatcher(f,i);
+  Dispatch dispatch;
+  if (Function *clone = cloneInternal(f)) {
+    if (void *target = executionEngine->getPointerToFunction(clone))
+      dispatch = Dispatch(getStub(f, i), target);
+  }
+  dispatchers[i] = dispatch;
+  return dispatch.stub != 0;
+}
 
-    dispatchers.insert(std::make_pair(i, dispatcher));
+/// The globals v refers to, through constant expressions too.
+static void collectGlobals(Value *v, std::vector<GlobalVariable*> &globals) {
+  if (GlobalVariable *gv = dyn_cast<GlobalVariable>(v)) {
+    globals.push_back(gv);
+  } else if (isa<Constant>(v) && !isa<GlobalValue>(v)) {
+    Constant *c = cast<Constant>(v);
+    for (unsigned i = 0; i < c->getNumOperands(); i++)
+      collectGlobals(c->getOperand(i), globals);
+  }
+}
 
-    if (dispatcher) {
-      // Force the JIT execution engine to go ahead and build the function. This
-      // ensures that any errors or assertions in the compilation process will
-      // trigger crashes instead of being caught as aborts in the external
-      // function.
-      executionEngine->recompileAndRelinkFunction(dispatcher);
+/// Clone f and the internal functions it calls into the dispatch module, in
+/// which the globals they use are declarations bound to the addresses of
+/// the executor. Returns the clone of f, null if a global has no address.
+Function *ExternalDispatcher::cloneInternal(Function *f) {
+  std::map<const Value*, Value*>::iterator found = nativeValues.find(f);
+  if (found != nativeValues.end())
+    return cast<Function>(found->second);
+
+  std::vector<std::pair<Function*, Function*> > cloned;
+  std::vector<Function*> pending(1, f);
+  while (!pending.empty()) {
+    Function *g = pending.back();
+    pending.pop_back();
+    if (nativeValues.count(g))
+      continue;
+    Function *clone = Function::Create(g->getFunctionType(),
+                                       GlobalValue::InternalLinkage,
+                                       g->getName(), dispatchModule);
+    nativeValues[g] = clone;
+    cloned.push_back(std::make_pair(g, clone));
+
+    for (inst_iterator i = inst_begin(g), ie = inst_end(g); i != ie; ++i) {
+      std::vector<GlobalVariable*> globals;
+      for (unsigned op = 0; op < i->getNumOperands(); op++) {
+        Value *v = i->getOperand(op)->stripPointerCasts();
+        Function *callee = dyn_cast<Function>(v);
+        if (!callee) {
+          collectGlobals(i->getOperand(op), globals);
+        } else if (!callee->isDeclaration()) {
+          pending.push_back(callee);
+        } else if (!nativeValues.count(callee)) {
+          nativeValues[callee] = dispatchModule->getOrInsertFunction(
+              callee->getName(), callee->getFunctionType(),
+              callee->getAttributes());
+        }
+      }
+      for (unsigned j = 0; j < globals.size(); j++) {
+        GlobalVariable *gv = globals[j];
+        if (nativeValues.count(gv))
+          continue;
+        std::map<const GlobalValue*, uint64_t>::iterator address =
+          globalAddresses.find(gv);
+        if (address == globalAddresses.end()) {
+          for (unsigned k = 0; k < cloned.size(); k++) {
+            nativeValues.erase(cloned[k].first);
+            cloned[k].second->eraseFromParent();
+          }
+          return 0;
+        }
+        GlobalVariable *decl =
+          new GlobalVariable(*dispatchModule, gv->getType()->getElementType(),
+                             gv->isConstant(), GlobalValue::ExternalLinkage,
+                             0, gv->getName());
+        executionEngine->addGlobalMapping(decl,
+                                          (void*) (uintptr_t) address->second);
+        nativeValues[gv] = decl;
+      }
     }
-  } else {
-    dispatcher = it->second;
   }
 
-  return runProtectedCall(dispatcher, args);
+  ValueToValueMapTy vmap;
+  for (std::map<const Value*, Value*>::iterator it = nativeValues.begin(),
+       ie = nativeValues.end(); it != ie; ++it)
+    vmap[it->first] = it->second;
+  for (unsigned i = 0; i < cloned.size(); i++) {
+    Function *g = cloned[i].first, *clone = cloned[i].second;
+    Function::arg_iterator arg = clone->arg_begin();
+    for (Function::arg_iterator ai = g->arg_begin(), ae = g->arg_end();
+         ai != ae; ++ai, ++arg)
+      vmap[ai] = arg;
+    SmallVector<ReturnInst*, 8> returns;
+    CloneFunctionInto(clone, g, vmap, true, returns);
+  }
+  return cast<Function>(nativeValues[f]);
+}
+
+bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args) {
+  dispatchers_ty::iterator it = dispatchers.find(i);
+  if (it == dispatchers.end()) {
+    prepareCall(f, i);
+    it = dispatchers.find(i);
+  }
+
+  return runProtectedCall(it->second, args);
+}
+
+ExternalDispatcher::Stub ExternalDispatcher::getStub(Function *f,
+                                                     Instruction *inst) {
+  CallSite cs(inst);
+  LLVM_TYPE_Q FunctionType *FTy =
+    cast<FunctionType>(cast<PointerType>(f->getType())->getElementType());
+
+  // The arguments are passed with the types of the parameters and, past
+  // them, with the types of the call site, see createDispatcher.
+  std::vector<LLVM_TYPE_Q Type*> argTys;
+  unsigned i = 0;
+  for (CallSite::arg_iterator ai = cs.arg_begin(), ae = cs.arg_end();
+       ai!=ae; ++ai, ++i)
+    argTys.push_back(i < FTy->getNumParams() ? FTy->getParamType(i) :
+                     (*ai)->getType());
+  signature_ty signature(FTy, FunctionType::get(FTy->getReturnType(),
+                                                argTys, false));
+
+  std::vector<StubInfo> &candidates = stubs[signature];
+  for (unsigned j = 0; j < candidates.size(); j++) {
+    Function *prototype = candidates[j].prototype;
+    if (prototype->getAttributes() == f->getAttributes() &&
+        prototype->getCallingConv() == f->getCallingConv())
+      return candidates[j].stub;
+  }
+
+  Function *dispatcher = createDispatcher(f, inst);
+  // Force the JIT execution engine to go ahead and build the function. This
+  // ensures that any errors or assertions in the compilation process will
+  // trigger crashes instead of being caught as aborts in the external
+  // function.
+  StubInfo info;
+  info.prototype = f;
+  info.stub = (Stub) executionEngine->getPointerToFunction(dispatcher);
+  candidates.push_back(info);
+  return info.stub;
 }
 
 // FIXME: This is not reentrant.
 static uint64_t *gTheArgsP;
+static void *gTheTargetP;
 
-bool ExternalDispatcher::runProtectedCall(Function *f, uint64_t *args) {
+bool ExternalDispatcher::runProtectedCall(const Dispatch &dispatch,
+                                          uint64_t *args) {
   struct sigaction segvAction, segvActionOld;
   bool res;
   
-  if (!f)
+  if (!dispatch.stub)
     return false;
 
-  std::vector<GenericValue> gvArgs;
   gTheArgsP = args;
+  gTheTargetP = dispatch.target;
 
   segvAction.sa_handler = 0;
   memset(&segvAction.sa_mask, 0, sizeof(segvAction.sa_mask));
@@ -177,7 +320,7 @@ bool ExternalDispatcher::runProtectedCall(Function *f, uint64_t *args) {
   if (setjmp(escapeCallJmpBuf)) {
     res = false;
   } else {
-    executionEngine->runFunction(f, gvArgs);
+    dispatch.stub();
     res = true;
   }
 
@@ -190,11 +333,9 @@ bool ExternalDispatcher::runProtectedCall(Function *f, uint64_t *args) {
 // this file. This is done so that the stub function prototype trivially matches
 // the special cases that the JIT knows how to directly call. If this is not
 // done, then the jit will end up generating a nullary stub just to call our
-// stub, for every single function call.
+// stub, for every single function call. The target is passed the same way
+// through gTheTargetP, so that calls with the same signature share a stub.
 Function *ExternalDispatcher::createDispatcher(Function *target, Instruction *inst) {
-  if (!resolveSymbol(target->getName()))
-    return 0;
-
   CallSite cs;
   if (inst->getOpcode()==Instruction::Call) {
     cs = CallSite(cast<CallInst>(inst));
@@ -250,16 +391,21 @@ Function *ExternalDispatcher::createDispatcher(Function *target, Instruction *in
     idx += ((!!argSize ? argSize : 64) + 63)/64;
   }
 
-  Constant *dispatchTarget =
-    dispatchModule->getOrInsertFunction(target->getName(), FTy,
-                                        target->getAttributes());
+  Instruction *targetpp =
+    new IntToPtrInst(ConstantInt::get(Type::getInt64Ty(getGlobalContext()),
+                                      (uintptr_t) (void*) &gTheTargetP),
+                     PointerType::getUnqual(PointerType::getUnqual(FTy)),
+                     "targetp", dBB);
+  Instruction *dispatchTarget = new LoadInst(targetpp, "target", dBB);
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
-  Instruction *result = CallInst::Create(dispatchTarget,
-                                         llvm::ArrayRef<Value *>(args, args+i),
-                                         "", dBB);
+  CallInst *result = CallInst::Create(dispatchTarget,
+                                      llvm::ArrayRef<Value *>(args, args+i),
+                                      "", dBB);
 #else
-  Instruction *result = CallInst::Create(dispatchTarget, args, args+i, "", dBB);
+  CallInst *result = CallInst::Create(dispatchTarget, args, args+i, "", dBB);
 #endif
+  result->setAttributes(target->getAttributes());
+  result->setCallingConv(target->getCallingConv());
   if (result->getType() != Type::getVoidTy(getGlobalContext())) {
     Instruction *resp = 
       new BitCastInst(argI64s, PointerType::getUnqual(result->getType()), 
@@ -10,12 +10,16 @@
 #ifndef KLEE_EXTERNALDISPATCHER_H
 #define KLEE_EXTERNALDISPATCHER_H
 
+#include "llvm/ADT/DenseMap.h"
+
 #include <map>
 #include <string>
+#include <vector>
 #include <stdint.h>
 
 namespace llvm {
   class ExecutionEngine;
+  class GlobalValue;
   class Instruction;
   class Function;
   class FunctionType;
@@ -25,19 +29,68 @@ namespace llvm {
 namespace klee {
   class ExternalDispatcher {
   private:
-    typedef std::map<const llvm::Instruction*,llvm::Function*> dispatchers_ty;
+    typedef void (*Stub)();
+
+    /// A stub is compiled once for every signature a call site passes its
+    /// arguments with, and calls the target of the call through a pointer.
+    struct Dispatch {
+      Stub stub;
+      void *target;
+
+      Dispatch() : stub(0), target(0) {}
+      Dispatch(Stub _stub, void *_target) : stub(_stub), target(_target) {}
+    };
+
+    /// the declared type of the target and the types the arguments are
+    /// passed as
+    typedef std::pair<const llvm::FunctionType*,
+                      const llvm::FunctionType*> signature_ty;
+    struct StubInfo {
+      /// the first target of the stub, whose attributes the stub calls with
+      llvm::Function *prototype;
+      Stub stub;
+    };
+    typedef std::map<signature_ty, std::vector<StubInfo> > stubs_ty;
+    stubs_ty stubs;
+
+    typedef llvm::DenseMap<const llvm::Instruction*, Dispatch> dispatchers_ty;
     dispatchers_ty dispatchers;
     llvm::Module *dispatchModule;
     llvm::ExecutionEngine *executionEngine;
     std::map<std::string, void*> preboundFunctions;
+
+    /// the addresses the executor gave the globals of its module
+    std::map<const llvm::GlobalValue*, uint64_t> globalAddresses;
+    /// the clones and declarations in the dispatch module of the functions
+    /// and globals of the executor's module
+    std::map<const llvm::Value*, llvm::Value*> nativeValues;
     
+    Stub getStub(llvm::Function *f, llvm::Instruction *i);
+    llvm::Function *cloneInternal(llvm::Function *f);
     llvm::Function *createDispatcher(llvm::Function *f, llvm::Instruction *i);
-    bool runProtectedCall(llvm::Function *f, uint64_t *args);
+    bool runProtectedCall(const Dispatch &dispatch, uint64_t *args);
     
   public:
     ExternalDispatcher();
     ~ExternalDispatcher();
 
+    /// Compile the stub of the call of f at i ahead of its first execution.
+    /// Returns false if f cannot be resolved.
+    bool prepareCall(llvm::Function *f, llvm::Instruction *i);
+
+    /// The address of a global of the executor's module, for the native
+    /// code of prepareNativeCall.
+    void setGlobalAddress(const llvm::GlobalValue *gv, uint64_t address) {
+      globalAddresses[gv] = address;
+    }
+
+    /// Compile the internal function f, and the functions it calls, to be
+    /// called natively at i by executeCall. The caller makes sure that
+    /// they only call intrinsics and other internal functions, and only
+    /// use globals whose address was set. Returns false if they cannot be
+    /// compiled.
+    bool prepareNativeCall(llvm::Function *f, llvm::Instruction *i);
+
     /* Call the given function using the parameter passing convention of
      * ci with arguments in args[1], args[2], ... and writing the result
      * into args[0].
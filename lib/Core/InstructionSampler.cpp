@@ -0,0 +1,125 @@
+//===-- InstructionSampler.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "InstructionSampler.h"
+
+#include "klee/Config/Version.h"
+#include "klee/ExecutionState.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/System/Time.h"
+
+#if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#else
+#include "llvm/BasicBlock.h"
+#include "llvm/Function.h"
+#include "llvm/Instruction.h"
+#endif
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+
+using namespace klee;
+using namespace llvm;
+
+template <typename T>
+static bool moreSampled(const std::pair<T, uint64_t> &a,
+                        const std::pair<T, uint64_t> &b) {
+  return a.second > b.second;
+}
+
+static const Function *getFunction(const KInstruction *ki) {
+  const Instruction *inst = ki->isCloned ? ki->origInst : ki->inst;
+  return inst->getParent()->getParent();
+}
+
+InstructionSampler::InstructionSampler(unsigned _period,
+                                       unsigned numInstructions,
+                                       bool _sampleStacks)
+  : period(_period), countdown(_period), samples(numInstructions, 0),
+    instructions(numInstructions, 0), sampleStacks(_sampleStacks),
+    lastSample(util::getMonotonicTime()) {
+  assert(period && "sampling period must be positive");
+}
+
+void InstructionSampler::sample(const ExecutionState &state) {
+  countdown = period;
+  const KInstruction *ki = state.pc;
+  unsigned id = ki->info->id;
+  if (id >= samples.size()) {
+    samples.resize(id + 1, 0);
+    instructions.resize(id + 1, 0);
+  }
+  samples[id]++;
+  instructions[id] = ki;
+
+  if (!sampleStacks)
+    return;
+  double now = util::getMonotonicTime();
+  std::vector<const Function *> stack;
+  stack.reserve(state.stack.size());
+  for (unsigned i = 0; i < state.stack.size(); i++)
+    stack.push_back(state.stack[i].kf->function);
+  stacks[stack] += (uint64_t) ((now - lastSample) * 1000000.);
+  lastSample = now;
+}
+
+void InstructionSampler::skipTime() {
+  lastSample = util::getMonotonicTime();
+}
+
+void InstructionSampler::writeOpcodes(raw_ostream &os) const {
+  std::map<unsigned, uint64_t> opcodes;
+  for (unsigned i = 0; i < samples.size(); i++)
+    if (samples[i])
+      opcodes[instructions[i]->opcode] += samples[i];
+
+  std::vector< std::pair<unsigned, uint64_t> > sorted(opcodes.begin(),
+                                                      opcodes.end());
+  std::stable_sort(sorted.begin(), sorted.end(), moreSampled<unsigned>);
+
+  os << "opcode\tsamples\tinstructions\n";
+  for (unsigned i = 0; i < sorted.size(); i++)
+    os << Instruction::getOpcodeName(sorted[i].first) << "\t"
+       << sorted[i].second << "\t" << sorted[i].second * period << "\n";
+}
+
+void InstructionSampler::writeFunctions(raw_ostream &os) const {
+  std::map<const Function *, uint64_t> functions;
+  for (unsigned i = 0; i < samples.size(); i++)
+    if (samples[i])
+      functions[getFunction(instructions[i])] += samples[i];
+
+  std::vector< std::pair<const Function *, uint64_t> > sorted(
+      functions.begin(), functions.end());
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   moreSampled<const Function *>);
+
+  os << "function\tsamples\tinstructions\n";
+  for (unsigned i = 0; i < sorted.size(); i++)
+    os << sorted[i].first->getName() << "\t" << sorted[i].second << "\t"
+       << sorted[i].second * period << "\n";
+}
+
+void InstructionSampler::writeStacks(raw_ostream &os) const {
+  for (std::map<std::vector<const Function *>, uint64_t>::const_iterator
+           it = stacks.begin(), ie = stacks.end(); it != ie; ++it) {
+    if (!it->second)
+      continue;
+    for (unsigned i = 0; i < it->first.size(); i++)
+      os << (i ? ";" : "") << it->first[i]->getName();
+    os << " " << it->second << "\n";
+  }
+}
@@ -0,0 +1,78 @@
+//===-- InstructionSampler.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_INSTRUCTIONSAMPLER_H
+#define KLEE_INSTRUCTIONSAMPLER_H
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+namespace llvm {
+  class Function;
+  class raw_ostream;
+}
+
+namespace klee {
+  class ExecutionState;
+  struct KInstruction;
+
+  /// InstructionSampler - Counts every period-th executed instruction, as a
+  /// cheap profile of the opcodes and functions the interpreter spends its
+  /// instructions in.
+  ///
+  /// The samples are kept by instruction id, the opcodes and functions are
+  /// only summed up when the profile is written.
+  ///
+  /// With stacks, every sample also charges the wall time since the last
+  /// one to the interpreted call stack of the state, so the time of the
+  /// solver calls and of the other work in between goes to the functions
+  /// of the program that caused it.
+  class InstructionSampler {
+    unsigned period;
+    unsigned countdown;
+    std::vector<uint64_t> samples;
+    /// the instruction of every id sampled so far
+    std::vector<const KInstruction *> instructions;
+    bool sampleStacks;
+    double lastSample;
+    /// microseconds by call stack, outermost function first
+    std::map<std::vector<const llvm::Function *>, uint64_t> stacks;
+
+    void sample(const ExecutionState &state);
+
+  public:
+    /// numInstructions bounds the instruction ids.
+    InstructionSampler(unsigned period, unsigned numInstructions,
+                       bool sampleStacks = false);
+
+    /// Count the instruction the state is about to execute.
+    void step(const ExecutionState &state) {
+      if (--countdown == 0)
+        sample(state);
+    }
+
+    /// Charge the time since the last sample to no stack.
+    void skipTime();
+
+    /// Write the samples of every opcode, most sampled first, with the
+    /// instruction count they estimate.
+    void writeOpcodes(llvm::raw_ostream &os) const;
+
+    /// Write the samples of every function, most sampled first.
+    void writeFunctions(llvm::raw_ostream &os) const;
+
+    /// Write the time of every call stack in microseconds, in the collapsed
+    /// format of flamegraph.pl ("main;f;g 1234"), which sums up the lines
+    /// of several files.
+    void writeStacks(llvm::raw_ostream &os) const;
+  };
+}
+
+#endif
@@ -16,8 +16,10 @@
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/util/ArrayCache.h"
 
+#include "CoreStats.h"
 #include "ObjectHolder.h"
 #include "MemoryManager.h"
+#include "PayloadAllocator.h"
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include <llvm/IR/Function.h>
@@ -29,10 +31,13 @@
 #include <llvm/Value.h>
 #endif
 
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
+#include <new>
 #include <sstream>
 
 using namespace llvm;
@@ -42,6 +47,30 @@ namespace {
   cl::opt<bool>
   UseConstantArrays("use-constant-arrays",
                     cl::init(true));
+
+  cl::opt<bool>
+  LazySymbolicWrites("lazy-symbolic-writes",
+                     cl::init(false),
+                     cl::desc("Keep the writes at symbolic offsets apart "
+                              "from the update list of their object, which "
+                              "gets the concrete bytes only when a read at a "
+                              "symbolic offset needs them (default=false)"));
+}
+
+/// the writes the overlay of an object holds before it is flushed, so that
+/// the reads through it stay small
+static const unsigned MaxOverlayWrites = 32;
+
+/// the payload offsets keep the masks and known symbolics aligned
+static size_t alignPayload(size_t n) {
+  return (n + 7) & ~(size_t) 7;
+}
+
+namespace klee {
+  struct StoreChunk : util::MemoryAccounted<util::ObjectMemory> {
+    unsigned refCount;
+    uint8_t data[ObjectState::StoreChunkSize];
+  };
 }
 
 /***/
@@ -102,21 +131,27 @@ ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    payload(0),
+    payloadSize(0),
+    concreteStore(0),
+    chunks(0),
+    freshByte(0),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(0, 0),
+    pendingMask(0),
+    contentHash(0),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
+  allocatePayload(0);
   if (!UseConstantArrays) {
     static unsigned id = 0;
     const Array *array =
         getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), size);
     updates = UpdateList(array, 0);
   }
-  memset(concreteStore, 0, size);
 }
 
 
@@ -124,47 +159,97 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    payload(0),
+    payloadSize(0),
+    concreteStore(0),
+    chunks(0),
+    freshByte(0),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(array, 0),
+    pendingMask(0),
+    contentHash(0),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
+  allocatePayload(0);
   makeSymbolic();
-  memset(concreteStore, 0, size);
 }
 
 ObjectState::ObjectState(const ObjectState &os) 
   : copyOnWriteOwner(0),
     refCount(0),
     object(os.object),
-    concreteStore(new uint8_t[os.size]),
-    concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : 0),
-    flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
+    payload(0),
+    payloadSize(0),
+    concreteStore(0),
+    chunks(0),
+    freshByte(os.freshByte),
+    concreteMask(0),
+    flushMask(0),
     knownSymbolics(0),
     updates(os.updates),
+    overlay(os.overlay),
+    pendingMask(os.pendingMask ? new BitArray(*os.pendingMask, os.size) : 0),
+    contentHash(os.contentHash),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
   if (object)
     object->refCount++;
 
+  // A single allocation holds the contents, the masks and the known
+  // symbolics.
+  size_t maskSize = alignPayload(sizeof(BitArray)) +
+                    alignPayload(BitArray::getStorageSize(size));
+  size_t extra = 0;
+  if (os.concreteMask)
+    extra += maskSize;
+  if (os.flushMask)
+    extra += maskSize;
+  if (os.knownSymbolics)
+    extra += size * sizeof(ref<Expr>);
+  char *p = allocatePayload(extra);
+
+  // The chunks of large objects are shared until written.
+  size_t copied = payloadSize - extra;
+  if (concreteStore) {
+    memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
+  } else {
+    copied = 0;
+    for (unsigned i = 0, e = getNumChunks(); i != e; ++i)
+      if ((chunks[i] = os.chunks[i]))
+        ++chunks[i]->refCount;
+  }
+
+  if (os.concreteMask) {
+    concreteMask = new (p) BitArray(*os.concreteMask, size,
+        reinterpret_cast<uint32_t *>(p + alignPayload(sizeof(BitArray))));
+    p += maskSize;
+  }
+  if (os.flushMask) {
+    flushMask = new (p) BitArray(*os.flushMask, size,
+        reinterpret_cast<uint32_t *>(p + alignPayload(sizeof(BitArray))));
+    p += maskSize;
+  }
   if (os.knownSymbolics) {
-    knownSymbolics = new ref<Expr>[size];
+    knownSymbolics = reinterpret_cast<ref<Expr> *>(p);
     for (unsigned i=0; i<size; i++)
-      knownSymbolics[i] = os.knownSymbolics[i];
+      new (&knownSymbolics[i]) ref<Expr>(os.knownSymbolics[i]);
   }
 
-  memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
+  ++stats::copyOnWriteCopies;
+  stats::copyOnWriteBytes += copied + extra;
 }
 
 ObjectState::~ObjectState() {
-  if (concreteMask) delete concreteMask;
-  if (flushMask) delete flushMask;
-  if (knownSymbolics) delete[] knownSymbolics;
-  delete[] concreteStore;
+  freeMask(concreteMask);
+  freeMask(flushMask);
+  freeMask(pendingMask);
+  freeKnownSymbolics();
+  releaseChunks();
+  PayloadAllocator::deallocate(payload, payloadSize);
 
   if (object)
   {
@@ -177,6 +262,188 @@ ObjectState::~ObjectState() {
   }
 }
 
+bool ObjectState::isInPayload(const void *p) const {
+  const uint8_t *b = static_cast<const uint8_t *>(p);
+  return b >= payload && b < payload + payloadSize;
+}
+
+char *ObjectState::allocatePayload(size_t extra) {
+  size_t storeSize = size <= StoreChunkSize
+                         ? alignPayload(size)
+                         : getNumChunks() * sizeof(StoreChunk *);
+  payloadSize = storeSize + extra;
+  payload = static_cast<uint8_t *>(PayloadAllocator::allocate(payloadSize));
+  if (size <= StoreChunkSize) {
+    concreteStore = payload;
+    memset(concreteStore, 0, size);
+  } else {
+    chunks = reinterpret_cast<StoreChunk **>(payload);
+    memset(chunks, 0, storeSize);
+  }
+  return reinterpret_cast<char *>(payload) + storeSize;
+}
+
+void ObjectState::releaseChunks() {
+  if (!chunks)
+    return;
+  for (unsigned i = 0, e = getNumChunks(); i != e; ++i) {
+    if (chunks[i] && --chunks[i]->refCount == 0)
+      delete chunks[i];
+    chunks[i] = 0;
+  }
+}
+
+/// Get a chunk to write, copying it first if it is shared.
+uint8_t *ObjectState::getWritableChunk(unsigned index) {
+  StoreChunk *&chunk = chunks[index];
+  if (!chunk) {
+    chunk = new StoreChunk;
+    chunk->refCount = 1;
+    memset(chunk->data, freshByte, StoreChunkSize);
+  } else if (chunk->refCount > 1) {
+    StoreChunk *copy = new StoreChunk(*chunk);
+    copy->refCount = 1;
+    --chunk->refCount;
+    chunk = copy;
+    stats::copyOnWriteBytes += StoreChunkSize;
+  }
+  return chunk->data;
+}
+
+uint8_t ObjectState::getConcreteByte(unsigned offset) const {
+  if (concreteStore)
+    return concreteStore[offset];
+  const StoreChunk *chunk = chunks[offset / StoreChunkSize];
+  return chunk ? chunk->data[offset % StoreChunkSize] : freshByte;
+}
+
+uint8_t *ObjectState::getWritableByte(unsigned offset) {
+  if (concreteStore)
+    return concreteStore + offset;
+  return getWritableChunk(offset / StoreChunkSize) + offset % StoreChunkSize;
+}
+
+void ObjectState::readStore(unsigned offset, void *dst, unsigned n) const {
+  uint8_t *out = static_cast<uint8_t *>(dst);
+  if (concreteStore) {
+    memcpy(out, concreteStore + offset, n);
+    return;
+  }
+  while (n) {
+    unsigned at = offset % StoreChunkSize;
+    unsigned len = std::min(n, StoreChunkSize - at);
+    const StoreChunk *chunk = chunks[offset / StoreChunkSize];
+    if (chunk)
+      memcpy(out, chunk->data + at, len);
+    else
+      memset(out, freshByte, len);
+    out += len;
+    offset += len;
+    n -= len;
+  }
+}
+
+/// Whether the n bytes at data are all value.
+static bool isFilled(const uint8_t *data, unsigned n, uint8_t value) {
+  for (unsigned i = 0; i != n; ++i)
+    if (data[i] != value)
+      return false;
+  return true;
+}
+
+void ObjectState::writeStore(unsigned offset, const void *src, unsigned n) {
+  contentHash = 0;
+  const uint8_t *in = static_cast<const uint8_t *>(src);
+  if (concreteStore) {
+    memcpy(concreteStore + offset, in, n);
+    return;
+  }
+  while (n) {
+    unsigned index = offset / StoreChunkSize;
+    unsigned at = offset % StoreChunkSize;
+    unsigned len = std::min(n, StoreChunkSize - at);
+    const StoreChunk *chunk = chunks[index];
+    if (chunk ? memcmp(chunk->data + at, in, len) != 0
+              : !isFilled(in, len, freshByte))
+      memcpy(getWritableChunk(index) + at, in, len);
+    in += len;
+    offset += len;
+    n -= len;
+  }
+}
+
+bool ObjectState::storeEquals(const void *src) const {
+  const uint8_t *in = static_cast<const uint8_t *>(src);
+  if (concreteStore)
+    return memcmp(concreteStore, in, size) == 0;
+  for (unsigned offset = 0; offset < size; offset += StoreChunkSize) {
+    unsigned len = std::min(size - offset, (unsigned) StoreChunkSize);
+    const StoreChunk *chunk = chunks[offset / StoreChunkSize];
+    if (chunk ? memcmp(chunk->data, in + offset, len) != 0
+              : !isFilled(in + offset, len, freshByte))
+      return false;
+  }
+  return true;
+}
+
+void ObjectState::fillStore(uint8_t value) {
+  if (concreteStore) {
+    memset(concreteStore, value, size);
+    return;
+  }
+  // the chunks are only allocated when written
+  releaseChunks();
+  freshByte = value;
+}
+
+/// Free a mask, which lives in the payload of copies, or else on the heap.
+void ObjectState::freeMask(BitArray *mask) const {
+  if (!mask)
+    return;
+  if (isInPayload(mask))
+    mask->~BitArray();
+  else
+    delete mask;
+}
+
+void ObjectState::freeKnownSymbolics() {
+  if (!knownSymbolics)
+    return;
+  if (isInPayload(knownSymbolics)) {
+    for (unsigned i=0; i<size; i++)
+      knownSymbolics[i].~ref();
+  } else {
+    delete[] knownSymbolics;
+  }
+  knownSymbolics = 0;
+}
+
+/***/
+
+/// Load the n <= 8 bytes at store in the byte order of the target. The loops
+/// are the byte-order idioms the compiler turns into single loads.
+static uint64_t loadConcrete(const uint8_t *store, unsigned n) {
+  uint64_t value = 0;
+  if (Context::get().isLittleEndian()) {
+    for (unsigned i = 0; i != n; ++i)
+      value |= (uint64_t) store[i] << (8 * i);
+  } else {
+    for (unsigned i = 0; i != n; ++i)
+      value = (value << 8) | store[i];
+  }
+  return value;
+}
+
+static void storeConcrete(uint8_t *store, uint64_t value, unsigned n) {
+  if (Context::get().isLittleEndian()) {
+    for (unsigned i = 0; i != n; ++i)
+      store[i] = (uint8_t) (value >> (8 * i));
+  } else {
+    for (unsigned i = 0; i != n; ++i)
+      store[n - i - 1] = (uint8_t) (value >> (8 * i));
+  }
+}
+
 ArrayCache *ObjectState::getArrayCache() const {
   assert(object && "object was NULL");
   return object->parent->getArrayCache();
@@ -236,12 +503,14 @@ const UpdateList &ObjectState::getUpdates() const {
 }
 
 void ObjectState::makeConcrete() {
-  if (concreteMask) delete concreteMask;
-  if (flushMask) delete flushMask;
-  if (knownSymbolics) delete[] knownSymbolics;
+  freeMask(concreteMask);
+  freeMask(flushMask);
+  freeMask(pendingMask);
+  freeKnownSymbolics();
   concreteMask = 0;
   flushMask = 0;
-  knownSymbolics = 0;
+  pendingMask = 0;
+  overlay.clear();
 }
 
 void ObjectState::makeSymbolic() {
@@ -257,16 +526,16 @@ void ObjectState::makeSymbolic() {
 }
 
 void ObjectState::initializeToZero() {
+  contentHash = 0;
   makeConcrete();
-  memset(concreteStore, 0, size);
+  fillStore(0);
 }
 
 void ObjectState::initializeToRandom() {  
+  contentHash = 0;
   makeConcrete();
-  for (unsigned i=0; i<size; i++) {
-    // randomly selected by 256 sided die
-    concreteStore[i] = 0xAB;
-  }
+  // randomly selected by 256 sided die
+  fillStore(0xAB);
 }
 
 /*
@@ -292,7 +561,7 @@ void ObjectState::flushRangeForRead(unsigned rangeBase,
     if (!isByteFlushed(offset)) {
       if (isByteConcrete(offset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
+                       ConstantExpr::create(getConcreteByte(offset), Expr::Int8));
       } else {
         assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
@@ -312,7 +581,7 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
     if (!isByteFlushed(offset)) {
       if (isByteConcrete(offset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
+                       ConstantExpr::create(getConcreteByte(offset), Expr::Int8));
         markByteSymbolic(offset);
       } else {
         assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
@@ -334,10 +603,93 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
   } 
 }
 
+void ObjectState::writeToOverlay(ref<Expr> offset, ref<Expr> value) {
+  // the bytes written at constant offsets since the overlay began go
+  // between it and this write
+  if (!overlay.empty() && (!flushMask || !flushMask->isAllUnset(0, size)))
+    flushOverlay();
+
+  if (overlay.empty()) {
+    // as flushRangeForWrite, but the unflushed bytes are only marked
+    if (!flushMask) flushMask = new BitArray(size, true);
+    for (unsigned i = 0; i < size; i++) {
+      if (!isByteFlushed(i)) {
+        if (!pendingMask)
+          pendingMask = new BitArray(size, false);
+        pendingMask->set(i);
+        flushMask->unset(i);
+        markByteSymbolic(i);
+      } else if (isByteConcrete(i)) {
+        markByteSymbolic(i);
+      } else if (isByteKnownSymbolic(i)) {
+        setKnownSymbolic(i, 0);
+      }
+    }
+  }
+
+  overlay.push_back(std::make_pair(offset, value));
+  if (overlay.size() >= MaxOverlayWrites)
+    flushOverlay();
+}
+
+void ObjectState::flushOverlay() const {
+  if (overlay.empty())
+    return;
+
+  if (pendingMask) {
+    for (unsigned i = 0; i < size; i++) {
+      if (!pendingMask->get(i))
+        continue;
+      if (isByteKnownSymbolic(i)) {
+        updates.extend(ConstantExpr::create(i, Expr::Int32), knownSymbolics[i]);
+        knownSymbolics[i] = 0;
+      } else {
+        updates.extend(ConstantExpr::create(i, Expr::Int32),
+                       ConstantExpr::create(getConcreteByte(i), Expr::Int8));
+      }
+    }
+    freeMask(pendingMask);
+    pendingMask = 0;
+  }
+  for (unsigned i = 0; i < overlay.size(); i++)
+    updates.extend(overlay[i].first, overlay[i].second);
+  overlay.clear();
+}
+
+ref<Expr> ObjectState::readThroughOverlay(unsigned offset) const {
+  ref<Expr> result;
+  if (!isBytePending(offset))
+    result = ReadExpr::create(getUpdates(),
+                              ConstantExpr::create(offset, Expr::Int32));
+  else if (isByteKnownSymbolic(offset))
+    result = knownSymbolics[offset];
+  else
+    result = ConstantExpr::create(getConcreteByte(offset), Expr::Int8);
+
+  ref<Expr> index = ConstantExpr::create(offset, Expr::Int32);
+  for (unsigned i = 0; i < overlay.size(); i++)
+    result = SelectExpr::create(EqExpr::create(overlay[i].first, index),
+                                overlay[i].second, result);
+  return result;
+}
+
+bool ObjectState::isBytePending(unsigned offset) const {
+  return pendingMask && pendingMask->get(offset);
+}
+
+void ObjectState::clearPending(unsigned offset, unsigned n) {
+  if (pendingMask)
+    pendingMask->unsetRange(offset, offset + n);
+}
+
 bool ObjectState::isByteConcrete(unsigned offset) const {
   return !concreteMask || concreteMask->get(offset);
 }
 
+bool ObjectState::isRangeConcrete(unsigned offset, unsigned n) const {
+  return !concreteMask || concreteMask->isAllSet(offset, offset + n);
+}
+
 bool ObjectState::isByteFlushed(unsigned offset) const {
   return flushMask && !flushMask->get(offset);
 }
@@ -386,12 +738,14 @@ void ObjectState::setKnownSymbolic(unsigned offset,
 
 ref<Expr> ObjectState::read8(unsigned offset) const {
   if (isByteConcrete(offset)) {
-    return ConstantExpr::create(concreteStore[offset], Expr::Int8);
-  } else if (isByteKnownSymbolic(offset)) {
+    return ConstantExpr::create(getConcreteByte(offset), Expr::Int8);
+  } else if (isByteKnownSymbolic(offset) && !isBytePending(offset)) {
     return knownSymbolics[offset];
   } else {
     assert(isByteFlushed(offset) && "unflushed byte without cache value");
-    
+
+    if (!overlay.empty())
+      return readThroughOverlay(offset);
     return ReadExpr::create(getUpdates(), 
                             ConstantExpr::create(offset, Expr::Int32));
   }    
@@ -399,6 +753,7 @@ ref<Expr> ObjectState::read8(unsigned offset) const {
 
 ref<Expr> ObjectState::read8(ref<Expr> offset) const {
   assert(!isa<ConstantExpr>(offset) && "constant offset passed to symbolic read8");
+  flushOverlay();
   unsigned base, size;
   fastRangeCheckOffset(offset, &base, &size);
   flushRangeForRead(base, size);
@@ -414,13 +769,36 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
   return ReadExpr::create(getUpdates(), ZExtExpr::create(offset, Expr::Int32));
 }
 
+void ObjectState::writeConcrete(unsigned offset, uint64_t value,
+                                unsigned n) {
+  contentHash = 0;
+  if (concreteStore) {
+    storeConcrete(concreteStore + offset, value, n);
+  } else {
+    uint8_t bytes[8];
+    storeConcrete(bytes, value, n);
+    writeStore(offset, bytes, n);
+  }
+  if (knownSymbolics)
+    for (unsigned i = 0; i != n; ++i)
+      knownSymbolics[offset + i] = 0;
+
+  if (concreteMask)
+    concreteMask->setRange(offset, offset + n);
+  if (flushMask)
+    flushMask->setRange(offset, offset + n);
+  clearPending(offset, n);
+}
+
 void ObjectState::write8(unsigned offset, uint8_t value) {
+  contentHash = 0;
   //assert(read_only == false && "writing to read-only object!");
-  concreteStore[offset] = value;
+  *getWritableByte(offset) = value;
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
   markByteUnflushed(offset);
+  clearPending(offset, 1);
 }
 
 void ObjectState::write8(unsigned offset, ref<Expr> value) {
@@ -432,11 +810,17 @@ void ObjectState::write8(unsigned offset, ref<Expr> value) {
       
     markByteSymbolic(offset);
     markByteUnflushed(offset);
+    clearPending(offset, 1);
   }
 }
 
 void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
   assert(!isa<ConstantExpr>(offset) && "constant offset passed to symbolic write8");
+  if (LazySymbolicWrites) {
+    writeToOverlay(ZExtExpr::create(offset, Expr::Int32), value);
+    return;
+  }
+
   unsigned base, size;
   fastRangeCheckOffset(offset, &base, &size);
   flushRangeForWrite(base, size);
@@ -486,9 +870,19 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // Read concrete bytes at once rather than folding an expression per byte.
+  if (width <= 64 && isRangeConcrete(offset, NumBytes)) {
+    uint8_t bytes[8];
+    const uint8_t *store = concreteStore ? concreteStore + offset : bytes;
+    if (!concreteStore)
+      readStore(offset, bytes, NumBytes);
+    return ConstantExpr::create(loadConcrete(store, NumBytes), width);
+  }
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -500,6 +894,7 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
 }
 
 void ObjectState::write(ref<Expr> offset, ref<Expr> value) {
+  contentHash = 0;
   // Truncate offset to 32-bits.
   offset = ZExtExpr::create(offset, Expr::Int32);
 
@@ -527,6 +922,7 @@ void ObjectState::write(ref<Expr> offset, ref<Expr> value) {
 }
 
 void ObjectState::write(unsigned offset, ref<Expr> value) {
+  contentHash = 0;
   // Check for writes of constant values.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     Expr::Width w = CE->getWidth();
@@ -559,28 +955,117 @@ void ObjectState::write(unsigned offset, ref<Expr> value) {
   }
 } 
 
-void ObjectState::write16(unsigned offset, uint16_t value) {
-  unsigned NumBytes = 2;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+void ObjectState::copyFrom(unsigned offset, const ObjectState &src,
+                           unsigned srcOffset, unsigned n) {
+  contentHash = 0;
+  uint8_t buffer[StoreChunkSize];
+  while (n) {
+    bool concrete = src.isByteConcrete(srcOffset);
+    unsigned len = 1;
+    while (len < n && len < (unsigned) StoreChunkSize &&
+           src.isByteConcrete(srcOffset + len) == concrete)
+      ++len;
+
+    if (concrete) {
+      src.readStore(srcOffset, buffer, len);
+      writeStore(offset, buffer, len);
+      if (knownSymbolics)
+        for (unsigned i = 0; i != len; ++i)
+          knownSymbolics[offset + i] = 0;
+      if (concreteMask)
+        concreteMask->setRange(offset, offset + len);
+      if (flushMask)
+        flushMask->setRange(offset, offset + len);
+      clearPending(offset, len);
+    } else {
+      for (unsigned i = 0; i != len; ++i)
+        write8(offset + i, src.read8(srcOffset + i));
+    }
+    offset += len;
+    srcOffset += len;
+    n -= len;
   }
 }
 
-void ObjectState::write32(unsigned offset, uint32_t value) {
-  unsigned NumBytes = 4;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+void ObjectState::fill(unsigned offset, ref<Expr> value, unsigned n) {
+  contentHash = 0;
+  ConstantExpr *CE = dyn_cast<ConstantExpr>(value);
+  if (!CE) {
+    for (unsigned i = 0; i != n; ++i)
+      write8(offset + i, value);
+    return;
+  }
+
+  uint8_t buffer[StoreChunkSize];
+  memset(buffer, (uint8_t) CE->getZExtValue(8),
+         std::min(n, (unsigned) StoreChunkSize));
+  while (n) {
+    unsigned len = std::min(n, (unsigned) StoreChunkSize);
+    writeStore(offset, buffer, len);
+    if (knownSymbolics)
+      for (unsigned i = 0; i != len; ++i)
+        knownSymbolics[offset + i] = 0;
+    if (concreteMask)
+      concreteMask->setRange(offset, offset + len);
+    if (flushMask)
+      flushMask->setRange(offset, offset + len);
+    clearPending(offset, len);
+    offset += len;
+    n -= len;
   }
 }
 
+void ObjectState::write16(unsigned offset, uint16_t value) {
+  writeConcrete(offset, value, 2);
+}
+
+void ObjectState::write32(unsigned offset, uint32_t value) {
+  writeConcrete(offset, value, 4);
+}
+
 void ObjectState::write64(unsigned offset, uint64_t value) {
-  unsigned NumBytes = 8;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+  writeConcrete(offset, value, 8);
+}
+
+uint64_t ObjectState::getContentHash() const {
+  if (contentHash)
+    return contentHash;
+
+  llvm::hash_code h = llvm::hash_combine(size, freshByte);
+  if (concreteStore) {
+    h = llvm::hash_combine(h, llvm::hash_combine_range(concreteStore,
+                                                       concreteStore + size));
+  } else {
+    // chunks never written hash as nothing, like freshByte above
+    for (unsigned i = 0, e = getNumChunks(); i != e; ++i) {
+      const StoreChunk *chunk = chunks[i];
+      if (!chunk)
+        continue;
+      unsigned len = std::min(size - i * StoreChunkSize,
+                              (unsigned) StoreChunkSize);
+      h = llvm::hash_combine(h, i, llvm::hash_combine_range(chunk->data,
+                                                            chunk->data + len));
+    }
   }
+
+  if (concreteMask || updates.head || !overlay.empty() || pendingMask) {
+    // the symbolic bytes, as far as they can be told apart cheaply
+    h = llvm::hash_combine(h, updates.root ? updates.hash() : 0);
+    for (unsigned i = 0; i != size; ++i) {
+      if (isByteConcrete(i))
+        continue;
+      h = llvm::hash_combine(h, i,
+                             isByteKnownSymbolic(i) ? knownSymbolics[i]->hash()
+                                                    : 0,
+                             isByteFlushed(i), isBytePending(i));
+    }
+    for (unsigned i = 0; i != overlay.size(); ++i)
+      h = llvm::hash_combine(h, overlay[i].first->hash(),
+                             overlay[i].second->hash());
+  }
+
+  contentHash = h ? (uint64_t) h : 1;
+  return contentHash;
 }
 
 void ObjectState::print() {
@@ -12,6 +12,7 @@
 
 #include "Context.h"
 #include "klee/Expr.h"
+#include "klee/Internal/System/MemoryUsage.h"
 
 #include "llvm/ADT/StringExtras.h"
 
@@ -28,6 +29,7 @@ class BitArray;
 class MemoryManager;
 class Solver;
 class ArrayCache;
+struct StoreChunk;
 
 class MemoryObject {
   friend class STPBuilder;
@@ -136,7 +138,11 @@ public:
       return UltExpr::create(offset, getSizeExpr());
     }
   }
-  ref<Expr> getBoundsCheckOffset(ref<Expr> offset, unsigned bytes) const {
+  /// getBoundsCheckOffset of a constant offset, without building it.
+  bool isInBounds(uint64_t offset, unsigned bytes) const {
+    return bytes <= size && offset <= size - bytes;
+  }
+    ref<Expr> getBoundsCheckOffset(ref<Expr> offset, unsigned bytes) const {
     if (bytes<=size) {
       return UltExpr::create(offset, 
                              ConstantExpr::alloc(size - bytes + 1, 
@@ -147,7 +153,7 @@ public:
   }
 };
 
-class ObjectState {
+class ObjectState : public util::MemoryAccounted<util::ObjectMemory> {
 private:
   friend class AddressSpace;
   unsigned copyOnWriteOwner; // exclusively for AddressSpace
@@ -157,7 +163,18 @@ private:
 
   const MemoryObject *object;
 
+  /// the pooled allocation holding the contents, and for the copies of
+  /// objects also the masks and known symbolics of the original
+  uint8_t *payload;
+  size_t payloadSize;
+  /// the contents of objects of up to StoreChunkSize bytes, else null
   uint8_t *concreteStore;
+  /// the contents of larger objects, in chunks shared with the copies of
+  /// the object until either writes them; a null chunk was never written
+  /// and is all freshByte
+  StoreChunk **chunks;
+  /// the bytes the object was initialized to, 0 or the random pattern
+  uint8_t freshByte;
   // XXX cleanup name of flushMask (its backwards or something)
   BitArray *concreteMask;
 
@@ -169,11 +186,23 @@ private:
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// The writes at symbolic offsets not in updates yet, oldest first, and
+  /// the bytes whose values from before them are not in updates either.
+  /// The bytes of pendingMask are flushed and not concrete, their values
+  /// are still in the store or the known symbolics.
+  mutable std::vector<std::pair<ref<Expr>, ref<Expr> > > overlay;
+  mutable BitArray *pendingMask;
+
+  /// getContentHash() until the next write, 0 if not computed
+  mutable uint64_t contentHash;
+
 public:
   unsigned size;
 
   bool readOnly;
 
+  enum { StoreChunkSize = 4096 };
+
 public:
   /// Create a new object state for the given memory object with concrete
   /// contents. The initial contents are undefined, it is the callers
@@ -209,6 +238,20 @@ public:
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
 
+  /// Copy the n bytes at srcOffset of src to offset. Runs of concrete
+  /// bytes are copied between the stores as they are, only the symbolic
+  /// bytes are read and written one by one.
+  void copyFrom(unsigned offset, const ObjectState &src, unsigned srcOffset,
+                unsigned n);
+
+  /// Set the n bytes at offset to the byte value, concrete ones in bulk.
+  void fill(unsigned offset, ref<Expr> value, unsigned n);
+
+  /// A hash of the contents, cached until the next write. Equal hashes
+  /// suggest equal contents; objects with equal contents may still hash
+  /// differently when their symbolic bytes were written in another way.
+  uint64_t getContentHash() const;
+
 private:
   const UpdateList &getUpdates() const;
 
@@ -219,13 +262,48 @@ private:
   ref<Expr> read8(ref<Expr> offset) const;
   void write8(unsigned offset, ref<Expr> value);
   void write8(ref<Expr> offset, ref<Expr> value);
+  /// Write the n <= 8 low bytes of value, in the byte order of the target.
+  void writeConcrete(unsigned offset, uint64_t value, unsigned n);
 
   void fastRangeCheckOffset(ref<Expr> offset, unsigned *base_r, 
                             unsigned *size_r) const;
   void flushRangeForRead(unsigned rangeBase, unsigned rangeSize) const;
   void flushRangeForWrite(unsigned rangeBase, unsigned rangeSize);
 
+  /// Record a write at a symbolic offset in the overlay, which only the
+  /// next read at a symbolic offset flushes.
+  void writeToOverlay(ref<Expr> offset, ref<Expr> value);
+  /// Put the pending bytes and then the overlay into updates.
+  void flushOverlay() const;
+  /// The byte at offset, flushed or pending, with the overlay on top.
+  ref<Expr> readThroughOverlay(unsigned offset) const;
+  bool isBytePending(unsigned offset) const;
+  void clearPending(unsigned offset, unsigned n);
+
+  unsigned getNumChunks() const {
+    return (size + StoreChunkSize - 1) / StoreChunkSize;
+  }
+  /// Allocate the payload with extra bytes after the contents, which are
+  /// returned.
+  char *allocatePayload(size_t extra);
+  void releaseChunks();
+  uint8_t *getWritableChunk(unsigned index);
+
+  uint8_t getConcreteByte(unsigned offset) const;
+  uint8_t *getWritableByte(unsigned offset);
+  void readStore(unsigned offset, void *dst, unsigned n) const;
+  /// Write n bytes of the contents, leaving the chunks they already match
+  /// shared.
+  void writeStore(unsigned offset, const void *src, unsigned n);
+  bool storeEquals(const void *src) const;
+  void fillStore(uint8_t value);
+
+  bool isInPayload(const void *p) const;
+  void freeMask(BitArray *mask) const;
+  void freeKnownSymbolics();
+
   bool isByteConcrete(unsigned offset) const;
+  bool isRangeConcrete(unsigned offset, unsigned n) const;
   bool isByteFlushed(unsigned offset) const;
   bool isByteKnownSymbolic(unsigned offset) const;
 
@@ -18,6 +18,7 @@
 #include "llvm/Support/MathExtras.h"
 
 #include <inttypes.h>
+#include <mpi.h>
 #include <sys/mman.h>
 
 using namespace klee;
@@ -25,13 +26,15 @@ using namespace klee;
 namespace {
 llvm::cl::opt<bool> DeterministicAllocation(
     "allocate-determ",
-    llvm::cl::desc("Allocate memory deterministically(default=off)"),
+    llvm::cl::desc("Allocate memory deterministically (default=off, on in "
+                   "distributed runs)"),
     llvm::cl::init(false));
 
 llvm::cl::opt<unsigned> DeterministicAllocationSize(
     "allocate-determ-size",
-    llvm::cl::desc(
-        "Preallocated memory for deterministic allocation in MB (default=100)"),
+    llvm::cl::desc("Preallocated memory for deterministic allocation in MB, "
+                   "only reserved until used (default=100, 16384 in "
+                   "distributed runs)"),
     llvm::cl::init(100));
 
 llvm::cl::opt<bool>
@@ -54,16 +57,38 @@ llvm::cl::opt<unsigned long long> DeterministicStartAddress(
 }
 
 /***/
+
+/// Whether this process is one of several ranks, which replay the paths of
+/// each other and so need the same addresses.
+static bool isDistributedRun() {
+  int initialized = 0;
+  MPI_Initialized(&initialized);
+  if (!initialized)
+    return false;
+  int numCores = 1;
+  MPI_Comm_size(MPI_COMM_WORLD, &numCores);
+  return numCores > 1;
+}
+
 MemoryManager::MemoryManager(ArrayCache *_arrayCache)
     : arrayCache(_arrayCache), deterministicSpace(0), nextFreeSlot(0),
       spaceSize(DeterministicAllocationSize.getValue() * 1024 * 1024) {
-  if (DeterministicAllocation) {
+  bool deterministic = DeterministicAllocation;
+  if (!DeterministicAllocation.getNumOccurrences() && isDistributedRun()) {
+    deterministic = true;
+    if (!DeterministicAllocationSize.getNumOccurrences())
+      spaceSize = (size_t)16384 * 1024 * 1024;
+  }
+
+  if (deterministic) {
     // Page boundary
     void *expectedAddress = (void *)DeterministicStartAddress.getValue();
 
-    char *newSpace =
-        (char *)mmap(expectedAddress, spaceSize, PROT_READ | PROT_WRITE,
-                     MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    // The space is only reserved, pages are backed as they are touched.
+    char *newSpace = (char *)mmap(expectedAddress, spaceSize,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE,
+                                  -1, 0);
 
     if (newSpace == MAP_FAILED) {
       klee_error("Couldn't mmap() memory for deterministic allocations");
@@ -81,16 +106,39 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache)
 MemoryManager::~MemoryManager() {
   while (!objects.empty()) {
     MemoryObject *mo = *objects.begin();
-    if (!mo->isFixed && !DeterministicAllocation)
+    if (!mo->isFixed && !isDeterministic())
       free((void *)mo->address);
     objects.erase(mo);
     delete mo;
   }
 
-  if (DeterministicAllocation)
+  if (isDeterministic())
     munmap(deterministicSpace, spaceSize);
 }
 
+/// The deterministic space taken by an object of the given size, before its
+/// red zone. 0-sized objects take one byte, so they get their own red zones.
+static size_t getSlotSize(uint64_t size) {
+  return llvm::RoundUpToAlignment(std::max(size, (uint64_t)1), 16);
+}
+
+char *MemoryManager::takeFreeSlot(size_t slotSize, size_t alignment) {
+  std::map<size_t, std::vector<char *> >::iterator it =
+      freeSlots.find(slotSize);
+  if (it == freeSlots.end())
+    return 0;
+  // Take the most recently freed one which is aligned enough.
+  std::vector<char *> &slots = it->second;
+  for (size_t i = slots.size(); i-- > 0;) {
+    char *slot = slots[i];
+    if ((uint64_t)slot % alignment == 0) {
+      slots.erase(slots.begin() + i);
+      return slot;
+    }
+  }
+  return 0;
+}
+
 MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
                                       bool isGlobal,
                                       const llvm::Value *allocSite,
@@ -110,21 +158,24 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
   }
 
   uint64_t address = 0;
-  if (DeterministicAllocation) {
+  if (isDeterministic()) {
+    size_t slotSize = getSlotSize(size);
 
-    address = llvm::RoundUpToAlignment((uint64_t)nextFreeSlot + alignment - 1,
-                                       alignment);
-
-    // Handle the case of 0-sized allocations as 1-byte allocations.
-    // This way, we make sure we have this allocation between its own red zones
-    size_t alloc_size = std::max(size, (uint64_t)1);
-    if ((char *)address + alloc_size < deterministicSpace + spaceSize) {
-      nextFreeSlot = (char *)address + alloc_size + RedZoneSpace;
+    // Reuse the slots of freed objects of the same size class.
+    if (char *slot = takeFreeSlot(slotSize, alignment)) {
+      address = (uint64_t)slot;
+      ++stats::allocationsReused;
     } else {
-      klee_warning_once(0, "Couldn't allocate %" PRIu64
-                           " bytes. Not enough deterministic space left.",
-                        size);
-      address = 0;
+      address = llvm::RoundUpToAlignment(
+          (uint64_t)nextFreeSlot + alignment - 1, alignment);
+      if ((char *)address + slotSize < deterministicSpace + spaceSize) {
+        nextFreeSlot = (char *)address + slotSize + RedZoneSpace;
+      } else {
+        klee_warning_once(0, "Couldn't allocate %" PRIu64
+                             " bytes. Not enough deterministic space left.",
+                          size);
+        address = 0;
+      }
     }
   } else {
     // Use malloc for the standard case
@@ -167,12 +218,51 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t address, uint64_t size,
   return res;
 }
 
+MemoryObject *MemoryManager::allocateAt(uint64_t address, uint64_t size,
+                                        bool isLocal, bool isGlobal,
+                                        const llvm::Value *allocSite) {
+  if (!isDeterministic())
+    return 0;
+
+  size_t slotSize = getSlotSize(size);
+  if ((char *)address < deterministicSpace ||
+      (char *)address + slotSize >= deterministicSpace + spaceSize) {
+    klee_warning("Couldn't recreate object at 0x%" PRIx64
+                 ": outside of deterministic space.",
+                 address);
+    return 0;
+  }
+
+  // Keep the bump pointer past every recreated object, and drop the free
+  // slots it overlaps, so that fresh allocations never overlap with it.
+  if ((char *)address + slotSize + RedZoneSpace > nextFreeSlot)
+    nextFreeSlot = (char *)address + slotSize + RedZoneSpace;
+  for (std::map<size_t, std::vector<char *> >::iterator
+         it = freeSlots.begin(), ie = freeSlots.end(); it != ie; ++it) {
+    std::vector<char *> &slots = it->second;
+    for (size_t i = slots.size(); i-- > 0;)
+      if (slots[i] < (char *)address + slotSize &&
+          (char *)address < slots[i] + it->first)
+        slots.erase(slots.begin() + i);
+  }
+
+  ++stats::allocations;
+  MemoryObject *res = new MemoryObject(address, size, isLocal, isGlobal, false,
+                                       allocSite, this);
+  objects.insert(res);
+  return res;
+}
+
 void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
 void MemoryManager::markFreed(MemoryObject *mo) {
   if (objects.find(mo) != objects.end()) {
-    if (!mo->isFixed && !DeterministicAllocation)
-      free((void *)mo->address);
+    if (!mo->isFixed) {
+      if (!isDeterministic())
+        free((void *)mo->address);
+      else
+        freeSlots[getSlotSize(mo->size)].push_back((char *)mo->address);
+    }
     objects.erase(mo);
   }
 }
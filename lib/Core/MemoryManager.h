@@ -10,8 +10,10 @@
 #ifndef KLEE_MEMORYMANAGER_H
 #define KLEE_MEMORYMANAGER_H
 
+#include <map>
 #include <set>
 #include <stdint.h>
+#include <vector>
 
 namespace llvm {
 class Value;
@@ -30,6 +32,11 @@ private:
   char *deterministicSpace;
   char *nextFreeSlot;
   size_t spaceSize;
+  /// the slots of the freed deterministic objects by slot size, the most
+  /// recently freed last
+  std::map<size_t, std::vector<char *> > freeSlots;
+
+  char *takeFreeSlot(size_t slotSize, size_t alignment);
 
 public:
   MemoryManager(ArrayCache *arrayCache);
@@ -43,6 +50,13 @@ public:
                          const llvm::Value *allocSite, size_t alignment = 8);
   MemoryObject *allocateFixed(uint64_t address, uint64_t size,
                               const llvm::Value *allocSite);
+  /*
+   * Recreates an object at a given address inside the deterministic space,
+   * e.g. for a state that was allocated by another process. Later
+   * allocations are placed after it. Returns NULL if address is not usable.
+   */
+  MemoryObject *allocateAt(uint64_t address, uint64_t size, bool isLocal,
+                           bool isGlobal, const llvm::Value *allocSite);
   void deallocate(const MemoryObject *mo);
   void markFreed(MemoryObject *mo);
   ArrayCache *getArrayCache() const { return arrayCache; }
@@ -51,6 +65,8 @@ public:
    * Returns the size used by deterministic allocation in bytes
    */
   size_t getUsedDeterministicSize();
+
+  bool isDeterministic() const { return deterministicSpace != 0; }
 };
 
 } // End klee namespace
@@ -19,8 +19,9 @@ using namespace klee;
 
   /* *** */
 
-PTree::PTree(const data_type &_root)
-    : root(new Node(0, _root)), changed(false) {}
+PTree::PTree(const data_type &_root) : changed(false), numNodes(0) {
+  root = createNode(0, _root, 0);
+}
 
 PTree::~PTree() {}
 
@@ -29,8 +30,14 @@ PTree::split(Node *n,
              const data_type &leftData, 
              const data_type &rightData) {
   assert(n && !n->left && !n->right);
-  n->left = new Node(n, leftData);
-  n->right = new Node(n, rightData);
+  // the splits of recovery states are not forks of the path
+  bool fork = leftData && rightData && !leftData->isRecoveryState() &&
+              !rightData->isRecoveryState();
+  if (fork)
+    forkRates.recordFork(n->depth);
+  unsigned depth = fork ? n->depth + 1 : n->depth;
+  n->left = createNode(n, leftData, depth);
+  n->right = createNode(n, rightData, depth);
   changed = true;
   return std::make_pair(n->left, n->right);
 }
@@ -47,10 +54,57 @@ void PTree::remove(Node *n) {
         p->right = 0;
       }
     }
-    delete n;
+    destroyNode(n);
     n = p;
   } while (n && !n->left && !n->right);
+  if (n && (!n->left || !n->right))
+    collapse(n);
+  changed = true;
+}
+
+PTreeNode *PTree::attach(const data_type &data) {
   changed = true;
+  return createNode(0, data, data ? data->depth : 0);
+}
+
+PTreeNode *PTree::detach(Node *n) {
+  if (!n->parent)
+    return n;
+  ExecutionState *data = n->data;
+  unsigned depth = n->depth;
+  remove(n);
+  return createNode(0, data, depth);
+}
+
+PTreeNode *PTree::createNode(Node *parent, const data_type &data,
+                             unsigned depth) {
+  ++numNodes;
+  return new Node(parent, data, depth);
+}
+
+void PTree::destroyNode(Node *n) {
+  assert(numNodes > 0);
+  --numNodes;
+  delete n;
+}
+
+void PTree::collapse(Node *n) {
+  Node *c = n->left ? n->left : n->right;
+  assert(c && !n->data && (!n->left || !n->right));
+  if (c->pinned)
+    return;
+  n->left = c->left;
+  n->right = c->right;
+  if (n->left)
+    n->left->parent = n;
+  if (n->right)
+    n->right->parent = n;
+  n->data = c->data;
+  if (n->data)
+    n->data->ptreeNode = n;
+  n->condition = c->condition;
+  n->depth = c->depth;
+  destroyNode(c);
 }
 
 void PTree::dump(llvm::raw_ostream &os) {
@@ -106,12 +160,15 @@ void PTree::dump(llvm::raw_ostream &os) {
 }
 
 PTreeNode::PTreeNode(PTreeNode *_parent, 
-                     ExecutionState *_data) 
+                     ExecutionState *_data,
+                     unsigned _depth)
   : parent(_parent),
     left(0),
     right(0),
     data(_data),
-    condition(0) {
+    condition(0),
+    depth(_depth),
+    pinned(false) {
 }
 
 PTreeNode::~PTreeNode() {
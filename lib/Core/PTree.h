@@ -11,6 +11,8 @@
 #define __UTIL_PTREE_H__
 
 #include <klee/Expr.h>
+#include "klee/Internal/Support/SubtreeEstimator.h"
+#include "klee/Internal/System/MemoryUsage.h"
 
 namespace klee {
   class ExecutionState;
@@ -22,6 +24,9 @@ namespace klee {
     typedef class PTreeNode Node;
     Node *root;
     bool changed;
+    /// fork rates of the forks of normal states, the leaves are recorded by
+    /// the executor when paths end
+    SubtreeEstimator forkRates;
 
     PTree(const data_type &_root);
     ~PTree();
@@ -29,20 +34,48 @@ namespace klee {
     std::pair<Node*,Node*> split(Node *n,
                                  const data_type &leftData,
                                  const data_type &rightData);
+    /// Remove the leaf n and its ancestors which are left without
+    /// children. A parent left with a single child takes the place of
+    /// that child, so the tree has no chains of single child nodes.
     void remove(Node *n);
+    /// Create a parentless node for a state which was not forked in this
+    /// tree (e.g. one received from another worker). It is not reachable
+    /// from root.
+    Node *attach(const data_type &data);
+    /// Take the leaf n of a state which is parked outside the states (e.g.
+    /// offloaded to another worker) out of the tree and return a
+    /// parentless node for it, which keeps its depth.
+    Node *detach(Node *n);
+
+    /// The number of nodes and the memory they take.
+    size_t getNumNodes() const { return numNodes; }
+    size_t getMemoryUsage() const { return numNodes * sizeof(Node); }
 
     void dump(llvm::raw_ostream &os);
+
+  private:
+    size_t numNodes;
+
+    Node *createNode(Node *parent, const data_type &data, unsigned depth);
+    void destroyNode(Node *n);
+    /// Merge the only child of n into n.
+    void collapse(Node *n);
   };
 
-  class PTreeNode {
+  class PTreeNode : public util::MemoryAccounted<util::PTreeMemory> {
     friend class PTree;
   public:
     PTreeNode *parent, *left, *right;
     ExecutionState *data;
     ref<Expr> condition;
+    /// number of forks of normal states above the node
+    unsigned depth;
+    /// the node is referred to from outside the tree (e.g. by a searcher)
+    /// and is not merged away
+    bool pinned;
 
   private:
-    PTreeNode(PTreeNode *_parent, ExecutionState *_data);
+    PTreeNode(PTreeNode *_parent, ExecutionState *_data, unsigned _depth);
     ~PTreeNode();
   };
 }
@@ -0,0 +1,82 @@
+//===-- PayloadAllocator.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PayloadAllocator.h"
+
+#include "klee/Internal/System/MemoryUsage.h"
+
+#include <new>
+
+using namespace klee;
+
+/* classes of 16, 32, ..., 4096 bytes */
+static const unsigned minShift = 4;
+static const unsigned numClasses = 9;
+static const size_t slabSize = 64 * 1024;
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+static FreeBlock *freeLists[numClasses];
+static char *slabCursors[numClasses];
+static char *slabEnds[numClasses];
+static size_t slabBytes;
+
+/// the class of a size, numClasses if it is too large for the pool
+static unsigned getClass(size_t size) {
+  unsigned c = 0;
+  while (c < numClasses && ((size_t) 1 << (c + minShift)) < size)
+    c++;
+  return c;
+}
+
+/// the bytes a block of the size takes
+static size_t getBlockSize(size_t size) {
+  unsigned c = getClass(size);
+  return c == numClasses ? size : (size_t) 1 << (c + minShift);
+}
+
+void *PayloadAllocator::allocate(size_t size) {
+  util::AccountMemory(util::ObjectMemory, getBlockSize(size));
+  unsigned c = getClass(size);
+  if (c == numClasses)
+    return ::operator new(size);
+
+  if (FreeBlock *block = freeLists[c]) {
+    freeLists[c] = block->next;
+    return block;
+  }
+
+  size_t blockSize = (size_t) 1 << (c + minShift);
+  if (slabCursors[c] == slabEnds[c]) {
+    slabCursors[c] = static_cast<char *>(::operator new(slabSize));
+    slabEnds[c] = slabCursors[c] + slabSize;
+    slabBytes += slabSize;
+  }
+  void *p = slabCursors[c];
+  slabCursors[c] += blockSize;
+  return p;
+}
+
+void PayloadAllocator::deallocate(void *p, size_t size) {
+  util::AccountMemory(util::ObjectMemory, -(int64_t) getBlockSize(size));
+  unsigned c = getClass(size);
+  if (c == numClasses) {
+    ::operator delete(p);
+    return;
+  }
+
+  FreeBlock *block = static_cast<FreeBlock *>(p);
+  block->next = freeLists[c];
+  freeLists[c] = block;
+}
+
+size_t PayloadAllocator::getSlabBytes() {
+  return slabBytes;
+}
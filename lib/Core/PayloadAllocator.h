@@ -0,0 +1,34 @@
+//===-- PayloadAllocator.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PAYLOADALLOCATOR_H
+#define KLEE_PAYLOADALLOCATOR_H
+
+#include <stddef.h>
+
+namespace klee {
+
+/// PayloadAllocator - Pooled allocation for the contents of the object
+/// states.
+///
+/// Blocks of up to 4 KB are rounded up to a power of two and taken from
+/// slabs of their size class, freed blocks are kept on a list per class for
+/// the next block of that class. Larger blocks go to the heap.
+class PayloadAllocator {
+public:
+  static void *allocate(size_t size);
+  static void deallocate(void *p, size_t size);
+
+  /// The bytes of all the slabs, including the free blocks.
+  static size_t getSlabBytes();
+};
+
+}
+
+#endif
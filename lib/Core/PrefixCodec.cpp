@@ -0,0 +1,149 @@
+//===-- PrefixCodec.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PrefixCodec.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+using namespace klee;
+
+namespace {
+const char PrefixPacketMagic[4] = {'K', 'P', 'F', '2'};
+
+void writeU32(std::vector<char> &out, uint32_t v) {
+  for (unsigned i = 0; i < 4; ++i)
+    out.push_back((char)(v >> (8 * i)));
+}
+
+const unsigned BranchBits = 3;
+const unsigned NumBranches = 5;
+
+/// Append the branches [begin, end) of prefix, BranchBits each.
+void writeBranches(std::vector<char> &out, const std::vector<char> &prefix,
+                   size_t begin) {
+  size_t length = prefix.size() - begin;
+  writeU32(out, length);
+  size_t base = out.size();
+  out.resize(base + (length * BranchBits + 7) / 8, 0);
+  for (size_t i = 0; i != length; ++i) {
+    unsigned branch = prefix[begin + i] - '0';
+    assert(branch < NumBranches && "invalid branch in history");
+    size_t bit = i * BranchBits;
+    out[base + bit / 8] |= (char)(branch << (bit % 8));
+    if (bit % 8 + BranchBits > 8)
+      out[base + bit / 8 + 1] |= (char)(branch >> (8 - bit % 8));
+  }
+}
+
+class BranchReader {
+  const unsigned char *pos, *end;
+
+public:
+  BranchReader(const char *buffer, size_t size)
+      : pos((const unsigned char *)buffer),
+        end((const unsigned char *)buffer + size) {}
+
+  bool readU32(uint32_t &v) {
+    if (end - pos < 4)
+      return false;
+    v = 0;
+    for (unsigned i = 0; i < 4; ++i)
+      v |= (uint32_t)*pos++ << (8 * i);
+    return true;
+  }
+
+  bool readBranches(std::vector<unsigned char> &out) {
+    uint32_t length;
+    if (!readU32(length))
+      return false;
+    size_t bytes = ((size_t)length * BranchBits + 7) / 8;
+    if ((size_t)(end - pos) < bytes)
+      return false;
+    out.reserve(out.size() + length);
+    for (uint32_t i = 0; i != length; ++i) {
+      size_t bit = (size_t)i * BranchBits;
+      unsigned branch = pos[bit / 8] >> (bit % 8);
+      if (bit % 8 + BranchBits > 8)
+        branch |= pos[bit / 8 + 1] << (8 - bit % 8);
+      branch &= (1 << BranchBits) - 1;
+      if (branch >= NumBranches)
+        return false;
+      out.push_back('0' + branch);
+    }
+    pos += bytes;
+    return true;
+  }
+
+  bool atEnd() const { return pos == end; }
+};
+}
+
+void PrefixCodec::encode(const std::vector<std::vector<char> > &prefixes,
+                         std::vector<char> &out) {
+  size_t common = prefixes.empty() ? 0 : prefixes[0].size();
+  for (size_t i = 1; i < prefixes.size(); ++i) {
+    size_t j = 0;
+    while (j < common && j < prefixes[i].size() &&
+           prefixes[i][j] == prefixes[0][j])
+      ++j;
+    common = j;
+  }
+
+  out.insert(out.end(), PrefixPacketMagic, PrefixPacketMagic + 4);
+  writeU32(out, prefixes.size());
+  std::vector<char> shared;
+  if (!prefixes.empty())
+    shared.assign(prefixes[0].begin(), prefixes[0].begin() + common);
+  writeBranches(out, shared, 0);
+  for (size_t i = 0; i != prefixes.size(); ++i)
+    writeBranches(out, prefixes[i], common);
+}
+
+bool PrefixCodec::isPrefixPacket(const char *buffer, size_t size) {
+  return size >= 4 && !memcmp(buffer, PrefixPacketMagic, 4);
+}
+
+bool PrefixCodec::decode(const char *buffer, size_t size,
+                         std::vector<std::vector<unsigned char> > &out) {
+  if (!isPrefixPacket(buffer, size))
+    return false;
+  BranchReader reader(buffer + 4, size - 4);
+
+  uint32_t count;
+  std::vector<unsigned char> shared;
+  if (!reader.readU32(count) || !reader.readBranches(shared))
+    return false;
+
+  std::vector<std::vector<unsigned char> > prefixes;
+  for (uint32_t i = 0; i != count; ++i) {
+    prefixes.push_back(shared);
+    if (!reader.readBranches(prefixes.back()))
+      return false;
+  }
+  if (!reader.atEnd())
+    return false;
+
+  out.insert(out.end(), prefixes.begin(), prefixes.end());
+  return true;
+}
+
+void PrefixCodec::toTreePath(const std::vector<unsigned char> &prefix,
+                             std::vector<unsigned char> &out) {
+  for (size_t i = 0; i != prefix.size(); ++i) {
+    unsigned char branch = prefix[i];
+    if (branch == '2')
+      out.push_back('0');
+    else if (branch == '3')
+      out.push_back('1');
+    else if (branch != '-')
+      out.push_back(branch);
+  }
+}
@@ -0,0 +1,47 @@
+//===-- PrefixCodec.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PREFIXCODEC_H
+#define KLEE_PREFIXCODEC_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace klee {
+
+/// PrefixCodec - Packs branch histories ('0'-'4' per branch) into the
+/// offload wire format.
+///
+/// A packet starts with a magic, the number of prefixes and the prefix all
+/// of them share, followed by the remaining suffix of every prefix. Each
+/// part is length-prefixed and stores 3 bits per branch.
+class PrefixCodec {
+public:
+  /// Append a packet holding all the given prefixes to out.
+  static void encode(const std::vector<std::vector<char> > &prefixes,
+                     std::vector<char> &out);
+
+  /// Returns true if buffer holds a packet written by encode.
+  static bool isPrefixPacket(const char *buffer, size_t size);
+
+  /// Unpack the complete prefixes of a packet, in the order they were
+  /// encoded.
+  ///
+  /// \return false if the packet is malformed; out is left unchanged.
+  static bool decode(const char *buffer, size_t size,
+                     std::vector<std::vector<unsigned char> > &out);
+
+  /// Map a branch history to the left/right path stored in the PrefixTree,
+  /// i.e. turn the '2'/'3' of unforked branches into '0'/'1'.
+  static void toTreePath(const std::vector<unsigned char> &prefix,
+                         std::vector<unsigned char> &out);
+};
+}
+
+#endif
@@ -1,52 +1,135 @@
 #include "PrefixTree.h"
 
-bool PrefixTree::addToTree(std::vector<unsigned char>& inPath) {
-  Node* current = root;
-  unsigned int idx=0;
-  while(idx<inPath.size()) {
-    if(inPath[idx] == '0') {
-      if(!current->left) {
-        current->left = new Node(nullptr, nullptr);
-      }
-      current = current->left;
-    } else {
-      if(!current->right) {
-        current->right = new Node(nullptr, nullptr);
+#include <algorithm>
+
+static unsigned childIndex(unsigned char branch) {
+  return branch == '0' ? 0 : 1;
+}
+
+static bool parkedEarlier(const PrefixTree::Node* a,
+                          const PrefixTree::Node* b) {
+  return a->parkedAt < b->parkedAt;
+}
+
+PrefixTree::~PrefixTree() {
+  std::vector<Node*> stack(1, root);
+  while(!stack.empty()) {
+    Node* n = stack.back();
+    stack.pop_back();
+    for(unsigned i=0; i<2; i++) {
+      if(n->children[i]) {
+        stack.push_back(n->children[i]);
       }
-      current = current->right;
     }
-    idx++;
+    delete n;
+  }
+}
+
+bool PrefixTree::addToTree(const std::vector<unsigned char>& inPath,
+                           klee::ExecutionState* state, double now) {
+  Node* current = root;
+  size_t idx = 0;
+  while(idx < inPath.size()) {
+    Node*& child = current->children[childIndex(inPath[idx])];
+    if(!child) {
+      child = new Node(std::string(inPath.begin()+idx, inPath.end()), state,
+                       now);
+      return true;
+    }
+    //the common part of the path and the edge
+    const std::string& label = child->label;
+    size_t common = 0;
+    while(common < label.size() && idx+common < inPath.size() &&
+          label[common] == inPath[idx+common]) {
+      common++;
+    }
+    if(common < label.size()) {
+      //split the edge where the path leaves it
+      Node* split = new Node(label.substr(0, common), nullptr);
+      child->label.erase(0, common);
+      split->children[childIndex(child->label[0])] = child;
+      child = split;
+    }
+    current = child;
+    idx += common;
   }
+  if(current->state) {
+    return false;
+  }
+  current->state = state;
+  current->parkedAt = now;
   return true;
 }
 
-bool PrefixTree::getPathToResume(std::vector<unsigned char>& inPath, std::vector<unsigned char>& outPath, std::ostream& log) {
+PrefixTree::Node* PrefixTree::getNodeToResume(
+    const std::vector<unsigned char>& inPath, size_t& length) {
   //1 is right and 0 is left
-  //std::string instr(inPath.begin(), inPath.end());
-  //log<<"Getting Path: "<<instr<<"\n";
   Node* current = root;
-  unsigned int idx=0;
-  while(idx<inPath.size()) {
-    if(inPath[idx] == '0') {
-      //log<<"Idx: "<<idx<<" is 0\n";
-      //log.flush();
-      if(current->left) {
-        outPath.push_back('0');
-        current = current->left;
-      } else {
-        break;
-      }
-    } else {
-      //log<<"Idx: "<<idx<<" is 1\n";
-      //log.flush();
-      if(current->right) {
-        outPath.push_back('1');
-        current = current->right;
-      } else {
-        break;
+  length = 0;
+  while(length < inPath.size()) {
+    Node* child = current->children[childIndex(inPath[length])];
+    if(!child) {
+      break;
+    }
+    const std::string& label = child->label;
+    size_t common = 0;
+    while(common < label.size() && length+common < inPath.size() &&
+          label[common] == inPath[length+common]) {
+      common++;
+    }
+    length += common;
+    if(common < label.size()) {
+      return nullptr;
+    }
+    current = child;
+  }
+  return current;
+}
+
+PrefixTree::Node* PrefixTree::getNearestToResume(
+    const std::vector<unsigned char>& inPath, size_t& length) {
+  Node* current = root;
+  Node* nearest = root->state ? root : nullptr;
+  size_t depth = 0;
+  length = 0;
+  while(depth < inPath.size()) {
+    Node* child = current->children[childIndex(inPath[depth])];
+    if(!child) {
+      break;
+    }
+    const std::string& label = child->label;
+    size_t common = 0;
+    while(common < label.size() && depth+common < inPath.size() &&
+          label[common] == inPath[depth+common]) {
+      common++;
+    }
+    if(common < label.size()) {
+      break;
+    }
+    depth += common;
+    current = child;
+    if(current->state) {
+      nearest = current;
+      length = depth;
+    }
+  }
+  return nearest;
+}
+
+void PrefixTree::getParkedNodes(std::vector<Node*>& out) {
+  std::vector<Node*>::size_type first = out.size();
+  std::vector<Node*> stack(1, root);
+  while(!stack.empty()) {
+    Node* n = stack.back();
+    stack.pop_back();
+    if(n->state) {
+      out.push_back(n);
+    }
+    for(unsigned i=0; i<2; i++) {
+      if(n->children[i]) {
+        stack.push_back(n->children[i]);
       }
     }
-    ++idx;
   }
-  return true;
+  std::stable_sort(out.begin()+first, out.end(), parkedEarlier);
 }
@@ -1,25 +1,55 @@
 #ifndef KLEE_PREFIX_TREE
 #define KLEE_PREFIX_TREE
+#include "klee/Internal/System/MemoryUsage.h"
+
+#include <string>
 #include <vector>
-#include <iostream>
+
+namespace klee {
+  class ExecutionState;
+}
+
+/// The paths ('0' and '1') of the states suspended while ranging, a path
+/// compressed binary tree holding every state at the end of its path.
 class PrefixTree {
   public:
-  class Node {
+  class Node
+    : public klee::util::MemoryAccounted<klee::util::PrefixTreeMemory> {
     public:
-    Node* left;
-    Node* right;
-    Node(Node* l, Node* r) {
-      left = l;
-      right = r;
+    /// the branches from the parent to this node
+    std::string label;
+    Node* children[2];
+    /// the state suspended at the node, or null
+    klee::ExecutionState* state;
+    /// the wall time the state was suspended at
+    double parkedAt;
+
+    Node(const std::string& l, klee::ExecutionState* s, double t = 0)
+      : label(l), state(s), parkedAt(t) {
+      children[0] = children[1] = nullptr;
     }
   };
 
   PrefixTree() {
-    root = new Node(nullptr, nullptr);
+    root = new Node("", nullptr);
   }
+  ~PrefixTree();
 
-  bool addToTree(std::vector<unsigned char>& inPath);
-  bool getPathToResume(std::vector<unsigned char>& inPath, std::vector<unsigned char>& outPath, std::ostream& log);
+  /// Add the path of a suspended state, a path keeps the first state added.
+  /// Returns false if the path already held one.
+  bool addToTree(const std::vector<unsigned char>& inPath,
+                 klee::ExecutionState* state, double now = 0);
+  /// Follow inPath as long as the tree does. Returns the node the walk
+  /// stops at, null if it stops inside an edge, with the number of branches
+  /// walked in length.
+  Node* getNodeToResume(const std::vector<unsigned char>& inPath,
+                        size_t& length);
+  /// The deepest node on inPath which holds a state, null if there is none,
+  /// with its number of branches in length.
+  Node* getNearestToResume(const std::vector<unsigned char>& inPath,
+                           size_t& length);
+  /// Append the nodes holding a state to out, oldest state first.
+  void getParkedNodes(std::vector<Node*>& out);
   private:
   Node* root;
 };
@@ -0,0 +1,151 @@
+//===-- QueryProfiler.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryProfiler.h"
+
+#include "klee/Config/Version.h"
+#include "klee/SolverStats.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+
+#if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#else
+#include "llvm/BasicBlock.h"
+#include "llvm/Function.h"
+#include "llvm/Instruction.h"
+#endif
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace klee;
+using namespace llvm;
+
+static const char *layerNames[QueryProfiler::NumLayers] = {
+  "core", "shared", "known", "cex", "cache", "other"
+};
+
+template <typename T>
+static bool costlier(const std::pair<T, QueryProfiler::Site> &a,
+                     const std::pair<T, QueryProfiler::Site> &b) {
+  if (a.second.time != b.second.time)
+    return a.second.time > b.second.time;
+  return a.second.queries > b.second.queries;
+}
+
+static void writeHeader(raw_ostream &os, const char *first) {
+  os << first << "\ttime(s)\tqueries";
+  for (unsigned i = 0; i < QueryProfiler::NumLayers; i++)
+    os << "\t" << layerNames[i];
+  os << "\n";
+}
+
+static void writeSite(raw_ostream &os, const QueryProfiler::Site &site) {
+  os << "\t" << format("%.6f", site.time / 1000000.) << "\t" << site.queries;
+  for (unsigned i = 0; i < QueryProfiler::NumLayers; i++)
+    os << "\t" << site.layers[i];
+  os << "\n";
+}
+
+static const Function *getFunction(const KInstruction *ki) {
+  const Instruction *inst = ki->isCloned ? ki->origInst : ki->inst;
+  return inst->getParent()->getParent();
+}
+
+void QueryProfiler::Site::add(const Site &other) {
+  queries += other.queries;
+  time += other.time;
+  for (unsigned i = 0; i < NumLayers; i++)
+    layers[i] += other.layers[i];
+}
+
+QueryProfiler::Counters QueryProfiler::getCounters() {
+  Counters counters;
+  counters.core = stats::queries;
+  counters.shared = stats::querySharedCacheHits;
+  counters.known = stats::queryKnownBitsHits;
+  counters.cex = stats::queryCexCacheHits;
+  counters.cache = stats::queryCacheHits;
+  return counters;
+}
+
+void QueryProfiler::record(const KInstruction *ki, uint64_t usec,
+                           const Counters &before) {
+  if (!ki)
+    return;
+
+  /* the innermost layer which was reached answered the query */
+  Counters after = getCounters();
+  Layer layer = Other;
+  if (after.core != before.core)
+    layer = CoreSolver;
+  else if (after.shared != before.shared)
+    layer = SharedCache;
+  else if (after.known != before.known)
+    layer = KnownBits;
+  else if (after.cex != before.cex)
+    layer = CexCache;
+  else if (after.cache != before.cache)
+    layer = QueryCache;
+
+  Site &site = sites[ki];
+  site.queries++;
+  site.time += usec;
+  site.layers[layer]++;
+
+  std::pair<uint64_t, uint64_t> &block = blocks[ki->inst->getParent()];
+  block.first++;
+  block.second += usec;
+}
+
+double QueryProfiler::getExpectedCost(const BasicBlock *bb) const {
+  std::map<const BasicBlock *, std::pair<uint64_t, uint64_t> >::const_iterator
+    it = blocks.find(bb);
+  if (it == blocks.end())
+    return 0;
+  return (double) it->second.second / it->second.first;
+}
+
+void QueryProfiler::writeSites(raw_ostream &os) const {
+  std::vector< std::pair<const KInstruction *, Site> > sorted(sites.begin(),
+                                                              sites.end());
+  std::sort(sorted.begin(), sorted.end(), costlier<const KInstruction *>);
+
+  writeHeader(os, "function\tfile:line\tasm-line\topcode");
+  for (unsigned i = 0; i < sorted.size(); i++) {
+    const KInstruction *ki = sorted[i].first;
+    os << getFunction(ki)->getName() << "\t" << *ki->info->file << ":"
+       << ki->info->line << "\t" << ki->info->assemblyLine << "\t"
+       << ki->inst->getOpcodeName();
+    writeSite(os, sorted[i].second);
+  }
+}
+
+void QueryProfiler::writeFunctions(raw_ostream &os) const {
+  std::map<const Function *, Site> functions;
+  for (std::map<const KInstruction *, Site>::const_iterator it = sites.begin(),
+         ie = sites.end(); it != ie; ++it)
+    functions[getFunction(it->first)].add(it->second);
+
+  std::vector< std::pair<const Function *, Site> > sorted(functions.begin(),
+                                                          functions.end());
+  std::sort(sorted.begin(), sorted.end(), costlier<const Function *>);
+
+  writeHeader(os, "function");
+  for (unsigned i = 0; i < sorted.size(); i++) {
+    os << sorted[i].first->getName();
+    writeSite(os, sorted[i].second);
+  }
+}
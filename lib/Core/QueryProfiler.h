@@ -0,0 +1,84 @@
+//===-- QueryProfiler.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_QUERYPROFILER_H
+#define KLEE_QUERYPROFILER_H
+
+#include <stdint.h>
+#include <map>
+
+namespace llvm {
+  class BasicBlock;
+  class raw_ostream;
+}
+
+namespace klee {
+  struct KInstruction;
+
+  /// QueryProfiler - Attributes the cost of the solver queries to the
+  /// instructions which issue them.
+  ///
+  /// The layer of the solver chain which answered a query is found from the
+  /// solver statistics, by comparing them before and after the query.
+  class QueryProfiler {
+  public:
+    enum Layer {
+      CoreSolver,
+      SharedCache,
+      KnownBits,
+      CexCache,
+      QueryCache,
+      /// answered on the way, e.g. by the independent solver
+      Other,
+      NumLayers
+    };
+
+    /// the solver statistics which tell the layers apart
+    struct Counters {
+      uint64_t core, shared, known, cex, cache;
+    };
+
+    struct Site {
+      uint64_t queries;
+      /// wall time in microseconds
+      uint64_t time;
+      uint64_t layers[NumLayers];
+
+      Site() : queries(0), time(0) {
+        for (unsigned i = 0; i < NumLayers; i++)
+          layers[i] = 0;
+      }
+      void add(const Site &other);
+    };
+
+  private:
+    std::map<const KInstruction *, Site> sites;
+    /// the queries and their time of the instructions of every block
+    std::map<const llvm::BasicBlock *, std::pair<uint64_t, uint64_t> > blocks;
+
+  public:
+    static Counters getCounters();
+
+    /// Record a query of ki which took usec microseconds, before are the
+    /// counters from before it.
+    void record(const KInstruction *ki, uint64_t usec, const Counters &before);
+
+    /// The mean time in microseconds of the queries issued in bb so far, the
+    /// expected cost of the next query of a state entering it; 0 if none.
+    double getExpectedCost(const llvm::BasicBlock *bb) const;
+
+    /// Write the sites, costliest first.
+    void writeSites(llvm::raw_ostream &os) const;
+
+    /// Write the sum of the sites of every function, costliest first.
+    void writeFunctions(llvm::raw_ostream &os) const;
+  };
+}
+
+#endif
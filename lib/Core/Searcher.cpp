@@ -12,6 +12,7 @@
 #include "CoreStats.h"
 #include "Executor.h"
 #include "PTree.h"
+#include "QueryProfiler.h"
 #include "StatsTracker.h"
 
 #include "klee/ExecutionState.h"
@@ -44,6 +45,7 @@
 #include <cassert>
 #include <fstream>
 #include <climits>
+#include <algorithm>
 
 using namespace klee;
 using namespace llvm;
@@ -62,6 +64,74 @@ Searcher::~Searcher() {
 
 ///
 
+namespace {
+  /// Orders the states from the best to donate to the worst.
+  struct OffloadOrder {
+    Searcher::OffloadCriteria criteria;
+
+    OffloadOrder(Searcher::OffloadCriteria _criteria) : criteria(_criteria) {}
+
+    bool operator()(const ExecutionState *a, const ExecutionState *b) const {
+      switch (criteria) {
+      case Searcher::OC_LargestSubtree:
+        if (a->depth != b->depth)
+          return a->depth < b->depth;
+        break;
+      case Searcher::OC_LeastRecentlyScheduled:
+        if (a->lastScheduled != b->lastScheduled)
+          return a->lastScheduled < b->lastScheduled;
+        break;
+      case Searcher::OC_NearestTarget:
+        // 0 is unreachable, the farthest
+        if (a->targetDistance != b->targetDistance)
+          return a->targetDistance && (!b->targetDistance ||
+                                       a->targetDistance < b->targetDistance);
+        break;
+      default:
+        break;
+      }
+      return a->branchHist.size() < b->branchHist.size();
+    }
+  };
+}
+
+namespace {
+  /// Keeps the k best states to donate seen so far in a heap at the end of
+  /// out.
+  class OffloadSelection {
+    unsigned k;
+    OffloadOrder order;
+    std::vector<ExecutionState *> &out;
+    std::vector<ExecutionState *>::size_type first;
+
+  public:
+    OffloadSelection(unsigned _k, Searcher::OffloadCriteria criteria,
+                     std::vector<ExecutionState *> &_out)
+      : k(_k), order(criteria), out(_out), first(_out.size()) {}
+
+    template <typename Iterator>
+    void consider(Iterator begin, Iterator end) {
+      for (; k && begin != end; ++begin) {
+        ExecutionState *es = *begin;
+        if (es->isSuspended())
+          continue;
+        if (out.size() - first == k) {
+          if (!order(es, out[first]))
+            continue;
+          std::pop_heap(out.begin() + first, out.end(), order);
+          out.back() = es;
+        } else {
+          out.push_back(es);
+        }
+        std::push_heap(out.begin() + first, out.end(), order);
+      }
+    }
+
+    /// Leave the selected states best first.
+    void finish() { std::sort_heap(out.begin() + first, out.end(), order); }
+  };
+}
+
 ExecutionState &DFSSearcher::selectState() {
   return *states.back();
 }
@@ -69,195 +139,104 @@ ExecutionState &DFSSearcher::selectState() {
 void DFSSearcher::update(ExecutionState *current,
                          const std::vector<ExecutionState *> &addedStates,
                          const std::vector<ExecutionState *> &removedStates) {
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
+  for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
+                                                     ie = addedStates.end();
+       it != ie; ++it) {
+    ExecutionState *es = *it;
+    es->searcherPos = states.insert(states.end(), es);
+  }
   for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
                                                      ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
-    if (es == states.back()) {
-      states.pop_back();
-    } else {
-      bool ok = false;
-
-      for (std::vector<ExecutionState*>::iterator it = states.begin(),
-             ie = states.end(); it != ie; ++it) {
-        if (es==*it) {
-          states.erase(it);
-          ok = true;
-          break;
-        }
-      }
-
-      assert(ok && "invalid state removed");
-    }
+    assert(*es->searcherPos == es && "invalid state removed");
+    states.erase(es->searcherPos);
   }
 }
 
 ExecutionState* DFSSearcher::getState2Offload() {
-  //ExecutionState *ptr2State = states[theRNG.getInt32()%states.size()];
-  ExecutionState *ptr2State = states[0];
-  ExecutionState retState = *ptr2State;
-  return ptr2State;
+  return states.front();
+}
+
+void DFSSearcher::selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                                        std::vector<ExecutionState *> &out) {
+  OffloadSelection selection(k, criteria, out);
+  selection.consider(states.begin(), states.end());
+  selection.finish();
 }
 
 ///
 
-BFSSearcher::BFSSearcher() {
-  currentMinDepth = 0;
-  depthStatesMap.clear();
-  depthMap.clear();
+BFSSearcher::BFSSearcher() : numStates(0) {
 }
 
 BFSSearcher::~BFSSearcher() {
 }
 
-
-//ExecutionState &BFSSearcher::getState2Offload() {
-//}
-
 ExecutionState* BFSSearcher::getState2Offload() {
-  assert(depthStatesMap.find(currentMinDepth) != depthStatesMap.end());
-  return (depthStatesMap[currentMinDepth][theRNG.getInt32()%depthStatesMap[currentMinDepth].size()]);
+  assert(!depthStates.empty());
+  std::list<ExecutionState*> &shallowest = depthStates.begin()->second;
+  std::list<ExecutionState*>::iterator it = shallowest.begin();
+  std::advance(it, theRNG.getInt32() % shallowest.size());
+  return *it;
+}
+
+void BFSSearcher::selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                                        std::vector<ExecutionState *> &out) {
+  OffloadSelection selection(k, criteria, out);
+  for (std::map<unsigned, std::list<ExecutionState*> >::iterator
+         it = depthStates.begin(), ie = depthStates.end(); it != ie; ++it)
+    selection.consider(it->second.begin(), it->second.end());
+  selection.finish();
 }
 
 ExecutionState &BFSSearcher::selectState() {
-  //std::cout<<"YT Calling Select State Minimum Depth: "<<currentMinDepth<<"\n";
-  //std::cout.flush();
-  assert(depthStatesMap.find(currentMinDepth) != depthStatesMap.end());
-  return *((depthStatesMap[currentMinDepth]).front());
+  assert(!depthStates.empty());
+  return *depthStates.begin()->second.front();
 }
 
 //The switch statement adds all the states corresponding to each of the case
 //statments in one go. Each case has an increasing depth. Now If say there are
 //multiple switch statements, a state of depth 4 will be added before the
 //a state of depth 2 in the following switch stament which breaks the BFS
-//search, so I need to reimplement the BFS search again to accomodate this case
-//There is map which maps the depth to the deque of states of that depth
+//search, so the states are kept in a list for every depth, and the
+//shallowest depth is searched first
 void BFSSearcher::update(ExecutionState *current,
     const std::vector<ExecutionState *> &addedStates,
     const std::vector<ExecutionState *> &removedStates) {
-
-  //std::cout << "SS_Searcher: Calling updatestate BFS \n";
-  //std::cout.flush();;
-  if(current != nullptr) {
-    auto mit = depthMap.find(current);
-    if (mit == depthMap.end()) {
-      //if the state doesnt exist for some reason just put it 
-      //in and update it
-      //depthMap[current] = current->actDepth;
-      //insertIntoDepthStateMap(current);
-      //std::cout << "YT Inserting State "<<current<<" at depth "<<current->actDepth<<"\n";
-    } else {
-      //if it exists and the depth has changed, if yes update it
-      if (depthMap[current] != current->actDepth) {
-        //std::cout << "YT Updating State "<<current<<" from depth "<<depthMap[current]
-        //          << " to depth " << current->actDepth<<"\n";
-        updateDepthStateMap(current, depthMap[current]);
-        depthMap[current] = current->actDepth;
-      }
-    }
-  }
-
-  //removing the removed states
-  //std::cout << "SS_Searcher: Removing states BFS \n";
   for(auto it = removedStates.begin(); it != removedStates.end(); ++it) {
     removeFromDepthStateMap(*it);
   }
-  //adding the new states
-  //std::cout << "SS_Searcher: Adding states BFS \n";
+  //the current state is filed again if its depth has changed
+  if(current != nullptr && current->searcherDepth != NotInSearcher &&
+     current->searcherDepth != current->actDepth &&
+     std::find(addedStates.begin(), addedStates.end(), current) ==
+         addedStates.end()) {
+    removeFromDepthStateMap(current);
+    insertIntoDepthStateMap(current);
+  }
   for(auto it = addedStates.begin(); it != addedStates.end(); ++it) {
     insertIntoDepthStateMap(*it);
   }
 }
 
 void BFSSearcher::insertIntoDepthStateMap(ExecutionState* current) {
-  auto it2 = std::find(states.begin(), states.end(), current);
-  if(it2 == states.end()) {
-    states.push_back(current);
-  }
-  int depth = current->actDepth;
-  if(depthMap.size() == 0) { //first state
-    currentMinDepth = current->actDepth;
-    //depthMap.clear();
-    //depthStatesMap.clear();
-  }
-  depthMap[current] = depth;
-  if(depthStatesMap.find(depth) == depthStatesMap.end()) {
-    std::deque<ExecutionState*> newListofStates;
-    newListofStates.push_back(current);
-    depthStatesMap[depth] = newListofStates;
-    if(currentMinDepth > current->actDepth) {
-      currentMinDepth = current->actDepth;
-    }
-    //std::cout << "YT Adding first state "<<current<<" depth "<<depth<<" "<<current<<"\n";
-    //std::cout.flush();
-  } else {
-    auto listofStates= depthStatesMap[depth];
-    listofStates.push_back(current);
-    depthStatesMap[depth] = listofStates;
-    //std::cout << "YT Adding state "<<current<<" depth "<<depth<<" "<<current<<"\n";
-    //std::cout.flush();
-  }
+  std::list<ExecutionState*> &states = depthStates[current->actDepth];
+  current->searcherDepth = current->actDepth;
+  current->searcherPos = states.insert(states.end(), current);
+  numStates++;
 }
 
 void BFSSearcher::removeFromDepthStateMap(ExecutionState* current) {
-  //assert(depthMap.find(current) != depthMap.end());
-  auto it2 = std::find(states.begin(), states.end(), current);
-  assert(it2!=states.end());
-  states.erase(it2);
-  int oldDepth = depthMap[current];
-  int depth = current->actDepth;
-  //std::cout << "YT Trying Removing state "<<current<<" depth "<<depth<<" "<<current<<"\n";
-  //std::cout.flush();
-  assert(depthStatesMap.find(oldDepth) != depthStatesMap.end());
-  auto listofStates = depthStatesMap[oldDepth];
-  auto it = std::find(listofStates.begin(), listofStates.end(), current);
-  assert(it!=listofStates.end());
-  listofStates.erase(it);
-  //here check if the list is empty
-  if(listofStates.size() == 0) {
-    depthStatesMap.erase(oldDepth);
-    //std::cout << "YT Removing last state "<<current<<" depth "<<depth<<"\n";
-    //std::cout.flush();
-    if (oldDepth == currentMinDepth) {
-      int found = false;
-      //currentMinDepth++;
-      int tryDepth = currentMinDepth + 1;
-      while(depthStatesMap.find(tryDepth) == depthStatesMap.end()) {
-        //std::cout << "Trying for a new depth: "<<tryDepth<<"\n";
-        tryDepth++;  
-      } 
-      currentMinDepth = tryDepth;
-      //std::cout << "YT New Minimum Depth  "<< currentMinDepth <<"\n";
-      //std::cout.flush();
-    }
-  } else {
-    depthStatesMap[oldDepth] = listofStates;
-    //std::cout << "YT Removing state "<<current<<" depth "<<depth<<"\n";
-    //std::cout.flush();
-  }
-  depthMap.erase(current);
-}
-
-void BFSSearcher::updateDepthStateMap(ExecutionState* current, int oldDepth) {
-  int newDepth = current->actDepth;
-  assert(depthStatesMap.find(oldDepth) != depthStatesMap.end());
-  //erase from the old list
-  auto listofStates = depthStatesMap[oldDepth];
-  auto it = std::find(listofStates.begin(), listofStates.end(), current);
-  assert(it!=listofStates.end());
-  listofStates.erase(it);
-  if (listofStates.size() == 0) {
-    depthStatesMap.erase(oldDepth);
-    if (currentMinDepth <= oldDepth)
-      //currentMinDepth = oldDepth+1;
-      currentMinDepth = newDepth;
-  } else {
-    depthStatesMap[oldDepth] = listofStates;
-  }
-  insertIntoDepthStateMap(current);
+  std::map<unsigned, std::list<ExecutionState*> >::iterator depth =
+      depthStates.find(current->searcherDepth);
+  assert(depth != depthStates.end() && *current->searcherPos == current &&
+         "invalid state removed");
+  depth->second.erase(current->searcherPos);
+  if (depth->second.empty())
+    depthStates.erase(depth);
+  current->searcherDepth = NotInSearcher;
+  numStates--;
 }
 
 ///
@@ -296,11 +275,18 @@ ExecutionState* RandomSearcher::getState2Offload() {
   return states[0];
 }
 
+void RandomSearcher::selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                                           std::vector<ExecutionState *> &out) {
+  OffloadSelection selection(k, criteria, out);
+  selection.consider(states.begin(), states.end());
+  selection.finish();
+}
+
 ///
 
 WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
   : states(new DiscretePDF<ExecutionState*>()),
-    type(_type) {
+    type(_type), weightEpoch(0) {
   switch(type) {
   case Depth: 
     updateWeights = false;
@@ -310,6 +296,7 @@ WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
   case QueryCost:
   case MinDistToUncovered:
   case CoveringNew:
+  case MinDistToTarget:
     updateWeights = true;
     break;
   default:
@@ -344,8 +331,14 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   }
   case QueryCost:
     return (es->queryCost < .1) ? 1. : 1./es->queryCost;
+  case MinDistToTarget: {
+    // kept up to date by the executor
+    double inv = 1. / (es->targetDistance ? es->targetDistance : 10000);
+    return inv * inv;
+  }
   case CoveringNew:
   case MinDistToUncovered: {
+    updateMinDistToUncovered(*es);
     uint64_t md2u = computeMinDistToUncovered(es->pc,
                                               es->stack.back().minDistToUncoveredOnReturn);
 
@@ -370,17 +363,29 @@ void WeightedRandomSearcher::update(
           removedStates.end())
     states->update(current, getWeight(current));
 
+  /* new distances to uncovered code change the weights of all states */
+  if ((type == MinDistToUncovered || type == CoveringNew) &&
+      weightEpoch != getUncoveredEpoch()) {
+    weightEpoch = getUncoveredEpoch();
+    for (std::list<ExecutionState *>::iterator it = stateList.begin(),
+                                               ie = stateList.end();
+         it != ie; ++it)
+      states->update(*it, getWeight(*it));
+  }
+
   for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
                                                      ie = addedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
     states->insert(es, getWeight(es));
+    es->searcherPos = stateList.insert(stateList.end(), es);
   }
 
   for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
                                                      ie = removedStates.end();
        it != ie; ++it) {
     states->remove(*it);
+    stateList.erase((*it)->searcherPos);
   }
 }
 
@@ -399,6 +404,13 @@ ExecutionState* WeightedRandomSearcher::getState2Offload() {
   return &state2Offload;
 }
 
+void WeightedRandomSearcher::selectStatesToOffload(
+    unsigned k, OffloadCriteria criteria, std::vector<ExecutionState *> &out) {
+  OffloadSelection selection(k, criteria, out);
+  selection.consider(stateList.begin(), stateList.end());
+  selection.finish();
+}
+
 ///
 
 RandomPathSearcher::RandomPathSearcher(Executor &_executor)
@@ -438,6 +450,11 @@ void
 RandomPathSearcher::update(ExecutionState *current,
                            const std::vector<ExecutionState *> &addedStates,
                            const std::vector<ExecutionState *> &removedStates) {
+  states.insert(addedStates.begin(), addedStates.end());
+  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
+                                                     ie = removedStates.end();
+       it != ie; ++it)
+    states.erase(*it);
 }
 
 bool RandomPathSearcher::empty() { 
@@ -445,8 +462,15 @@ bool RandomPathSearcher::empty() {
 }
 
 ExecutionState* RandomPathSearcher::getState2Offload() {
-  ExecutionState* ff;
-  return ff;
+  assert(!states.empty());
+  return *states.begin();
+}
+
+void RandomPathSearcher::selectStatesToOffload(
+    unsigned k, OffloadCriteria criteria, std::vector<ExecutionState *> &out) {
+  OffloadSelection selection(k, criteria, out);
+  selection.consider(states.begin(), states.end());
+  selection.finish();
 }
 
 ///
@@ -528,8 +552,7 @@ void BumpMergingSearcher::update(
 }
 
 ExecutionState* BumpMergingSearcher::getState2Offload() {
-  ExecutionState* ff;
-  return ff;
+  return baseSearcher->getState2Offload();
 }
 
 
@@ -667,8 +690,7 @@ MergingSearcher::update(ExecutionState *current,
 }
 
 ExecutionState* MergingSearcher::getState2Offload() {
-  ExecutionState* ff;
-  return ff;
+  return baseSearcher->getState2Offload();
 }
 
 ///
@@ -719,8 +741,7 @@ BatchingSearcher::update(ExecutionState *current,
 }
 
 ExecutionState* BatchingSearcher::getState2Offload() {
-      ExecutionState* ff;
-            return ff;
+  return baseSearcher->getState2Offload();
 }
 
 /***/
@@ -781,8 +802,233 @@ void IterativeDeepeningTimeSearcher::update(
 }
 
 ExecutionState* IterativeDeepeningTimeSearcher::getState2Offload() {
-  ExecutionState* ff;
-  return ff;
+  if (baseSearcher->atleast2states() || pausedStates.empty())
+    return baseSearcher->getState2Offload();
+  return *pausedStates.begin();
+}
+
+void IterativeDeepeningTimeSearcher::selectStatesToOffload(
+    unsigned k, OffloadCriteria criteria, std::vector<ExecutionState *> &out) {
+  // the paused states are waiting anyway, they are worth donating too
+  std::vector<ExecutionState *> selected;
+  baseSearcher->selectStatesToOffload(k, criteria, selected);
+  OffloadSelection selection(k, criteria, out);
+  selection.consider(selected.begin(), selected.end());
+  selection.consider(pausedStates.begin(), pausedStates.end());
+  selection.finish();
+}
+
+/***/
+
+QueryCostSearcher::QueryCostSearcher(Executor &_executor,
+                                     Searcher *_baseSearcher,
+                                     double _threshold)
+  : executor(_executor), baseSearcher(_baseSearcher), threshold(_threshold) {
+}
+
+QueryCostSearcher::~QueryCostSearcher() {
+  delete baseSearcher;
+}
+
+double QueryCostSearcher::getExpectedCost(ExecutionState *es) {
+  if (!executor.queryProfiler)
+    return 0;
+  return executor.queryProfiler->getExpectedCost(es->pc->inst->getParent());
+}
+
+void QueryCostSearcher::defer(ExecutionState *es, double cost) {
+  deferred.insert(std::make_pair(cost, es));
+  deferredCost[es] = cost;
+  ++stats::deferredStates;
+}
+
+void QueryCostSearcher::update(
+    ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
+    const std::vector<ExecutionState *> &removedStates) {
+  std::vector<ExecutionState *> alt;
+  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
+                                                     ie = removedStates.end();
+       it != ie; ++it) {
+    std::map<ExecutionState*, double>::iterator found = deferredCost.find(*it);
+    if (found == deferredCost.end()) {
+      alt.push_back(*it);
+      continue;
+    }
+    deferred.erase(std::make_pair(found->second, *it));
+    deferredCost.erase(found);
+  }
+
+  // the added states and the current one may have reached costlier blocks,
+  // but one state is always left to the base searcher
+  std::vector<ExecutionState *> added;
+  for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
+                                                     ie = addedStates.end();
+       it != ie; ++it) {
+    double cost = getExpectedCost(*it);
+    if (cost > threshold && !(*it)->isRecoveryState() &&
+        baseSearcher->getSize() + added.size() > alt.size())
+      defer(*it, cost);
+    else
+      added.push_back(*it);
+  }
+  baseSearcher->update(current, added, alt);
+
+  if (current && baseSearcher->getSize() > 1 &&
+      !current->isRecoveryState() && !deferredCost.count(current) &&
+      std::find(removedStates.begin(), removedStates.end(), current) ==
+          removedStates.end()) {
+    double cost = getExpectedCost(current);
+    if (cost > threshold) {
+      baseSearcher->removeState(current);
+      defer(current, cost);
+    }
+  }
+
+  if (baseSearcher->empty() && !deferred.empty()) {
+    ExecutionState *es = deferred.begin()->second;
+    deferred.erase(deferred.begin());
+    deferredCost.erase(es);
+    baseSearcher->addState(es);
+  }
+}
+
+ExecutionState* QueryCostSearcher::getState2Offload() {
+  if (deferred.empty())
+    return baseSearcher->getState2Offload();
+  return deferred.rbegin()->second;
+}
+
+void QueryCostSearcher::selectStatesToOffload(
+    unsigned k, OffloadCriteria criteria, std::vector<ExecutionState *> &out) {
+  // the costliest states go first, the cheap ones stay with this worker
+  for (std::set<std::pair<double, ExecutionState*> >::reverse_iterator
+         it = deferred.rbegin(), ie = deferred.rend(); k && it != ie; ++it) {
+    if (it->second->isSuspended())
+      continue;
+    out.push_back(it->second);
+    k--;
+  }
+  if (k)
+    baseSearcher->selectStatesToOffload(k, criteria, out);
+}
+
+/***/
+
+FairShareSearcher::FairShareSearcher(
+    const std::function<Searcher *()> &_newSearcher, double _slice)
+  : newSearcher(_newSearcher), slice(_slice), running(0), sliceStart(0) {
+}
+
+FairShareSearcher::~FairShareSearcher() {
+  for (std::map<unsigned, Subtree>::iterator it = subtrees.begin(),
+         ie = subtrees.end(); it != ie; ++it)
+    delete it->second.searcher;
+}
+
+ExecutionState &FairShareSearcher::selectState() {
+  double now = util::getWallTime();
+  std::map<unsigned, Subtree>::iterator it = subtrees.find(running);
+  if (it != subtrees.end() && now - sliceStart < slice)
+    return it->second.searcher->selectState();
+
+  // the slice is over, the subtree which ran the least goes next
+  if (it != subtrees.end())
+    it->second.time += now - sliceStart;
+  std::map<unsigned, Subtree>::iterator next = subtrees.begin();
+  for (it = subtrees.begin(); it != subtrees.end(); ++it)
+    if (it->second.time < next->second.time)
+      next = it;
+  if (next->first != running)
+    ++stats::subtreeSlices;
+  running = next->first;
+  sliceStart = now;
+  return next->second.searcher->selectState();
+}
+
+void FairShareSearcher::update(
+    ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
+    const std::vector<ExecutionState *> &removedStates) {
+  typedef std::pair<std::vector<ExecutionState *>,
+                    std::vector<ExecutionState *> > Changes;
+  std::map<unsigned, Changes> changes;
+  for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
+         ie = addedStates.end(); it != ie; ++it)
+    changes[(*it)->subtree].first.push_back(*it);
+  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
+         ie = removedStates.end(); it != ie; ++it)
+    changes[(*it)->subtree].second.push_back(*it);
+  // the subtree of the current state sees it even if nothing else changed
+  if (current && subtrees.count(current->subtree))
+    changes[current->subtree];
+
+  for (std::map<unsigned, Changes>::iterator it = changes.begin(),
+         ie = changes.end(); it != ie; ++it) {
+    std::map<unsigned, Subtree>::iterator subtree = subtrees.find(it->first);
+    if (subtree == subtrees.end()) {
+      if (it->second.first.empty())
+        continue;
+      // a new subtree starts as if it had run as long as the least run one,
+      // not ahead of all the others
+      double time = 0;
+      for (std::map<unsigned, Subtree>::iterator st = subtrees.begin();
+           st != subtrees.end(); ++st)
+        if (st == subtrees.begin() || st->second.time < time)
+          time = st->second.time;
+      Subtree s = { newSearcher(), time };
+      subtree = subtrees.insert(std::make_pair(it->first, s)).first;
+    }
+    Searcher *searcher = subtree->second.searcher;
+    searcher->update(current && current->subtree == it->first ? current : 0,
+                     it->second.first, it->second.second);
+    if (searcher->empty()) {
+      delete searcher;
+      subtrees.erase(subtree);
+    }
+  }
+}
+
+unsigned int FairShareSearcher::getSize() {
+  unsigned size = 0;
+  for (std::map<unsigned, Subtree>::iterator it = subtrees.begin(),
+         ie = subtrees.end(); it != ie; ++it)
+    size += it->second.searcher->getSize();
+  return size;
+}
+
+void FairShareSearcher::getStarvedSubtrees(std::vector<Searcher *> &out) {
+  std::vector<std::pair<double, Searcher *> > order;
+  for (std::map<unsigned, Subtree>::iterator it = subtrees.begin(),
+         ie = subtrees.end(); it != ie; ++it)
+    order.push_back(std::make_pair(it->second.time, it->second.searcher));
+  std::stable_sort(order.begin(), order.end(),
+                   [](const std::pair<double, Searcher *> &a,
+                      const std::pair<double, Searcher *> &b) {
+                     return a.first < b.first;
+                   });
+  for (unsigned i = 0; i < order.size(); i++)
+    out.push_back(order[i].second);
+}
+
+ExecutionState* FairShareSearcher::getState2Offload() {
+  std::vector<Searcher *> starved;
+  getStarvedSubtrees(starved);
+  for (unsigned i = 0; i < starved.size(); i++)
+    if (ExecutionState *es = starved[i]->getState2Offload())
+      return es;
+  return 0;
+}
+
+void FairShareSearcher::selectStatesToOffload(
+    unsigned k, OffloadCriteria criteria, std::vector<ExecutionState *> &out) {
+  // the subtrees which ran the least go first, another worker gets to them
+  // sooner
+  std::vector<Searcher *> starved;
+  getStarvedSubtrees(starved);
+  for (unsigned i = 0; i < starved.size() && k; i++) {
+    size_t before = out.size();
+    starved[i]->selectStatesToOffload(k, criteria, out);
+    k -= std::min<size_t>(k, out.size() - before);
+  }
 }
 
 /***/
@@ -813,8 +1059,7 @@ void InterleavedSearcher::update(
 }
 
 ExecutionState* InterleavedSearcher::getState2Offload() {
-  ExecutionState* ff;
-  return ff;
+  return searchers[0]->getState2Offload();
 }
 
 /* splitted searcher */
@@ -968,6 +1213,7 @@ void RandomRecoveryPath::update(
     ExecutionState *es = *i;
     if (es->getLevel() == treeStack.size()) {
       /* this state has a higher level, so we push it as a root */
+      es->ptreeNode->pinned = true;
       treeStack.push(es->ptreeNode);
     }
 
@@ -996,8 +1242,53 @@ bool RandomRecoveryPath::empty() {
 }
 
 ExecutionState* RandomRecoveryPath::getState2Offload() {
-  ExecutionState* ff;
-  return ff;
+  // recovery states are not donated
+  return 0;
+}
+
+/* recovery searcher ranked by the blocked states */
+bool RecoveryPrioritySearcher::hasHigherPriority(ExecutionState *a, ExecutionState *b) {
+  /* a recovery state at level n blocks n + 1 states */
+  if (a->getLevel() != b->getLevel()) {
+    return a->getLevel() > b->getLevel();
+  }
+
+  ExecutionState *oa = a->getOriginatingState();
+  ExecutionState *ob = b->getOriginatingState();
+  if (oa->coveredNew != ob->coveredNew) {
+    return oa->coveredNew;
+  }
+
+  return oa->getSuspendTime() < ob->getSuspendTime();
+}
+
+ExecutionState &RecoveryPrioritySearcher::selectState() {
+  /* the latest added state wins ties */
+  ExecutionState *best = states.back();
+  for (auto i = states.rbegin(); i != states.rend(); i++) {
+    if (hasHigherPriority(*i, best)) {
+      best = *i;
+    }
+  }
+  return *best;
+}
+
+void RecoveryPrioritySearcher::update(
+  ExecutionState *current,
+  const std::vector<ExecutionState *> &addedStates,
+  const std::vector<ExecutionState *> &removedStates
+) {
+  states.insert(states.end(), addedStates.begin(), addedStates.end());
+  for (auto i = removedStates.begin(); i != removedStates.end(); i++) {
+    auto j = std::find(states.begin(), states.end(), *i);
+    assert(j != states.end() && "invalid state removed");
+    states.erase(j);
+  }
+}
+
+ExecutionState* RecoveryPrioritySearcher::getState2Offload() {
+  // recovery states are not donated
+  return 0;
 }
 
 /* optimized splitted searcher */
@@ -1113,6 +1404,5 @@ bool OptimizedSplittedSearcher::empty() {
 }
 
 ExecutionState* OptimizedSplittedSearcher::getState2Offload() {
-  ExecutionState* ff;
-  return ff;
+  return baseSearcher->getState2Offload();
 }
@@ -13,6 +13,8 @@
 #include "PTree.h"
 
 #include "llvm/Support/raw_ostream.h"
+#include <functional>
+#include <list>
 #include <vector>
 #include <set>
 #include <map>
@@ -39,6 +41,22 @@ namespace klee {
     virtual ExecutionState* getState2Offload() = 0;
     virtual bool atleast2states() = 0;
 
+    /// what makes a state worth donating to another worker
+    enum OffloadCriteria {
+      /// fewest branches for the receiver to replay
+      OC_ShortestHistory,
+      /// fewest forks on its path, i.e. the largest subtree left below it
+      OC_LargestSubtree,
+      OC_LeastRecentlyScheduled,
+      /// nearest to an --error-location target
+      OC_NearestTarget
+    };
+
+    /// Append the (up to) k best states to donate to out, best first.
+    /// Searchers which can not enumerate their states append none.
+    virtual void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                                       std::vector<ExecutionState *> &out) {}
+
 
     virtual void update(ExecutionState *current,
                         const std::vector<ExecutionState *> &addedStates,
@@ -84,22 +102,27 @@ namespace klee {
       NURS_Depth,
       NURS_ICnt,
       NURS_CPICnt,
-      NURS_QC
+      NURS_QC,
+      NURS_Target
     };
 
     enum RecoverySearchType {
       RS_DFS,
       RS_RandomPath,
+      RS_Priority,
     };
   };
 
   class DFSSearcher : public Searcher {
-    std::vector<ExecutionState*> states;
+    /// the states in the order they were added, each knows its position
+    std::list<ExecutionState*> states;
 
     public:
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
     bool atleast2states() { return (states.size()>1?true:false); }
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out);
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
@@ -111,25 +134,30 @@ namespace klee {
   };
 
   class BFSSearcher : public Searcher {
-    std::deque<ExecutionState*> states;
-    std::unordered_map<ExecutionState*,int> depthMap;
-    std::unordered_map<unsigned int, std::deque<ExecutionState*>> depthStatesMap;
-    unsigned int currentMinDepth;
+    /// the states of every depth in the order they were added, each knows
+    /// its depth and position
+    std::map<unsigned, std::list<ExecutionState*> > depthStates;
+    unsigned int numStates;
+    /// the depth of the states removed from the searcher
+    enum { NotInSearcher = ~0u };
 
   public:
     BFSSearcher();
     ~BFSSearcher();
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
-    bool atleast2states() { return ((depthStatesMap[currentMinDepth]).size()>1?true:false);}
+    bool atleast2states() {
+      return !depthStates.empty() && depthStates.begin()->second.size() > 1;
+    }
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out);
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     void insertIntoDepthStateMap(ExecutionState * current);
     void removeFromDepthStateMap(ExecutionState* current);
-    void updateDepthStateMap(ExecutionState* current, int oldDepth);
-    bool empty() { return states.empty(); }
-    unsigned int getSize() { return states.size(); }
+    bool empty() { return numStates == 0; }
+    unsigned int getSize() { return numStates; }
     void printName(llvm::raw_ostream &os) {
       os << "BFSSearcher\n";
     }
@@ -142,6 +170,8 @@ namespace klee {
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
     bool atleast2states() { return (states.size()>1?true:false); }
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out);
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
@@ -160,13 +190,19 @@ namespace klee {
       InstCount,
       CPInstCount,
       MinDistToUncovered,
-      CoveringNew
+      CoveringNew,
+      /// the distance to the --error-location targets
+      MinDistToTarget
     };
 
   private:
     DiscretePDF<ExecutionState*> *states;
+    /// the states of the pdf, which can not be enumerated
+    std::list<ExecutionState*> stateList;
     WeightType type;
     bool updateWeights;
+    /// the epoch of the distances to uncovered code the weights use
+    uint64_t weightEpoch;
     
     double getWeight(ExecutionState*);
 
@@ -177,11 +213,13 @@ namespace klee {
     ExecutionState* getState2Offload();
     //bool atleast2states() { return false; }
     bool atleast2states();
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out);
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty();
-    unsigned int getSize() {return 0; }
+    unsigned int getSize() { return stateList.size(); }
     void printName(llvm::raw_ostream &os) {
       os << "WeightedRandomSearcher::";
       switch(type) {
@@ -191,6 +229,7 @@ namespace klee {
       case CPInstCount        : os << "CPInstCount\n"; return;
       case MinDistToUncovered : os << "MinDistToUncovered\n"; return;
       case CoveringNew        : os << "CoveringNew\n"; return;
+      case MinDistToTarget    : os << "MinDistToTarget\n"; return;
       default                 : os << "<unknown type>\n"; return;
       }
     }
@@ -198,6 +237,9 @@ namespace klee {
 
   class RandomPathSearcher : public Searcher {
     Executor &executor;
+    /// the states added to the searcher, which walks the process tree but
+    /// counts and donates these
+    std::set<ExecutionState*> states;
 
   public:
     RandomPathSearcher(Executor &_executor);
@@ -205,12 +247,14 @@ namespace klee {
 
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
-    bool atleast2states() { return false; }
+    bool atleast2states() { return states.size() > 1; }
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out);
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty();
-    unsigned int getSize() {return 0; }
+    unsigned int getSize() { return states.size(); }
     void printName(llvm::raw_ostream &os) {
       os << "RandomPathSearcher\n";
     }
@@ -231,12 +275,19 @@ namespace klee {
 
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
-    bool atleast2states() { return false; }
+    bool atleast2states() { return baseSearcher->atleast2states(); }
+    /// the states waiting at a merge point are not donated
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out) {
+      baseSearcher->selectStatesToOffload(k, criteria, out);
+    }
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty() && statesAtMerge.empty(); }
-    unsigned int getSize() {return 0; }
+    unsigned int getSize() {
+      return baseSearcher->getSize() + statesAtMerge.size();
+    }
     void printName(llvm::raw_ostream &os) {
       os << "MergingSearcher\n";
     }
@@ -257,12 +308,19 @@ namespace klee {
 
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
-    bool atleast2states() { return false; }
+    bool atleast2states() { return baseSearcher->atleast2states(); }
+    /// the states waiting at a merge point are not donated
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out) {
+      baseSearcher->selectStatesToOffload(k, criteria, out);
+    }
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty() && statesAtMerge.empty(); }
-    unsigned int getSize() {return 0; }
+    unsigned int getSize() {
+      return baseSearcher->getSize() + statesAtMerge.size();
+    }
     void printName(llvm::raw_ostream &os) {
       os << "BumpMergingSearcher\n";
     }
@@ -285,12 +343,16 @@ namespace klee {
 
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
-    bool atleast2states() { return false; }
+    bool atleast2states() { return baseSearcher->atleast2states(); }
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out) {
+      baseSearcher->selectStatesToOffload(k, criteria, out);
+    }
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty(); }
-    unsigned int getSize() {return 0; }
+    unsigned int getSize() { return baseSearcher->getSize(); }
     void printName(llvm::raw_ostream &os) {
       os << "<BatchingSearcher> timeBudget: " << timeBudget
          << ", instructionBudget: " << instructionBudget
@@ -311,17 +373,111 @@ namespace klee {
 
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
-    bool atleast2states() { return false; }
+    bool atleast2states() { return getSize() > 1; }
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out);
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty() && pausedStates.empty(); }
-    unsigned int getSize() { return 0; }
+    unsigned int getSize() {
+      return baseSearcher->getSize() + pausedStates.size();
+    }
     void printName(llvm::raw_ostream &os) {
       os << "IterativeDeepeningTimeSearcher\n";
     }
   };
 
+  /* sets aside the states whose next query is expected to take longer than
+   * a threshold, by the mean time of the queries issued so far in the block
+   * they are at, while the base searcher has other states; the cheapest one
+   * is resumed when it runs dry, and the most expensive ones are donated
+   * first
+   */
+  class QueryCostSearcher : public Searcher {
+    Executor &executor;
+    Searcher *baseSearcher;
+    /// in microseconds
+    double threshold;
+    /// the states set aside, cheapest first
+    std::set<std::pair<double, ExecutionState*> > deferred;
+    std::map<ExecutionState*, double> deferredCost;
+
+    double getExpectedCost(ExecutionState *es);
+    void defer(ExecutionState *es, double cost);
+
+  public:
+    QueryCostSearcher(Executor &executor, Searcher *baseSearcher,
+                      double threshold);
+    ~QueryCostSearcher();
+
+    ExecutionState &selectState() { return baseSearcher->selectState(); }
+    ExecutionState* getState2Offload();
+    bool atleast2states() { return getSize() > 1; }
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out);
+    void update(ExecutionState *current,
+                const std::vector<ExecutionState *> &addedStates,
+                const std::vector<ExecutionState *> &removedStates);
+    bool empty() { return baseSearcher->empty() && deferred.empty(); }
+    unsigned int getSize() {
+      return baseSearcher->getSize() + deferred.size();
+    }
+    void printName(llvm::raw_ostream &os) {
+      os << "<QueryCostSearcher> threshold: " << threshold
+         << "us, baseSearcher:\n";
+      baseSearcher->printName(os);
+      os << "</QueryCostSearcher>\n";
+    }
+  };
+
+  /* gives the prefix subtrees of the states (ExecutionState::subtree), one
+   * per prefix of a merged prefix packet, time slices in turn, each one
+   * searched by a base searcher of its own, so that one subtree can not
+   * starve the others; the subtree which ran the least goes next, and its
+   * states are donated first
+   */
+  class FairShareSearcher : public Searcher {
+    struct Subtree {
+      Searcher *searcher;
+      /// the seconds its slices took so far
+      double time;
+    };
+
+    std::function<Searcher *()> newSearcher;
+    double slice;
+    std::map<unsigned, Subtree> subtrees;
+    /// the subtree whose slice is running, and when it started
+    unsigned running;
+    double sliceStart;
+
+    /// the subtrees with states, the one which ran the least first
+    void getStarvedSubtrees(std::vector<Searcher *> &out);
+
+  public:
+    FairShareSearcher(const std::function<Searcher *()> &newSearcher,
+                      double slice);
+    ~FairShareSearcher();
+
+    ExecutionState &selectState();
+    ExecutionState* getState2Offload();
+    bool atleast2states() { return getSize() > 1; }
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out);
+    void update(ExecutionState *current,
+                const std::vector<ExecutionState *> &addedStates,
+                const std::vector<ExecutionState *> &removedStates);
+    bool empty() { return subtrees.empty(); }
+    unsigned int getSize();
+    void printName(llvm::raw_ostream &os) {
+      os << "<FairShareSearcher> slice: " << slice << "s, subtrees: "
+         << subtrees.size() << "\n";
+      if (!subtrees.empty())
+        subtrees.begin()->second.searcher->printName(os);
+      os << "</FairShareSearcher>\n";
+    }
+  };
+
   class InterleavedSearcher : public Searcher {
     typedef std::vector<Searcher*> searchers_ty;
 
@@ -334,12 +490,17 @@ namespace klee {
 
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
-    bool atleast2states() { return false; }
+    bool atleast2states() { return searchers[0]->atleast2states(); }
+    /// all searchers hold the same states, the first one picks them
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out) {
+      searchers[0]->selectStatesToOffload(k, criteria, out);
+    }
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return searchers[0]->empty(); }
-    unsigned int getSize() { return 0; }
+    unsigned int getSize() { return searchers[0]->getSize(); }
     
     void printName(llvm::raw_ostream &os) {
       os << "<InterleavedSearcher> containing "
@@ -363,6 +524,11 @@ namespace klee {
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
     bool atleast2states() { return (baseSearcher->atleast2states()); }
+    /// only originating states are donated
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out) {
+      baseSearcher->selectStatesToOffload(k, criteria, out);
+    }
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
@@ -398,7 +564,7 @@ namespace klee {
                 const std::vector<ExecutionState *> &removedStates);
 
     bool empty();
-    unsigned int getSize() { return 0; }
+    unsigned int getSize() { return states.size(); }
 
     void printName(llvm::raw_ostream &os) {
       os << "RandomRecoveryPath\n";
@@ -406,6 +572,29 @@ namespace klee {
 
   };
 
+  /* selects the recovery state which blocks the most states: deeper
+   * recoveries first, then the ones whose originating state covered new
+   * code, then the ones waiting the longest (ties are handled as DFS)
+   */
+  class RecoveryPrioritySearcher : public Searcher {
+    std::vector<ExecutionState *> states;
+
+    bool hasHigherPriority(ExecutionState *a, ExecutionState *b);
+
+  public:
+    ExecutionState &selectState();
+    ExecutionState* getState2Offload();
+    bool atleast2states() { return false; }
+    void update(ExecutionState *current,
+                const std::vector<ExecutionState *> &addedStates,
+                const std::vector<ExecutionState *> &removedStates);
+    bool empty() { return states.empty(); }
+    unsigned int getSize() { return states.size(); }
+    void printName(llvm::raw_ostream &os) {
+      os << "RecoveryPrioritySearcher\n";
+    }
+  };
+
   class OptimizedSplittedSearcher : public Searcher {
     Searcher *baseSearcher;
     Searcher *recoverySearcher;
@@ -423,13 +612,21 @@ namespace klee {
 
     ExecutionState &selectState();
     ExecutionState* getState2Offload();
-    bool atleast2states() { return false; }
+    bool atleast2states() { return baseSearcher->atleast2states(); }
+    /// only originating states are donated
+    void selectStatesToOffload(unsigned k, OffloadCriteria criteria,
+                               std::vector<ExecutionState *> &out) {
+      baseSearcher->selectStatesToOffload(k, criteria, out);
+    }
 
     void update(ExecutionState *current,
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty();
-    unsigned int getSize() { return 0; }
+    unsigned int getSize() {
+      return baseSearcher->getSize() + recoverySearcher->getSize() +
+             highPrioritySearcher->getSize();
+    }
     void printName(llvm::raw_ostream &os) {
       os << "OptimizedSplittedSearcher\n";
       os << "- base searcher: "; baseSearcher->printName(os);
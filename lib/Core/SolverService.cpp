@@ -0,0 +1,342 @@
+//===-- SolverService.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SolverService.h"
+
+#include "CoreStats.h"
+
+#include "klee/CommandLine.h"
+#include "klee/Constraints.h"
+#include "klee/ExprBuilder.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "expr/Parser.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <mpi.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+
+// the tags of main.cpp
+#define KILL 1
+#define SOLVE_REQ 31
+#define SOLVE_RESP 32
+
+#define MASTER_NODE 0
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+  cl::opt<int>
+  SolverRanks("solver-ranks",
+              cl::desc("Use the last N ranks as solver services, which solve "
+                       "the queries the workers expect to be expensive "
+                       "(default=0)"),
+              cl::init(0));
+
+  cl::opt<unsigned>
+  SolverServiceThreshold("solver-service-threshold",
+                         cl::desc("Send a query to a solver rank if the "
+                                  "queries of its block took at least this "
+                                  "many milliseconds on average "
+                                  "(default=100)"),
+                         cl::init(100));
+
+  /// The header of a SOLVE_REQ, followed by the binary query log records.
+  struct SolveRequest {
+    uint32_t sequence;
+    double timeout;
+  };
+
+  /// The header of a SOLVE_RESP, followed by the values of the objects if
+  /// the query has a solution.
+  struct SolveReply {
+    enum Status { Solvable, Unsolvable, Failed, Invalid };
+    uint32_t sequence;
+    unsigned char status;
+  };
+}
+
+MPI_Comm klee::runComm = MPI_COMM_WORLD;
+
+int klee::getNumSolverRanks() {
+  return SolverRanks;
+}
+
+int klee::getNumInterpreterRanks() {
+  int numCores = 1;
+  MPI_Comm_size(runComm, &numCores);
+  return numCores - SolverRanks;
+}
+
+bool klee::isSolverRank(int rank) {
+  return SolverRanks > 0 && rank >= getNumInterpreterRanks();
+}
+
+void klee::runSolverService() {
+  // one solver for all the workers, which keeps its caches warm across
+  // their queries
+  Solver *solver = createCoreSolver(CoreSolverToUse);
+  if (!solver)
+    klee_error("Failed to create core solver\n");
+  solver = createCexCachingSolver(solver);
+  solver = createCachingSolver(solver);
+  solver = createIndependentSolver(solver);
+
+  ExprBuilder *builder = createDefaultExprBuilder();
+  ArrayCache arrays;
+  // the definitions of each worker are read by a reader of its own
+  std::map<int, BinaryQueryLogReader *> readers;
+  std::vector<char> buffer;
+  while (true) {
+    MPI_Status status;
+    MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, runComm, &status);
+    int count;
+    MPI_Get_count(&status, MPI_CHAR, &count);
+    buffer.resize(std::max(count, 1));
+    MPI_Recv(&buffer[0], count, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG,
+             runComm, &status);
+    if (status.MPI_TAG == KILL && status.MPI_SOURCE == MASTER_NODE)
+      break;
+    if (status.MPI_TAG != SOLVE_REQ || count < (int)sizeof(SolveRequest))
+      continue;
+
+    SolveRequest request;
+    memcpy(&request, &buffer[0], sizeof(request));
+    BinaryQueryLogReader *&reader = readers[status.MPI_SOURCE];
+    if (!reader)
+      reader = new BinaryQueryLogReader(builder, &arrays);
+
+    SolveReply reply;
+    reply.sequence = request.sequence;
+    std::string packet;
+    expr::QueryCommand *qc = reader->readQuery(
+        &buffer[sizeof(request)], count - sizeof(request));
+    if (!qc) {
+      // the worker starts a new log after this
+      delete reader;
+      readers.erase(status.MPI_SOURCE);
+      reply.status = SolveReply::Invalid;
+    } else {
+      ConstraintManager constraints(qc->Constraints);
+      std::vector<std::vector<unsigned char> > values;
+      bool hasSolution;
+      solver->setCoreSolverTimeout(request.timeout);
+      if (!solver->impl->computeInitialValues(
+              Query(constraints, qc->Query), qc->Objects, values,
+              hasSolution)) {
+        reply.status = SolveReply::Failed;
+      } else if (hasSolution) {
+        reply.status = SolveReply::Solvable;
+        for (unsigned i = 0; i < values.size(); ++i)
+          packet.append(values[i].begin(), values[i].end());
+      } else {
+        reply.status = SolveReply::Unsolvable;
+      }
+      delete qc;
+    }
+    packet.insert(0, (const char *)&reply, sizeof(reply));
+    MPI_Send(&packet[0], packet.size(), MPI_CHAR, status.MPI_SOURCE,
+             SOLVE_RESP, runComm);
+  }
+
+  for (std::map<int, BinaryQueryLogReader *>::iterator it = readers.begin(),
+       ie = readers.end(); it != ie; ++it)
+    delete it->second;
+  delete builder;
+  delete solver;
+}
+
+void klee::stopSolverService() {
+  char dummy = 0;
+  int numCores = 1;
+  MPI_Comm_size(runComm, &numCores);
+  for (int rank = getNumInterpreterRanks(); rank < numCores; rank++)
+    MPI_Send(&dummy, 1, MPI_CHAR, rank, KILL, runComm);
+}
+
+/***/
+
+bool SolverServiceClient::shouldShip() const {
+  return expectedCost >= SolverServiceThreshold * 1000.;
+}
+
+bool SolverServiceClient::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  if (server < 0) {
+    int rank;
+    MPI_Comm_rank(runComm, &rank);
+    server = getNumInterpreterRanks() + rank % SolverRanks;
+  }
+
+  SolveRequest request;
+  request.sequence = ++sequence;
+  request.timeout = timeout;
+  std::string packet((const char *)&request, sizeof(request)), record;
+  writer.resetIfFull(packet);
+  writer.writeQuery(packet, record, BinaryQueryLogWriter::InitialValues,
+                    query, &objects);
+  packet += record;
+  MPI_Send(&packet[0], packet.size(), MPI_CHAR, server, SOLVE_REQ,
+           runComm);
+  ++stats::shippedQueries;
+
+  // the answer of a query given up on is dropped when it comes
+  double deadline = timeout ? util::getWallTime() + timeout + 1 : 0;
+  bool (*interruptCheck)() = getSolverInterruptCheck();
+  std::vector<char> buffer;
+  while (true) {
+    int flag;
+    MPI_Status status;
+    MPI_Iprobe(server, SOLVE_RESP, runComm, &flag, &status);
+    if (!flag) {
+      if ((deadline && util::getWallTime() > deadline) ||
+          (interruptCheck && interruptCheck()))
+        return false;
+      usleep(1000);
+      continue;
+    }
+
+    int count;
+    MPI_Get_count(&status, MPI_CHAR, &count);
+    buffer.resize(count);
+    MPI_Recv(&buffer[0], count, MPI_CHAR, server, SOLVE_RESP, runComm,
+             &status);
+    SolveReply reply;
+    memcpy(&reply, &buffer[0], sizeof(reply));
+    if (reply.sequence != sequence)
+      continue;
+
+    switch (reply.status) {
+    case SolveReply::Solvable: {
+      hasSolution = true;
+      values = std::vector<std::vector<unsigned char> >(objects.size());
+      const char *pos = &buffer[sizeof(reply)];
+      for (unsigned i = 0; i < objects.size(); ++i) {
+        values[i].assign(pos, pos + objects[i]->size);
+        pos += objects[i]->size;
+      }
+      return true;
+    }
+    case SolveReply::Unsolvable:
+      hasSolution = false;
+      return true;
+    case SolveReply::Invalid:
+      // the server forgot our definitions
+      writer = BinaryQueryLogWriter();
+      return false;
+    default:
+      return false;
+    }
+  }
+}
+
+/***/
+
+namespace {
+  /// Sends the queries the client picks to a solver rank, and solves the
+  /// others locally.
+  class SolverServiceSolver : public SolverImpl {
+    Solver *solver;
+    SolverServiceClient *client;
+    SolverRunStatus runStatusCode;
+
+  public:
+    SolverServiceSolver(Solver *_solver, SolverServiceClient *_client)
+      : solver(_solver), client(_client),
+        runStatusCode(SOLVER_RUN_STATUS_FAILURE) {}
+    ~SolverServiceSolver() {
+      delete solver;
+      delete client;
+    }
+
+    bool computeTruth(const Query &, bool &isValid);
+    bool computeValue(const Query &, ref<Expr> &result);
+    bool computeInitialValues(const Query &,
+                              const std::vector<const Array *> &objects,
+                              std::vector<std::vector<unsigned char> > &values,
+                              bool &hasSolution);
+    SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+    char *getConstraintLog(const Query &query) {
+      return solver->impl->getConstraintLog(query);
+    }
+    void setCoreSolverTimeout(double timeout) {
+      solver->impl->setCoreSolverTimeout(timeout);
+      client->setTimeout(timeout);
+    }
+  };
+}
+
+bool SolverServiceSolver::computeTruth(const Query &query, bool &isValid) {
+  if (!client->shouldShip()) {
+    bool success = solver->impl->computeTruth(query, isValid);
+    runStatusCode = solver->impl->getOperationStatusCode();
+    return success;
+  }
+
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+  if (!computeInitialValues(query, objects, values, hasSolution))
+    return false;
+  isValid = !hasSolution;
+  return true;
+}
+
+bool SolverServiceSolver::computeValue(const Query &query, ref<Expr> &result) {
+  if (!client->shouldShip()) {
+    bool success = solver->impl->computeValue(query, result);
+    runStatusCode = solver->impl->getOperationStatusCode();
+    return success;
+  }
+
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+  findSymbolicObjects(query.expr, objects);
+  if (!computeInitialValues(query.withFalse(), objects, values, hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+  Assignment a(objects, values);
+  result = a.evaluate(query.expr);
+  return true;
+}
+
+bool SolverServiceSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  bool success;
+  if (client->shouldShip()) {
+    success = client->computeInitialValues(query, objects, values,
+                                           hasSolution);
+    runStatusCode = !success ? SOLVER_RUN_STATUS_FAILURE
+                    : hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                                  : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  } else {
+    success = solver->impl->computeInitialValues(query, objects, values,
+                                                 hasSolution);
+    runStatusCode = solver->impl->getOperationStatusCode();
+  }
+  return success;
+}
+
+Solver *klee::createSolverServiceSolver(Solver *s,
+                                        SolverServiceClient *client) {
+  return new Solver(new SolverServiceSolver(s, client));
+}
@@ -0,0 +1,83 @@
+//===-- SolverService.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVERSERVICE_H
+#define KLEE_SOLVERSERVICE_H
+
+#include "klee/util/BinaryQueryLog.h"
+
+#include <mpi.h>
+#include <stdint.h>
+#include <vector>
+
+namespace klee {
+  class Array;
+  class Solver;
+  struct Query;
+
+  /// The ranks of this run: MPI_COMM_WORLD, or the block of it which runs
+  /// one configuration of a --campaign.
+  extern MPI_Comm runComm;
+
+  /// The number of ranks of --solver-ranks, the last ones of runComm,
+  /// which only solve the queries the others send them.
+  int getNumSolverRanks();
+
+  /// The number of the other ranks, the master and the workers.
+  int getNumInterpreterRanks();
+
+  bool isSolverRank(int rank);
+
+  /// Solve the queries sent to this rank until the master sends KILL.
+  void runSolverService();
+
+  /// Send KILL to the solver ranks, from the master.
+  void stopSolverService();
+
+  /// SolverServiceClient - Sends the queries expected to take long to a
+  /// solver rank, in the binary query log format, and waits for the answer.
+  ///
+  /// The caller sets the expected cost of each query, e.g. from the query
+  /// profile of the block issuing it.
+  class SolverServiceClient {
+    /// the rank the queries go to, -1 until the first one
+    int server;
+    /// the sequence number of the last request, stale answers are dropped
+    uint32_t sequence;
+    /// the expected cost of the next query, in microseconds
+    double expectedCost;
+    double timeout;
+    BinaryQueryLogWriter writer;
+
+  public:
+    SolverServiceClient()
+      : server(-1), sequence(0), expectedCost(0), timeout(0) {}
+
+    void setExpectedCost(double usec) { expectedCost = usec; }
+
+    void setTimeout(double _timeout) { timeout = _timeout; }
+
+    /// Whether the next query is expected to take longer than
+    /// --solver-service-threshold.
+    bool shouldShip() const;
+
+    /// Solve the query on the solver rank, as SolverImpl does. Returns false
+    /// if no answer came in time.
+    bool computeInitialValues(const Query &query,
+                              const std::vector<const Array*> &objects,
+                              std::vector<std::vector<unsigned char> > &values,
+                              bool &hasSolution);
+  };
+
+  /// Create a solver which sends the queries client->shouldShip() picks to
+  /// a solver rank and gives the others to s. It owns s and client.
+  Solver *createSolverServiceSolver(Solver *s, SolverServiceClient *client);
+}
+
+#endif
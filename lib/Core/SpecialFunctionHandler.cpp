@@ -38,6 +38,7 @@
 #include "llvm/IR/DataLayout.h"
 #endif
 
+#include <algorithm>
 #include <errno.h>
 
 using namespace llvm;
@@ -56,6 +57,14 @@ namespace {
                    cl::desc("Silently terminate paths with an infeasible "
                             "condition given to klee_assume() rather than "
                             "emitting an error (default=false)"));
+
+  cl::opt<bool>
+  NativeMemoryFunctions("native-memory-functions",
+                        cl::init(false),
+                        cl::desc("Run memcpy, memmove, memset, strlen and "
+                                 "memcmp of concrete sizes directly on the "
+                                 "memory objects, instead of interpreting "
+                                 "them byte by byte (default=false)"));
 }
 
 
@@ -92,6 +101,7 @@ static SpecialFunctionHandler::HandlerInfo handlerInfo[] = {
   add("free", handleFree, false),
   add("klee_assume", handleAssume, false),
   add("klee_check_memory_access", handleCheckMemoryAccess, false),
+  add("klee_copy_memory", handleCopyMemory, true),
   add("klee_get_valuef", handleGetValue, true),
   add("klee_get_valued", handleGetValue, true),
   add("klee_get_valuel", handleGetValue, true),
@@ -237,8 +247,179 @@ bool SpecialFunctionHandler::handle(ExecutionState &state,
   }
 }
 
+bool SpecialFunctionHandler::handleNative(ExecutionState &state,
+                                          Function *f,
+                                          KInstruction *target,
+                                          std::vector<ref<Expr> > &arguments) {
+  // as klee_copy_memory, the states of chopping track the loads and stores
+  if (!NativeMemoryFunctions || !f || state.isRecoveryState() ||
+      !state.isNormalState() || state.isInDependentMode())
+    return false;
+
+  StringRef name = f->getName();
+  if ((name == "memcpy" || name == "memmove") && arguments.size() == 3)
+    return nativeCopy(state, target, arguments);
+  if (name == "memset" && arguments.size() == 3)
+    return nativeSet(state, target, arguments);
+  if (name == "strlen" && arguments.size() == 1)
+    return nativeStrlen(state, target, arguments);
+  if (name == "memcmp" && arguments.size() == 3)
+    return nativeCompare(state, target, arguments);
+  return false;
+}
+
 /****/
 
+bool SpecialFunctionHandler::resolveRange(ExecutionState &state,
+                                          ref<Expr> address, uint64_t n,
+                                          const MemoryObject *&mo,
+                                          const ObjectState *&os,
+                                          unsigned &offset) {
+  address = executor.toUnique(state, address);
+  ref<ConstantExpr> ce = dyn_cast<ConstantExpr>(address);
+  ObjectPair op;
+  if (ce.isNull() || !state.addressSpace.resolveOne(ce, op))
+    return false;
+  uint64_t at = ce->getZExtValue() - op.first->address;
+  if (at > op.first->size || n > op.first->size - at)
+    return false;
+  mo = op.first;
+  os = op.second;
+  offset = at;
+  return true;
+}
+
+void SpecialFunctionHandler::copyBytes(ExecutionState &state,
+                                       const MemoryObject *dstMo,
+                                       const ObjectState *dstOs,
+                                       unsigned dstOffset,
+                                       const MemoryObject *srcMo,
+                                       const ObjectState *srcOs,
+                                       unsigned srcOffset, unsigned n) {
+  ObjectState *wos = state.addressSpace.getWriteable(dstMo, dstOs);
+  if (srcMo != dstMo || dstOffset <= srcOffset || dstOffset >= srcOffset + n) {
+    wos->copyFrom(dstOffset, srcMo == dstMo ? *wos : *srcOs, srcOffset, n);
+    return;
+  }
+  // a move up within the object goes backwards, in steps which do not
+  // overlap their sources
+  unsigned step = dstOffset - srcOffset;
+  while (n) {
+    unsigned len = std::min(n, step);
+    n -= len;
+    wos->copyFrom(dstOffset + n, *wos, srcOffset + n, len);
+  }
+}
+
+bool SpecialFunctionHandler::nativeCopy(ExecutionState &state,
+                                        KInstruction *target,
+                                        std::vector<ref<Expr> > &arguments) {
+  ref<ConstantExpr> n =
+      dyn_cast<ConstantExpr>(executor.toUnique(state, arguments[2]));
+  if (n.isNull())
+    return false;
+  uint64_t size = n->getZExtValue();
+  const MemoryObject *dstMo, *srcMo;
+  const ObjectState *dstOs, *srcOs;
+  unsigned dstOffset, srcOffset;
+  if (!resolveRange(state, arguments[0], size, dstMo, dstOs, dstOffset) ||
+      !resolveRange(state, arguments[1], size, srcMo, srcOs, srcOffset) ||
+      dstOs->readOnly)
+    return false;
+
+  if (size)
+    copyBytes(state, dstMo, dstOs, dstOffset, srcMo, srcOs, srcOffset, size);
+  executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
+bool SpecialFunctionHandler::nativeSet(ExecutionState &state,
+                                       KInstruction *target,
+                                       std::vector<ref<Expr> > &arguments) {
+  ref<ConstantExpr> n =
+      dyn_cast<ConstantExpr>(executor.toUnique(state, arguments[2]));
+  if (n.isNull())
+    return false;
+  uint64_t size = n->getZExtValue();
+  const MemoryObject *mo;
+  const ObjectState *os;
+  unsigned offset;
+  if (!resolveRange(state, arguments[0], size, mo, os, offset) || os->readOnly)
+    return false;
+
+  if (size) {
+    ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+    wos->fill(offset, ExtractExpr::create(arguments[1], 0, Expr::Int8), size);
+  }
+  executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
+bool SpecialFunctionHandler::nativeStrlen(ExecutionState &state,
+                                          KInstruction *target,
+                                          std::vector<ref<Expr> > &arguments) {
+  const MemoryObject *mo;
+  const ObjectState *os;
+  unsigned offset;
+  if (!resolveRange(state, arguments[0], 1, mo, os, offset))
+    return false;
+
+  // a symbolic byte before the terminator forks, as does the function
+  for (unsigned i = offset; i < mo->size; ++i) {
+    ref<ConstantExpr> byte = dyn_cast<ConstantExpr>(os->read8(i));
+    if (byte.isNull())
+      return false;
+    if (byte->isZero()) {
+      Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+      executor.bindLocal(target, state,
+                         ConstantExpr::create(i - offset, width));
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SpecialFunctionHandler::nativeCompare(ExecutionState &state,
+                                           KInstruction *target,
+                                           std::vector<ref<Expr> > &arguments) {
+  ref<ConstantExpr> n =
+      dyn_cast<ConstantExpr>(executor.toUnique(state, arguments[2]));
+  if (n.isNull())
+    return false;
+  uint64_t size = n->getZExtValue();
+  const MemoryObject *mo1, *mo2;
+  const ObjectState *os1, *os2;
+  unsigned offset1, offset2;
+  if (!resolveRange(state, arguments[0], size, mo1, os1, offset1) ||
+      !resolveRange(state, arguments[1], size, mo2, os2, offset2))
+    return false;
+
+  // up to the first concrete difference, the pairs of bytes which may
+  // differ decide in order, so the result is built from the last back
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  ref<Expr> result = ConstantExpr::create(0, width);
+  std::vector<std::pair<ref<Expr>, ref<Expr> > > pairs;
+  for (unsigned i = 0; i < size; ++i) {
+    ref<Expr> a = os1->read8(offset1 + i), b = os2->read8(offset2 + i);
+    if (a == b)
+      continue;
+    if (isa<ConstantExpr>(a) && isa<ConstantExpr>(b)) {
+      result = SubExpr::create(ZExtExpr::create(a, width),
+                               ZExtExpr::create(b, width));
+      break;
+    }
+    pairs.push_back(std::make_pair(a, b));
+  }
+  for (unsigned i = pairs.size(); i > 0; --i) {
+    ref<Expr> a = pairs[i - 1].first, b = pairs[i - 1].second;
+    result = SelectExpr::create(EqExpr::create(a, b), result,
+                                SubExpr::create(ZExtExpr::create(a, width),
+                                                ZExtExpr::create(b, width)));
+  }
+  executor.bindLocal(target, state, result);
+  return true;
+}
+
 // reads a concrete string from memory
 std::string 
 SpecialFunctionHandler::readStringAtAddress(ExecutionState &state, 
@@ -555,6 +736,37 @@ void SpecialFunctionHandler::handleGetObjSize(ExecutionState &state,
   }
 }
 
+void SpecialFunctionHandler::handleCopyMemory(ExecutionState &state,
+                                              KInstruction *target,
+                                              std::vector<ref<Expr> > &arguments) {
+  assert(arguments.size()==3 &&
+         "invalid number of arguments to klee_copy_memory");
+  Expr::Width width =
+      executor.kmodule->targetData->getTypeSizeInBits(target->inst->getType());
+
+  // Only concrete, in bounds copies are done here. The caller copies the
+  // others itself, so that their errors are reported as usual, and so do
+  // the states of chopping, which track the loads and stores.
+  ref<ConstantExpr> dst = dyn_cast<ConstantExpr>(arguments[0]);
+  ref<ConstantExpr> src = dyn_cast<ConstantExpr>(arguments[1]);
+  ref<ConstantExpr> n = dyn_cast<ConstantExpr>(arguments[2]);
+  const MemoryObject *dstMo, *srcMo;
+  const ObjectState *dstOs, *srcOs;
+  unsigned dstOffset, srcOffset;
+  bool copied = false;
+  if (!dst.isNull() && !src.isNull() && !n.isNull() &&
+      !state.isRecoveryState() && state.isNormalState() &&
+      !state.isInDependentMode() &&
+      resolveRange(state, dst, n->getZExtValue(), dstMo, dstOs, dstOffset) &&
+      resolveRange(state, src, n->getZExtValue(), srcMo, srcOs, srcOffset) &&
+      !dstOs->readOnly) {
+    copyBytes(state, dstMo, dstOs, dstOffset, srcMo, srcOs, srcOffset,
+              n->getZExtValue());
+    copied = true;
+  }
+  executor.bindLocal(target, state, ConstantExpr::create(copied, width));
+}
+
 void SpecialFunctionHandler::handleGetErrno(ExecutionState &state,
                                             KInstruction *target,
                                             std::vector<ref<Expr> > &arguments) {
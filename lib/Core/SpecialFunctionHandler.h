@@ -10,6 +10,8 @@
 #ifndef KLEE_SPECIALFUNCTIONHANDLER_H
 #define KLEE_SPECIALFUNCTIONHANDLER_H
 
+#include "llvm/ADT/DenseMap.h"
+
 #include <iterator>
 #include <map>
 #include <vector>
@@ -24,6 +26,8 @@ namespace klee {
   class Expr;
   class ExecutionState;
   struct KInstruction;
+  class MemoryObject;
+  class ObjectState;
   template<typename T> class ref;
   
   class SpecialFunctionHandler {
@@ -32,8 +36,8 @@ namespace klee {
                                                     KInstruction *target, 
                                                     std::vector<ref<Expr> > 
                                                       &arguments);
-    typedef std::map<const llvm::Function*, 
-                     std::pair<Handler,bool> > handlers_ty;
+    typedef llvm::DenseMap<const llvm::Function*,
+                           std::pair<Handler,bool> > handlers_ty;
 
     handlers_ty handlers;
     class Executor &executor;
@@ -88,9 +92,43 @@ namespace klee {
                 KInstruction *target,
                 std::vector< ref<Expr> > &arguments);
 
+    /// Whether calls to f are handled internally.
+    bool isHandled(const llvm::Function *f) const { return handlers.count(f); }
+
+    /// Run a call to memcpy, memmove, memset, strlen or memcmp directly on
+    /// the object states, with --native-memory-functions. \return false
+    /// if the call is left to the function itself: for other functions,
+    /// symbolic sizes and accesses out of bounds, which then report their
+    /// errors as usual.
+    bool handleNative(ExecutionState &state,
+                      llvm::Function *f,
+                      KInstruction *target,
+                      std::vector< ref<Expr> > &arguments);
+
     /* Convenience routines */
 
     std::string readStringAtAddress(ExecutionState &state, ref<Expr> address);
+
+    /// Resolve the n bytes at address to a single object, without forking.
+    bool resolveRange(ExecutionState &state, ref<Expr> address, uint64_t n,
+                      const MemoryObject *&mo, const ObjectState *&os,
+                      unsigned &offset);
+
+    /// Copy n bytes between resolved objects, as memmove.
+    void copyBytes(ExecutionState &state,
+                   const MemoryObject *dstMo, const ObjectState *dstOs,
+                   unsigned dstOffset,
+                   const MemoryObject *srcMo, const ObjectState *srcOs,
+                   unsigned srcOffset, unsigned n);
+
+    bool nativeCopy(ExecutionState &state, KInstruction *target,
+                    std::vector< ref<Expr> > &arguments);
+    bool nativeSet(ExecutionState &state, KInstruction *target,
+                   std::vector< ref<Expr> > &arguments);
+    bool nativeStrlen(ExecutionState &state, KInstruction *target,
+                      std::vector< ref<Expr> > &arguments);
+    bool nativeCompare(ExecutionState &state, KInstruction *target,
+                       std::vector< ref<Expr> > &arguments);
     
     /* Handlers */
 
@@ -103,6 +141,7 @@ namespace klee {
     HANDLER(handleAssume);
     HANDLER(handleCalloc);
     HANDLER(handleCheckMemoryAccess);
+    HANDLER(handleCopyMemory);
     HANDLER(handleDefineFixedObject);
     HANDLER(handleDelete);    
     HANDLER(handleDeleteArray);
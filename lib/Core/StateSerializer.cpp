@@ -0,0 +1,576 @@
+//===-- StateSerializer.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateSerializer.h"
+#include "Executor.h"
+#include "Memory.h"
+#include "MemoryManager.h"
+#include "StatsTracker.h"
+
+#include "expr/Parser.h"
+#include "klee/ExecutionState.h"
+#include "klee/ExprBuilder.h"
+#include "klee/util/ExprPPrinter.h"
+#include "klee/Internal/Module/Cell.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <string.h>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+const char StatePacketMagic[4] = {'K', 'S', 'T', '1'};
+
+enum AllocSiteKind {
+  AllocSiteNone,
+  AllocSiteGlobal,
+  AllocSiteInstruction,
+};
+
+class ByteWriter {
+  std::vector<char> &out;
+
+public:
+  ByteWriter(std::vector<char> &_out) : out(_out) {}
+
+  void writeU8(uint8_t v) { out.push_back((char)v); }
+  void writeU32(uint32_t v) {
+    for (unsigned i = 0; i < 4; ++i)
+      out.push_back((char)(v >> (8 * i)));
+  }
+  void writeU64(uint64_t v) {
+    for (unsigned i = 0; i < 8; ++i)
+      out.push_back((char)(v >> (8 * i)));
+  }
+  void writeString(const std::string &s) {
+    writeU32(s.size());
+    out.insert(out.end(), s.begin(), s.end());
+  }
+  void patchU32(size_t pos, uint32_t v) {
+    for (unsigned i = 0; i < 4; ++i)
+      out[pos + i] = (char)(v >> (8 * i));
+  }
+  size_t size() const { return out.size(); }
+};
+
+class ByteReader {
+  const unsigned char *pos, *end;
+  bool valid;
+
+  bool has(size_t n) {
+    if (!valid || (size_t)(end - pos) < n)
+      valid = false;
+    return valid;
+  }
+
+public:
+  ByteReader(const char *buffer, size_t size)
+      : pos((const unsigned char *)buffer),
+        end((const unsigned char *)buffer + size), valid(true) {}
+
+  bool ok() const { return valid; }
+
+  uint8_t readU8() { return has(1) ? *pos++ : 0; }
+  uint32_t readU32() {
+    if (!has(4))
+      return 0;
+    uint32_t v = 0;
+    for (unsigned i = 0; i < 4; ++i)
+      v |= (uint32_t)*pos++ << (8 * i);
+    return v;
+  }
+  uint64_t readU64() {
+    if (!has(8))
+      return 0;
+    uint64_t v = 0;
+    for (unsigned i = 0; i < 8; ++i)
+      v |= (uint64_t)*pos++ << (8 * i);
+    return v;
+  }
+  std::string readString() {
+    uint32_t n = readU32();
+    if (!has(n))
+      return std::string();
+    std::string s((const char *)pos, n);
+    pos += n;
+    return s;
+  }
+  const char *readBytes(size_t n) {
+    if (!has(n))
+      return 0;
+    const char *p = (const char *)pos;
+    pos += n;
+    return p;
+  }
+};
+
+/// Per-state encoder; collects every expression of the state into one list
+/// which is printed as the value list of a KQuery query.
+class StateWriter {
+  KModule *kmodule;
+  std::map<const KFunction *, std::map<const Instruction *, unsigned> >
+      instIndices;
+
+public:
+  std::vector<ref<Expr> > exprs;
+
+  StateWriter(KModule *_kmodule) : kmodule(_kmodule) {
+    // Slot 0 is never referenced, it only guarantees that the value list is
+    // printed (and with it the array declarations).
+    exprs.push_back(ConstantExpr::alloc(0, Expr::Bool));
+  }
+
+  uint32_t addExpr(ref<Expr> e) {
+    if (e.isNull())
+      return 0;
+    exprs.push_back(e);
+    return exprs.size() - 1;
+  }
+
+  bool findInstruction(const Instruction *inst, KFunction *&kf,
+                       unsigned &index) {
+    Function *f = const_cast<Function *>(inst->getParent()->getParent());
+    std::map<Function *, KFunction *>::iterator it =
+        kmodule->functionMap.find(f);
+    if (it == kmodule->functionMap.end())
+      return false;
+    kf = it->second;
+
+    std::map<const Instruction *, unsigned> &indices = instIndices[kf];
+    if (indices.empty()) {
+      for (unsigned i = 0; i < kf->numInstructions; ++i)
+        indices[kf->instructions[i]->inst] = i;
+    }
+    std::map<const Instruction *, unsigned>::iterator ii = indices.find(inst);
+    if (ii == indices.end())
+      return false;
+    index = ii->second;
+    return true;
+  }
+
+  void writeInstruction(ByteWriter &w, KInstruction *ki) {
+    KFunction *kf;
+    unsigned index;
+    if (!ki || !findInstruction(ki->inst, kf, index)) {
+      w.writeString("");
+      return;
+    }
+    w.writeString(kf->function->getName());
+    w.writeU32(index);
+  }
+
+  void writeAllocSite(ByteWriter &w, const Value *allocSite) {
+    KFunction *kf;
+    unsigned index;
+    if (const GlobalValue *gv = dyn_cast_or_null<GlobalValue>(allocSite)) {
+      w.writeU8(AllocSiteGlobal);
+      w.writeString(gv->getName());
+    } else if (const Instruction *inst =
+                   dyn_cast_or_null<Instruction>(allocSite)) {
+      if (findInstruction(inst, kf, index)) {
+        w.writeU8(AllocSiteInstruction);
+        w.writeString(kf->function->getName());
+        w.writeU32(index);
+      } else {
+        w.writeU8(AllocSiteNone);
+      }
+    } else {
+      w.writeU8(AllocSiteNone);
+    }
+  }
+};
+
+class StateReader {
+  KModule *kmodule;
+
+public:
+  std::vector<ref<Expr> > exprs;
+
+  StateReader(KModule *_kmodule) : kmodule(_kmodule) {}
+
+  ref<Expr> getExpr(uint32_t index, bool &ok) {
+    if (index == 0)
+      return ref<Expr>();
+    if (index >= exprs.size()) {
+      ok = false;
+      return ref<Expr>();
+    }
+    return exprs[index];
+  }
+
+  KFunction *getFunction(const std::string &name) {
+    Function *f = kmodule->module->getFunction(name);
+    if (!f)
+      return 0;
+    std::map<Function *, KFunction *>::iterator it =
+        kmodule->functionMap.find(f);
+    return it == kmodule->functionMap.end() ? 0 : it->second;
+  }
+
+  /// Returns a null iterator for an empty or unknown location.
+  KInstIterator readInstruction(ByteReader &r) {
+    std::string name = r.readString();
+    if (name.empty())
+      return KInstIterator();
+    unsigned index = r.readU32();
+    KFunction *kf = getFunction(name);
+    if (!kf || index >= kf->numInstructions)
+      return KInstIterator();
+    return KInstIterator(kf->instructions + index);
+  }
+
+  const Value *readAllocSite(ByteReader &r) {
+    uint8_t kind = r.readU8();
+    if (kind == AllocSiteGlobal) {
+      std::string name = r.readString();
+      return kmodule->module->getNamedValue(name);
+    } else if (kind == AllocSiteInstruction) {
+      std::string name = r.readString();
+      unsigned index = r.readU32();
+      KFunction *kf = getFunction(name);
+      if (!kf || index >= kf->numInstructions)
+        return 0;
+      return kf->instructions[index]->inst;
+    }
+    return 0;
+  }
+};
+}
+
+bool StateSerializer::canSerialize(ExecutionState &state) {
+  return state.isNormalState() && !state.isRecoveryState() &&
+         state.isResumed() && !state.isInDependentMode() &&
+         !state.getRecoveryState() && !state.hasPendingRecoveryInfo() &&
+         state.getPrefixesSize() == 0;
+}
+
+bool StateSerializer::isStatePacket(const char *buffer, size_t size) {
+  return size >= sizeof(StatePacketMagic) &&
+         memcmp(buffer, StatePacketMagic, sizeof(StatePacketMagic)) == 0;
+}
+
+void StateSerializer::serializeStates(
+    const std::vector<ExecutionState *> &states, std::vector<char> &out) {
+  ByteWriter w(out);
+  out.insert(out.end(), StatePacketMagic,
+             StatePacketMagic + sizeof(StatePacketMagic));
+  w.writeU32(states.size());
+
+  for (std::vector<ExecutionState *>::const_iterator it = states.begin(),
+                                                     ie = states.end();
+       it != ie; ++it) {
+    ExecutionState &state = **it;
+    assert(canSerialize(state) && "state must not carry recovery data");
+    StateWriter sw(executor.kmodule);
+    std::vector<char> body;
+    ByteWriter bw(body);
+
+    bw.writeU32(state.depth);
+    bw.writeU32(state.actDepth);
+    bw.writeU32(state.branchHist.size());
+    std::vector<char> hist = state.branchHist.toVector();
+    body.insert(body.end(), hist.begin(), hist.end());
+
+    sw.writeInstruction(bw, state.pc);
+    sw.writeInstruction(bw, state.prevPC);
+    bw.writeU32(state.incomingBBIndex);
+
+    bw.writeU32(state.stack.size());
+    for (ExecutionState::stack_ty::iterator sfIt = state.stack.begin(),
+                                            sfIe = state.stack.end();
+         sfIt != sfIe; ++sfIt) {
+      StackFrame &sf = *sfIt;
+      bw.writeString(sf.kf->function->getName());
+      sw.writeInstruction(bw, sf.caller);
+      bw.writeU32(sf.kf->numRegisters);
+      for (unsigned i = 0; i < sf.kf->numRegisters; ++i)
+        bw.writeU32(sw.addExpr(sf.getLocals()[i].value));
+      bw.writeU32(sf.allocas.size());
+      for (unsigned i = 0; i < sf.allocas.size(); ++i)
+        bw.writeU64(sf.allocas[i]->address);
+      bw.writeU64(sf.varargs ? sf.varargs->address : 0);
+    }
+
+    size_t numObjectsPos = bw.size();
+    bw.writeU32(0);
+    unsigned numObjects = 0;
+    for (MemoryMap::iterator oi = state.addressSpace.objects.begin(),
+                             oe = state.addressSpace.objects.end();
+         oi != oe; ++oi) {
+      const MemoryObject *mo = oi->first;
+      const ObjectState *os = oi->second;
+      bw.writeU64(mo->address);
+      bw.writeU32(mo->size);
+      bw.writeU8((mo->isLocal ? 1 : 0) | (mo->isGlobal ? 2 : 0) |
+                 (mo->isFixed ? 4 : 0) | (mo->isUserSpecified ? 8 : 0) |
+                 (os->readOnly ? 16 : 0));
+      bw.writeString(mo->name);
+      sw.writeAllocSite(bw, mo->allocSite);
+      for (unsigned i = 0; i < os->size; ++i) {
+        ref<Expr> byte = os->read8(i);
+        if (ConstantExpr *ce = dyn_cast<ConstantExpr>(byte)) {
+          bw.writeU8(0);
+          bw.writeU8(ce->getZExtValue(8));
+        } else {
+          bw.writeU8(1);
+          bw.writeU32(sw.addExpr(byte));
+        }
+      }
+      ++numObjects;
+    }
+    bw.patchU32(numObjectsPos, numObjects);
+
+    std::vector<const Array *> arrays;
+    bw.writeU32(state.symbolics->size());
+    for (unsigned i = 0; i < state.symbolics->size(); ++i) {
+      bw.writeU64((*state.symbolics)[i].first->address);
+      arrays.push_back((*state.symbolics)[i].second);
+    }
+
+    std::string query;
+    llvm::raw_string_ostream os(query);
+    ExprPPrinter::printQuery(os, state.constraints,
+                             ConstantExpr::alloc(0, Expr::Bool),
+                             &sw.exprs[0], &sw.exprs[0] + sw.exprs.size(),
+                             arrays.empty() ? 0 : &arrays[0],
+                             arrays.empty() ? 0 : &arrays[0] + arrays.size());
+    os.flush();
+
+    w.writeU32(body.size());
+    out.insert(out.end(), body.begin(), body.end());
+    w.writeString(query);
+  }
+}
+
+bool StateSerializer::deserializeStates(const char *buffer, size_t size,
+                                        const ExecutionState &templateState,
+                                        std::vector<ExecutionState *> &out) {
+  if (!isStatePacket(buffer, size))
+    return false;
+
+  ByteReader r(buffer + sizeof(StatePacketMagic),
+               size - sizeof(StatePacketMagic));
+  uint32_t numStates = r.readU32();
+  std::vector<ExecutionState *> result;
+  bool ok = r.ok();
+
+  for (uint32_t s = 0; ok && s < numStates; ++s) {
+    uint32_t bodySize = r.readU32();
+    const char *body = r.readBytes(bodySize);
+    std::string query = r.readString();
+    if (!r.ok()) {
+      ok = false;
+      break;
+    }
+
+    // Parse the expressions first, the state body refers to them by index.
+    StateReader sr(executor.kmodule);
+    std::vector<ref<Expr> > constraints;
+    std::vector<const Array *> arrays;
+    MemoryBuffer *MB = MemoryBuffer::getMemBuffer(query);
+    ExprBuilder *builder = createDefaultExprBuilder();
+    expr::Parser *P = expr::Parser::Create("offloaded state", MB, builder,
+                                           false, &executor.arrayCache);
+    P->SetMaxErrors(1);
+    bool foundQuery = false;
+    while (expr::Decl *D = P->ParseTopLevelDecl()) {
+      if (expr::QueryCommand *QC = dyn_cast<expr::QueryCommand>(D)) {
+        constraints = QC->Constraints;
+        sr.exprs = QC->Values;
+        arrays = QC->Objects;
+        foundQuery = true;
+      }
+      delete D;
+    }
+    bool parsed = foundQuery && P->GetNumErrors() == 0;
+    delete P;
+    delete builder;
+    delete MB;
+    if (!parsed) {
+      klee_warning("offloaded state: malformed expression list");
+      ok = false;
+      break;
+    }
+
+    ExecutionState *state = new ExecutionState(templateState);
+    result.push_back(state);
+    state->ptreeNode = 0;
+    state->clearPrefixes();
+    state->constraints = ConstraintManager(constraints);
+    while (!state->stack.empty())
+      state->popFrame();
+
+    ByteReader br(body, bodySize);
+    state->depth = br.readU32();
+    state->actDepth = br.readU32();
+    uint32_t histSize = br.readU32();
+    if (const char *hist = br.readBytes(histSize))
+      state->branchHist.assign(hist, hist + histSize);
+    state->pc = sr.readInstruction(br);
+    state->prevPC = sr.readInstruction(br);
+    state->incomingBBIndex = br.readU32();
+
+    // Frames are rebuilt before the objects they refer to, so just remember
+    // the addresses for now.
+    uint32_t numFrames = br.readU32();
+    std::vector<std::vector<uint64_t> > allocaAddrs(numFrames);
+    std::vector<uint64_t> varargsAddrs(numFrames);
+    for (uint32_t f = 0; ok && f < numFrames; ++f) {
+      KFunction *kf = sr.getFunction(br.readString());
+      KInstIterator caller = sr.readInstruction(br);
+      uint32_t numRegisters = br.readU32();
+      if (!kf || numRegisters != kf->numRegisters) {
+        ok = false;
+        break;
+      }
+      executor.kmodule->infos->loadFunction(kf->function);
+      state->pushFrame(caller, kf);
+      if (executor.statsTracker)
+        executor.statsTracker->framePushed(*state,
+                                           f ? &state->stack[f - 1] : 0);
+      Cell *locals = state->stack.back().getWritableLocals();
+      for (unsigned i = 0; i < numRegisters; ++i)
+        locals[i].value = sr.getExpr(br.readU32(), ok);
+      uint32_t numAllocas = br.readU32();
+      for (uint32_t i = 0; br.ok() && i < numAllocas; ++i)
+        allocaAddrs[f].push_back(br.readU64());
+      varargsAddrs[f] = br.readU64();
+    }
+    if (!ok || !br.ok() || !state->pc || state->stack.empty()) {
+      ok = false;
+      break;
+    }
+
+    // Objects shared with the template (globals, argv, environment) are kept
+    // and only get their contents replaced.
+    std::map<uint64_t, const MemoryObject *> existing;
+    for (MemoryMap::iterator oi = state->addressSpace.objects.begin(),
+                             oe = state->addressSpace.objects.end();
+         oi != oe; ++oi)
+      existing[oi->first->address] = oi->first;
+
+    std::map<uint64_t, const MemoryObject *> objectsByAddr;
+    uint32_t numObjects = br.readU32();
+    for (uint32_t o = 0; ok && br.ok() && o < numObjects; ++o) {
+      uint64_t address = br.readU64();
+      uint32_t objSize = br.readU32();
+      uint8_t flags = br.readU8();
+      std::string name = br.readString();
+      const Value *allocSite = sr.readAllocSite(br);
+
+      const MemoryObject *mo = 0;
+      std::map<uint64_t, const MemoryObject *>::iterator ei =
+          existing.find(address);
+      if (ei != existing.end() && ei->second->size == objSize) {
+        mo = ei->second;
+        existing.erase(ei);
+      } else {
+        MemoryObject *newMo =
+            (flags & 4)
+                ? executor.memory->allocateFixed(address, objSize, allocSite)
+                : executor.memory->allocateAt(address, objSize, flags & 1,
+                                              flags & 2, allocSite);
+        if (!newMo) {
+          ok = false;
+          break;
+        }
+        newMo->isUserSpecified = (flags & 8) != 0;
+        mo = newMo;
+      }
+      mo->setName(name);
+
+      ObjectState *os = new ObjectState(mo);
+      for (unsigned i = 0; i < objSize; ++i) {
+        if (br.readU8() == 0) {
+          os->write8(i, br.readU8());
+        } else {
+          ref<Expr> byte = sr.getExpr(br.readU32(), ok);
+          if (byte.isNull() || byte->getWidth() != Expr::Int8) {
+            ok = false;
+            break;
+          }
+          os->write(i, byte);
+        }
+      }
+      os->setReadOnly(flags & 16);
+      state->addressSpace.bindObject(mo, os);
+      objectsByAddr[address] = mo;
+    }
+    if (!ok || !br.ok())
+      break;
+
+    // Whatever the donor did not have any more is gone in this state too.
+    for (std::map<uint64_t, const MemoryObject *>::iterator
+             ei = existing.begin(),
+             ee = existing.end();
+         ei != ee; ++ei)
+      state->addressSpace.unbindObject(ei->second);
+
+    for (uint32_t f = 0; ok && f < numFrames; ++f) {
+      StackFrame &sf = state->stack[f];
+      for (unsigned i = 0; i < allocaAddrs[f].size(); ++i) {
+        std::map<uint64_t, const MemoryObject *>::iterator mi =
+            objectsByAddr.find(allocaAddrs[f][i]);
+        if (mi == objectsByAddr.end()) {
+          ok = false;
+          break;
+        }
+        sf.allocas.push_back(mi->second);
+      }
+      if (varargsAddrs[f]) {
+        std::map<uint64_t, const MemoryObject *>::iterator mi =
+            objectsByAddr.find(varargsAddrs[f]);
+        if (mi == objectsByAddr.end())
+          ok = false;
+        else
+          sf.varargs = const_cast<MemoryObject *>(mi->second);
+      }
+    }
+
+    uint32_t numSymbolics = br.readU32();
+    if (numSymbolics != arrays.size())
+      ok = false;
+    for (uint32_t i = 0; ok && i < numSymbolics; ++i) {
+      std::map<uint64_t, const MemoryObject *>::iterator mi =
+          objectsByAddr.find(br.readU64());
+      if (mi == objectsByAddr.end()) {
+        ok = false;
+        break;
+      }
+      state->addSymbolic(mi->second, arrays[i]);
+      state->arrayNames.write().insert(arrays[i]->name);
+    }
+    ok = ok && br.ok();
+  }
+  ok = ok && r.ok();
+
+  if (!ok) {
+    klee_warning("dropping malformed offloaded state packet");
+    for (std::vector<ExecutionState *>::iterator it = result.begin(),
+                                                 ie = result.end();
+         it != ie; ++it)
+      delete *it;
+    return false;
+  }
+
+  out.insert(out.end(), result.begin(), result.end());
+  return true;
+}
@@ -0,0 +1,56 @@
+//===-- StateSerializer.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESERIALIZER_H
+#define KLEE_STATESERIALIZER_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace klee {
+class ExecutionState;
+class Executor;
+
+/// StateSerializer - Flattens normal execution states into a byte buffer
+/// and rebuilds them inside another process running the same module.
+///
+/// A serialized state carries its path constraints, address space, stack,
+/// symbolics and branch history; expressions are encoded as a single KQuery
+/// query. Objects are recreated at their original addresses, so both sides
+/// must use deterministic allocation (the default in distributed runs).
+class StateSerializer {
+  Executor &executor;
+
+public:
+  StateSerializer(Executor &_executor) : executor(_executor) {}
+
+  /// Returns true if the state can be shipped without its Chopper
+  /// bookkeeping, i.e. it is a resumed normal state that is not ranging
+  /// over a prefix and has no snapshots, recoveries or dependent state.
+  static bool canSerialize(ExecutionState &state);
+
+  /// Append a packet holding all the given states to out.
+  void serializeStates(const std::vector<ExecutionState *> &states,
+                       std::vector<char> &out);
+
+  /// Returns true if buffer holds a packet written by serializeStates.
+  static bool isStatePacket(const char *buffer, size_t size);
+
+  /// Rebuild the states of a packet. Every state is created as a copy of
+  /// templateState (the initial state of this process), whose global
+  /// objects are reused.
+  ///
+  /// \return false if the packet is malformed; out is left unchanged.
+  bool deserializeStates(const char *buffer, size_t size,
+                         const ExecutionState &templateState,
+                         std::vector<ExecutionState *> &out);
+};
+}
+
+#endif
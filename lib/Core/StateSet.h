@@ -0,0 +1,90 @@
+//===-- StateSet.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESET_H
+#define KLEE_STATESET_H
+
+#include "klee/ExecutionState.h"
+
+#include <cassert>
+#include <vector>
+
+namespace klee {
+  /// StateSet - A set of states in a dense vector, for the sets the
+  /// executor updates on every fork and termination.
+  ///
+  /// The states keep their position in each kind of set
+  /// (ExecutionState::stateSetIndex), so insertion, removal and lookup take
+  /// constant time. A position is only trusted if the set holds the state
+  /// there, so copies of a state and sets cleared without telling the
+  /// states need no care. A removal moves the last state into the hole:
+  /// the order is arbitrary, as the pointer order of a std::set was.
+  class StateSet {
+  public:
+    /// The kinds of sets, a state is in at most one set of each.
+    enum Kind { All, NonRecovery, Offload, NumKinds };
+
+    typedef std::vector<ExecutionState *>::const_iterator iterator;
+    typedef iterator const_iterator;
+
+  private:
+    std::vector<ExecutionState *> items;
+    Kind kind;
+
+  public:
+    explicit StateSet(Kind _kind) : kind(_kind) {}
+
+    iterator begin() const { return items.begin(); }
+    iterator end() const { return items.end(); }
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+
+    bool count(const ExecutionState *es) const {
+      unsigned index = es->stateSetIndex[kind];
+      return index < items.size() && items[index] == es;
+    }
+
+    iterator find(const ExecutionState *es) const {
+      return count(es) ? items.begin() + es->stateSetIndex[kind] : end();
+    }
+
+    /// Returns false if the state was in the set already.
+    bool insert(ExecutionState *es) {
+      if (count(es))
+        return false;
+      es->stateSetIndex[kind] = items.size();
+      items.push_back(es);
+      return true;
+    }
+
+    void erase(iterator it) {
+      assert(it != end() && "erasing past the end");
+      unsigned index = it - items.begin();
+      items[index] = items.back();
+      items[index]->stateSetIndex[kind] = index;
+      items.pop_back();
+    }
+
+    /// Returns false if the state was not in the set.
+    bool erase(const ExecutionState *es) {
+      iterator it = find(es);
+      if (it == end())
+        return false;
+      erase(it);
+      return true;
+    }
+
+    /// Make room for n more states, ahead of a batch of insertions.
+    void reserve(size_t n) { items.reserve(items.size() + n); }
+
+    void clear() { items.clear(); }
+  };
+}
+
+#endif
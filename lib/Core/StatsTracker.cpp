@@ -20,11 +20,13 @@
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/SolverStats.h"
+#include "klee/util/NodeAllocator.h"
 
 #include "CallPathManager.h"
 #include "CoreStats.h"
 #include "Executor.h"
 #include "MemoryManager.h"
+#include "PTree.h"
 #include "UserSearcher.h"
 
 #if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
@@ -57,7 +59,11 @@
 #include "llvm/IR/CFG.h"
 #endif
 
+#include <algorithm>
 #include <fstream>
+#include <map>
+#include <math.h>
+#include <set>
 #include <unistd.h>
 
 using namespace klee;
@@ -101,6 +107,13 @@ namespace {
       cl::desc("Write istats after each n instructions, 0 to disable "
                "(default=0)"));
 
+  cl::opt<bool>
+  IStatsDelta("istats-delta",
+              cl::init(false),
+              cl::desc("Append the instruction statistics which changed to "
+                       "run.istats.delta at every istats write, run.istats "
+                       "is only written at the end (default=off)"));
+
   // XXX I really would like to have dynamic rate control for something like this.
   cl::opt<double>
   UncoveredUpdateInterval("uncovered-update-interval",
@@ -111,7 +124,22 @@ namespace {
   UseCallPaths("use-call-paths",
 	       cl::init(true),
                cl::desc("Enable calltree tracking for instruction level statistics (default=on)"));
-  
+
+  cl::opt<bool>
+  ProfileSkipFunctions("profile-skip-functions",
+                       cl::init(false),
+                       cl::desc("At the end, rank the functions by the forks "
+                                "and solver time below them against the "
+                                "stores they may execute and write the best "
+                                "candidates for --skip-functions to "
+                                "skip-candidates in the output directory "
+                                "(default=off)"));
+
+  cl::opt<unsigned>
+  NumSkipCandidates("skip-candidates",
+                    cl::init(3),
+                    cl::desc("The number of functions "
+                             "--profile-skip-functions picks (default=3)"));
 }
 
 ///
@@ -128,7 +156,7 @@ namespace klee {
     WriteIStatsTimer(StatsTracker *_statsTracker) : statsTracker(_statsTracker) {}
     ~WriteIStatsTimer() {}
     
-    void run() { statsTracker->writeIStats(); }
+    void run() { statsTracker->updateIStats(); }
   };
   
   class WriteStatsTimer : public Executor::Timer {
@@ -183,6 +211,7 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     objectFilename(_objectFilename),
     statsFile(0),
     istatsFile(0),
+    istatsDeltaFile(0),
     startWallTime(util::getWallTime()),
     numBranches(0),
     fullBranches(0),
@@ -263,6 +292,11 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
   if (OutputIStats) {
     istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
     assert(istatsFile && "unable to open istats file");
+    if (IStatsDelta) {
+      istatsDeltaFile =
+          executor.interpreterHandler->openOutputFile("run.istats.delta");
+      assert(istatsDeltaFile && "unable to open istats delta file");
+    }
 
     if (IStatsWriteInterval > 0)
       executor.addTimer(new WriteIStatsTimer(this), IStatsWriteInterval);
@@ -274,6 +308,8 @@ StatsTracker::~StatsTracker() {
     delete statsFile;
   if (istatsFile)
     delete istatsFile;
+  if (istatsDeltaFile)
+    delete istatsDeltaFile;
 }
 
 void StatsTracker::done() {
@@ -283,8 +319,113 @@ void StatsTracker::done() {
   if (OutputIStats) {
     if (updateMinDistToUncovered)
       computeReachableUncovered();
+    if (istatsDeltaFile)
+      writeIStatsDelta();
     writeIStats();
+    if (ProfileSkipFunctions && UseCallPaths)
+      writeSkipCandidates();
+  }
+}
+
+namespace {
+  struct SkipCandidate {
+    Function *f;
+    uint64_t calls, instructions, forks, solverTime, stores;
+    double score;
+
+    bool operator<(const SkipCandidate &other) const {
+      return score > other.score;
+    }
+  };
+}
+
+/// The number of stores in f and the functions it calls directly or
+/// transitively, a cheap bound of the side effects a skipped call has to
+/// recover.
+static uint64_t countReachableStores(Function *f) {
+  std::vector<Function*> stack(1, f);
+  std::set<Function*> visited;
+  visited.insert(f);
+  uint64_t stores = 0;
+  while (!stack.empty()) {
+    Function *g = stack.back();
+    stack.pop_back();
+    for (Function::iterator bb = g->begin(), bbe = g->end(); bb != bbe; ++bb) {
+      for (BasicBlock::iterator it = bb->begin(), ie = bb->end(); it != ie;
+           ++it) {
+        if (isa<StoreInst>(it)) {
+          ++stores;
+        } else if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
+          Function *callee = getDirectCallTarget(&*it);
+          if (callee && !callee->isDeclaration() &&
+              visited.insert(callee).second)
+            stack.push_back(callee);
+        }
+      }
+    }
+  }
+  return stores;
+}
+
+void StatsTracker::writeSkipCandidates() {
+  CallSiteSummaryTable callSiteStats;
+  callPathManager.getSummaryStatistics(callSiteStats);
+
+  std::map<Function*, SkipCandidate> byFunction;
+  for (CallSiteSummaryTable::iterator it = callSiteStats.begin(),
+         ie = callSiteStats.end(); it != ie; ++it) {
+    for (std::map<Function*, CallSiteInfo>::iterator fit = it->second.begin(),
+           fie = it->second.end(); fit != fie; ++fit) {
+      Function *f = fit->first;
+      if (!it->first || f->isDeclaration() || f->getName().startswith("klee_"))
+        continue;
+      // only void functions and those with a wrapper can be skipped
+      if (!f->getReturnType()->isVoidTy() &&
+          !f->getParent()->getFunction("__wrap_" + f->getName().str()))
+        continue;
+      SkipCandidate &c = byFunction[f];
+      c.f = f;
+      c.calls += fit->second.count;
+      c.instructions += fit->second.statistics.getValue(stats::instructions);
+      c.forks += fit->second.statistics.getValue(stats::forks);
+      c.solverTime += fit->second.statistics.getValue(stats::solverTime);
+    }
+  }
+
+  uint64_t instructions = stats::instructions;
+  uint64_t forks = std::max<uint64_t>(stats::forks, 1);
+  uint64_t solverTime = std::max<uint64_t>(stats::solverTime, 1);
+  std::vector<SkipCandidate> candidates;
+  for (std::map<Function*, SkipCandidate>::iterator it = byFunction.begin(),
+         ie = byFunction.end(); it != ie; ++it) {
+    SkipCandidate &c = it->second;
+    // the drivers of the run, e.g. main, contain all of it
+    if (c.instructions * 10 > instructions * 9 || (!c.forks && !c.solverTime))
+      continue;
+    c.stores = countReachableStores(c.f);
+    c.score = ((double) c.forks / forks + (double) c.solverTime / solverTime) /
+              (1 + log2(1 + (double) c.stores));
+    candidates.push_back(c);
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  llvm::raw_ostream *os =
+      executor.interpreterHandler->openOutputFile("skip-candidates");
+  if (!os)
+    return;
+  *os << "# function calls instructions forks solver-time(s) stores score\n";
+  std::string choice;
+  for (unsigned i = 0; i < candidates.size(); ++i) {
+    SkipCandidate &c = candidates[i];
+    *os << "# " << c.f->getName() << " " << c.calls << " " << c.instructions
+        << " " << c.forks << " " << c.solverTime / 1000000. << " " << c.stores
+        << " " << c.score << "\n";
+    if (i < NumSkipCandidates)
+      choice += (i ? "," : "") + c.f->getName().str();
   }
+  // the last line is read by --skip-functions-file
+  *os << choice << "\n";
+  delete os;
 }
 
 void StatsTracker::stepInstruction(ExecutionState &es) {
@@ -324,7 +465,7 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
+          es.coveredLines[ii.file].insert(ii.line);
 	es.coveredNew = true;
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
@@ -339,7 +480,7 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
 
   if (istatsFile && IStatsWriteAfterInstructions &&
       stats::instructions % IStatsWriteAfterInstructions.getValue() == 0)
-    writeIStats();
+    updateIStats();
 }
 
 ///
@@ -420,6 +561,32 @@ void StatsTracker::writeStatsHeader() {
              << "'CexCacheTime',"
              << "'ForkTime',"
              << "'ResolveTime',"
+             << "'BlockedTime',"
+             << "'Suspensions',"
+             << "'NumBlockedStates',"
+             << "'CexCacheHits',"
+             << "'CexCacheMisses',"
+             << "'CexCacheEvictions',"
+             << "'NumExprs',"
+             << "'ExprMemory',"
+             << "'ExprSlabMemory',"
+             << "'Allocations',"
+             << "'AllocationsReused',"
+             << "'Forks',"
+             << "'CopyOnWriteCopies',"
+             << "'CopyOnWriteBytes',"
+             << "'ReplayTime',"
+             << "'ExplorationTime',"
+             << "'RecoveryTime',"
+             << "'IdleTime',"
+             << "'PTreeNodes',"
+             << "'PTreeMemory',"
+             << "'KnownBitsHits',"
+             << "'KnownBitsMisses',";
+  for (unsigned i = 0; i < util::NumMemoryCategories; i++)
+    *statsFile << "'Memory"
+               << util::GetMemoryCategoryName((util::MemoryCategory) i) << "',";
+  *statsFile
 #ifdef DEBUG
 	     << "'ArrayHashTime',"
 #endif
@@ -450,6 +617,33 @@ void StatsTracker::writeStatsLine() {
              << "," << stats::cexCacheTime / 1000000.
              << "," << stats::forkTime / 1000000.
              << "," << stats::resolveTime / 1000000.
+             << "," << stats::blockedTime / 1000000.
+             << "," << stats::suspensions
+             << "," << getNumBlockedStates()
+             << "," << stats::queryCexCacheHits
+             << "," << stats::queryCexCacheMisses
+             << "," << stats::queryCexCacheEvictions
+             << "," << Expr::count
+             << "," << NodeAllocator::getLiveBytes()
+             << "," << NodeAllocator::getSlabBytes()
+             << "," << stats::allocations
+             << "," << stats::allocationsReused
+             << "," << stats::forks
+             << "," << stats::copyOnWriteCopies
+             << "," << stats::copyOnWriteBytes
+             << "," << stats::replayTime / 1000000.
+             << "," << stats::explorationTime / 1000000.
+             << "," << stats::recoveryTime / 1000000.
+             << "," << stats::idleTime / 1000000.
+             << "," << (executor.processTree ?
+                        executor.processTree->getNumNodes() : 0)
+             << "," << (executor.processTree ?
+                        executor.processTree->getMemoryUsage() : 0)
+             << "," << stats::queryKnownBitsHits
+             << "," << stats::queryKnownBitsMisses;
+  for (unsigned i = 0; i < util::NumMemoryCategories; i++)
+    *statsFile << "," << util::GetMemoryUsage((util::MemoryCategory) i);
+  *statsFile
 #ifdef DEBUG
              //<< "," << stats::arrayHashTime / 1000000.
 #endif
@@ -457,8 +651,19 @@ void StatsTracker::writeStatsLine() {
   statsFile->flush();
 }
 
+unsigned StatsTracker::getNumBlockedStates() {
+  unsigned count = 0;
+  for (StateSet::iterator it = executor.states.begin(),
+         ie = executor.states.end(); it != ie; ++it) {
+    ExecutionState &state = **it;
+    if (!state.isRecoveryState() && state.isSuspended())
+      count++;
+  }
+  return count;
+}
+
 void StatsTracker::updateStateStatistics(uint64_t addend) {
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
+  for (StateSet::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
     ExecutionState &state = **it;
     const InstructionInfo &ii = *state.pc->info;
@@ -468,24 +673,9 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
   }
 }
 
-void StatsTracker::writeIStats() {
-  Module *m = executor.kmodule->module;
-  uint64_t istatsMask = 0;
-  llvm::raw_fd_ostream &of = *istatsFile;
-  
-  // We assume that we didn't move the file pointer
-  unsigned istatsSize = of.tell();
-
-  of.seek(0);
-
-  of << "version: 1\n";
-  of << "creator: klee\n";
-  of << "pid: " << getpid() << "\n";
-  of << "cmd: " << m->getModuleIdentifier() << "\n\n";
-  of << "\n";
-  
+static uint64_t getIStatsMask() {
   StatisticManager &sm = *theStatisticManager;
-  unsigned nStats = sm.getNumStatistics();
+  uint64_t istatsMask = 0;
 
   // Max is 13, sadly
   istatsMask |= 1<<sm.getStatisticID("Queries");
@@ -501,6 +691,19 @@ void StatsTracker::writeIStats() {
   istatsMask |= 1<<sm.getStatisticID("UncoveredInstructions");
   istatsMask |= 1<<sm.getStatisticID("States");
   istatsMask |= 1<<sm.getStatisticID("MinDistToUncovered");
+  return istatsMask;
+}
+
+static void writeIStatsHeader(llvm::raw_ostream &of, Module *m,
+                              uint64_t istatsMask) {
+  StatisticManager &sm = *theStatisticManager;
+  unsigned nStats = sm.getNumStatistics();
+
+  of << "version: 1\n";
+  of << "creator: klee\n";
+  of << "pid: " << getpid() << "\n";
+  of << "cmd: " << m->getModuleIdentifier() << "\n\n";
+  of << "\n";
 
   of << "positions: instr line\n";
 
@@ -518,7 +721,97 @@ void StatsTracker::writeIStats() {
       of << sm.getStatistic(i).getShortName() << " ";
   }
   of << "\n";
+}
+
+void StatsTracker::updateIStats() {
+  if (istatsDeltaFile)
+    writeIStatsDelta();
+  else
+    writeIStats();
+}
+
+/// Append the current values of the instructions whose statistics changed
+/// since the last call, as one tick of run.istats.delta. The tick has the
+/// run.istats line format, with fl= and fn= repeated at its start.
+void StatsTracker::writeIStatsDelta() {
+  KModule *km = executor.kmodule;
+  llvm::raw_fd_ostream &of = *istatsDeltaFile;
+  StatisticManager &sm = *theStatisticManager;
+  uint64_t istatsMask = getIStatsMask();
+
+  std::vector<Statistic *> events;
+  for (unsigned i = 0; i < sm.getNumStatistics(); i++)
+    if (istatsMask & (1<<i))
+      events.push_back(&sm.getStatistic(i));
+
+  if (istatsWritten.empty()) {
+    writeIStatsHeader(of, km->module, istatsMask);
+    of << "ob=" << objectFilename << "\n";
+    istatsWritten.resize(km->infos->getMaxID() * events.size());
+  }
+
+  if (istatsMask & (1<<stats::states.getID()))
+    updateStateStatistics(1);
+
+  of << "tick=" << elapsed() << "\n";
+  std::string sourceFile = "";
+  for (std::vector<KFunction*>::iterator it = km->functions.begin(),
+         ie = km->functions.end(); it != ie; ++it) {
+    KFunction *kf = *it;
+    bool functionWritten = false;
+    for (unsigned i = 0; i < kf->numInstructions; ++i) {
+      const InstructionInfo &ii = *kf->instructions[i]->info;
+      uint64_t *written = &istatsWritten[ii.id * events.size()];
+      unsigned j = 0;
+      while (j < events.size() &&
+             sm.getIndexedValue(*events[j], ii.id) == written[j])
+        j++;
+      if (j == events.size())
+        continue;
+
+      if (!functionWritten) {
+        km->infos->loadFunction(kf->function);
+        const InstructionInfo &fii = km->infos->getFunctionInfo(kf->function);
+        if (*fii.file != sourceFile) {
+          of << "fl=" << *fii.file << "\n";
+          sourceFile = *fii.file;
+        }
+        of << "fn=" << kf->function->getName().str() << "\n";
+        functionWritten = true;
+      }
+      if (*ii.file != sourceFile) {
+        of << "fl=" << *ii.file << "\n";
+        sourceFile = *ii.file;
+      }
+      of << ii.assemblyLine << " " << ii.line << " ";
+      for (j = 0; j < events.size(); j++) {
+        written[j] = sm.getIndexedValue(*events[j], ii.id);
+        of << written[j] << " ";
+      }
+      of << "\n";
+    }
+  }
+
+  if (istatsMask & (1<<stats::states.getID()))
+    updateStateStatistics((uint64_t)-1);
+
+  of.flush();
+}
+
+void StatsTracker::writeIStats() {
+  Module *m = executor.kmodule->module;
+  uint64_t istatsMask = getIStatsMask();
+  llvm::raw_fd_ostream &of = *istatsFile;
   
+  // We assume that we didn't move the file pointer
+  unsigned istatsSize = of.tell();
+
+  of.seek(0);
+  writeIStatsHeader(of, m, istatsMask);
+
+  StatisticManager &sm = *theStatisticManager;
+  unsigned nStats = sm.getNumStatistics();
+
   // set state counts, decremented after we process so that we don't
   // have to zero all records each time.
   if (istatsMask & (1<<stats::states.getID()))
@@ -539,9 +832,9 @@ void StatsTracker::writeIStats() {
       // KCachegrind can create two entries for the function, one with an
       // unnamed file and one without.
       const InstructionInfo &ii = executor.kmodule->infos->getFunctionInfo(fnIt);
-      if (ii.file != sourceFile) {
-        of << "fl=" << ii.file << "\n";
-        sourceFile = ii.file;
+      if (*ii.file != sourceFile) {
+        of << "fl=" << *ii.file << "\n";
+        sourceFile = *ii.file;
       }
       
       of << "fn=" << fnIt->getName().str() << "\n";
@@ -552,9 +845,9 @@ void StatsTracker::writeIStats() {
           Instruction *instr = &*it;
           const InstructionInfo &ii = executor.kmodule->infos->getInfo(instr);
           unsigned index = ii.id;
-          if (ii.file!=sourceFile) {
-            of << "fl=" << ii.file << "\n";
-            sourceFile = ii.file;
+          if (*ii.file!=sourceFile) {
+            of << "fl=" << *ii.file << "\n";
+            sourceFile = *ii.file;
           }
           of << ii.assemblyLine << " ";
           of << ii.line << " ";
@@ -575,8 +868,8 @@ void StatsTracker::writeIStats() {
                 const InstructionInfo &fii = 
                   executor.kmodule->infos->getFunctionInfo(f);
   
-                if (fii.file!="" && fii.file!=sourceFile)
-                  of << "cfl=" << fii.file << "\n";
+                if (*fii.file!="" && *fii.file!=sourceFile)
+                  of << "cfl=" << *fii.file << "\n";
                 of << "cfn=" << f->getName().str() << "\n";
                 of << "calls=" << csi.count << " ";
                 of << fii.assemblyLine << " ";
@@ -642,6 +935,36 @@ static std::vector<Instruction*> getSuccs(Instruction *i) {
   return res;
 }
 
+static uint64_t uncoveredEpoch = 1;
+
+uint64_t klee::getUncoveredEpoch() {
+  return uncoveredEpoch;
+}
+
+void klee::updateMinDistToUncovered(ExecutionState &es) {
+  if (es.uncoveredEpoch == uncoveredEpoch)
+    return;
+  es.uncoveredEpoch = uncoveredEpoch;
+
+  uint64_t currentFrameMinDist = 0;
+  for (ExecutionState::stack_ty::iterator sfIt = es.stack.begin(),
+         sf_ie = es.stack.end(); sfIt != sf_ie; ++sfIt) {
+    ExecutionState::stack_ty::iterator next = sfIt + 1;
+    KInstIterator kii;
+
+    if (next==es.stack.end()) {
+      kii = es.pc;
+    } else {
+      kii = next->caller;
+      ++kii;
+    }
+
+    sfIt->minDistToUncoveredOnReturn = currentFrameMinDist;
+
+    currentFrameMinDist = computeMinDistToUncovered(kii, currentFrameMinDist);
+  }
+}
+
 uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
                                          uint64_t minDistAtRA) {
   StatisticManager &sm = *theStatisticManager;
@@ -664,6 +987,36 @@ uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
   }
 }
 
+void StatsTracker::getCoverage(std::vector<char> &bitmap) {
+  unsigned numIds = executor.kmodule->infos->getMaxID();
+  bitmap.assign((numIds + 7) / 8, 0);
+  if (!OutputIStats)
+    return;
+  for (unsigned id = 0; id < numIds; ++id)
+    if (theStatisticManager->getIndexedValue(stats::coveredInstructions, id))
+      bitmap[id / 8] |= 1 << (id % 8);
+}
+
+bool StatsTracker::mergeCoverage(const char *bitmap, size_t size,
+                                 unsigned &merged) {
+  merged = 0;
+  unsigned numIds = executor.kmodule->infos->getMaxID();
+  if (size != (numIds + 7) / 8)
+    return false;
+  if (!OutputIStats)
+    return true;
+  StatisticManager &sm = *theStatisticManager;
+  for (unsigned id = 0; id < numIds; ++id) {
+    if (!(bitmap[id / 8] & (1 << (id % 8))) ||
+        sm.getIndexedValue(stats::coveredInstructions, id))
+      continue;
+    sm.setIndexedValue(stats::coveredInstructions, id, 1);
+    sm.setIndexedValue(stats::uncoveredInstructions, id, 0);
+    ++merged;
+  }
+  return true;
+}
+
 void StatsTracker::computeReachableUncovered() {
   KModule *km = executor.kmodule;
   Module *m = km->module;
@@ -730,7 +1083,7 @@ void StatsTracker::computeReachableUncovered() {
         for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
              it != ie; ++it) {
           instructions.push_back(it);
-          unsigned id = infos.getInfo(it).id;
+          unsigned id = infos.getID(it);
           sm.setIndexedValue(stats::minDistToReturn, 
                              id, 
                              isa<ReturnInst>(it)
@@ -769,13 +1122,13 @@ void StatsTracker::computeReachableUncovered() {
         }
        
         if (bestThrough) {
-          unsigned id = infos.getInfo(*it).id;
+          unsigned id = infos.getID(*it);
           uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToReturn, id);
           std::vector<Instruction*> succs = getSuccs(*it);
           for (std::vector<Instruction*>::iterator it2 = succs.begin(),
                  ie = succs.end(); it2 != ie; ++it2) {
             uint64_t dist = sm.getIndexedValue(stats::minDistToReturn,
-                                               infos.getInfo(*it2).id);
+                                               infos.getID(*it2));
             if (dist) {
               uint64_t val = bestThrough + dist;
               if (best==0 || val<best)
@@ -811,7 +1164,7 @@ void StatsTracker::computeReachableUncovered() {
          bbIt != bb_ie; ++bbIt) {
       for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
            it != ie; ++it) {
-        unsigned id = infos.getInfo(it).id;
+        unsigned id = infos.getID(it);
         instructions.push_back(&*it);
         sm.setIndexedValue(stats::minDistToUncovered, 
                            id, 
@@ -830,7 +1183,7 @@ void StatsTracker::computeReachableUncovered() {
            ie = instructions.end(); it != ie; ++it) {
       Instruction *inst = *it;
       uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered, 
-                                                     infos.getInfo(inst).id);
+                                                     infos.getID(inst));
       unsigned bestThrough = 0;
       
       if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
@@ -846,7 +1199,7 @@ void StatsTracker::computeReachableUncovered() {
 
           if (!(*fnIt)->isDeclaration()) {
             uint64_t calleeDist = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getFunctionInfo(*fnIt).id);
+                                                     infos.getID((*fnIt)->begin()->begin()));
             if (calleeDist) {
               calleeDist = 1+calleeDist; // count instruction itself
               if (best==0 || calleeDist<best)
@@ -863,7 +1216,7 @@ void StatsTracker::computeReachableUncovered() {
         for (std::vector<Instruction*>::iterator it2 = succs.begin(),
                ie = succs.end(); it2 != ie; ++it2) {
           uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*it2).id);
+                                             infos.getID(*it2));
           if (dist) {
             uint64_t val = bestThrough + dist;
             if (best==0 || val<best)
@@ -874,32 +1227,13 @@ void StatsTracker::computeReachableUncovered() {
 
       if (best != cur) {
         sm.setIndexedValue(stats::minDistToUncovered, 
-                           infos.getInfo(inst).id, 
+                           infos.getID(inst), 
                            best);
         changed = true;
       }
     }
   } while (changed);
 
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
-         ie = executor.states.end(); it != ie; ++it) {
-    ExecutionState *es = *it;
-    uint64_t currentFrameMinDist = 0;
-    for (ExecutionState::stack_ty::iterator sfIt = es->stack.begin(),
-           sf_ie = es->stack.end(); sfIt != sf_ie; ++sfIt) {
-      ExecutionState::stack_ty::iterator next = sfIt + 1;
-      KInstIterator kii;
-
-      if (next==es->stack.end()) {
-        kii = es->pc;
-      } else {
-        kii = next->caller;
-        ++kii;
-      }
-      
-      sfIt->minDistToUncoveredOnReturn = currentFrameMinDist;
-      
-      currentFrameMinDist = computeMinDistToUncovered(kii, currentFrameMinDist);
-    }
-  }
+  // the stacks of the states are updated as they are used
+  ++uncoveredEpoch;
 }
@@ -13,6 +13,7 @@
 #include "CallPathManager.h"
 
 #include <set>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -36,7 +37,10 @@ namespace klee {
     Executor &executor;
     std::string objectFilename;
 
-    llvm::raw_fd_ostream *statsFile, *istatsFile;
+    llvm::raw_fd_ostream *statsFile, *istatsFile, *istatsDeltaFile;
+    /// the instruction statistics last appended to istatsDeltaFile, by
+    /// instruction id and event
+    std::vector<uint64_t> istatsWritten;
     double startWallTime;
     
     unsigned numBranches;
@@ -54,6 +58,10 @@ namespace klee {
     void writeStatsHeader();
     void writeStatsLine();
     void writeIStats();
+    void writeIStatsDelta();
+    void updateIStats();
+    void writeSkipCandidates();
+    unsigned getNumBlockedStates();
 
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
@@ -83,11 +91,29 @@ namespace klee {
     double elapsed();
 
     void computeReachableUncovered();
+
+    /// Set the bit of every covered instruction (by id) in bitmap.
+    void getCoverage(std::vector<char> &bitmap);
+
+    /// Mark the instructions set in bitmap as covered, so that states
+    /// reaching them no longer cover new code. The coverage totals keep
+    /// counting what this process covered first.
+    ///
+    /// \return false if bitmap does not fit the module; merged is the
+    /// number of instructions newly marked.
+    bool mergeCoverage(const char *bitmap, size_t size, unsigned &merged);
   };
 
   uint64_t computeMinDistToUncovered(const KInstruction *ki,
                                      uint64_t minDistAtRA);
 
+  /// Incremented whenever the distances to uncovered code are recomputed.
+  uint64_t getUncoveredEpoch();
+
+  /// Recompute the minimal distances of the stack frames of es if they
+  /// predate the current epoch.
+  void updateMinDistToUncovered(ExecutionState &es);
+
 }
 
 #endif
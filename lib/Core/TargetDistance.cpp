@@ -0,0 +1,249 @@
+//===-- TargetDistance.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TargetDistance.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Config/Version.h"
+#include "klee/Internal/Analysis/ReachabilityAnalysis.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/ModuleUtil.h"
+
+#if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#else
+#include "llvm/BasicBlock.h"
+#include "llvm/Function.h"
+#include "llvm/InlineAsm.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#endif
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CFG.h"
+#else
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/CFG.h"
+#endif
+
+#include <algorithm>
+
+using namespace klee;
+using namespace llvm;
+
+static std::vector<Instruction*> getSuccs(Instruction *i) {
+  BasicBlock *bb = i->getParent();
+  std::vector<Instruction*> res;
+
+  if (i==bb->getTerminator()) {
+    for (succ_iterator it = succ_begin(bb), ie = succ_end(bb); it != ie; ++it)
+      res.push_back(it->begin());
+  } else {
+    res.push_back(++BasicBlock::iterator(i));
+  }
+
+  return res;
+}
+
+static bool isCall(const Instruction *i) {
+  return isa<CallInst>(i) || isa<InvokeInst>(i);
+}
+
+/// the nearer of two distances, 0 is unreachable
+static uint64_t minDist(uint64_t best, uint64_t dist) {
+  return (dist && (best == 0 || dist < best)) ? dist : best;
+}
+
+TargetDistance::TargetDistance(
+    KModule *km, const std::map<std::string, std::vector<unsigned> > &targets,
+    ReachabilityAnalysis *ra)
+  : numTargets(0) {
+  Module *m = km->module;
+  for (Module::iterator fnIt = m->begin(), fn_ie = m->end();
+       fnIt != fn_ie; ++fnIt) {
+    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end();
+         bbIt != bb_ie; ++bbIt) {
+      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end();
+           it != ie; ++it) {
+        Instruction *inst = it;
+        instructions.push_back(inst);
+
+        if (!isCall(inst))
+          continue;
+        CallSite cs(inst);
+        std::vector<Function*> &callees = callTargets[inst];
+        if (isa<InlineAsm>(cs.getCalledValue())) {
+          // no targets
+        } else if (Function *target = getDirectCallTarget(cs)) {
+          callees.push_back(target);
+        } else {
+          ReachabilityAnalysis::FunctionSet resolved;
+          if (ra)
+            ra->getCallTargets(inst, resolved);
+          if (resolved.empty())
+            callees.assign(km->escapingFunctions.begin(),
+                           km->escapingFunctions.end());
+          else
+            callees.assign(resolved.begin(), resolved.end());
+        }
+      }
+    }
+  }
+
+  // the fixpoints settle faster backwards
+  std::reverse(instructions.begin(), instructions.end());
+  toTarget.assign(instructions.size(), 0);
+  for (unsigned i = 0; i < instructions.size(); ++i) {
+    index[instructions[i]] = i;
+    const InstructionInfo &info = km->infos->getInfo(instructions[i]);
+    if (info.file->empty())
+      continue;
+    std::string basename = info.file->substr(info.file->find_last_of("/\\") + 1);
+    std::map<std::string, std::vector<unsigned> >::const_iterator lines =
+        targets.find(basename);
+    if (lines != targets.end() &&
+        std::find(lines->second.begin(), lines->second.end(), info.line) !=
+            lines->second.end()) {
+      toTarget[i] = 1;
+      ++numTargets;
+    }
+  }
+
+  computeToReturn();
+  computeToTarget();
+}
+
+uint64_t TargetDistance::getToTarget(const Instruction *i) const {
+  DenseMap<const Instruction*, unsigned>::const_iterator it = index.find(i);
+  return it == index.end() ? 0 : toTarget[it->second];
+}
+
+uint64_t TargetDistance::getToReturn(const Instruction *i) const {
+  DenseMap<const Instruction*, unsigned>::const_iterator it = index.find(i);
+  return it == index.end() ? 0 : toReturn[it->second];
+}
+
+void TargetDistance::computeToReturn() {
+  toReturn.assign(instructions.size(), 0);
+  for (unsigned i = 0; i < instructions.size(); ++i) {
+    Function *f = instructions[i]->getParent()->getParent();
+    functionToReturn[f] = 0;
+    if (isa<ReturnInst>(instructions[i]))
+      toReturn[i] = 1;
+    if (isCall(instructions[i])) {
+      std::vector<Function*> &callees = callTargets[instructions[i]];
+      for (unsigned j = 0; j < callees.size(); ++j)
+        if (callees[j]->isDeclaration())
+          functionToReturn[callees[j]] = callees[j]->doesNotReturn() ? 0 : 1;
+    }
+  }
+
+  // as StatsTracker::computeReachableUncovered, not worklisted either
+  bool changed;
+  do {
+    changed = false;
+    for (unsigned i = 0; i < instructions.size(); ++i) {
+      Instruction *inst = instructions[i];
+      uint64_t bestThrough = 0;
+      if (isCall(inst)) {
+        std::vector<Function*> &callees = callTargets[inst];
+        for (unsigned j = 0; j < callees.size(); ++j) {
+          uint64_t dist = functionToReturn[callees[j]];
+          bestThrough = minDist(bestThrough, dist ? 1 + dist : 0);
+        }
+      } else {
+        bestThrough = 1;
+      }
+      if (!bestThrough)
+        continue;
+
+      uint64_t best = toReturn[i];
+      std::vector<Instruction*> succs = getSuccs(inst);
+      for (unsigned j = 0; j < succs.size(); ++j) {
+        uint64_t dist = toReturn[index[succs[j]]];
+        best = minDist(best, dist ? bestThrough + dist : 0);
+      }
+      // a function of a single ret has to update its entry too
+      Function *f = inst->getParent()->getParent();
+      bool isEntry = inst == f->begin()->begin();
+      if (best != toReturn[i] || (isEntry && functionToReturn[f] != best)) {
+        toReturn[i] = best;
+        changed = true;
+        if (isEntry)
+          functionToReturn[f] = best;
+      }
+    }
+  } while (changed);
+}
+
+void TargetDistance::computeToTarget() {
+  if (!numTargets)
+    return;
+
+  bool changed;
+  do {
+    changed = false;
+    for (unsigned i = 0; i < instructions.size(); ++i) {
+      Instruction *inst = instructions[i];
+      uint64_t best = toTarget[i];
+      uint64_t bestThrough = 0;
+      if (isCall(inst)) {
+        std::vector<Function*> &callees = callTargets[inst];
+        for (unsigned j = 0; j < callees.size(); ++j) {
+          Function *f = callees[j];
+          uint64_t dist = functionToReturn[f];
+          bestThrough = minDist(bestThrough, dist ? 1 + dist : 0);
+          if (!f->isDeclaration()) {
+            uint64_t calleeDist = toTarget[index[f->begin()->begin()]];
+            best = minDist(best, calleeDist ? 1 + calleeDist : 0);
+          }
+        }
+      } else {
+        bestThrough = 1;
+      }
+
+      if (bestThrough) {
+        std::vector<Instruction*> succs = getSuccs(inst);
+        for (unsigned j = 0; j < succs.size(); ++j) {
+          uint64_t dist = toTarget[index[succs[j]]];
+          best = minDist(best, dist ? bestThrough + dist : 0);
+        }
+      }
+      if (best != toTarget[i]) {
+        toTarget[i] = best;
+        changed = true;
+      }
+    }
+  } while (changed);
+}
+
+uint64_t TargetDistance::getDistance(const ExecutionState &es) const {
+  if (!numTargets)
+    return 0;
+  // from the pc, then from the return site of every caller
+  const Instruction *inst = es.pc->inst;
+  uint64_t best = getToTarget(inst);
+  uint64_t through = getToReturn(inst);
+  for (unsigned i = es.stack.size() - 1; i > 0 && through; --i) {
+    KInstIterator kii = es.stack[i].caller;
+    ++kii;
+    inst = kii->inst;
+    uint64_t dist = getToTarget(inst);
+    best = minDist(best, dist ? through + dist : 0);
+    uint64_t toRet = getToReturn(inst);
+    through = toRet ? through + toRet : 0;
+  }
+  return best;
+}
@@ -0,0 +1,70 @@
+//===-- TargetDistance.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_TARGETDISTANCE_H
+#define KLEE_TARGETDISTANCE_H
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class Function;
+  class Instruction;
+}
+
+class ReachabilityAnalysis;
+
+namespace klee {
+  class ExecutionState;
+  class KModule;
+
+  /// TargetDistance - The number of instructions from every instruction of
+  /// the module to the nearest target source line (--error-location),
+  /// through the CFG and the call graph.
+  ///
+  /// Indirect calls go to the targets the reachability analysis resolved,
+  /// else to all escaping functions. A state is as near to a target as the
+  /// nearest one ahead of its pc or, after returning, ahead of the return
+  /// site of one of its callers.
+  class TargetDistance {
+    llvm::DenseMap<const llvm::Instruction *, unsigned> index;
+    /// the instructions in reverse order, for the fixpoints
+    std::vector<llvm::Instruction *> instructions;
+    /// 0 is unreachable
+    std::vector<uint64_t> toTarget, toReturn;
+    std::map<llvm::Function *, uint64_t> functionToReturn;
+    std::map<const llvm::Instruction *, std::vector<llvm::Function *> >
+        callTargets;
+    unsigned numTargets;
+
+    uint64_t getToTarget(const llvm::Instruction *i) const;
+    uint64_t getToReturn(const llvm::Instruction *i) const;
+    void computeToReturn();
+    void computeToTarget();
+
+  public:
+    /// targets maps source file basenames to their lines, ra may be null.
+    TargetDistance(KModule *km,
+                   const std::map<std::string, std::vector<unsigned> > &targets,
+                   ReachabilityAnalysis *ra);
+
+    /// The number of instructions at the target lines.
+    unsigned getNumTargets() const { return numTargets; }
+
+    /// The distance of the state to the nearest target, 0 if it can reach
+    /// none.
+    uint64_t getDistance(const ExecutionState &es) const;
+  };
+}
+
+#endif
@@ -13,9 +13,12 @@
 #include "klee/ExecutionState.h"
 #include "klee/Solver.h"
 #include "klee/Statistics.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Support/EventTrace.h"
 #include "klee/Internal/System/Time.h"
 
 #include "CoreStats.h"
+#include "SolverService.h"
 
 #include "llvm/Support/TimeValue.h"
 
@@ -24,6 +27,22 @@ using namespace llvm;
 
 /***/
 
+void TimingSolver::recordQuery(const ExecutionState &state, uint64_t usec,
+                               const QueryProfiler::Counters &before) {
+  if (profiler)
+    profiler->record(state.prevPC, usec, before);
+  if (traceThreshold && usec >= traceThreshold) {
+    EventTrace &trace = EventTrace::getProcessTrace();
+    trace.record(EventTrace::SolverCall, EventTrace::now() - usec, usec, 0);
+  }
+}
+
+void TimingSolver::setSite(const ExecutionState &state) {
+  if (service && profiler && state.prevPC)
+    service->setExpectedCost(
+        profiler->getExpectedCost(state.prevPC->inst->getParent()));
+}
+
 bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
                             Solver::Validity &result) {
   // Fast path, to avoid timer and OS overhead.
@@ -33,20 +52,56 @@ bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
   }
 
   sys::TimeValue now = util::getWallTimeVal();
+  QueryProfiler::Counters before = QueryProfiler::Counters();
+  if (profiler)
+    before = QueryProfiler::getCounters();
+  setSite(state);
 
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
-  bool success = solver->evaluate(Query(state.constraints, expr), result);
+  bool success;
+  ref<Expr> value;
+  if (reuseModels && state.hasModel())
+    value = state.evaluateInModel(expr);
+  if (!value.isNull() && isa<ConstantExpr>(value)) {
+    // the model proves its side feasible, only the other one is asked
+    bool res;
+    ++stats::modelBranches;
+    if (value->isTrue()) {
+      success = solver->mustBeTrue(Query(state.constraints, expr), res);
+      result = res ? Solver::True : Solver::Unknown;
+    } else {
+      success = solver->mustBeFalse(Query(state.constraints, expr), res);
+      result = res ? Solver::False : Solver::Unknown;
+    }
+  } else {
+    success = solver->evaluate(Query(state.constraints, expr), result);
+    // one of the forks keeps the model
+    if (success && reuseModels && result == Solver::Unknown)
+      learnModel(state);
+  }
 
   sys::TimeValue delta = util::getWallTimeVal();
   delta -= now;
   stats::solverTime += delta.usec();
   state.queryCost += delta.usec()/1000000.;
+  recordQuery(state, delta.usec(), before);
 
   return success;
 }
 
+void TimingSolver::learnModel(const ExecutionState &state) {
+  std::vector<const Array*> objects;
+  for (unsigned i = 0; i < state.symbolics->size(); i++)
+    objects.push_back((*state.symbolics)[i].second);
+  std::vector< std::vector<unsigned char> > values;
+  if (solver->getInitialValues(Query(state.constraints,
+                                     ConstantExpr::alloc(0, Expr::Bool)),
+                               objects, values))
+    state.setModel(Assignment(objects, values));
+}
+
 bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr, 
                               bool &result) {
   // Fast path, to avoid timer and OS overhead.
@@ -56,6 +111,10 @@ bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
   }
 
   sys::TimeValue now = util::getWallTimeVal();
+  QueryProfiler::Counters before = QueryProfiler::Counters();
+  if (profiler)
+    before = QueryProfiler::getCounters();
+  setSite(state);
 
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
@@ -66,6 +125,7 @@ bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
   delta -= now;
   stats::solverTime += delta.usec();
   state.queryCost += delta.usec()/1000000.;
+  recordQuery(state, delta.usec(), before);
 
   return success;
 }
@@ -102,6 +162,10 @@ bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr,
   }
   
   sys::TimeValue now = util::getWallTimeVal();
+  QueryProfiler::Counters before = QueryProfiler::Counters();
+  if (profiler)
+    before = QueryProfiler::getCounters();
+  setSite(state);
 
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
@@ -112,6 +176,7 @@ bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr,
   delta -= now;
   stats::solverTime += delta.usec();
   state.queryCost += delta.usec()/1000000.;
+  recordQuery(state, delta.usec(), before);
 
   return success;
 }
@@ -126,6 +191,10 @@ TimingSolver::getInitialValues(const ExecutionState& state,
     return true;
 
   sys::TimeValue now = util::getWallTimeVal();
+  QueryProfiler::Counters before = QueryProfiler::Counters();
+  if (profiler)
+    before = QueryProfiler::getCounters();
+  setSite(state);
 
   bool success = solver->getInitialValues(Query(state.constraints,
                                                 ConstantExpr::alloc(0, Expr::Bool)), 
@@ -135,6 +204,7 @@ TimingSolver::getInitialValues(const ExecutionState& state,
   delta -= now;
   stats::solverTime += delta.usec();
   state.queryCost += delta.usec()/1000000.;
+  recordQuery(state, delta.usec(), before);
   
   return success;
 }
@@ -13,11 +13,14 @@
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 
+#include "QueryProfiler.h"
+
 #include <vector>
 
 namespace klee {
   class ExecutionState;
   class Solver;  
+  class SolverServiceClient;
 
   /// TimingSolver - A simple class which wraps a solver and handles
   /// tracking the statistics that we care about.
@@ -25,6 +28,24 @@ namespace klee {
   public:
     Solver *solver;
     bool simplifyExprs;
+    /// attributes the queries to the instructions issuing them, if set
+    QueryProfiler *profiler;
+    /// evaluate branch conditions under the last model of the state first
+    bool reuseModels;
+    /// queries of at least this many microseconds go to the event trace,
+    /// 0 for none
+    uint64_t traceThreshold;
+    /// sends the queries of the expensive blocks to a solver rank, if set
+    SolverServiceClient *service;
+
+  private:
+    void recordQuery(const ExecutionState &state, uint64_t usec,
+                     const QueryProfiler::Counters &before);
+    /// tell the solver service the expected cost of the next query
+    void setSite(const ExecutionState &state);
+    /// ask for a model of the constraints of the state, usually answered
+    /// by the counterexample cache from the query just solved
+    void learnModel(const ExecutionState &state);
 
   public:
     /// TimingSolver - Construct a new timing solver.
@@ -33,11 +54,17 @@ namespace klee {
     /// simplified (via the constraint manager interface) prior to
     /// querying.
     TimingSolver(Solver *_solver, bool _simplifyExprs = true) 
-      : solver(_solver), simplifyExprs(_simplifyExprs) {}
+      : solver(_solver), simplifyExprs(_simplifyExprs), profiler(0),
+        reuseModels(false), traceThreshold(0), service(0) {}
     ~TimingSolver() {
       delete solver;
     }
 
+    void setProfiler(QueryProfiler *_profiler) { profiler = _profiler; }
+    void setReuseModels(bool _reuseModels) { reuseModels = _reuseModels; }
+    void setTraceThreshold(uint64_t usec) { traceThreshold = usec; }
+    void setService(SolverServiceClient *_service) { service = _service; }
+
     void setTimeout(double t) {
       solver->setCoreSolverTimeout(t);
     }
@@ -31,6 +31,7 @@ namespace {
 			clEnumValN(Searcher::NURS_ICnt, "nurs:icnt", "use NURS with Instr-Count"),
 			clEnumValN(Searcher::NURS_CPICnt, "nurs:cpicnt", "use NURS with CallPath-Instr-Count"),
 			clEnumValN(Searcher::NURS_QC, "nurs:qc", "use NURS with Query-Cost"),
+			clEnumValN(Searcher::NURS_Target, "nurs:target", "use NURS with Min-Dist-to-Target (--error-location)"),
 			clEnumValEnd));
 
   cl::opt<bool>
@@ -69,10 +70,27 @@ namespace {
 	  cl::values(
       clEnumValN(Searcher::RS_DFS, "dfs", "use depth first search"),
       clEnumValN(Searcher::RS_RandomPath, "random-path", "use random path selection"),
+      clEnumValN(Searcher::RS_Priority, "priority", "prefer the recovery states blocking the most states (with --split-search)"),
       clEnumValEnd
     )
   );
 
+  cl::opt<double>
+  DeferQueryCost("defer-query-cost",
+                 cl::desc("Set aside the states whose next query is expected "
+                          "to take longer than this many milliseconds, by "
+                          "the queries of the block they are at, and donate "
+                          "them first (0=off, default)"),
+                 cl::init(0));
+
+  cl::opt<double>
+  FairShareSlice("fair-share-slice",
+                 cl::desc("Give the prefix subtrees of a merged prefix "
+                          "packet turns of this many seconds, the one which "
+                          "ran least first, and donate the starved ones "
+                          "first (0=off, default)"),
+                 cl::init(0));
+
   cl::opt<unsigned int>
   SplitRatio("split-ratio",
             cl::desc("ratio for choosing recovery states (default = 20)"),
@@ -89,6 +107,16 @@ bool klee::userSearcherRequiresMD2U() {
 }
 
 
+bool klee::userSearcherRequiresQueryProfile() {
+  return DeferQueryCost > 0;
+}
+
+
+bool klee::userSearcherRequiresSubtrees() {
+  return FairShareSlice > 0;
+}
+
+
 Searcher *getNewSearcher(Searcher::CoreSearchType type, Executor &executor) {
   Searcher *searcher = NULL;
   switch (type) {
@@ -102,6 +130,7 @@ Searcher *getNewSearcher(Searcher::CoreSearchType type, Executor &executor) {
   case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount); break;
   case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount); break;
   case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost); break;
+  case Searcher::NURS_Target: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::MinDistToTarget); break;
   }
 
   return searcher;
@@ -112,27 +141,46 @@ Searcher *klee::constructUserSearcher(Executor &executor, std::string searchMode
   std::cout << "User Searcher Search Strategy:" << searchMode << "\n";
   std::cout.flush();
   Searcher *searcher;// = getNewSearcher(Searcher::BFS, executor);
+  Searcher::CoreSearchType type;
   if(searchMode=="DFS") {
-    searcher = getNewSearcher(Searcher::DFS, executor);
+    type = Searcher::DFS;
   } else if(searchMode=="RAND") {
-    searcher = getNewSearcher(Searcher::RandomState, executor);
+    type = Searcher::RandomState;
   } else if(searchMode=="COVNEW") {
-    searcher = getNewSearcher(Searcher::NURS_CovNew, executor);
+    type = Searcher::NURS_CovNew;
+  } else if(searchMode=="DIST") {
+    type = Searcher::NURS_Target;
   } else {
-    searcher = getNewSearcher(Searcher::DFS, executor); 
+    type = Searcher::DFS;
   }
 
+  if (FairShareSlice > 0) {
+    Executor *exec = &executor;
+    searcher = new FairShareSearcher(
+        [exec, type]() { return getNewSearcher(type, *exec); },
+        FairShareSlice);
+  } else {
+    searcher = getNewSearcher(type, executor);
+  }
+
+  if (DeferQueryCost > 0)
+    searcher = new QueryCostSearcher(executor, searcher, DeferQueryCost * 1000);
+
   if (UseSplittedSearcher) {
     std::cout<<"Using splitted searcher \n";
     std::cout.flush();
     Searcher *searcher1;    
     /* TODO: Should both of the searchers be of the same type? */
-    if(searchMode=="DFS") {
+    if (std::find(RecoverySearch.begin(), RecoverySearch.end(), Searcher::RS_Priority) != RecoverySearch.end()) {
+      searcher1 = new RecoveryPrioritySearcher();
+    } else if(searchMode=="DFS") {
       searcher1 = getNewSearcher(Searcher::DFS, executor);
     } else if(searchMode=="RAND") {
       searcher1 = getNewSearcher(Searcher::RandomState, executor);
     } else if(searchMode=="COVNEW") {
       searcher1 = getNewSearcher(Searcher::NURS_CovNew, executor);
+    } else if(searchMode=="DIST") {
+      searcher1 = getNewSearcher(Searcher::NURS_Target, executor);
     } else {
       searcher1 = getNewSearcher(Searcher::DFS, executor);
     }
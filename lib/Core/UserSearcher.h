@@ -17,6 +17,12 @@ namespace klee {
   // XXX gross, should be on demand?
   bool userSearcherRequiresMD2U();
 
+  /// whether the searcher predicts query costs from the query profile
+  bool userSearcherRequiresQueryProfile();
+
+  /// whether the states are told apart by the prefix subtree they explore
+  bool userSearcherRequiresSubtrees();
+
   Searcher *constructUserSearcher(Executor &executor, std::string searchMode);
 }
 
@@ -0,0 +1,341 @@
+//===-- AssignmentBatch.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/AssignmentBatch.h"
+
+using namespace klee;
+
+static uint64_t getMask(Expr::Width width) {
+  return width >= 64 ? ~0ULL : (1ULL << width) - 1;
+}
+
+static int64_t signExtend(uint64_t value, Expr::Width width) {
+  return width >= 64 ? (int64_t) value :
+      (int64_t) (value << (64 - width)) >> (64 - width);
+}
+
+AssignmentBatch::ArrayLanes::ArrayLanes() {
+  for (unsigned i = 0; i < MaxLanes; i++) {
+    bytes[i] = 0;
+    size[i] = 0;
+  }
+}
+
+unsigned AssignmentBatch::add(const Assignment *a) {
+  assert(!isFull() && "batch is full");
+  assert(!a->allowFreeValues && "free values cannot be batched");
+  unsigned lane = assignments.size();
+  assignments.push_back(a);
+  live |= 1ULL << lane;
+  for (Assignment::bindings_ty::const_iterator it = a->bindings.begin(),
+         ie = a->bindings.end(); it != ie; ++it) {
+    ArrayLanes &array = arrays[it->first];
+    array.bytes[lane] = it->second.empty() ? 0 : &it->second[0];
+    array.size[lane] = it->second.size();
+  }
+  return lane;
+}
+
+void AssignmentBatch::remove(const Assignment *a) {
+  for (unsigned lane = 0; lane < assignments.size(); lane++) {
+    if (assignments[lane] != a)
+      continue;
+    for (Assignment::bindings_ty::const_iterator it = a->bindings.begin(),
+           ie = a->bindings.end(); it != ie; ++it) {
+      ArrayLanes &array = arrays[it->first];
+      array.bytes[lane] = 0;
+      array.size[lane] = 0;
+    }
+    assignments[lane] = 0;
+    live &= ~(1ULL << lane);
+    return;
+  }
+}
+
+unsigned AssignmentBatch::newSlot() {
+  values.push_back(Lanes());
+  return values.size() - 1;
+}
+
+uint64_t AssignmentBatch::satisfying(const ref<Expr> &e) {
+  uint64_t lanes = live, scalar;
+  unsigned slot;
+  if (evaluate(e, slot)) {
+    const Lanes &result = values[slot];
+    uint64_t truth = 0;
+    for (unsigned i = 0; i < MaxLanes; i++)
+      truth |= (result.v[i] & 1) << i;
+    scalar = lanes & result.undefined;
+    lanes &= truth & ~result.undefined;
+  } else {
+    scalar = lanes;
+    lanes = 0;
+  }
+
+  for (unsigned i = 0; i < MaxLanes && scalar >> i; i++) {
+    if (!((scalar >> i) & 1))
+      continue;
+    AssignmentEvaluator v(*assignments[i]);
+    if (v.visit(e)->isTrue())
+      lanes |= 1ULL << i;
+  }
+  return lanes;
+}
+
+bool AssignmentBatch::evaluateRead(const ReadExpr &re, unsigned &slot) {
+  unsigned index;
+  if (!evaluate(re.index, index))
+    return false;
+
+  uint64_t result[MaxLanes] = { 0 };
+  uint64_t pending = live, undefined = values[index].undefined;
+  for (const UpdateNode *un = re.updates.head; un && pending; un = un->next) {
+    uint64_t matches = 0;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(un->index)) {
+      uint64_t c = CE->getZExtValue();
+      const uint64_t *idx = values[index].v;
+      for (unsigned i = 0; i < MaxLanes; i++)
+        matches |= (uint64_t) (idx[i] == c) << i;
+    } else {
+      unsigned u;
+      if (!evaluate(un->index, u))
+        return false;
+      const Lanes &idx = values[index], &at = values[u];
+      for (unsigned i = 0; i < MaxLanes; i++)
+        matches |= (uint64_t) (idx.v[i] == at.v[i]) << i;
+      undefined |= at.undefined & pending;
+    }
+    matches &= pending;
+    if (!matches)
+      continue;
+
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(un->value)) {
+      uint64_t c = CE->getZExtValue();
+      for (unsigned i = 0; i < MaxLanes; i++)
+        if ((matches >> i) & 1)
+          result[i] = c;
+    } else {
+      unsigned u;
+      if (!evaluate(un->value, u))
+        return false;
+      const Lanes &value = values[u];
+      for (unsigned i = 0; i < MaxLanes; i++)
+        if ((matches >> i) & 1)
+          result[i] = value.v[i];
+      undefined |= value.undefined & matches;
+    }
+    pending &= ~matches;
+  }
+
+  // the lanes which no update wrote read the initial value
+  const Array *root = re.updates.root;
+  const uint64_t *idx = values[index].v;
+  std::map<const Array*, ArrayLanes>::const_iterator it = arrays.find(root);
+  for (unsigned i = 0; i < MaxLanes; i++) {
+    if (!((pending >> i) & 1))
+      continue;
+    if (root->isConstantArray() && idx[i] < root->size)
+      result[i] = root->constantValues[idx[i]]->getZExtValue();
+    else if (it != arrays.end() && idx[i] < it->second.size[i])
+      result[i] = it->second.bytes[i][idx[i]];
+  }
+
+  slot = newSlot();
+  Lanes &out = values[slot];
+  for (unsigned i = 0; i < MaxLanes; i++)
+    out.v[i] = result[i];
+  out.undefined = undefined;
+  return true;
+}
+
+bool AssignmentBatch::evaluate(const ref<Expr> &e, unsigned &slot) {
+  std::unordered_map<const Expr*, unsigned>::iterator found =
+    slots.find(e.get());
+  if (found != slots.end()) {
+    slot = found->second;
+    return true;
+  }
+  Expr::Width width = e->getWidth();
+  if (width > 64)
+    return false;
+  uint64_t mask = getMask(width);
+
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    uint64_t c = cast<ConstantExpr>(e)->getZExtValue();
+    slot = newSlot();
+    Lanes &out = values[slot];
+    for (unsigned i = 0; i < MaxLanes; i++)
+      out.v[i] = c;
+    out.undefined = 0;
+    break;
+  }
+
+  case Expr::NotOptimized:
+    if (!evaluate(cast<NotOptimizedExpr>(e)->src, slot))
+      return false;
+    break;
+
+  case Expr::Read:
+    if (!evaluateRead(*cast<ReadExpr>(e), slot))
+      return false;
+    break;
+
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    unsigned c, t, f;
+    if (!evaluate(se->cond, c) || !evaluate(se->trueExpr, t) ||
+        !evaluate(se->falseExpr, f))
+      return false;
+    slot = newSlot();
+    const Lanes &cond = values[c], &a = values[t], &b = values[f];
+    Lanes &out = values[slot];
+    for (unsigned i = 0; i < MaxLanes; i++)
+      out.v[i] = (cond.v[i] & 1) ? a.v[i] : b.v[i];
+    out.undefined = cond.undefined | a.undefined | b.undefined;
+    break;
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    unsigned l, r;
+    if (!evaluate(ce->getLeft(), l) || !evaluate(ce->getRight(), r))
+      return false;
+    unsigned shift = ce->getRight()->getWidth();
+    slot = newSlot();
+    const Lanes &a = values[l], &b = values[r];
+    Lanes &out = values[slot];
+    for (unsigned i = 0; i < MaxLanes; i++)
+      out.v[i] = (a.v[i] << shift) | b.v[i];
+    out.undefined = a.undefined | b.undefined;
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    unsigned k;
+    if (!evaluate(ee->expr, k))
+      return false;
+    unsigned offset = ee->offset;
+    slot = newSlot();
+    const Lanes &a = values[k];
+    Lanes &out = values[slot];
+    for (unsigned i = 0; i < MaxLanes; i++)
+      out.v[i] = (a.v[i] >> offset) & mask;
+    out.undefined = a.undefined;
+    break;
+  }
+
+  case Expr::ZExt:
+  case Expr::SExt:
+  case Expr::Not: {
+    unsigned k;
+    if (!evaluate(e->getKid(0), k))
+      return false;
+    Expr::Width kidWidth = e->getKid(0)->getWidth();
+    slot = newSlot();
+    const Lanes &a = values[k];
+    Lanes &out = values[slot];
+    if (e->getKind() == Expr::ZExt) {
+      for (unsigned i = 0; i < MaxLanes; i++)
+        out.v[i] = a.v[i];
+    } else if (e->getKind() == Expr::SExt) {
+      for (unsigned i = 0; i < MaxLanes; i++)
+        out.v[i] = (uint64_t) signExtend(a.v[i], kidWidth) & mask;
+    } else {
+      for (unsigned i = 0; i < MaxLanes; i++)
+        out.v[i] = ~a.v[i] & mask;
+    }
+    out.undefined = a.undefined;
+    break;
+  }
+
+  default: {
+    const BinaryExpr *be = dyn_cast<BinaryExpr>(e);
+    if (!be)
+      return false;
+    unsigned l, r;
+    if (!evaluate(be->left, l) || !evaluate(be->right, r))
+      return false;
+    // the width of the operands, which is not that of a comparison
+    Expr::Width w = be->left->getWidth();
+    uint64_t m = getMask(w);
+    slot = newSlot();
+    const Lanes &a = values[l], &b = values[r];
+    Lanes &out = values[slot];
+    out.undefined = a.undefined | b.undefined;
+
+#define LANES(value)                                                  \
+    for (unsigned i = 0; i < MaxLanes; i++) {                         \
+      uint64_t x = a.v[i], y = b.v[i];                                \
+      (void) x; (void) y;                                             \
+      out.v[i] = (value);                                             \
+    }
+#define SIGNED_LANES(value)                                           \
+    for (unsigned i = 0; i < MaxLanes; i++) {                         \
+      int64_t x = signExtend(a.v[i], w), y = signExtend(b.v[i], w);   \
+      out.v[i] = (value);                                             \
+    }
+
+    switch (e->getKind()) {
+    case Expr::Add: LANES((x + y) & m); break;
+    case Expr::Sub: LANES((x - y) & m); break;
+    case Expr::Mul: LANES((x * y) & m); break;
+    case Expr::And: LANES(x & y); break;
+    case Expr::Or: LANES(x | y); break;
+    case Expr::Xor: LANES(x ^ y); break;
+    case Expr::Shl: LANES(y >= w ? 0 : (x << y) & m); break;
+    case Expr::LShr: LANES(y >= w ? 0 : x >> y); break;
+    case Expr::AShr:
+      LANES((uint64_t) (signExtend(x, w) >> (y >= w ? w - 1 : y)) & m);
+      break;
+
+    // a division by zero leaves the lane to the scalar evaluation, and
+    // INT64_MIN / -1 wraps as in APInt
+    case Expr::UDiv:
+    case Expr::URem:
+    case Expr::SDiv:
+    case Expr::SRem:
+      for (unsigned i = 0; i < MaxLanes; i++)
+        out.undefined |= (uint64_t) (b.v[i] == 0) << i;
+      switch (e->getKind()) {
+      case Expr::UDiv: LANES(y ? x / y : 0); break;
+      case Expr::URem: LANES(y ? x % y : 0); break;
+      case Expr::SDiv:
+        SIGNED_LANES(!y ? 0 : (y == -1 ? (0 - (uint64_t) x) & m :
+                               (uint64_t) (x / y) & m));
+        break;
+      default:
+        SIGNED_LANES(!y || y == -1 ? 0 : (uint64_t) (x % y) & m);
+        break;
+      }
+      break;
+
+    case Expr::Eq: LANES(x == y); break;
+    case Expr::Ne: LANES(x != y); break;
+    case Expr::Ult: LANES(x < y); break;
+    case Expr::Ule: LANES(x <= y); break;
+    case Expr::Ugt: LANES(x > y); break;
+    case Expr::Uge: LANES(x >= y); break;
+    case Expr::Slt: SIGNED_LANES(x < y); break;
+    case Expr::Sle: SIGNED_LANES(x <= y); break;
+    case Expr::Sgt: SIGNED_LANES(x > y); break;
+    case Expr::Sge: SIGNED_LANES(x >= y); break;
+    default:
+      return false;
+    }
+#undef LANES
+#undef SIGNED_LANES
+    break;
+  }
+  }
+
+  slots[e.get()] = slot;
+  return true;
+}
@@ -0,0 +1,560 @@
+//===-- BinaryQueryLog.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/BinaryQueryLog.h"
+
+#include "expr/Parser.h"
+
+#include "klee/Constraints.h"
+#include "klee/ExprBuilder.h"
+#include "klee/Solver.h"
+#include "klee/util/ArrayCache.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+
+using namespace llvm;
+using namespace klee;
+using namespace klee::expr;
+
+const char klee::BinaryQueryLogMagic[4] = {'K', 'Q', 'B', '1'};
+
+/// The writer starts over once its tables hold this many entries, so that
+/// the expressions they keep alive do not accumulate over a whole run.
+static const unsigned MaxTableSize = 1 << 22;
+
+static void writeVarint(std::string &out, uint64_t v) {
+  do {
+    unsigned char byte = v & 0x7f;
+    v >>= 7;
+    if (v)
+      byte |= 0x80;
+    out.push_back((char) byte);
+  } while (v);
+}
+
+static void writeString(std::string &out, const std::string &s) {
+  writeVarint(out, s.size());
+  out += s;
+}
+
+/***/
+
+void BinaryQueryLogWriter::writeHeader(std::string &out) {
+  out.append(BinaryQueryLogMagic, sizeof(BinaryQueryLogMagic));
+}
+
+unsigned BinaryQueryLogWriter::getArray(std::string &out,
+                                        const Array *array) {
+  llvm::DenseMap<const Array*, unsigned>::iterator it = arrays.find(array);
+  if (it != arrays.end())
+    return it->second;
+  writeArray(out, array);
+  return arrays[array];
+}
+
+void BinaryQueryLogWriter::writeArray(std::string &out, const Array *array) {
+  std::vector<unsigned> values;
+  for (unsigned i = 0; i < array->constantValues.size(); ++i)
+    values.push_back(getExpr(out, array->constantValues[i]));
+
+  out.push_back('A');
+  writeString(out, array->name);
+  writeVarint(out, array->size);
+  writeVarint(out, array->domain);
+  writeVarint(out, array->range);
+  writeVarint(out, values.size());
+  for (unsigned i = 0; i < values.size(); ++i)
+    writeVarint(out, values[i]);
+
+  unsigned id = arrays.size();
+  arrays[array] = id;
+}
+
+void BinaryQueryLogWriter::writeUpdates(std::string &out,
+                                        const UpdateNode *head) {
+  // Update lists can be very long, so find the oldest node not written yet
+  // instead of recursing down the list.
+  std::vector<const UpdateNode*> pending;
+  for (const UpdateNode *un = head; un && !updates.count(un); un = un->next)
+    pending.push_back(un);
+
+  for (unsigned i = pending.size(); i-- > 0;) {
+    const UpdateNode *un = pending[i];
+    unsigned index = getExpr(out, un->index);
+    unsigned value = getExpr(out, un->value);
+
+    out.push_back('U');
+    writeVarint(out, un->next ? updates[un->next] + 1 : 0);
+    writeVarint(out, index);
+    writeVarint(out, value);
+
+    unsigned id = updates.size();
+    updates[un] = id;
+    updateRefs.push_back(UpdateList(0, un));
+  }
+}
+
+unsigned BinaryQueryLogWriter::getExpr(std::string &out, const ref<Expr> &e) {
+  llvm::DenseMap<const Expr*, unsigned>::iterator it = exprs.find(e.get());
+  if (it != exprs.end())
+    return it->second;
+  writeExpr(out, e);
+  return exprs[e.get()];
+}
+
+void BinaryQueryLogWriter::writeExpr(std::string &out, const ref<Expr> &e) {
+  std::vector<uint64_t> operands;
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    const APInt &value = cast<ConstantExpr>(e)->getAPValue();
+    operands.assign(value.getRawData(),
+                    value.getRawData() + value.getNumWords());
+    break;
+  }
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    operands.push_back(getArray(out, re->updates.root));
+    writeUpdates(out, re->updates.head);
+    operands.push_back(re->updates.head ? updates[re->updates.head] + 1 : 0);
+    operands.push_back(getExpr(out, re->index));
+    break;
+  }
+  case Expr::Extract:
+    operands.push_back(cast<ExtractExpr>(e)->offset);
+    operands.push_back(getExpr(out, e->getKid(0)));
+    break;
+  default:
+    for (unsigned i = 0; i < e->getNumKids(); ++i)
+      operands.push_back(getExpr(out, e->getKid(i)));
+    break;
+  }
+
+  out.push_back('E');
+  writeVarint(out, e->getKind());
+  writeVarint(out, e->getWidth());
+  for (unsigned i = 0; i < operands.size(); ++i)
+    writeVarint(out, operands[i]);
+
+  unsigned id = exprs.size();
+  exprs[e.get()] = id;
+  exprRefs.push_back(e);
+}
+
+void BinaryQueryLogWriter::writeQuery(std::string &defs, std::string &out,
+                                      QueryType type, const Query &query,
+                                      const std::vector<const Array*> *objects) {
+  std::vector<unsigned> constraints;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it)
+    constraints.push_back(getExpr(defs, *it));
+  unsigned expr = getExpr(defs, query.expr);
+  std::vector<unsigned> arrays;
+  if (objects)
+    for (unsigned i = 0; i < objects->size(); ++i)
+      arrays.push_back(getArray(defs, (*objects)[i]));
+
+  out.push_back('Q');
+  writeVarint(out, type);
+  writeVarint(out, constraints.size());
+  for (unsigned i = 0; i < constraints.size(); ++i)
+    writeVarint(out, constraints[i]);
+  writeVarint(out, expr);
+  writeVarint(out, arrays.size());
+  for (unsigned i = 0; i < arrays.size(); ++i)
+    writeVarint(out, arrays[i]);
+}
+
+void BinaryQueryLogWriter::writeResult(std::string &out, bool success,
+                                       double elapsed, unsigned answer) {
+  out.push_back('R');
+  writeVarint(out, success);
+  writeVarint(out, (uint64_t) (elapsed * 1000000));
+  writeVarint(out, answer);
+}
+
+void BinaryQueryLogWriter::resetIfFull(std::string &out) {
+  if (arrays.size() + updates.size() + exprs.size() < MaxTableSize)
+    return;
+
+  out.push_back('Z');
+  arrays.clear();
+  updates.clear();
+  exprs.clear();
+  updateRefs.clear();
+  exprRefs.clear();
+}
+
+bool klee::isBinaryQueryLog(const MemoryBuffer *MB) {
+  return MB->getBufferSize() >= sizeof(BinaryQueryLogMagic) &&
+         !memcmp(MB->getBufferStart(), BinaryQueryLogMagic,
+                 sizeof(BinaryQueryLogMagic));
+}
+
+/***/
+
+namespace {
+  /// Reads a binary query log, see BinaryQueryLogWriter for the format.
+  class BinaryQueryLogParser : public Parser {
+    const std::string Filename;
+    const unsigned char *Start, *Pos, *End;
+    ExprBuilder *Builder;
+    ArrayCache OwnArrayCache;
+    ArrayCache &TheArrayCache;
+    unsigned NumErrors;
+
+    std::vector<const Array*> Arrays;
+    std::vector<UpdateList> Updates;
+    std::vector<ref<Expr> > Exprs;
+
+    void Error(const char *Message);
+    bool ReadVarint(uint64_t &v);
+    bool ReadIndex(unsigned &index, size_t size);
+    bool ReadExpr(ref<Expr> &e);
+    bool ReadArrayRecord();
+    bool ReadUpdateRecord();
+    bool ReadExprRecord();
+    Decl *ReadQueryRecord();
+
+  public:
+    BinaryQueryLogParser(const std::string &_Filename, const MemoryBuffer *MB,
+                         ExprBuilder *_Builder, ArrayCache *_Arrays)
+      : Filename(_Filename),
+        Start((const unsigned char*) MB->getBufferStart()),
+        Pos(Start + sizeof(BinaryQueryLogMagic)),
+        End((const unsigned char*) MB->getBufferEnd()),
+        Builder(_Builder),
+        TheArrayCache(_Arrays ? *_Arrays : OwnArrayCache),
+        NumErrors(0) {}
+
+    /// A parser for chunks of records, see ReadChunk.
+    BinaryQueryLogParser(const std::string &_Filename, ExprBuilder *_Builder,
+                         ArrayCache *_Arrays)
+      : Filename(_Filename), Start(0), Pos(0), End(0), Builder(_Builder),
+        TheArrayCache(_Arrays ? *_Arrays : OwnArrayCache),
+        NumErrors(0) {}
+
+    /// Read the records from B to E, which end with a query record.
+    QueryCommand *ReadChunk(const unsigned char *B, const unsigned char *E);
+
+    virtual Decl *ParseTopLevelDecl();
+
+    // The log cannot be resynchronized after an error, so parsing always
+    // stops at the first one.
+    virtual void SetMaxErrors(unsigned N) {}
+
+    virtual unsigned GetNumErrors() const {
+      return NumErrors;
+    }
+  };
+}
+
+void BinaryQueryLogParser::Error(const char *Message) {
+  ++NumErrors;
+  llvm::errs() << Filename << ": offset " << (Pos - Start)
+               << ": error: " << Message << "\n";
+}
+
+bool BinaryQueryLogParser::ReadVarint(uint64_t &v) {
+  v = 0;
+  for (unsigned shift = 0; Pos != End && shift < 64; shift += 7) {
+    unsigned char byte = *Pos++;
+    v |= (uint64_t) (byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  Error("truncated or invalid integer");
+  return false;
+}
+
+bool BinaryQueryLogParser::ReadIndex(unsigned &index, size_t size) {
+  uint64_t v;
+  if (!ReadVarint(v))
+    return false;
+  if (v >= size) {
+    Error("reference to an undefined entry");
+    return false;
+  }
+  index = v;
+  return true;
+}
+
+bool BinaryQueryLogParser::ReadExpr(ref<Expr> &e) {
+  unsigned index;
+  if (!ReadIndex(index, Exprs.size()))
+    return false;
+  e = Exprs[index];
+  return true;
+}
+
+bool BinaryQueryLogParser::ReadArrayRecord() {
+  uint64_t length, size, domain, range, numValues;
+  if (!ReadVarint(length))
+    return false;
+  if ((uint64_t) (End - Pos) < length) {
+    Error("truncated array name");
+    return false;
+  }
+  std::string name((const char*) Pos, length);
+  Pos += length;
+  if (!ReadVarint(size) || !ReadVarint(domain) || !ReadVarint(range) ||
+      !ReadVarint(numValues))
+    return false;
+
+  std::vector<ref<ConstantExpr> > values;
+  for (uint64_t i = 0; i < numValues; ++i) {
+    ref<Expr> e;
+    if (!ReadExpr(e))
+      return false;
+    ConstantExpr *ce = dyn_cast<ConstantExpr>(e);
+    if (!ce) {
+      Error("non-constant array value");
+      return false;
+    }
+    values.push_back(ce);
+  }
+
+  Arrays.push_back(TheArrayCache.CreateArray(
+      name, size, values.empty() ? 0 : &values[0],
+      values.empty() ? 0 : &values[0] + values.size(), domain, range));
+  return true;
+}
+
+bool BinaryQueryLogParser::ReadUpdateRecord() {
+  uint64_t next;
+  ref<Expr> index, value;
+  if (!ReadVarint(next))
+    return false;
+  if (next > Updates.size()) {
+    Error("reference to an undefined update");
+    return false;
+  }
+  if (!ReadExpr(index) || !ReadExpr(value))
+    return false;
+
+  UpdateList ul(0, next ? Updates[next - 1].head : 0);
+  ul.extend(index, value);
+  Updates.push_back(ul);
+  return true;
+}
+
+bool BinaryQueryLogParser::ReadExprRecord() {
+  uint64_t kind, width;
+  if (!ReadVarint(kind) || !ReadVarint(width))
+    return false;
+
+  ref<Expr> e;
+  switch (kind) {
+  case Expr::Constant: {
+    std::vector<uint64_t> words((width + 63) / 64);
+    for (unsigned i = 0; i < words.size(); ++i)
+      if (!ReadVarint(words[i]))
+        return false;
+    e = Builder->Constant(APInt(width, words));
+    break;
+  }
+  case Expr::Read: {
+    unsigned array;
+    uint64_t head;
+    ref<Expr> index;
+    if (!ReadIndex(array, Arrays.size()) || !ReadVarint(head))
+      return false;
+    if (head > Updates.size()) {
+      Error("reference to an undefined update");
+      return false;
+    }
+    if (!ReadExpr(index))
+      return false;
+    e = Builder->Read(UpdateList(Arrays[array],
+                                 head ? Updates[head - 1].head : 0),
+                      index);
+    break;
+  }
+  case Expr::Extract: {
+    uint64_t offset;
+    ref<Expr> kid;
+    if (!ReadVarint(offset) || !ReadExpr(kid))
+      return false;
+    e = Builder->Extract(kid, offset, width);
+    break;
+  }
+  case Expr::Select: {
+    ref<Expr> cond, t, f;
+    if (!ReadExpr(cond) || !ReadExpr(t) || !ReadExpr(f))
+      return false;
+    e = Builder->Select(cond, t, f);
+    break;
+  }
+  case Expr::NotOptimized:
+  case Expr::ZExt:
+  case Expr::SExt:
+  case Expr::Not: {
+    ref<Expr> kid;
+    if (!ReadExpr(kid))
+      return false;
+    if (kind == Expr::NotOptimized)
+      e = Builder->NotOptimized(kid);
+    else if (kind == Expr::ZExt)
+      e = Builder->ZExt(kid, width);
+    else if (kind == Expr::SExt)
+      e = Builder->SExt(kid, width);
+    else
+      e = Builder->Not(kid);
+    break;
+  }
+  default: {
+    ref<Expr> l, r;
+    if (kind < Expr::Concat || kind > Expr::LastKind) {
+      Error("invalid expression kind");
+      return false;
+    }
+    if (!ReadExpr(l) || !ReadExpr(r))
+      return false;
+    switch (kind) {
+    case Expr::Concat: e = Builder->Concat(l, r); break;
+    case Expr::Add: e = Builder->Add(l, r); break;
+    case Expr::Sub: e = Builder->Sub(l, r); break;
+    case Expr::Mul: e = Builder->Mul(l, r); break;
+    case Expr::UDiv: e = Builder->UDiv(l, r); break;
+    case Expr::SDiv: e = Builder->SDiv(l, r); break;
+    case Expr::URem: e = Builder->URem(l, r); break;
+    case Expr::SRem: e = Builder->SRem(l, r); break;
+    case Expr::And: e = Builder->And(l, r); break;
+    case Expr::Or: e = Builder->Or(l, r); break;
+    case Expr::Xor: e = Builder->Xor(l, r); break;
+    case Expr::Shl: e = Builder->Shl(l, r); break;
+    case Expr::LShr: e = Builder->LShr(l, r); break;
+    case Expr::AShr: e = Builder->AShr(l, r); break;
+    case Expr::Eq: e = Builder->Eq(l, r); break;
+    case Expr::Ne: e = Builder->Ne(l, r); break;
+    case Expr::Ult: e = Builder->Ult(l, r); break;
+    case Expr::Ule: e = Builder->Ule(l, r); break;
+    case Expr::Ugt: e = Builder->Ugt(l, r); break;
+    case Expr::Uge: e = Builder->Uge(l, r); break;
+    case Expr::Slt: e = Builder->Slt(l, r); break;
+    case Expr::Sle: e = Builder->Sle(l, r); break;
+    case Expr::Sgt: e = Builder->Sgt(l, r); break;
+    case Expr::Sge: e = Builder->Sge(l, r); break;
+    default:
+      Error("invalid expression kind");
+      return false;
+    }
+    break;
+  }
+  }
+
+  Exprs.push_back(e);
+  return true;
+}
+
+Decl *BinaryQueryLogParser::ReadQueryRecord() {
+  uint64_t type, numConstraints, numObjects;
+  if (!ReadVarint(type) || !ReadVarint(numConstraints))
+    return 0;
+
+  std::vector<ExprHandle> constraints;
+  for (uint64_t i = 0; i < numConstraints; ++i) {
+    ref<Expr> e;
+    if (!ReadExpr(e))
+      return 0;
+    constraints.push_back(e);
+  }
+  ref<Expr> query;
+  if (!ReadExpr(query) || !ReadVarint(numObjects))
+    return 0;
+  std::vector<const Array*> objects;
+  for (uint64_t i = 0; i < numObjects; ++i) {
+    unsigned array;
+    if (!ReadIndex(array, Arrays.size()))
+      return 0;
+    objects.push_back(Arrays[array]);
+  }
+
+  // Value queries are asked for a value of the expression under the
+  // constraints, which the .kquery logs print as a query of false.
+  std::vector<ExprHandle> values;
+  if (type == BinaryQueryLogWriter::Value) {
+    values.push_back(query);
+    query = Builder->False();
+  }
+  return new QueryCommand(constraints, query, values, objects);
+}
+
+Decl *BinaryQueryLogParser::ParseTopLevelDecl() {
+  while (!NumErrors && Pos != End) {
+    unsigned char tag = *Pos++;
+    switch (tag) {
+    case 'A':
+      ReadArrayRecord();
+      break;
+    case 'U':
+      ReadUpdateRecord();
+      break;
+    case 'E':
+      ReadExprRecord();
+      break;
+    case 'Q':
+      return ReadQueryRecord();
+    case 'R': {
+      uint64_t v;
+      for (unsigned i = 0; i < 3 && ReadVarint(v); ++i)
+        ;
+      break;
+    }
+    case 'Z':
+      Arrays.clear();
+      Updates.clear();
+      Exprs.clear();
+      break;
+    default:
+      --Pos;
+      Error("invalid record");
+      break;
+    }
+  }
+  return 0;
+}
+
+QueryCommand *BinaryQueryLogParser::ReadChunk(const unsigned char *B,
+                                              const unsigned char *E) {
+  Start = Pos = B;
+  End = E;
+  Decl *D = ParseTopLevelDecl();
+  if (D && Pos != End) {
+    Error("records after the query");
+    delete D;
+    return 0;
+  }
+  return static_cast<QueryCommand*>(D);
+}
+
+BinaryQueryLogReader::BinaryQueryLogReader(ExprBuilder *builder,
+                                           ArrayCache *arrays)
+  : parser(new BinaryQueryLogParser("<query stream>", builder, arrays)) {}
+
+BinaryQueryLogReader::~BinaryQueryLogReader() {
+  delete parser;
+}
+
+QueryCommand *BinaryQueryLogReader::readQuery(const char *data, size_t n) {
+  const unsigned char *start = (const unsigned char*) data;
+  return static_cast<BinaryQueryLogParser*>(parser)->ReadChunk(start,
+                                                               start + n);
+}
+
+Parser *expr::createBinaryQueryLogParser(const std::string &Filename,
+                                         const MemoryBuffer *MB,
+                                         ExprBuilder *Builder,
+                                         ArrayCache *Arrays) {
+  return new BinaryQueryLogParser(Filename, MB, Builder, Arrays);
+}
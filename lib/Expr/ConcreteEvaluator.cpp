@@ -0,0 +1,254 @@
+//===-- ConcreteEvaluator.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ConcreteEvaluator.h"
+
+#include "klee/util/Assignment.h"
+
+using namespace klee;
+
+namespace {
+  /// A width with a machine type, truncation and sign extension are casts.
+  template<typename T, typename S> struct NativeWidth {
+    enum { Bits = sizeof(T) * 8 };
+    uint64_t truncate(uint64_t v) const { return (T) v; }
+    int64_t signExtend(uint64_t v) const { return (S) (T) v; }
+    unsigned bits() const { return Bits; }
+  };
+
+  struct BoolWidth {
+    uint64_t truncate(uint64_t v) const { return v & 1; }
+    int64_t signExtend(uint64_t v) const { return -(int64_t) (v & 1); }
+    unsigned bits() const { return 1; }
+  };
+
+  /// Any other width up to 64 bits.
+  struct MaskedWidth {
+    unsigned width;
+    uint64_t mask;
+    explicit MaskedWidth(unsigned _width)
+      : width(_width), mask(_width >= 64 ? ~0ULL : (1ULL << _width) - 1) {}
+    uint64_t truncate(uint64_t v) const { return v & mask; }
+    int64_t signExtend(uint64_t v) const {
+      return width >= 64 ? (int64_t) v :
+          (int64_t) (v << (64 - width)) >> (64 - width);
+    }
+    unsigned bits() const { return width; }
+  };
+}
+
+/// The kernel of the binary operations, on operands of the width W, which
+/// are truncated to it. Returns false on a division by zero.
+template<typename W>
+static bool evaluateBinary(const W &w, Expr::Kind kind, uint64_t x,
+                           uint64_t y, uint64_t &out) {
+  switch (kind) {
+  case Expr::Add: out = w.truncate(x + y); return true;
+  case Expr::Sub: out = w.truncate(x - y); return true;
+  case Expr::Mul: out = w.truncate(x * y); return true;
+  case Expr::And: out = x & y; return true;
+  case Expr::Or: out = x | y; return true;
+  case Expr::Xor: out = x ^ y; return true;
+  case Expr::Shl: out = y >= w.bits() ? 0 : w.truncate(x << y); return true;
+  case Expr::LShr: out = y >= w.bits() ? 0 : x >> y; return true;
+  case Expr::AShr:
+    out = w.truncate((uint64_t) (w.signExtend(x) >>
+                                 (y >= w.bits() ? w.bits() - 1 : y)));
+    return true;
+
+  case Expr::UDiv:
+  case Expr::URem:
+    if (!y)
+      return false;
+    out = kind == Expr::UDiv ? x / y : x % y;
+    return true;
+
+  // INT_MIN / -1 wraps as in APInt
+  case Expr::SDiv:
+  case Expr::SRem: {
+    int64_t sx = w.signExtend(x), sy = w.signExtend(y);
+    if (!sy)
+      return false;
+    if (kind == Expr::SDiv)
+      out = w.truncate(sy == -1 ? 0 - (uint64_t) sx : (uint64_t) (sx / sy));
+    else
+      out = sy == -1 ? 0 : w.truncate((uint64_t) (sx % sy));
+    return true;
+  }
+
+  case Expr::Eq: out = x == y; return true;
+  case Expr::Ne: out = x != y; return true;
+  case Expr::Ult: out = x < y; return true;
+  case Expr::Ule: out = x <= y; return true;
+  case Expr::Ugt: out = x > y; return true;
+  case Expr::Uge: out = x >= y; return true;
+  case Expr::Slt: out = w.signExtend(x) < w.signExtend(y); return true;
+  case Expr::Sle: out = w.signExtend(x) <= w.signExtend(y); return true;
+  case Expr::Sgt: out = w.signExtend(x) > w.signExtend(y); return true;
+  case Expr::Sge: out = w.signExtend(x) >= w.signExtend(y); return true;
+  default:
+    return false;
+  }
+}
+
+static bool evaluateBinary(Expr::Width width, Expr::Kind kind, uint64_t x,
+                           uint64_t y, uint64_t &out) {
+  switch (width) {
+  case Expr::Bool:
+    return evaluateBinary(BoolWidth(), kind, x, y, out);
+  case Expr::Int8:
+    return evaluateBinary(NativeWidth<uint8_t, int8_t>(), kind, x, y, out);
+  case Expr::Int16:
+    return evaluateBinary(NativeWidth<uint16_t, int16_t>(), kind, x, y, out);
+  case Expr::Int32:
+    return evaluateBinary(NativeWidth<uint32_t, int32_t>(), kind, x, y, out);
+  case Expr::Int64:
+    return evaluateBinary(NativeWidth<uint64_t, int64_t>(), kind, x, y, out);
+  default:
+    return evaluateBinary(MaskedWidth(width), kind, x, y, out);
+  }
+}
+
+static int64_t signExtend(uint64_t value, Expr::Width width) {
+  switch (width) {
+  case Expr::Bool: return BoolWidth().signExtend(value);
+  case Expr::Int8: return (int8_t) value;
+  case Expr::Int16: return (int16_t) value;
+  case Expr::Int32: return (int32_t) value;
+  case Expr::Int64: return (int64_t) value;
+  default: return MaskedWidth(width).signExtend(value);
+  }
+}
+
+ConcreteEvaluator::ConcreteEvaluator(const Assignment &_assignment)
+  : assignment(_assignment) {
+  assert(!assignment.allowFreeValues && "free values cannot be concrete");
+}
+
+ref<ConstantExpr> ConcreteEvaluator::evaluate(const ref<Expr> &e) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e))
+    return CE;
+  uint64_t value;
+  if (!evaluate(e, value))
+    return ref<ConstantExpr>();
+  return ConstantExpr::alloc(value, e->getWidth());
+}
+
+bool ConcreteEvaluator::evaluate(const ref<Expr> &e, uint64_t &value) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+    if (CE->getWidth() > 64)
+      return false;
+    value = CE->getZExtValue();
+    return true;
+  }
+
+  std::unordered_map<const Expr*, uint64_t>::iterator it =
+    values.find(e.get());
+  if (it != values.end()) {
+    value = it->second;
+    return true;
+  }
+  if (e->getWidth() > 64 || !evaluateNode(e, value))
+    return false;
+  values[e.get()] = value;
+  return true;
+}
+
+bool ConcreteEvaluator::evaluateRead(const ReadExpr &re, uint64_t &value) {
+  uint64_t index;
+  if (!evaluate(re.index, index))
+    return false;
+
+  for (const UpdateNode *un = re.updates.head; un; un = un->next) {
+    uint64_t at;
+    if (!evaluate(un->index, at))
+      return false;
+    if (at == index)
+      return evaluate(un->value, value);
+  }
+
+  const Array *root = re.updates.root;
+  if (root->isConstantArray() && index < root->size) {
+    value = root->constantValues[index]->getZExtValue();
+    return true;
+  }
+  Assignment::bindings_ty::const_iterator binding =
+    assignment.bindings.find(root);
+  value = binding != assignment.bindings.end() &&
+      index < binding->second.size() ? binding->second[index] : 0;
+  return true;
+}
+
+bool ConcreteEvaluator::evaluateNode(const ref<Expr> &e, uint64_t &value) {
+  Expr::Width width = e->getWidth();
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    return evaluate(cast<NotOptimizedExpr>(e)->src, value);
+
+  case Expr::Read:
+    return evaluateRead(*cast<ReadExpr>(e), value);
+
+  case Expr::Select: {
+    // only the side taken is evaluated
+    const SelectExpr *se = cast<SelectExpr>(e);
+    uint64_t cond;
+    if (!evaluate(se->cond, cond))
+      return false;
+    return evaluate(cond ? se->trueExpr : se->falseExpr, value);
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    uint64_t left, right;
+    if (!evaluate(ce->getLeft(), left) || !evaluate(ce->getRight(), right))
+      return false;
+    value = (left << ce->getRight()->getWidth()) | right;
+    return true;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    uint64_t kid;
+    if (!evaluate(ee->expr, kid))
+      return false;
+    value = MaskedWidth(width).truncate(kid >> ee->offset);
+    return true;
+  }
+
+  case Expr::ZExt:
+    return evaluate(e->getKid(0), value);
+
+  case Expr::SExt: {
+    uint64_t kid;
+    if (!evaluate(e->getKid(0), kid))
+      return false;
+    value = MaskedWidth(width).truncate(
+        (uint64_t) signExtend(kid, e->getKid(0)->getWidth()));
+    return true;
+  }
+
+  case Expr::Not: {
+    uint64_t kid;
+    if (!evaluate(e->getKid(0), kid))
+      return false;
+    value = MaskedWidth(width).truncate(~kid);
+    return true;
+  }
+
+  default: {
+    const BinaryExpr *be = dyn_cast<BinaryExpr>(e);
+    uint64_t left, right;
+    if (!be || !evaluate(be->left, left) || !evaluate(be->right, right))
+      return false;
+    // the width of the operands, which is not that of a comparison
+    return evaluateBinary(be->left->getWidth(), e->getKind(), left, right,
+                          value);
+  }
+  }
+}
@@ -0,0 +1,171 @@
+//===-- ConstraintPartition.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ConstraintPartition.h"
+
+#include "klee/util/ExprUtil.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace klee;
+
+/// the array elements e reads at constant indices, and the arrays it reads
+/// at symbolic ones (as in the independent solver)
+static void getAccesses(ref<Expr> e,
+                        std::vector< std::pair<const Array *, unsigned> > &reads,
+                        std::set<const Array *> &wholes) {
+  std::vector< ref<ReadExpr> > found;
+  findReads(e, /* visitUpdates= */ true, found);
+  for (unsigned i = 0; i != found.size(); ++i) {
+    ReadExpr *re = found[i].get();
+    const Array *array = re->updates.root;
+
+    // Reads of a constant array don't alias.
+    if (array->isConstantArray() && !re->updates.head)
+      continue;
+
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index))
+      reads.push_back(std::make_pair(array, (unsigned) CE->getZExtValue(32)));
+    else
+      wholes.insert(array);
+  }
+}
+
+unsigned ConstraintPartition::find(unsigned index) const {
+  while (parent[index] != index) {
+    parent[index] = parent[parent[index]];
+    index = parent[index];
+  }
+  return index;
+}
+
+void ConstraintPartition::unite(unsigned a, unsigned b) {
+  a = find(a);
+  b = find(b);
+  if (a == b)
+    return;
+  if (members[a].size() < members[b].size())
+    std::swap(a, b);
+  parent[b] = a;
+  members[a].insert(members[a].end(), members[b].begin(), members[b].end());
+  std::vector<unsigned>().swap(members[b]);
+}
+
+void ConstraintPartition::clear() {
+  parent.clear();
+  members.clear();
+  elements.clear();
+  wholeObjects.clear();
+}
+
+void ConstraintPartition::add(unsigned index, ref<Expr> e) {
+  assert(index == parent.size() && "constraints added out of order");
+  parent.push_back(index);
+  members.push_back(std::vector<unsigned>(1, index));
+
+  std::vector< std::pair<const Array *, unsigned> > reads;
+  std::set<const Array *> wholes;
+  getAccesses(e, reads, wholes);
+
+  for (std::set<const Array *>::iterator it = wholes.begin(),
+                                         ie = wholes.end(); it != ie; ++it) {
+    std::map<const Array *, unsigned>::iterator whole = wholeObjects.find(*it);
+    if (whole != wholeObjects.end()) {
+      unite(index, whole->second);
+      continue;
+    }
+    wholeObjects.insert(std::make_pair(*it, index));
+    std::map<const Array *, std::map<unsigned, unsigned> >::iterator array =
+        elements.find(*it);
+    if (array != elements.end()) {
+      for (std::map<unsigned, unsigned>::iterator elt = array->second.begin(),
+             eltEnd = array->second.end(); elt != eltEnd; ++elt)
+        unite(index, elt->second);
+      elements.erase(array);
+    }
+  }
+
+  for (unsigned i = 0; i < reads.size(); i++) {
+    std::map<const Array *, unsigned>::iterator whole =
+        wholeObjects.find(reads[i].first);
+    if (whole != wholeObjects.end()) {
+      unite(index, whole->second);
+      continue;
+    }
+    std::pair<std::map<unsigned, unsigned>::iterator, bool> elt =
+        elements[reads[i].first].insert(std::make_pair(reads[i].second, index));
+    if (!elt.second)
+      unite(index, elt.first->second);
+  }
+}
+
+bool ConstraintPartition::getDependent(ref<Expr> e,
+                                       std::vector<unsigned> &result) const {
+  std::vector< std::pair<const Array *, unsigned> > reads;
+  std::set<const Array *> wholes;
+  getAccesses(e, reads, wholes);
+
+  std::set<unsigned> roots;
+  for (std::set<const Array *>::iterator it = wholes.begin(),
+                                         ie = wholes.end(); it != ie; ++it) {
+    std::map<const Array *, unsigned>::const_iterator whole =
+        wholeObjects.find(*it);
+    if (whole != wholeObjects.end()) {
+      roots.insert(find(whole->second));
+      continue;
+    }
+    std::map<const Array *, std::map<unsigned, unsigned> >::const_iterator
+        array = elements.find(*it);
+    if (array != elements.end()) {
+      for (std::map<unsigned, unsigned>::const_iterator
+             elt = array->second.begin(), eltEnd = array->second.end();
+           elt != eltEnd; ++elt)
+        roots.insert(find(elt->second));
+    }
+  }
+
+  for (unsigned i = 0; i < reads.size(); i++) {
+    if (wholes.count(reads[i].first))
+      continue;
+    std::map<const Array *, unsigned>::const_iterator whole =
+        wholeObjects.find(reads[i].first);
+    if (whole != wholeObjects.end()) {
+      roots.insert(find(whole->second));
+      continue;
+    }
+    std::map<const Array *, std::map<unsigned, unsigned> >::const_iterator
+        array = elements.find(reads[i].first);
+    if (array == elements.end())
+      continue;
+    std::map<unsigned, unsigned>::const_iterator elt =
+        array->second.find(reads[i].second);
+    if (elt != array->second.end())
+      roots.insert(find(elt->second));
+  }
+
+  result.clear();
+  for (std::set<unsigned>::iterator it = roots.begin(), ie = roots.end();
+       it != ie; ++it)
+    result.insert(result.end(), members[*it].begin(), members[*it].end());
+  std::sort(result.begin(), result.end());
+  return !reads.empty() || !wholes.empty();
+}
+
+void ConstraintPartition::getSets(
+    std::vector< std::vector<unsigned> > &result) const {
+  result.clear();
+  for (unsigned i = 0; i < parent.size(); i++) {
+    if (parent[i] != i)
+      continue;
+    result.push_back(members[i]);
+    std::sort(result.back().begin(), result.back().end());
+  }
+  std::sort(result.begin(), result.end());
+}
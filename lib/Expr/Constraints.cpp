@@ -9,6 +9,7 @@
 
 #include "klee/Constraints.h"
 
+#include "klee/ExprBuilder.h"
 #include "klee/util/ExprPPrinter.h"
 #include "klee/util/ExprVisitor.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
@@ -28,6 +29,11 @@ namespace {
   RewriteEqualities("rewrite-equalities",
 		    llvm::cl::init(true),
 		    llvm::cl::desc("Rewrite existing constraints when an equality with a constant is added (default=on)"));
+
+  llvm::cl::opt<bool>
+  SimplifyKnownBits("simplify-known-bits",
+                    llvm::cl::init(false),
+                    llvm::cl::desc("Drop the masks, extracts and shifts the known bits of their operands make redundant from new constraints (default=off)"));
 }
 
 
@@ -57,17 +63,17 @@ public:
 
 class ExprReplaceVisitor2 : public ExprVisitor {
 private:
-  const std::map< ref<Expr>, ref<Expr> > &replacements;
+  const ImmutableMap< ref<Expr>, ref<Expr> > &replacements;
 
 public:
-  ExprReplaceVisitor2(const std::map< ref<Expr>, ref<Expr> > &_replacements) 
+  ExprReplaceVisitor2(const ImmutableMap< ref<Expr>, ref<Expr> > &_replacements) 
     : ExprVisitor(true),
       replacements(_replacements) {}
 
   Action visitExprPost(const Expr &e) {
-    std::map< ref<Expr>, ref<Expr> >::const_iterator it =
-      replacements.find(ref<Expr>(const_cast<Expr*>(&e)));
-    if (it!=replacements.end()) {
+    const std::pair< ref<Expr>, ref<Expr> > *it =
+      replacements.lookup(ref<Expr>(const_cast<Expr*>(&e)));
+    if (it) {
       return Action::changeTo(it->second);
     } else {
       return Action::doChildren();
@@ -75,24 +81,109 @@ public:
   }
 };
 
-bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
-  ConstraintManager::constraints_ty old;
+/// Rewrites every node of an expression by the known bits of its kids.
+class KnownBitsVisitor : public ExprVisitor {
+private:
+  ExprBuilder *builder;
+
+public:
+  KnownBitsVisitor(ExprBuilder *_builder) : builder(_builder) {}
+
+  Action visitExprPost(const Expr &e) {
+    ref<Expr> result =
+      simplifyKnownBits(builder, ref<Expr>(const_cast<Expr*>(&e)));
+    return result.isNull() ? Action::doChildren() : Action::changeTo(result);
+  }
+};
+
+void ConstraintManager::push(ref<Expr> e) {
+  unsigned offset = count % ChunkSize;
+  if (offset == 0) {
+    last = new Chunk(last);
+    chunks.push_back(last.get());
+  } else if (last->used != offset) {
+    // a manager sharing the chunk has appended to it, copy the part in use
+    Chunk *copy = new Chunk(last->parent);
+    for (unsigned i = 0; i < offset; i++)
+      copy->data[i] = last->data[i];
+    copy->used = offset;
+    last = copy;
+    chunks.back() = copy;
+  }
+  last->data[last->used++] = e;
+  count++;
+  simplified.clear();
+}
+
+void ConstraintManager::clear() {
+  last = 0;
+  count = 0;
+  chunks.clear();
+  simplified.clear();
+}
+
+bool ConstraintManager::operator==(const ConstraintManager &other) const {
+  if (count != other.count)
+    return false;
+  for (unsigned i = 0; i < chunks.size(); i++) {
+    if (chunks[i] == other.chunks[i])
+      continue;
+    unsigned n = i + 1 < chunks.size() ? ChunkSize : count - i * ChunkSize;
+    for (unsigned j = 0; j < n; j++)
+      if (chunks[i]->data[j] != other.chunks[i]->data[j])
+        return false;
+  }
+  return true;
+}
+
+bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor,
+                                           ref<Expr> src) {
+  // only the constraints depending on src can contain it
+  std::vector<unsigned> candidates;
+  bool all = !partitionValid || !partition.getDependent(src, candidates);
+  if (!all) {
+    bool any = false;
+    for (unsigned i = 0; i < candidates.size() && !any; i++) {
+      const ref<Expr> &ce = (*this)[candidates[i]];
+      any = visitor.visit(ce) != ce;
+    }
+    if (!any)
+      return false;
+  }
+
+  std::vector< ref<Expr> > old(begin(), end());
   bool changed = false;
 
-  constraints.swap(old);
-  for (ConstraintManager::constraints_ty::iterator 
-         it = old.begin(), ie = old.end(); it != ie; ++it) {
-    ref<Expr> &ce = *it;
+  // the constraints are only kept in place if none of them changes
+  bool wasPartitionValid = partitionValid;
+  bool wereEqualitiesValid = equalitiesValid;
+  partitionValid = false;
+  equalitiesValid = false;
+  clear();
+  unsigned next = 0;
+  for (unsigned i = 0; i < old.size(); i++) {
+    ref<Expr> &ce = old[i];
+    if (!all) {
+      if (next == candidates.size() || candidates[next] != i) {
+        push(ce);
+        continue;
+      }
+      next++;
+    }
     ref<Expr> e = visitor.visit(ce);
 
     if (e!=ce) {
       addConstraintInternal(e); // enable further reductions
       changed = true;
     } else {
-      constraints.push_back(ce);
+      push(ce);
     }
   }
 
+  if (!changed) {
+    partitionValid = wasPartitionValid;
+    equalitiesValid = wereEqualitiesValid;
+  }
   return changed;
 }
 
@@ -100,29 +191,39 @@ void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
   // XXX 
 }
 
+void ConstraintManager::addEquality(const ref<Expr> &e) const {
+  // the first constraint on an expression wins
+  std::pair< ref<Expr>, ref<Expr> > replacement(
+      e, ConstantExpr::alloc(1, Expr::Bool));
+  if (const EqExpr *ee = dyn_cast<EqExpr>(e)) {
+    if (isa<ConstantExpr>(ee->left))
+      replacement = std::make_pair(ee->right, ee->left);
+  }
+  if (!equalities.lookup(replacement.first))
+    equalities = equalities.insert(replacement);
+}
+
 ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
   if (isa<ConstantExpr>(e))
     return e;
 
-  std::map< ref<Expr>, ref<Expr> > equalities;
-  
-  for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
-      if (isa<ConstantExpr>(ee->left)) {
-        equalities.insert(std::make_pair(ee->right,
-                                         ee->left));
-      } else {
-        equalities.insert(std::make_pair(*it,
-                                         ConstantExpr::alloc(1, Expr::Bool)));
-      }
-    } else {
-      equalities.insert(std::make_pair(*it,
-                                       ConstantExpr::alloc(1, Expr::Bool)));
-    }
+  ExprHashMap< ref<Expr> >::const_iterator it = simplified.find(e);
+  if (it != simplified.end())
+    return it->second;
+
+  if (!equalitiesValid) {
+    equalities = EqualityMap();
+    for (unsigned i = 0; i < count; i++)
+      addEquality((*this)[i]);
+    equalitiesValid = true;
   }
 
-  return ExprReplaceVisitor2(equalities).visit(e);
+  ref<Expr> result = ExprReplaceVisitor2(equalities).visit(e);
+  // the expressions of one state repeat, those of old queries do not
+  if (simplified.size() >= MaxSimplified)
+    simplified.clear();
+  simplified.insert(std::make_pair(e, result));
+  return result;
 }
 
 void ConstraintManager::addConstraintInternal(ref<Expr> e) {
@@ -152,20 +253,43 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
       BinaryExpr *be = cast<BinaryExpr>(e);
       if (isa<ConstantExpr>(be->left)) {
         ExprReplaceVisitor visitor(be->right, be->left);
-        rewriteConstraints(visitor);
+        rewriteConstraints(visitor, be->right);
       }
     }
-    constraints.push_back(e);
+    pushConstraint(e);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    pushConstraint(e);
     break;
   }
 }
 
+void ConstraintManager::pushConstraint(ref<Expr> e) {
+  push(e);
+  if (partitionValid)
+    partition.add(count - 1, e);
+  if (equalitiesValid)
+    addEquality(e);
+}
+
+const ConstraintPartition &ConstraintManager::getPartition() const {
+  if (!partitionValid) {
+    partition.clear();
+    for (unsigned i = 0; i < count; i++)
+      partition.add(i, (*this)[i]);
+    partitionValid = true;
+  }
+  return partition;
+}
+
 void ConstraintManager::addConstraint(ref<Expr> e) {
   e = simplifyExpr(e);
+  if (SimplifyKnownBits) {
+    static ExprBuilder *builder = createKnownBitsExprBuilder(
+        createConstantFoldingExprBuilder(createDefaultExprBuilder()));
+    e = KnownBitsVisitor(builder).visit(e);
+  }
   addConstraintInternal(e);
 }
@@ -21,21 +21,125 @@
 
 #include "klee/util/ExprPPrinter.h"
 
+#include <algorithm>
 #include <sstream>
+#ifdef KLEE_ATOMIC_REFCOUNT
+#include <mutex>
+#endif
+
+#include <ciso646>
+#ifdef _LIBCPP_VERSION
+#include <unordered_map>
+#define unordered_multimap std::unordered_multimap
+#else
+#include <tr1/unordered_map>
+#define unordered_multimap std::tr1::unordered_multimap
+#endif
 
 using namespace klee;
 using namespace llvm;
 
+bool Expr::internExprs = false;
+
 namespace {
   cl::opt<bool>
   ConstArrayOpt("const-array-opt",
 	 cl::init(false),
 	 cl::desc("Enable various optimizations involving all-constant arrays."));
+
+  cl::opt<bool, true>
+  InternExprs("intern-exprs",
+              cl::location(Expr::internExprs),
+              cl::desc("Hash-cons the expressions, so an expression equal to "
+                       "a live one is not allocated again (default=off)"));
 }
 
 /***/
 
-unsigned Expr::count = 0;
+InstanceCount Expr::count(0);
+
+/// the live interned expressions, by hash; an expression leaves it when it
+/// is deleted. Never freed, expressions may outlive static destruction.
+typedef unordered_multimap<unsigned, Expr *> InternTable;
+
+static InternTable &getInternTable() {
+  static InternTable *table = new InternTable();
+  return *table;
+}
+
+#ifdef KLEE_ATOMIC_REFCOUNT
+/// guards the intern table, never freed either
+static std::mutex &getInternLock() {
+  static std::mutex *lock = new std::mutex();
+  return *lock;
+}
+#endif
+
+ref<Expr> Expr::internExpr(Expr *e) {
+  InternTable &table = getInternTable();
+  ref<Expr> result;
+#ifdef KLEE_ATOMIC_REFCOUNT
+  /* a candidate is held while it is compared, so that another thread can
+     not delete it meanwhile; one whose other references all went in the
+     meantime is deleted once the lock is released, as forgetting it takes
+     the lock */
+  llvm::SmallVector<Expr *, 4> orphans;
+  {
+  std::lock_guard<std::mutex> guard(getInternLock());
+#endif
+  std::pair<InternTable::iterator, InternTable::iterator> range =
+    table.equal_range(e->hashValue);
+
+  /* the kids are interned already, so comparing them is a pointer check */
+  unsigned numKids = e->getNumKids();
+  for (InternTable::iterator it = range.first;
+       result.isNull() && it != range.second; ++it) {
+    Expr *other = it->second;
+#ifdef KLEE_ATOMIC_REFCOUNT
+    if (!other->refCount.retainIfLive())
+      continue;
+#endif
+    if (other->getKind() == e->getKind() &&
+        other->getWidth() == e->getWidth() &&
+        !other->compareContents(*e)) {
+      unsigned i = 0;
+      while (i < numKids && other->getKid(i).get() == e->getKid(i).get())
+        i++;
+      if (i == numKids)
+        result = other;
+    }
+#ifdef KLEE_ATOMIC_REFCOUNT
+    if (--other->refCount == 0)
+      orphans.push_back(other);
+#endif
+  }
+
+  if (result.isNull()) {
+    table.insert(std::make_pair(e->hashValue, e));
+    result = e;
+  }
+#ifdef KLEE_ATOMIC_REFCOUNT
+  }
+  for (unsigned i = 0; i < orphans.size(); i++)
+    delete orphans[i];
+#endif
+  return result;
+}
+
+void Expr::forgetExpr(Expr *e) {
+  InternTable &table = getInternTable();
+#ifdef KLEE_ATOMIC_REFCOUNT
+  std::lock_guard<std::mutex> guard(getInternLock());
+#endif
+  std::pair<InternTable::iterator, InternTable::iterator> range =
+    table.equal_range(e->hashValue);
+  for (InternTable::iterator it = range.first; it != range.second; ++it) {
+    if (it->second == e) {
+      table.erase(it);
+      return;
+    }
+  }
+}
 
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
@@ -84,7 +188,11 @@ ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
 }
 
 int Expr::compare(const Expr &b) const {
+#ifdef KLEE_ATOMIC_REFCOUNT
+  static thread_local ExprEquivSet equivs;
+#else
   static ExprEquivSet equivs;
+#endif
   int r = compare(b, equivs);
   equivs.clear();
   return r;
@@ -183,6 +291,30 @@ unsigned Expr::computeHash() {
   return hashValue;
 }
 
+ref<ConstantExpr> ConstantExpr::getSmall(int index, int widthIndex) {
+  static const Width widths[] = { Bool, Int8, Int16, Int32, Int64 };
+  static const unsigned numWidths = sizeof(widths) / sizeof(widths[0]);
+  static const unsigned perWidth = numSmallConstants + numSmallNegatives;
+  /* never freed, like the intern table; filled at once, so that threads
+     only read it */
+  static ref<ConstantExpr> *table = [] {
+    ref<ConstantExpr> *t = new ref<ConstantExpr>[numWidths * perWidth];
+    for (unsigned w = 0; w < numWidths; w++)
+      for (unsigned i = 0; i < perWidth; i++) {
+        uint64_t v =
+            i < numSmallConstants ? i : -(uint64_t) (i - numSmallConstants + 1);
+        if (getSmallIndex(v, widths[w]) != (int) i)
+          continue;
+        ref<ConstantExpr> r(new ConstantExpr(llvm::APInt(widths[w], v)));
+        r->computeHash();
+        t[w * perWidth + i] = intern(r);
+      }
+    return t;
+  }();
+
+  return table[widthIndex * perWidth + index];
+}
+
 unsigned ConstantExpr::computeHash() {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
   hashValue = hash_value(value) ^ (getWidth() * MAGIC_HASH_CONSTANT);
@@ -324,6 +456,192 @@ void Expr::dump() const {
 
 /***/
 
+static uint64_t getMask(Expr::Width w) {
+  return w >= 64 ? ~0ULL : (1ULL << w) - 1;
+}
+
+/// The number of low bits set in v.
+static unsigned countTrailingOnes(uint64_t v) {
+  unsigned n = 0;
+  for (; n < 64 && (v >> n & 1); n++)
+    ;
+  return n;
+}
+
+/// The number of high bits of a width set in v.
+static unsigned countLeadingOnes(uint64_t v, Expr::Width w) {
+  unsigned n = 0;
+  for (; n < w && (v >> (w - 1 - n) & 1); n++)
+    ;
+  return n;
+}
+
+/// The known bits of e, an expression of at most 64 bits.
+static void computeKnownBits(const Expr &e, uint64_t &zero, uint64_t &one) {
+  Expr::Width w = e.getWidth();
+  uint64_t mask = getMask(w);
+  uint64_t z[3] = { 0, 0, 0 }, o[3] = { 0, 0, 0 };
+  unsigned n = std::min(e.getNumKids(), 3u);
+  if (e.getKind() != Expr::NotOptimized && e.getKind() != Expr::Read)
+    for (unsigned i = 0; i < n; i++)
+      e.getKid(i)->getKnownBits(z[i], o[i]);
+  zero = one = 0;
+
+  switch (e.getKind()) {
+  case Expr::Constant:
+    one = cast<ConstantExpr>(&e)->getZExtValue();
+    zero = ~one & mask;
+    break;
+
+  case Expr::Select:
+    if (o[0] & 1) {
+      zero = z[1], one = o[1];
+    } else if (z[0] & 1) {
+      zero = z[2], one = o[2];
+    } else {
+      zero = z[1] & z[2], one = o[1] & o[2];
+    }
+    break;
+
+  case Expr::Concat: {
+    Expr::Width rw = e.getKid(1)->getWidth();
+    zero = z[0] << rw | z[1];
+    one = o[0] << rw | o[1];
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr &ee = cast<ExtractExpr>(e);
+    if (ee.expr->getWidth() <= 64) {
+      zero = z[0] >> ee.offset & mask;
+      one = o[0] >> ee.offset & mask;
+    }
+    break;
+  }
+
+  case Expr::ZExt:
+    zero = z[0] | (mask & ~getMask(e.getKid(0)->getWidth()));
+    one = o[0];
+    break;
+
+  case Expr::SExt: {
+    Expr::Width kw = e.getKid(0)->getWidth();
+    uint64_t sign = 1ULL << (kw - 1), high = mask & ~getMask(kw);
+    zero = z[0] | (z[0] & sign ? high : 0);
+    one = o[0] | (o[0] & sign ? high : 0);
+    break;
+  }
+
+  case Expr::Not:
+    zero = o[0], one = z[0];
+    break;
+
+  case Expr::And:
+    zero = z[0] | z[1], one = o[0] & o[1];
+    break;
+
+  case Expr::Or:
+    zero = z[0] & z[1], one = o[0] | o[1];
+    break;
+
+  case Expr::Xor:
+    zero = (z[0] & z[1]) | (o[0] & o[1]);
+    one = (z[0] & o[1]) | (o[0] & z[1]);
+    break;
+
+  case Expr::Shl:
+  case Expr::LShr:
+  case Expr::AShr: {
+    const ConstantExpr *amount = dyn_cast<ConstantExpr>(e.getKid(1));
+    if (!amount || amount->getZExtValue() >= w)
+      break;
+    unsigned c = amount->getZExtValue();
+    uint64_t high = mask & ~(mask >> c), sign = 1ULL << (w - 1);
+    if (e.getKind() == Expr::Shl) {
+      zero = (z[0] << c | ((1ULL << c) - 1)) & mask;
+      one = o[0] << c & mask;
+    } else if (e.getKind() == Expr::LShr) {
+      zero = z[0] >> c | high;
+      one = o[0] >> c;
+    } else {
+      zero = z[0] >> c | (z[0] & sign ? high : 0);
+      one = o[0] >> c | (o[0] & sign ? high : 0);
+    }
+    break;
+  }
+
+  // the low bits clear in both operands stay clear
+  case Expr::Add:
+  case Expr::Sub: {
+    unsigned low = std::min(countTrailingOnes(z[0]), countTrailingOnes(z[1]));
+    zero = getMask(std::min(low, w));
+    break;
+  }
+
+  case Expr::Mul: {
+    unsigned low = countTrailingOnes(z[0]) + countTrailingOnes(z[1]);
+    zero = getMask(std::min(low, w));
+    break;
+  }
+
+  // neither is above the dividend, but a quotient by 0 is all ones
+  case Expr::UDiv:
+  case Expr::URem:
+    if (e.getKind() == Expr::URem || o[1])
+      zero = mask & ~getMask(w - countLeadingOnes(z[0], w));
+    break;
+
+  case Expr::Eq:
+    if ((z[0] & o[1]) | (o[0] & z[1]))
+      zero = 1;
+    break;
+
+  // from the least and the greatest values of the operands
+  case Expr::Ult:
+  case Expr::Ule: {
+    Expr::Width kw = e.getKid(0)->getWidth();
+    uint64_t leastL = o[0], greatestL = ~z[0] & getMask(kw);
+    uint64_t leastR = o[1], greatestR = ~z[1] & getMask(kw);
+    if (e.getKind() == Expr::Ult) {
+      one = greatestL < leastR;
+      zero = leastL >= greatestR;
+    } else {
+      one = greatestL <= leastR;
+      zero = leastL > greatestR;
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+
+  zero &= mask;
+  one &= mask;
+}
+
+void Expr::getKnownBits(uint64_t &zero, uint64_t &one) const {
+  if (getWidth() > 64) {
+    zero = one = 0;
+    return;
+  }
+  // constants are shared by threads, they are never written
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(this)) {
+    one = ce->getZExtValue();
+    zero = ~one & getMask(getWidth());
+    return;
+  }
+  if (knownZero & knownOne) {
+    computeKnownBits(*this, zero, one);
+    knownOne = one;
+    knownZero = zero;
+  }
+  zero = knownZero;
+  one = knownOne;
+}
+
+/***/
+
 ref<Expr> ConstantExpr::fromMemory(void *address, Width width) {
   switch (width) {
   case  Expr::Bool: return ConstantExpr::create(*(( uint8_t*) address), width);
@@ -358,8 +676,22 @@ void ConstantExpr::toString(std::string &Res, unsigned radix) const {
   Res = value.toString(radix, false);
 }
 
+/* Constants of at most 64 bits, almost all of them, are folded on machine
+   words rather than through APInt arithmetic. */
+
+static inline ref<ConstantExpr> foldWord(uint64_t v, Expr::Width w) {
+  return ConstantExpr::alloc(bits64::truncateToNBits(v, w), w);
+}
+
+static inline int64_t signedWord(uint64_t v, Expr::Width w) {
+  return w == 64 ? (int64_t) v : (int64_t) (v << (64 - w)) >> (64 - w);
+}
+
 ref<ConstantExpr> ConstantExpr::Concat(const ref<ConstantExpr> &RHS) {
   Expr::Width W = getWidth() + RHS->getWidth();
+  if (W <= 64)
+    return foldWord(value.getZExtValue() << RHS->getWidth() |
+                    RHS->value.getZExtValue(), W);
   APInt Tmp(value);
   Tmp=Tmp.zext(W);
   Tmp <<= RHS->getWidth();
@@ -369,34 +701,56 @@ ref<ConstantExpr> ConstantExpr::Concat(const ref<ConstantExpr> &RHS) {
 }
 
 ref<ConstantExpr> ConstantExpr::Extract(unsigned Offset, Width W) {
+  if (getWidth() <= 64)
+    return foldWord(value.getZExtValue() >> Offset, W);
   return ConstantExpr::alloc(APInt(value.ashr(Offset)).zextOrTrunc(W));
 }
 
 ref<ConstantExpr> ConstantExpr::ZExt(Width W) {
+  if (getWidth() <= 64 && W <= 64)
+    return foldWord(value.getZExtValue(), W);
   return ConstantExpr::alloc(APInt(value).zextOrTrunc(W));
 }
 
 ref<ConstantExpr> ConstantExpr::SExt(Width W) {
+  if (getWidth() <= 64 && W <= 64)
+    return foldWord(signedWord(value.getZExtValue(), getWidth()), W);
   return ConstantExpr::alloc(APInt(value).sextOrTrunc(W));
 }
 
 ref<ConstantExpr> ConstantExpr::Add(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return foldWord(value.getZExtValue() + RHS->value.getZExtValue(),
+                    getWidth());
   return ConstantExpr::alloc(value + RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Neg() {
+  if (getWidth() <= 64)
+    return foldWord(-value.getZExtValue(), getWidth());
   return ConstantExpr::alloc(-value);
 }
 
 ref<ConstantExpr> ConstantExpr::Sub(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return foldWord(value.getZExtValue() - RHS->value.getZExtValue(),
+                    getWidth());
   return ConstantExpr::alloc(value - RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Mul(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return foldWord(value.getZExtValue() * RHS->value.getZExtValue(),
+                    getWidth());
   return ConstantExpr::alloc(value * RHS->value);
 }
 
+// a division by zero, or the overflowing signed ones, are left to APInt
+
 ref<ConstantExpr> ConstantExpr::UDiv(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64 && !RHS->isZero())
+    return foldWord(value.getZExtValue() / RHS->value.getZExtValue(),
+                    getWidth());
   return ConstantExpr::alloc(value.udiv(RHS->value));
 }
 
@@ -405,6 +759,9 @@ ref<ConstantExpr> ConstantExpr::SDiv(const ref<ConstantExpr> &RHS) {
 }
 
 ref<ConstantExpr> ConstantExpr::URem(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64 && !RHS->isZero())
+    return foldWord(value.getZExtValue() % RHS->value.getZExtValue(),
+                    getWidth());
   return ConstantExpr::alloc(value.urem(RHS->value));
 }
 
@@ -413,30 +770,59 @@ ref<ConstantExpr> ConstantExpr::SRem(const ref<ConstantExpr> &RHS) {
 }
 
 ref<ConstantExpr> ConstantExpr::And(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return foldWord(value.getZExtValue() & RHS->value.getZExtValue(),
+                    getWidth());
   return ConstantExpr::alloc(value & RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Or(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return foldWord(value.getZExtValue() | RHS->value.getZExtValue(),
+                    getWidth());
   return ConstantExpr::alloc(value | RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Xor(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return foldWord(value.getZExtValue() ^ RHS->value.getZExtValue(),
+                    getWidth());
   return ConstantExpr::alloc(value ^ RHS->value);
 }
 
+// shifting by the width or more gives 0, or the sign for AShr
+
 ref<ConstantExpr> ConstantExpr::Shl(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64) {
+    uint64_t shift = RHS->getLimitedValue(getWidth());
+    return foldWord(shift < getWidth() ? value.getZExtValue() << shift : 0,
+                    getWidth());
+  }
   return ConstantExpr::alloc(value.shl(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::LShr(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64) {
+    uint64_t shift = RHS->getLimitedValue(getWidth());
+    return foldWord(shift < getWidth() ? value.getZExtValue() >> shift : 0,
+                    getWidth());
+  }
   return ConstantExpr::alloc(value.lshr(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::AShr(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64) {
+    uint64_t shift = std::min(RHS->getLimitedValue(getWidth()),
+                              (uint64_t) getWidth() - 1);
+    return foldWord(signedWord(value.getZExtValue(), getWidth()) >> shift,
+                    getWidth());
+  }
   return ConstantExpr::alloc(value.ashr(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::Not() {
+  if (getWidth() <= 64)
+    return foldWord(~value.getZExtValue(), getWidth());
   return ConstantExpr::alloc(~value);
 }
 
@@ -449,34 +835,62 @@ ref<ConstantExpr> ConstantExpr::Ne(const ref<ConstantExpr> &RHS) {
 }
 
 ref<ConstantExpr> ConstantExpr::Ult(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(value.getZExtValue() <
+                                   RHS->value.getZExtValue(), Expr::Bool);
   return ConstantExpr::alloc(value.ult(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ule(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(value.getZExtValue() <=
+                                   RHS->value.getZExtValue(), Expr::Bool);
   return ConstantExpr::alloc(value.ule(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ugt(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(value.getZExtValue() >
+                                   RHS->value.getZExtValue(), Expr::Bool);
   return ConstantExpr::alloc(value.ugt(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Uge(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(value.getZExtValue() >=
+                                   RHS->value.getZExtValue(), Expr::Bool);
   return ConstantExpr::alloc(value.uge(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Slt(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(
+        signedWord(value.getZExtValue(), getWidth()) <
+            signedWord(RHS->value.getZExtValue(), getWidth()), Expr::Bool);
   return ConstantExpr::alloc(value.slt(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Sle(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(
+        signedWord(value.getZExtValue(), getWidth()) <=
+            signedWord(RHS->value.getZExtValue(), getWidth()), Expr::Bool);
   return ConstantExpr::alloc(value.sle(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Sgt(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(
+        signedWord(value.getZExtValue(), getWidth()) >
+            signedWord(RHS->value.getZExtValue(), getWidth()), Expr::Bool);
   return ConstantExpr::alloc(value.sgt(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Sge(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(
+        signedWord(value.getZExtValue(), getWidth()) >=
+            signedWord(RHS->value.getZExtValue(), getWidth()), Expr::Bool);
   return ConstantExpr::alloc(value.sge(RHS->value), Expr::Bool);
 }
 
@@ -530,7 +944,11 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
 
   const UpdateNode *un = ul.head;
   bool updateListHasSymbolicWrites = false;
+  ConstantExpr *constantIndex = dyn_cast<ConstantExpr>(index);
   for (; un; un=un->next) {
+    // Skip the writes at other constant indices.
+    if (constantIndex && !(un = un->findUpdate(constantIndex->getZExtValue())))
+      break;
     ref<Expr> cond = EqExpr::create(index, un->index);
     
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond)) {
@@ -1054,6 +1054,226 @@ namespace {
     SimplifyingExprBuilder;
 }
 
+static uint64_t getMask(Expr::Width w) {
+  return w >= 64 ? ~0ULL : (1ULL << w) - 1;
+}
+
+/// The bits which may be 1 in a value of e.
+static uint64_t getPossibleOnes(const ref<Expr> &e) {
+  uint64_t zero, one;
+  e->getKnownBits(zero, one);
+  return ~zero & getMask(e->getWidth());
+}
+
+/// Are the bits which may be 1 in a value of e all known to be 1 in mask?
+static bool isCoveredBy(const ref<Expr> &e, const ref<Expr> &mask) {
+  if (e->getWidth() > 64)
+    return false;
+  uint64_t zero, one;
+  mask->getKnownBits(zero, one);
+  return !(getPossibleOnes(e) & ~one);
+}
+
+/// Is no bit 1 in both a value of a and a value of b?
+static bool isDisjoint(const ref<Expr> &a, const ref<Expr> &b) {
+  return a->getWidth() <= 64 && !(getPossibleOnes(a) & getPossibleOnes(b));
+}
+
+ref<Expr> klee::simplifyKnownBits(ExprBuilder *Builder, const ref<Expr> &E) {
+  Expr::Width Width = E->getWidth();
+  if (isa<ConstantExpr>(E))
+    return ref<Expr>();
+  if (Width <= 64) {
+    uint64_t zero, one;
+    E->getKnownBits(zero, one);
+    if ((zero | one) == getMask(Width))
+      return Builder->Constant(one, Width);
+  }
+
+  switch (E->getKind()) {
+  case Expr::And: {
+    const AndExpr *AE = cast<AndExpr>(E);
+    // A mask of bits known to be clear already
+    if (isCoveredBy(AE->left, AE->right))
+      return AE->left;
+    if (isCoveredBy(AE->right, AE->left))
+      return AE->right;
+    // A mask which keeps no bit of one side of an Or
+    for (unsigned i = 0; i < 2; i++) {
+      const ref<Expr> &Mask = E->getKid(1 - i);
+      if (const OrExpr *OE = dyn_cast<OrExpr>(E->getKid(i))) {
+        if (isDisjoint(OE->left, Mask))
+          return Builder->And(OE->right, Mask);
+        if (isDisjoint(OE->right, Mask))
+          return Builder->And(OE->left, Mask);
+      }
+    }
+    break;
+  }
+
+  case Expr::Or: {
+    // An operand whose bits are known to be set already
+    const OrExpr *OE = cast<OrExpr>(E);
+    if (isCoveredBy(OE->right, OE->left))
+      return OE->left;
+    if (isCoveredBy(OE->left, OE->right))
+      return OE->right;
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *EE = cast<ExtractExpr>(E);
+    const ref<Expr> &Kid = EE->expr;
+    unsigned Offset = EE->offset;
+    if (Width == Kid->getWidth())
+      return Kid;
+
+    if (const ConcatExpr *CE = dyn_cast<ConcatExpr>(Kid)) {
+      // The bits of one side only
+      Expr::Width RightWidth = CE->getRight()->getWidth();
+      if (Offset + Width <= RightWidth)
+        return Builder->Extract(CE->getRight(), Offset, Width);
+      if (Offset >= RightWidth)
+        return Builder->Extract(CE->getLeft(), Offset - RightWidth, Width);
+    } else if (const ZExtExpr *ZE = dyn_cast<ZExtExpr>(Kid)) {
+      if (Offset + Width <= ZE->src->getWidth())
+        return Builder->Extract(ZE->src, Offset, Width);
+    } else if (const ExtractExpr *Inner = dyn_cast<ExtractExpr>(Kid)) {
+      return Builder->Extract(Inner->expr, Inner->offset + Offset, Width);
+    } else if (const OrExpr *OE = dyn_cast<OrExpr>(Kid)) {
+      // The bits of the byte fields of a word but one
+      if (Kid->getWidth() <= 64) {
+        uint64_t Bits = getMask(Width) << Offset;
+        if (!(getPossibleOnes(OE->left) & Bits))
+          return Builder->Extract(OE->right, Offset, Width);
+        if (!(getPossibleOnes(OE->right) & Bits))
+          return Builder->Extract(OE->left, Offset, Width);
+      }
+    } else if (isa<ShlExpr>(Kid) || isa<LShrExpr>(Kid)) {
+      const BinaryExpr *BE = cast<BinaryExpr>(Kid);
+      const ConstantExpr *Amount = dyn_cast<ConstantExpr>(BE->right);
+      Expr::Width KidWidth = Kid->getWidth();
+      if (!Amount || KidWidth > 64 || Amount->getZExtValue() >= KidWidth)
+        break;
+      unsigned Shift = Amount->getZExtValue();
+      if (isa<ShlExpr>(Kid) && Offset >= Shift)
+        return Builder->Extract(BE->left, Offset - Shift, Width);
+      if (isa<LShrExpr>(Kid) && Offset + Shift + Width <= KidWidth)
+        return Builder->Extract(BE->left, Offset + Shift, Width);
+    }
+    break;
+  }
+
+  case Expr::ZExt:
+    if (const ZExtExpr *ZE = dyn_cast<ZExtExpr>(E->getKid(0)))
+      return Builder->ZExt(ZE->src, Width);
+    break;
+
+  default:
+    break;
+  }
+
+  return ref<Expr>();
+}
+
+namespace {
+  class KnownBitsBuilder : public ChainedBuilder {
+    /// e, or its rewrite by the known bits of its kids
+    ref<Expr> simplify(const ref<Expr> &e) {
+      ref<Expr> result = simplifyKnownBits(Builder, e);
+      return result.isNull() ? e : result;
+    }
+
+  public:
+    KnownBitsBuilder(ExprBuilder *Builder, ExprBuilder *Base)
+      : ChainedBuilder(Builder, Base) {}
+
+    ref<Expr> Select(const ref<Expr> &Cond,
+                     const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Select(Cond, LHS, RHS));
+    }
+
+    ref<Expr> Concat(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Concat(LHS, RHS));
+    }
+
+    ref<Expr> Extract(const ref<Expr> &LHS, unsigned Offset, Expr::Width W) {
+      return simplify(Base->Extract(LHS, Offset, W));
+    }
+
+    ref<Expr> ZExt(const ref<Expr> &LHS, Expr::Width W) {
+      return simplify(Base->ZExt(LHS, W));
+    }
+
+    ref<Expr> SExt(const ref<Expr> &LHS, Expr::Width W) {
+      return simplify(Base->SExt(LHS, W));
+    }
+
+    ref<Expr> Add(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Add(LHS, RHS));
+    }
+
+    ref<Expr> Sub(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Sub(LHS, RHS));
+    }
+
+    ref<Expr> Mul(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Mul(LHS, RHS));
+    }
+
+    ref<Expr> UDiv(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->UDiv(LHS, RHS));
+    }
+
+    ref<Expr> URem(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->URem(LHS, RHS));
+    }
+
+    ref<Expr> Not(const ref<Expr> &LHS) {
+      return simplify(Base->Not(LHS));
+    }
+
+    ref<Expr> And(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->And(LHS, RHS));
+    }
+
+    ref<Expr> Or(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Or(LHS, RHS));
+    }
+
+    ref<Expr> Xor(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Xor(LHS, RHS));
+    }
+
+    ref<Expr> Shl(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Shl(LHS, RHS));
+    }
+
+    ref<Expr> LShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->LShr(LHS, RHS));
+    }
+
+    ref<Expr> AShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->AShr(LHS, RHS));
+    }
+
+    ref<Expr> Eq(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Eq(LHS, RHS));
+    }
+
+    ref<Expr> Ult(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Ult(LHS, RHS));
+    }
+
+    ref<Expr> Ule(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return simplify(Base->Ule(LHS, RHS));
+    }
+  };
+
+  typedef ConstantSpecializedExprBuilder<KnownBitsBuilder>
+    KnownBitsExprBuilder;
+}
+
 ExprBuilder *klee::createDefaultExprBuilder() {
   return new DefaultExprBuilder();
 }
@@ -1065,3 +1285,7 @@ ExprBuilder *klee::createConstantFoldingExprBuilder(ExprBuilder *Base) {
 ExprBuilder *klee::createSimplifyingExprBuilder(ExprBuilder *Base) {
   return new SimplifyingExprBuilder(Base);
 }
+
+ExprBuilder *klee::createKnownBitsExprBuilder(ExprBuilder *Base) {
+  return new KnownBitsExprBuilder(Base);
+}
@@ -14,6 +14,8 @@ using namespace klee;
 ExprVisitor::Action ExprEvaluator::evalRead(const UpdateList &ul,
                                             unsigned index) {
   for (const UpdateNode *un=ul.head; un; un=un->next) {
+    if (!(un = un->findUpdate(index)))
+      break;
     ref<Expr> ui = visit(un->index);
     
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(ui)) {
@@ -11,7 +11,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "klee/util/ExprSMTLIBPrinter.h"
 
-#include <stack>
+#include <algorithm>
 
 namespace ExprSMTLIBOptions {
 // Command line options
@@ -83,6 +83,9 @@ void ExprSMTLIBPrinter::reset() {
   bindings.clear();
   orderedBindings.clear();
   seenExprs.clear();
+  seenUpdates.clear();
+  updateBindings.clear();
+  orderedUpdateBindings.clear();
   usedArrays.clear();
   haveConstantArray = false;
 
@@ -475,30 +478,51 @@ const char *ExprSMTLIBPrinter::getSMTLIBKeyword(const ref<Expr> &e) {
 
 void ExprSMTLIBPrinter::printUpdatesAndArray(const UpdateNode *un,
                                              const Array *root) {
-  if (un != NULL) {
-    *p << "(store ";
-    p->pushIndent();
-    printSeperator();
+  if (un == NULL) {
+    // The base case of the recursion
+    *p << root->name;
+    return;
+  }
 
-    // recurse to get the array or update that this store operations applies to
-    printUpdatesAndArray(un->next, root);
+  if (abbrMode != ABBR_NONE) {
+    UpdateBindingMap::iterator i = updateBindings.find(un);
+    if (i != updateBindings.end()) {
+      int &id = i->second.second;
+      if (abbrMode == ABBR_LET || id < 0) {
+        *p << "?B" << (id < 0 ? -id : id);
+      } else {
+        *p << "(! ";
+        printStore(un, root);
+        *p << " :named ?B" << id << ")";
+        id = -id;
+      }
+      return;
+    }
+  }
 
-    printSeperator();
+  printStore(un, root);
+}
 
-    // print index
-    printExpression(un->index, SORT_BITVECTOR);
-    printSeperator();
+void ExprSMTLIBPrinter::printStore(const UpdateNode *un, const Array *root) {
+  *p << "(store ";
+  p->pushIndent();
+  printSeperator();
 
-    // print value that is assigned to this index of the array
-    printExpression(un->value, SORT_BITVECTOR);
+  // recurse to get the array or update that this store operations applies to
+  printUpdatesAndArray(un->next, root);
 
-    p->popIndent();
-    printSeperator();
-    *p << ")";
-  } else {
-    // The base case of the recursion
-    *p << root->name;
-  }
+  printSeperator();
+
+  // print index
+  printExpression(un->index, SORT_BITVECTOR);
+  printSeperator();
+
+  // print value that is assigned to this index of the array
+  printExpression(un->value, SORT_BITVECTOR);
+
+  p->popIndent();
+  printSeperator();
+  *p << ")";
 }
 
 void ExprSMTLIBPrinter::scanAll() {
@@ -657,8 +681,8 @@ void ExprSMTLIBPrinter::printQueryInSingleAssert() {
   ref<Expr> queryAssert = Expr::createIsZero(query->expr);
 
   // Print constraints inside the main query to reuse the Expr bindings
-  for (std::vector<ref<Expr> >::const_iterator i = query->constraints.begin(),
-                                               e = query->constraints.end();
+  for (ConstraintManager::const_iterator i = query->constraints.begin(),
+                                         e = query->constraints.end();
        i != e; ++i) {
     queryAssert = AndExpr::create(queryAssert, *i);
   }
@@ -709,10 +733,10 @@ void ExprSMTLIBPrinter::scan(const ref<Expr> &e) {
         // check if the array is constant
         if (re->updates.root->isConstantArray())
           haveConstantArray = true;
-
-        // scan the update list
-        scanUpdates(re->updates.head);
       }
+
+      // scan the update list, reads of one array can have different ones
+      scanUpdates(re->updates.head, re->updates.root);
     }
 
     // recurse into the children
@@ -722,107 +746,121 @@ void ExprSMTLIBPrinter::scan(const ref<Expr> &e) {
   } else {
     // Add the expression to the binding map. The semantics of std::map::insert
     // are such that it will not be inserted twice.
-    bindings.insert(std::make_pair(e, bindings.size()+1));
+    if (!bindings.count(e))
+      bindings.insert(
+          std::make_pair(e, bindings.size() + updateBindings.size() + 1));
   }
 }
 
 void ExprSMTLIBPrinter::scanBindingExprDeps() {
-  if (!bindings.size())
+  if (!bindings.size() && !updateBindings.size())
     return;
 
-  // Mutual dependency storage
-  typedef std::map<const ref<Expr>, std::set<ref<Expr> > > ExprDepMap;
-
-  // A map from binding Expr (need abbreviating) "e" to the set of binding Expr
-  // that are sub expressions of "e" (i.e. "e" uses these sub expressions).
-  // usesSubExprMap[a].count(b) == 1  means that binding Expr "a" uses
-  // sub Expr "b" (also a binding Expr).
-  // One can think of this map representing the "depends on" edges
-  // in a "dependency graph" where nodes are binding Expr roots
-  ExprDepMap usesSubExprMap;
-
-  // A map from Binding Expr "e" to the set of binding Expr that use "e"
-  // subExprOfMap[a].count(b) == 1 means that binding Expr "a" is a sub Expr
-  // of binding Expr "b".
-  // One can think of this map as representing the edges in the previously
-  // mentioned "dependency graph" except the direction of the edges
-  // have been reversed
-  ExprDepMap subExprOfMap;
-
-  // Working queue holding expressions with no dependencies
-  std::vector<ref<Expr> > nonDepBindings;
-
-  // Iterate over bindings and collect dependencies
-  for (BindingMap::const_iterator it = bindings.begin();
-       it != bindings.end(); ++it) {
-    std::stack<ref<Expr> > childQueue;
-    childQueue.push(it->first);
-    // Non-recursive expression parsing
-    while (childQueue.size()) {
-      Expr *ep = childQueue.top().get();
-      childQueue.pop();
-      for (unsigned i = 0; i < ep->getNumKids(); ++i) {
-        ref<Expr> e = ep->getKid(i);
-        if (isa<ConstantExpr>(e))
-          continue;
-        // Are there any dependencies in the bindings?
-        if (bindings.count(e)) {
-          usesSubExprMap[it->first].insert(e);
-          subExprOfMap[e].insert(it->first);
-        } else {
-          childQueue.push(e);
-        }
-      }
-    }
-    // Store expressions with zero deps
-    if (!usesSubExprMap.count(it->first))
-      nonDepBindings.push_back(it->first);
+  // A binding is defined by the let one level inside the lets of all the
+  // bindings it uses, so its level is one more than the highest level of
+  // those. The levels are memoized per node, which keeps this linear in the
+  // size of the query DAG.
+  std::vector<std::vector<ref<Expr> > > levelExprs;
+  for (BindingMap::const_iterator it = bindings.begin(); it != bindings.end();
+       ++it) {
+    unsigned level = getBindingLevel(it->first);
+    if (levelExprs.size() < level)
+      levelExprs.resize(level);
+    levelExprs[level - 1].push_back(it->first);
+  }
+
+  // Order the update list bindings by the binding number scan() gave them,
+  // as their addresses are not deterministic
+  std::vector<std::pair<int, const UpdateNode *> > updatesFound;
+  for (UpdateBindingMap::const_iterator it = updateBindings.begin();
+       it != updateBindings.end(); ++it)
+    updatesFound.push_back(std::make_pair(it->second.second, it->first));
+  std::sort(updatesFound.begin(), updatesFound.end());
+
+  std::vector<std::vector<const UpdateNode *> > levelUpdates;
+  for (unsigned i = 0; i < updatesFound.size(); ++i) {
+    unsigned level = getBindingLevel(updatesFound[i].second);
+    if (levelUpdates.size() < level)
+      levelUpdates.resize(level);
+    levelUpdates[level - 1].push_back(updatesFound[i].second);
   }
-  assert(nonDepBindings.size() && "there must be expr bindings with no deps");
 
-  // Unroll the dependency tree starting with zero-dep expressions
-  // and redefine bindings
+  exprLevels.clear();
+  updateLevels.clear();
+
+  // Renumber the bindings level by level
+  unsigned numLevels = std::max(levelExprs.size(), levelUpdates.size());
+  levelExprs.resize(numLevels);
+  levelUpdates.resize(numLevels);
+  orderedBindings.resize(numLevels);
   unsigned counter = 1;
-  // nonDepBindings always holds expressions with no dependencies
-  while (nonDepBindings.size()) {
-    BindingMap levelExprs;
-    std::vector<ref<Expr> > tmp(nonDepBindings);
-    nonDepBindings.clear();
-    for (std::vector<ref<Expr> >::const_iterator nonDepExprIt = tmp.begin();
-         nonDepExprIt != tmp.end(); ++nonDepExprIt) {
-      // Save to the level expression bindings
-      levelExprs.insert(std::make_pair(*nonDepExprIt, counter++));
-      // Who is dependent on me?
-      ExprDepMap::iterator depsIt = subExprOfMap.find(*nonDepExprIt);
-      if (depsIt != subExprOfMap.end()) {
-        for (std::set<ref<Expr> >::iterator exprIt = depsIt->second.begin();
-             exprIt != depsIt->second.end(); ) {
-          // Erase dependency
-          ExprDepMap::iterator subExprIt = usesSubExprMap.find(*exprIt);
-          assert(subExprIt != usesSubExprMap.end());
-          assert(subExprIt->second.count(*nonDepExprIt));
-          subExprIt->second.erase(*nonDepExprIt);
-          // If the expression *exprIt does not have any
-          // dependencies anymore, add it to the queue
-          if (!subExprIt->second.size()) {
-            nonDepBindings.push_back(*exprIt);
-            depsIt->second.erase(exprIt++);
-          } else {
-            ++exprIt;
-          }
-        }
-      }
-    }
-    // Store level bindings
-    orderedBindings.push_back(levelExprs);
+  for (unsigned i = 0; i < numLevels; ++i) {
+    for (std::vector<ref<Expr> >::const_iterator it = levelExprs[i].begin();
+         it != levelExprs[i].end(); ++it)
+      orderedBindings[i].insert(std::make_pair(*it, 0));
+    for (BindingMap::iterator it = orderedBindings[i].begin();
+         it != orderedBindings[i].end(); ++it)
+      it->second = counter++;
+    for (std::vector<const UpdateNode *>::const_iterator it =
+             levelUpdates[i].begin();
+         it != levelUpdates[i].end(); ++it)
+      updateBindings[*it].second = counter++;
   }
+  orderedUpdateBindings.swap(levelUpdates);
 }
 
-void ExprSMTLIBPrinter::scanUpdates(const UpdateNode *un) {
-  while (un != NULL) {
+unsigned ExprSMTLIBPrinter::getBindingLevel(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return 0;
+
+  std::map<const Expr *, unsigned>::iterator it = exprLevels.find(e.get());
+  if (it != exprLevels.end())
+    return it->second;
+
+  unsigned level = 0;
+  Expr *ep = e.get();
+  for (unsigned i = 0; i < ep->getNumKids(); ++i)
+    level = std::max(level, getBindingLevel(ep->getKid(i)));
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e))
+    level = std::max(level, getBindingLevel(re->updates.head));
+  if (bindings.count(e))
+    ++level;
+
+  exprLevels.insert(std::make_pair(ep, level));
+  return level;
+}
+
+unsigned ExprSMTLIBPrinter::getBindingLevel(const UpdateNode *un) {
+  if (un == NULL)
+    return 0;
+
+  std::map<const UpdateNode *, unsigned>::iterator it = updateLevels.find(un);
+  if (it != updateLevels.end())
+    return it->second;
+
+  unsigned level = std::max(getBindingLevel(un->index),
+                            getBindingLevel(un->value));
+  level = std::max(level, getBindingLevel(un->next));
+  if (updateBindings.count(un))
+    ++level;
+
+  updateLevels.insert(std::make_pair(un, level));
+  return level;
+}
+
+void ExprSMTLIBPrinter::scanUpdates(const UpdateNode *un, const Array *root) {
+  for (; un != NULL; un = un->next) {
+    if (!seenUpdates.insert(un).second) {
+      // The rest of the list is shared with an update list scanned before,
+      // so abbreviate it rather than printing it for each use.
+      if (!updateBindings.count(un))
+        updateBindings.insert(std::make_pair(
+            un, std::make_pair(root, bindings.size() + updateBindings.size() +
+                                         1)));
+      return;
+    }
     scan(un->index);
     scan(un->value);
-    un = un->next;
   }
 }
 
@@ -876,10 +914,12 @@ void ExprSMTLIBPrinter::printAssert(const ref<Expr> &e) {
     // Clear original bindings, we'll be using orderedBindings
     // to print nested let expressions
     bindings.clear();
+    UpdateBindingMap allUpdateBindings;
+    allUpdateBindings.swap(updateBindings);
 
     // Print each binding on its level
     for (unsigned i = 0; i < orderedBindings.size(); ++i) {
-      BindingMap levelBindings = orderedBindings[i];
+      const BindingMap &levelBindings = orderedBindings[i];
       for (BindingMap::const_iterator j = levelBindings.begin();
            j != levelBindings.end(); ++j) {
         printSeperator();
@@ -894,6 +934,23 @@ void ExprSMTLIBPrinter::printAssert(const ref<Expr> &e) {
         printSeperator();
         *p << ")";
       }
+      const std::vector<const UpdateNode *> &levelUpdates =
+          orderedUpdateBindings[i];
+      for (std::vector<const UpdateNode *>::const_iterator j =
+               levelUpdates.begin();
+           j != levelUpdates.end(); ++j) {
+        const std::pair<const Array *, int> &binding = allUpdateBindings[*j];
+        printSeperator();
+        *p << "(?B" << binding.second;
+        p->pushIndent();
+        printSeperator();
+
+        printStore(*j, binding.first);
+
+        p->popIndent();
+        printSeperator();
+        *p << ")";
+      }
       p->popIndent();
       printSeperator();
       *p << ")";
@@ -910,6 +967,10 @@ void ExprSMTLIBPrinter::printAssert(const ref<Expr> &e) {
       // Insert current level bindings so that they can be used
       // in the next level during expression printing
       bindings.insert(levelBindings.begin(), levelBindings.end());
+      for (std::vector<const UpdateNode *>::const_iterator j =
+               levelUpdates.begin();
+           j != levelUpdates.end(); ++j)
+        updateBindings.insert(*allUpdateBindings.find(*j));
     }
 
     printExpression(e, SORT_BOOL);
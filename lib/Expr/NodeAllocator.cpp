@@ -0,0 +1,92 @@
+//===-- NodeAllocator.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/NodeAllocator.h"
+#include "klee/Config/config.h"
+#include "klee/Internal/System/MemoryUsage.h"
+
+#include <new>
+#ifdef KLEE_ATOMIC_REFCOUNT
+#include <mutex>
+#endif
+
+using namespace klee;
+
+static const size_t granularity = 16;
+static const size_t numClasses = 16;
+static const size_t slabSize = 64 * 1024;
+
+/* plain statics, so nodes can be allocated during static initialization */
+struct FreeNode {
+  FreeNode *next;
+};
+static FreeNode *freeLists[numClasses];
+static char *slabCursors[numClasses];
+static char *slabEnds[numClasses];
+static size_t liveBytes;
+static size_t slabBytes;
+#ifdef KLEE_ATOMIC_REFCOUNT
+/* constant initialized, like the plain statics */
+static std::mutex allocatorLock;
+#endif
+
+void *NodeAllocator::allocate(size_t size) {
+  size_t c = (size + granularity - 1) / granularity - 1;
+  if (size == 0 || c >= numClasses) {
+    util::AccountMemory(util::ExprMemory, size);
+    return ::operator new(size);
+  }
+
+#ifdef KLEE_ATOMIC_REFCOUNT
+  std::lock_guard<std::mutex> guard(allocatorLock);
+#endif
+  liveBytes += (c + 1) * granularity;
+  util::AccountMemory(util::ExprMemory, (c + 1) * granularity);
+  if (FreeNode *node = freeLists[c]) {
+    freeLists[c] = node->next;
+    return node;
+  }
+
+  if (slabCursors[c] == slabEnds[c]) {
+    size_t nodeSize = (c + 1) * granularity;
+    size_t nodes = slabSize / nodeSize;
+    slabCursors[c] = static_cast<char *>(::operator new(nodes * nodeSize));
+    slabEnds[c] = slabCursors[c] + nodes * nodeSize;
+    slabBytes += nodes * nodeSize;
+  }
+  void *p = slabCursors[c];
+  slabCursors[c] += (c + 1) * granularity;
+  return p;
+}
+
+void NodeAllocator::deallocate(void *p, size_t size) {
+  size_t c = (size + granularity - 1) / granularity - 1;
+  if (size == 0 || c >= numClasses) {
+    util::AccountMemory(util::ExprMemory, -(int64_t) size);
+    ::operator delete(p);
+    return;
+  }
+
+#ifdef KLEE_ATOMIC_REFCOUNT
+  std::lock_guard<std::mutex> guard(allocatorLock);
+#endif
+  liveBytes -= (c + 1) * granularity;
+  util::AccountMemory(util::ExprMemory, -(int64_t) ((c + 1) * granularity));
+  FreeNode *node = static_cast<FreeNode *>(p);
+  node->next = freeLists[c];
+  freeLists[c] = node;
+}
+
+size_t NodeAllocator::getLiveBytes() {
+  return liveBytes;
+}
+
+size_t NodeAllocator::getSlabBytes() {
+  return slabBytes;
+}
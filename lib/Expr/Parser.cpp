@@ -17,8 +17,11 @@
 #include "klee/Solver.h"
 #include "klee/util/ExprPPrinter.h"
 #include "klee/util/ArrayCache.h"
+#include "klee/util/BinaryQueryLog.h"
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -103,22 +106,28 @@ namespace {
 
   /// ParserImpl - Parser implementation.
   class ParserImpl : public Parser {
-    typedef std::map<const std::string, const Identifier*> IdentifierTabTy;
+    typedef llvm::StringMap<const Identifier*> IdentifierTabTy;
     typedef std::map<const Identifier*, ExprHandle> ExprSymTabTy;
     typedef std::map<const Identifier*, VersionHandle> VersionSymTabTy;
 
     const std::string Filename;
     const MemoryBuffer *TheMemoryBuffer;
     ExprBuilder *Builder;
-    ArrayCache TheArrayCache;
+    ArrayCache OwnArrayCache;
+    /// TheArrayCache - The cache arrays are created in; either OwnArrayCache
+    /// or a cache supplied by the client.
+    ArrayCache &TheArrayCache;
     bool ClearArrayAfterQuery;
 
     Lexer TheLexer;
     unsigned MaxErrors;
     unsigned NumErrors;
 
-    // FIXME: Use LLVM symbol tables?
+    /// IdentifierTab - The identifiers by name, which live in
+    /// IdentifierAlloc until the parser is destroyed. The labels of a
+    /// query reuse those of the previous ones, so a long log adds few.
     IdentifierTabTy IdentifierTab;
+    llvm::SpecificBumpPtrAllocator<Identifier> IdentifierAlloc;
 
     std::map<const Identifier*, const ArrayDecl*> ArraySymTab;
     ExprSymTabTy ExprSymTab;
@@ -324,8 +333,10 @@ namespace {
 
   public:
     ParserImpl(const std::string _Filename, const MemoryBuffer *MB,
-               ExprBuilder *_Builder, bool _ClearArrayAfterQuery)
+               ExprBuilder *_Builder, bool _ClearArrayAfterQuery,
+               ArrayCache *_Arrays)
         : Filename(_Filename), TheMemoryBuffer(MB), Builder(_Builder),
+          TheArrayCache(_Arrays ? *_Arrays : OwnArrayCache),
           ClearArrayAfterQuery(_ClearArrayAfterQuery), TheLexer(MB),
           MaxErrors(~0u), NumErrors(0) {}
 
@@ -354,15 +365,12 @@ namespace {
 }
 
 const Identifier *ParserImpl::GetOrCreateIdentifier(const Token &Tok) {
-  // FIXME: Make not horribly inefficient please.
   assert(Tok.kind == Token::Identifier && "Expected only identifier tokens.");
-  std::string Name(Tok.start, Tok.length);
-  IdentifierTabTy::iterator it = IdentifierTab.find(Name);
-  if (it != IdentifierTab.end())
-    return it->second;
-
-  Identifier *I = new Identifier(Name);
-  IdentifierTab.insert(std::make_pair(Name, I));
+  // looked up in place in the input, the name is only copied once
+  StringRef Name(Tok.start, Tok.length);
+  const Identifier *&I = IdentifierTab[Name];
+  if (!I)
+    I = new (IdentifierAlloc.Allocate()) Identifier(Name.str());
 
   return I;
 }
@@ -681,6 +689,10 @@ DeclResult ParserImpl::ParseQueryCommand() {
   if (Tok.kind != Token::EndOfFile)
     ExpectRParen("unexpected argument to 'query'.");
 
+  // the labels are local to the query, its nodes are freed with it
+  ExprSymTab.clear();
+  VersionSymTab.clear();
+
   // If we assume that the queries are independent, we clear the array
   // table from the previous declarations
   if (ClearArrayAfterQuery)
@@ -1568,33 +1580,7 @@ void ParserImpl::Error(const char *Message, const Token &At) {
 }
 
 ParserImpl::~ParserImpl() {
-  // Free identifiers
-  //
-  // Note the Identifiers are not disjoint across the symbol
-  // tables so we need to keep track of what has freed to
-  // avoid doing a double free.
-  std::set<const Identifier*> freedNodes;
-  for (IdentifierTabTy::iterator pi = IdentifierTab.begin(),
-                                 pe = IdentifierTab.end();
-       pi != pe; ++pi) {
-    const Identifier* id = pi->second;
-    if (freedNodes.insert(id).second)
-      delete id;
-  }
-  for (ExprSymTabTy::iterator pi = ExprSymTab.begin(),
-                              pe = ExprSymTab.end();
-       pi != pe; ++pi) {
-    const Identifier* id = pi->first;
-    if (freedNodes.insert(id).second)
-      delete id;
-  }
-  for (VersionSymTabTy::iterator pi = VersionSymTab.begin(),
-                                 pe = VersionSymTab.end();
-       pi != pe; ++pi) {
-    const Identifier* id = pi->first;
-    if (freedNodes.insert(id).second)
-      delete id;
-  }
+  // the identifiers are freed with IdentifierAlloc
 }
 
 // AST API
@@ -1646,8 +1632,13 @@ Parser::~Parser() {
 }
 
 Parser *Parser::Create(const std::string Filename, const MemoryBuffer *MB,
-                       ExprBuilder *Builder, bool ClearArrayAfterQuery) {
-  ParserImpl *P = new ParserImpl(Filename, MB, Builder, ClearArrayAfterQuery);
+                       ExprBuilder *Builder, bool ClearArrayAfterQuery,
+                       ArrayCache *Arrays) {
+  if (isBinaryQueryLog(MB))
+    return createBinaryQueryLogParser(Filename, MB, Builder, Arrays);
+
+  ParserImpl *P =
+      new ParserImpl(Filename, MB, Builder, ClearArrayAfterQuery, Arrays);
   P->Initialize();
   return P;
 }
@@ -0,0 +1,148 @@
+//===-- QueryHash.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/QueryHash.h"
+
+#include "klee/Constraints.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+static void mix(QueryHasher::Hash &h, uint64_t value) {
+  h.first = (h.first ^ value) * 0x9E3779B97F4A7C15ULL;
+  h.first ^= h.first >> 29;
+  h.second = (h.second + value) * 0xC2B2AE3D27D4EB4FULL;
+  h.second ^= h.second >> 31;
+}
+
+static void mix(QueryHasher::Hash &h, const QueryHasher::Hash &value) {
+  mix(h, value.first);
+  mix(h, value.second);
+}
+
+static bool isCommutative(Expr::Kind kind) {
+  switch (kind) {
+  case Expr::Add:
+  case Expr::Mul:
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor:
+  case Expr::Eq:
+  case Expr::Ne:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// the contents of a constant array are part of its hash, a symbolic array
+/// is only known by its number
+QueryHasher::Hash QueryHasher::hashArray(const Array *array, bool numbered) {
+  Hash h(0x6172726179ULL, 0x41525241ULL);
+  mix(h, array->size);
+  mix(h, array->getDomain());
+  mix(h, array->getRange());
+  if (array->isConstantArray()) {
+    mix(h, 1);
+    for (unsigned i = 0; i < array->constantValues.size(); i++)
+      mix(h, array->constantValues[i]->getZExtValue());
+  } else if (numbered) {
+    mix(h, 2);
+    mix(h, arrayIds.insert(std::make_pair(array, arrayIds.size())).first->second);
+  }
+  return h;
+}
+
+QueryHasher::Hash QueryHasher::hashExpr(const ref<Expr> &e, bool numbered) {
+  std::map<const Expr *, Hash> &memo = numbered ? hashes : shapes;
+  std::map<const Expr *, Hash>::iterator it = memo.find(e.get());
+  if (it != memo.end())
+    return it->second;
+
+  Hash h(0x65787072ULL, 0x45585052ULL);
+  mix(h, e->getKind());
+  mix(h, e->getWidth());
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+    for (unsigned i = 0; i < value.getNumWords(); i++)
+      mix(h, value.getRawData()[i]);
+    break;
+  }
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    mix(h, hashArray(re->updates.root, numbered));
+    for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+      mix(h, hashExpr(un->index, numbered));
+      mix(h, hashExpr(un->value, numbered));
+    }
+    break;
+  }
+  case Expr::Extract:
+    mix(h, cast<ExtractExpr>(e)->offset);
+    break;
+  default:
+    break;
+  }
+
+  if (isCommutative(e->getKind()) && e->getNumKids() == 2) {
+    /* the arrays are numbered in the order of the operand shapes */
+    Hash left = hashExpr(e->getKid(0), false);
+    Hash right = hashExpr(e->getKid(1), false);
+    unsigned first = right < left ? 1 : 0;
+    if (numbered) {
+      left = hashExpr(e->getKid(first), true);
+      right = hashExpr(e->getKid(1 - first), true);
+    }
+    mix(h, std::min(left, right));
+    mix(h, std::max(left, right));
+  } else {
+    for (unsigned i = 0; i < e->getNumKids(); i++)
+      mix(h, hashExpr(e->getKid(i), numbered));
+  }
+
+  memo.insert(std::make_pair(e.get(), h));
+  return h;
+}
+
+QueryHasher::QueryHasher(const ConstraintManager &constraints)
+    : constraintsHash(0x636f6e73ULL, 0x434f4e53ULL) {
+  std::vector< std::pair<Hash, unsigned> > order;
+  for (unsigned i = 0; i < constraints.size(); i++)
+    order.push_back(std::make_pair(hashExpr(constraints[i], false), i));
+  std::sort(order.begin(), order.end());
+
+  std::vector<Hash> set;
+  for (unsigned i = 0; i < order.size(); i++)
+    set.push_back(hashExpr(constraints[order[i].second], true));
+  std::sort(set.begin(), set.end());
+  set.erase(std::unique(set.begin(), set.end()), set.end());
+
+  mix(constraintsHash, set.size());
+  for (unsigned i = 0; i < set.size(); i++)
+    mix(constraintsHash, set[i]);
+}
+
+QueryHasher::Hash QueryHasher::getHash(ref<Expr> expr) {
+  Hash h = constraintsHash;
+  hashed.push_back(expr);
+  mix(h, hashExpr(expr, true));
+  return h;
+}
+
+QueryHasher::Hash
+QueryHasher::getHash(ref<Expr> expr,
+                     const std::vector<const Array *> &objects) {
+  Hash h = getHash(expr);
+  mix(h, objects.size());
+  for (unsigned i = 0; i < objects.size(); i++)
+    mix(h, hashArray(objects[i], true));
+  return h;
+}
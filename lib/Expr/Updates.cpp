@@ -9,10 +9,38 @@
 
 #include "klee/Expr.h"
 
+#include <algorithm>
 #include <cassert>
+#include <iterator>
 
 using namespace klee;
 
+namespace klee {
+  /// UpdateSnapshot - The newest update of every constant index written by
+  /// a run of updates at constant indices, sorted by index, and the update
+  /// at a symbolic index which ends the run (null at the end of the list).
+  struct UpdateSnapshot {
+    typedef std::pair<uint64_t, const UpdateNode *> Entry;
+    std::vector<Entry> latest;
+    const UpdateNode *barrier;
+  };
+}
+
+/// the least distance between two snapshots of a run, as the snapshots are
+/// copied from each other they are also at least a quarter of their size
+/// apart so that the copying costs a constant amortized time per update
+static const unsigned SnapshotInterval = 32;
+
+static bool entryIndexLess(const UpdateSnapshot::Entry &a,
+                           const UpdateSnapshot::Entry &b) {
+  return a.first < b.first;
+}
+
+static bool entryIndexEqual(const UpdateSnapshot::Entry &a,
+                            const UpdateSnapshot::Entry &b) {
+  return a.first == b.first;
+}
+
 ///
 
 UpdateNode::UpdateNode(const UpdateNode *_next, 
@@ -34,6 +62,64 @@ UpdateNode::UpdateNode(const UpdateNode *_next,
     size = 1 + next->size;
   }
   else size = 1;
+  snapshot = 0;
+  buildSnapshot();
+}
+
+void UpdateNode::buildSnapshot() {
+  if (!isa<ConstantExpr>(index)) {
+    base = this;
+    return;
+  }
+  base = next ? next->base : 0;
+
+  unsigned distance = size - (base ? base->size : 0);
+  const UpdateSnapshot *previous = base ? base->snapshot : 0;
+  if (distance < std::max(SnapshotInterval,
+                          previous ? (unsigned) previous->latest.size() / 4
+                                   : 0))
+    return;
+
+  /* the updates since the base, newest first, then the older ones */
+  std::vector<UpdateSnapshot::Entry> recent;
+  for (const UpdateNode *un = this; un != base; un = un->next)
+    recent.push_back(std::make_pair(
+        cast<ConstantExpr>(un->index)->getZExtValue(), un));
+  std::stable_sort(recent.begin(), recent.end(), entryIndexLess);
+  recent.erase(std::unique(recent.begin(), recent.end(), entryIndexEqual),
+               recent.end());
+
+  snapshot = new UpdateSnapshot();
+  if (previous) {
+    std::set_union(recent.begin(), recent.end(), previous->latest.begin(),
+                   previous->latest.end(),
+                   std::back_inserter(snapshot->latest), entryIndexLess);
+    snapshot->barrier = previous->barrier;
+  } else {
+    snapshot->latest.swap(recent);
+    snapshot->barrier = base;
+  }
+  base = this;
+}
+
+const UpdateNode *UpdateNode::findUpdate(uint64_t i) const {
+  for (const UpdateNode *un = this; un; un = un->next) {
+    ConstantExpr *CE = dyn_cast<ConstantExpr>(un->index);
+    if (!CE)
+      return un;
+    if (const UpdateSnapshot *s = un->snapshot) {
+      std::vector<UpdateSnapshot::Entry>::const_iterator it =
+          std::lower_bound(s->latest.begin(), s->latest.end(),
+                           std::make_pair(i, (const UpdateNode *) 0),
+                           entryIndexLess);
+      if (it != s->latest.end() && it->first == i)
+        return it->second;
+      return s->barrier;
+    }
+    if (CE->getZExtValue() == i)
+      return un;
+  }
+  return 0;
 }
 
 extern "C" void vc_DeleteExpr(void*);
@@ -44,6 +130,7 @@ extern "C" void vc_DeleteExpr(void*);
 // non-recursively.
 UpdateNode::~UpdateNode() {
     assert(refCount == 0 && "Deleted UpdateNode when a reference is still held");
+    delete snapshot;
 }
 
 int UpdateNode::compare(const UpdateNode &b) const {
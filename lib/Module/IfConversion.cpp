@@ -0,0 +1,140 @@
+//===-- IfConversion.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IntrinsicInst.h"
+#else
+#include "llvm/Function.h"
+#include "llvm/IntrinsicInst.h"
+#endif
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+
+namespace {
+  cl::opt<unsigned>
+  IfConversionThreshold("if-conversion-threshold",
+                        cl::desc("Turn a branch into selects if each of its "
+                                 "sides runs at most this many instructions "
+                                 "(with -optimize-pipeline=symbolic, "
+                                 "default=16)"),
+                        cl::init(16));
+}
+
+char klee::IfConversionPass::ID = 0;
+
+/// The block an unconditional branch ends b with, 0 if there is none.
+static BasicBlock *getOnlySuccessor(BasicBlock *b) {
+  BranchInst *br = dyn_cast<BranchInst>(b->getTerminator());
+  return br && br->isUnconditional() ? br->getSuccessor(0) : 0;
+}
+
+/// Can side, entered from pred only and going on to merge, run whether
+/// the branch of pred goes to it or not.
+static bool canSpeculate(BasicBlock *side, BasicBlock *pred,
+                         BasicBlock *merge) {
+  if (side->getSinglePredecessor() != pred || getOnlySuccessor(side) != merge ||
+      isa<PHINode>(side->begin()))
+    return false;
+
+  unsigned count = 0;
+  for (BasicBlock::iterator it = side->begin(), ie = side->end(); it != ie;
+       ++it) {
+    Instruction *i = &*it;
+    if (i == side->getTerminator() || isa<DbgInfoIntrinsic>(i))
+      continue;
+    // memory accesses and calls may fork or fail on their own
+    if (isa<CallInst>(i) || i->mayReadOrWriteMemory() ||
+        !isSafeToSpeculativelyExecute(i) || ++count > IfConversionThreshold)
+      return false;
+  }
+  return true;
+}
+
+bool klee::IfConversionPass::convert(BasicBlock *b) {
+  BranchInst *br = dyn_cast<BranchInst>(b->getTerminator());
+  if (!br || !br->isConditional())
+    return false;
+  BasicBlock *t = br->getSuccessor(0), *f = br->getSuccessor(1);
+  if (t == f)
+    return false;
+
+  // a triangle skips one side, a diamond runs either side before merge
+  BasicBlock *merge, *trueSide = 0, *falseSide = 0;
+  if (getOnlySuccessor(t) == f && canSpeculate(t, b, f)) {
+    merge = f;
+    trueSide = t;
+  } else if (getOnlySuccessor(f) == t && canSpeculate(f, b, t)) {
+    merge = t;
+    falseSide = f;
+  } else if ((merge = getOnlySuccessor(t)) && merge == getOnlySuccessor(f) &&
+             canSpeculate(t, b, merge) && canSpeculate(f, b, merge)) {
+    trueSide = t;
+    falseSide = f;
+  } else {
+    return false;
+  }
+  if (merge == b)
+    return false;
+
+  BasicBlock *sides[2] = { trueSide, falseSide };
+  for (unsigned i = 0; i < 2; i++) {
+    if (!sides[i])
+      continue;
+    while (&sides[i]->front() != sides[i]->getTerminator())
+      sides[i]->front().moveBefore(br);
+  }
+
+  // the values merged from the sides are selected by the condition
+  Value *cond = br->getCondition();
+  for (BasicBlock::iterator it = merge->begin();
+       PHINode *phi = dyn_cast<PHINode>(&*it); ++it) {
+    Value *trueValue = phi->getIncomingValueForBlock(trueSide ? trueSide : b);
+    Value *falseValue =
+        phi->getIncomingValueForBlock(falseSide ? falseSide : b);
+    Value *value = trueValue == falseValue ? trueValue :
+        SelectInst::Create(cond, trueValue, falseValue, phi->getName(), br);
+    for (unsigned i = 0; i < 2; i++)
+      if (sides[i])
+        phi->removeIncomingValue(sides[i], false);
+    if (trueSide && falseSide)
+      phi->addIncoming(value, b);
+    else
+      phi->setIncomingValue(phi->getBasicBlockIndex(b), value);
+  }
+
+  BranchInst::Create(merge, br);
+  br->eraseFromParent();
+  for (unsigned i = 0; i < 2; i++) {
+    if (!sides[i])
+      continue;
+    sides[i]->dropAllReferences();
+    sides[i]->eraseFromParent();
+  }
+  // so that b becomes a side of the branch around it
+  MergeBlockIntoPredecessor(merge);
+  return true;
+}
+
+bool klee::IfConversionPass::runOnFunction(Function &f) {
+  bool changed = false, again = true;
+  // a diamond inside a side of another one is converted first
+  while (again) {
+    again = false;
+    for (Function::iterator b = f.begin(), be = f.end(); b != be; ++b)
+      again |= convert(&*b);
+    changed |= again;
+  }
+  return changed;
+}
@@ -48,7 +48,8 @@
 
 #include "klee/Internal/Analysis/Cloner.h"
 
-#include <map>
+#include <algorithm>
+#include <cassert>
 #include <string>
 
 using namespace llvm;
@@ -64,7 +65,7 @@ public:
 };
         
 static void buildInstructionToLineMap(Module *m,
-                                      std::map<const Instruction*, unsigned> &out) {  
+                                      DenseMap<const Instruction*, unsigned> &out) {  
   InstructionToLineAnnotator a;
   std::string str;
   llvm::raw_string_ostream os(str);
@@ -103,7 +104,7 @@ static std::string getDSPIPath(DILocation Loc) {
 
 bool InstructionInfoTable::getInstructionDebugInfo(const llvm::Instruction *I, 
                                                    const std::string *&File,
-                                                   unsigned &Line) {
+                                                   unsigned &Line) const {
   if (MDNode *N = I->getMetadata("dbg")) {
     DILocation Loc(N);
     File = internString(getDSPIPath(Loc));
@@ -114,41 +115,28 @@ bool InstructionInfoTable::getInstructionDebugInfo(const llvm::Instruction *I,
   return false;
 }
 
-InstructionInfoTable::InstructionInfoTable(Module *m, bool isSkippingFunctions, Cloner *cloner)
-  : dummyString(""), dummyInfo(0, dummyString, 0, 0) {
+InstructionInfoTable::InstructionInfoTable(Module *m, bool isSkippingFunctions,
+                                           Cloner *cloner, bool _lazy)
+  : dummyString(""), dummyInfo(0, &dummyString, 0, 0), lazy(_lazy) {
   unsigned id = 0;
-  std::map<const Instruction*, unsigned> lineTable;
-  buildInstructionToLineMap(m, lineTable);
 
   for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
        fnIt != fn_ie; ++fnIt) {
+    if (fnIt->isDeclaration())
+      continue;
 
-    // We want to ensure that as all instructions have source information, if
-    // available. Clang sometimes will not write out debug information on the
-    // initial instructions in a function (correspond to the formal parameters),
-    // so we first search forward to find the first instruction with debug info,
-    // if any.
-    const std::string *initialFile = &dummyString;
-    unsigned initialLine = 0;
-    for (inst_iterator it = inst_begin(fnIt), ie = inst_end(fnIt); it != ie;
-         ++it) {
-      if (getInstructionDebugInfo(&*it, initialFile, initialLine))
-        break;
-    }
+    // The instructions of a cloned function were mapped to their originals
+    // along with the function it was cloned from.
+    if (ids.count(&*inst_begin(fnIt)))
+      continue;
 
-    const std::string *file = initialFile;
-    unsigned line = initialLine;
+    functionIndex[fnIt] = functions.size();
+    functions.push_back(fnIt);
+    functionStart.push_back(id);
     for (inst_iterator it = inst_begin(fnIt), ie = inst_end(fnIt); it != ie;
-        ++it) {
-      Instruction *instr = &*it;
-      unsigned assemblyLine = lineTable[instr];
-
-      // Update our source level debug information.
-      getInstructionDebugInfo(instr, file, line);
-
-      infos.insert(std::make_pair(instr,
-                                  InstructionInfo(id++, *file, line,
-                                                  assemblyLine)));
+         ++it) {
+      ids[&*it] = id;
+      infos.push_back(InstructionInfo(id++, &dummyString, 0, 0));
     }
 
     if (!isSkippingFunctions) {
@@ -169,6 +157,84 @@ InstructionInfoTable::InstructionInfoTable(Module *m, bool isSkippingFunctions,
       }
     }
   }
+  loaded.assign(functions.size(), false);
+
+  if (lazy)
+    return;
+
+  DenseMap<const Instruction*, unsigned> lineTable;
+  buildInstructionToLineMap(m, lineTable);
+
+  for (unsigned i = 0; i < functions.size(); ++i) {
+    loadIndex(i);
+
+    id = functionStart[i];
+    for (const_inst_iterator it = inst_begin(functions[i]),
+           ie = inst_end(functions[i]); it != ie; ++it)
+      infos[id++].assemblyLine = lineTable.lookup(&*it);
+  }
+}
+
+void InstructionInfoTable::loadIndex(unsigned index) const {
+  if (loaded[index])
+    return;
+  loaded[index] = true;
+
+  const Function *f = functions[index];
+
+  // We want to ensure that as all instructions have source information, if
+  // available. Clang sometimes will not write out debug information on the
+  // initial instructions in a function (correspond to the formal parameters),
+  // so we first search forward to find the first instruction with debug info,
+  // if any.
+  const std::string *initialFile = &dummyString;
+  unsigned initialLine = 0;
+  for (const_inst_iterator it = inst_begin(f), ie = inst_end(f); it != ie;
+       ++it) {
+    if (getInstructionDebugInfo(&*it, initialFile, initialLine))
+      break;
+  }
+
+  const std::string *file = initialFile;
+  unsigned line = initialLine;
+  unsigned id = functionStart[index];
+  for (const_inst_iterator it = inst_begin(f), ie = inst_end(f); it != ie;
+       ++it) {
+    // Update our source level debug information.
+    getInstructionDebugInfo(&*it, file, line);
+
+    InstructionInfo &info = infos[id++];
+    info.file = file;
+    info.line = line;
+  }
+}
+
+void InstructionInfoTable::loadID(unsigned id) const {
+  std::vector<unsigned>::const_iterator it =
+    std::upper_bound(functionStart.begin(), functionStart.end(), id);
+  assert(it != functionStart.begin() && "id not owned by any function");
+  loadIndex(it - functionStart.begin() - 1);
+}
+
+void InstructionInfoTable::loadFunction(const Function *f) const {
+  if (!lazy)
+    return;
+
+  DenseMap<const Function*, unsigned>::iterator it = functionIndex.find(f);
+  if (it != functionIndex.end()) {
+    if (it->second != ~0u)
+      loadIndex(it->second);
+    return;
+  }
+
+  /* a cloned function, load the functions its instructions come from */
+  for (const_inst_iterator ii = inst_begin(f), ie = inst_end(f); ii != ie;
+       ++ii) {
+    const InstructionInfo &info = lookup(&*ii);
+    if (&info != &dummyInfo)
+      loadID(info.id);
+  }
+  functionIndex[f] = ~0u;
 }
 
 void InstructionInfoTable::addClonedInfo(Cloner *cloner, Function *f) {
@@ -183,11 +249,10 @@ void InstructionInfoTable::addClonedInfo(Cloner *cloner, Function *f) {
                 llvm_unreachable("something is wrong with the cloner mapping");
             }
 
-            const InstructionInfo &info = getInfo(origInst);
-            infos.insert(std::make_pair(inst, info));
+            ids.insert(std::make_pair(inst, getID(origInst)));
         } else {
             /* instruction information not available (probably due to slicer insertions) */
-            infos.insert(std::make_pair(inst, dummyInfo));
+            ids.insert(std::make_pair(inst, ~0u));
         }
     }
 }
@@ -199,7 +264,7 @@ InstructionInfoTable::~InstructionInfoTable() {
     delete *it;
 }
 
-const std::string *InstructionInfoTable::internString(std::string s) {
+const std::string *InstructionInfoTable::internString(std::string s) const {
   std::set<const std::string *, ltstr>::iterator it = internedStrings.find(&s);
   if (it==internedStrings.end()) {
     std::string *interned = new std::string(s);
@@ -214,14 +279,28 @@ unsigned InstructionInfoTable::getMaxID() const {
   return infos.size();
 }
 
+unsigned InstructionInfoTable::getID(const Instruction *inst) const {
+  return lookup(inst).id;
+}
+
 const InstructionInfo &
-InstructionInfoTable::getInfo(const Instruction *inst) const {
-  std::map<const llvm::Instruction*, InstructionInfo>::const_iterator it = 
-    infos.find(inst);
-  if (it == infos.end())
+InstructionInfoTable::lookup(const Instruction *inst) const {
+  DenseMap<const llvm::Instruction*, unsigned>::const_iterator it =
+    ids.find(inst);
+  if (it == ids.end())
     llvm::report_fatal_error("invalid instruction, not present in "
                              "initial module!");
-  return it->second;
+  if (it->second == ~0u)
+    return dummyInfo;
+  return infos[it->second];
+}
+
+const InstructionInfo &
+InstructionInfoTable::getInfo(const Instruction *inst) const {
+  const InstructionInfo &info = lookup(inst);
+  if (lazy && &info != &dummyInfo)
+    loadID(info.id);
+  return info;
 }
 
 const InstructionInfo &
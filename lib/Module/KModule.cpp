@@ -21,6 +21,7 @@
 #include "klee/Internal/Support/Debug.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include "llvm/IR/Instructions.h"
@@ -42,13 +43,16 @@
 #endif
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+#include "llvm/Analysis/Dominators.h"
 #include "llvm/Support/CallSite.h"
 #else
 #include "llvm/IR/CallSite.h"
+#include "llvm/IR/Dominators.h"
 #endif
 
 #include "llvm/PassManager.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Support/Path.h"
@@ -64,6 +68,8 @@
 #include "klee/Internal/Analysis/SliceGenerator.h"
 
 #include <sstream>
+#include <stdio.h>
+#include <unistd.h>
 
 using namespace llvm;
 using namespace klee;
@@ -103,6 +109,13 @@ namespace {
                         clEnumValEnd),
              cl::init(eSwitchTypeInternal));
   
+  cl::opt<bool>
+  LazyInstructionInfo("lazy-instruction-info",
+                      cl::desc("Read the source locations of a function only "
+                               "when it is first called or reported, and "
+                               "leave the assembly.ll lines out (default=off)"),
+                      cl::init(false));
+
   cl::opt<bool>
   DebugPrintEscapingFunctions("debug-print-escaping-functions", 
                               cl::desc("Print functions whose address is taken."));
@@ -142,7 +155,8 @@ KModule::~KModule() {
 /***/
 
 namespace llvm {
-extern void Optimize(Module *, const std::string &EntryPoint);
+extern void Optimize(Module *, const std::string &EntryPoint,
+                     std::vector<std::string> &passNames);
 }
 
 // what a hack
@@ -249,15 +263,17 @@ void KModule::addInternalFunction(const char* functionName){
   internalFunctions.insert(internalFunction);
 }
 
-void KModule::prepare(const Interpreter::ModuleOptions &opts,
-		              const std::vector<Interpreter::SkippedFunctionOption> &skippedFunctions,
-                      InterpreterHandler *ih,
-                      ReachabilityAnalysis *ra,
-                      Inliner *inliner,
-                      AAPass *aa,
-                      ModRefAnalysis *mra,
-                      Cloner *cloner,
-                      SliceGenerator *sliceGenerator) {
+std::string KModule::getTransformOptions() {
+  std::stringstream key;
+  key << "switch-type=" << SwitchType;
+  for (cl::list<std::string>::iterator it = MergeAtExit.begin(),
+         ie = MergeAtExit.end(); it != ie; ++it)
+    key << " merge-at-exit=" << *it;
+  return key.str();
+}
+
+void KModule::transform(const Interpreter::ModuleOptions &opts,
+                        const std::vector<Interpreter::SkippedFunctionOption> &skippedFunctions) {
   if (!MergeAtExit.empty()) {
     Function *mergeFn = module->getFunction("klee_merge");
     if (!mergeFn) {
@@ -325,8 +341,19 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   pm.add(new IntrinsicCleanerPass(*targetData, false));
   pm.run(*module);
 
-  if (opts.Optimize)
-    Optimize(module, opts.EntryPoint);
+  if (opts.Optimize) {
+    std::vector<std::string> passNames;
+    Optimize(module, opts.EntryPoint, passNames);
+
+    // Record the pipeline, so that runs can be compared by it.
+    llvm::raw_fd_ostream *os = ih->openOutputFile("optimize.passes");
+    if (os) {
+      for (std::vector<std::string>::iterator it = passNames.begin(),
+             ie = passNames.end(); it != ie; ++it)
+        *os << *it << "\n";
+      delete os;
+    }
+  }
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 3)
   // Force importing functions required by intrinsic lowering. Kind of
   // unfortunate clutter when we don't need them but we won't know
@@ -365,13 +392,6 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
     );
   module = linkWithLibrary(module, LibPath.str());
 
-  // Add internal functions which are not used to check if instructions
-  // have been already visited
-  if (opts.CheckDivZero)
-    addInternalFunction("klee_div_zero_check");
-  if (opts.CheckOvershift)
-    addInternalFunction("klee_overshift_check");
-
 
   // Needs to happen after linking (since ctors/dtors can be modified)
   // and optimization (since global optimization can rewrite lists).
@@ -404,6 +424,66 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   f = module->getFunction("memset");
   if (f && f->use_empty()) f->eraseFromParent();
 #endif
+}
+
+void KModule::writeModuleCache(const std::string &path) {
+  std::stringstream tmpName;
+  tmpName << path << ".tmp" << getpid();
+  std::string tmpFile = tmpName.str();
+  std::string error;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,5)
+  llvm::raw_fd_ostream os(tmpFile.c_str(), error, llvm::sys::fs::F_None);
+#elif LLVM_VERSION_CODE >= LLVM_VERSION(3,4)
+  llvm::raw_fd_ostream os(tmpFile.c_str(), error, llvm::sys::fs::F_Binary);
+#else
+  llvm::raw_fd_ostream os(tmpFile.c_str(), error,
+                          llvm::raw_fd_ostream::F_Binary);
+#endif
+  if (!error.empty()) {
+    klee_warning("unable to write module cache %s: %s", tmpFile.c_str(),
+                 error.c_str());
+    return;
+  }
+  WriteBitcodeToFile(module, os);
+  os.close();
+
+  /* readers only ever see a complete module */
+  if (os.has_error() || rename(tmpFile.c_str(), path.c_str()) != 0) {
+    os.clear_error();
+    klee_warning("unable to write module cache %s", path.c_str());
+    unlink(tmpFile.c_str());
+  }
+}
+
+void KModule::prepare(const Interpreter::ModuleOptions &opts,
+		              const std::vector<Interpreter::SkippedFunctionOption> &skippedFunctions,
+                      InterpreterHandler *ih,
+                      ReachabilityAnalysis *ra,
+                      Inliner *inliner,
+                      AAPass *aa,
+                      ModRefAnalysis *mra,
+                      Cloner *cloner,
+                      SliceGenerator *sliceGenerator) {
+  if (!opts.Prepared) {
+    transform(opts, skippedFunctions);
+    if (!skippedFunctions.empty()) {
+      /* the pruning and the inlining are cached with the transformation */
+      ra->prepare();
+      inliner->run();
+    }
+    if (!opts.CacheFile.empty())
+      writeModuleCache(opts.CacheFile);
+  } else if (!skippedFunctions.empty()) {
+    /* only builds the function type map on a cached module */
+    ra->prepare();
+  }
+
+  // Add internal functions which are not used to check if instructions
+  // have been already visited
+  if (opts.CheckDivZero)
+    addInternalFunction("klee_div_zero_check");
+  if (opts.CheckOvershift)
+    addInternalFunction("klee_overshift_check");
 
   // Write out the .ll assembly file. We truncate long lines to work
   // around a kcachegrind parsing bug (it puts them on new lines), so
@@ -452,12 +532,6 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   kleeMergeFn = module->getFunction("klee_merge");
 
   if (!skippedFunctions.empty()) {
-    /* prepare reachability analysis */
-    ra->prepare();
-
-    /* first, we need to do the inlining... */
-    inliner->run();
-
     /* run pointer analysis */
     klee_message("Runnining pointer analysis...");
     PassManager passManager;
@@ -481,7 +555,8 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
 
   /* Build shadow structures */
 
-  infos = new InstructionInfoTable(module, !skippedFunctions.empty(), cloner);
+  infos = new InstructionInfoTable(module, !skippedFunctions.empty(), cloner,
+                                   LazyInstructionInfo);
   
   for (Module::iterator it = module->begin(), ie = module->end();
        it != ie; ++it) {
@@ -522,6 +597,8 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
     KFunction *kf = *it;
     if (functionEscapes(kf->function))
       escapingFunctions.insert(kf->function);
+    if (opts.FindLoops)
+      kf->findLoopExits();
   }
 
   if (DebugPrintEscapingFunctions && !escapingFunctions.empty()) {
@@ -537,7 +614,7 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
 void KModule::addFunction(KFunction *kf, bool isSkippingFunctions, Cloner *cloner, ModRefAnalysis *mra) {
     for (unsigned i=0; i<kf->numInstructions; ++i) {
         KInstruction *ki = kf->instructions[i];
-        ki->info = &infos->getInfo(ki->inst);
+        ki->info = &infos->lookup(ki->inst);
         ki->isCloned = kf->isCloned;
         ki->origInst = NULL;
         ki->mayBlock = false;
@@ -557,6 +634,9 @@ void KModule::addFunction(KFunction *kf, bool isSkippingFunctions, Cloner *clone
 
         if (ki->inst->getOpcode() == Instruction::Load) {
             ki->mayBlock = mra->mayBlock(ki->getOrigInst());
+            if (ki->mayBlock) {
+                addModifiers(ki, mra);
+            }
         }
         if (ki->inst->getOpcode() == Instruction::Store) {
             ki->mayOverride = mra->mayOverride(ki->getOrigInst());
@@ -567,6 +647,31 @@ void KModule::addFunction(KFunction *kf, bool isSkippingFunctions, Cloner *clone
     functionMap.insert(std::make_pair(kf->function, kf));
 }
 
+/* resolve the modifiers and their slice ids once, not on every execution */
+void KModule::addModifiers(KInstruction *ki, ModRefAnalysis *mra) {
+    ModRefAnalysis::LoadToModInfoMap &loadToModInfoMap = mra->getLoadToModInfoMap();
+    ModRefAnalysis::LoadToModInfoMap::iterator entry = loadToModInfoMap.find(ki->getOrigInst());
+    if (entry == loadToModInfoMap.end()) {
+        return;
+    }
+
+    std::set<ModRefAnalysis::ModInfo> &modInfos = entry->second;
+    ModRefAnalysis::ModInfoToIdMap &modInfoToIdMap = mra->getModInfoToIdMap();
+    ki->modifiers = new KModifierInfo[modInfos.size()];
+    ki->numModifiers = modInfos.size();
+
+    unsigned index = 0;
+    for (std::set<ModRefAnalysis::ModInfo>::iterator i = modInfos.begin(); i != modInfos.end(); i++) {
+        KModifierInfo &modifier = ki->modifiers[index++];
+        modifier.f = i->first;
+        modifier.allocSite = i->second.first;
+        modifier.offset = i->second.second;
+
+        ModRefAnalysis::ModInfoToIdMap::iterator id = modInfoToIdMap.find(*i);
+        modifier.sliceId = id == modInfoToIdMap.end() ? 0 : id->second;
+    }
+}
+
 KConstant* KModule::getKConstant(Constant *c) {
   std::map<llvm::Constant*, KConstant*>::iterator it = constantMap.find(c);
   if (it != constantMap.end())
@@ -655,12 +760,18 @@ KFunction::KFunction(llvm::Function *_function,
       case Instruction::InsertValue:
       case Instruction::ExtractValue:
         ki = new KGEPInstruction(); break;
+      case Instruction::Call:
+      case Instruction::Invoke:
+        ki = new KCallInstruction(); break;
       default:
         ki = new KInstruction(); break;
       }
 
       ki->inst = it;      
+      ki->opcode = it->getOpcode();
       ki->dest = registerMap[it];
+      ki->modifiers = 0;
+      ki->numModifiers = 0;
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         CallSite cs(it);
@@ -686,6 +797,32 @@ KFunction::KFunction(llvm::Function *_function,
   }
 }
 
+void KFunction::findLoopExits() {
+  DominatorTreeBase<BasicBlock> dt(false);
+  dt.recalculate(*function);
+  LoopInfoBase<BasicBlock, Loop> loopInfo;
+  loopInfo.Analyze(dt);
+
+  for (llvm::Function::iterator bbit = function->begin(),
+         bbie = function->end(); bbit != bbie; ++bbit) {
+    BranchInst *bi = dyn_cast<BranchInst>(bbit->getTerminator());
+    if (!bi || bi->isUnconditional())
+      continue;
+    for (Loop *loop = loopInfo.getLoopFor(bbit); loop;
+         loop = loop->getParentLoop()) {
+      unsigned exitMask = 0;
+      for (unsigned i = 0; i < 2; i++)
+        if (!loop->contains(bi->getSuccessor(i)))
+          exitMask |= 1 << i;
+      // a branch leaving on both sides is not where the loop forks
+      if (exitMask == 1 || exitMask == 2) {
+        LoopExit exit = { loop->getHeader(), exitMask };
+        loopExits[bi].push_back(exit);
+      }
+    }
+  }
+}
+
 KFunction::~KFunction() {
   for (unsigned i=0; i<numInstructions; ++i)
     delete instructions[i];
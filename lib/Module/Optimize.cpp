@@ -15,6 +15,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "Passes.h"
+
 #include "klee/Config/Version.h"
 #include "llvm/PassManager.h"
 #include "llvm/Analysis/Passes.h"
@@ -78,9 +80,33 @@ static cl::opt<bool> StripDebug("strip-debug",
 static cl::alias A1("S", cl::desc("Alias for --strip-debug"),
   cl::aliasopt(StripDebug));
 
+namespace {
+  enum OptimizePipelineKind {
+    eOptimizeDefault,
+    eOptimizeSymbolic
+  };
+}
+
+static cl::opt<OptimizePipelineKind>
+OptimizePipeline("optimize-pipeline",
+  cl::desc("The passes -optimize runs"),
+  cl::values(clEnumValN(eOptimizeDefault, "default",
+                        "The link time pipeline of llvm-ld (default)"),
+             clEnumValN(eOptimizeSymbolic, "symbolic",
+                        "Do not unswitch loops or thread jumps, turn cheap "
+                        "branches into selects, scalarize vectors and "
+                        "eliminate dead stores last"),
+             clEnumValEnd),
+  cl::init(eOptimizeDefault));
+
+// The names of the passes added, in order, for optimize.passes.
+static std::vector<std::string> PassNames;
+
 // A utility function that adds a pass to the pass manager but will also add
 // a verifier pass after if we're supposed to verify.
 static inline void addPass(PassManager &PM, Pass *P) {
+  PassNames.push_back(P->getPassName());
+
   // Add the pass to the pass manager...
   PM.add(P);
 
@@ -125,17 +151,26 @@ static void AddStandardCompilePasses(PassManager &PM) {
   addPass(PM, createSimplifyLibCallsPass());     // Library Call Optimizations
 #endif
   addPass(PM, createInstructionCombiningPass()); // Cleanup for scalarrepl.
-  addPass(PM, createJumpThreadingPass());        // Thread jumps.
+  if (OptimizePipeline != eOptimizeSymbolic)
+    addPass(PM, createJumpThreadingPass());      // Thread jumps.
   addPass(PM, createCFGSimplificationPass());    // Merge & remove BBs
   addPass(PM, createScalarReplAggregatesPass()); // Break up aggregate allocas
   addPass(PM, createInstructionCombiningPass()); // Combine silly seq's
+  if (OptimizePipeline == eOptimizeSymbolic) {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 4)
+    addPass(PM, createScalarizerPass());         // Split vector operations
+#endif
+    addPass(PM, new klee::IfConversionPass());   // Branches to selects
+    addPass(PM, createCFGSimplificationPass());
+  }
 
   addPass(PM, createTailCallEliminationPass());  // Eliminate tail calls
   addPass(PM, createCFGSimplificationPass());    // Merge & remove BBs
   addPass(PM, createReassociatePass());          // Reassociate expressions
   addPass(PM, createLoopRotatePass());
   addPass(PM, createLICMPass());                 // Hoist loop invariants
-  addPass(PM, createLoopUnswitchPass());         // Unswitch loops.
+  if (OptimizePipeline != eOptimizeSymbolic)
+    addPass(PM, createLoopUnswitchPass());       // Unswitch loops.
   // FIXME : Removing instcombine causes nestedloop regression.
   addPass(PM, createInstructionCombiningPass());
   addPass(PM, createIndVarSimplifyPass());       // Canonicalize indvars
@@ -145,6 +180,9 @@ static void AddStandardCompilePasses(PassManager &PM) {
   addPass(PM, createGVNPass());                  // Remove redundancies
   addPass(PM, createMemCpyOptPass());            // Remove memcpy / form memset
   addPass(PM, createSCCPPass());                 // Constant prop with SCCP
+  // GVN and SCCP fold the conditions that guarded memory accesses
+  if (OptimizePipeline == eOptimizeSymbolic)
+    addPass(PM, new klee::IfConversionPass());
 
   // Run instcombine after redundancy elimination to exploit opportunities
   // opened up by them.
@@ -163,7 +201,9 @@ static void AddStandardCompilePasses(PassManager &PM) {
 /// Optimize - Perform link time optimizations. This will run the scalar
 /// optimizations, any loaded plugin-optimization modules, and then the
 /// inter-procedural optimizations if applicable.
-void Optimize(Module *M, const std::string &EntryPoint) {
+void Optimize(Module *M, const std::string &EntryPoint,
+              std::vector<std::string> &passNames) {
+  PassNames.clear();
 
   // Instantiate the pass manager to organize the passes.
   PassManager Passes;
@@ -234,7 +274,8 @@ void Optimize(Module *M, const std::string &EntryPoint) {
 
     // The IPO passes may leave cruft around.  Clean up after them.
     addPass(Passes, createInstructionCombiningPass());
-    addPass(Passes, createJumpThreadingPass());        // Thread jumps.
+    if (OptimizePipeline != eOptimizeSymbolic)
+      addPass(Passes, createJumpThreadingPass());      // Thread jumps.
     addPass(Passes, createScalarReplAggregatesPass()); // Break up allocas
 
     // Run a few AA driven optimizations here and now, to cleanup the code.
@@ -249,7 +290,8 @@ void Optimize(Module *M, const std::string &EntryPoint) {
     // Cleanup and simplify the code after the scalar optimizations.
     addPass(Passes, createInstructionCombiningPass());
 
-    addPass(Passes, createJumpThreadingPass());        // Thread jumps.
+    if (OptimizePipeline != eOptimizeSymbolic)
+      addPass(Passes, createJumpThreadingPass());      // Thread jumps.
     addPass(Passes, createPromoteMemoryToRegisterPass()); // Cleanup jumpthread.
     
     // Delete basic blocks, which optimization passes may have killed...
@@ -283,6 +325,12 @@ void Optimize(Module *M, const std::string &EntryPoint) {
   if (!DisableOptimizations) {
     addPass(Passes, createInstructionCombiningPass());
     addPass(Passes, createCFGSimplificationPass());
+    if (OptimizePipeline == eOptimizeSymbolic) {
+      addPass(Passes, new klee::IfConversionPass());
+      addPass(Passes, createCFGSimplificationPass());
+      // the stores left are the ones the mod/ref analysis has to track
+      addPass(Passes, createDeadStoreEliminationPass());
+    }
     addPass(Passes, createAggressiveDCEPass());
     addPass(Passes, createGlobalDCEPass());
   }
@@ -293,6 +341,7 @@ void Optimize(Module *M, const std::string &EntryPoint) {
 
   // Run our queue of passes all at once now, efficiently.
   Passes.run(*M);
+  passNames.swap(PassNames);
 }
 
 }
@@ -123,6 +123,25 @@ public:
   virtual bool runOnFunction(llvm::Function &f);
 };
   
+/// IfConversionPass - Turn the branches over a few side-effect free
+/// instructions into selects.
+///
+/// A symbolic branch forks, a select does not: its sides are merged into
+/// an ite expression instead. The sides of a triangle or diamond which run
+/// no memory accesses or calls, and at most --if-conversion-threshold
+/// instructions each, are hoisted above the branch, and the phis of the
+/// merge select between their values.
+class IfConversionPass : public llvm::FunctionPass {
+  static char ID;
+
+  bool convert(llvm::BasicBlock *b);
+
+public:
+  IfConversionPass() : llvm::FunctionPass(ID) {}
+
+  virtual bool runOnFunction(llvm::Function &f);
+};
+
 class DivCheckPass : public llvm::ModulePass {
   static char ID;
 public:
@@ -0,0 +1,141 @@
+//===-- BinaryQueryLoggingSolver.cpp --------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/Config/Version.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/BinaryQueryLog.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 4)
+#include "llvm/Support/FileSystem.h"
+#endif
+#include "llvm/Support/raw_ostream.h"
+
+using namespace klee;
+using namespace klee::util;
+
+/// Logs queries in the binary query log format. Unlike the text loggers, the
+/// definitions of the expressions a query needs are written even when the
+/// query itself is below the logging threshold, since later queries may
+/// refer to them.
+class BinaryQueryLoggingSolver : public SolverImpl {
+  Solver *solver;
+  llvm::raw_fd_ostream *os;
+  BinaryQueryLogWriter writer;
+  std::string defs, record;
+  int minQueryTimeToLog; // as for QueryLoggingSolver
+  double startTime;
+
+  void startQuery(BinaryQueryLogWriter::QueryType type, const Query &query,
+                  const std::vector<const Array *> *objects = 0) {
+    writer.resetIfFull(defs);
+    writer.writeQuery(defs, record, type, query, objects);
+    startTime = getWallTime();
+  }
+
+  void finishQuery(bool success, unsigned answer) {
+    double elapsed = getWallTime() - startTime;
+    BinaryQueryLogWriter::writeResult(record, success, elapsed, answer);
+
+    bool writeRecord = false;
+    if ((0 == minQueryTimeToLog) ||
+        (static_cast<int>(elapsed * 1000) > minQueryTimeToLog)) {
+      writeRecord = minQueryTimeToLog >= 0 ||
+                    SOLVER_RUN_STATUS_TIMEOUT ==
+                        solver->impl->getOperationStatusCode();
+    }
+
+    os->write(defs.data(), defs.size());
+    if (writeRecord)
+      os->write(record.data(), record.size());
+    defs.clear();
+    record.clear();
+  }
+
+public:
+  BinaryQueryLoggingSolver(Solver *_solver, std::string path,
+                           int queryTimeToLog)
+      : solver(_solver), minQueryTimeToLog(queryTimeToLog), startTime(0) {
+    std::string error;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+    os = new llvm::raw_fd_ostream(path.c_str(), error, llvm::sys::fs::F_None);
+#elif LLVM_VERSION_CODE >= LLVM_VERSION(3, 4)
+    os = new llvm::raw_fd_ostream(path.c_str(), error,
+                                  llvm::sys::fs::F_Binary);
+#else
+    os = new llvm::raw_fd_ostream(path.c_str(), error,
+                                  llvm::raw_fd_ostream::F_Binary);
+#endif
+    if (!error.empty())
+      klee_error("Could not open file %s : %s", path.c_str(), error.c_str());
+
+    std::string header;
+    BinaryQueryLogWriter::writeHeader(header);
+    *os << header;
+  }
+
+  ~BinaryQueryLoggingSolver() {
+    delete solver;
+    delete os;
+  }
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    startQuery(BinaryQueryLogWriter::Truth, query);
+    bool success = solver->impl->computeTruth(query, isValid);
+    finishQuery(success, success && isValid);
+    return success;
+  }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    startQuery(BinaryQueryLogWriter::Validity, query);
+    bool success = solver->impl->computeValidity(query, result);
+    finishQuery(success, success ? result + 1 : 0);
+    return success;
+  }
+
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    startQuery(BinaryQueryLogWriter::Value, query);
+    bool success = solver->impl->computeValue(query, result);
+    finishQuery(success, 0);
+    return success;
+  }
+
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    startQuery(BinaryQueryLogWriter::InitialValues, query, &objects);
+    bool success =
+        solver->impl->computeInitialValues(query, objects, values, hasSolution);
+    finishQuery(success, success && hasSolution);
+    return success;
+  }
+
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+
+  void setCoreSolverTimeout(double timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+///
+
+Solver *klee::createBinaryQueryLoggingSolver(Solver *_solver, std::string path,
+                                             int minQueryTimeToLog) {
+  return new Solver(
+      new BinaryQueryLoggingSolver(_solver, path, minQueryTimeToLog));
+}
@@ -16,6 +16,8 @@
 #include "klee/SolverImpl.h"
 
 #include "klee/SolverStats.h"
+#include "klee/util/QueryHash.h"
+#include "klee/Internal/System/MemoryUsage.h"
 
 #include <ciso646>
 #ifdef _LIBCPP_VERSION
@@ -30,52 +32,44 @@ using namespace klee;
 
 class CachingSolver : public SolverImpl {
 private:
-  ref<Expr> canonicalizeQuery(ref<Expr> originalQuery,
-                              bool &negationUsed);
+  /// the hash of the canonical form of the query or of its negation,
+  /// whichever is smaller
+  typedef QueryHasher::Hash CacheKey;
 
-  void cacheInsert(const Query& query,
+  CacheKey getCacheKey(const Query& query, bool &negationUsed);
+
+  void cacheInsert(const CacheKey &key, bool negationUsed,
                    IncompleteSolver::PartialValidity result);
 
-  bool cacheLookup(const Query& query,
+  bool cacheLookup(const CacheKey &key, bool negationUsed,
                    IncompleteSolver::PartialValidity &result);
   
-  struct CacheEntry {
-    CacheEntry(const ConstraintManager &c, ref<Expr> q)
-      : constraints(c), query(q) {}
-
-    CacheEntry(const CacheEntry &ce)
-      : constraints(ce.constraints), query(ce.query) {}
-    
-    ConstraintManager constraints;
-    ref<Expr> query;
-
-    bool operator==(const CacheEntry &b) const {
-      return constraints==b.constraints && *query.get()==*b.query.get();
-    }
-  };
-  
-  struct CacheEntryHash {
-    unsigned operator()(const CacheEntry &ce) const {
-      unsigned result = ce.query->hash();
-      
-      for (ConstraintManager::constraint_iterator it = ce.constraints.begin();
-           it != ce.constraints.end(); ++it)
-        result ^= (*it)->hash();
-      
-      return result;
+  struct CacheKeyHash {
+    size_t operator()(const CacheKey &key) const {
+      return key.first ^ key.second;
     }
   };
 
-  typedef unordered_map<CacheEntry, 
+  typedef unordered_map<CacheKey, 
                         IncompleteSolver::PartialValidity, 
-                        CacheEntryHash> cache_map;
+                        CacheKeyHash> cache_map;
   
   Solver *solver;
   cache_map cache;
 
+  /// the estimated size of an entry, with its hash node
+  static size_t getEntryBytes() {
+    return sizeof(cache_map::value_type) + 2 * sizeof(void *);
+  }
+
 public:
   CachingSolver(Solver *s) : solver(s) {}
-  ~CachingSolver() { cache.clear(); delete solver; }
+  ~CachingSolver() {
+    util::AccountMemory(util::SolverCacheMemory,
+                        -(int64_t) (cache.size() * getEntryBytes()));
+    cache.clear();
+    delete solver;
+  }
 
   bool computeValidity(const Query&, Solver::Validity &result);
   bool computeTruth(const Query&, bool &isValid);
@@ -96,32 +90,27 @@ public:
   void setCoreSolverTimeout(double timeout);
 };
 
-/** @returns the canonical version of the given query.  The reference
-    negationUsed is set to true if the original query was negated in
-    the canonicalization process. */
-ref<Expr> CachingSolver::canonicalizeQuery(ref<Expr> originalQuery,
-                                           bool &negationUsed) {
-  ref<Expr> negatedQuery = Expr::createIsZero(originalQuery);
+/** @returns the key of the canonical version of the given query. The
+    canonical form does not depend on the order of the constraints and of
+    commutative operands or on the names of the arrays, so alpha-equivalent
+    queries share an entry. The reference negationUsed is set to true if
+    the key is the one of the negated query. */
+CachingSolver::CacheKey CachingSolver::getCacheKey(const Query& query,
+                                                   bool &negationUsed) {
+  QueryHasher hasher(query.constraints);
+  CacheKey key = hasher.getHash(query.expr);
+  CacheKey negatedKey = hasher.getHash(Expr::createIsZero(query.expr));
 
   // select the "smaller" query to the be canonical representation
-  if (originalQuery.compare(negatedQuery) < 0) {
-    negationUsed = false;
-    return originalQuery;
-  } else {
-    negationUsed = true;
-    return negatedQuery;
-  }
+  negationUsed = negatedKey < key;
+  return negationUsed ? negatedKey : key;
 }
 
 /** @returns true on a cache hit, false of a cache miss.  Reference
     value result only valid on a cache hit. */
-bool CachingSolver::cacheLookup(const Query& query,
+bool CachingSolver::cacheLookup(const CacheKey &key, bool negationUsed,
                                 IncompleteSolver::PartialValidity &result) {
-  bool negationUsed;
-  ref<Expr> canonicalQuery = canonicalizeQuery(query.expr, negationUsed);
-
-  CacheEntry ce(query.constraints, canonicalQuery);
-  cache_map::iterator it = cache.find(ce);
+  cache_map::iterator it = cache.find(key);
   
   if (it != cache.end()) {
     result = (negationUsed ?
@@ -134,22 +123,25 @@ bool CachingSolver::cacheLookup(const Query& query,
 }
 
 /// Inserts the given query, result pair into the cache.
-void CachingSolver::cacheInsert(const Query& query,
+void CachingSolver::cacheInsert(const CacheKey &key, bool negationUsed,
                                 IncompleteSolver::PartialValidity result) {
-  bool negationUsed;
-  ref<Expr> canonicalQuery = canonicalizeQuery(query.expr, negationUsed);
-
-  CacheEntry ce(query.constraints, canonicalQuery);
   IncompleteSolver::PartialValidity cachedResult = 
     (negationUsed ? IncompleteSolver::negatePartialValidity(result) : result);
   
-  cache.insert(std::make_pair(ce, cachedResult));
+  std::pair<cache_map::iterator, bool> res =
+    cache.insert(std::make_pair(key, cachedResult));
+  if (res.second)
+    util::AccountMemory(util::SolverCacheMemory, getEntryBytes());
+  else
+    res.first->second = cachedResult;
 }
 
 bool CachingSolver::computeValidity(const Query& query,
                                     Solver::Validity &result) {
   IncompleteSolver::PartialValidity cachedResult;
-  bool tmp, cacheHit = cacheLookup(query, cachedResult);
+  bool negationUsed;
+  CacheKey key = getCacheKey(query, negationUsed);
+  bool tmp, cacheHit = cacheLookup(key, negationUsed, cachedResult);
   
   if (cacheHit) {
     switch(cachedResult) {
@@ -170,11 +162,11 @@ bool CachingSolver::computeValidity(const Query& query,
       if (!solver->impl->computeTruth(query, tmp))
         return false;
       if (tmp) {
-        cacheInsert(query, IncompleteSolver::MustBeTrue);
+        cacheInsert(key, negationUsed, IncompleteSolver::MustBeTrue);
         result = Solver::True;
         return true;
       } else {
-        cacheInsert(query, IncompleteSolver::TrueOrFalse);
+        cacheInsert(key, negationUsed, IncompleteSolver::TrueOrFalse);
         result = Solver::Unknown;
         return true;
       }
@@ -184,11 +176,11 @@ bool CachingSolver::computeValidity(const Query& query,
       if (!solver->impl->computeTruth(query.negateExpr(), tmp))
         return false;
       if (tmp) {
-        cacheInsert(query, IncompleteSolver::MustBeFalse);
+        cacheInsert(key, negationUsed, IncompleteSolver::MustBeFalse);
         result = Solver::False;
         return true;
       } else {
-        cacheInsert(query, IncompleteSolver::TrueOrFalse);
+        cacheInsert(key, negationUsed, IncompleteSolver::TrueOrFalse);
         result = Solver::Unknown;
         return true;
       }
@@ -211,14 +203,16 @@ bool CachingSolver::computeValidity(const Query& query,
     cachedResult = IncompleteSolver::TrueOrFalse; break;
   }
   
-  cacheInsert(query, cachedResult);
+  cacheInsert(key, negationUsed, cachedResult);
   return true;
 }
 
 bool CachingSolver::computeTruth(const Query& query,
                                  bool &isValid) {
   IncompleteSolver::PartialValidity cachedResult;
-  bool cacheHit = cacheLookup(query, cachedResult);
+  bool negationUsed;
+  CacheKey key = getCacheKey(query, negationUsed);
+  bool cacheHit = cacheLookup(key, negationUsed, cachedResult);
 
   // a cached result of MayBeTrue forces us to check whether
   // a False assignment exists.
@@ -245,7 +239,7 @@ bool CachingSolver::computeTruth(const Query& query,
     cachedResult = IncompleteSolver::MayBeFalse;
   }
   
-  cacheInsert(query, cachedResult);
+  cacheInsert(key, negationUsed, cachedResult);
   return true;
 }
 
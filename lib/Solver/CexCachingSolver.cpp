@@ -14,6 +14,7 @@
 #include "klee/SolverImpl.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/AssignmentBatch.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
 #include "klee/Internal/ADT/MapOfSets.h"
@@ -21,9 +22,13 @@
 #include "klee/SolverStats.h"
 
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/Time.h"
 
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
+
 using namespace klee;
 using namespace llvm;
 
@@ -44,12 +49,35 @@ namespace {
   cl::opt<bool>
   CexCacheExperimental("cex-cache-exp", cl::init(false));
 
+  cl::opt<unsigned>
+  CexCacheMaxMemory("cex-cache-max-memory",
+                    cl::desc("Bound on the estimated size of the "
+                             "counterexample cache in MB, the entries which "
+                             "saved the least solver time per byte are "
+                             "evicted first, 0 for no bound (default=256)"),
+                    cl::init(256));
+
 }
 
 ///
 
 typedef std::set< ref<Expr> > KeyType;
 
+/// a cached result, and what it is worth keeping
+struct CexCacheEntry {
+  /// 0 for an unsatisfiable key
+  Assignment *assignment;
+  /// the solver time which produced the result, in seconds
+  double cost;
+  /// entries with the lowest priority are evicted first (GreedyDual-Size:
+  /// the priority is the cost per byte, on top of the priority of the last
+  /// evicted entry when it was inserted or last hit)
+  double priority;
+  size_t bytes;
+
+  CexCacheEntry() : assignment(0), cost(0.), priority(0.), bytes(0) {}
+};
+
 struct AssignmentLessThan {
   bool operator()(const Assignment *a, const Assignment *b) {
     return a->bindings < b->bindings;
@@ -62,9 +90,28 @@ class CexCachingSolver : public SolverImpl {
 
   Solver *solver;
   
-  MapOfSets<ref<Expr>, Assignment*> cache;
+  MapOfSets<ref<Expr>, CexCacheEntry> cache;
   // memo table
   assignmentsTable_ty assignmentsTable;
+  /// the number of entries holding each assignment
+  std::map<Assignment*, unsigned> assignmentUses;
+  /// the assignments of the table in batches, for --cex-cache-try-all;
+  /// the lanes of removed assignments stay empty until rebuildBatches
+  std::vector<AssignmentBatch*> batches;
+  std::map<Assignment*, AssignmentBatch*> assignmentBatch;
+  /// the estimated size of the entries and of the assignments
+  size_t bytes;
+  /// the priority of the last evicted entry
+  double inflation;
+
+  void addBytes(int64_t delta);
+  void touch(CexCacheEntry &entry);
+  void addEntry(const KeyType &key, Assignment *binding, double cost);
+  bool removeEntry(const KeyType &key);
+  void evict();
+  void addToBatches(Assignment *a);
+  void removeFromBatches(Assignment *a);
+  void rebuildBatches();
 
   bool searchForAssignment(KeyType &key, 
                            Assignment *&result);
@@ -79,7 +126,8 @@ class CexCachingSolver : public SolverImpl {
   bool getAssignment(const Query& query, Assignment *&result);
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver)
+    : solver(_solver), bytes(0), inflation(0.) {}
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
@@ -97,11 +145,11 @@ public:
 ///
 
 struct NullAssignment {
-  bool operator()(Assignment *a) const { return !a; }
+  bool operator()(const CexCacheEntry &e) const { return !e.assignment; }
 };
 
 struct NonNullAssignment {
-  bool operator()(Assignment *a) const { return a!=0; }
+  bool operator()(const CexCacheEntry &e) const { return e.assignment!=0; }
 };
 
 struct NullOrSatisfyingAssignment {
@@ -109,11 +157,139 @@ struct NullOrSatisfyingAssignment {
   
   NullOrSatisfyingAssignment(KeyType &_key) : key(_key) {}
 
-  bool operator()(Assignment *a) const { 
+  bool operator()(const CexCacheEntry &e) const { 
+    Assignment *a = e.assignment;
     return !a || a->satisfies(key.begin(), key.end()); 
   }
 };
 
+/// the estimated size of a key, as if it shared no node with other keys
+static size_t getKeyBytes(const KeyType &key) {
+  return sizeof(CexCacheEntry) + key.size() * 64;
+}
+
+static size_t getAssignmentBytes(const Assignment *a) {
+  size_t bytes = sizeof(Assignment);
+  for (Assignment::bindings_ty::const_iterator it = a->bindings.begin(),
+         ie = a->bindings.end(); it != ie; ++it)
+    bytes += 64 + it->second.size();
+  return bytes;
+}
+
+/// the size of the cache changed, in the memory accounting too
+void CexCachingSolver::addBytes(int64_t delta) {
+  bytes += delta;
+  util::AccountMemory(util::SolverCacheMemory, delta);
+}
+
+void CexCachingSolver::touch(CexCacheEntry &entry) {
+  entry.priority = inflation + entry.cost / entry.bytes;
+}
+
+void CexCachingSolver::addEntry(const KeyType &key, Assignment *binding,
+                                double cost) {
+  removeEntry(key);
+
+  CexCacheEntry entry;
+  entry.assignment = binding;
+  entry.cost = cost;
+  entry.bytes = getKeyBytes(key);
+  touch(entry);
+  cache.insert(key, entry);
+  addBytes(entry.bytes);
+  if (binding)
+    ++assignmentUses[binding];
+}
+
+bool CexCachingSolver::removeEntry(const KeyType &key) {
+  CexCacheEntry *entry = cache.lookup(key);
+  if (!entry)
+    return false;
+
+  Assignment *a = entry->assignment;
+  addBytes(-(int64_t) entry->bytes);
+  cache.erase(key);
+  if (a && --assignmentUses[a] == 0) {
+    assignmentUses.erase(a);
+    assignmentsTable.erase(a);
+    removeFromBatches(a);
+    addBytes(-(int64_t) getAssignmentBytes(a));
+    delete a;
+  }
+  return true;
+}
+
+/// evict the entries of the lowest priority, until the cache is down to
+/// three quarters of its bound
+void CexCachingSolver::evict() {
+  size_t target = (size_t) CexCacheMaxMemory * 1024 * 1024 / 4 * 3;
+
+  /* find the priority up to which the entries go... */
+  std::vector< std::pair<double, size_t> > priorities;
+  for (MapOfSets<ref<Expr>, CexCacheEntry>::iterator it = cache.begin(),
+         ie = cache.end(); it != ie; ++it) {
+    CexCacheEntry entry = (*it).second;
+    size_t size = entry.bytes;
+    if (entry.assignment && assignmentUses[entry.assignment] == 1)
+      size += getAssignmentBytes(entry.assignment);
+    priorities.push_back(std::make_pair(entry.priority, size));
+  }
+  std::sort(priorities.begin(), priorities.end());
+
+  size_t left = bytes;
+  double cutoff = inflation;
+  for (unsigned i = 0; i < priorities.size() && left > target; i++) {
+    cutoff = priorities[i].first;
+    left -= std::min(left, priorities[i].second);
+  }
+
+  /* ...then remove them, the iteration does not survive a removal */
+  std::vector<KeyType> victims;
+  for (MapOfSets<ref<Expr>, CexCacheEntry>::iterator it = cache.begin(),
+         ie = cache.end(); it != ie; ++it)
+    if ((*it).second.priority <= cutoff)
+      victims.push_back((*it).first);
+  for (unsigned i = 0; i < victims.size(); i++)
+    if (removeEntry(victims[i]))
+      ++stats::queryCexCacheEvictions;
+  inflation = cutoff;
+  rebuildBatches();
+}
+
+void CexCachingSolver::addToBatches(Assignment *a) {
+  if (!CexCacheTryAll)
+    return;
+  if (batches.empty() || batches.back()->isFull())
+    batches.push_back(new AssignmentBatch());
+  batches.back()->add(a);
+  assignmentBatch[a] = batches.back();
+}
+
+void CexCachingSolver::removeFromBatches(Assignment *a) {
+  std::map<Assignment*, AssignmentBatch*>::iterator it =
+    assignmentBatch.find(a);
+  if (it == assignmentBatch.end())
+    return;
+  AssignmentBatch *batch = it->second;
+  assignmentBatch.erase(it);
+  batch->remove(a);
+  if (batch->empty()) {
+    batches.erase(std::find(batches.begin(), batches.end(), batch));
+    delete batch;
+  }
+}
+
+/// pack the assignments of the table into full batches again
+void CexCachingSolver::rebuildBatches() {
+  for (unsigned i = 0; i < batches.size(); i++)
+    delete batches[i];
+  batches.clear();
+  assignmentBatch.clear();
+  for (assignmentsTable_ty::iterator it = assignmentsTable.begin(),
+         ie = assignmentsTable.end(); it != ie; ++it)
+    addToBatches(*it);
+}
+
 /// searchForAssignment - Look for a cached solution for a query.
 ///
 /// \param key - The query to look up.
@@ -122,16 +298,17 @@ struct NullOrSatisfyingAssignment {
 /// unsatisfiable query).
 /// \return - True if a cached result was found.
 bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
-  Assignment * const *lookup = cache.lookup(key);
+  CexCacheEntry *lookup = cache.lookup(key);
   if (lookup) {
-    result = *lookup;
+    touch(*lookup);
+    result = lookup->assignment;
     return true;
   }
 
   if (CexCacheTryAll) {
     // Look for a satisfying assignment for a superset, which is trivially an
     // assignment for any subset.
-    Assignment **lookup = 0;
+    CexCacheEntry *lookup = 0;
     if (CexCacheSuperSet)
       lookup = cache.findSuperset(key, NonNullAssignment());
 
@@ -141,17 +318,17 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
-      result = *lookup;
+      touch(*lookup);
+      result = lookup->assignment;
       return true;
     }
 
-    // Otherwise, iterate through the set of current assignments to see if one
-    // of them satisfies the query.
-    for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
-           ie = assignmentsTable.end(); it != ie; ++it) {
-      Assignment *a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
-        result = a;
+    // Otherwise, evaluate the current assignments a batch at a time to see
+    // if one of them satisfies the query.
+    for (unsigned i = 0; i < batches.size(); i++) {
+      int lane = batches[i]->findSatisfying(key.begin(), key.end());
+      if (lane >= 0) {
+        result = const_cast<Assignment*>(batches[i]->getAssignment(lane));
         return true;
       }
     }
@@ -160,7 +337,7 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
 
     // Look for a satisfying assignment for a superset, which is trivially an
     // assignment for any subset.
-    Assignment **lookup = 0;
+    CexCacheEntry *lookup = 0;
     if (CexCacheSuperSet)
       lookup = cache.findSuperset(key, NonNullAssignment());
 
@@ -174,7 +351,8 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
-      result = *lookup;
+      touch(*lookup);
+      result = lookup->assignment;
       return true;
     }
   }
@@ -221,11 +399,17 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   std::vector<const Array*> objects;
   findSymbolicObjects(key.begin(), key.end(), objects);
 
+  if (CexCacheMaxMemory &&
+      bytes > (size_t) CexCacheMaxMemory * 1024 * 1024)
+    evict();
+
   std::vector< std::vector<unsigned char> > values;
   bool hasSolution;
+  double start = util::getWallTime();
   if (!solver->impl->computeInitialValues(query, objects, values, 
                                           hasSolution))
     return false;
+  double cost = util::getWallTime() - start;
     
   Assignment *binding;
   if (hasSolution) {
@@ -237,6 +421,9 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
     if (!res.second) {
       delete binding;
       binding = *res.first;
+    } else {
+      addBytes(getAssignmentBytes(binding));
+      addToBatches(binding);
     }
     
     if (DebugCexCacheCheckBinding)
@@ -250,7 +437,7 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   }
   
   result = binding;
-  cache.insert(key, binding);
+  addEntry(key, binding, cost);
 
   return true;
 }
@@ -258,8 +445,11 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
 ///
 
 CexCachingSolver::~CexCachingSolver() {
+  util::AccountMemory(util::SolverCacheMemory, -(int64_t) bytes);
   cache.clear();
   delete solver;
+  for (unsigned i = 0; i < batches.size(); i++)
+    delete batches[i];
   for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
          ie = assignmentsTable.end(); it != ie; ++it)
     delete *it;
@@ -12,6 +12,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include <string>
+#include <vector>
 
 #ifdef ENABLE_METASMT
 
@@ -89,6 +90,29 @@ Solver *createCoreSolver(CoreSolverType cst) {
     llvm::errs() << "Not compiled with Z3 support\n";
     return NULL;
 #endif
+  case PORTFOLIO_SOLVER: {
+    std::vector<Solver *> solvers;
+    std::vector<std::string> names;
+#ifdef ENABLE_STP
+    solvers.push_back(
+        new STPSolver(UseForkedCoreSolver, CoreSolverOptimizeDivides));
+    names.push_back("STP");
+#endif
+#ifdef ENABLE_Z3
+    solvers.push_back(new Z3Solver());
+    names.push_back("Z3");
+#endif
+    if (solvers.size() < 2) {
+      llvm::errs() << "Portfolio needs both STP and Z3 support\n";
+      while (!solvers.empty()) {
+        delete solvers.back();
+        solvers.pop_back();
+      }
+      return NULL;
+    }
+    llvm::errs() << "Using portfolio solver backend (STP, Z3)\n";
+    return createPortfolioSolver(solvers, names);
+  }
   case NO_SOLVER:
     llvm::errs() << "Invalid solver\n";
     return NULL;
@@ -291,32 +291,45 @@ inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
   return os;
 }
 
-// XXX waste of space, rather have ByteValueRange
 typedef ValueRange CexValueData;
 
+/// CexByteRange - The range of a byte of an object, stored in two bytes
+/// rather than the 16 of a ValueRange, so the contents of large objects stay
+/// compact. Starts out as the full range.
+class CexByteRange {
+  uint8_t m_min, m_max;
+
+public:
+  CexByteRange() : m_min(0), m_max(255) {}
+  CexByteRange(const CexValueData &range)
+    : m_min(range.min()), m_max(range.max()) {
+    assert(range.min() <= 255 && range.max() <= 255 &&
+           "byte range out of bounds");
+  }
+
+  operator CexValueData() const { return CexValueData(m_min, m_max); }
+
+  unsigned char getMidpoint() const { return m_min + (m_max - m_min) / 2; }
+};
+
 class CexObjectData {
   /// possibleContents - An array of "possible" values for the object.
   ///
   /// The possible values is an inexact approximation for the set of values for
   /// each array location.
-  std::vector<CexValueData> possibleContents;
+  std::vector<CexByteRange> possibleContents;
 
   /// exactContents - An array of exact values for the object.
   ///
   /// The exact values are a conservative approximation for the set of values
   /// for each array location.
-  std::vector<CexValueData> exactContents;
+  std::vector<CexByteRange> exactContents;
 
   CexObjectData(const CexObjectData&); // DO NOT IMPLEMENT
   void operator=(const CexObjectData&); // DO NOT IMPLEMENT
 
 public:
-  CexObjectData(uint64_t size) : possibleContents(size), exactContents(size) {
-    for (uint64_t i = 0; i != size; ++i) {
-      possibleContents[i] = ValueRange(0, 255);
-      exactContents[i] = ValueRange(0, 255);
-    }
-  }
+  CexObjectData(uint64_t size) : possibleContents(size), exactContents(size) {}
 
   const CexValueData getPossibleValues(size_t index) const { 
     return possibleContents[index];
@@ -325,7 +338,7 @@ public:
     possibleContents[index] = values;
   }
   void setPossibleValue(size_t index, unsigned char value) {
-    possibleContents[index] = CexValueData(value);
+    possibleContents[index] = CexValueData(value, value);
   }
 
   const CexValueData getExactValues(size_t index) const { 
@@ -337,8 +350,7 @@ public:
 
   /// getPossibleValue - Return some possible value.
   unsigned char getPossibleValue(size_t index) const {
-    const CexValueData &cvd = possibleContents[index];
-    return cvd.min() + (cvd.max() - cvd.min()) / 2;
+    return possibleContents[index].getMidpoint();
   }
 };
 
@@ -1105,24 +1117,23 @@ FastCexSolver::computeInitialValues(const Query& query,
     return true;
 
   // Propogation found a satisfying assignment, compute the initial values.
+  // These are the values the possible evaluator reads, taken directly from
+  // the object data rather than through a read expression per byte.
   for (unsigned i = 0; i != objects.size(); ++i) {
     const Array *array = objects[i];
     assert(array);
     std::vector<unsigned char> data;
     data.reserve(array->size);
 
+    std::map<const Array*, CexObjectData*>::iterator it =
+      cd.objects.find(array);
     for (unsigned i=0; i < array->size; i++) {
-      ref<Expr> read = 
-        ReadExpr::create(UpdateList(array, 0),
-                         ConstantExpr::create(i, array->getDomain()));
-      ref<Expr> value = cd.evaluatePossible(read);
-      
-      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
-        data.push_back((unsigned char) CE->getZExtValue(8));
-      } else {
-        // FIXME: When does this happen?
-        return false;
-      }
+      if (array->isConstantArray())
+        data.push_back(array->constantValues[i]->getZExtValue(8));
+      else if (it == cd.objects.end())
+        data.push_back(127);
+      else
+        data.push_back(it->second->getPossibleValue(i));
     }
 
     values.push_back(data);
@@ -10,15 +10,24 @@
 #define DEBUG_TYPE "independent-solver"
 #include "klee/Solver.h"
 
+#include "klee/CommandLine.h"
 #include "klee/Expr.h"
 #include "klee/Constraints.h"
 #include "klee/SolverImpl.h"
 #include "klee/Internal/Support/Debug.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/ConstraintPartition.h"
 
 #include "klee/util/ExprUtil.h"
 #include "klee/util/Assignment.h"
 
+#include "llvm/Support/Errno.h"
 #include "llvm/Support/raw_ostream.h"
+#include <errno.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <ostream>
@@ -259,96 +268,53 @@ inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
 // Breaks down a constraint into all of it's individual pieces, returning a
 // list of IndependentElementSets or the independent factors.
 //
+// The sets of the constraints come from the partition kept by their
+// ConstraintManager; the negated query expression joins the sets it
+// depends on.
+//
 // Caller takes ownership of returned std::list.
 static std::list<IndependentElementSet>*
 getAllIndependentConstraintsSets(const Query &query) {
   std::list<IndependentElementSet> *factors = new std::list<IndependentElementSet>();
+  const ConstraintPartition &partition = query.constraints.getPartition();
+  std::vector<unsigned> dependent;
   ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr);
   if (CE) {
     assert(CE && CE->isFalse() && "the expr should always be false and "
                                   "therefore not included in factors");
   } else {
     ref<Expr> neg = Expr::createIsZero(query.expr);
-    factors->push_back(IndependentElementSet(neg));
+    IndependentElementSet factor(neg);
+    partition.getDependent(neg, dependent);
+    for (unsigned i = 0; i < dependent.size(); i++)
+      factor.add(IndependentElementSet(query.constraints[dependent[i]]));
+    factors->push_back(factor);
   }
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
-    // iterate through all the previously separated constraints.  Until we
-    // actually return, factors is treated as a queue of expressions to be
-    // evaluated.  If the queue property isn't maintained, then the exprs
-    // could be returned in an order different from how they came it, negatively
-    // affecting later stages.
-    factors->push_back(IndependentElementSet(*it));
+  // The constraints of a factor keep the order in which they came in, or
+  // later stages could be affected.
+  std::vector< std::vector<unsigned> > sets;
+  partition.getSets(sets);
+  for (unsigned i = 0; i < sets.size(); i++) {
+    // a set is either part of the query's factor or independent of it
+    if (std::binary_search(dependent.begin(), dependent.end(), sets[i][0]))
+      continue;
+    IndependentElementSet factor(query.constraints[sets[i][0]]);
+    for (unsigned j = 1; j < sets[i].size(); j++)
+      factor.add(IndependentElementSet(query.constraints[sets[i][j]]));
+    factors->push_back(factor);
   }
 
-  bool doneLoop = false;
-  do {
-    doneLoop = true;
-    std::list<IndependentElementSet> *done =
-        new std::list<IndependentElementSet>;
-    while (factors->size() > 0) {
-      IndependentElementSet current = factors->front();
-      factors->pop_front();
-      // This list represents the set of factors that are separate from current.
-      // Those that are not inserted into this list (queue) intersect with
-      // current.
-      std::list<IndependentElementSet> *keep =
-          new std::list<IndependentElementSet>;
-      while (factors->size() > 0) {
-        IndependentElementSet compare = factors->front();
-        factors->pop_front();
-        if (current.intersects(compare)) {
-          if (current.add(compare)) {
-            // Means that we have added (z=y)added to (x=y)
-            // Now need to see if there are any (z=?)'s
-            doneLoop = false;
-          }
-        } else {
-          keep->push_back(compare);
-        }
-      }
-      done->push_back(current);
-      delete factors;
-      factors = keep;
-    }
-    delete factors;
-    factors = done;
-  } while (!doneLoop);
-
   return factors;
 }
 
 static 
-IndependentElementSet getIndependentConstraints(const Query& query,
-                                                std::vector< ref<Expr> > &result) {
-  IndependentElementSet eltsClosure(query.expr);
-  std::vector< std::pair<ref<Expr>, IndependentElementSet> > worklist;
-
-  for (ConstraintManager::const_iterator it = query.constraints.begin(), 
-         ie = query.constraints.end(); it != ie; ++it)
-    worklist.push_back(std::make_pair(*it, IndependentElementSet(*it)));
-
-  // XXX This should be more efficient (in terms of low level copy stuff).
-  bool done = false;
-  do {
-    done = true;
-    std::vector< std::pair<ref<Expr>, IndependentElementSet> > newWorklist;
-    for (std::vector< std::pair<ref<Expr>, IndependentElementSet> >::iterator
-           it = worklist.begin(), ie = worklist.end(); it != ie; ++it) {
-      if (it->second.intersects(eltsClosure)) {
-        if (eltsClosure.add(it->second))
-          done = false;
-        result.push_back(it->first);
-        // Means that we have added (z=y)added to (x=y)
-        // Now need to see if there are any (z=?)'s
-      } else {
-        newWorklist.push_back(*it);
-      }
-    }
-    worklist.swap(newWorklist);
-  } while (!done);
+void getIndependentConstraints(const Query& query,
+                               std::vector< ref<Expr> > &result) {
+  std::vector<unsigned> dependent;
+  query.constraints.getPartition().getDependent(query.expr, dependent);
+  for (unsigned i = 0; i < dependent.size(); i++)
+    result.push_back(query.constraints[dependent[i]]);
 
   KLEE_DEBUG(
     std::set< ref<Expr> > reqset(result.begin(), result.end());
@@ -362,13 +328,36 @@ IndependentElementSet getIndependentConstraints(const Query& query,
       errs() << " " << (reqset.count(*it) ? "(required)" : "(independent)") << "\n";
       errs() << "\telts: " << IndependentElementSet(*it) << "\n";
     }
-    errs() << "elts closure: " << eltsClosure << "\n";
  );
+}
 
 
-  return eltsClosure;
+static bool writeAll(int fd, const unsigned char *p, size_t size) {
+  while (size) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
 }
 
+/// \return the number of bytes read before end of file or an error
+static size_t readAll(int fd, unsigned char *p, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = read(fd, p + done, size - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  return done;
+}
 
 // Extracts which arrays are referenced from a particular independent set.  Examines both
 // the actual known array accesses arr[1] plus the undetermined accesses arr[x].
@@ -390,10 +379,27 @@ void calculateArrayReferences(const IndependentElementSet & ie,
   }
 }
 
+/// the answer of the solver for one factor
+struct FactorResult {
+  bool success, hasSolution;
+  std::vector<std::vector<unsigned char> > values;
+
+  FactorResult() : success(false), hasSolution(false) {}
+};
+
 class IndependentSolver : public SolverImpl {
 private:
   Solver *solver;
 
+  /// \return true if the factor has a solution
+  bool solveFactor(const IndependentElementSet &factor,
+                   const std::vector<const Array *> &arrays,
+                   FactorResult &result);
+  /// solve the factors in --independent-solver-jobs processes
+  void solveFactorsForked(const std::vector<IndependentElementSet *> &factors,
+                          const std::vector<std::vector<const Array *> > &arrays,
+                          std::vector<FactorResult> &results);
+
 public:
   IndependentSolver(Solver *_solver) 
     : solver(_solver) {}
@@ -414,8 +420,7 @@ public:
 bool IndependentSolver::computeValidity(const Query& query,
                                         Solver::Validity &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure =
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValidity(Query(tmp, query.expr), 
                                        result);
@@ -423,8 +428,7 @@ bool IndependentSolver::computeValidity(const Query& query,
 
 bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeTruth(Query(tmp, query.expr), 
                                     isValid);
@@ -432,8 +436,7 @@ bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
 
 bool IndependentSolver::computeValue(const Query& query, ref<Expr> &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValue(Query(tmp, query.expr), result);
 }
@@ -472,6 +475,111 @@ bool assertCreatedPointEvaluatesToTrue(const Query &query,
   return cast<ConstantExpr>(q)->isTrue();
 }
 
+bool IndependentSolver::solveFactor(const IndependentElementSet &factor,
+                                    const std::vector<const Array *> &arrays,
+                                    FactorResult &result) {
+  ConstraintManager tmp(factor.exprs);
+  result.success = solver->impl->computeInitialValues(
+      Query(tmp, ConstantExpr::alloc(0, Expr::Bool)), arrays, result.values,
+      result.hasSolution);
+  return result.success && result.hasSolution;
+}
+
+/// The factors of job j are those of index j modulo the number of jobs. The
+/// parent solves the factors of job 0 through its own chain, so that its
+/// caches still learn them, and a forked child each of the others; a child
+/// writes a status and a solution byte per factor, then the solution.
+void IndependentSolver::solveFactorsForked(
+    const std::vector<IndependentElementSet *> &factors,
+    const std::vector<std::vector<const Array *> > &arrays,
+    std::vector<FactorResult> &results) {
+  unsigned jobs = std::min<size_t>(IndependentSolverJobs, factors.size());
+  std::vector<pid_t> pids(jobs, -1);
+  std::vector<int> fds(jobs, -1);
+  fflush(stdout);
+  fflush(stderr);
+  for (unsigned j = 1; j < jobs; j++) {
+    int pipefd[2];
+    if (pipe(pipefd) < 0) {
+      klee_warning("pipe failed (for independent solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      break;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for independent solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      close(pipefd[0]);
+      close(pipefd[1]);
+      break;
+    }
+
+    if (pid == 0) {
+      close(pipefd[0]);
+      for (unsigned k = 1; k < j; k++)
+        close(fds[k]);
+      std::vector<unsigned char> message;
+      for (unsigned i = j; i < factors.size(); i += jobs) {
+        FactorResult result;
+        bool solved = solveFactor(*factors[i], arrays[i], result);
+        message.push_back(result.success);
+        message.push_back(result.hasSolution);
+        for (unsigned k = 0; solved && k < result.values.size(); k++)
+          message.insert(message.end(), result.values[k].begin(),
+                         result.values[k].end());
+        if (!solved)
+          break;
+      }
+      writeAll(pipefd[1], &message[0], message.size());
+      _exit(0);
+    }
+
+    close(pipefd[1]);
+    pids[j] = pid;
+    fds[j] = pipefd[0];
+  }
+
+  for (unsigned j = 0; j < jobs; j++) {
+    if (pids[j] != -1)
+      continue;
+    // the parent's share, and that of the children which did not start
+    for (unsigned i = j; i < factors.size(); i += jobs)
+      if (!solveFactor(*factors[i], arrays[i], results[i]))
+        break;
+  }
+
+  for (unsigned j = 1; j < jobs; j++) {
+    if (pids[j] == -1)
+      continue;
+    for (unsigned i = j; i < factors.size(); i += jobs) {
+      unsigned char status[2];
+      if (readAll(fds[j], status, 2) != 2)
+        break;
+      results[i].success = status[0];
+      results[i].hasSolution = status[1];
+      if (!status[0] || !status[1])
+        break;
+      results[i].values.resize(arrays[i].size());
+      for (unsigned k = 0; k < arrays[i].size(); k++) {
+        std::vector<unsigned char> &bytes = results[i].values[k];
+        bytes.resize(arrays[i][k]->size);
+        if (!bytes.empty() &&
+            readAll(fds[j], &bytes[0], bytes.size()) != bytes.size()) {
+          // a crashed child is a failed query
+          results[i].success = false;
+          break;
+        }
+      }
+      if (!results[i].success)
+        break;
+    }
+    close(fds[j]);
+    int status;
+    while (waitpid(pids[j], &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+}
+
 bool IndependentSolver::computeInitialValues(const Query& query,
                                              const std::vector<const Array*> &objects,
                                              std::vector< std::vector<unsigned char> > &values,
@@ -484,8 +592,8 @@ bool IndependentSolver::computeInitialValues(const Query& query,
   // to remember to manually call delete
   std::list<IndependentElementSet> *factors = getAllIndependentConstraintsSets(query);
 
-  //Used to rearrange all of the answers into the correct order
-  std::map<const Array*, std::vector<unsigned char> > retMap;
+  std::vector<IndependentElementSet *> solved;
+  std::vector<std::vector<const Array *> > arrays;
   for (std::list<IndependentElementSet>::iterator it = factors->begin();
        it != factors->end(); ++it) {
     std::vector<const Array*> arraysInFactor;
@@ -495,14 +603,30 @@ bool IndependentSolver::computeInitialValues(const Query& query,
     if (arraysInFactor.size() == 0){
       continue;
     }
-    ConstraintManager tmp(it->exprs);
-    std::vector<std::vector<unsigned char> > tempValues;
-    if (!solver->impl->computeInitialValues(Query(tmp, ConstantExpr::alloc(0, Expr::Bool)),
-                                            arraysInFactor, tempValues, hasSolution)){
+    solved.push_back(&*it);
+    arrays.push_back(arraysInFactor);
+  }
+
+  // a factor which is not solved stays failed
+  std::vector<FactorResult> results(solved.size());
+  if (IndependentSolverJobs > 1 && solved.size() > 1)
+    solveFactorsForked(solved, arrays, results);
+  else
+    for (unsigned i = 0; i < solved.size(); i++)
+      if (!solveFactor(*solved[i], arrays[i], results[i]))
+        break;
+
+  //Used to rearrange all of the answers into the correct order
+  std::map<const Array*, std::vector<unsigned char> > retMap;
+  for (unsigned f = 0; f < solved.size(); f++) {
+    const std::vector<const Array *> &arraysInFactor = arrays[f];
+    std::vector<std::vector<unsigned char> > &tempValues = results[f].values;
+    if (!results[f].success){
       values.clear();
       delete factors;
       return false;
-    } else if (!hasSolution){
+    } else if (!results[f].hasSolution){
+      hasSolution = false;
       values.clear();
       delete factors;
       return true;
@@ -517,7 +641,7 @@ bool IndependentSolver::computeInitialValues(const Query& query,
           std::vector<unsigned char> * tempPtr = &retMap[arraysInFactor[i]];
           assert(tempPtr->size() == tempValues[i].size() &&
                  "we're talking about the same array here");
-          ::DenseSet<unsigned> * ds = &(it->elements[arraysInFactor[i]]);
+          ::DenseSet<unsigned> * ds = &(solved[f]->elements[arraysInFactor[i]]);
           for (std::set<unsigned>::iterator it2 = ds->begin(); it2 != ds->end(); it2++){
             unsigned index = * it2;
             (* tempPtr)[index] = tempValues[i][index];
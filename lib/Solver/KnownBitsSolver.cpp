@@ -0,0 +1,727 @@
+//===-- KnownBitsSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/IncompleteSolver.h"
+#include "klee/SolverStats.h"
+
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+using namespace klee;
+
+namespace {
+
+static uint64_t getMask(Expr::Width width) {
+  return width >= 64 ? ~0ULL : (1ULL << width) - 1;
+}
+
+static int64_t signExtend(uint64_t value, Expr::Width width) {
+  return width >= 64 ? (int64_t) value :
+      (int64_t) (value << (64 - width)) >> (64 - width);
+}
+
+/// AbstractValue - The values of an expression of up to 64 bits which may
+/// still be possible: those in [lo, hi] whose bits agree with the bits
+/// known to be zero and to be one.
+struct AbstractValue {
+  Expr::Width width;
+  uint64_t zeros, ones;
+  uint64_t lo, hi;
+  /// no value is possible
+  bool empty;
+
+  AbstractValue() : width(0), zeros(0), ones(0), lo(0), hi(0), empty(false) {}
+
+  static AbstractValue top(Expr::Width w) {
+    AbstractValue v;
+    v.width = w;
+    v.hi = getMask(w);
+    return v;
+  }
+  static AbstractValue constant(Expr::Width w, uint64_t c) {
+    return range(w, c, c);
+  }
+  static AbstractValue range(Expr::Width w, uint64_t lo, uint64_t hi) {
+    AbstractValue v = top(w);
+    v.lo = lo;
+    v.hi = hi;
+    v.normalize();
+    return v;
+  }
+  static AbstractValue bits(Expr::Width w, uint64_t zeros, uint64_t ones) {
+    AbstractValue v = top(w);
+    v.zeros = zeros & getMask(w);
+    v.ones = ones & getMask(w);
+    v.normalize();
+    return v;
+  }
+
+  bool isConstant() const { return !empty && lo == hi; }
+  uint64_t mask() const { return getMask(width); }
+  bool signKnown() const { return ((zeros | ones) >> (width - 1)) & 1; }
+
+  /// Tighten the interval and the bits by each other.
+  void normalize() {
+    uint64_t m = mask();
+    if (ones & zeros) {
+      empty = true;
+      return;
+    }
+    lo = std::max(lo, ones);
+    hi = std::min(hi, ~zeros & m);
+    if (lo > hi) {
+      empty = true;
+      return;
+    }
+    // the leading bits lo and hi share are those of every value between
+    uint64_t diff = lo ^ hi;
+    uint64_t prefix = diff ? ~getMask(64 - llvm::countLeadingZeros(diff)) & m
+                           : m;
+    ones |= lo & prefix;
+    zeros |= ~lo & prefix;
+    if (ones & zeros)
+      empty = true;
+  }
+
+  /// The values possible in both.
+  void meet(const AbstractValue &v) {
+    zeros |= v.zeros;
+    ones |= v.ones;
+    lo = std::max(lo, v.lo);
+    hi = std::min(hi, v.hi);
+    empty |= v.empty;
+    if (!empty)
+      normalize();
+  }
+
+  /// The values possible in either.
+  void join(const AbstractValue &v) {
+    if (v.empty)
+      return;
+    if (empty) {
+      *this = v;
+      return;
+    }
+    zeros &= v.zeros;
+    ones &= v.ones;
+    lo = std::min(lo, v.lo);
+    hi = std::max(hi, v.hi);
+  }
+
+  /// The signed interval, the whole signed range if the values straddle
+  /// the sign.
+  void getSignedRange(int64_t &slo, int64_t &shi) const {
+    if ((lo >> (width - 1)) == (hi >> (width - 1))) {
+      slo = signExtend(lo, width);
+      shi = signExtend(hi, width);
+    } else {
+      slo = signExtend(1ULL << (width - 1), width);
+      shi = (int64_t) (getMask(width) >> 1);
+    }
+  }
+};
+
+/// KnownBitsSolver - An incomplete solver which evaluates the query over
+/// known bits and unsigned intervals, after narrowing the values of the
+/// subexpressions the constraints bound (masks, comparisons and equalities
+/// with constants).
+///
+/// It only answers when the query is the same under every value left, so
+/// it never guesses; like the rest of the solver chain it takes the
+/// constraints to be satisfiable.
+class KnownBitsSolver : public IncompleteSolver {
+  /// the values the constraints leave to the subexpressions they bound
+  std::map<ref<Expr>, AbstractValue> bounds;
+  std::unordered_map<const Expr*, AbstractValue> values;
+  /// the constraints cannot all hold
+  bool contradiction;
+
+  void bound(const ref<Expr> &e, const AbstractValue &v, unsigned depth);
+  void boundBool(const ref<Expr> &e, bool truth, unsigned depth);
+  void boundSigned(const ref<Expr> &e, int64_t slo, int64_t shi,
+                   unsigned depth);
+  AbstractValue evaluate(const ref<Expr> &e);
+  AbstractValue evaluateRead(const ReadExpr &re);
+  AbstractValue evaluateNode(const ref<Expr> &e);
+
+  /// the value of the expression of the query under its constraints
+  bool evaluateQuery(const Query &query, AbstractValue &result);
+
+public:
+  KnownBitsSolver() : contradiction(false) {}
+
+  IncompleteSolver::PartialValidity computeTruth(const Query &query);
+  IncompleteSolver::PartialValidity computeValidity(const Query &query);
+  bool computeValue(const Query &query, ref<Expr> &result);
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    return false;
+  }
+};
+
+}
+
+/***/
+
+/// the bounds are pushed this deep into an expression at most
+static const unsigned MaxBoundDepth = 32;
+
+void KnownBitsSolver::bound(const ref<Expr> &e, const AbstractValue &v,
+                            unsigned depth) {
+  if (contradiction || depth > MaxBoundDepth || e->getWidth() > 64)
+    return;
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+    AbstractValue c = AbstractValue::constant(v.width, CE->getZExtValue());
+    c.meet(v);
+    if (c.empty)
+      contradiction = true;
+    return;
+  }
+
+  AbstractValue &r =
+    bounds.insert(std::make_pair(e, AbstractValue::top(v.width))).first->second;
+  AbstractValue before = r;
+  r.meet(v);
+  if (r.empty) {
+    contradiction = true;
+    return;
+  }
+  if (r.zeros == before.zeros && r.ones == before.ones && r.lo == before.lo &&
+      r.hi == before.hi)
+    return;
+  AbstractValue b = r;
+
+  if (b.width == Expr::Bool && b.isConstant()) {
+    boundBool(e, b.lo, depth);
+    return;
+  }
+
+  switch (e->getKind()) {
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    Expr::Width lw = ce->getLeft()->getWidth(), rw = ce->getRight()->getWidth();
+    AbstractValue left = AbstractValue::bits(lw, b.zeros >> rw, b.ones >> rw);
+    left.meet(AbstractValue::range(lw, b.lo >> rw, b.hi >> rw));
+    bound(ce->getLeft(), left, depth + 1);
+    AbstractValue right = AbstractValue::bits(rw, b.zeros, b.ones);
+    if ((b.lo >> rw) == (b.hi >> rw))
+      right.meet(AbstractValue::range(rw, b.lo & getMask(rw),
+                                      b.hi & getMask(rw)));
+    bound(ce->getRight(), right, depth + 1);
+    break;
+  }
+
+  case Expr::ZExt: {
+    const ref<Expr> &kid = e->getKid(0);
+    uint64_t km = getMask(kid->getWidth());
+    if (b.lo > km) {
+      contradiction = true;
+      return;
+    }
+    AbstractValue k = AbstractValue::bits(kid->getWidth(), b.zeros, b.ones);
+    k.meet(AbstractValue::range(kid->getWidth(), b.lo, std::min(b.hi, km)));
+    bound(kid, k, depth + 1);
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    Expr::Width kw = ee->expr->getWidth();
+    if (kw > 64)
+      break;
+    bound(ee->expr, AbstractValue::bits(kw, b.zeros << ee->offset,
+                                        b.ones << ee->offset), depth + 1);
+    break;
+  }
+
+  case Expr::Not:
+    bound(e->getKid(0), AbstractValue::range(b.width, ~b.hi & b.mask(),
+                                             ~b.lo & b.mask()), depth + 1);
+    bound(e->getKid(0), AbstractValue::bits(b.width, b.ones, b.zeros),
+          depth + 1);
+    break;
+
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor:
+  case Expr::Add: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    for (unsigned i = 0; i < 2; i++) {
+      const ref<Expr> &kid = i ? be->right : be->left;
+      const ref<Expr> &other = i ? be->left : be->right;
+      ConstantExpr *CE = dyn_cast<ConstantExpr>(other);
+      uint64_t k = CE ? CE->getZExtValue() : 0;
+      if (e->getKind() == Expr::And) {
+        // a one needs ones on both sides, a zero against a one is a zero
+        uint64_t zeros = CE ? b.zeros & k : 0;
+        bound(kid, AbstractValue::bits(b.width, zeros, b.ones), depth + 1);
+      } else if (e->getKind() == Expr::Or) {
+        uint64_t ones = CE ? b.ones & ~k : 0;
+        bound(kid, AbstractValue::bits(b.width, b.zeros, ones), depth + 1);
+      } else if (!CE) {
+        continue;
+      } else if (e->getKind() == Expr::Xor) {
+        bound(kid, AbstractValue::bits(b.width, (b.zeros & ~k) | (b.ones & k),
+                                       (b.ones & ~k) | (b.zeros & k)),
+              depth + 1);
+      } else if (b.isConstant()) {
+        bound(kid, AbstractValue::constant(b.width, (b.lo - k) & b.mask()),
+              depth + 1);
+      } else if (b.lo >= k) {
+        // kid + k cannot wrap around to reach [lo, hi]
+        bound(kid, AbstractValue::range(b.width, b.lo - k, b.hi - k),
+              depth + 1);
+      }
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+void KnownBitsSolver::boundSigned(const ref<Expr> &e, int64_t slo,
+                                  int64_t shi, unsigned depth) {
+  Expr::Width w = e->getWidth();
+  if (slo > shi) {
+    contradiction = true;
+    return;
+  }
+  // only the ranges on one side of the sign are unsigned intervals
+  if (shi < 0 || slo >= 0)
+    bound(e, AbstractValue::range(w, (uint64_t) slo & getMask(w),
+                                  (uint64_t) shi & getMask(w)), depth);
+}
+
+void KnownBitsSolver::boundBool(const ref<Expr> &e, bool truth,
+                                unsigned depth) {
+  switch (e->getKind()) {
+  case Expr::And:
+  case Expr::Or:
+    // a true And or a false Or holds the same on both sides
+    if (truth == (e->getKind() == Expr::And)) {
+      bound(e->getKid(0), AbstractValue::constant(Expr::Bool, truth),
+            depth + 1);
+      bound(e->getKid(1), AbstractValue::constant(Expr::Bool, truth),
+            depth + 1);
+    }
+    return;
+
+  case Expr::Not:
+    bound(e->getKid(0), AbstractValue::constant(Expr::Bool, !truth),
+          depth + 1);
+    return;
+
+  case Expr::Eq:
+  case Expr::Ne: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ConstantExpr *CE = dyn_cast<ConstantExpr>(be->left);
+    const ref<Expr> *kid = &be->right;
+    if (!CE) {
+      CE = dyn_cast<ConstantExpr>(be->right);
+      kid = &be->left;
+    }
+    if (!CE || (*kid)->getWidth() > 64)
+      return;
+    if (e->getKind() == Expr::Ne)
+      truth = !truth;
+    uint64_t c = CE->getZExtValue();
+    Expr::Width w = (*kid)->getWidth();
+    if (truth) {
+      bound(*kid, AbstractValue::constant(w, c), depth + 1);
+    } else if (w == Expr::Bool) {
+      bound(*kid, AbstractValue::constant(w, !c), depth + 1);
+    } else {
+      // a value ruled out at an end of the interval moves that end
+      AbstractValue v = evaluate(*kid);
+      if (v.lo == c && c < v.mask())
+        bound(*kid, AbstractValue::range(w, c + 1, v.mask()), depth + 1);
+      else if (v.hi == c && c > 0)
+        bound(*kid, AbstractValue::range(w, 0, c - 1), depth + 1);
+    }
+    return;
+  }
+
+  case Expr::Ult:
+  case Expr::Ule:
+  case Expr::Ugt:
+  case Expr::Uge:
+  case Expr::Slt:
+  case Expr::Sle:
+  case Expr::Sgt:
+  case Expr::Sge: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    Expr::Kind kind = e->getKind();
+    ref<Expr> left = be->left, right = be->right;
+    // as left < right or left <= right
+    if (kind == Expr::Ugt || kind == Expr::Uge || kind == Expr::Sgt ||
+        kind == Expr::Sge) {
+      std::swap(left, right);
+      kind = kind == Expr::Ugt ? Expr::Ult : kind == Expr::Uge ? Expr::Ule :
+             kind == Expr::Sgt ? Expr::Slt : Expr::Sle;
+    }
+    // a false comparison is the opposite one, the sides swapped
+    if (!truth) {
+      std::swap(left, right);
+      kind = kind == Expr::Ult ? Expr::Ule : kind == Expr::Ule ? Expr::Ult :
+             kind == Expr::Slt ? Expr::Sle : Expr::Slt;
+    }
+    Expr::Width w = left->getWidth();
+    if (w > 64)
+      return;
+    bool strict = kind == Expr::Ult || kind == Expr::Slt;
+    uint64_t m = getMask(w);
+
+    if (kind == Expr::Ult || kind == Expr::Ule) {
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(right)) {
+        uint64_t c = CE->getZExtValue();
+        if (strict && c == 0)
+          contradiction = true;
+        else
+          bound(left, AbstractValue::range(w, 0, c - strict), depth + 1);
+      } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(left)) {
+        uint64_t c = CE->getZExtValue();
+        if (strict && c == m)
+          contradiction = true;
+        else
+          bound(right, AbstractValue::range(w, c + strict, m), depth + 1);
+      }
+    } else {
+      int64_t smin = signExtend(1ULL << (w - 1), w), smax = (int64_t) (m >> 1);
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(right)) {
+        int64_t c = signExtend(CE->getZExtValue(), w);
+        if (strict && c == smin)
+          contradiction = true;
+        else
+          boundSigned(left, smin, c - strict, depth + 1);
+      } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(left)) {
+        int64_t c = signExtend(CE->getZExtValue(), w);
+        if (strict && c == smax)
+          contradiction = true;
+        else
+          boundSigned(right, c + strict, smax, depth + 1);
+      }
+    }
+    return;
+  }
+
+  default:
+    return;
+  }
+}
+
+/***/
+
+AbstractValue KnownBitsSolver::evaluate(const ref<Expr> &e) {
+  std::unordered_map<const Expr*, AbstractValue>::iterator it =
+    values.find(e.get());
+  if (it != values.end())
+    return it->second;
+
+  AbstractValue v = evaluateNode(e);
+  std::map<ref<Expr>, AbstractValue>::iterator b = bounds.find(e);
+  if (b != bounds.end())
+    v.meet(b->second);
+  if (v.empty)
+    contradiction = true;
+  values[e.get()] = v;
+  return v;
+}
+
+AbstractValue KnownBitsSolver::evaluateRead(const ReadExpr &re) {
+  AbstractValue index = evaluate(re.index);
+  const Array *root = re.updates.root;
+  const UpdateNode *un = re.updates.head;
+  if (index.isConstant()) {
+    // the updates at other constant indices do not matter
+    for (; un; un = un->next) {
+      ConstantExpr *CE = dyn_cast<ConstantExpr>(un->index);
+      if (!CE)
+        break;
+      if (CE->getZExtValue() == index.lo)
+        return evaluate(un->value);
+    }
+  }
+  if (un || !root->isConstantArray())
+    return AbstractValue::top(re.getWidth());
+
+  // a read of a constant array is one of the values in the range read
+  if (index.hi >= root->size || index.hi - index.lo >= 256)
+    return AbstractValue::top(re.getWidth());
+  AbstractValue v;
+  v.empty = true;
+  for (uint64_t i = index.lo; i <= index.hi; i++)
+    v.join(AbstractValue::constant(re.getWidth(),
+                                   root->constantValues[i]->getZExtValue()));
+  return v;
+}
+
+AbstractValue KnownBitsSolver::evaluateNode(const ref<Expr> &e) {
+  Expr::Width w = e->getWidth();
+  if (w > 64)
+    return AbstractValue::top(64);
+  uint64_t m = getMask(w);
+
+  switch (e->getKind()) {
+  case Expr::Constant:
+    return AbstractValue::constant(w, cast<ConstantExpr>(e)->getZExtValue());
+
+  case Expr::NotOptimized:
+    return evaluate(cast<NotOptimizedExpr>(e)->src);
+
+  case Expr::Read:
+    return evaluateRead(*cast<ReadExpr>(e));
+
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    AbstractValue c = evaluate(se->cond);
+    if (c.isConstant())
+      return evaluate(c.lo ? se->trueExpr : se->falseExpr);
+    AbstractValue v = evaluate(se->trueExpr);
+    v.join(evaluate(se->falseExpr));
+    return v;
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    if (ce->getLeft()->getWidth() > 64 || ce->getRight()->getWidth() > 64)
+      return AbstractValue::top(w);
+    AbstractValue l = evaluate(ce->getLeft()), r = evaluate(ce->getRight());
+    unsigned rw = ce->getRight()->getWidth();
+    AbstractValue v = AbstractValue::bits(w, (l.zeros << rw) | r.zeros,
+                                          (l.ones << rw) | r.ones);
+    v.meet(AbstractValue::range(w, (l.lo << rw) | r.lo, (l.hi << rw) | r.hi));
+    return v;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (ee->expr->getWidth() > 64)
+      return AbstractValue::top(w);
+    AbstractValue k = evaluate(ee->expr);
+    unsigned off = ee->offset;
+    AbstractValue v = AbstractValue::bits(w, k.zeros >> off, k.ones >> off);
+    if ((k.hi >> off) <= m)
+      v.meet(AbstractValue::range(w, k.lo >> off, k.hi >> off));
+    return v;
+  }
+
+  case Expr::ZExt: {
+    AbstractValue k = evaluate(e->getKid(0));
+    AbstractValue v = AbstractValue::bits(w, k.zeros | (m & ~k.mask()),
+                                          k.ones);
+    v.meet(AbstractValue::range(w, k.lo, k.hi));
+    return v;
+  }
+
+  case Expr::SExt: {
+    AbstractValue k = evaluate(e->getKid(0));
+    // the bits of a known sign extend it
+    AbstractValue v = AbstractValue::bits(w, signExtend(k.zeros, k.width),
+                                          signExtend(k.ones, k.width));
+    if (k.signKnown())
+      v.meet(AbstractValue::range(w, signExtend(k.lo, k.width) & m,
+                                  signExtend(k.hi, k.width) & m));
+    return v;
+  }
+
+  case Expr::Not: {
+    AbstractValue k = evaluate(e->getKid(0));
+    AbstractValue v = AbstractValue::bits(w, k.ones, k.zeros);
+    v.meet(AbstractValue::range(w, ~k.hi & m, ~k.lo & m));
+    return v;
+  }
+
+  default:
+    break;
+  }
+
+  const BinaryExpr *be = dyn_cast<BinaryExpr>(e);
+  if (!be || be->left->getWidth() > 64)
+    return AbstractValue::top(w);
+  AbstractValue a = evaluate(be->left), b = evaluate(be->right);
+  Expr::Width kw = a.width;
+  uint64_t km = a.mask();
+  AbstractValue v = AbstractValue::top(w);
+
+  switch (e->getKind()) {
+  case Expr::And:
+    v = AbstractValue::bits(w, a.zeros | b.zeros, a.ones & b.ones);
+    v.meet(AbstractValue::range(w, 0, std::min(a.hi, b.hi)));
+    return v;
+  case Expr::Or:
+    v = AbstractValue::bits(w, a.zeros & b.zeros, a.ones | b.ones);
+    v.meet(AbstractValue::range(w, std::max(a.lo, b.lo), m));
+    return v;
+  case Expr::Xor:
+    return AbstractValue::bits(w, (a.zeros & b.zeros) | (a.ones & b.ones),
+                               (a.zeros & b.ones) | (a.ones & b.zeros));
+
+  case Expr::Add:
+  case Expr::Sub: {
+    // the low bits known on both sides are known in the result
+    uint64_t known = (a.zeros | a.ones) & (b.zeros | b.ones);
+    uint64_t low = ~known ? getMask(llvm::countTrailingZeros(~known)) : ~0ULL;
+    uint64_t r = (e->getKind() == Expr::Add ? a.ones + b.ones
+                                            : a.ones - b.ones) & low & m;
+    v = AbstractValue::bits(w, ~r & low, r);
+    if (e->getKind() == Expr::Add && a.hi <= m - b.hi)
+      v.meet(AbstractValue::range(w, a.lo + b.lo, a.hi + b.hi));
+    else if (e->getKind() == Expr::Sub && a.lo >= b.hi)
+      v.meet(AbstractValue::range(w, a.lo - b.hi, a.hi - b.lo));
+    return v;
+  }
+
+  case Expr::Mul: {
+    // the trailing zeros add up
+    unsigned tz = llvm::countTrailingZeros(~a.zeros) +
+                  llvm::countTrailingZeros(~b.zeros);
+    v = AbstractValue::bits(w, getMask(std::min(tz, 64u)), 0);
+    if (!b.hi || a.hi <= m / b.hi)
+      v.meet(AbstractValue::range(w, a.lo * b.lo, a.hi * b.hi));
+    return v;
+  }
+
+  case Expr::UDiv:
+    if (b.lo)
+      v = AbstractValue::range(w, a.lo / b.hi, a.hi / b.lo);
+    return v;
+  case Expr::URem:
+    if (b.lo)
+      v = AbstractValue::range(w, 0, std::min(a.hi, b.hi - 1));
+    return v;
+
+  case Expr::Shl:
+  case Expr::LShr:
+  case Expr::AShr: {
+    if (!b.isConstant()) {
+      if (e->getKind() == Expr::LShr)
+        v = AbstractValue::range(w, 0, a.hi);
+      return v;
+    }
+    uint64_t s = b.lo;
+    if (s >= kw)
+      return e->getKind() == Expr::AShr ? v : AbstractValue::constant(w, 0);
+    if (e->getKind() == Expr::Shl) {
+      v = AbstractValue::bits(w, (a.zeros << s) | getMask(s), a.ones << s);
+      if (a.hi <= (m >> s))
+        v.meet(AbstractValue::range(w, a.lo << s, a.hi << s));
+    } else if (e->getKind() == Expr::LShr || (a.zeros >> (kw - 1)) & 1) {
+      v = AbstractValue::bits(w, (a.zeros >> s) | ~(m >> s), a.ones >> s);
+      v.meet(AbstractValue::range(w, a.lo >> s, a.hi >> s));
+    } else {
+      v = AbstractValue::bits(w, signExtend(a.zeros, kw) >> s,
+                              signExtend(a.ones, kw) >> s);
+    }
+    return v;
+  }
+
+  case Expr::Eq:
+  case Expr::Ne: {
+    bool ne = e->getKind() == Expr::Ne;
+    if (a.isConstant() && b.isConstant())
+      return AbstractValue::constant(w, (a.lo == b.lo) != ne);
+    if ((a.ones & b.zeros) || (a.zeros & b.ones) || a.hi < b.lo ||
+        b.hi < a.lo)
+      return AbstractValue::constant(w, ne);
+    return v;
+  }
+
+  case Expr::Ult:
+  case Expr::Ule:
+  case Expr::Ugt:
+  case Expr::Uge: {
+    if (e->getKind() == Expr::Ugt || e->getKind() == Expr::Uge)
+      std::swap(a, b);
+    bool strict = e->getKind() == Expr::Ult || e->getKind() == Expr::Ugt;
+    if (strict ? a.hi < b.lo : a.hi <= b.lo)
+      return AbstractValue::constant(w, 1);
+    if (strict ? a.lo >= b.hi : a.lo > b.hi)
+      return AbstractValue::constant(w, 0);
+    return v;
+  }
+
+  case Expr::Slt:
+  case Expr::Sle:
+  case Expr::Sgt:
+  case Expr::Sge: {
+    if (e->getKind() == Expr::Sgt || e->getKind() == Expr::Sge)
+      std::swap(a, b);
+    bool strict = e->getKind() == Expr::Slt || e->getKind() == Expr::Sgt;
+    int64_t alo, ahi, blo, bhi;
+    a.getSignedRange(alo, ahi);
+    b.getSignedRange(blo, bhi);
+    if (strict ? ahi < blo : ahi <= blo)
+      return AbstractValue::constant(w, 1);
+    if (strict ? alo >= bhi : alo > bhi)
+      return AbstractValue::constant(w, 0);
+    return v;
+  }
+
+  default:
+    return v;
+  }
+}
+
+/***/
+
+bool KnownBitsSolver::evaluateQuery(const Query &query,
+                                    AbstractValue &result) {
+  bounds.clear();
+  values.clear();
+  contradiction = false;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie && !contradiction; ++it)
+    bound(*it, AbstractValue::constant(Expr::Bool, 1), 0);
+  if (!contradiction)
+    result = evaluate(query.expr);
+  bool known = !contradiction && result.isConstant();
+  bounds.clear();
+  values.clear();
+  if (known)
+    ++stats::queryKnownBitsHits;
+  else
+    ++stats::queryKnownBitsMisses;
+  return known;
+}
+
+IncompleteSolver::PartialValidity
+KnownBitsSolver::computeTruth(const Query &query) {
+  AbstractValue v;
+  if (!evaluateQuery(query, v))
+    return IncompleteSolver::None;
+  return v.lo ? IncompleteSolver::MustBeTrue : IncompleteSolver::MustBeFalse;
+}
+
+IncompleteSolver::PartialValidity
+KnownBitsSolver::computeValidity(const Query &query) {
+  return computeTruth(query);
+}
+
+bool KnownBitsSolver::computeValue(const Query &query, ref<Expr> &result) {
+  AbstractValue v;
+  if (query.expr->getWidth() > 64 || !evaluateQuery(query, v))
+    return false;
+  result = ConstantExpr::create(v.lo, query.expr->getWidth());
+  return true;
+}
+
+Solver *klee::createKnownBitsSolver(Solver *s) {
+  return new Solver(new StagedSolverImpl(new KnownBitsSolver(), s));
+}
@@ -0,0 +1,385 @@
+//===-- PortfolioSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/CommandLine.h"
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <map>
+#include <set>
+
+using namespace klee;
+using namespace llvm;
+
+/***/
+
+namespace {
+
+/// what is known about the queries of one shape
+struct ShapeStats {
+  /// queries answered, and the time they took
+  unsigned runs;
+  double time;
+  /// races, and how many of them each solver won
+  unsigned races;
+  std::vector<unsigned> wins;
+
+  ShapeStats() : runs(0), time(0.), races(0) {}
+};
+
+/// the parts of a query which decide which solver is faster on it
+class ShapeVisitor {
+  std::set<const Expr *> visited;
+
+public:
+  bool nonLinear, symbolicIndex, updates;
+
+  ShapeVisitor() : nonLinear(false), symbolicIndex(false), updates(false) {}
+
+  void visit(const ref<Expr> &e) {
+    if (isa<ConstantExpr>(e) || !visited.insert(e.get()).second)
+      return;
+
+    switch (e->getKind()) {
+    case Expr::Mul:
+    case Expr::UDiv:
+    case Expr::SDiv:
+    case Expr::URem:
+    case Expr::SRem:
+      if (!isa<ConstantExpr>(e->getKid(0)) && !isa<ConstantExpr>(e->getKid(1)))
+        nonLinear = true;
+      break;
+    case Expr::Read: {
+      const ReadExpr *re = cast<ReadExpr>(e);
+      if (!isa<ConstantExpr>(re->index))
+        symbolicIndex = true;
+      if (re->updates.head)
+        updates = true;
+      break;
+    }
+    default:
+      break;
+    }
+
+    for (unsigned i = 0; i < e->getNumKids(); i++)
+      visit(e->getKid(i));
+  }
+};
+
+static unsigned log2Bucket(size_t n) {
+  unsigned bucket = 0;
+  while (n > 1 && bucket < 15) {
+    n >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+static uint64_t getShape(const Query &query,
+                         const std::vector<const Array *> &objects) {
+  ShapeVisitor visitor;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
+       it != ie; ++it)
+    visitor.visit(*it);
+  visitor.visit(query.expr);
+
+  uint64_t shape = visitor.nonLinear | (visitor.symbolicIndex << 1) |
+                   (visitor.updates << 2);
+  shape |= (uint64_t) log2Bucket(query.constraints.size()) << 8;
+  shape |= (uint64_t) log2Bucket(objects.size()) << 16;
+  shape |= (uint64_t) query.expr->getKind() << 24;
+  return shape;
+}
+
+static bool writeAll(int fd, const unsigned char *p, size_t size) {
+  while (size) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+/// \return the number of bytes read before end of file or an error
+static size_t readAll(int fd, unsigned char *p, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = read(fd, p + done, size - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  return done;
+}
+
+class PortfolioSolver : public SolverImpl {
+private:
+  std::vector<Solver *> solvers;
+  std::vector<std::string> names;
+  std::map<uint64_t, ShapeStats> shapes;
+  double timeout;
+  SolverRunStatus runStatusCode;
+
+  bool race(const Query &query, const std::vector<const Array *> &objects,
+            std::vector<std::vector<unsigned char> > &values,
+            bool &hasSolution, unsigned &winner);
+
+public:
+  PortfolioSolver(const std::vector<Solver *> &_solvers,
+                  const std::vector<std::string> &_names)
+      : solvers(_solvers), names(_names), timeout(0.),
+        runStatusCode(SOLVER_RUN_STATUS_FAILURE) {}
+  ~PortfolioSolver() {
+    for (unsigned i = 0; i < solvers.size(); i++)
+      delete solvers[i];
+  }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &query) {
+    return solvers[0]->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(double _timeout) {
+    timeout = _timeout;
+    for (unsigned i = 0; i < solvers.size(); i++)
+      solvers[i]->impl->setCoreSolverTimeout(_timeout);
+  }
+};
+}
+
+/// Run every solver in a forked process and take the first answer. The
+/// solvers build their formulas from the query, which is not safe to share
+/// between threads, so a child gets its own copy; the losers are killed.
+bool PortfolioSolver::race(const Query &query,
+                           const std::vector<const Array *> &objects,
+                           std::vector<std::vector<unsigned char> > &values,
+                           bool &hasSolution, unsigned &winner) {
+  /* a child writes its status, then the solution, if any */
+  size_t sum = 2;
+  for (unsigned i = 0; i < objects.size(); i++)
+    sum += objects[i]->size;
+
+  std::vector<pid_t> pids;
+  std::vector<struct pollfd> fds;
+  fflush(stdout);
+  fflush(stderr);
+  for (unsigned i = 0; i < solvers.size(); i++) {
+    int pipefd[2];
+    if (pipe(pipefd) < 0) {
+      klee_warning("pipe failed (for portfolio) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      break;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for portfolio) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      close(pipefd[0]);
+      close(pipefd[1]);
+      break;
+    }
+
+    if (pid == 0) {
+      close(pipefd[0]);
+      for (unsigned j = 0; j < fds.size(); j++)
+        close(fds[j].fd);
+      std::vector<unsigned char> message(1, 0);
+      std::vector<std::vector<unsigned char> > result;
+      bool solution;
+      if (solvers[i]->impl->computeInitialValues(query, objects, result,
+                                                  solution)) {
+        message[0] = 1;
+        message.push_back(solution);
+        for (unsigned j = 0; solution && j < result.size(); j++)
+          message.insert(message.end(), result[j].begin(), result[j].end());
+      }
+      writeAll(pipefd[1], &message[0], message.size());
+      _exit(0);
+    }
+
+    close(pipefd[1]);
+    pids.push_back(pid);
+    struct pollfd fd = { pipefd[0], POLLIN, 0 };
+    fds.push_back(fd);
+  }
+
+  bool found = false, timedOut = false;
+  std::vector<unsigned char> message(sum);
+  size_t pending = fds.size();
+  double start = util::getWallTime();
+  while (pending && !found) {
+    int ms = -1;
+    if (timeout) {
+      double left = timeout - (util::getWallTime() - start);
+      ms = left > 0 ? (int) (left * 1000) + 1 : 0;
+    }
+    int n = poll(&fds[0], fds.size(), ms);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      timedOut = n == 0;
+      break;
+    }
+
+    for (unsigned i = 0; i < fds.size() && !found; i++) {
+      if (fds[i].fd < 0 || !fds[i].revents)
+        continue;
+      size_t length = readAll(fds[i].fd, &message[0], sum);
+      close(fds[i].fd);
+      fds[i].fd = -1;
+      pending--;
+      /* a failed or crashed solver leaves the race to the others */
+      if (length < 2 || message[0] != 1 || length != (message[1] ? sum : 2))
+        continue;
+
+      found = true;
+      winner = i;
+      hasSolution = message[1];
+      values.clear();
+      if (hasSolution) {
+        const unsigned char *p = &message[2];
+        for (unsigned j = 0; j < objects.size(); j++) {
+          values.push_back(
+              std::vector<unsigned char>(p, p + objects[j]->size));
+          p += objects[j]->size;
+        }
+      }
+    }
+  }
+
+  for (unsigned i = 0; i < pids.size(); i++) {
+    if (fds[i].fd >= 0) {
+      kill(pids[i], SIGKILL);
+      close(fds[i].fd);
+    }
+    int status;
+    while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  if (found)
+    runStatusCode = hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                                : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  else if (pids.empty())
+    runStatusCode = SOLVER_RUN_STATUS_FORK_FAILED;
+  else
+    runStatusCode =
+        timedOut ? SOLVER_RUN_STATUS_TIMEOUT : SOLVER_RUN_STATUS_FAILURE;
+  return found;
+}
+
+bool PortfolioSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  ShapeStats &shape = shapes[getShape(query, objects)];
+  if (shape.wins.empty())
+    shape.wins.resize(solvers.size());
+
+  unsigned best = 0;
+  for (unsigned i = 1; i < solvers.size(); i++)
+    if (shape.wins[i] > shape.wins[best])
+      best = i;
+
+  /* new shapes and shapes which tend to be slow are raced, until one solver
+     clearly wins on them */
+  bool routed = shape.races >= PortfolioRouteAfter &&
+                shape.wins[best] * 4 >= shape.races * 3;
+  bool fast = shape.runs && shape.time / shape.runs < PortfolioRaceThreshold;
+
+  double start = util::getWallTime();
+  bool success;
+  if (routed || fast) {
+    if (routed)
+      ++stats::queryPortfolioRouted;
+    success = solvers[best]->impl->computeInitialValues(query, objects, values,
+                                                        hasSolution);
+    runStatusCode = solvers[best]->impl->getOperationStatusCode();
+  } else {
+    ++stats::queryPortfolioRaces;
+    unsigned winner;
+    success = race(query, objects, values, hasSolution, winner);
+    if (success) {
+      shape.races++;
+      shape.wins[winner]++;
+      if (shape.races == PortfolioRouteAfter &&
+          shape.wins[winner] * 4 >= shape.races * 3)
+        klee_message("portfolio: routing a query shape to %s",
+                     names[winner].c_str());
+    }
+  }
+
+  if (success) {
+    shape.runs++;
+    shape.time += util::getWallTime() - start;
+  }
+  return success;
+}
+
+bool PortfolioSolver::computeTruth(const Query &query, bool &isValid) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  if (!computeInitialValues(query, objects, values, hasSolution))
+    return false;
+
+  isValid = !hasSolution;
+  return true;
+}
+
+bool PortfolioSolver::computeValue(const Query &query, ref<Expr> &result) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  findSymbolicObjects(query.expr, objects);
+  if (!computeInitialValues(query.withFalse(), objects, values, hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  Assignment a(objects, values);
+  result = a.evaluate(query.expr);
+  return true;
+}
+
+Solver *klee::createPortfolioSolver(const std::vector<Solver *> &solvers,
+                                    const std::vector<std::string> &names) {
+  assert(!solvers.empty() && solvers.size() == names.size());
+  return new Solver(new PortfolioSolver(solvers, names));
+}
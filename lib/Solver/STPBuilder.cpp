@@ -61,7 +61,10 @@ STPArrayExprHash::~STPArrayExprHash() {
     }
   }
 
+  clearUpdateNodes();
+}
 
+void STPArrayExprHash::clearUpdateNodes() {
   for (UpdateNodeHashConstIter it = _update_node_hash.begin();
       it != _update_node_hash.end(); ++it) {
     ::VCExpr un_expr = it->second;
@@ -70,6 +73,7 @@ STPArrayExprHash::~STPArrayExprHash() {
       un_expr = 0;
     }
   }
+  ArrayExprHash< ::VCExpr >::clearUpdateNodes();
 }
 
 /***/
@@ -83,6 +87,13 @@ STPBuilder::~STPBuilder() {
   
 }
 
+void STPBuilder::trimCaches() {
+  if (constructed.size() > MaxSolverTermCache)
+    constructed.clear();
+  if (_arr_hash.getNumUpdateNodes() > MaxSolverTermCache)
+    _arr_hash.clearUpdateNodes();
+}
+
 ///
 
 /* Warning: be careful about what c_interface functions you use. Some of
@@ -456,6 +467,16 @@ ExprHandle STPBuilder::constructSDivByConstant(ExprHandle expr_n, unsigned width
                        construct(root->constantValues[i], 0));
 	vc_DeleteExpr(prev);
       }
+    } else if (isBitvectorArray(root)) {
+      // The reads at symbolic indices see the same bytes as the reads at
+      // constant indices, which use the byte variables directly.
+      for (unsigned i = 0, e = root->size; i != e; ++i) {
+	::VCExpr prev = array_expr;
+	array_expr = vc_writeExpr(vc, prev,
+                       construct(ConstantExpr::alloc(i, root->getDomain()), 0),
+                       getInitialByte(root, i));
+	vc_DeleteExpr(prev);
+      }
     }
     
     _arr_hash.hashArrayExpr(root, array_expr);
@@ -464,7 +485,27 @@ ExprHandle STPBuilder::constructSDivByConstant(ExprHandle expr_n, unsigned width
   return(array_expr); 
 }
 
+ExprHandle STPBuilder::getInitialByte(const Array *root, unsigned index) {
+  assert(isBitvectorArray(root) && index < root->size);
+  std::vector<ExprHandle> &bytes = _array_bytes[root];
+  if (bytes.empty()) {
+    // As for the arrays, the names are made unique by a counter.
+    std::string unique_id = llvm::itostr(_array_bytes.size());
+    unsigned const uid_length = unique_id.length();
+    unsigned const space = (root->name.length() > 32 - uid_length)
+                               ? (32 - uid_length)
+                               : root->name.length();
+    std::string unique_name = root->name.substr(0, space) + "!" + unique_id;
+    for (unsigned i = 0; i != root->size; ++i)
+      bytes.push_back(buildVar((unique_name + "_" + llvm::utostr(i)).c_str(),
+                               root->getRange()));
+  }
+  return bytes[index];
+}
+
 ExprHandle STPBuilder::getInitialRead(const Array *root, unsigned index) {
+  if (isBitvectorArray(root) && index < root->size)
+    return getInitialByte(root, index);
   return vc_readExpr(vc, getInitialArray(root), bvConst32(32, index));
 }
 
@@ -559,8 +600,20 @@ ExprHandle STPBuilder::constructActual(ref<Expr> e, int *width_out) {
     ReadExpr *re = cast<ReadExpr>(e);
     assert(re && re->updates.root);
     *width_out = re->updates.root->getRange();
+    // A read at a constant index only needs the updates which may write it.
+    const UpdateNode *un = re->updates.head;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
+      uint64_t index = CE->getZExtValue();
+      if (un && (un = un->findUpdate(index)) &&
+          isa<ConstantExpr>(un->index))
+        return construct(un->value, width_out);
+      // Nor does a read of the initial bytes of a small symbolic array.
+      const Array *root = re->updates.root;
+      if (!un && isBitvectorArray(root) && index < root->size)
+        return getInitialByte(root, index);
+    }
     return vc_readExpr(vc,
-                       getArrayForUpdate(re->updates.root, re->updates.head),
+                       getArrayForUpdate(re->updates.root, un),
                        construct(re->index, 0));
   }
     
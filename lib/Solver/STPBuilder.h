@@ -12,8 +12,10 @@
 
 #include "klee/util/ExprHashMap.h"
 #include "klee/util/ArrayExprHash.h"
+#include "klee/CommandLine.h"
 #include "klee/Config/config.h"
 
+#include <map>
 #include <vector>
 
 #define Expr VCExpr
@@ -60,6 +62,7 @@ namespace klee {
   public:
     STPArrayExprHash() {};
     virtual ~STPArrayExprHash();
+    virtual void clearUpdateNodes();
   };
 
 class STPBuilder {
@@ -73,6 +76,9 @@ class STPBuilder {
 
   STPArrayExprHash _arr_hash;
 
+  /// the byte variables of the arrays encoded as bitvectors
+  std::map<const Array*, std::vector<ExprHandle> > _array_bytes;
+
 private:  
 
   ExprHandle bvOne(unsigned width);
@@ -103,6 +109,12 @@ private:
   ExprHandle constructSDivByConstant(ExprHandle expr_n, unsigned width, uint64_t d);
 
   ::VCExpr getInitialArray(const Array *os);
+  /// isBitvectorArray - Is the array symbolic and of at most
+  /// --bitvector-array-size bytes, and so encoded as one variable per byte.
+  bool isBitvectorArray(const Array *root) const {
+    return !root->isConstantArray() && root->size <= BitvectorArraySize;
+  }
+  ExprHandle getInitialByte(const Array *root, unsigned index);
   ::VCExpr getArrayForUpdate(const Array *root, const UpdateNode *un);
 
   ExprHandle constructActual(ref<Expr> e, int *width_out);
@@ -121,9 +133,15 @@ public:
 
   ExprHandle construct(ref<Expr> e) { 
     ExprHandle res = construct(e, 0);
-    constructed.clear();
+    if (!MaxSolverTermCache)
+      constructed.clear();
     return res;
   }
+
+  /// Drop the cached terms if there are more than --max-solver-term-cache of
+  /// them, they are otherwise kept across queries. Only call this between
+  /// queries, as the array terms are handed out unreferenced.
+  void trimCaches();
 };
 
 }
@@ -9,23 +9,34 @@
 #include "klee/Config/config.h"
 #ifdef ENABLE_STP
 #include "STPBuilder.h"
+#include "klee/CommandLine.h"
 #include "klee/Solver.h"
 #include "klee/SolverImpl.h"
 #include "klee/Constraints.h"
+#include "klee/ExprBuilder.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/ArrayCache.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/BinaryQueryLog.h"
 #include "klee/util/ExprUtil.h"
+#include "expr/Parser.h"
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Errno.h"
 #include "llvm/Support/ErrorHandling.h"
 
 #include <errno.h>
+#include <poll.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
 
 namespace {
 
@@ -36,6 +47,13 @@ llvm::cl::opt<bool> DebugDumpSTPQueries(
 llvm::cl::opt<bool> IgnoreSolverFailures(
     "ignore-solver-failures", llvm::cl::init(false),
     llvm::cl::desc("Ignore any solver failures (default=off)"));
+
+llvm::cl::opt<bool> ForkedSolverServer(
+    "forked-solver-server", llvm::cl::init(true),
+    llvm::cl::desc("With --use-forked-solver, send the queries to a solver "
+                   "process which is started once and restarted only after "
+                   "a timeout or a crash, instead of forking for every query "
+                   "(default=on)"));
 }
 
 #define vc_bvBoolExtract IAMTHESPAWNOFSATAN
@@ -46,11 +64,12 @@ static int shared_memory_id = 0;
 // memory, which will quickly be exhausted by KLEE running its tests in
 // parallel. For now, we work around this by just requesting a smaller size --
 // in practice users hitting this limit on counterexample sizes probably already
-// are hitting more serious scalability issues.
+// are hitting more serious scalability issues. The region grows when a query
+// or a counterexample does not fit.
 #ifdef __APPLE__
-static const unsigned shared_memory_size = 1 << 16;
+static size_t shared_memory_size = 1 << 16;
 #else
-static const unsigned shared_memory_size = 1 << 20;
+static size_t shared_memory_size = 1 << 20;
 #endif
 
 static void stp_error_handler(const char *err_msg) {
@@ -58,6 +77,90 @@ static void stp_error_handler(const char *err_msg) {
   abort();
 }
 
+static int allocateSharedMemory(size_t size) {
+  int id = shmget(IPC_PRIVATE, size, IPC_CREAT | 0700);
+  if (id < 0)
+    llvm::report_fatal_error("unable to allocate shared memory region");
+  shared_memory_ptr = (unsigned char *)shmat(id, NULL, 0);
+  if (shared_memory_ptr == (void *)-1)
+    llvm::report_fatal_error("unable to attach shared memory region");
+  shared_memory_size = size;
+  return id;
+}
+
+/// Make the shared memory hold at least size bytes. The new region is
+/// returned, or -1 if the old one is large enough; the caller marks it for
+/// removal once every process which needs it attached it.
+static int reserveSharedMemory(size_t size) {
+  if (size <= shared_memory_size)
+    return -1;
+  shmdt(shared_memory_ptr);
+  shared_memory_id = allocateSharedMemory(std::max(size,
+                                                   2 * shared_memory_size));
+  return shared_memory_id;
+}
+
+static ::VC createValidityChecker() {
+  ::VC vc = vc_createValidityChecker();
+  assert(vc && "unable to create validity checker");
+
+  // In newer versions of STP, a memory management mechanism has been
+  // introduced that automatically invalidates certain C interface
+  // pointers at vc_Destroy time.  This caused double-free errors
+  // due to the ExprHandle destructor also attempting to invalidate
+  // the pointers using vc_DeleteExpr.  By setting EXPRDELETE to 0
+  // we restore the old behaviour.
+  vc_setInterfaceFlags(vc, EXPRDELETE, 0);
+
+  make_division_total(vc);
+
+  vc_registerErrorHandler(::stp_error_handler);
+  return vc;
+}
+
+static bool readAll(int fd, void *buf, size_t n) {
+  char *p = (char *)buf;
+  while (n) {
+    ssize_t r = read(fd, p, n);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return false;
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+static bool writeAll(int fd, const void *buf, size_t n) {
+  const char *p = (const char *)buf;
+  while (n) {
+    // not write(), a solver process which died must not kill us by SIGPIPE
+    ssize_t r = send(fd, p, n, MSG_NOSIGNAL);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return false;
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+/// A query for the solver process: the records of the binary query log
+/// at the start of the shared memory.
+struct SolverServerRequest {
+  int sharedMemoryId;
+  uint64_t length;
+};
+
+/// The answer of the solver process; the counterexample follows in the
+/// shared memory if the query has a solution.
+struct SolverServerReply {
+  enum { Solvable, Unsolvable, Invalid };
+  int status;
+};
+
 namespace klee {
 
 class STPSolverImpl : public SolverImpl {
@@ -67,6 +170,25 @@ private:
   double timeout;
   bool useForkedSTP;
   SolverRunStatus runStatusCode;
+  /// constraints asserted in vc, one push level each (incremental mode)
+  std::vector<ref<Expr> > asserted;
+  bool optimizeDivides;
+  /// the process using the solver process and the shared memory
+  pid_t owner;
+  /// the solver process of --forked-solver-server, 0 if not running
+  pid_t serverPid;
+  int serverSocket;
+  /// the definitions the solver process knows
+  BinaryQueryLogWriter *serverWriter;
+
+  void assertConstraints(const Query &);
+  bool startServer();
+  void stopServer();
+  SolverRunStatus
+  runAndGetCexServer(const Query &query,
+                     const std::vector<const Array *> &objects,
+                     std::vector<std::vector<unsigned char> > &values,
+                     bool &hasSolution);
 
 public:
   STPSolverImpl(bool _useForkedSTP, bool _optimizeDivides = true);
@@ -85,38 +207,24 @@ public:
 };
 
 STPSolverImpl::STPSolverImpl(bool _useForkedSTP, bool _optimizeDivides)
-    : vc(vc_createValidityChecker()),
+    : vc(createValidityChecker()),
       builder(new STPBuilder(vc, _optimizeDivides)), timeout(0.0),
-      useForkedSTP(_useForkedSTP), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
-  assert(vc && "unable to create validity checker");
+      useForkedSTP(_useForkedSTP), runStatusCode(SOLVER_RUN_STATUS_FAILURE),
+      optimizeDivides(_optimizeDivides), owner(getpid()), serverPid(0),
+      serverSocket(-1),
+      serverWriter(0) {
   assert(builder && "unable to create STPBuilder");
 
-  // In newer versions of STP, a memory management mechanism has been
-  // introduced that automatically invalidates certain C interface
-  // pointers at vc_Destroy time.  This caused double-free errors
-  // due to the ExprHandle destructor also attempting to invalidate
-  // the pointers using vc_DeleteExpr.  By setting EXPRDELETE to 0
-  // we restore the old behaviour.
-  vc_setInterfaceFlags(vc, EXPRDELETE, 0);
-
-  make_division_total(vc);
-
-  vc_registerErrorHandler(::stp_error_handler);
-
   if (useForkedSTP) {
     assert(shared_memory_id == 0 && "shared memory id already allocated");
-    shared_memory_id =
-        shmget(IPC_PRIVATE, shared_memory_size, IPC_CREAT | 0700);
-    if (shared_memory_id < 0)
-      llvm::report_fatal_error("unable to allocate shared memory region");
-    shared_memory_ptr = (unsigned char *)shmat(shared_memory_id, NULL, 0);
-    if (shared_memory_ptr == (void *)-1)
-      llvm::report_fatal_error("unable to attach shared memory region");
+    shared_memory_id = allocateSharedMemory(shared_memory_size);
     shmctl(shared_memory_id, IPC_RMID, NULL);
   }
 }
 
 STPSolverImpl::~STPSolverImpl() {
+  stopServer();
+
   // Detach the memory region.
   shmdt(shared_memory_ptr);
   shared_memory_ptr = 0;
@@ -129,12 +237,37 @@ STPSolverImpl::~STPSolverImpl() {
 
 /***/
 
+/// Assert the constraints of query, for the forked solver in the parent so
+/// that the child inherits them. In incremental mode, the prefix shared with
+/// the constraints of the previous query (e.g. the path up to the last
+/// branch) stays asserted.
+void STPSolverImpl::assertConstraints(const Query &query) {
+  ConstraintManager::const_iterator it = query.constraints.begin(),
+                                    ie = query.constraints.end();
+  if (UseIncrementalCoreSolver) {
+    size_t common = 0;
+    while (common < asserted.size() && it != ie && asserted[common] == *it) {
+      ++common;
+      ++it;
+    }
+    for (size_t i = common; i < asserted.size(); ++i)
+      vc_pop(vc);
+    asserted.resize(common);
+    for (; it != ie; ++it) {
+      vc_push(vc);
+      vc_assertFormula(vc, builder->construct(*it));
+      asserted.push_back(*it);
+    }
+    vc_push(vc);
+  } else {
+    vc_push(vc);
+    for (; it != ie; ++it)
+      vc_assertFormula(vc, builder->construct(*it));
+  }
+}
+
 char *STPSolverImpl::getConstraintLog(const Query &query) {
-  vc_push(vc);
-  for (std::vector<ref<Expr> >::const_iterator it = query.constraints.begin(),
-                                               ie = query.constraints.end();
-       it != ie; ++it)
-    vc_assertFormula(vc, builder->construct(*it));
+  assertConstraints(query);
   assert(query.expr == ConstantExpr::alloc(0, Expr::Bool) &&
          "Unexpected expression in query!");
 
@@ -219,14 +352,16 @@ runAndGetCexForked(::VC vc, STPBuilder *builder, ::VCExpr q,
                    const std::vector<const Array *> &objects,
                    std::vector<std::vector<unsigned char> > &values,
                    bool &hasSolution, double timeout) {
-  unsigned char *pos = shared_memory_ptr;
-  unsigned sum = 0;
+  size_t sum = 0;
   for (std::vector<const Array *>::const_iterator it = objects.begin(),
                                                   ie = objects.end();
        it != ie; ++it)
     sum += (*it)->size;
-  if (sum >= shared_memory_size)
-    llvm::report_fatal_error("not enough shared memory for counterexample");
+  // the child inherits the attached region
+  int region = reserveSharedMemory(sum);
+  if (region >= 0)
+    shmctl(region, IPC_RMID, NULL);
+  unsigned char *pos = shared_memory_ptr;
 
   fflush(stdout);
   fflush(stderr);
@@ -321,23 +456,257 @@ runAndGetCexForked(::VC vc, STPBuilder *builder, ::VCExpr q,
     }
   }
 }
-bool STPSolverImpl::computeInitialValues(
+/// The loop of the solver process: solve the queries sent over socket
+/// with a validity checker of its own until the socket is closed.
+static void runSolverServer(int socket, bool optimizeDivides) {
+#ifdef __linux__
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+  ::VC vc = createValidityChecker();
+  STPBuilder *builder = new STPBuilder(vc, optimizeDivides);
+  ExprBuilder *exprBuilder = createDefaultExprBuilder();
+  ArrayCache arrays;
+  BinaryQueryLogReader reader(exprBuilder, &arrays);
+
+  SolverServerRequest request;
+  while (readAll(socket, &request, sizeof(request))) {
+    if (request.sharedMemoryId != shared_memory_id) {
+      shmdt(shared_memory_ptr);
+      shared_memory_ptr =
+          (unsigned char *)shmat(request.sharedMemoryId, NULL, 0);
+      if (shared_memory_ptr == (void *)-1)
+        _exit(1);
+      shared_memory_id = request.sharedMemoryId;
+    }
+
+    SolverServerReply reply;
+    expr::QueryCommand *qc =
+        reader.readQuery((const char *)shared_memory_ptr, request.length);
+    if (!qc) {
+      reply.status = SolverServerReply::Invalid;
+    } else {
+      vc_push(vc);
+      for (std::vector<ref<Expr> >::const_iterator
+               it = qc->Constraints.begin(), ie = qc->Constraints.end();
+           it != ie; ++it)
+        vc_assertFormula(vc, builder->construct(*it));
+      std::vector<std::vector<unsigned char> > values;
+      bool hasSolution;
+      runAndGetCex(vc, builder, builder->construct(qc->Query), qc->Objects,
+                   values, hasSolution);
+      vc_pop(vc);
+      builder->trimCaches();
+
+      unsigned char *pos = shared_memory_ptr;
+      for (unsigned i = 0; i < values.size(); ++i) {
+        std::copy(values[i].begin(), values[i].end(), pos);
+        pos += values[i].size();
+      }
+      reply.status = hasSolution ? SolverServerReply::Solvable
+                                 : SolverServerReply::Unsolvable;
+      delete qc;
+    }
+    if (!writeAll(socket, &reply, sizeof(reply)))
+      break;
+  }
+  _exit(0);
+}
+
+bool STPSolverImpl::startServer() {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0) {
+    klee_warning("socketpair failed (for STP) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  int pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for STP) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(sockets[0]);
+    close(sockets[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(sockets[0]);
+    runSolverServer(sockets[1], optimizeDivides);
+  }
+
+  close(sockets[1]);
+  serverPid = pid;
+  serverSocket = sockets[0];
+  serverWriter = new BinaryQueryLogWriter();
+  return true;
+}
+
+void STPSolverImpl::stopServer() {
+  if (!serverPid)
+    return;
+  close(serverSocket);
+  kill(serverPid, SIGKILL);
+  while (waitpid(serverPid, 0, 0) < 0 && errno == EINTR)
+    ;
+  serverPid = 0;
+  serverSocket = -1;
+  delete serverWriter;
+  serverWriter = 0;
+}
+
+SolverImpl::SolverRunStatus STPSolverImpl::runAndGetCexServer(
     const Query &query, const std::vector<const Array *> &objects,
     std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
-  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  if (owner != getpid()) {
+    // A forked copy of the interpreter, e.g. for an asynchronous query,
+    // must not talk to the solver process of its parent, nor write into
+    // its shared memory.
+    if (serverPid) {
+      close(serverSocket);
+      serverPid = 0;
+      serverSocket = -1;
+      delete serverWriter;
+      serverWriter = 0;
+    }
+    shmdt(shared_memory_ptr);
+    shared_memory_id = allocateSharedMemory(shared_memory_size);
+    shmctl(shared_memory_id, IPC_RMID, NULL);
+    owner = getpid();
+  }
 
-  TimerStatIncrementer t(stats::queryTime);
+  if (!serverPid && !startServer()) {
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_FORK_FAILED;
+  }
 
-  vc_push(vc);
+  std::string defs, record;
+  serverWriter->resetIfFull(defs);
+  serverWriter->writeQuery(defs, record, BinaryQueryLogWriter::InitialValues,
+                           query, &objects);
+  defs += record;
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
+  size_t cexSize = 0;
+  for (std::vector<const Array *>::const_iterator it = objects.begin(),
+                                                  ie = objects.end();
        it != ie; ++it)
-    vc_assertFormula(vc, builder->construct(*it));
+    cexSize += (*it)->size;
+  int region = reserveSharedMemory(std::max(defs.size(), cexSize));
+  std::copy(defs.begin(), defs.end(), shared_memory_ptr);
+
+  SolverServerRequest request;
+  request.sharedMemoryId = shared_memory_id;
+  request.length = defs.size();
+  SolverServerReply reply;
+  bool sent = writeAll(serverSocket, &request, sizeof(request));
+
+  // wait for the reply, up to the timeout, in slices of 100ms if the
+  // query may be interrupted
+  double deadline = timeout ? util::getWallTime() + std::max(1.0, timeout) : 0;
+  bool (*interruptCheck)() = getSolverInterruptCheck();
+  bool answered = false, timedOut = false, interrupted = false;
+  while (sent) {
+    int wait = -1;
+    if (timeout) {
+      double left = deadline - util::getWallTime();
+      if (left <= 0) {
+        timedOut = true;
+        break;
+      }
+      wait = std::max(1, (int)(left * 1000));
+    }
+    bool sliced = interruptCheck && (wait < 0 || wait > 100);
+    if (sliced)
+      wait = 100;
+    struct pollfd pfd;
+    pfd.fd = serverSocket;
+    pfd.events = POLLIN;
+    int r = poll(&pfd, 1, wait);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r == 0 && sliced) {
+      if (interruptCheck()) {
+        interrupted = true;
+        break;
+      }
+      continue;
+    }
+    if (r > 0)
+      answered = readAll(serverSocket, &reply, sizeof(reply));
+    else
+      timedOut = r == 0;
+    break;
+  }
+
+  // the solver process attached the new region (or is gone)
+  if (region >= 0)
+    shmctl(region, IPC_RMID, NULL);
+
+  if (!answered) {
+    // the process is killed mid query, it is restarted for the next one
+    // without the definitions it had
+    stopServer();
+    if (timedOut) {
+      klee_warning("STP timed out");
+      return SolverImpl::SOLVER_RUN_STATUS_TIMEOUT;
+    }
+    if (interrupted)
+      return SolverImpl::SOLVER_RUN_STATUS_INTERRUPTED;
+    klee_warning("STP did not return successfully.  Most likely you forgot "
+                 "to run 'ulimit -s unlimited'");
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_INTERRUPTED;
+  }
+
+  if (reply.status == SolverServerReply::Invalid) {
+    stopServer();
+    klee_warning("STP did not return a recognized code");
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_UNEXPECTED_EXIT_CODE;
+  }
+
+  hasSolution = reply.status == SolverServerReply::Solvable;
+  if (!hasSolution)
+    return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+
+  values = std::vector<std::vector<unsigned char> >(objects.size());
+  unsigned char *pos = shared_memory_ptr;
+  for (unsigned i = 0; i < objects.size(); ++i) {
+    values[i].assign(pos, pos + objects[i]->size);
+    pos += objects[i]->size;
+  }
+  return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+}
+
+bool STPSolverImpl::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  TimerStatIncrementer t(stats::queryTime);
 
   ++stats::queries;
   ++stats::queryCounterexamples;
 
+  if (useForkedSTP && ForkedSolverServer) {
+    runStatusCode = runAndGetCexServer(query, objects, values, hasSolution);
+    bool success = ((SOLVER_RUN_STATUS_SUCCESS_SOLVABLE == runStatusCode) ||
+                    (SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE == runStatusCode));
+    if (success) {
+      if (hasSolution)
+        ++stats::queriesInvalid;
+      else
+        ++stats::queriesValid;
+    }
+    return success;
+  }
+
+  assertConstraints(query);
+
   ExprHandle stp_e = builder->construct(query.expr);
 
   if (DebugDumpSTPQueries) {
@@ -367,6 +736,7 @@ bool STPSolverImpl::computeInitialValues(
   }
 
   vc_pop(vc);
+  builder->trimCaches();
 
   return success;
 }
@@ -0,0 +1,424 @@
+//===-- SharedCacheSolver.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SharedSolverCache.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/QueryHash.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+using namespace llvm;
+
+/***/
+
+static const char packetMagic[4] = { 'K', 'S', 'S', 'C' };
+static const char seedsMagic[4] = { 'K', 'S', 'S', 'D' };
+static const char fileMagic[4] = { 'K', 'S', 'S', 'F' };
+static const uint32_t fileVersion = 1;
+/// the magic, the version and the program hash
+static const size_t fileHeaderSize = 16;
+static const unsigned maxSeeds = 64;
+
+template <typename T>
+static void put(std::vector<char> &out, T value) {
+  const char *p = reinterpret_cast<const char *>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+static bool get(const char *&p, const char *end, T &value) {
+  if ((size_t) (end - p) < sizeof(T))
+    return false;
+  memcpy(&value, p, sizeof(T));
+  p += sizeof(T);
+  return true;
+}
+
+bool SharedSolverCache::lookup(const Key &key, Entry &entry) const {
+  std::map<Key, Entry>::const_iterator it = entries.find(key);
+  if (it == entries.end())
+    return false;
+  entry = it->second;
+  return true;
+}
+
+void SharedSolverCache::insert(const Key &key, const Entry &entry) {
+  if (entries.size() >= maxEntries)
+    return;
+  if (entries.insert(std::make_pair(key, entry)).second && publish)
+    outgoing.push_back(key);
+}
+
+bool SharedSolverCache::takeOutgoing(std::vector<char> &out) {
+  if (outgoing.empty())
+    return false;
+
+  out.insert(out.end(), packetMagic, packetMagic + sizeof(packetMagic));
+  put<uint32_t>(out, outgoing.size());
+  for (std::vector<Key>::iterator it = outgoing.begin(), ie = outgoing.end();
+       it != ie; ++it) {
+    const Entry &entry = entries[*it];
+    put<uint64_t>(out, it->first);
+    put<uint64_t>(out, it->second);
+    put<uint8_t>(out, entry.hasSolution);
+    put<uint32_t>(out, entry.values.size());
+    for (unsigned i = 0; i < entry.values.size(); i++) {
+      const std::vector<unsigned char> &value = entry.values[i];
+      put<uint32_t>(out, value.size());
+      out.insert(out.end(), value.begin(), value.end());
+    }
+  }
+  outgoing.clear();
+  return true;
+}
+
+bool SharedSolverCache::addPacket(const char *buffer, size_t size) {
+  const char *p = buffer, *end = buffer + size;
+  uint32_t count;
+  if (size < sizeof(packetMagic) ||
+      memcmp(buffer, packetMagic, sizeof(packetMagic)) != 0)
+    return false;
+  p += sizeof(packetMagic);
+  if (!get(p, end, count) || count > size)
+    return false;
+
+  /* decode everything first, a truncated packet adds nothing */
+  std::vector< std::pair<Key, Entry> > received(count);
+  for (unsigned i = 0; i < count; i++) {
+    Key &key = received[i].first;
+    Entry &entry = received[i].second;
+    uint8_t hasSolution;
+    uint32_t numValues;
+    if (!get(p, end, key.first) || !get(p, end, key.second) ||
+        !get(p, end, hasSolution) || !get(p, end, numValues))
+      return false;
+    entry.hasSolution = hasSolution;
+    entry.values.resize(numValues);
+    for (unsigned j = 0; j < numValues; j++) {
+      uint32_t length;
+      if (!get(p, end, length) || (size_t) (end - p) < length)
+        return false;
+      entry.values[j].assign(p, p + length);
+      p += length;
+    }
+  }
+  if (p != end)
+    return false;
+
+  /* remote entries are not published again */
+  for (unsigned i = 0; i < count && entries.size() < maxEntries; i++)
+    entries.insert(received[i]);
+  return true;
+}
+
+/* a cache file is a header and then the packets, each after its size */
+bool SharedSolverCache::loadFile(const std::string &path,
+                                 uint64_t programHash) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  flock(fd, LOCK_SH);
+
+  bool valid = false;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && (size_t) st.st_size >= fileHeaderSize) {
+    size_t size = st.st_size;
+    void *map = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map != MAP_FAILED) {
+      const char *p = static_cast<const char *>(map), *end = p + size;
+      uint32_t version;
+      uint64_t hash;
+      p += sizeof(fileMagic);
+      valid = memcmp(map, fileMagic, sizeof(fileMagic)) == 0 &&
+              get(p, end, version) && version == fileVersion &&
+              get(p, end, hash) && hash == programHash;
+      uint32_t length;
+      while (valid && entries.size() < maxEntries && get(p, end, length) &&
+             (size_t) (end - p) >= length) {
+        if (!addPacket(p, length))
+          break;
+        p += length;
+      }
+      munmap(map, size);
+    }
+  }
+
+  flock(fd, LOCK_UN);
+  close(fd);
+  return valid;
+}
+
+bool SharedSolverCache::appendToFile(const std::string &path,
+                                     uint64_t programHash,
+                                     const std::vector<char> &packet) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0664);
+  if (fd < 0)
+    return false;
+  if (flock(fd, LOCK_EX) != 0) {
+    close(fd);
+    return false;
+  }
+
+  std::vector<char> out;
+  char header[fileHeaderSize];
+  uint32_t version = 0;
+  uint64_t hash = 0;
+  if (pread(fd, header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+      memcmp(header, fileMagic, sizeof(fileMagic)) == 0) {
+    memcpy(&version, header + sizeof(fileMagic), sizeof(version));
+    memcpy(&hash, header + sizeof(fileMagic) + sizeof(version), sizeof(hash));
+  }
+  if (version != fileVersion || hash != programHash) {
+    /* the entries of another program are dropped */
+    if (ftruncate(fd, 0) != 0) {
+      flock(fd, LOCK_UN);
+      close(fd);
+      return false;
+    }
+    out.insert(out.end(), fileMagic, fileMagic + sizeof(fileMagic));
+    put<uint32_t>(out, fileVersion);
+    put<uint64_t>(out, programHash);
+  }
+  put<uint32_t>(out, packet.size());
+  out.insert(out.end(), packet.begin(), packet.end());
+
+  bool success = lseek(fd, 0, SEEK_END) >= 0 &&
+                 write(fd, &out[0], out.size()) == (ssize_t) out.size();
+  flock(fd, LOCK_UN);
+  close(fd);
+  return success;
+}
+
+void SharedSolverCache::addSeed(const Seed &seed) {
+  seeds.push_back(seed);
+  if (seeds.size() > maxSeeds)
+    seeds.pop_front();
+}
+
+void SharedSolverCache::encodeSeeds(const std::vector<Seed> &seeds,
+                                    std::vector<char> &out) {
+  size_t base = out.size();
+  out.insert(out.end(), seedsMagic, seedsMagic + sizeof(seedsMagic));
+  put<uint32_t>(out, 0);
+  put<uint32_t>(out, seeds.size());
+  for (unsigned i = 0; i < seeds.size(); i++) {
+    put<uint32_t>(out, seeds[i].size());
+    for (Seed::const_iterator it = seeds[i].begin(), ie = seeds[i].end();
+         it != ie; ++it) {
+      put<uint32_t>(out, it->first.size());
+      out.insert(out.end(), it->first.begin(), it->first.end());
+      put<uint32_t>(out, it->second.size());
+      out.insert(out.end(), it->second.begin(), it->second.end());
+    }
+  }
+  /* the total size lets the reader find what follows */
+  uint32_t length = out.size() - base;
+  memcpy(&out[base + sizeof(seedsMagic)], &length, sizeof(length));
+}
+
+size_t SharedSolverCache::decodeSeeds(const char *buffer, size_t size,
+                                      std::vector<Seed> &out) {
+  const char *p = buffer;
+  uint32_t length, count;
+  if (size < sizeof(seedsMagic) ||
+      memcmp(buffer, seedsMagic, sizeof(seedsMagic)) != 0)
+    return 0;
+  p += sizeof(seedsMagic);
+  if (!get(p, buffer + size, length) || length > size ||
+      length < sizeof(seedsMagic) + 2 * sizeof(uint32_t))
+    return 0;
+
+  const char *end = buffer + length;
+  if (!get(p, end, count) || count > length)
+    return 0;
+  std::vector<Seed> received(count);
+  for (unsigned i = 0; i < count; i++) {
+    uint32_t numArrays;
+    if (!get(p, end, numArrays))
+      return 0;
+    for (unsigned j = 0; j < numArrays; j++) {
+      uint32_t nameLength, valueLength;
+      if (!get(p, end, nameLength) || (size_t) (end - p) < nameLength)
+        return 0;
+      std::string name(p, nameLength);
+      p += nameLength;
+      if (!get(p, end, valueLength) || (size_t) (end - p) < valueLength)
+        return 0;
+      received[i][name].assign(p, p + valueLength);
+      p += valueLength;
+    }
+  }
+  if (p != end)
+    return 0;
+
+  out.insert(out.end(), received.begin(), received.end());
+  return length;
+}
+
+/***/
+
+class SharedCacheSolver : public SolverImpl {
+private:
+  Solver *solver;
+  SharedSolverCache &cache;
+
+  SharedSolverCache::Key getKey(const Query &query,
+                                const std::vector<const Array *> &objects);
+
+  bool isSolution(const Query &query,
+                  const std::vector<const Array *> &objects,
+                  std::vector<std::vector<unsigned char> > &values);
+
+  bool findSeedSolution(const Query &query,
+                        const std::vector<const Array *> &objects,
+                        std::vector<std::vector<unsigned char> > &values);
+
+public:
+  SharedCacheSolver(Solver *_solver, SharedSolverCache &_cache)
+      : solver(_solver), cache(_cache) {}
+  ~SharedCacheSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(double timeout);
+};
+
+/// the key is the hash of the canonical query, which does not depend on
+/// the addresses or names of the arrays, so the same query built by another
+/// process has the same key
+SharedSolverCache::Key
+SharedCacheSolver::getKey(const Query &query,
+                          const std::vector<const Array *> &objects) {
+  return QueryHasher(query.constraints).getHash(query.expr, objects);
+}
+
+bool SharedCacheSolver::isSolution(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values) {
+  for (unsigned i = 0; i < values.size(); i++)
+    if (values[i].size() != objects[i]->size)
+      return false;
+
+  Assignment assignment(objects, values);
+  return assignment.satisfies(query.constraints.begin(),
+                              query.constraints.end()) &&
+         assignment.evaluate(query.expr)->isFalse();
+}
+
+/// a seed solves the path constraints of a state, so it also solves the
+/// queries made along its prefix which the state took
+bool SharedCacheSolver::findSeedSolution(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values) {
+  const std::deque<SharedSolverCache::Seed> &seeds = cache.getSeeds();
+  for (std::deque<SharedSolverCache::Seed>::const_reverse_iterator
+           it = seeds.rbegin(), ie = seeds.rend(); it != ie; ++it) {
+    std::vector<std::vector<unsigned char> > candidate;
+    for (unsigned i = 0; i < objects.size(); i++) {
+      SharedSolverCache::Seed::const_iterator value =
+          it->find(objects[i]->name);
+      if (value == it->end())
+        break;
+      candidate.push_back(value->second);
+    }
+    if (candidate.size() == objects.size() &&
+        isSolution(query, objects, candidate)) {
+      values = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SharedCacheSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  SharedSolverCache::Key key = getKey(query, objects);
+  SharedSolverCache::Entry entry;
+
+  if (cache.lookup(key, entry) && entry.values.size() ==
+      (entry.hasSolution ? objects.size() : 0)) {
+    /* a solution is cheap to check, so a digest collision can not make it
+       unsound */
+    if (!entry.hasSolution || isSolution(query, objects, entry.values)) {
+      ++stats::querySharedCacheHits;
+      hasSolution = entry.hasSolution;
+      values = entry.values;
+      return true;
+    }
+  }
+
+  if (findSeedSolution(query, objects, values)) {
+    ++stats::querySharedCacheHits;
+    hasSolution = true;
+    entry.hasSolution = true;
+    entry.values = values;
+    cache.insert(key, entry);
+    return true;
+  }
+
+  ++stats::querySharedCacheMisses;
+  if (!solver->impl->computeInitialValues(query, objects, values, hasSolution))
+    return false;
+
+  entry.hasSolution = hasSolution;
+  entry.values.clear();
+  if (hasSolution)
+    entry.values = values;
+  cache.insert(key, entry);
+  return true;
+}
+
+bool SharedCacheSolver::computeTruth(const Query &query, bool &isValid) {
+  return solver->impl->computeTruth(query, isValid);
+}
+
+bool SharedCacheSolver::computeValidity(const Query &query,
+                                        Solver::Validity &result) {
+  return solver->impl->computeValidity(query, result);
+}
+
+bool SharedCacheSolver::computeValue(const Query &query, ref<Expr> &result) {
+  return solver->impl->computeValue(query, result);
+}
+
+SolverImpl::SolverRunStatus SharedCacheSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *SharedCacheSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void SharedCacheSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+Solver *klee::createSharedCacheSolver(Solver *s, SharedSolverCache &cache) {
+  return new Solver(new SharedCacheSolver(s, cache));
+}
@@ -13,6 +13,16 @@
 
 using namespace klee;
 
+static bool (*solverInterruptCheck)() = 0;
+
+void klee::setSolverInterruptCheck(bool (*check)()) {
+  solverInterruptCheck = check;
+}
+
+bool (*klee::getSolverInterruptCheck())() {
+  return solverInterruptCheck;
+}
+
 const char *Solver::validity_to_str(Validity v) {
   switch (v) {
   default:    return "Unknown";
@@ -19,10 +19,19 @@ Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
+Statistic stats::queryCexCacheEvictions("QueryCexCacheEvictions", "QCexEvicts");
+Statistic stats::queryKnownBitsHits("QueryKnownBitsHits", "QKBhits");
+Statistic stats::queryKnownBitsMisses("QueryKnownBitsMisses", "QKBmisses");
+Statistic stats::querySharedCacheHits("QuerySharedCacheHits", "QSChits");
+Statistic stats::querySharedCacheMisses("QuerySharedCacheMisses", "QSCmisses");
+Statistic stats::queryPortfolioRaces("QueryPortfolioRaces", "QPFraces");
+Statistic stats::queryPortfolioRouted("QueryPortfolioRouted", "QPFrouted");
 Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
 Statistic stats::queryTime("QueryTime", "Qtime");
+Statistic stats::queryTimeouts("QueryTimeouts", "Qtimeouts");
+Statistic stats::queryEscalations("QueryEscalations", "Qescalated");
 
 #ifdef DEBUG
 Statistic stats::arrayHashTime("ArrayHashTime", "AHtime");
@@ -10,6 +10,7 @@
 #ifdef ENABLE_Z3
 #include "Z3Builder.h"
 
+#include "klee/CommandLine.h"
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 #include "klee/util/Bits.h"
@@ -51,7 +52,7 @@ void custom_z3_error_handler(Z3_context ctx, Z3_error_code ec) {
 Z3ArrayExprHash::~Z3ArrayExprHash() {}
 
 void Z3ArrayExprHash::clear() {
-  _update_node_hash.clear();
+  clearUpdateNodes();
   _array_hash.clear();
 }
 
@@ -74,9 +75,17 @@ Z3Builder::~Z3Builder() {
   // they aren associated with.
   clearConstructCache();
   _arr_hash.clear();
+  _array_bytes.clear();
   Z3_del_context(ctx);
 }
 
+void Z3Builder::trimCaches() {
+  if (constructed.size() > MaxSolverTermCache)
+    clearConstructCache();
+  if (_arr_hash.getNumUpdateNodes() > MaxSolverTermCache)
+    _arr_hash.clearUpdateNodes();
+}
+
 Z3SortHandle Z3Builder::getBvSort(unsigned width) {
   // FIXME: cache these
   return Z3SortHandle(Z3_mk_bv_sort(ctx, width), ctx);
@@ -379,6 +388,15 @@ Z3ASTHandle Z3Builder::getInitialArray(const Array *root) {
             prev, construct(ConstantExpr::alloc(i, root->getDomain()), 0),
             construct(root->constantValues[i], 0));
       }
+    } else if (isBitvectorArray(root)) {
+      // The reads at symbolic indices see the same bytes as the reads at
+      // constant indices, which use the byte variables directly.
+      for (unsigned i = 0, e = root->size; i != e; ++i) {
+        Z3ASTHandle prev = array_expr;
+        array_expr = writeExpr(
+            prev, construct(ConstantExpr::alloc(i, root->getDomain()), 0),
+            getInitialByte(root, i));
+      }
     }
 
     _arr_hash.hashArrayExpr(root, array_expr);
@@ -387,7 +405,34 @@ Z3ASTHandle Z3Builder::getInitialArray(const Array *root) {
   return (array_expr);
 }
 
+bool Z3Builder::isBitvectorArray(const Array *root) const {
+  return !root->isConstantArray() && root->size <= BitvectorArraySize;
+}
+
+Z3ASTHandle Z3Builder::getInitialByte(const Array *root, unsigned index) {
+  assert(isBitvectorArray(root) && index < root->size);
+  std::vector<Z3ASTHandle> &bytes = _array_bytes[root];
+  if (bytes.empty()) {
+    // As for the arrays, the names are made unique by a counter.
+    std::string unique_id = llvm::itostr(_array_bytes.size());
+    unsigned const uid_length = unique_id.length();
+    unsigned const space = (root->name.length() > 32 - uid_length)
+                               ? (32 - uid_length)
+                               : root->name.length();
+    std::string unique_name = root->name.substr(0, space) + "!" + unique_id;
+    Z3SortHandle t = getBvSort(root->getRange());
+    for (unsigned i = 0; i != root->size; ++i) {
+      std::string name = unique_name + "_" + llvm::utostr(i);
+      Z3_symbol s = Z3_mk_string_symbol(ctx, name.c_str());
+      bytes.push_back(Z3ASTHandle(Z3_mk_const(ctx, s, t), ctx));
+    }
+  }
+  return bytes[index];
+}
+
 Z3ASTHandle Z3Builder::getInitialRead(const Array *root, unsigned index) {
+  if (isBitvectorArray(root) && index < root->size)
+    return getInitialByte(root, index);
   return readExpr(getInitialArray(root), bvConst32(32, index));
 }
 
@@ -484,7 +529,18 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     ReadExpr *re = cast<ReadExpr>(e);
     assert(re && re->updates.root);
     *width_out = re->updates.root->getRange();
-    return readExpr(getArrayForUpdate(re->updates.root, re->updates.head),
+    // A read at a constant index only needs the updates which may write it.
+    const UpdateNode *un = re->updates.head;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
+      uint64_t index = CE->getZExtValue();
+      if (un && (un = un->findUpdate(index)) && isa<ConstantExpr>(un->index))
+        return construct(un->value, width_out);
+      // Nor does a read of the initial bytes of a small symbolic array.
+      const Array *root = re->updates.root;
+      if (!un && isBitvectorArray(root) && index < root->size)
+        return getInitialByte(root, index);
+    }
+    return readExpr(getArrayForUpdate(re->updates.root, un),
                     construct(re->index, 0));
   }
 
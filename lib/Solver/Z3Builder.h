@@ -15,6 +15,9 @@
 #include "klee/Config/config.h"
 #include <z3.h>
 
+#include <map>
+#include <vector>
+
 namespace klee {
 
 template <typename T> class Z3NodeHandle {
@@ -108,6 +111,8 @@ public:
 class Z3Builder {
   ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
   Z3ArrayExprHash _arr_hash;
+  /// the byte variables of the arrays encoded as bitvectors
+  std::map<const Array *, std::vector<Z3ASTHandle> > _array_bytes;
 
 private:
   Z3ASTHandle bvOne(unsigned width);
@@ -160,6 +165,10 @@ private:
                                       Z3ASTHandle isSigned);
 
   Z3ASTHandle getInitialArray(const Array *os);
+  /// Is the array symbolic and of at most --bitvector-array-size bytes, and
+  /// so encoded as one variable per byte.
+  bool isBitvectorArray(const Array *root) const;
+  Z3ASTHandle getInitialByte(const Array *root, unsigned index);
   Z3ASTHandle getArrayForUpdate(const Array *root, const UpdateNode *un);
 
   Z3ASTHandle constructActual(ref<Expr> e, int *width_out);
@@ -190,6 +199,10 @@ public:
   }
 
   void clearConstructCache() { constructed.clear(); }
+
+  /// Drop the cached terms if there are more than --max-solver-term-cache of
+  /// them, they are otherwise kept across queries.
+  void trimCaches();
 };
 }
 
@@ -10,6 +10,7 @@
 #include "klee/Internal/Support/ErrorHandling.h"
 #ifdef ENABLE_Z3
 #include "Z3Builder.h"
+#include "klee/CommandLine.h"
 #include "klee/Constraints.h"
 #include "klee/Solver.h"
 #include "klee/SolverImpl.h"
@@ -28,6 +29,10 @@ private:
   ::Z3_params solverParameters;
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
+  /// solver kept across queries, with one scope per asserted constraint
+  /// (incremental mode)
+  ::Z3_solver incrementalSolver;
+  std::vector<ref<Expr> > asserted;
 
   bool internalRunSolver(const Query &,
                          const std::vector<const Array *> *objects,
@@ -66,15 +71,21 @@ public:
 
 Z3SolverImpl::Z3SolverImpl()
     : builder(new Z3Builder(/*autoClearConstructCache=*/false)), timeout(0.0),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), incrementalSolver(0) {
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
   timeoutParamStrSymbol = Z3_mk_string_symbol(builder->ctx, "timeout");
   setCoreSolverTimeout(timeout);
+  if (UseIncrementalCoreSolver) {
+    incrementalSolver = Z3_mk_simple_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, incrementalSolver);
+  }
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  if (incrementalSolver)
+    Z3_solver_dec_ref(builder->ctx, incrementalSolver);
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
@@ -91,8 +102,8 @@ void Z3Solver::setCoreSolverTimeout(double timeout) {
 
 char *Z3SolverImpl::getConstraintLog(const Query &query) {
   std::vector<Z3ASTHandle> assumptions;
-  for (std::vector<ref<Expr> >::const_iterator it = query.constraints.begin(),
-                                               ie = query.constraints.end();
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
        it != ie; ++it) {
     assumptions.push_back(builder->construct(*it));
   }
@@ -166,21 +177,41 @@ bool Z3SolverImpl::internalRunSolver(
     const Query &query, const std::vector<const Array *> *objects,
     std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
   TimerStatIncrementer t(stats::queryTime);
-  // TODO: Does making a new solver for each query have a performance
-  // impact vs making one global solver and using push and pop?
+  // With --use-incremental-solver one solver is kept and the constraints
+  // are pushed one scope each, otherwise a new solver is made per query.
   // TODO: is the "simple_solver" the right solver to use for
   // best performance?
-  Z3_solver theSolver = Z3_mk_simple_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
+  Z3_solver theSolver;
+  ConstraintManager::const_iterator it = query.constraints.begin(),
+                                    ie = query.constraints.end();
+  if (incrementalSolver) {
+    // Keep the prefix shared with the constraints of the previous query.
+    theSolver = incrementalSolver;
+    size_t common = 0;
+    while (common < asserted.size() && it != ie && asserted[common] == *it) {
+      ++common;
+      ++it;
+    }
+    if (common < asserted.size())
+      Z3_solver_pop(builder->ctx, theSolver, asserted.size() - common);
+    asserted.resize(common);
+  } else {
+    theSolver = Z3_mk_simple_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+  }
   Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
 
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
+  for (; it != ie; ++it) {
+    if (incrementalSolver) {
+      Z3_solver_push(builder->ctx, theSolver);
+      asserted.push_back(*it);
+    }
     Z3_solver_assert(builder->ctx, theSolver, builder->construct(*it));
   }
+  if (incrementalSolver)
+    Z3_solver_push(builder->ctx, theSolver);
   ++stats::queries;
   if (objects)
     ++stats::queryCounterexamples;
@@ -201,13 +232,15 @@ bool Z3SolverImpl::internalRunSolver(
   runStatusCode = handleSolverResponse(theSolver, satisfiable, objects, values,
                                        hasSolution);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
-  // Clear the builder's cache to prevent memory usage exploding.
-  // By using ``autoClearConstructCache=false`` and clearning now
-  // we allow Z3_ast expressions to be shared from an entire
-  // ``Query`` rather than only sharing within a single call to
-  // ``builder->construct()``.
-  builder->clearConstructCache();
+  if (incrementalSolver)
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  else
+    Z3_solver_dec_ref(builder->ctx, theSolver);
+  // Bound the builder's caches to prevent memory usage exploding.
+  // By using ``autoClearConstructCache=false`` and trimming now
+  // we allow Z3_ast expressions to be shared across queries
+  // rather than only within a single call to ``builder->construct()``.
+  builder->trimCaches();
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
       runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
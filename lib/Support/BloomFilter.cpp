@@ -0,0 +1,61 @@
+//===-- BloomFilter.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/BloomFilter.h"
+
+#include <cmath>
+
+using namespace klee;
+
+BloomFilter::BloomFilter(uint64_t _numBits, unsigned _numProbes)
+  : words((_numBits + 63) / 64), numProbes(_numProbes ? _numProbes : 1),
+    numInserted(0), numSet(0) {
+  if (words.empty())
+    words.resize(1);
+  numBits = words.size() * 64;
+}
+
+/// The probes are h1 + i * h2 (double hashing), with h2 from the 64 bit
+/// finalizer of MurmurHash3 so that similar hashes probe apart.
+uint64_t BloomFilter::getBit(uint64_t hash, unsigned probe) const {
+  uint64_t h2 = hash;
+  h2 ^= h2 >> 33;
+  h2 *= 0xff51afd7ed558ccdULL;
+  h2 ^= h2 >> 33;
+  h2 *= 0xc4ceb9fe1a85ec53ULL;
+  h2 ^= h2 >> 33;
+  return (hash + probe * (h2 | 1)) % numBits;
+}
+
+bool BloomFilter::contains(uint64_t hash) const {
+  for (unsigned i = 0; i < numProbes; i++) {
+    uint64_t bit = getBit(hash, i);
+    if (!(words[bit / 64] & (1ULL << (bit % 64))))
+      return false;
+  }
+  return true;
+}
+
+bool BloomFilter::insert(uint64_t hash) {
+  if (contains(hash))
+    return false;
+  for (unsigned i = 0; i < numProbes; i++) {
+    uint64_t bit = getBit(hash, i), mask = 1ULL << (bit % 64);
+    if (!(words[bit / 64] & mask)) {
+      words[bit / 64] |= mask;
+      numSet++;
+    }
+  }
+  numInserted++;
+  return true;
+}
+
+double BloomFilter::getFalsePositiveRate() const {
+  return std::pow((double) numSet / numBits, (double) numProbes);
+}
@@ -0,0 +1,108 @@
+//===-- BranchHistory.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+#include "klee/Config/config.h"
+#ifdef HAVE_ZLIB_H
+#include "klee/Internal/Support/BranchHistory.h"
+#include "klee/Internal/Support/CompressionStream.h"
+
+#include <string.h>
+
+using namespace klee;
+
+/// the first bytes of the uncompressed stream, plain logs start with a
+/// branch or a newline
+static const char magic[] = "KBRH\x01";
+static const size_t magicSize = sizeof(magic) - 1;
+
+static void writeNumber(llvm::raw_ostream &os, size_t value) {
+  while (value >= 0x80) {
+    os << (char) (0x80 | (value & 0x7f));
+    value >>= 7;
+  }
+  os << (char) value;
+}
+
+BranchHistoryWriter::BranchHistoryWriter(const std::string &path,
+                                         std::string &error)
+    : os(new compressed_fd_ostream(path.c_str(), error)) {
+  if (error.empty())
+    os->write(magic, magicSize);
+}
+
+BranchHistoryWriter::~BranchHistoryWriter() {
+  delete os;
+}
+
+void BranchHistoryWriter::write(const std::vector<char> &path) {
+  size_t shared = 0;
+  while (shared < path.size() && shared < previous.size() &&
+         path[shared] == previous[shared])
+    shared++;
+  writeNumber(*os, shared);
+  writeNumber(*os, path.size() - shared);
+  if (shared < path.size())
+    os->write(&path[shared], path.size() - shared);
+  previous = path;
+}
+
+BranchHistoryReader::BranchHistoryReader(const std::string &path)
+    : file(gzopen(path.c_str(), "rb")), binary(false) {
+  if (!file)
+    return;
+
+  /* gzread passes plain files through */
+  char header[magicSize];
+  int read = gzread((gzFile) file, header, magicSize);
+  if (read == (int) magicSize && !memcmp(header, magic, magicSize)) {
+    binary = true;
+  } else {
+    gzrewind((gzFile) file);
+  }
+}
+
+BranchHistoryReader::~BranchHistoryReader() {
+  if (file)
+    gzclose((gzFile) file);
+}
+
+bool BranchHistoryReader::readNumber(size_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 8 * sizeof(size_t); shift += 7) {
+    int c = gzgetc((gzFile) file);
+    if (c < 0)
+      return false;
+    value |= (size_t) (c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool BranchHistoryReader::next(std::vector<char> &path) {
+  if (!file)
+    return false;
+
+  if (!binary) {
+    path.clear();
+    int c;
+    while ((c = gzgetc((gzFile) file)) >= 0 && c != '\n')
+      path.push_back(c);
+    return c == '\n' || !path.empty();
+  }
+
+  size_t shared, added;
+  if (!readNumber(shared) || !readNumber(added) || shared > current.size())
+    return false;
+  current.resize(shared + added);
+  if (added && gzread((gzFile) file, &current[shared], added) != (int) added)
+    return false;
+  path = current;
+  return true;
+}
+#endif
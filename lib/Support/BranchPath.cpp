@@ -0,0 +1,48 @@
+//===-- BranchPath.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/BranchPath.h"
+
+using namespace klee;
+
+void BranchPath::push_back(char branch) {
+  /* append in place when this path ends where the last chunk does */
+  if (last.isNull() || length != last->start + last->used ||
+      last->used == ChunkSize)
+    last = new Chunk(last, length);
+  last->data[last->used++] = branch;
+  length++;
+}
+
+void BranchPath::clear() {
+  last = 0;
+  length = 0;
+}
+
+void BranchPath::assign(const char *begin, const char *end) {
+  clear();
+  for (; begin != end; ++begin)
+    push_back(*begin);
+}
+
+void BranchPath::toVector(std::vector<char> &branches) const {
+  branches.resize(length);
+  size_t end = length;
+  for (Chunk *c = last.get(); c; c = c->parent.get()) {
+    for (size_t i = c->start; i < end; i++)
+      branches[i] = c->data[i - c->start];
+    end = c->start;
+  }
+}
+
+std::vector<char> BranchPath::toVector() const {
+  std::vector<char> branches;
+  toVector(branches);
+  return branches;
+}
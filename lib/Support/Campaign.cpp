@@ -0,0 +1,141 @@
+//===-- Campaign.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/Campaign.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+
+using namespace klee;
+
+static bool parseUnsigned(const std::string &text, unsigned &value) {
+  if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos)
+    return false;
+  value = strtoul(text.c_str(), 0, 10);
+  return true;
+}
+
+bool Campaign::parse(std::istream &is, std::string &error) {
+  configs.clear();
+  std::string line;
+  for (unsigned lineNo = 1; std::getline(is, line); lineNo++) {
+    std::ostringstream where;
+    where << "line " << lineNo << ": ";
+    std::string::size_type hash = line.find('#');
+    if (hash != std::string::npos)
+      line.erase(hash);
+    std::istringstream words(line);
+    Config config;
+    std::string priority;
+    if (!(words >> config.name))
+      continue;
+    if (!(words >> priority) || !parseUnsigned(priority, config.priority) ||
+        !config.priority) {
+      error = where.str() + "expected a priority above 0 after the name";
+      return false;
+    }
+    for (unsigned i = 0; i < configs.size(); i++) {
+      if (configs[i].name == config.name) {
+        error = where.str() + "configuration " + config.name + " repeated";
+        return false;
+      }
+    }
+
+    std::string word;
+    while (words >> word) {
+      if (word == "--") {
+        config.hasArgs = true;
+        while (words >> word)
+          config.args.push_back(word);
+        break;
+      }
+      std::string::size_type eq = word.find('=');
+      std::string key = word.substr(0, eq);
+      std::string value = eq == std::string::npos ? "" : word.substr(eq + 1);
+      bool valid = !value.empty();
+      if (key == "error-location")
+        config.errorLocation = value;
+      else if (key == "search")
+        config.search = value;
+      else if (key == "timeout")
+        valid = parseUnsigned(value, config.timeOut);
+      else
+        valid = false;
+      if (!valid) {
+        error = where.str() + "invalid setting " + word;
+        return false;
+      }
+    }
+    configs.push_back(config);
+  }
+  if (configs.empty()) {
+    error = "no configurations";
+    return false;
+  }
+  return true;
+}
+
+bool Campaign::read(const std::string &path, std::string &error) {
+  std::ifstream is(path.c_str());
+  if (!is) {
+    error = "unable to open " + path + ": " + strerror(errno);
+    return false;
+  }
+  if (!parse(is, error)) {
+    error = path + ": " + error;
+    return false;
+  }
+  return true;
+}
+
+bool Campaign::partition(unsigned numRanks, unsigned minRanks,
+                         std::vector<unsigned> &blocks) const {
+  if (empty() || numRanks < size() * minRanks)
+    return false;
+  blocks.assign(size(), minRanks);
+  unsigned spare = numRanks - size() * minRanks;
+  uint64_t total = 0;
+  for (unsigned i = 0; i < size(); i++)
+    total += configs[i].priority;
+
+  // the whole shares first, then the largest remainders, the first
+  // configuration among ties
+  std::vector<uint64_t> remainders(size());
+  unsigned given = 0;
+  for (unsigned i = 0; i < size(); i++) {
+    uint64_t share = (uint64_t) spare * configs[i].priority;
+    blocks[i] += share / total;
+    given += share / total;
+    remainders[i] = share % total;
+  }
+  for (; given < spare; given++) {
+    unsigned best = 0;
+    for (unsigned i = 1; i < size(); i++)
+      if (remainders[i] > remainders[best])
+        best = i;
+    ++blocks[best];
+    remainders[best] = 0;
+  }
+  return true;
+}
+
+unsigned Campaign::getConfig(const std::vector<unsigned> &blocks,
+                             unsigned rank) {
+  unsigned end = 0;
+  for (unsigned i = 0; i < blocks.size(); i++) {
+    end += blocks[i];
+    if (rank < end)
+      return i;
+  }
+  return blocks.size() - 1;
+}
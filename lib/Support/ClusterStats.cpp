@@ -0,0 +1,85 @@
+//===-- ClusterStats.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/ClusterStats.h"
+
+#include <cassert>
+
+using namespace klee;
+
+static const char *fieldNames[ClusterStats::NumFields] = {
+  "Instructions", "States", "SuspendedStates", "SolverTime", "Queries",
+  "CacheHits", "CoveredInstructions", "Offloads", "ReplayTime",
+  "ExplorationTime", "RecoveryTime", "IdleTime", "ExprMemory",
+  "ObjectMemory", "ConstraintMemory", "SnapshotMemory", "SolverCacheMemory",
+  "PTreeMemory", "PrefixTreeMemory"
+};
+
+const char *ClusterStats::getName(Field field) {
+  assert(field < NumFields);
+  return fieldNames[field];
+}
+
+void ClusterStats::update(unsigned rank, const uint64_t *record) {
+  if (rank >= records.size())
+    records.resize(rank + 1);
+  records[rank].assign(record, record + NumFields);
+}
+
+uint64_t ClusterStats::getTotal(Field field) const {
+  assert(field < NumFields);
+  uint64_t total = 0;
+  for (unsigned i = 0; i < records.size(); i++)
+    if (!records[i].empty())
+      total += records[i][field];
+  return total;
+}
+
+unsigned ClusterStats::getNumReporting() const {
+  unsigned count = 0;
+  for (unsigned i = 0; i < records.size(); i++)
+    if (!records[i].empty())
+      count++;
+  return count;
+}
+
+void ClusterStats::writeHeader(std::ostream &os) const {
+  os << "Time\tWorkers";
+  for (unsigned i = 0; i < NumFields; i++)
+    os << "\t" << fieldNames[i];
+  os << "\n";
+}
+
+void ClusterStats::writeRow(std::ostream &os, double elapsed) const {
+  os << elapsed << "\t" << getNumReporting();
+  for (unsigned i = 0; i < NumFields; i++)
+    os << "\t" << getTotal((Field) i);
+  os << "\n";
+}
+
+void ClusterStats::writeJSON(std::ostream &os, double elapsed) const {
+  os << "{\"time\": " << elapsed << ", \"workers\": " << getNumReporting()
+     << ", \"total\": {";
+  for (unsigned i = 0; i < NumFields; i++)
+    os << (i ? ", " : "") << "\"" << fieldNames[i] << "\": "
+       << getTotal((Field) i);
+  os << "}, \"ranks\": {";
+  bool first = true;
+  for (unsigned rank = 0; rank < records.size(); rank++) {
+    if (records[rank].empty())
+      continue;
+    os << (first ? "" : ", ") << "\"" << rank << "\": {";
+    first = false;
+    for (unsigned i = 0; i < NumFields; i++)
+      os << (i ? ", " : "") << "\"" << fieldNames[i] << "\": "
+         << records[rank][i];
+    os << "}";
+  }
+  os << "}}\n";
+}
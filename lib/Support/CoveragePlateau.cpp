@@ -0,0 +1,47 @@
+//===-- CoveragePlateau.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/CoveragePlateau.h"
+
+using namespace klee;
+
+CoveragePlateau::CoveragePlateau(double _window, uint64_t _minCovered,
+                                 double now)
+  : window(_window), minCovered(_minCovered), since(now), inWindow(0) {}
+
+void CoveragePlateau::expire(double now) {
+  while (!samples.empty() && samples.front().first <= now - window) {
+    inWindow -= samples.front().second;
+    samples.pop_front();
+  }
+}
+
+void CoveragePlateau::record(double now, uint64_t newlyCovered) {
+  if (!isEnabled() || !newlyCovered)
+    return;
+  samples.push_back(std::make_pair(now, newlyCovered));
+  inWindow += newlyCovered;
+}
+
+uint64_t CoveragePlateau::getCovered(double now) {
+  expire(now);
+  return inWindow;
+}
+
+bool CoveragePlateau::isReached(double now) {
+  if (!isEnabled() || now - since < window)
+    return false;
+  return getCovered(now) < minCovered;
+}
+
+void CoveragePlateau::reset(double now) {
+  since = now;
+  samples.clear();
+  inWindow = 0;
+}
@@ -0,0 +1,173 @@
+//===-- EventTrace.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/EventTrace.h"
+#include "klee/Internal/System/Time.h"
+
+#include <cassert>
+#include <string.h>
+
+using namespace klee;
+
+static const char packetMagic[4] = { 'K', 'T', 'R', 'C' };
+
+static const char *kindNames[EventTrace::NumKinds] = {
+  "OffloadRequest", "OffloadResponse", "Task", "ReplayDone", "SolverCall",
+  "Recovery", "MemoryKill"
+};
+
+template <typename T>
+static void put(std::vector<char> &out, T value) {
+  const char *p = reinterpret_cast<const char *>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+static bool get(const char *&p, const char *end, T &value) {
+  if ((size_t) (end - p) < sizeof(T))
+    return false;
+  memcpy(&value, p, sizeof(T));
+  p += sizeof(T);
+  return true;
+}
+
+void EventTrace::setCapacity(size_t capacity) {
+  ring.assign(capacity, Event());
+  numRecorded = 0;
+}
+
+void EventTrace::getEvents(std::vector<Event> &out) const {
+  if (numRecorded <= ring.size()) {
+    out.insert(out.end(), ring.begin(), ring.begin() + numRecorded);
+    return;
+  }
+  size_t oldest = numRecorded % ring.size();
+  out.insert(out.end(), ring.begin() + oldest, ring.end());
+  out.insert(out.end(), ring.begin(), ring.begin() + oldest);
+}
+
+uint64_t EventTrace::getNumDropped() const {
+  return numRecorded > ring.size() ? numRecorded - ring.size() : 0;
+}
+
+void EventTrace::encode(uint64_t now, std::vector<char> &out) const {
+  std::vector<Event> events;
+  getEvents(events);
+  out.insert(out.end(), packetMagic, packetMagic + sizeof(packetMagic));
+  put<uint64_t>(out, now);
+  put<uint64_t>(out, getNumDropped());
+  put<uint32_t>(out, events.size());
+  for (unsigned i = 0; i < events.size(); i++) {
+    put<uint64_t>(out, events[i].start);
+    put<uint64_t>(out, events[i].duration);
+    put<uint32_t>(out, events[i].kind);
+    put<uint32_t>(out, events[i].arg);
+  }
+}
+
+bool EventTrace::decode(const char *buffer, size_t size, uint64_t &sent,
+                        uint64_t &dropped, std::vector<Event> &out) {
+  const char *p = buffer, *end = buffer + size;
+  uint32_t count;
+  if (size < sizeof(packetMagic) ||
+      memcmp(buffer, packetMagic, sizeof(packetMagic)) != 0)
+    return false;
+  p += sizeof(packetMagic);
+  if (!get(p, end, sent) || !get(p, end, dropped) || !get(p, end, count) ||
+      count > size)
+    return false;
+
+  std::vector<Event> events(count);
+  for (unsigned i = 0; i < count; i++) {
+    Event &event = events[i];
+    if (!get(p, end, event.start) || !get(p, end, event.duration) ||
+        !get(p, end, event.kind) || !get(p, end, event.arg) ||
+        event.kind >= NumKinds)
+      return false;
+  }
+  if (p != end)
+    return false;
+  out.insert(out.end(), events.begin(), events.end());
+  return true;
+}
+
+const char *EventTrace::getName(Kind kind) {
+  assert(kind < NumKinds);
+  return kindNames[kind];
+}
+
+uint64_t EventTrace::now() {
+  return (uint64_t) (util::getWallTime() * 1000000.);
+}
+
+EventTrace &EventTrace::getProcessTrace() {
+  static EventTrace trace;
+  return trace;
+}
+
+/***/
+
+void TraceMerger::add(unsigned rank,
+                      const std::vector<EventTrace::Event> &events,
+                      int64_t offset, uint64_t dropped) {
+  ranks.push_back(RankTrace());
+  RankTrace &trace = ranks.back();
+  trace.rank = rank;
+  trace.dropped = dropped;
+  trace.events = events;
+  for (unsigned i = 0; i < trace.events.size(); i++)
+    trace.events[i].start -= offset;
+}
+
+bool TraceMerger::addPacket(unsigned rank, const char *buffer, size_t size,
+                            uint64_t received) {
+  uint64_t sent, dropped;
+  std::vector<EventTrace::Event> events;
+  if (!EventTrace::decode(buffer, size, sent, dropped, events))
+    return false;
+  add(rank, events, (int64_t) (sent - received), dropped);
+  return true;
+}
+
+void TraceMerger::writeChromeTrace(std::ostream &os) const {
+  uint64_t origin = 0;
+  bool first = true;
+  for (unsigned i = 0; i < ranks.size(); i++)
+    for (unsigned j = 0; j < ranks[i].events.size(); j++)
+      if (first || ranks[i].events[j].start < origin) {
+        origin = ranks[i].events[j].start;
+        first = false;
+      }
+
+  os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  first = true;
+  for (unsigned i = 0; i < ranks.size(); i++) {
+    const RankTrace &trace = ranks[i];
+    os << (first ? "" : ",") << "\n{\"name\": \"process_name\", \"ph\": \"M\", "
+       << "\"pid\": " << trace.rank << ", \"args\": {\"name\": \""
+       << (trace.rank ? "worker " : "master ") << trace.rank;
+    if (trace.dropped)
+      os << " (" << trace.dropped << " events dropped)";
+    os << "\"}}";
+    first = false;
+    for (unsigned j = 0; j < trace.events.size(); j++) {
+      const EventTrace::Event &event = trace.events[j];
+      os << ",\n{\"name\": \""
+         << EventTrace::getName((EventTrace::Kind) event.kind)
+         << "\", \"pid\": " << trace.rank << ", \"tid\": 0, \"ts\": "
+         << event.start - origin;
+      if (event.duration)
+        os << ", \"ph\": \"X\", \"dur\": " << event.duration;
+      else
+        os << ", \"ph\": \"i\", \"s\": \"p\"";
+      os << ", \"args\": {\"arg\": " << event.arg << "}}";
+    }
+  }
+  os << "\n]}\n";
+}
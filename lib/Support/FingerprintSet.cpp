@@ -0,0 +1,44 @@
+//===-- FingerprintSet.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/FingerprintSet.h"
+
+#include <string.h>
+
+using namespace klee;
+
+bool FingerprintSet::insert(uint64_t fingerprint) {
+  if (seen.count(fingerprint))
+    return false;
+  if (seen.size() < capacity) {
+    seen.insert(fingerprint);
+    outgoing.push_back(fingerprint);
+  }
+  return true;
+}
+
+bool FingerprintSet::takeOutgoing(std::vector<char> &packet) {
+  if (outgoing.empty())
+    return false;
+  packet.resize(outgoing.size() * sizeof(uint64_t));
+  memcpy(&packet[0], &outgoing[0], packet.size());
+  outgoing.clear();
+  return true;
+}
+
+bool FingerprintSet::addPacket(const char *data, size_t n) {
+  if (n % sizeof(uint64_t))
+    return false;
+  for (size_t i = 0; i < n && seen.size() < capacity; i += sizeof(uint64_t)) {
+    uint64_t fingerprint;
+    memcpy(&fingerprint, data + i, sizeof(fingerprint));
+    seen.insert(fingerprint);
+  }
+  return true;
+}
@@ -120,3 +120,20 @@ size_t util::GetTotalMallocUsage() {
 
 #endif
 }
+
+static const char *categoryNames[util::NumMemoryCategories] = {
+  "Expr", "Object", "Constraint", "Snapshot", "SolverCache", "PTree",
+  "PrefixTree"
+};
+
+const char *util::GetMemoryCategoryName(MemoryCategory category) {
+  return categoryNames[category];
+}
+
+util::MemoryCategory util::GetLargestMemoryCategory() {
+  MemoryCategory largest = ExprMemory;
+  for (unsigned i = 1; i < NumMemoryCategories; i++)
+    if (GetMemoryUsage((MemoryCategory) i) > GetMemoryUsage(largest))
+      largest = (MemoryCategory) i;
+  return largest;
+}
@@ -0,0 +1,96 @@
+//===-- PathInterval.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/PathInterval.h"
+
+#include <cassert>
+
+using namespace klee;
+
+/// the first k bits of bits, padded with zeros
+static std::string firstBits(const std::string &bits, size_t k) {
+  std::string res = bits.substr(0, k);
+  res.resize(k, '0');
+  return res;
+}
+
+/// compare the fractions 0.a and 0.b
+static int compareFractions(const std::string &a, const std::string &b) {
+  size_t n = a.size() > b.size() ? a.size() : b.size();
+  return firstBits(a, n).compare(firstBits(b, n));
+}
+
+bool PathInterval::isAll() const {
+  return lower.find('1') == std::string::npos && upper.empty();
+}
+
+bool PathInterval::overlaps(const std::string &prefix) const {
+  // the subtree ends at or before lower if prefix < the first bits of lower
+  if (prefix < firstBits(lower, prefix.size()))
+    return false;
+  return upper.empty() || compareFractions(prefix, upper) < 0;
+}
+
+bool PathInterval::contains(const std::string &prefix) const {
+  if (compareFractions(prefix, lower) < 0)
+    return false;
+  // the subtree ends at or before upper if prefix < the first bits of upper
+  return upper.empty() || prefix < firstBits(upper, prefix.size());
+}
+
+bool PathInterval::owns(const std::string &path) const {
+  return compareFractions(path, lower) >= 0 &&
+         (upper.empty() || compareFractions(path, upper) < 0);
+}
+
+std::string PathInterval::encode() const {
+  return lower + "-" + upper;
+}
+
+bool PathInterval::decode(const char *data, size_t size, PathInterval &out) {
+  std::string s(data, size);
+  size_t dash = s.find('-');
+  if (dash == std::string::npos ||
+      s.find_first_not_of("01-") != std::string::npos ||
+      s.find('-', dash + 1) != std::string::npos)
+    return false;
+  out = PathInterval(s.substr(0, dash), s.substr(dash + 1));
+  return true;
+}
+
+std::string PathInterval::getForks(const std::vector<char> &history) {
+  std::string forks;
+  for (unsigned i = 0; i < history.size(); i++) {
+    if (history[i] == '0' || history[i] == '1')
+      forks.push_back(history[i]);
+  }
+  return forks;
+}
+
+void PathInterval::split(unsigned n, std::vector<PathInterval> &out) {
+  assert(n > 0 && "no intervals to split into");
+  unsigned depth = 8;
+  for (unsigned m = n - 1; m; m >>= 1)
+    depth++;
+
+  // the binary expansion of i/n, by long division
+  std::vector<std::string> bounds(n + 1);
+  for (unsigned i = 1; i < n; i++) {
+    unsigned long long rest = i;
+    for (unsigned b = 0; b < depth; b++) {
+      rest *= 2;
+      bool bit = rest >= n;
+      if (bit)
+        rest -= n;
+      bounds[i].push_back(bit ? '1' : '0');
+    }
+  }
+  for (unsigned i = 0; i < n; i++)
+    out.push_back(PathInterval(bounds[i], bounds[i + 1]));
+}
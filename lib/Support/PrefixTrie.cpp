@@ -0,0 +1,58 @@
+//===-- PrefixTrie.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/PrefixTrie.h"
+
+#include <assert.h>
+
+using namespace klee;
+
+static unsigned getIndex(char branch) {
+  assert(branch >= '0' && branch < '0' + PrefixTrie::NumBranches &&
+         "invalid branch");
+  return branch - '0';
+}
+
+void PrefixTrie::add(const char *branches, size_t length, size_t depth) {
+  /* copy the nodes on the way which other positions share */
+  ref<Node> *slot = &node;
+  for (size_t i = depth;; i++) {
+    if (slot->isNull())
+      *slot = new Node();
+    else if ((*slot)->refCount > 1)
+      *slot = new Node(**slot);
+    (*slot)->count++;
+    /* a prefix may be terminated by a dash */
+    if (i >= length || branches[i] < '0' ||
+        branches[i] >= '0' + NumBranches)
+      break;
+    slot = &(*slot)->children[getIndex(branches[i])];
+  }
+}
+
+bool PrefixTrie::hasNext() const {
+  if (node.isNull())
+    return false;
+  for (unsigned i = 0; i < NumBranches; i++)
+    if (!node->children[i].isNull())
+      return true;
+  return false;
+}
+
+bool PrefixTrie::hasNext(char branch) const {
+  return !node.isNull() && !node->children[getIndex(branch)].isNull();
+}
+
+void PrefixTrie::advance(char branch) {
+  if (node.isNull())
+    return;
+  /* the child must outlive the node it is taken from */
+  ref<Node> child = node->children[getIndex(branch)];
+  node = child;
+}
@@ -0,0 +1,96 @@
+//===-- SearchPortfolio.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/SearchPortfolio.h"
+
+#include <cassert>
+
+using namespace klee;
+
+const double SearchPortfolio::MinShareFactor = 0.1;
+
+SearchPortfolio::SearchPortfolio(const std::vector<std::string> &_heuristics,
+                                 unsigned numRanks)
+  : heuristics(_heuristics), assigned(numRanks, -1),
+    covered(_heuristics.size(), 0), samples(_heuristics.size(), 0) {}
+
+double SearchPortfolio::getRate(unsigned heuristic) const {
+  assert(heuristic < heuristics.size());
+  if (!samples[heuristic])
+    return 0;
+  return (double) covered[heuristic] / samples[heuristic];
+}
+
+int SearchPortfolio::getAssigned(unsigned rank) const {
+  return rank < assigned.size() ? assigned[rank] : -1;
+}
+
+double SearchPortfolio::getWeight(unsigned heuristic) const {
+  double best = 0;
+  for (unsigned i = 0; i < heuristics.size(); i++)
+    if (samples[i] && getRate(i) > best)
+      best = getRate(i);
+  if (best == 0)
+    return 1;
+  if (!samples[heuristic])
+    return best;
+  double rate = getRate(heuristic);
+  return rate < best * MinShareFactor ? best * MinShareFactor : rate;
+}
+
+const std::string &SearchPortfolio::assign(unsigned rank) {
+  assert(!empty() && rank < assigned.size());
+  release(rank);
+
+  std::vector<unsigned> running(heuristics.size(), 0);
+  unsigned busy = 1;
+  for (unsigned r = 0; r < assigned.size(); r++) {
+    if (assigned[r] >= 0) {
+      ++running[assigned[r]];
+      ++busy;
+    }
+  }
+  double total = 0;
+  for (unsigned i = 0; i < heuristics.size(); i++)
+    total += getWeight(i);
+
+  // the heuristic furthest below its share, the first one among ties
+  unsigned picked = 0;
+  double bestDeficit = 0;
+  for (unsigned i = 0; i < heuristics.size(); i++) {
+    double deficit = busy * getWeight(i) / total - running[i];
+    if (i == 0 || deficit > bestDeficit + 1e-9) {
+      picked = i;
+      bestDeficit = deficit;
+    }
+  }
+  assigned[rank] = picked;
+  return heuristics[picked];
+}
+
+const std::string &SearchPortfolio::rotate(unsigned rank) {
+  assert(!empty() && rank < assigned.size());
+  if (assigned[rank] < 0)
+    return assign(rank);
+  assigned[rank] = (assigned[rank] + 1) % heuristics.size();
+  return heuristics[assigned[rank]];
+}
+
+void SearchPortfolio::release(unsigned rank) {
+  if (rank < assigned.size())
+    assigned[rank] = -1;
+}
+
+void SearchPortfolio::recordCoverage(unsigned rank, unsigned newlyCovered) {
+  int heuristic = getAssigned(rank);
+  if (heuristic < 0)
+    return;
+  covered[heuristic] += newlyCovered;
+  ++samples[heuristic];
+}
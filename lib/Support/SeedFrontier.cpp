@@ -0,0 +1,96 @@
+//===-- SeedFrontier.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/SeedFrontier.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+bool SeedFrontier::covers(const std::vector<std::string> &sorted,
+                          const std::string &path) {
+  // A prefix of path sorts before it, and so does everything between them
+  // which starts with it. None of those is a prefix of another, so the
+  // prefix is the last one not after path.
+  std::vector<std::string>::const_iterator it =
+      std::upper_bound(sorted.begin(), sorted.end(), path);
+  if (it == sorted.begin())
+    return false;
+  --it;
+  return it->size() <= path.size() && path.compare(0, it->size(), *it) == 0;
+}
+
+/// Sort the frontier and drop the prefixes under another one.
+static void normalize(std::vector<std::string> &frontier) {
+  std::sort(frontier.begin(), frontier.end());
+  std::vector<std::string>::iterator out = frontier.begin();
+  for (std::vector<std::string>::iterator it = frontier.begin(),
+                                          ie = frontier.end();
+       it != ie; ++it) {
+    // the prefixes of a path sort before it, and the paths between them
+    // are dropped for being under the one kept last
+    if (out != frontier.begin()) {
+      const std::string &last = *(out - 1);
+      if (last.size() <= it->size() && it->compare(0, last.size(), last) == 0)
+        continue;
+    }
+    if (out != it)
+      out->swap(*it);
+    ++out;
+  }
+  frontier.erase(out, frontier.end());
+}
+
+void SeedFrontier::add(std::vector<std::string> frontier) {
+  normalize(frontier);
+  if (!started) {
+    prefixes.swap(frontier);
+    started = true;
+    return;
+  }
+
+  // A path is under both frontiers if it is under a prefix of each, so
+  // under the longer of the two. Keep the prefixes of either frontier
+  // which the other one covers.
+  std::vector<std::string> both;
+  for (unsigned i = 0; i < prefixes.size(); i++)
+    if (covers(frontier, prefixes[i]))
+      both.push_back(prefixes[i]);
+  for (unsigned i = 0; i < frontier.size(); i++)
+    if (covers(prefixes, frontier[i]))
+      both.push_back(frontier[i]);
+  std::sort(both.begin(), both.end());
+  both.erase(std::unique(both.begin(), both.end()), both.end());
+  prefixes.swap(both);
+}
+
+void GenerationFrontier::add(const std::vector<std::string> &notTaken,
+                             const std::vector<std::string> &paths) {
+  branches.insert(branches.end(), notTaken.begin(), notTaken.end());
+  finished.insert(finished.end(), paths.begin(), paths.end());
+}
+
+std::vector<std::string> GenerationFrontier::getPrefixes() const {
+  std::vector<std::string> paths(finished);
+  std::sort(paths.begin(), paths.end());
+
+  // The paths starting with a branch sort right after it, a branch a seed
+  // went through is dropped before the ones below it are, which stay.
+  std::vector<std::string> left;
+  for (unsigned i = 0; i < branches.size(); i++) {
+    const std::string &branch = branches[i];
+    std::vector<std::string>::const_iterator it =
+        std::lower_bound(paths.begin(), paths.end(), branch);
+    if (it != paths.end() && it->compare(0, branch.size(), branch) == 0)
+      continue;
+    left.push_back(branch);
+  }
+  normalize(left);
+  return left;
+}
@@ -0,0 +1,528 @@
+//===-- ShmMPI.cpp --------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+// Only built instead of an MPI library (-DENABLE_SHM_TRANSPORT=ON)
+#ifdef KLEE_SHM_MPI
+
+#include "klee/Internal/Support/ShmMPI.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+  /// The tags of the collectives, which MPI_ANY_TAG does not match.
+  enum { SplitTag = -10, BcastTag = -11, GatherTag = -12 };
+
+  /// The bytes from one rank to another, written by the first and read by
+  /// the second only.
+  struct Ring {
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+  };
+
+  /// What precedes the bytes of a message in a ring.
+  struct Header {
+    int32_t context;
+    int32_t tag;
+    uint32_t length;
+  };
+
+  struct Message {
+    int source;
+    int context;
+    int tag;
+    std::vector<char> data;
+  };
+
+  /// A message of a ring taken in partly.
+  struct Partial {
+    bool hasHeader;
+    Header header;
+    std::vector<char> data;
+  };
+
+  struct Communicator {
+    int context;
+    /// the world rank of every rank of the communicator
+    std::vector<int> ranks;
+    int rank;
+    /// the communicators split off so far, the same on all its ranks
+    unsigned splits;
+    bool freed;
+  };
+
+  int worldRank = 0, worldSize = 0;
+  bool initialized = false;
+  size_t ringSize;
+  /// the shared mapping: the pids of the ranks, then the ring of every
+  /// pair with its bytes
+  char *shared;
+  size_t sharedSize;
+  pid_t *pids;
+  std::vector<Partial> partials;
+  std::deque<Message> inbox;
+  std::vector<Communicator> comms;
+  std::recursive_mutex lock;
+}
+
+static Ring *getRing(int from, int to) {
+  size_t offset = (worldSize * sizeof(pid_t) + 63) / 64 * 64;
+  offset += (size_t) (from * worldSize + to) * (sizeof(Ring) + ringSize);
+  return (Ring *) (shared + offset);
+}
+
+static char *getBytes(Ring *ring) {
+  return (char *) (ring + 1);
+}
+
+/// Copy n bytes out of the ring of the reader, which has them.
+static void readRing(Ring *ring, void *out, size_t n) {
+  uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+  size_t at = tail % ringSize, first = std::min(n, ringSize - at);
+  memcpy(out, getBytes(ring) + at, first);
+  memcpy((char *) out + first, getBytes(ring), n - first);
+  ring->tail.store(tail + n, std::memory_order_release);
+}
+
+/// Copy up to n bytes into the ring of the writer, returns the bytes
+/// copied.
+static size_t writeRing(Ring *ring, const void *in, size_t n) {
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  size_t room = ringSize - (head - ring->tail.load(std::memory_order_acquire));
+  n = std::min(n, room);
+  size_t at = head % ringSize, first = std::min(n, ringSize - at);
+  memcpy(getBytes(ring) + at, in, first);
+  memcpy(getBytes(ring), (const char *) in + first, n - first);
+  ring->head.store(head + n, std::memory_order_release);
+  return n;
+}
+
+/// Move the bytes the other ranks sent into the inbox.
+static void drain() {
+  for (int from = 0; from < worldSize; from++) {
+    Ring *ring = getRing(from, worldRank);
+    Partial &p = partials[from];
+    while (true) {
+      size_t available = ring->head.load(std::memory_order_acquire) -
+                         ring->tail.load(std::memory_order_relaxed);
+      if (!p.hasHeader) {
+        if (available < sizeof(Header))
+          break;
+        readRing(ring, &p.header, sizeof(Header));
+        p.hasHeader = true;
+        p.data.clear();
+        p.data.reserve(p.header.length);
+        available -= sizeof(Header);
+      }
+      size_t n = std::min(available, (size_t) p.header.length - p.data.size());
+      size_t at = p.data.size();
+      p.data.resize(at + n);
+      if (n)
+        readRing(ring, &p.data[at], n);
+      if (p.data.size() < p.header.length)
+        break;
+      Message m;
+      m.source = from;
+      m.context = p.header.context;
+      m.tag = p.header.tag;
+      m.data.swap(p.data);
+      inbox.push_back(m);
+      p.hasHeader = false;
+    }
+  }
+}
+
+/// Wait for room in a ring, taking in the messages sent meanwhile.
+static void waitForRoom(int to) {
+  drain();
+  if (kill(pids[to], 0) != 0) {
+    // nobody will read the ring again
+    _exit(1);
+  }
+  sched_yield();
+}
+
+static void sendBytes(int to, const void *data, size_t n) {
+  Ring *ring = getRing(worldRank, to);
+  const char *bytes = (const char *) data;
+  while (n) {
+    size_t sent = writeRing(ring, bytes, n);
+    bytes += sent;
+    n -= sent;
+    if (n)
+      waitForRoom(to);
+  }
+}
+
+static bool isValid(MPI_Comm comm) {
+  return comm >= 0 && comm < (int) comms.size() && !comms[comm].freed;
+}
+
+/// The first message of the inbox for the communicator, source (a rank of
+/// it) and tag, inbox.end() if there is none.
+static std::deque<Message>::iterator match(MPI_Comm comm, int source,
+                                           int tag) {
+  const Communicator &c = comms[comm];
+  for (std::deque<Message>::iterator it = inbox.begin(), ie = inbox.end();
+       it != ie; ++it) {
+    if (it->context != c.context)
+      continue;
+    if (source != MPI_ANY_SOURCE && c.ranks[source] != it->source)
+      continue;
+    if (tag == MPI_ANY_TAG ? it->tag < 0 : it->tag != tag)
+      continue;
+    return it;
+  }
+  return inbox.end();
+}
+
+static void fillStatus(MPI_Comm comm, const Message &m, MPI_Status *status) {
+  if (!status)
+    return;
+  const std::vector<int> &ranks = comms[comm].ranks;
+  status->MPI_SOURCE =
+    std::find(ranks.begin(), ranks.end(), m.source) - ranks.begin();
+  status->MPI_TAG = m.tag;
+  status->MPI_ERROR = MPI_SUCCESS;
+  status->count = m.data.size();
+}
+
+static size_t getRingSize(int size) {
+  // 256MB for all the rings, from 64KB to 1MB each
+  size_t perRing = ((size_t) 256 << 20) / ((size_t) size * size);
+  size_t ring = (size_t) 64 << 10;
+  while (ring * 2 <= perRing && ring < ((size_t) 1 << 20))
+    ring *= 2;
+  return ring;
+}
+
+int MPI_Init(int *argc, char ***argv) {
+  if (initialized)
+    return MPI_ERR_OTHER;
+  const char *env = getenv("KLEE_RANKS");
+  worldSize = env ? atoi(env) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (worldSize < 2)
+    worldSize = 2;
+  ringSize = getRingSize(worldSize);
+
+  size_t pidBytes = (worldSize * sizeof(pid_t) + 63) / 64 * 64;
+  sharedSize = pidBytes +
+    (size_t) worldSize * worldSize * (sizeof(Ring) + ringSize);
+  void *mapping = mmap(0, sharedSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED)
+    return MPI_ERR_OTHER;
+  shared = (char *) mapping;
+  pids = (pid_t *) shared;
+  for (int from = 0; from < worldSize; from++)
+    for (int to = 0; to < worldSize; to++) {
+      Ring *ring = getRing(from, to);
+      new (&ring->head) std::atomic<uint64_t>(0);
+      new (&ring->tail) std::atomic<uint64_t>(0);
+    }
+
+  pids[0] = getpid();
+  for (int rank = 1; rank < worldSize; rank++) {
+    pid_t pid = fork();
+    if (pid < 0)
+      return MPI_ERR_OTHER;
+    if (pid == 0) {
+      // the ranks go with the one started
+      prctl(PR_SET_PDEATHSIG, SIGKILL);
+      if (getppid() != pids[0])
+        _exit(1);
+      worldRank = rank;
+      pids[rank] = getpid();
+      break;
+    }
+    pids[rank] = pid;
+  }
+
+  partials.assign(worldSize, Partial());
+  for (int i = 0; i < worldSize; i++)
+    partials[i].hasHeader = false;
+  Communicator world;
+  world.context = 0;
+  for (int i = 0; i < worldSize; i++)
+    world.ranks.push_back(i);
+  world.rank = worldRank;
+  world.splits = 0;
+  world.freed = false;
+  comms.push_back(world);
+  initialized = true;
+  return MPI_SUCCESS;
+}
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided) {
+  *provided = MPI_THREAD_MULTIPLE;
+  return MPI_Init(argc, argv);
+}
+
+int MPI_Initialized(int *flag) {
+  *flag = initialized;
+  return MPI_SUCCESS;
+}
+
+int MPI_Query_thread(int *provided) {
+  *provided = MPI_THREAD_MULTIPLE;
+  return MPI_SUCCESS;
+}
+
+int MPI_Finalize(void) {
+  if (worldRank != 0)
+    return MPI_SUCCESS;
+  int result = MPI_SUCCESS;
+  for (int rank = 1; rank < worldSize; rank++) {
+    int status;
+    if (waitpid(pids[rank], &status, 0) != pids[rank] ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      result = MPI_ERR_OTHER;
+  }
+  return result;
+}
+
+int MPI_Abort(MPI_Comm comm, int errorcode) {
+  for (int rank = 0; rank < worldSize; rank++)
+    if (rank != worldRank && pids[rank] > 0)
+      kill(pids[rank], SIGKILL);
+  _exit(errorcode ? errorcode : 1);
+}
+
+int MPI_Comm_rank(MPI_Comm comm, int *rank) {
+  std::lock_guard<std::recursive_mutex> guard(lock);
+  if (!isValid(comm))
+    return MPI_ERR_OTHER;
+  *rank = comms[comm].rank;
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_size(MPI_Comm comm, int *size) {
+  std::lock_guard<std::recursive_mutex> guard(lock);
+  if (!isValid(comm))
+    return MPI_ERR_OTHER;
+  *size = comms[comm].ranks.size();
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm) {
+  if (!isValid(comm))
+    return MPI_ERR_OTHER;
+  // every rank learns the color and key of all others
+  int size = comms[comm].ranks.size();
+  std::vector<int> mine(2), all(2 * size);
+  mine[0] = color;
+  mine[1] = key;
+  MPI_Allgather(&mine[0], 2, MPI_INT, &all[0], 2, MPI_INT, comm);
+
+  std::lock_guard<std::recursive_mutex> guard(lock);
+  Communicator &parent = comms[comm];
+  unsigned split = ++parent.splits;
+  if (color == MPI_UNDEFINED) {
+    *newcomm = MPI_COMM_NULL;
+    return MPI_SUCCESS;
+  }
+  std::vector<std::pair<std::pair<int, int>, int> > members;
+  for (int i = 0; i < size; i++)
+    if (all[2 * i] == color)
+      members.push_back(std::make_pair(std::make_pair(all[2 * i + 1], i),
+                                       parent.ranks[i]));
+  std::sort(members.begin(), members.end());
+
+  Communicator c;
+  // the same on the ranks of the new communicator, and apart from the
+  // other colors and splits
+  uint64_t context = parent.context;
+  context = context * 1000003 + split;
+  context = context * 1000003 + (unsigned) color;
+  c.context = (int) ((context ^ (context >> 31)) & 0x7fffffff);
+  for (unsigned i = 0; i < members.size(); i++) {
+    c.ranks.push_back(members[i].second);
+    if (members[i].second == worldRank)
+      c.rank = i;
+  }
+  c.splits = 0;
+  c.freed = false;
+  comms.push_back(c);
+  *newcomm = comms.size() - 1;
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info,
+                        MPI_Comm *newcomm) {
+  // all ranks share the node
+  return MPI_Comm_split(comm, split_type == MPI_COMM_TYPE_SHARED ? 0 :
+                        MPI_UNDEFINED, key, newcomm);
+}
+
+int MPI_Comm_free(MPI_Comm *comm) {
+  std::lock_guard<std::recursive_mutex> guard(lock);
+  if (!isValid(*comm) || *comm == MPI_COMM_WORLD)
+    return MPI_ERR_OTHER;
+  comms[*comm].freed = true;
+  *comm = MPI_COMM_NULL;
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_set_errhandler(MPI_Comm comm, MPI_Errhandler errhandler) {
+  return isValid(comm) ? MPI_SUCCESS : MPI_ERR_OTHER;
+}
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest,
+             int tag, MPI_Comm comm) {
+  std::lock_guard<std::recursive_mutex> guard(lock);
+  if (!isValid(comm) || dest < 0 || dest >= (int) comms[comm].ranks.size())
+    return MPI_ERR_OTHER;
+  int to = comms[comm].ranks[dest];
+  Header header;
+  header.context = comms[comm].context;
+  header.tag = tag;
+  header.length = (uint32_t) count * datatype;
+  if (to == worldRank) {
+    Message m;
+    m.source = worldRank;
+    m.context = header.context;
+    m.tag = tag;
+    m.data.assign((const char *) buf, (const char *) buf + header.length);
+    inbox.push_back(m);
+    return MPI_SUCCESS;
+  }
+  sendBytes(to, &header, sizeof(header));
+  sendBytes(to, buf, header.length);
+  return MPI_SUCCESS;
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest,
+              int tag, MPI_Comm comm, MPI_Request *request) {
+  *request = 1;
+  return MPI_Send(buf, count, datatype, dest, tag, comm);
+}
+
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag,
+               MPI_Status *status) {
+  std::lock_guard<std::recursive_mutex> guard(lock);
+  if (!isValid(comm))
+    return MPI_ERR_OTHER;
+  drain();
+  std::deque<Message>::iterator it = match(comm, source, tag);
+  *flag = it != inbox.end();
+  if (*flag)
+    fillStatus(comm, *it, status);
+  return MPI_SUCCESS;
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status) {
+  int flag = 0;
+  while (true) {
+    int result = MPI_Iprobe(source, tag, comm, &flag, status);
+    if (result != MPI_SUCCESS || flag)
+      return result;
+    sched_yield();
+  }
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source,
+             int tag, MPI_Comm comm, MPI_Status *status) {
+  while (true) {
+    {
+      std::lock_guard<std::recursive_mutex> guard(lock);
+      if (!isValid(comm))
+        return MPI_ERR_OTHER;
+      drain();
+      std::deque<Message>::iterator it = match(comm, source, tag);
+      if (it != inbox.end()) {
+        size_t n = std::min(it->data.size(), (size_t) count * datatype);
+        if (n)
+          memcpy(buf, &it->data[0], n);
+        fillStatus(comm, *it, status);
+        bool truncated = it->data.size() > n;
+        inbox.erase(it);
+        return truncated ? MPI_ERR_OTHER : MPI_SUCCESS;
+      }
+    }
+    sched_yield();
+  }
+}
+
+int MPI_Get_count(const MPI_Status *status, MPI_Datatype datatype,
+                  int *count) {
+  *count = status->count / datatype;
+  return MPI_SUCCESS;
+}
+
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status) {
+  *request = MPI_REQUEST_NULL;
+  *flag = 1;
+  return MPI_SUCCESS;
+}
+
+int MPI_Testall(int count, MPI_Request requests[], int *flag,
+                MPI_Status statuses[]) {
+  for (int i = 0; i < count; i++)
+    requests[i] = MPI_REQUEST_NULL;
+  *flag = 1;
+  return MPI_SUCCESS;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status) {
+  *request = MPI_REQUEST_NULL;
+  return MPI_SUCCESS;
+}
+
+int MPI_Request_free(MPI_Request *request) {
+  *request = MPI_REQUEST_NULL;
+  return MPI_SUCCESS;
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root,
+              MPI_Comm comm) {
+  if (!isValid(comm))
+    return MPI_ERR_OTHER;
+  int rank = comms[comm].rank, size = comms[comm].ranks.size();
+  if (rank != root)
+    return MPI_Recv(buffer, count, datatype, root, BcastTag, comm,
+                    MPI_STATUS_IGNORE);
+  for (int i = 0; i < size; i++)
+    if (i != root)
+      MPI_Send(buffer, count, datatype, i, BcastTag, comm);
+  return MPI_SUCCESS;
+}
+
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                  void *recvbuf, int recvcount, MPI_Datatype recvtype,
+                  MPI_Comm comm) {
+  if (!isValid(comm))
+    return MPI_ERR_OTHER;
+  int rank = comms[comm].rank, size = comms[comm].ranks.size();
+  size_t block = (size_t) recvcount * recvtype;
+  // rank 0 gathers the blocks and hands them all out
+  if (rank != 0) {
+    MPI_Send(sendbuf, sendcount, sendtype, 0, GatherTag, comm);
+  } else {
+    memcpy(recvbuf, sendbuf, block);
+    for (int i = 1; i < size; i++)
+      MPI_Recv((char *) recvbuf + i * block, recvcount, recvtype, i,
+               GatherTag, comm, MPI_STATUS_IGNORE);
+  }
+  return MPI_Bcast(recvbuf, size * block, MPI_BYTE, 0, comm);
+}
+
+#endif
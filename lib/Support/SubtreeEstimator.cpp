@@ -0,0 +1,55 @@
+//===-- SubtreeEstimator.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/SubtreeEstimator.h"
+
+using namespace klee;
+
+const double SubtreeEstimator::MaxEstimate = 1e15;
+
+void SubtreeEstimator::recordFork(unsigned depth) {
+  if (depth >= nodes.size()) {
+    nodes.resize(depth + 1, 0);
+    children.resize(depth + 1, 0);
+  }
+  ++nodes[depth];
+  children[depth] += 2;
+  stale = true;
+}
+
+void SubtreeEstimator::recordLeaf(unsigned depth) {
+  if (depth >= nodes.size()) {
+    nodes.resize(depth + 1, 0);
+    children.resize(depth + 1, 0);
+  }
+  ++nodes[depth];
+  stale = true;
+}
+
+double SubtreeEstimator::getRate(unsigned depth) const {
+  if (depth >= nodes.size() || !nodes[depth])
+    return 0;
+  return (double) children[depth] / nodes[depth];
+}
+
+double SubtreeEstimator::estimate(unsigned depth) const {
+  if (stale) {
+    // E(d) = 1 + r(d) E(d+1), from the deepest measured depth up
+    estimates.resize(nodes.size());
+    double below = 1;
+    for (unsigned d = nodes.size(); d-- > 0;) {
+      below = nodes[d] ? 1 + getRate(d) * below : 1;
+      if (below > MaxEstimate)
+        below = MaxEstimate;
+      estimates[d] = below;
+    }
+    stale = false;
+  }
+  return depth < estimates.size() ? estimates[depth] : 1;
+}
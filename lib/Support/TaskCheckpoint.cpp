@@ -0,0 +1,109 @@
+//===-- TaskCheckpoint.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/TaskCheckpoint.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fstream>
+
+using namespace klee;
+
+static const char checkpointMagic[] = "KCKPT1\n";
+
+void TaskCheckpoint::start(unsigned rank, int tag, const std::string &data) {
+  assert(rank < running.size() && "invalid rank");
+  running[rank] = Task(tag, data);
+}
+
+void TaskCheckpoint::steal(unsigned thief, unsigned victim) {
+  assert(thief < running.size() && victim < running.size() && "invalid rank");
+  if (running[victim].tag != -1)
+    running[thief] = running[victim];
+}
+
+void TaskCheckpoint::finish(unsigned rank) {
+  assert(rank < running.size() && "invalid rank");
+  running[rank] = Task();
+}
+
+unsigned TaskCheckpoint::getNumRunning() const {
+  unsigned n = 0;
+  for (unsigned i = 0; i < running.size(); i++)
+    if (running[i].tag != -1)
+      n++;
+  return n;
+}
+
+static void writeTask(std::ofstream &os, const TaskCheckpoint::Task &task) {
+  os << task.tag << " " << task.data.size() << "\n";
+  os.write(task.data.data(), task.data.size());
+  os << "\n";
+}
+
+bool TaskCheckpoint::write(const std::string &path,
+                           const std::vector<Task> &queued,
+                           std::string &error) const {
+  std::string tmp = path + ".tmp";
+  std::ofstream os(tmp.c_str(), std::ios::binary | std::ios::trunc);
+  if (!os) {
+    error = "unable to open " + tmp + ": " + strerror(errno);
+    return false;
+  }
+  os << checkpointMagic << queued.size() + getNumRunning() << "\n";
+  for (unsigned i = 0; i < queued.size(); i++)
+    writeTask(os, queued[i]);
+  for (unsigned i = 0; i < running.size(); i++)
+    if (running[i].tag != -1)
+      writeTask(os, running[i]);
+  os.close();
+  if (!os) {
+    error = "unable to write " + tmp;
+    return false;
+  }
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    error = "unable to rename " + tmp + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool TaskCheckpoint::read(const std::string &path, std::vector<Task> &tasks,
+                          std::string &error) {
+  std::ifstream is(path.c_str(), std::ios::binary);
+  if (!is) {
+    error = "unable to open " + path + ": " + strerror(errno);
+    return false;
+  }
+  char magic[sizeof(checkpointMagic) - 1];
+  unsigned count;
+  if (!is.read(magic, sizeof(magic)) ||
+      memcmp(magic, checkpointMagic, sizeof(magic)) != 0 || !(is >> count)) {
+    error = path + " is not a checkpoint";
+    return false;
+  }
+  tasks.clear();
+  for (unsigned i = 0; i < count; i++) {
+    Task task;
+    size_t size;
+    if (!(is >> task.tag >> size) || is.get() != '\n') {
+      error = path + " is truncated";
+      return false;
+    }
+    task.data.resize(size);
+    if ((size && !is.read(&task.data[0], size)) || is.get() != '\n') {
+      error = path + " is truncated";
+      return false;
+    }
+    tasks.push_back(task);
+  }
+  return true;
+}
@@ -13,6 +13,8 @@
 #include "llvm/Support/TimeValue.h"
 #include "llvm/Support/Process.h"
 
+#include <time.h>
+
 using namespace llvm;
 using namespace klee;
 
@@ -27,6 +29,16 @@ double util::getWallTime() {
   return (now.seconds() + ((double) now.nanoseconds() * 1e-9));
 }
 
+double util::getMonotonicTime() {
+  struct timespec ts;
+#ifdef CLOCK_MONOTONIC_COARSE
+  ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+  return ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
 sys::TimeValue util::getWallTimeVal() {
   return sys::TimeValue::now();
 }
@@ -0,0 +1,68 @@
+//===-- WorkTree.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/WorkTree.h"
+
+#include "klee/Internal/ADT/RNG.h"
+
+#include <cassert>
+
+using namespace klee;
+
+void WorkTree::destroy(Node *node) {
+  if (!node)
+    return;
+  destroy(node->children[0]);
+  destroy(node->children[1]);
+  delete node;
+}
+
+void WorkTree::add(const std::string &path, unsigned id) {
+  Node *node = root;
+  ++node->count;
+  for (unsigned i = 0; i < path.size(); i++) {
+    int branch;
+    if (path[i] == '0' || path[i] == '2')
+      branch = 0;
+    else if (path[i] == '1' || path[i] == '3')
+      branch = 1;
+    else
+      continue;
+    if (!node->children[branch])
+      node->children[branch] = new Node();
+    node = node->children[branch];
+    ++node->count;
+  }
+  node->ids.push_back(id);
+}
+
+unsigned WorkTree::takeRandomPath(RNG &rng) {
+  assert(!empty() && "no prefix left");
+  Node *node = root;
+  while (true) {
+    --node->count;
+    // the prefixes ending here count as one more branch
+    Node *options[3];
+    unsigned numOptions = 0;
+    if (!node->ids.empty())
+      options[numOptions++] = node;
+    for (unsigned i = 0; i < 2; i++)
+      if (node->children[i] && node->children[i]->count)
+        options[numOptions++] = node->children[i];
+    assert(numOptions && "inconsistent prefix counts");
+
+    Node *next = options[rng.getInt32() % numOptions];
+    if (next == node) {
+      unsigned id = node->ids.back();
+      node->ids.pop_back();
+      return id;
+    }
+    node = next;
+  }
+}
@@ -0,0 +1,246 @@
+//===-- WorkerTracker.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/WorkerTracker.h"
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace klee;
+
+/// The side of a branch in the trie, -1 for separators. Unforked branches
+/// ('2'/'3') take the same side as forked ones.
+static int getBranchSide(char branch) {
+  switch (branch) {
+  case '0': case '2': return 0;
+  case '1': case '3': return 1;
+  default: return -1;
+  }
+}
+
+WorkerTracker::RankQueue::RankQueue(unsigned numRanks)
+  : prev(numRanks, -1), next(numRanks, -1), queued(numRanks, false),
+    head(-1), tail(-1), count(0) {}
+
+void WorkerTracker::RankQueue::push(unsigned rank) {
+  assert(!queued[rank] && "rank already queued");
+  prev[rank] = tail;
+  next[rank] = -1;
+  if (tail != -1)
+    next[tail] = rank;
+  else
+    head = rank;
+  tail = rank;
+  queued[rank] = true;
+  ++count;
+}
+
+void WorkerTracker::RankQueue::remove(unsigned rank) {
+  if (!queued[rank])
+    return;
+  if (prev[rank] != -1)
+    next[prev[rank]] = next[rank];
+  else
+    head = next[rank];
+  if (next[rank] != -1)
+    prev[next[rank]] = prev[rank];
+  else
+    tail = prev[rank];
+  queued[rank] = false;
+  --count;
+}
+
+WorkerTracker::WorkerTracker(unsigned _firstWorker, unsigned numRanks)
+  : firstWorker(_firstWorker), busy(numRanks, false),
+    ready(numRanks, false), offloadActive(numRanks, false),
+    lost(numRanks, false), numLost(0), workEstimate(numRanks, 0),
+    targetDistance(numRanks, 0), node(numRanks, 0), minLocalWork(0),
+    idleQueue(numRanks), readyQueue(numRanks),
+    pathNodes(1) {
+  assert(firstWorker <= numRanks);
+  for (unsigned rank = firstWorker; rank < numRanks; ++rank)
+    idleQueue.push(rank);
+}
+
+void WorkerTracker::markBusy(unsigned rank) {
+  assert(rank >= firstWorker && "not a worker");
+  assert(!lost[rank] && "worker is lost");
+  busy[rank] = true;
+  idleQueue.remove(rank);
+}
+
+bool WorkerTracker::markIdle(unsigned rank) {
+  assert(rank >= firstWorker && "not a worker");
+  if (lost[rank])
+    return false;
+  bool wasActive = offloadActive[rank];
+  busy[rank] = false;
+  ready[rank] = false;
+  offloadActive[rank] = false;
+  workEstimate[rank] = 0;
+  targetDistance[rank] = 0;
+  readyQueue.remove(rank);
+  if (!idleQueue.contains(rank))
+    idleQueue.push(rank);
+  return wasActive;
+}
+
+bool WorkerTracker::markLost(unsigned rank) {
+  assert(rank >= firstWorker && "not a worker");
+  if (lost[rank])
+    return false;
+  bool wasActive = markIdle(rank);
+  idleQueue.remove(rank);
+  lost[rank] = true;
+  ++numLost;
+  return wasActive;
+}
+
+void WorkerTracker::markJoined(unsigned rank) {
+  assert(rank >= firstWorker && "not a worker");
+  if (!lost[rank])
+    return;
+  lost[rank] = false;
+  --numLost;
+  idleQueue.push(rank);
+}
+
+void WorkerTracker::markReady(unsigned rank) {
+  if (ready[rank] || lost[rank])
+    return;
+  ready[rank] = true;
+  if (!offloadActive[rank])
+    readyQueue.push(rank);
+}
+
+void WorkerTracker::markNotReady(unsigned rank) {
+  ready[rank] = false;
+  readyQueue.remove(rank);
+}
+
+bool WorkerTracker::popIdle(unsigned &rank) {
+  if (idleQueue.empty())
+    return false;
+  rank = idleQueue.front();
+  markBusy(rank);
+  return true;
+}
+
+bool WorkerTracker::popIdleNearest(const char *prefix, size_t size,
+                                   unsigned &rank) {
+  if (idleQueue.empty())
+    return false;
+  // the idle workers at the deepest node which has any
+  std::vector<unsigned> nearest, idle;
+  int node = 0;
+  for (size_t i = 0; i != size; ++i) {
+    int side = getBranchSide(prefix[i]);
+    if (side == -1)
+      continue;
+    node = pathNodes[node].children[side];
+    if (node == -1)
+      break;
+    idle.clear();
+    const std::vector<unsigned> &ranks = pathNodes[node].ranks;
+    for (unsigned j = 0; j != ranks.size(); ++j)
+      if (idleQueue.contains(ranks[j]))
+        idle.push_back(ranks[j]);
+    if (idle.empty())
+      break;
+    nearest.swap(idle);
+  }
+
+  rank = idleQueue.front();
+  if (!nearest.empty()) {
+    for (int r = rank; r != -1; r = idleQueue.after(r)) {
+      if (std::find(nearest.begin(), nearest.end(), (unsigned)r) !=
+          nearest.end()) {
+        rank = r;
+        break;
+      }
+    }
+  }
+  markBusy(rank);
+  return true;
+}
+
+void WorkerTracker::addPrefix(unsigned rank, const char *prefix, size_t size) {
+  unsigned node = 0;
+  for (size_t i = 0; i != size; ++i) {
+    int side = getBranchSide(prefix[i]);
+    if (side == -1)
+      continue;
+    int child = pathNodes[node].children[side];
+    if (child == -1) {
+      child = pathNodes.size();
+      pathNodes[node].children[side] = child;
+      pathNodes.push_back(PathNode());
+    }
+    node = child;
+    std::vector<unsigned> &ranks = pathNodes[node].ranks;
+    if (std::find(ranks.begin(), ranks.end(), rank) == ranks.end())
+      ranks.push_back(rank);
+  }
+}
+
+bool WorkerTracker::popIdleNear(unsigned donor, unsigned &rank) {
+  if (idleQueue.empty())
+    return false;
+  rank = idleQueue.front();
+  for (int r = rank; r != -1; r = idleQueue.after(r)) {
+    if (node[r] == node[donor]) {
+      rank = r;
+      break;
+    }
+  }
+  markBusy(rank);
+  return true;
+}
+
+void WorkerTracker::setWorkEstimate(unsigned rank, unsigned work) {
+  workEstimate[rank] = work;
+}
+
+bool WorkerTracker::isBetterDonor(unsigned a, unsigned b) const {
+  // 0 is no target in reach, the farthest
+  if (targetDistance[a] != targetDistance[b])
+    return targetDistance[a] && (!targetDistance[b] ||
+                                 targetDistance[a] < targetDistance[b]);
+  return workEstimate[a] > workEstimate[b];
+}
+
+bool WorkerTracker::pickDonor(unsigned &rank) {
+  if (readyQueue.empty())
+    return false;
+  std::vector<bool> hasIdle(busy.size(), false);
+  for (int r = idleQueue.empty() ? -1 : (int)idleQueue.front(); r != -1;
+       r = idleQueue.after(r))
+    hasIdle[node[r]] = true;
+
+  int best = -1, bestLocal = -1;
+  for (int r = readyQueue.front(); r != -1; r = readyQueue.after(r)) {
+    if (best == -1 || isBetterDonor(r, best))
+      best = r;
+    if (hasIdle[node[r]] && workEstimate[r] >= minLocalWork &&
+        (bestLocal == -1 || isBetterDonor(r, bestLocal)))
+      bestLocal = r;
+  }
+  rank = bestLocal != -1 ? bestLocal : best;
+  readyQueue.remove(rank);
+  offloadActive[rank] = true;
+  return true;
+}
+
+void WorkerTracker::offloadDone(unsigned rank) {
+  if (!offloadActive[rank])
+    return;
+  offloadActive[rank] = false;
+  if (ready[rank])
+    readyQueue.push(rank);
+}
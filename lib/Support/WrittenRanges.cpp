@@ -0,0 +1,76 @@
+//===-- WrittenRanges.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/WrittenRanges.h"
+
+using namespace klee;
+
+void WrittenRanges::add(uint64_t address, uint64_t size, unsigned epoch) {
+  if (size == 0)
+    return;
+  uint64_t start = address, end = address + size;
+
+  // from the range before the write if it reaches it
+  std::map<uint64_t, Range>::iterator it = ranges.upper_bound(start);
+  if (it != ranges.begin()) {
+    std::map<uint64_t, Range>::iterator prev = it;
+    --prev;
+    if (prev->second.end >= start)
+      it = prev;
+  }
+
+  while (it != ranges.end() && it->first <= end) {
+    uint64_t rangeStart = it->first;
+    Range range = it->second;
+    if (range.epoch == epoch) {
+      // overlapping or adjacent, merge it in
+      if (rangeStart < start)
+        start = rangeStart;
+      if (range.end > end)
+        end = range.end;
+      ranges.erase(it++);
+      continue;
+    }
+    if (range.end <= start || rangeStart >= end) {
+      // adjacent only
+      ++it;
+      continue;
+    }
+    // keep what sticks out on either side
+    ranges.erase(it++);
+    if (rangeStart < start)
+      ranges[rangeStart] = Range(start, range.epoch);
+    if (range.end > end)
+      ranges[end] = Range(range.end, range.epoch);
+  }
+  ranges[start] = Range(end, epoch);
+}
+
+bool WrittenRanges::covers(uint64_t address, uint64_t size,
+                           unsigned &epoch) const {
+  std::map<uint64_t, Range>::const_iterator it = ranges.upper_bound(address);
+  if (it == ranges.begin())
+    return false;
+  --it;
+
+  uint64_t pos = address, end = address + size;
+  unsigned earliest = it->second.epoch;
+  for (; it != ranges.end(); ++it) {
+    if (it->first > pos || it->second.end <= pos)
+      return false;
+    if (it->second.epoch < earliest)
+      earliest = it->second.epoch;
+    pos = it->second.end;
+    if (pos >= end) {
+      epoch = earliest;
+      return true;
+    }
+  }
+  return false;
+}
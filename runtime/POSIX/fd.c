@@ -35,11 +35,35 @@ void klee_warning(const char*);
 void klee_warning_once(const char*);
 int klee_get_errno(void);
 
-/* Returns pointer to the symbolic file structure fs the pathname is symbolic */
+/* Returns pointer to the concrete file structure if the pathname is the
+   path of a concrete file */
+static exe_disk_file_t *__get_con_file(const char *pathname) {
+  unsigned i;
+
+  for (i=0; i<__exe_fs.n_con_files; ++i) {
+    exe_disk_file_t *df = &__exe_fs.con_files[i];
+    if (strcmp(pathname, df->path) == 0) {
+      if (df->stat->st_ino == 0)
+        return NULL;
+      return df;
+    }
+  }
+
+  return NULL;
+}
+
+/* Returns pointer to the symbolic file structure fs the pathname is symbolic,
+   or to the concrete file structure if it is the path of a concrete file */
 static exe_disk_file_t *__get_sym_file(const char *pathname) {
   char c = pathname[0];
   unsigned i;
 
+  if (__exe_fs.n_con_files) {
+    exe_disk_file_t *cf = __get_con_file(pathname);
+    if (cf)
+      return cf;
+  }
+
   if (c == 0 || pathname[1] != 0)
     return NULL;
 
@@ -55,6 +79,13 @@ static exe_disk_file_t *__get_sym_file(const char *pathname) {
   return NULL;
 }
 
+/* Copies the contents of a modeled file in a single step if the arguments
+   are concrete, else through memcpy. */
+void __fd_copy_contents(void *dest, const void *src, size_t n) {
+  if (!klee_copy_memory(dest, src, n))
+    memcpy(dest, src, n);
+}
+
 static void *__concretize_ptr(const void *p);
 static size_t __concretize_size(size_t s);
 static const char *__concretize_string(const char *s);
@@ -392,7 +423,7 @@ ssize_t read(int fd, void *buf, size_t count) {
       count = f->dfile->size - f->off;
     }
     
-    memcpy(buf, f->dfile->contents + f->off, count);
+    __fd_copy_contents(buf, f->dfile->contents + f->off, count);
     f->off += count;
     
     return count;
@@ -458,7 +489,7 @@ ssize_t write(int fd, const void *buf, size_t count) {
     }
     
     if (actual_count)
-      memcpy(f->dfile->contents + f->off, buf, actual_count);
+      __fd_copy_contents(f->dfile->contents + f->off, buf, actual_count);
     
     if (count != actual_count)
       klee_warning("write() ignores bytes.\n");
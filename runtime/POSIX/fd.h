@@ -21,6 +21,7 @@ typedef struct {
   unsigned size;  /* in bytes */
   char* contents;
   struct stat64* stat;
+  const char *path; /* the file on disk of a concrete file, else NULL */
 } exe_disk_file_t;
 
 typedef enum {
@@ -39,6 +40,8 @@ typedef struct {
   exe_disk_file_t* dfile;   /* ptr to file on disk, if symbolic */
 } exe_file_t;
 
+#define MAX_CON_FILES 8
+
 typedef struct {
   unsigned n_sym_files; /* number of symbolic input files, excluding stdin */
   exe_disk_file_t *sym_stdin, *sym_stdout;
@@ -51,6 +54,11 @@ typedef struct {
   /* Which read, write etc. call should fail */
   int *read_fail, *write_fail, *close_fail, *ftruncate_fail, *getcwd_fail;
   int *chmod_fail, *fchmod_fail;
+
+  /* files on disk whose contents are loaded concretely, with symbolic
+     bytes only where asked for */
+  unsigned n_con_files;
+  exe_disk_file_t con_files[MAX_CON_FILES];
 } exe_file_system_t;
 
 #define MAX_FDS 32
@@ -74,6 +82,8 @@ extern exe_sym_env_t __exe_env;
 void klee_init_fds(unsigned n_files, unsigned file_length,
                    unsigned stdin_length, int sym_stdout_flag,
                    int do_all_writes_flag, unsigned max_failures);
+void klee_init_con_file(const char *path, unsigned sym_offset,
+                        unsigned sym_length);
 void klee_init_env(int *argcPtr, char ***argvPtr);
 
 /* *** */
@@ -87,5 +97,6 @@ int __fd_fstat(int fd, struct stat64 *buf);
 int __fd_ftruncate(int fd, off64_t length);
 int __fd_statfs(const char *path, struct statfs *buf);
 int __fd_getdents(unsigned int fd, struct dirent64 *dirp, unsigned int count);
+void __fd_copy_contents(void *dest, const void *src, size_t n);
 
 #endif /* __EXE_FD__ */
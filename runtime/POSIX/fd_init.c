@@ -19,6 +19,7 @@
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 
 exe_file_system_t __exe_fs;
@@ -55,6 +56,7 @@ static void __create_new_dfile(exe_disk_file_t *dfile, unsigned size,
   assert(size);
 
   dfile->size = size;
+  dfile->path = NULL;
   dfile->contents = malloc(dfile->size);
   klee_make_symbolic(dfile->contents, dfile->size, name);
   
@@ -94,6 +96,64 @@ static void __create_new_dfile(exe_disk_file_t *dfile, unsigned size,
   dfile->stat = s;
 }
 
+static void __emit_error(const char *msg) {
+  klee_report_error(__FILE__, __LINE__, msg, "user.err");
+}
+
+/* path: file on disk whose contents the file gets
+   sym_offset, sym_length: the range of its bytes which are symbolic, named
+                           con<k>-data for the k-th concrete file
+
+   The contents are read by the host in one go into a concrete object,
+   only the symbolic bytes are copied in by the interpreter. */
+void klee_init_con_file(const char *path, unsigned sym_offset,
+                        unsigned sym_length) {
+  char name[10] = "con?-data";
+  exe_disk_file_t *dfile;
+  struct stat64 *s;
+  unsigned done = 0;
+  int fd;
+
+  if (__exe_fs.n_con_files == MAX_CON_FILES)
+    __emit_error("too many concrete files");
+
+  name[3] = '0' + __exe_fs.n_con_files;
+  dfile = &__exe_fs.con_files[__exe_fs.n_con_files];
+
+  s = malloc(sizeof(*s));
+  fd = syscall(__NR_open, path, O_RDONLY);
+#if __WORDSIZE == 64
+  if (fd == -1 || syscall(__NR_fstat, fd, s) == -1 || !S_ISREG(s->st_mode))
+#else
+  if (fd == -1 || syscall(__NR_fstat64, fd, s) == -1 || !S_ISREG(s->st_mode))
+#endif
+    __emit_error("cannot read concrete file");
+
+  dfile->size = s->st_size;
+  dfile->path = path;
+  dfile->stat = s;
+  dfile->contents = malloc(dfile->size ? dfile->size : 1);
+  while (done < dfile->size) {
+    int r = syscall(__NR_pread64, fd, dfile->contents + done,
+                    dfile->size - done, (off64_t) done);
+    if (r <= 0)
+      __emit_error("cannot read concrete file");
+    done += r;
+  }
+  syscall(__NR_close, fd);
+
+  if (sym_length) {
+    char *sym;
+    if (sym_offset > dfile->size || sym_length > dfile->size - sym_offset)
+      __emit_error("symbolic bytes past the end of a concrete file");
+    sym = malloc(sym_length);
+    klee_make_symbolic(sym, sym_length, name);
+    __fd_copy_contents(dfile->contents + sym_offset, sym, sym_length);
+  }
+
+  __exe_fs.n_con_files++;
+}
+
 static unsigned __sym_uint32(const char *name) {
   unsigned x;
   klee_make_symbolic(&x, sizeof x, name);
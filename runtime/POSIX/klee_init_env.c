@@ -91,6 +91,9 @@ void klee_init_env(int* argcPtr, char*** argvPtr) {
   unsigned max_len, min_argvs, max_argvs;
   unsigned sym_files = 0, sym_file_len = 0;
   unsigned sym_stdin_len = 0;
+  unsigned con_files = 0;
+  char *con_file_paths[MAX_CON_FILES];
+  unsigned con_sym_offsets[MAX_CON_FILES], con_sym_lens[MAX_CON_FILES];
   int sym_stdout_flag = 0;
   int save_all_writes_flag = 0;
   int fd_fail = 0;
@@ -111,6 +114,8 @@ usage: (klee_init_env) [options] [program arguments]\n\
   -sym-files <NUM> <N>      - Make NUM symbolic files ('A', 'B', 'C', etc.),\n\
                               each with size N\n\
   -sym-stdin <N>            - Make stdin symbolic with size N.\n\
+  -con-file <F> <OFF> <N>   - Model the file F with its contents on disk,\n\
+                              with N symbolic bytes at offset OFF\n\
   -sym-stdout               - Make stdout symbolic.\n\
   -save-all-writes          - Allow write operations to execute as expected\n\
                               even if they exceed the file size. If set to 0, all\n\
@@ -162,6 +167,21 @@ usage: (klee_init_env) [options] [program arguments]\n\
       sym_files = __str_to_int(argv[k++], msg);
       sym_file_len = __str_to_int(argv[k++], msg);
 
+    } else if (__streq(argv[k], "--con-file") ||
+               __streq(argv[k], "-con-file")) {
+      const char *msg = "--con-file expects a path and two integer arguments "
+                        "<sym-offset> <sym-len>";
+
+      if (k+3 >= argc)
+        __emit_error(msg);
+      if (con_files == MAX_CON_FILES)
+        __emit_error("too many concrete files for klee_init_env");
+
+      k++;
+      con_file_paths[con_files] = argv[k++];
+      con_sym_offsets[con_files] = __str_to_int(argv[k++], msg);
+      con_sym_lens[con_files] = __str_to_int(argv[k++], msg);
+      con_files++;
     } else if (__streq(argv[k], "--sym-stdin") ||
                __streq(argv[k], "-sym-stdin")) {
       const char *msg =
@@ -207,5 +227,8 @@ usage: (klee_init_env) [options] [program arguments]\n\
 
   klee_init_fds(sym_files, sym_file_len, sym_stdin_len, sym_stdout_flag,
                 save_all_writes_flag, fd_fail);
+  for (i=0; i < (int) con_files; i++)
+    klee_init_con_file(con_file_paths[i], con_sym_offsets[i],
+                       con_sym_lens[i]);
 }
 
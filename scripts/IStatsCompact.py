@@ -0,0 +1,118 @@
+#!/usr/bin/python
+
+# ===-- IStatsCompact.py --------------------------------------------------===##
+#
+#                      The KLEE Symbolic Virtual Machine
+#
+#  This file is distributed under the University of Illinois Open Source
+#  License. See LICENSE.TXT for details.
+#
+# ===----------------------------------------------------------------------===##
+
+"""Fold the run.istats.delta logs of --istats-delta into a run.istats file.
+
+Every tick of a log holds the current values of the instructions which
+changed since the tick before, so the last record of an instruction wins.
+The logs of several output directories (e.g. the workers of a cluster run)
+are summed the way IStatsMerge.py sums run.istats files. Call site
+statistics are only in the run.istats written at the end of a run."""
+
+import sys, os
+
+class CompactError(Exception):
+    pass
+
+def readDelta(path):
+    f = open(path)
+    header = []
+    events = None
+    for ln in f:
+        if ln.startswith('ob='):
+            break
+        if ln.startswith('events:'):
+            events = ln[len('events: '):].split()
+        header.append(ln)
+    if events is None:
+        raise CompactError("%s: missing events directive"%(path,))
+
+    records = {}
+    fl = fn = ''
+    for ln in f:
+        if ln.startswith('tick='):
+            fl = fn = ''
+        elif ln.startswith('fl='):
+            fl = ln[len('fl='):].rstrip('\n')
+        elif ln.startswith('fn='):
+            fn = ln[len('fn='):].rstrip('\n')
+        else:
+            data = ln.split()
+            if len(data)!=len(events)+2:
+                # the last tick of a run which was killed
+                break
+            data = [int(d) for d in data]
+            records[data[0]] = [fl,fn,data[1],data[2:]]
+    return header,events,records
+
+def merge(logs):
+    header,events,merged = logs[0]
+    for h,e,records in logs[1:]:
+        if e!=events:
+            raise CompactError("events differ")
+        for instr,rec in records.items():
+            existing = merged.get(instr)
+            if existing is None:
+                merged[instr] = rec
+                continue
+            if existing[:3]!=rec[:3]:
+                raise CompactError("instruction %d differs"%(instr,))
+            for i,ev in enumerate(events):
+                if ev=='Icov':
+                    existing[3][i] = max(existing[3][i],rec[3][i])
+                elif ev=='Iuncov':
+                    existing[3][i] = min(existing[3][i],rec[3][i])
+                else:
+                    existing[3][i] += rec[3][i]
+    return header,merged
+
+def write(output, header, records, ob):
+    output.writelines(header)
+    output.write('ob=%s\n'%(ob,))
+    fl = fn = None
+    for instr in sorted(records):
+        rfl,rfn,line,values = records[instr]
+        if rfn!=fn:
+            if rfl!=fl:
+                output.write('fl=%s\n'%(rfl,))
+                fl = rfl
+            output.write('fn=%s\n'%(rfn,))
+            fn = rfn
+        elif rfl!=fl:
+            output.write('fl=%s\n'%(rfl,))
+            fl = rfl
+        output.write('%d %d %s\n'%(instr,line,' '.join(map(str,values))))
+
+def main(args):
+    from optparse import OptionParser
+    op = OptionParser("usage: %prog [options] directories+ output")
+    opts,args = op.parse_args()
+
+    if len(args)<2:
+        op.error("incorrect number of arguments")
+    output = args.pop()
+    directories = args
+
+    logs = [readDelta(os.path.join(d,'run.istats.delta')) for d in directories]
+    header,records = merge(logs)
+
+    if not os.path.exists(output):
+        os.mkdir(output)
+    assembly = os.path.join(output,'assembly.ll')
+    if not os.path.exists(assembly):
+        open(assembly,'w').write(
+            open(os.path.join(directories[0],'assembly.ll')).read())
+
+    write(open(os.path.join(output,'run.istats'),'w'), header, records,
+          os.path.abspath(assembly))
+
+if __name__=='__main__':
+    main(sys.argv)
@@ -67,6 +67,19 @@ def requires_auth(f):
         return f(*args, **kwargs)
     return decorated
 
+#live statistics of a pChop run, the snapshot written by the master with
+#--cluster-stats-interval, e.g.
+#CLUSTER_STATS=/path/to/cluster_stats_out.json python coverageServer.py
+CLUSTER_STATS = os.environ.get('CLUSTER_STATS', 'cluster_stats.json')
+
+@app.route("/cluster")
+def cluster_stats():
+    try:
+        with open(CLUSTER_STATS) as f:
+            return Response(f.read(), mimetype='application/json')
+    except IOError:
+        return Response('{}', 404, mimetype='application/json')
+
 @app.route("/<path:path>")
 def serve_page(path):
 	return send_from_directory('./coverage', path)
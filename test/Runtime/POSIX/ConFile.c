@@ -0,0 +1,31 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: printf "hello world" > %t.data
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error --posix-runtime %t.bc --con-file %t.data 6 5 %t.data
+// RUN: test -f %t.klee-out/test000001.ktest
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  char buf[16];
+  struct stat s;
+
+  int fd = open(argv[1], O_RDONLY);
+  assert(fd != -1);
+  assert(fstat(fd, &s) == 0 && s.st_size == 11);
+
+  assert(read(fd, buf, sizeof buf) == 11);
+  assert(memcmp(buf, "hello ", 6) == 0);
+  assert(!klee_is_symbolic(buf[5]));
+  assert(klee_is_symbolic(buf[6]));
+  assert(klee_is_symbolic(buf[10]));
+
+  assert(lseek(fd, 2, SEEK_SET) == 2);
+  assert(read(fd, buf, 3) == 3);
+  assert(memcmp(buf, "llo", 3) == 0);
+  return 0;
+}
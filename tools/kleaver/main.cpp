@@ -23,14 +23,20 @@
 #include "klee/util/ExprVisitor.h"
 #include "klee/util/ExprSMTLIBPrinter.h"
 #include "klee/Internal/Support/PrintVersion.h"
+#include "klee/Internal/System/Time.h"
 
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <errno.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 
@@ -54,7 +60,8 @@ namespace {
     PrintTokens,
     PrintAST,
     PrintSMTLIBv2,
-    Evaluate
+    Evaluate,
+    Benchmark
   };
 
   static llvm::cl::opt<ToolActions> 
@@ -69,6 +76,9 @@ namespace {
                         "Print parsed AST nodes from the input file."),
              clEnumValN(Evaluate, "evaluate",
                         "Print parsed AST nodes from the input file."),
+             clEnumValN(Benchmark, "benchmark",
+                        "Evaluate the queries in parallel and report the "
+                        "solver latencies of each --chain."),
              clEnumValEnd));
 
 
@@ -100,6 +110,28 @@ namespace {
       llvm::cl::desc("We discard the previous array declarations after a query "
                      "is performed. Default: false"),
       llvm::cl::init(false));
+
+  llvm::cl::opt<bool> StreamQueries(
+      "stream",
+      llvm::cl::desc("Evaluate each query as soon as it is parsed and free it "
+                     "afterwards, instead of parsing the whole input first, "
+                     "so large query logs run in constant memory. The "
+                     "queries before a parse error are still evaluated. "
+                     "Default: false"),
+      llvm::cl::init(false));
+
+  llvm::cl::opt<unsigned> BenchmarkJobs(
+      "jobs",
+      llvm::cl::desc("Number of worker processes for -benchmark "
+                     "(default=number of online CPUs)"),
+      llvm::cl::init(0));
+
+  llvm::cl::list<std::string> BenchmarkChains(
+      "chain",
+      llvm::cl::desc("Solver chain to benchmark: 'default' for the chain "
+                     "selected by the solver options, 'core' for the core "
+                     "solver alone, or a comma separated list of fast-cex, "
+                     "cex-cache, cache and independent (can be repeated)"));
 }
 
 static std::string getQueryLogPath(const char filename[])
@@ -194,14 +226,122 @@ static bool PrintInputAST(const char *Filename,
   return success;
 }
 
+static void EvaluateQuery(Solver *S, QueryCommand *QC, unsigned Index) {
+  llvm::outs() << "Query " << Index << ":\t";
+
+  assert("FIXME: Support counterexample query commands!");
+  if (QC->Values.empty() && QC->Objects.empty()) {
+    bool result;
+    if (S->mustBeTrue(Query(ConstraintManager(QC->Constraints), QC->Query),
+                      result)) {
+      llvm::outs() << (result ? "VALID" : "INVALID");
+    } else {
+      llvm::outs() << "FAIL (reason: "
+                << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+                << ")";
+    }
+  } else if (!QC->Values.empty()) {
+    assert(QC->Objects.empty() && 
+           "FIXME: Support counterexamples for values and objects!");
+    assert(QC->Values.size() == 1 &&
+           "FIXME: Support counterexamples for multiple values!");
+    assert(QC->Query->isFalse() &&
+           "FIXME: Support counterexamples with non-trivial query!");
+    ref<ConstantExpr> result;
+    if (S->getValue(Query(ConstraintManager(QC->Constraints), 
+                          QC->Values[0]),
+                    result)) {
+      llvm::outs() << "INVALID\n";
+      llvm::outs() << "\tExpr 0:\t" << result;
+    } else {
+      llvm::outs() << "FAIL (reason: "
+                << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+                << ")";
+    }
+  } else {
+    std::vector< std::vector<unsigned char> > result;
+    
+    if (S->getInitialValues(Query(ConstraintManager(QC->Constraints), 
+                                  QC->Query),
+                            QC->Objects, result)) {
+      llvm::outs() << "INVALID\n";
+
+      for (unsigned i = 0, e = result.size(); i != e; ++i) {
+        llvm::outs() << "\tArray " << i << ":\t"
+                   << QC->Objects[i]->name
+                   << "[";
+        for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
+          llvm::outs() << (unsigned) result[i][j];
+          if (j + 1 != QC->Objects[i]->size)
+            llvm::outs() << ", ";
+        }
+        llvm::outs() << "]";
+        if (i + 1 != e)
+          llvm::outs() << "\n";
+      }
+    } else {
+      SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
+      if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
+        llvm::outs() << " FAIL (reason: "
+                  << SolverImpl::getOperationStatusString(retCode)
+                  << ")";
+      }           
+      else {
+        llvm::outs() << "VALID (counterexample request ignored)";
+      }
+    }
+  }
+
+  llvm::outs() << "\n";
+}
+
+static Solver *CreateEvaluationSolver() {
+  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
+
+  if (CoreSolverToUse != DUMMY_SOLVER) {
+    if (0 != MaxCoreSolverTime) {
+      coreSolver->setCoreSolverTimeout(MaxCoreSolverTime);
+    }
+  }
+
+  return constructSolverChain(coreSolver,
+                              getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
+                              getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME));
+}
+
 static bool EvaluateInputAST(const char *Filename,
                              const MemoryBuffer *MB,
                              ExprBuilder *Builder) {
   std::vector<Decl*> Decls;
   Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
   P->SetMaxErrors(20);
-  while (Decl *D = P->ParseTopLevelDecl()) {
-    Decls.push_back(D);
+  Solver *S = 0;
+  unsigned Index = 0;
+  if (StreamQueries) {
+    // only the array declarations are kept, the queries refer to them
+    S = CreateEvaluationSolver();
+    while (Decl *D = P->ParseTopLevelDecl()) {
+      QueryCommand *QC = dyn_cast<QueryCommand>(D);
+      if (!QC) {
+        Decls.push_back(D);
+        continue;
+      }
+      if (!P->GetNumErrors())
+        EvaluateQuery(S, QC, Index++);
+      delete QC;
+      if (ClearArrayAfterQuery) {
+        for (std::vector<Decl*>::iterator it = Decls.begin(),
+               ie = Decls.end(); it != ie; ++it)
+          delete *it;
+        Decls.clear();
+      }
+    }
+  } else {
+    while (Decl *D = P->ParseTopLevelDecl()) {
+      Decls.push_back(D);
+    }
   }
 
   bool success = true;
@@ -210,96 +350,21 @@ static bool EvaluateInputAST(const char *Filename,
     success = false;
   }  
 
-  if (!success)
+  if (!success) {
+    for (std::vector<Decl*>::iterator it = Decls.begin(),
+           ie = Decls.end(); it != ie; ++it)
+      delete *it;
+    delete P;
+    delete S;
     return false;
-
-  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
-
-  if (CoreSolverToUse != DUMMY_SOLVER) {
-    if (0 != MaxCoreSolverTime) {
-      coreSolver->setCoreSolverTimeout(MaxCoreSolverTime);
-    }
   }
 
-  Solver *S = constructSolverChain(coreSolver,
-                                   getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME));
-
-  unsigned Index = 0;
+  if (!S)
+    S = CreateEvaluationSolver();
   for (std::vector<Decl*>::iterator it = Decls.begin(),
          ie = Decls.end(); it != ie; ++it) {
-    Decl *D = *it;
-    if (QueryCommand *QC = dyn_cast<QueryCommand>(D)) {
-      llvm::outs() << "Query " << Index << ":\t";
-
-      assert("FIXME: Support counterexample query commands!");
-      if (QC->Values.empty() && QC->Objects.empty()) {
-        bool result;
-        if (S->mustBeTrue(Query(ConstraintManager(QC->Constraints), QC->Query),
-                          result)) {
-          llvm::outs() << (result ? "VALID" : "INVALID");
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else if (!QC->Values.empty()) {
-        assert(QC->Objects.empty() && 
-               "FIXME: Support counterexamples for values and objects!");
-        assert(QC->Values.size() == 1 &&
-               "FIXME: Support counterexamples for multiple values!");
-        assert(QC->Query->isFalse() &&
-               "FIXME: Support counterexamples with non-trivial query!");
-        ref<ConstantExpr> result;
-        if (S->getValue(Query(ConstraintManager(QC->Constraints), 
-                              QC->Values[0]),
-                        result)) {
-          llvm::outs() << "INVALID\n";
-          llvm::outs() << "\tExpr 0:\t" << result;
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else {
-        std::vector< std::vector<unsigned char> > result;
-        
-        if (S->getInitialValues(Query(ConstraintManager(QC->Constraints), 
-                                      QC->Query),
-                                QC->Objects, result)) {
-          llvm::outs() << "INVALID\n";
-
-          for (unsigned i = 0, e = result.size(); i != e; ++i) {
-            llvm::outs() << "\tArray " << i << ":\t"
-                       << QC->Objects[i]->name
-                       << "[";
-            for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
-              llvm::outs() << (unsigned) result[i][j];
-              if (j + 1 != QC->Objects[i]->size)
-                llvm::outs() << ", ";
-            }
-            llvm::outs() << "]";
-            if (i + 1 != e)
-              llvm::outs() << "\n";
-          }
-        } else {
-          SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
-          if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
-            llvm::outs() << " FAIL (reason: "
-                      << SolverImpl::getOperationStatusString(retCode)
-                      << ")";
-          }           
-          else {
-            llvm::outs() << "VALID (counterexample request ignored)";
-          }
-        }
-      }
-
-      llvm::outs() << "\n";
-      ++Index;
-    }
+    if (QueryCommand *QC = dyn_cast<QueryCommand>(*it))
+      EvaluateQuery(S, QC, Index++);
   }
 
   for (std::vector<Decl*>::iterator it = Decls.begin(),
@@ -326,6 +391,241 @@ static bool EvaluateInputAST(const char *Filename,
   return success;
 }
 
+namespace {
+  /// A solver chain to benchmark, see -chain.
+  struct ChainConfig {
+    std::string name;
+    bool fastCex, cexCache, cache, independent;
+  };
+}
+
+static bool parseChainConfig(const std::string &spec, ChainConfig &config) {
+  config.name = spec;
+  if (spec == "default") {
+    config.fastCex = UseFastCexSolver;
+    config.cexCache = UseCexCache;
+    config.cache = UseCache;
+    config.independent = UseIndependentSolver;
+    return true;
+  }
+
+  config.fastCex = config.cexCache = config.cache = config.independent = false;
+  if (spec == "core")
+    return true;
+
+  SmallVector<StringRef, 4> stages;
+  StringRef(spec).split(stages, ",");
+  for (unsigned i = 0; i < stages.size(); ++i) {
+    StringRef stage = stages[i].trim();
+    if (stage == "fast-cex")
+      config.fastCex = true;
+    else if (stage == "cex-cache")
+      config.cexCache = true;
+    else if (stage == "cache")
+      config.cache = true;
+    else if (stage == "independent")
+      config.independent = true;
+    else {
+      llvm::errs() << "kleaver: error: unknown solver chain stage '" << stage
+                   << "' in '" << spec << "'\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Run a query command against a solver, the way EvaluateInputAST does but
+/// without printing the result. Returns false if the solver failed.
+static bool runQueryCommand(Solver *S, QueryCommand *QC) {
+  ConstraintManager constraints(QC->Constraints);
+  if (QC->Values.empty() && QC->Objects.empty()) {
+    bool result;
+    return S->mustBeTrue(Query(constraints, QC->Query), result);
+  }
+
+  if (!QC->Values.empty()) {
+    ref<ConstantExpr> result;
+    return S->getValue(Query(constraints, QC->Values[0]), result);
+  }
+
+  std::vector< std::vector<unsigned char> > result;
+  if (S->getInitialValues(Query(constraints, QC->Query), QC->Objects, result))
+    return true;
+  // As in EvaluateInputAST, only a timeout counts as a failure here.
+  return S->impl->getOperationStatusCode() !=
+         SolverImpl::SOLVER_RUN_STATUS_TIMEOUT;
+}
+
+static double percentile(const std::vector<double> &sorted, unsigned p) {
+  if (sorted.empty())
+    return 0;
+  size_t rank = (sorted.size() * p + 99) / 100;
+  return sorted[rank ? rank - 1 : 0];
+}
+
+/// Evaluate all queries with one solver chain in each of jobs worker
+/// processes, which take the next query from a shared counter, and print
+/// the latency summary of the chain.
+///
+/// The workers are processes rather than threads: expression reference
+/// counts, the statistics and some core solvers are not thread safe. They
+/// share the parsed queries copy-on-write and report through a shared
+/// mapping, one latency and status slot per query.
+static bool benchmarkChain(const ChainConfig &config,
+                           const std::vector<QueryCommand*> &queries,
+                           unsigned jobs) {
+  size_t n = queries.size();
+  size_t size = sizeof(double) * (n + 1) + n;
+  void *shared = mmap(0, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    llvm::errs() << "kleaver: error: unable to map benchmark results\n";
+    return false;
+  }
+  // The next query to run, padded to keep the latencies aligned.
+  unsigned *next = (unsigned*) shared;
+  double *latency = (double*) shared + 1;
+  // 0 when the query was not run, 1 when it was solved, 2 when it failed.
+  unsigned char *status = (unsigned char*) (latency + n);
+
+  UseFastCexSolver = config.fastCex;
+  UseCexCache = config.cexCache;
+  UseCache = config.cache;
+  UseIndependentSolver = config.independent;
+
+  llvm::outs().flush();
+  llvm::errs().flush();
+  double start = util::getWallTime();
+  std::vector<pid_t> pids;
+  for (unsigned i = 0; i < jobs; ++i) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      llvm::errs() << "kleaver: warning: fork failed, running with "
+                   << pids.size() << " workers\n";
+      break;
+    }
+
+    if (pid == 0) {
+      Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
+      if (CoreSolverToUse != DUMMY_SOLVER && 0 != MaxCoreSolverTime)
+        coreSolver->setCoreSolverTimeout(MaxCoreSolverTime);
+      Solver *S = constructSolverChain(coreSolver, "", "", "", "");
+
+      for (;;) {
+        unsigned index = __sync_fetch_and_add(next, 1);
+        if (index >= n)
+          break;
+        double queryStart = util::getWallTime();
+        bool ok = runQueryCommand(S, queries[index]);
+        latency[index] = util::getWallTime() - queryStart;
+        status[index] = ok ? 1 : 2;
+      }
+
+      delete S;
+      _exit(0);
+    }
+    pids.push_back(pid);
+  }
+
+  for (unsigned i = 0; i < pids.size(); ++i) {
+    int wstatus;
+    while (waitpid(pids[i], &wstatus, 0) < 0 && errno == EINTR)
+      ;
+  }
+  double wall = util::getWallTime() - start;
+
+  std::vector<double> solved;
+  unsigned failed = 0, lost = 0;
+  double total = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (status[i] == 0) {
+      lost++;
+      continue;
+    }
+    if (status[i] == 2)
+      failed++;
+    solved.push_back(latency[i]);
+    total += latency[i];
+  }
+  std::sort(solved.begin(), solved.end());
+
+  llvm::outs() << llvm::format("%-32s %5u %8u %7u %7u %9.2f %9.2f "
+                               "%9.2f %9.2f %9.2f %9.2f\n",
+                               config.name.c_str(), (unsigned) pids.size(),
+                               (unsigned) solved.size(), failed, lost, wall,
+                               total, 1000 * percentile(solved, 50),
+                               1000 * percentile(solved, 90),
+                               1000 * percentile(solved, 99),
+                               1000 * (solved.empty() ? 0 : solved.back()));
+
+  munmap(shared, size);
+  return !pids.empty() && lost == 0;
+}
+
+static bool BenchmarkInputAST(const char *Filename,
+                              const MemoryBuffer *MB,
+                              ExprBuilder *Builder) {
+  std::vector<Decl*> Decls;
+  Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
+  P->SetMaxErrors(20);
+  while (Decl *D = P->ParseTopLevelDecl()) {
+    Decls.push_back(D);
+  }
+
+  if (unsigned N = P->GetNumErrors()) {
+    llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
+    return false;
+  }
+
+  std::vector<ChainConfig> configs;
+  std::vector<std::string> specs(BenchmarkChains.begin(),
+                                 BenchmarkChains.end());
+  if (specs.empty())
+    specs.push_back("default");
+  for (unsigned i = 0; i < specs.size(); ++i) {
+    ChainConfig config;
+    if (!parseChainConfig(specs[i], config))
+      return false;
+    configs.push_back(config);
+  }
+
+  std::vector<QueryCommand*> queries;
+  for (std::vector<Decl*>::iterator it = Decls.begin(),
+         ie = Decls.end(); it != ie; ++it)
+    if (QueryCommand *QC = dyn_cast<QueryCommand>(*it))
+      queries.push_back(QC);
+
+  unsigned jobs = BenchmarkJobs;
+  if (!jobs) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = cpus > 0 ? cpus : 1;
+  }
+
+  // The workers would all append to the same logs.
+  if (!queryLoggingOptions.empty()) {
+    llvm::errs() << "kleaver: warning: query logging is disabled in "
+                 << "-benchmark mode\n";
+    queryLoggingOptions.clear();
+  }
+
+  llvm::outs() << queries.size() << " queries, latencies in ms\n"
+               << llvm::format("%-32s %5s %8s %7s %7s %9s %9s "
+                               "%9s %9s %9s %9s\n",
+                               "chain", "jobs", "queries", "failed", "lost",
+                               "wall(s)", "total(s)", "p50", "p90", "p99",
+                               "max");
+  bool success = true;
+  for (unsigned i = 0; i < configs.size(); ++i)
+    success &= benchmarkChain(configs[i], queries, jobs);
+
+  for (std::vector<Decl*>::iterator it = Decls.begin(),
+         ie = Decls.end(); it != ie; ++it)
+    delete *it;
+  delete P;
+
+  return success;
+}
+
 static bool printInputAsSMTLIBv2(const char *Filename,
                              const MemoryBuffer *MB,
                              ExprBuilder *Builder)
@@ -451,6 +751,10 @@ int main(int argc, char **argv) {
     success = EvaluateInputAST(InputFile=="-" ? "<stdin>" : InputFile.c_str(),
                                MB.get(), Builder);
     break;
+  case Benchmark:
+    success = BenchmarkInputAST(InputFile=="-" ? "<stdin>" : InputFile.c_str(),
+                                MB.get(), Builder);
+    break;
   case PrintSMTLIBv2:
     success = printInputAsSMTLIBv2(InputFile=="-"? "<stdin>" : InputFile.c_str(), MB.get(),Builder);
     break;
@@ -0,0 +1,357 @@
+//===-- klee-bench.cpp ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+// Micro-benchmarks of the hot paths of the executor. Every case prints one
+// tab separated line:
+//
+//   <benchmark> <parameter> <iterations> <ns per iteration>
+//
+// The cases are run with doubling iteration counts until one run takes
+// -min-time seconds, only the last run is reported.
+
+#include "AddressSpace.h"
+#include "Context.h"
+#include "Memory.h"
+#include "PTree.h"
+#include "PrefixTree.h"
+
+#include "klee/Config/Version.h"
+#include "klee/Constraints.h"
+#include "klee/ExecutionState.h"
+#include "klee/Expr.h"
+#include "klee/ExprBuilder.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/Internal/ADT/RNG.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/ArrayCache.h"
+
+#if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#else
+#include "llvm/BasicBlock.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#endif
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+  cl::opt<std::string>
+  Filter("filter",
+         cl::desc("Only run the benchmarks whose name contains this"),
+         cl::init(""));
+
+  cl::opt<double>
+  MinTime("min-time",
+          cl::desc("Seconds a reported run takes at least (default=0.2)"),
+          cl::init(0.2));
+}
+
+/// A benchmark runs its loop the given number of times and returns the
+/// seconds the loop took, without its setup.
+typedef double (*BenchmarkFn)(unsigned param, unsigned iterations);
+
+static ArrayCache arrayCache;
+static RNG rng;
+
+/// The constraints x[i] <= 200 for i < n, which the all zero assignment
+/// satisfies.
+static std::vector<ref<Expr> > makeConstraints(unsigned n) {
+  const Array *x = arrayCache.CreateArray("x", n ? n : 1);
+  std::vector<ref<Expr> > constraints;
+  for (unsigned i = 0; i < n; i++)
+    constraints.push_back(
+        UleExpr::create(Expr::createTempRead(x, Expr::Int8, i),
+                        ConstantExpr::create(200, Expr::Int8)));
+  return constraints;
+}
+
+/// The KFunction of an empty function, for the initial frame of a state.
+static KFunction *getEmptyFunction() {
+  static KFunction *kf = 0;
+  if (!kf) {
+    LLVMContext &ctx = getGlobalContext();
+    Module *m = new Module("klee-bench", ctx);
+    Function *f =
+      Function::Create(FunctionType::get(Type::getVoidTy(ctx), false),
+                       GlobalValue::ExternalLinkage, "empty", m);
+    ReturnInst::Create(ctx, BasicBlock::Create(ctx, "entry", f));
+    kf = new KFunction(f, 0);
+  }
+  return kf;
+}
+
+/// The state copy of Executor::fork, for a state with param constraints.
+static double benchFork(unsigned param, unsigned iterations) {
+  ExecutionState state(getEmptyFunction());
+  std::vector<ref<Expr> > constraints = makeConstraints(param);
+  for (unsigned i = 0; i < constraints.size(); i++)
+    state.addConstraint(constraints[i]);
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; i++)
+    delete state.branch();
+  return util::getWallTime() - start;
+}
+
+/// Resolves random addresses among param objects of 64 bytes.
+static double benchResolveOne(unsigned param, unsigned iterations) {
+  AddressSpace as;
+  const uint64_t base = 0x10000000, stride = 128;
+  for (unsigned i = 0; i < param; i++) {
+    MemoryObject *mo =
+      new MemoryObject(base + i * stride, 64, false, true, false, 0, 0);
+    as.bindObject(mo, new ObjectState(mo));
+  }
+  std::vector<ref<ConstantExpr> > addresses;
+  for (unsigned i = 0; i < 1024; i++)
+    addresses.push_back(ConstantExpr::create(
+        base + (rng.getInt32() % param) * stride + rng.getInt32() % 64,
+        Expr::Int64));
+
+  unsigned found = 0;
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; i++) {
+    ObjectPair op;
+    found += as.resolveOne(addresses[i % addresses.size()], op);
+  }
+  double time = util::getWallTime() - start;
+  assert(found == iterations && "resolution missed an object");
+  (void) found;
+  return time;
+}
+
+/// Writes then reads back a concrete word of an object of param bytes.
+static double benchObjectState(unsigned param, unsigned iterations) {
+  MemoryObject *mo = new MemoryObject(0x10000000, param, false, true, false,
+                                      0, 0);
+  ObjectState *os = new ObjectState(mo);
+  ObjectHolder holder(os);
+  ref<Expr> value = ConstantExpr::create(0xdeadbeef, Expr::Int32);
+  unsigned words = param / 4;
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; i++) {
+    unsigned offset = (i % words) * 4;
+    os->write(offset, value);
+    os->read(offset, Expr::Int32);
+  }
+  return util::getWallTime() - start;
+}
+
+/// Builds (x[i] + c) ^ x[i+1] sums through the builder chain param: 0 for
+/// the default, 1 with constant folding, 2 with constant folding and
+/// simplification.
+static double benchExprBuilder(unsigned param, unsigned iterations) {
+  ExprBuilder *builder = createDefaultExprBuilder();
+  if (param >= 1)
+    builder = createConstantFoldingExprBuilder(builder);
+  if (param >= 2)
+    builder = createSimplifyingExprBuilder(builder);
+  const Array *x = arrayCache.CreateArray("y", 64);
+  ref<Expr> c = builder->Constant(7, Expr::Int8);
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; i++) {
+    unsigned idx = i % 63;
+    ref<Expr> a = Expr::createTempRead(x, Expr::Int8, idx);
+    ref<Expr> b = Expr::createTempRead(x, Expr::Int8, idx + 1);
+    builder->Xor(builder->Add(a, c), b);
+  }
+  double time = util::getWallTime() - start;
+  delete builder;
+  return time;
+}
+
+/// A core solver which answers every query with the all zero assignment.
+class ZeroSolverImpl : public SolverImpl {
+public:
+  bool computeTruth(const Query &, bool &) { return false; }
+  bool computeValue(const Query &, ref<Expr> &) { return false; }
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    values.clear();
+    for (unsigned i = 0; i < objects.size(); i++)
+      values.push_back(std::vector<unsigned char>(objects[i]->size, 0));
+    hasSolution = true;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+/// Asks the counterexample cache about subsets of param constraints, after
+/// it has seen the full set, so every query is answered by the superset
+/// lookup.
+static double benchCexCache(unsigned param, unsigned iterations) {
+  Solver *solver = createCexCachingSolver(new Solver(new ZeroSolverImpl()));
+  std::vector<ref<Expr> > constraints = makeConstraints(param);
+  // x[0] == 0, constant queries would not reach the cache
+  ref<Expr> query = EqExpr::create(constraints[0]->getKid(0),
+                                   ConstantExpr::create(0, Expr::Int8));
+
+  ConstraintManager all(constraints);
+  bool result;
+  solver->mayBeTrue(Query(all, query), result);
+
+  std::vector<ConstraintManager*> subsets;
+  for (unsigned i = 0; i < 16; i++) {
+    std::vector<ref<Expr> > subset;
+    for (unsigned j = 0; j < constraints.size(); j++)
+      if (rng.getBool())
+        subset.push_back(constraints[j]);
+    subsets.push_back(new ConstraintManager(subset));
+  }
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; i++)
+    solver->mayBeTrue(Query(*subsets[i % subsets.size()], query), result);
+  double time = util::getWallTime() - start;
+
+  for (unsigned i = 0; i < subsets.size(); i++)
+    delete subsets[i];
+  delete solver;
+  return time;
+}
+
+static std::vector<unsigned char> randomPath(unsigned length) {
+  std::vector<unsigned char> path(length);
+  for (unsigned i = 0; i < length; i++)
+    path[i] = rng.getBool() ? '1' : '0';
+  return path;
+}
+
+/// Adds iterations random paths of param branches to a PrefixTree.
+static double benchPrefixTreeInsert(unsigned param, unsigned iterations) {
+  std::vector<std::vector<unsigned char> > paths;
+  for (unsigned i = 0; i < 1024; i++)
+    paths.push_back(randomPath(param));
+  ExecutionState *state = reinterpret_cast<ExecutionState*>(1);
+
+  PrefixTree tree;
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; i++)
+    tree.addToTree(paths[i % paths.size()], state);
+  return util::getWallTime() - start;
+}
+
+/// Looks up the resume point of random paths of param branches in a
+/// PrefixTree holding 1024 other random paths of that length.
+static double benchPrefixTreeResume(unsigned param, unsigned iterations) {
+  ExecutionState *state = reinterpret_cast<ExecutionState*>(1);
+  PrefixTree tree;
+  for (unsigned i = 0; i < 1024; i++)
+    tree.addToTree(randomPath(param), state);
+  std::vector<std::vector<unsigned char> > paths;
+  for (unsigned i = 0; i < 1024; i++)
+    paths.push_back(randomPath(param));
+
+  size_t length = 0, total = 0;
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; i++) {
+    tree.getNodeToResume(paths[i % paths.size()], length);
+    total += length;
+  }
+  double time = util::getWallTime() - start;
+  (void) total;
+  return time;
+}
+
+/// Splits the leaves of a PTree breadth first until it holds param leaves,
+/// then removes them; an iteration is one split and its removal.
+static double benchPTreeSplit(unsigned param, unsigned iterations) {
+  double time = 0;
+  for (unsigned done = 0; done < iterations; done += param - 1) {
+    PTree tree(0);
+    std::vector<PTreeNode*> leaves(1, tree.root);
+    double start = util::getWallTime();
+    for (unsigned i = 0; leaves.size() - i < param; i++) {
+      std::pair<PTreeNode*, PTreeNode*> res = tree.split(leaves[i], 0, 0);
+      leaves.push_back(res.first);
+      leaves.push_back(res.second);
+    }
+    for (unsigned i = leaves.size() - param; i < leaves.size(); i++)
+      tree.remove(leaves[i]);
+    time += util::getWallTime() - start;
+  }
+  return time;
+}
+
+struct Benchmark {
+  const char *name;
+  BenchmarkFn fn;
+  std::vector<unsigned> params;
+};
+
+static std::vector<unsigned> params(unsigned a, unsigned b, unsigned c,
+                                    unsigned d) {
+  std::vector<unsigned> res;
+  res.push_back(a);
+  res.push_back(b);
+  res.push_back(c);
+  if (d)
+    res.push_back(d);
+  return res;
+}
+
+int main(int argc, char **argv) {
+  llvm::llvm_shutdown_obj shutdown;
+  cl::ParseCommandLineOptions(argc, argv, "KLEE micro-benchmarks\n");
+  Context::initialize(true, Expr::Int64);
+
+  const Benchmark benchmarks[] = {
+    { "fork", benchFork, params(0, 16, 256, 4096) },
+    { "resolve-one", benchResolveOne, params(16, 256, 4096, 65536) },
+    { "object-state-rw", benchObjectState, params(64, 4096, 65536, 0) },
+    { "expr-builder", benchExprBuilder, params(0, 1, 2, 0) },
+    { "cex-cache-superset", benchCexCache, params(8, 64, 512, 0) },
+    { "prefix-tree-insert", benchPrefixTreeInsert, params(16, 64, 256, 0) },
+    { "prefix-tree-resume", benchPrefixTreeResume, params(16, 64, 256, 0) },
+    { "ptree-split", benchPTreeSplit, params(2, 64, 4096, 0) },
+  };
+
+  printf("benchmark\tparam\titerations\tns\n");
+  for (unsigned b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+    const Benchmark &bench = benchmarks[b];
+    if (std::string(bench.name).find(Filter) == std::string::npos)
+      continue;
+    for (unsigned p = 0; p < bench.params.size(); p++) {
+      unsigned iterations = 1;
+      double time = bench.fn(bench.params[p], iterations);
+      while (time < MinTime && iterations < (1u << 30)) {
+        iterations *= 2;
+        time = bench.fn(bench.params[p], iterations);
+      }
+      printf("%s\t%u\t%u\t%.1f\n", bench.name, bench.params[p], iterations,
+             time * 1e9 / iterations);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,42 @@
+//===-- klee-brhist.cpp -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+// Prints a branch history log, one path per line as in the logs written
+// without --compress-branch-history.
+
+#include "klee/Config/config.h"
+#include "klee/Internal/Support/BranchHistory.h"
+
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <branch history file>\n", argv[0]);
+    return 1;
+  }
+
+#ifdef HAVE_ZLIB_H
+  klee::BranchHistoryReader reader(argv[1]);
+  if (!reader.good()) {
+    fprintf(stderr, "ERROR: unable to open: %s\n", argv[1]);
+    return 1;
+  }
+
+  std::vector<char> path;
+  while (reader.next(path)) {
+    if (!path.empty())
+      fwrite(&path[0], 1, path.size(), stdout);
+    fputc('\n', stdout);
+  }
+  return 0;
+#else
+  fprintf(stderr, "ERROR: %s was built without zlib\n", argv[0]);
+  return 1;
+#endif
+}
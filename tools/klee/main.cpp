@@ -9,6 +9,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "PrefixCodec.h"
+#include "SolverService.h"
+
 #include "klee/ExecutionState.h"
 #include "klee/Expr.h"
 #include "klee/Interpreter.h"
@@ -16,12 +19,25 @@
 #include "klee/Config/Version.h"
 #include "klee/Internal/ADT/KTest.h"
 #include "klee/Internal/ADT/TreeStream.h"
+#include "klee/Internal/ADT/RNG.h"
 #include "klee/Internal/Support/Debug.h"
 #include "klee/Internal/Support/ModuleUtil.h"
+#include "klee/Internal/Support/PathInterval.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/PrintVersion.h"
+#include "klee/Internal/Support/BloomFilter.h"
+#include "klee/Internal/Support/Campaign.h"
+#include "klee/Internal/Support/ClusterStats.h"
+#include "klee/Internal/Support/CoveragePlateau.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/EventTrace.h"
+#include "klee/Internal/Support/SearchPortfolio.h"
+#include "klee/Internal/Support/SeedFrontier.h"
+#include "klee/Internal/Support/TaskCheckpoint.h"
+#include "klee/Internal/Support/WorkerTracker.h"
+#include "klee/Internal/Support/WorkTree.h"
 #include "klee/Internal/Analysis/Annotator.h"
+#include "klee/Internal/Module/KModule.h"
 
 
 #if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
@@ -47,6 +63,7 @@
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -62,17 +79,25 @@
 #endif
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iterator>
+#include <mutex>
 #include <sstream>
 #include <iostream>
+#include <thread>
+#include <unordered_set>
 
 #include <mpi.h>
 #include <set>
@@ -91,10 +116,38 @@ using namespace klee;
 #define KILL_COMP 8
 #define READY_TO_OFFLOAD 9
 #define NOT_READY_TO_OFFLOAD 10
+#define OFFLOAD_STATE_RESP 11
+#define START_STATE_TASK 12
+#define START_SPLIT_TASK 13
+#define SPLIT_RESP 14
+#define STEAL_REQ 15
+#define STEAL_RESP 16
+#define STEAL_GIVEN 17
+#define START_STEAL_TASK 18
+#define HEARTBEAT 19
+#define SOLVER_CACHE 20
+#define SHARED_COVERAGE 21
+#define SEARCH_MODE 22
+#define TEST_HASH 23
+#define CLUSTER_STATS 24
+#define START_SEED_TASK 25
+#define WORK_REQUEST 26
+#define LEAVE 27
+#define LEAVE_RESP 28
+#define START_RANGE_TASK 29
+#define TRACE 30
+#define SOLVE_REQ 31
+#define SOLVE_RESP 32
+#define STATE_FINGERPRINTS 33
+#define PREFIX_CLAIM 34
 
 #define PREFIX_MODE 101
 #define RANGE_MODE 102
 #define NO_MODE 103
+#define STATE_MODE 104
+#define SPLIT_MODE 105
+#define STEAL_MODE 106
+#define SEED_MODE 107
 
 #define OFFLOADING_ENABLE false
 #define ENABLE_DYN_OFF false
@@ -104,12 +157,14 @@ using namespace klee;
 #define FLUSH false
 
 #define MASTER_NODE 0
+#define FIRST_WORKER 1
 
 enum searchMode{
   DFS,
   BFS,
   RAND,
-  COVNEW
+  COVNEW,
+  DIST
 };
 
 namespace {
@@ -122,6 +177,13 @@ namespace {
                "Optionally, a line number can be specified to choose a specific call site "
                "(e.g. <function1>[:line],<function2>[:line],..)"));
 
+  cl::opt<std::string>
+  SkippedFunctionsFile("skip-functions-file",
+                       cl::desc("Read the --skip-functions list from the last "
+                                "line of this file, e.g. the skip-candidates "
+                                "file written by --profile-skip-functions"),
+                       cl::init(""));
+
   cl::opt<std::string>
   InlinedFunctions("inline",
                    cl::desc("Comma-separated list of functions to be inlined (e.g. <function1>,<function2>,..)"),
@@ -181,12 +243,37 @@ namespace {
 
   cl::opt<bool>
   WritePaths("write-paths",
-                cl::desc("Write .path files for each test case"));
+                cl::desc("Write .path files (the branch history) for each "
+                         "test case"));
 
   cl::opt<bool>
   WriteSymPaths("write-sym-paths",
                 cl::desc("Write .sym.path files for each test case"));
 
+  cl::opt<bool>
+  DedupTests("dedup-tests",
+             cl::desc("Ask the master whether the path of a test case was "
+                      "covered by any worker before writing it, and drop "
+                      "it if so (default=off)"));
+
+  cl::opt<bool>
+  PackTests("pack-tests",
+            cl::desc("Append the test cases to tests.kpack in the output "
+                     "directory instead of writing one .ktest file per test "
+                     "case, see ktest-pack (default=off)"));
+
+  cl::opt<bool>
+  AsyncTestWriter("async-test-writer",
+                  cl::desc("Write the files of the test cases on a "
+                           "background thread (default=off)"));
+
+  cl::opt<unsigned>
+  TestWriterQueue("test-writer-queue", cl::init(64),
+                  cl::desc("Maximum number of test cases waiting for "
+                           "--async-test-writer, generating another one "
+                           "blocks until the writer catches up "
+                           "(default=64)"));
+
   cl::opt<bool>
   ExitOnError("exit-on-error",
               cl::desc("Exit if errors occur"));
@@ -253,7 +340,9 @@ namespace {
 
   cl::opt<std::string>
   ReplayPathFile("replay-path",
-                 cl::desc("Specify a path file to replay"),
+                 cl::desc("Specify a path file to replay, a branch history "
+                          "as in the .path files and the _br_hist logs "
+                          "(with -phase1Depth=0)"),
                  cl::value_desc("path file"));
 
   cl::opt<unsigned int>
@@ -283,17 +372,37 @@ namespace {
                  cl::value_desc("policy name"),
                  cl::init("DFS"));
 
+  cl::list<std::string>
+  SearchPortfolioList("search-portfolio", cl::CommaSeparated,
+                 cl::desc("Mix of policies (BFS, DFS, RAND, COVNEW, DIST) the "
+                          "master assigns to the worker tasks, weighted by "
+                          "the coverage the workers report in their "
+                          "heartbeats (overrides searchPolicy)"),
+                 cl::value_desc("policy names"));
+
   cl::opt<std::string>
   offloadPolicy("offloadPolicy",
-                 cl::desc("policy name"),
+                 cl::desc("offload policy (DEFAULT or ADAPTIVE)"),
                  cl::value_desc("policy name"),
                  cl::init("DEFAULT"));
 
   cl::list<std::string>
-  SeedOutFile("seed-out");
+  SeedOutFile("seed-out",
+              cl::desc("Seed the exploration with this .ktest file, the "
+                       "seeds are split among the workers (with -phase1Depth)"));
 
   cl::list<std::string>
-  SeedOutDir("seed-out-dir");
+  SeedOutDir("seed-out-dir",
+             cl::desc("Seed the exploration with the .ktest files in this "
+                      "directory"));
+
+  cl::opt<bool>
+  GenerationalSeeds("generational-seeds",
+                    cl::desc("Run every seed along its own path without "
+                             "solver queries at its branches, and hand out "
+                             "each branch it did not take as a prefix "
+                             "(default=off)"),
+                    cl::init(false));
 
   cl::list<std::string>
   LinkLibraries("link-llvm-lib",
@@ -321,6 +430,155 @@ namespace {
   lb("lb",
     	cl::desc("load balance"),
     	cl::init(false));
+
+  cl::opt<bool>
+  workStealing("work-stealing",
+    	cl::desc("Idle workers steal prefixes from random peers, the master only "
+               "detects termination (replaces --lb, default=off)"),
+    	cl::init(false));
+
+  cl::opt<bool>
+  phase1Split("phase1-split",
+    	cl::desc("Only expand one state per worker in the master and let the workers "
+               "grow the phase 1 frontier in parallel (default=off)"),
+    	cl::init(false));
+
+  cl::opt<unsigned>
+  PathIntervals("path-intervals",
+    	cl::desc("Skip phase 1 and split the paths into this many intervals of "
+               "the same share, which the workers explore from the initial "
+               "state, dropping the forks out of their interval "
+               "(default=0 (off))"),
+    	cl::init(0));
+
+  cl::opt<unsigned>
+  PrefixBatchTime("prefix-batch-time",
+    	cl::desc("Hand out the phase 1 prefixes in batches worth about this "
+               "many seconds of work, judged by the time the finished ones "
+               "took, so that a worker replays the stem they share once; "
+               "not with --global-random-path (default=0 (off))"),
+    	cl::init(0));
+
+  cl::opt<bool>
+  GlobalRandomPath("global-random-path",
+    	cl::desc("Hand out the phase 1 prefixes by a random path over the "
+               "tree of the outstanding ones, instead of the largest "
+               "estimated subtrees first (default=off)"),
+    	cl::init(false));
+
+  cl::opt<bool>
+  OffloadProgressThread("offload-progress-thread",
+    	cl::desc("Answer the offload requests of the master from a thread of "
+               "the worker, so that a long solver call does not hold them up; "
+               "needs an MPI library with MPI_THREAD_MULTIPLE (default=off)"),
+    	cl::init(false));
+
+  cl::opt<unsigned>
+  LocalDonorMinWork("local-donor-min-work",
+    	cl::desc("Offload from a donor on the node of an idle worker before "
+               "donors on other nodes if its estimated work left (see "
+               "--heartbeat-interval) is at least this (default=0)"),
+    	cl::init(0));
+
+  cl::opt<bool>
+  LocalityAssignment("locality-assignment",
+    	cl::desc("Hand a prefix to the idle worker whose earlier prefixes share "
+               "the longest beginning with it, which resumes it from a "
+               "suspended state nearby instead of replaying it from the root "
+               "(default=on)"),
+    	cl::init(true));
+
+  cl::opt<unsigned>
+  CheckpointInterval("checkpoint-interval",
+    	cl::desc("Save the work the run has left to checkpoint_<output-dir> "
+               "every this many seconds and at the timeout (default=0 (off))"),
+    	cl::init(0));
+
+  cl::opt<unsigned>
+  WorkerTimeout("worker-timeout",
+    	cl::desc("Give up on a worker running a task that has not been heard "
+               "of for this many seconds and hand its task to another one, "
+               "needs --heartbeat-interval (default=0 (off))"),
+    	cl::init(0));
+
+  cl::opt<unsigned>
+  PlateauWindow("plateau-window",
+    	cl::desc("End the run once the workers newly covered fewer than "
+               "--plateau-min-covered instructions in this many seconds, "
+               "needs --heartbeat-interval (default=0 (off))"),
+    	cl::init(0));
+
+  cl::opt<unsigned>
+  PlateauMinCovered("plateau-min-covered",
+    	cl::desc("Instructions the workers have to newly cover in every "
+               "--plateau-window to keep the run going (default=1)"),
+    	cl::init(1));
+
+  cl::opt<unsigned>
+  PlateauDiversify("plateau-diversify",
+    	cl::desc("Before ending the run at a coverage plateau, this many times "
+               "switch the busy workers to another search heuristic and "
+               "give them another --plateau-window (default=0)"),
+    	cl::init(0));
+
+  cl::opt<unsigned>
+  ClaimFilterSize("claim-filter-size",
+    	cl::desc("Megabytes of the Bloom filter in which the master keeps the "
+               "path prefixes the workers claimed with --claim-prefix-depth "
+               "(default=16)"),
+    	cl::init(16));
+
+  cl::opt<unsigned>
+  ShutdownGrace("shutdown-grace",
+    	cl::desc("When a bug is found or the time is up, give the workers this "
+               "many seconds to write their test cases and statistics before "
+               "aborting the run (default=10)"),
+    	cl::init(10));
+
+  cl::opt<unsigned>
+  StandbyWorkers("standby-workers",
+    	cl::desc("Hold back the last this many ranks, which join the run when "
+               "--elastic-control asks for them (default=0)"),
+    	cl::init(0));
+
+  cl::opt<std::string>
+  ElasticControl("elastic-control",
+    	cl::desc("Read commands appended to this file during the run: "
+               "\"join [rank]\" adds a standby worker, \"leave <rank>\" has "
+               "a worker hand its states back and stop (default=off)"),
+    	cl::init(""));
+
+  cl::opt<std::string>
+  ResumeCheckpoint("resume-checkpoint",
+    	cl::desc("Skip phase 1 and hand out the work saved in this checkpoint "
+               "instead"),
+    	cl::init(""));
+
+  cl::opt<std::string>
+  ModuleCacheDir("module-cache-dir",
+    	cl::desc("Keep the linked and transformed module in this directory, "
+               "keyed by a hash of the input and the options that change it. "
+               "Later runs and tasks, and the ranks that wait for the first "
+               "one, load it instead of linking and transforming again. "
+               "Must be visible to all ranks (default=off)"),
+    	cl::init(""));
+
+  cl::opt<std::string>
+  CampaignFile("campaign",
+    	cl::desc("Run the configurations of this file (error locations, "
+               "search policies, time outs, program arguments) side by "
+               "side, each on a block of the ranks sized by its priority, "
+               "sharing the prepared module through --module-cache-dir, "
+               "which defaults to <file>.module-cache (default=off)"),
+    	cl::init(""));
+
+  cl::opt<unsigned>
+  TraceEvents("trace-events",
+    	cl::desc("Keep the last this many events of every rank (offloads, "
+               "tasks, replays, slow solver calls, recoveries, memory "
+               "kills) and write them to trace_<output-dir>.json at the end, "
+               "a Chrome trace on the clock of the master (default=0 (off))"),
+    	cl::init(0));
 }
 
 extern cl::opt<double> MaxTime;
@@ -345,6 +603,19 @@ typedef std::map<unsigned, std::pair<std::set<PSEModInfo>, std::set<PSEModInfoG>
 
 class KleeHandler : public InterpreterHandler {
 private:
+  /// the contents of the files of a test case, collected on the
+  /// interpreter thread
+  struct PendingTest {
+    unsigned id;
+    bool hasKTest;
+    std::vector< std::pair<std::string, std::vector<unsigned char> > > objects;
+    /// the other files by suffix, in the order they are written
+    std::vector< std::pair<std::string, std::string> > files;
+    /// the .info file is written last, with the time since startTime
+    bool writeInfo;
+    double startTime;
+  };
+
   Interpreter *m_interpreter;
   TreeStreamWriter *m_pathWriter, *m_symPathWriter;
   llvm::raw_ostream *m_infoFile;
@@ -353,6 +624,7 @@ private:
   std::string outputFileName;
 
   unsigned m_testIndex;  // number of tests written so far
+  unsigned m_duplicateTests; // number of tests dropped by --dedup-tests
   unsigned m_pathsExplored; // number of paths explored so far
   unsigned m_recoveryStatesCount; // number of recovery states
   unsigned m_generatedSlicesCount; // number of generated slices
@@ -362,12 +634,27 @@ private:
   int m_argc;
   char **m_argv;
 
+  // the test cases queued for the writer thread (--async-test-writer)
+  std::thread m_writerThread;
+  std::mutex m_writerLock;
+  std::condition_variable m_writerWakeup;
+  std::deque<PendingTest *> m_pendingTests;
+  bool m_stopWriter;
+
+  void writeTestCase(PendingTest &test);
+  void queueTestCase(PendingTest *test);
+  void runTestWriter();
+  void stopTestWriter();
+
+  bool isNewPath(const ExecutionState &state);
+
 public:
   KleeHandler(int argc, char **argv);
   ~KleeHandler();
 
   llvm::raw_ostream &getInfoStream() const { return *m_infoFile; }
   unsigned getNumTestCases() { return m_testIndex; }
+  unsigned getNumDuplicateTests() { return m_duplicateTests; }
   unsigned getNumPathsExplored() { return m_pathsExplored; }
   void incPathsExplored() { m_pathsExplored++; }
 
@@ -425,12 +712,14 @@ KleeHandler::KleeHandler(int argc, char **argv)
     m_infoFile(0),
     m_outputDirectory(),
     m_testIndex(0),
+    m_duplicateTests(0),
     m_pathsExplored(0),
     m_recoveryStatesCount(0),
     m_generatedSlicesCount(0),
     m_snapshotsCount(0),
     m_argc(argc),
-    m_argv(argv) {
+    m_argv(argv),
+    m_stopWriter(false) {
 
   // create output directory (OutputDir or "klee-out-<i>")
   bool dir_given = OutputDir != "";
@@ -461,7 +750,7 @@ KleeHandler::KleeHandler(int argc, char **argv)
         m_outputDirectory = d;
         outputFileName = OutputDir+std::to_string(i);
         int world_rank;
-        MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+        MPI_Comm_rank(runComm, &world_rank);
         std::cout<<"Output Directory World Rank: "<<world_rank<<" Index: "
                  <<outputFileName<<"\n";
 
@@ -504,6 +793,7 @@ std::string KleeHandler::getOutputDir() {
 }
 
 KleeHandler::~KleeHandler() {
+  stopTestWriter();
   if (m_pathWriter) delete m_pathWriter;
   if (m_symPathWriter) delete m_symPathWriter;
   fclose(klee_warning_file);
@@ -579,72 +869,41 @@ void KleeHandler::processTestCase(const ExecutionState &state,
                                   const char *errorSuffix) {
   if (errorMessage && ExitOnError) {
     llvm::errs() << "EXITING ON ERROR:\n" << errorMessage << "\n";
+    stopTestWriter();
     exit(1);
   }
 
+  if (!NoOutput && !isNewPath(state)) {
+    ++m_duplicateTests;
+    return;
+  }
+
   if (!NoOutput) {
-    std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
-    bool success = m_interpreter->getSymbolicSolution(state, out);
+    PendingTest *test = new PendingTest();
+    test->hasKTest = m_interpreter->getSymbolicSolution(state, test->objects);
 
-    if (!success)
+    if (!test->hasKTest)
       klee_warning("unable to get symbolic solution, losing test case");
 
-    double start_time = util::getWallTime();
+    test->startTime = util::getWallTime();
 
     unsigned id = ++m_testIndex;
+    test->id = id;
 
-    if (success) {
-      KTest b;
-      b.numArgs = m_argc;
-      b.args = m_argv;
-      b.symArgvs = 0;
-      b.symArgvLen = 0;
-      b.numObjects = out.size();
-      b.objects = new KTestObject[b.numObjects];
-      assert(b.objects);
-      for (unsigned i=0; i<b.numObjects; i++) {
-        KTestObject *o = &b.objects[i];
-        o->name = const_cast<char*>(out[i].first.c_str());
-        o->numBytes = out[i].second.size();
-        o->bytes = new unsigned char[o->numBytes];
-        assert(o->bytes);
-        std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
-      }
-
-      if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
-        klee_warning("unable to write output test case, losing it");
-      }
-
-      for (unsigned i=0; i<b.numObjects; i++)
-        delete[] b.objects[i].bytes;
-      delete[] b.objects;
-    }
-
-    if (errorMessage) {
-      llvm::raw_ostream *f = openTestFile(errorSuffix, id);
-      *f << errorMessage;
-      delete f;
-    }
+    if (errorMessage)
+      test->files.push_back(std::make_pair(errorSuffix, errorMessage));
 
     if (m_pathWriter) {
-      std::vector<unsigned char> concreteBranches;
-      m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
-                               concreteBranches);
-      llvm::raw_fd_ostream *f = openTestFile("path", id);
-      for (std::vector<unsigned char>::iterator I = concreteBranches.begin(),
-                                                E = concreteBranches.end();
-           I != E; ++I) {
-        *f << *I << "\n";
-      }
-      delete f;
+      //the branch history, which -replay-path takes back
+      std::vector<char> hist = state.branchHist.toVector();
+      std::string contents(hist.begin(), hist.end());
+      test->files.push_back(std::make_pair("path", contents + "\n"));
     }
 
     if (errorMessage || WriteKQueries) {
       std::string constraints;
       m_interpreter->getConstraintLog(state, constraints,Interpreter::KQUERY);
-      llvm::raw_ostream *f = openTestFile("kquery", id);
-      *f << constraints;
-      delete f;
+      test->files.push_back(std::make_pair("kquery", constraints));
     }
 
     if (WriteCVCs) {
@@ -652,51 +911,136 @@ void KleeHandler::processTestCase(const ExecutionState &state,
       // SMT-LIBv2 not CVC which is a bit confusing
       std::string constraints;
       m_interpreter->getConstraintLog(state, constraints, Interpreter::STP);
-      llvm::raw_ostream *f = openTestFile("cvc", id);
-      *f << constraints;
-      delete f;
+      test->files.push_back(std::make_pair("cvc", constraints));
     }
 
     if(WriteSMT2s) {
       std::string constraints;
         m_interpreter->getConstraintLog(state, constraints, Interpreter::SMTLIB2);
-        llvm::raw_ostream *f = openTestFile("smt2", id);
-        *f << constraints;
-        delete f;
+        test->files.push_back(std::make_pair("smt2", constraints));
     }
 
     if (m_symPathWriter) {
       std::vector<unsigned char> symbolicBranches;
       m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
                                   symbolicBranches);
-      llvm::raw_fd_ostream *f = openTestFile("sym.path", id);
+      std::string contents;
+      llvm::raw_string_ostream f(contents);
       for (std::vector<unsigned char>::iterator I = symbolicBranches.begin(), E = symbolicBranches.end(); I!=E; ++I) {
-        *f << *I << "\n";
+        f << *I << "\n";
       }
-      delete f;
+      test->files.push_back(std::make_pair("sym.path", f.str()));
     }
 
     if (WriteCov) {
       std::map<const std::string*, std::set<unsigned> > cov;
       m_interpreter->getCoveredLines(state, cov);
-      llvm::raw_ostream *f = openTestFile("cov", id);
+      std::string contents;
+      llvm::raw_string_ostream f(contents);
       for (std::map<const std::string*, std::set<unsigned> >::iterator
              it = cov.begin(), ie = cov.end();
            it != ie; ++it) {
         for (std::set<unsigned>::iterator
                it2 = it->second.begin(), ie = it->second.end();
              it2 != ie; ++it2)
-          *f << *it->first << ":" << *it2 << "\n";
+          f << *it->first << ":" << *it2 << "\n";
       }
-      delete f;
+      test->files.push_back(std::make_pair("cov", f.str()));
     }
 
     if (m_testIndex == StopAfterNTests)
       m_interpreter->setHaltExecution(true);
 
-    if (WriteTestInfo) {
-      double elapsed_time = util::getWallTime() - start_time;
-      llvm::raw_ostream *f = openTestFile("info", id);
+    test->writeInfo = WriteTestInfo;
+    if (AsyncTestWriter) {
+      queueTestCase(test);
+    } else {
+      writeTestCase(*test);
+      delete test;
+    }
+  }
+}
+
+//the master keeps the hashes of the paths of all test cases written so far
+//(--dedup-tests)
+bool KleeHandler::isNewPath(const ExecutionState &state) {
+  if (!DedupTests)
+    return true;
+
+  //FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  std::vector<char> hist = state.branchHist.toVector();
+  for (unsigned i = 0; i < hist.size(); i++) {
+    hash ^= (unsigned char) hist[i];
+    hash *= 1099511628211ULL;
+  }
+  unsigned packet[2] = { (unsigned) (hash >> 32), (unsigned) hash };
+  MPI_Send(packet, 2, MPI_UNSIGNED, 0, TEST_HASH, runComm);
+
+  //the master stops answering once it kills the workers, keep the test
+  //case then and leave the KILL to the interpreter
+  while (true) {
+    int flag;
+    MPI_Status status;
+    MPI_Iprobe(0, TEST_HASH, runComm, &flag, &status);
+    if (flag) {
+      char isNew;
+      MPI_Recv(&isNew, 1, MPI_CHAR, 0, TEST_HASH, runComm, &status);
+      return isNew;
+    }
+    MPI_Iprobe(0, KILL, runComm, &flag, &status);
+    if (flag)
+      return true;
+  }
+}
+
+void KleeHandler::writeTestCase(PendingTest &test) {
+  if (test.hasKTest) {
+    KTest b;
+    b.numArgs = m_argc;
+    b.args = m_argv;
+    b.symArgvs = 0;
+    b.symArgvLen = 0;
+    b.numObjects = test.objects.size();
+    b.objects = new KTestObject[b.numObjects];
+    assert(b.objects);
+    for (unsigned i=0; i<b.numObjects; i++) {
+      KTestObject *o = &b.objects[i];
+      o->name = const_cast<char*>(test.objects[i].first.c_str());
+      o->numBytes = test.objects[i].second.size();
+      o->bytes = new unsigned char[o->numBytes];
+      assert(o->bytes);
+      std::copy(test.objects[i].second.begin(), test.objects[i].second.end(),
+                o->bytes);
+    }
+
+    int written;
+    if (PackTests)
+      written = kTest_appendToPack(&b, test.id,
+                                   getOutputFilename("tests.kpack").c_str());
+    else
+      written = kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", test.id)).c_str());
+    if (!written) {
+      klee_warning("unable to write output test case, losing it");
+    }
+
+    for (unsigned i=0; i<b.numObjects; i++)
+      delete[] b.objects[i].bytes;
+    delete[] b.objects;
+  }
+
+  for (unsigned i = 0; i < test.files.size(); i++) {
+    llvm::raw_ostream *f = openTestFile(test.files[i].first, test.id);
+    if (!f)
+      continue;
+    *f << test.files[i].second;
+    delete f;
+  }
+
+  if (test.writeInfo) {
+    double elapsed_time = util::getWallTime() - test.startTime;
+    llvm::raw_ostream *f = openTestFile("info", test.id);
+    if (f) {
       *f << "Time to generate test case: "
          << elapsed_time << "s\n";
       delete f;
@@ -704,19 +1048,61 @@ void KleeHandler::processTestCase(const ExecutionState &state,
   }
 }
 
-  // load a .path file
+void KleeHandler::queueTestCase(PendingTest *test) {
+  std::unique_lock<std::mutex> lock(m_writerLock);
+  if (!m_writerThread.joinable())
+    m_writerThread = std::thread(&KleeHandler::runTestWriter, this);
+  while (m_pendingTests.size() >= std::max(1u, (unsigned) TestWriterQueue))
+    m_writerWakeup.wait(lock);
+  m_pendingTests.push_back(test);
+  m_writerWakeup.notify_all();
+}
+
+void KleeHandler::runTestWriter() {
+  std::unique_lock<std::mutex> lock(m_writerLock);
+  while (true) {
+    if (m_pendingTests.empty()) {
+      if (m_stopWriter)
+        return;
+      m_writerWakeup.wait(lock);
+      continue;
+    }
+    PendingTest *test = m_pendingTests.front();
+    lock.unlock();
+    writeTestCase(*test);
+    delete test;
+    lock.lock();
+    // the queue shrinks only once the test case is on disk
+    m_pendingTests.pop_front();
+    m_writerWakeup.notify_all();
+  }
+}
+
+/// Write the queued test cases before the output files are closed.
+void KleeHandler::stopTestWriter() {
+  {
+    std::lock_guard<std::mutex> lock(m_writerLock);
+    if (!m_writerThread.joinable())
+      return;
+    m_stopWriter = true;
+    m_writerWakeup.notify_all();
+  }
+  m_writerThread.join();
+}
+
+  // load a .path file, the branches are '0' or '2' for true and '1' or '3'
+  // for false, as in ExecutionState::branchHist
 void KleeHandler::loadPathFile(std::string name,
                                      std::vector<bool> &buffer) {
   std::ifstream f(name.c_str(), std::ios::in | std::ios::binary);
 
   if (!f.good())
-    assert(0 && "unable to open path file");
+    klee_error("unable to open path file: %s", name.c_str());
 
-  while (f.good()) {
-    unsigned value;
-    f >> value;
-    buffer.push_back(!!value);
-    f.get();
+  char c;
+  while (f.get(c)) {
+    if (c >= '0' && c <= '3')
+      buffer.push_back(c == '0' || c == '2');
   }
 }
 
@@ -910,6 +1296,7 @@ static const char *modelledExternals[] = {
   "klee_abort",
   "klee_assume",
   "klee_check_memory_access",
+  "klee_copy_memory",
   "klee_define_fixed_object",
   "klee_get_errno",
   "klee_get_valuef",
@@ -1305,6 +1692,185 @@ static llvm::Module *linkWithUclibc(llvm::Module *mainModule, StringRef libDir)
 }
 #endif
 
+/// Read a bitcode module, returns null with the reason in error on failure.
+static Module *readModule(const std::string &path, std::string &error) {
+  Module *module = 0;
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+  OwningPtr<MemoryBuffer> BufferPtr;
+  error_code ec=MemoryBuffer::getFileOrSTDIN(path.c_str(), BufferPtr);
+  if (ec) {
+    error = ec.message();
+    return 0;
+  }
+
+  module = getLazyBitcodeModule(BufferPtr.get(), getGlobalContext(), &error);
+
+  if (module) {
+    if (module->MaterializeAllPermanently(&error)) {
+      delete module;
+      module = 0;
+    }
+  }
+#else
+  auto Buffer = MemoryBuffer::getFileOrSTDIN(path.c_str());
+  if (!Buffer) {
+    error = Buffer.getError().message();
+    return 0;
+  }
+
+  auto moduleOrError = getLazyBitcodeModule(Buffer->get(), getGlobalContext());
+
+  if (!moduleOrError) {
+    error = moduleOrError.getError().message();
+    return 0;
+  }
+  // The module has taken ownership of the MemoryBuffer so release it
+  // from the std::unique_ptr
+  Buffer->release();
+
+  module = *moduleOrError;
+  if (auto ec = module->materializeAllPermanently()) {
+    error = ec.message();
+    delete module;
+    module = 0;
+  }
+#endif
+  return module;
+}
+
+//held by the rank which transforms the module for --module-cache-dir
+static int moduleCacheLock = -1;
+
+static void unlockModuleCache() {
+  if (moduleCacheLock >= 0) {
+    flock(moduleCacheLock, LOCK_UN);
+    close(moduleCacheLock);
+    moduleCacheLock = -1;
+  }
+}
+
+std::string getSkippedFunctions();
+
+/// The file of the transformed module in --module-cache-dir, keyed by the
+/// input, the klee build and every option the transformation depends on.
+static std::string
+getModuleCacheFile(const Interpreter::ModuleOptions &Opts) {
+  if (InputFile == "-")
+    return "";
+  if (mkdir(ModuleCacheDir.c_str(), 0775) != 0 && errno != EEXIST) {
+    klee_warning("unable to create module cache %s", ModuleCacheDir.c_str());
+    return "";
+  }
+  std::ifstream input(InputFile.c_str(), std::ios::binary);
+  if (!input.good())
+    return "";
+
+  std::stringstream key;
+  key << input.rdbuf() << '\0';
+  //a rebuilt klee comes with rebuilt runtime libraries
+  struct stat st;
+  if (stat("/proc/self/exe", &st) == 0)
+    key << st.st_mtime << ' ' << st.st_size;
+  key << '\0' << Opts.LibraryDir << '\0' << Opts.EntryPoint << '\0'
+      << Opts.Optimize << Opts.CheckDivZero << Opts.CheckOvershift << ' '
+      << static_cast<int>(Libc.getValue()) << WithPOSIXRuntime
+      << WithSymArgsRuntime << '\0'
+      << getSkippedFunctions() << '\0' << InlinedFunctions << '\0'
+      << KModule::getTransformOptions();
+  for (unsigned i = 0; i < LinkLibraries.size(); i++)
+    key << '\0' << LinkLibraries[i];
+
+  MD5 hash;
+  hash.update(key.str());
+  MD5::MD5Result result;
+  hash.final(result);
+  SmallString<32> digest;
+  MD5::stringifyResult(result, digest);
+  return ModuleCacheDir + "/module-" + digest.str().str() + ".bc";
+}
+
+/// Load the input module and link it with the libraries. With
+/// --module-cache-dir, load the transformed module of an earlier run
+/// instead. If there is none yet, the rank holds the cache lock until
+/// unlockModuleCache(), after the interpreter wrote the module, so that the
+/// other ranks wait for it rather than transform the module too.
+static Module *loadModule(Interpreter::ModuleOptions &Opts) {
+  std::string ErrorMsg;
+  std::string cacheFile;
+  if (!ModuleCacheDir.empty())
+    cacheFile = getModuleCacheFile(Opts);
+  if (!cacheFile.empty()) {
+    std::string lockFile = cacheFile + ".lock";
+    moduleCacheLock = open(lockFile.c_str(), O_RDWR | O_CREAT, 0664);
+    if (moduleCacheLock >= 0 && flock(moduleCacheLock, LOCK_EX) != 0) {
+      close(moduleCacheLock);
+      moduleCacheLock = -1;
+    }
+
+    struct stat st;
+    if (stat(cacheFile.c_str(), &st) != 0) {
+      Opts.CacheFile = cacheFile;
+    } else {
+      unlockModuleCache();
+      if (Module *cached = readModule(cacheFile, ErrorMsg)) {
+        klee_message("NOTE: Using transformed module: %s", cacheFile.c_str());
+        Opts.Prepared = true;
+        return cached;
+      }
+      klee_warning("unable to load module cache %s: %s", cacheFile.c_str(),
+                   ErrorMsg.c_str());
+    }
+  }
+
+  Module *mainModule = readModule(InputFile, ErrorMsg);
+  if (!mainModule)
+    klee_error("error loading program '%s': %s", InputFile.c_str(),
+               ErrorMsg.c_str());
+
+  if (WithPOSIXRuntime || WithSymArgsRuntime)
+    initEnv(mainModule);
+
+  switch (Libc) {
+  case NoLibc: /* silence compiler warning */
+    break;
+
+  case KleeLibc: {
+    // FIXME: Find a reasonable solution for this.
+    SmallString<128> Path(Opts.LibraryDir);
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
+    llvm::sys::path::append(Path, "klee-libc.bc");
+#else
+    llvm::sys::path::append(Path, "libklee-libc.bca");
+#endif
+    mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
+    assert(mainModule && "unable to link with klee-libc");
+    break;
+  }
+
+  case UcLibc:
+    mainModule = linkWithUclibc(mainModule, Opts.LibraryDir);
+    break;
+  }
+
+  if (WithPOSIXRuntime) {
+    SmallString<128> Path(Opts.LibraryDir);
+    llvm::sys::path::append(Path, "libkleeRuntimePOSIX.bca");
+    klee_message("NOTE: Using model: %s", Path.c_str());
+    mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
+    assert(mainModule && "unable to link with simple model");
+  }
+
+  std::vector<std::string>::iterator libs_it;
+  std::vector<std::string>::iterator libs_ie;
+  for (libs_it = LinkLibraries.begin(), libs_ie = LinkLibraries.end();
+          libs_it != libs_ie; ++libs_it) {
+    const char * libFilename = libs_it->c_str();
+    klee_message("Linking in library: %s.\n", libFilename);
+    mainModule = klee::linkWithLibrary(mainModule, libFilename);
+  }
+  return mainModule;
+}
+
 bool parseNameLineOption(
     std::string option,
     std::string &fname,
@@ -1340,6 +1906,7 @@ struct SysPointers {
 
 int master(int argc, char **argv, char **envp);
 void slave(int argc, char **argv, char **envp);
+bool isSearchPolicy(const std::string &policy);
 
 int executeWorker(int argc, char **argv, char **envp, 
 	char** workList, char* prefix, unsigned int count,
@@ -1356,6 +1923,27 @@ std::vector<std::string> split(const std::string& s, char delimiter)
   return tokens;
 }
 
+/// The --skip-functions list, or the last line of --skip-functions-file
+/// which is not a comment.
+std::string getSkippedFunctions() {
+  if (SkippedFunctionsFile == "" || SkippedFunctions != "") {
+    return SkippedFunctions;
+  }
+  std::ifstream f(SkippedFunctionsFile.c_str());
+  if (!f.good()) {
+    klee_error("unable to open --skip-functions-file: %s",
+               SkippedFunctionsFile.c_str());
+  }
+  std::string line, last;
+  while (std::getline(f, line)) {
+    line = strip(line);
+    if (!line.empty() && line[0] != '#') {
+      last = line;
+    }
+  }
+  return last;
+}
+
 void parseSkippingParameter(
   Module *module,
   std::string parameter,
@@ -1411,199 +1999,1014 @@ void parseErrorLocationParameter(std::string parameter, std::map<std::string, st
     }
 }
 
-void timeOutCheck() {
-  if(timeOut!=0) {
-   sleep(timeOut);
-  } else { 
-    sleep(86400);
+//the coordinator enforces the deadline itself, a timeOut of 0 keeps the
+//one day limit
+time_t getDeadline(time_t start) {
+  return start + (timeOut != 0 ? timeOut : 86400);
+}
+
+//the paths of the test cases written by all workers (--dedup-tests)
+std::unordered_set<uint64_t> seenPaths;
+uint64_t duplicatePaths = 0;
+
+//tell a worker whether the path of its next test case is new
+void answerTestHash(int source) {
+  unsigned packet[2];
+  MPI_Status status;
+  MPI_Recv(packet, 2, MPI_UNSIGNED, source, TEST_HASH, runComm, &status);
+  uint64_t hash = ((uint64_t) packet[0] << 32) | packet[1];
+  char isNew = seenPaths.insert(hash).second;
+  if(!isNew) {
+    ++duplicatePaths;
   }
-  //MPI_Abort(MPI_COMM_WORLD, -1);
-  char dummy;
-  MPI_Send(&dummy, 1, MPI_CHAR, 0, TIMEOUT, MPI_COMM_WORLD);
+  MPI_Send(&isNew, 1, MPI_CHAR, source, TEST_HASH, runComm);
 }
 
-int main(int argc, char **argv, char **envp) {
-  atexit(llvm_shutdown);  // Call llvm_shutdown() on exit.
+//the path prefixes the workers claimed (--claim-prefix-depth), and the
+//claims of a prefix claimed before
+BloomFilter *claimedPrefixes = 0;
+uint64_t overlappingPrefixes = 0;
+
+//tell a worker whether the subtree below a prefix is its own
+void answerPrefixClaim(int source) {
+  unsigned packet[2];
+  MPI_Status status;
+  MPI_Recv(packet, 2, MPI_UNSIGNED, source, PREFIX_CLAIM, runComm, &status);
+  uint64_t hash = ((uint64_t) packet[0] << 32) | packet[1];
+  if(!claimedPrefixes) {
+    claimedPrefixes = new BloomFilter((uint64_t) ClaimFilterSize << 23, 4);
+  }
+  char isNew = claimedPrefixes->insert(hash);
+  if(!isNew) {
+    ++overlappingPrefixes;
+  }
+  MPI_Send(&isNew, 1, MPI_CHAR, source, PREFIX_CLAIM, runComm);
+}
 
-  llvm::InitializeNativeTarget();
+void logPrefixClaims(std::ofstream &masterLog) {
+  if(claimedPrefixes) {
+    masterLog << "MASTER: CLAIMED_PREFIXES:"<<claimedPrefixes->size()
+      <<" OVERLAPPING_PREFIXES:"<<overlappingPrefixes
+      <<" FALSE_POSITIVE_RATE:"<<claimedPrefixes->getFalsePositiveRate()<<"\n";
+  }
+}
 
-  parseArguments(argc, argv);
-  sys::PrintStackTraceOnErrorSignal();
+void logUniquePaths(std::ofstream &masterLog) {
+  if(!seenPaths.empty()) {
+    masterLog << "MASTER: UNIQUE_PATHS:"<<seenPaths.size()
+      <<" DUPLICATE_PATHS:"<<duplicatePaths<<"\n";
+  }
+}
 
-  sys::SetInterruptFunction(interrupt_handle);
+//the sums of the statistics the workers report (--cluster-stats-interval),
+//written as a time series and as a JSON snapshot for outside monitors
+ClusterStats clusterStats;
+std::ofstream clusterStatsLog;
+double clusterStatsStart = 0, lastClusterStatsRow = 0;
+
+void writeClusterStats() {
+  double now = util::getWallTime();
+  std::string name = "cluster_stats_"+OutputDir;
+  if(!clusterStatsLog.is_open()) {
+    clusterStatsLog.open(name);
+    clusterStats.writeHeader(clusterStatsLog);
+  }
+  clusterStats.writeRow(clusterStatsLog, now - clusterStatsStart);
+  clusterStatsLog.flush();
+  //readers never see a half written snapshot
+  std::ofstream snapshot(name+".json.tmp");
+  clusterStats.writeJSON(snapshot, now - clusterStatsStart);
+  snapshot.close();
+  rename((name+".json.tmp").c_str(), (name+".json").c_str());
+  lastClusterStatsRow = now;
+}
 
-	/*MPI Parallel Code should go here*/
-	MPI_Init(NULL, NULL);
+//the traces of the workers (--trace-events), sent before their KILL_COMP
+TraceMerger traceMerger;
 
-	int world_rank;
-	MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
-	//master rank 
-	if(world_rank == 0) {
-  	master(argc, argv, envp);
-	} else if(world_rank == 1) {
-  	timeOutCheck();
-	} else { //slaves
-  	slave(argc, argv, envp);
-	}
+void addTrace(int source, const char *buffer, int count) {
+  if(!traceMerger.addPacket(source, buffer, count, EventTrace::now())) {
+    klee_warning("malformed trace from worker %d", source);
+  }
+}
 
-	MPI_Finalize();
-	return 0;
+void writeTrace() {
+  const EventTrace &trace = EventTrace::getProcessTrace();
+  std::vector<EventTrace::Event> events;
+  trace.getEvents(events);
+  traceMerger.add(MASTER_NODE, events, 0, trace.getNumDropped());
+  std::ofstream os("trace_"+OutputDir+".json");
+  traceMerger.writeChromeTrace(os);
 }
 
-std::string getNewSearch() {
-  if(searchPolicy == "BFS") {
-    return "BFS";
-  } else if (searchPolicy == "DFS") {
-    return "DFS";
-  } else if (searchPolicy == "RAND") {
-    return "RAND";
-  } else if (searchPolicy == "COVNEW") {
-    return "COVNEW";
-  } else {
-		return "DFS";
-	}
+//the trace of the worker, if any, then its KILL_COMP
+void recvKillComp(int source) {
+  MPI_Status status;
+  if(TraceEvents) {
+    int count;
+    MPI_Probe(source, TRACE, runComm, &status);
+    MPI_Get_count(&status, MPI_CHAR, &count);
+    std::vector<char> buffer(count);
+    MPI_Recv(&buffer[0], count, MPI_CHAR, source, TRACE, runComm, &status);
+    addTrace(source, &buffer[0], count);
+  }
+  char dummy;
+  MPI_Recv(&dummy, 1, MPI_CHAR, source, KILL_COMP, runComm, &status);
 }
 
-int master(int argc, char **argv, char **envp) {
+//the master stops listening once it has the KILL_COMP, the trace goes first
+void sendKillComp() {
+  if(TraceEvents) {
+    std::vector<char> packet;
+    EventTrace::getProcessTrace().encode(EventTrace::now(), packet);
+    MPI_Send(&packet[0], packet.size(), MPI_CHAR, MASTER_NODE, TRACE, runComm);
+  }
+  char result = 0;
+  MPI_Send(&result, 1, MPI_CHAR, MASTER_NODE, KILL_COMP, runComm);
+}
 
-  //setting up the workers 
-  int num_cores;
-  MPI_Comm_size(MPI_COMM_WORLD, &num_cores);
-	std::ofstream masterLog;
-	masterLog.open("log_master_"+OutputDir);
-	if(phase1Depth == 0) {
-		char buf[256];
-		time_t t[2];
+void recvClusterStats(int source) {
+  uint64_t record[ClusterStats::NumFields];
+  MPI_Status status;
+  MPI_Recv(record, ClusterStats::NumFields, MPI_UINT64_T, source,
+      CLUSTER_STATS, runComm, &status);
+  clusterStats.update(source, record);
+  //at most one row a second, however many workers report
+  if(util::getWallTime() - lastClusterStatsRow >= 1) {
+    writeClusterStats();
+  }
+}
+
+//when every worker was last heard of (--worker-timeout)
+std::vector<time_t> lastHeard;
+
+//wait for the next message from any worker, returns false once the
+//deadline has passed. Test case hashes, prefix claims and statistics are
+//handled on the way.
+bool probeUntil(time_t deadline, MPI_Status &status) {
+  int flag = false;
+  while(!flag) {
+    if(time(NULL) >= deadline) {
+      return false;
+    }
+    MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, runComm, &flag, &status);
+    if(flag && status.MPI_SOURCE < (int)lastHeard.size()) {
+      lastHeard[status.MPI_SOURCE] = time(NULL);
+    }
+    if(flag && (status.MPI_TAG == TEST_HASH)) {
+      answerTestHash(status.MPI_SOURCE);
+      flag = false;
+    } else if(flag && (status.MPI_TAG == PREFIX_CLAIM)) {
+      answerPrefixClaim(status.MPI_SOURCE);
+      flag = false;
+    } else if(flag && (status.MPI_TAG == CLUSTER_STATS)) {
+      recvClusterStats(status.MPI_SOURCE);
+      flag = false;
+    }
+  }
+  return true;
+}
+
+//the work a run has left (--checkpoint-interval): the tasks not handed out
+//yet and the ones the workers are running
+time_t lastCheckpoint = 0;
+
+void writeCheckpoint(const TaskCheckpoint &running,
+    const std::vector<std::string> &prefixes, const std::vector<int> &prefixTags,
+    const std::vector<bool> &dispatched, std::ofstream &masterLog) {
+  std::vector<TaskCheckpoint::Task> queued;
+  for(unsigned i=0; i<prefixes.size(); ++i) {
+    if(!dispatched[i]) {
+      queued.push_back(TaskCheckpoint::Task(prefixTags[i], prefixes[i]));
+    }
+  }
+  std::string error;
+  if(running.write("checkpoint_"+OutputDir, queued, error)) {
+    masterLog << "MASTER: CHECKPOINT Queued:"<<queued.size()
+              <<" Running:"<<running.getNumRunning()<<"\n";
+  } else {
+    klee_warning("checkpoint failed: %s", error.c_str());
+  }
+  lastCheckpoint = time(NULL);
+}
+
+void checkpointIfDue(const TaskCheckpoint &running,
+    const std::vector<std::string> &prefixes, const std::vector<int> &prefixTags,
+    const std::vector<bool> &dispatched, std::ofstream &masterLog) {
+  if(CheckpointInterval && time(NULL) - lastCheckpoint >= CheckpointInterval) {
+    writeCheckpoint(running, prefixes, prefixTags, dispatched, masterLog);
+  }
+}
+
+//the ranks held back by --standby-workers, the lowest last
+std::vector<unsigned> standbyWorkers;
+
+//end the run from the master, once the workers were sent KILL: abort the
+//job, or with --campaign only leave it, so that the other configurations
+//go on while the workers of this one finish by themselves
+void endRun() {
+  if(runComm == MPI_COMM_WORLD) {
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+  //the standby workers would wait for a task until the job ends
+  char dummy;
+  for(unsigned i=0; i<standbyWorkers.size(); ++i) {
+    MPI_Send(&dummy, 1, MPI_CHAR, standbyWorkers[i], KILL, runComm);
+  }
+  stopSolverService();
+  MPI_Finalize();
+  exit(0);
+}
+
+//stop the workers and give them --shutdown-grace seconds to write their
+//test cases and statistics (KILL_COMP), taking whatever else they still
+//send meanwhile; workers, if given, tells which ranks are lost and not
+//waited for
+void shutdownWorkers(int num_cores, std::ofstream &masterLog,
+    const WorkerTracker *workers) {
+  char dummy;
+  std::vector<bool> stopping(num_cores, false);
+  int numStopping = 0;
+  for(int x=FIRST_WORKER; x<num_cores; ++x) {
+    if(!workers || !workers->isLost(x)) {
+      MPI_Send(&dummy, 1, MPI_CHAR, x, KILL, runComm);
+      stopping[x] = true;
+      numStopping++;
+    }
+  }
+  //probeUntil answers the test hashes the workers ask for while they
+  //write their test cases
+  MPI_Status status;
+  time_t deadline = time(NULL) + ShutdownGrace;
+  while(numStopping > 0 && probeUntil(deadline, status)) {
+    int count;
+    MPI_Get_count(&status, MPI_CHAR, &count);
+    std::vector<char> buffer(count+1);
+    MPI_Recv(&buffer[0], count, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG,
+        runComm, &status);
+    if(status.MPI_TAG == KILL_COMP && stopping[status.MPI_SOURCE]) {
+      stopping[status.MPI_SOURCE] = false;
+      numStopping--;
+    } else if(status.MPI_TAG == TRACE) {
+      addTrace(status.MPI_SOURCE, &buffer[0], count);
+    }
+  }
+  if(numStopping > 0) {
+    masterLog << "MASTER: "<<numStopping<<" WORKERS DID NOT STOP IN "<<ShutdownGrace<<"s\n";
+  }
+  logUniquePaths(masterLog);
+  logPrefixClaims(masterLog);
+  if(clusterStats.getNumReporting()) writeClusterStats();
+  if(TraceEvents) writeTrace();
+  masterLog.close();
+  endRun();
+}
+
+void timeOutWorkers(int num_cores, std::ofstream &masterLog,
+    const WorkerTracker *workers) {
+  masterLog << "MASTER: TIMEOUT\n";
+  shutdownWorkers(num_cores, masterLog, workers);
+}
+
+//queue a task again, after the tasks already queued
+void requeueTask(const std::string &data, int tag,
+    std::vector<std::string> &prefixes, std::vector<int> &prefixTags,
+    std::vector<bool> &dispatched, WorkTree &outstanding) {
+  if(GlobalRandomPath) {
+    outstanding.add(data, prefixes.size());
+  }
+  prefixes.push_back(data);
+  prefixTags.push_back(tag);
+  dispatched.push_back(false);
+}
+
+//give up on the workers whose task has not been heard of for
+//--worker-timeout seconds and queue their tasks again, returns true if an
+//offload request died with them
+bool reclaimLostWorkers(WorkerTracker &workers, SearchPortfolio &portfolio,
+    TaskCheckpoint &running, std::vector<int> &pendingTasks,
+    std::vector<std::string> &prefixes, std::vector<int> &prefixTags,
+    std::vector<bool> &dispatched, std::vector<int> &queuedTasks,
+    WorkTree &outstanding, std::ofstream &masterLog) {
+  bool offloadLost = false;
+  time_t now = time(NULL);
+  for(unsigned x=FIRST_WORKER; x<lastHeard.size(); ++x) {
+    const TaskCheckpoint::Task &task = running.getTask(x);
+    if(workers.isLost(x) || task.tag == -1 || now - lastHeard[x] < WorkerTimeout) {
+      continue;
+    }
+    masterLog << "MASTER: WORKER_LOST ID:"<<x<<" Silent:"<<now - lastHeard[x]<<"s\n";
+    if(FLUSH) masterLog.flush();
+    requeueTask(task.data, task.tag, prefixes, prefixTags, dispatched,
+        outstanding);
+    //the task it was handed early goes out again too
+    if(queuedTasks[x] != -1) {
+      unsigned queued = queuedTasks[x];
+      dispatched[queued] = true;
+      queuedTasks[x] = -1;
+      requeueTask(prefixes[queued], prefixTags[queued], prefixes, prefixTags,
+          dispatched, outstanding);
+    }
+    running.finish(x);
+    if(workers.markLost(x)) {
+      offloadLost = true;
+    }
+    portfolio.release(x);
+    pendingTasks[x] = 0;
+  }
+  if(workers.getNumWorkers() == 0) {
+    masterLog << "MASTER: NO WORKERS LEFT\n";
+    if(CheckpointInterval) {
+      writeCheckpoint(running, prefixes, prefixTags, dispatched, masterLog);
+    }
+    masterLog.close();
+    endRun();
+  }
+  return offloadLost;
+}
+
+//the workers asked to leave
+std::vector<bool> leaving;
+//how far --elastic-control was read, and when
+std::streamoff elasticControlRead = 0;
+time_t lastElasticPoll = 0;
+
+//apply the commands appended to --elastic-control since the last look. A
+//joining rank waits for its first task like any idle worker, a leaving one
+//gets no more work and hands its states back (LEAVE_RESP)
+void pollElasticControl(WorkerTracker &workers, std::ofstream &masterLog) {
+  if(ElasticControl.empty() || time(NULL) == lastElasticPoll) {
+    return;
+  }
+  lastElasticPoll = time(NULL);
+  std::ifstream control(ElasticControl.c_str());
+  if(!control || !control.seekg(elasticControlRead)) {
+    return;
+  }
+  std::string line;
+  //a line without its newline may still be written
+  while(std::getline(control, line) && !control.eof()) {
+    elasticControlRead = control.tellg();
+    std::istringstream command(line);
+    std::string verb;
+    int rank = -1;
+    command >> verb >> rank;
+    if(verb == "join") {
+      std::vector<unsigned>::iterator it = standbyWorkers.end();
+      if(rank == -1 && !standbyWorkers.empty()) {
+        --it;
+      } else if(rank != -1) {
+        it = std::find(standbyWorkers.begin(), standbyWorkers.end(),
+            (unsigned) rank);
+      }
+      if(it == standbyWorkers.end()) {
+        masterLog << "MASTER: NO_STANDBY_WORKER "<<line<<"\n";
+        continue;
+      }
+      unsigned x = *it;
+      standbyWorkers.erase(it);
+      workers.markJoined(x);
+      lastHeard[x] = time(NULL);
+      masterLog << "MASTER: WORKER_JOINED ID:"<<x<<"\n";
+    } else if(verb == "leave") {
+      if(rank < FIRST_WORKER || rank >= (int) leaving.size() ||
+         workers.isLost(rank) || leaving[rank]) {
+        masterLog << "MASTER: NOT_A_WORKER "<<line<<"\n";
+        continue;
+      }
+      //stolen tasks are not tracked by the master
+      if(workStealing) {
+        klee_warning("elastic-control: workers can not leave with "
+                     "--work-stealing");
+        continue;
+      }
+      unsigned numLeaving = std::count(leaving.begin(), leaving.end(), true);
+      if(workers.getNumWorkers() <= numLeaving + 1) {
+        masterLog << "MASTER: LAST_WORKER_STAYS ID:"<<rank<<"\n";
+        continue;
+      }
+      char dummy;
+      MPI_Send(&dummy, 1, MPI_CHAR, rank, LEAVE, runComm);
+      leaving[rank] = true;
+      workers.markNotReady(rank);
+      if(!workers.isBusy(rank)) {
+        workers.markBusy(rank);
+      }
+      masterLog << "MASTER->WORKER: LEAVE ID:"<<rank<<"\n";
+    } else if(!verb.empty()) {
+      klee_warning("elastic-control: unknown command: %s", line.c_str());
+    }
+    if(FLUSH) masterLog.flush();
+  }
+}
+
+//the worker left and handed back its states as one prefix packet (or 'x'
+//for none), returns true if an offload request died with it
+bool retireWorker(unsigned x, const std::vector<char> &packet,
+    WorkerTracker &workers, SearchPortfolio &portfolio,
+    TaskCheckpoint &running, std::vector<int> &pendingTasks,
+    std::vector<std::string> &prefixes, std::vector<int> &prefixTags,
+    std::vector<bool> &dispatched, std::vector<int> &queuedTasks,
+    WorkTree &outstanding, std::ofstream &masterLog) {
+  masterLog << "WORKER->MASTER: LEFT ID:"<<x<<" Length:"<<packet.size()<<"\n";
+  if(FLUSH) masterLog.flush();
+  if(packet.size() > 1) {
+    requeueTask(std::string(packet.begin(), packet.end()), START_PREFIX_TASK,
+        prefixes, prefixTags, dispatched, outstanding);
+  }
+  //it stopped before getting to the task it was handed early
+  if(queuedTasks[x] != -1) {
+    unsigned queued = queuedTasks[x];
+    dispatched[queued] = true;
+    queuedTasks[x] = -1;
+    requeueTask(prefixes[queued], prefixTags[queued], prefixes, prefixTags,
+        dispatched, outstanding);
+  }
+  leaving[x] = false;
+  running.finish(x);
+  bool offloadLost = workers.markLost(x);
+  portfolio.release(x);
+  pendingTasks[x] = 0;
+  return offloadLost;
+}
+
+//pick the idle worker for a task, the nearest one for a prefix
+bool popIdleFor(WorkerTracker &workers, int tag, const std::string &data,
+    unsigned &rank) {
+  if(!LocalityAssignment || tag != START_PREFIX_TASK) {
+    return workers.popIdle(rank);
+  }
+  //a batch is placed by its first prefix, all of them are remembered
+  std::vector<std::vector<unsigned char> > batch;
+  if(!PrefixCodec::decode(data.data(), data.size(), batch)) {
+    batch.push_back(std::vector<unsigned char>(data.begin(), data.end()));
+  }
+  const char *first = reinterpret_cast<const char*>(batch[0].data());
+  if(!workers.popIdleNearest(first, batch[0].size(), rank)) {
+    return false;
+  }
+  for(unsigned i=0; i<batch.size(); ++i) {
+    workers.addPrefix(rank, reinterpret_cast<const char*>(batch[i].data()),
+        batch[i].size());
+  }
+  return true;
+}
+
+//the node (lowest rank of the shared memory group) of every rank
+std::vector<unsigned> rankNodes;
+
+void discoverTopology() {
+  int world_rank, num_cores;
+  MPI_Comm_rank(runComm, &world_rank);
+  MPI_Comm_size(runComm, &num_cores);
+  MPI_Comm nodeComm;
+  MPI_Comm_split_type(runComm, MPI_COMM_TYPE_SHARED, world_rank,
+      MPI_INFO_NULL, &nodeComm);
+  unsigned node = world_rank;
+  MPI_Bcast(&node, 1, MPI_UNSIGNED, 0, nodeComm);
+  MPI_Comm_free(&nodeComm);
+  rankNodes.resize(num_cores);
+  MPI_Allgather(&node, 1, MPI_UNSIGNED, &rankNodes[0], 1, MPI_UNSIGNED,
+      runComm);
+}
+
+//--campaign: give every configuration a block of the ranks with a
+//communicator of its own (runComm), and set the options of the one this
+//rank runs
+void splitCampaign() {
+  int world_rank, world_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  Campaign campaign;
+  std::string error;
+  if(!campaign.read(CampaignFile, error)) {
+    klee_error("campaign option: %s", error.c_str());
+  }
+  //a master and a worker besides the solver ranks
+  unsigned minRanks = FIRST_WORKER + 1 + getNumSolverRanks();
+  std::vector<unsigned> blocks;
+  if(!campaign.partition(world_size, minRanks, blocks)) {
+    klee_error("campaign option: %u configurations need at least %u ranks",
+        campaign.size(), campaign.size() * minRanks);
+  }
+  for(unsigned i=0; i<campaign.size(); ++i) {
+    if(!campaign[i].search.empty() && !isSearchPolicy(campaign[i].search)) {
+      klee_error("campaign option: invalid policy of %s: %s",
+          campaign[i].name.c_str(), campaign[i].search.c_str());
+    }
+  }
+  if(world_rank == 0) {
+    unsigned first = 0;
+    for(unsigned i=0; i<campaign.size(); ++i) {
+      klee_message("campaign: %s on ranks %u-%u", campaign[i].name.c_str(),
+          first, first + blocks[i] - 1);
+      first += blocks[i];
+    }
+  }
+
+  unsigned index = Campaign::getConfig(blocks, world_rank);
+  MPI_Comm_split(MPI_COMM_WORLD, index, world_rank, &runComm);
+  const Campaign::Config &config = campaign[index];
+  if(!config.errorLocation.empty()) {
+    ErrorLocation = config.errorLocation;
+  }
+  if(!config.search.empty()) {
+    searchPolicy = config.search;
+  }
+  if(config.timeOut) {
+    timeOut = config.timeOut;
+  }
+  if(config.hasArgs) {
+    InputArgv.clear();
+    InputArgv.insert(InputArgv.end(), config.args.begin(), config.args.end());
+  }
+  OutputDir = (OutputDir.empty() ? std::string("campaign") : OutputDir) +
+      "_" + config.name;
+  //the first rank to load the module prepares it for all the others
+  if(ModuleCacheDir.empty()) {
+    ModuleCacheDir = CampaignFile + ".module-cache";
+  }
+}
+
+//--prefix-batch-time: when every worker got its task and how many phase 1
+//prefixes it held, 0 for none (or not timed)
+std::vector<double> taskStarted;
+std::vector<unsigned> taskPrefixes;
+//the time the timed prefixes took, and how many there were
+double prefixSeconds = 0;
+unsigned prefixesTimed = 0;
+const unsigned maxPrefixBatch = 64;
+
+//a phase 1 prefix as it comes from the master's run, not yet packed
+bool isRawPrefix(int tag, const std::string &data) {
+  return tag == START_PREFIX_TASK && !data.empty() &&
+      data.find_first_not_of("0123") == std::string::npos;
+}
+
+void startTaskTimer(unsigned worker, int tag, const std::string &data) {
+  if(!PrefixBatchTime) {
+    return;
+  }
+  taskStarted.resize(worker+1, 0);
+  taskPrefixes.resize(worker+1, 0);
+  taskStarted[worker] = util::getWallTime();
+  std::vector<std::vector<unsigned char> > batch;
+  if(isRawPrefix(tag, data)) {
+    taskPrefixes[worker] = 1;
+  } else if(tag == START_PREFIX_TASK &&
+            PrefixCodec::decode(data.data(), data.size(), batch)) {
+    taskPrefixes[worker] = batch.size();
+  } else {
+    taskPrefixes[worker] = 0;
+  }
+}
+
+void stopTaskTimer(unsigned worker) {
+  if(worker >= taskPrefixes.size() || !taskPrefixes[worker]) {
+    return;
+  }
+  prefixSeconds += util::getWallTime() - taskStarted[worker];
+  prefixesTimed += taskPrefixes[worker];
+  taskPrefixes[worker] = 0;
+}
+
+//--prefix-batch-time: pack the raw prefix at next together with the raw
+//prefixes not handed out yet which share the longest stem with it, as many
+//as fit the batch time, into one packet in its place. Those with the same
+//stem length keep their order, so the nearest and largest still go first.
+void batchPrefixes(unsigned next, std::vector<std::string> &prefixes,
+    std::vector<int> &prefixTags, std::vector<bool> &dispatched) {
+  if(!PrefixBatchTime || GlobalRandomPath || !prefixesTimed ||
+     !isRawPrefix(prefixTags[next], prefixes[next])) {
+    return;
+  }
+  double perPrefix = prefixSeconds / prefixesTimed;
+  unsigned size = perPrefix * maxPrefixBatch <= PrefixBatchTime ?
+      maxPrefixBatch : (unsigned) (PrefixBatchTime / perPrefix);
+  if(size < 2) {
+    return;
+  }
+
+  const std::string &head = prefixes[next];
+  std::vector<std::pair<int, unsigned> > stems;
+  for(unsigned i=next+1; i<prefixes.size(); ++i) {
+    if(dispatched[i] || !isRawPrefix(prefixTags[i], prefixes[i])) {
+      continue;
+    }
+    unsigned j = 0;
+    while(j < head.size() && j < prefixes[i].size() && head[j] == prefixes[i][j]) {
+      ++j;
+    }
+    stems.push_back(std::make_pair(-(int) j, i));
+  }
+  std::stable_sort(stems.begin(), stems.end());
+  if(stems.size() > size-1) {
+    stems.resize(size-1);
+  }
+  if(stems.empty()) {
+    return;
+  }
+
+  std::vector<std::vector<char> > batch(1, std::vector<char>(head.begin(), head.end()));
+  std::vector<bool> taken(prefixes.size(), false);
+  for(unsigned i=0; i<stems.size(); ++i) {
+    const std::string &p = prefixes[stems[i].second];
+    batch.push_back(std::vector<char>(p.begin(), p.end()));
+    taken[stems[i].second] = true;
+  }
+  std::vector<char> packet;
+  PrefixCodec::encode(batch, packet);
+  prefixes[next].assign(packet.begin(), packet.end());
+
+  unsigned kept = next+1;
+  for(unsigned i=next+1; i<prefixes.size(); ++i) {
+    if(taken[i]) {
+      continue;
+    }
+    prefixes[kept].swap(prefixes[i]);
+    prefixTags[kept] = prefixTags[i];
+    dispatched[kept] = dispatched[i];
+    ++kept;
+  }
+  prefixes.resize(kept);
+  prefixTags.resize(kept);
+  dispatched.resize(kept);
+}
+
+//the index of the next task to hand out
+unsigned takeNextTask(unsigned cnt, WorkTree &outstanding, RNG &workRNG,
+    std::vector<std::string> &prefixes, std::vector<int> &prefixTags,
+    std::vector<bool> &dispatched) {
+  if(!outstanding.empty()) {
+    return outstanding.takeRandomPath(workRNG);
+  }
+  batchPrefixes(cnt, prefixes, prefixTags, dispatched);
+  return cnt;
+}
+
+//hand the next prefix to a worker which runs dry soon (--prefetch-below),
+//it is only recorded as running once the worker gets to it
+void sendQueuedTask(unsigned worker, unsigned next, std::vector<int> &queuedTasks,
+    std::vector<std::string> &prefixes, std::vector<int> &prefixTags,
+    std::ofstream &masterLog) {
+  MPI_Send(&(prefixes[next][0]), prefixes[next].size(), MPI_CHAR, worker,
+      prefixTags[next], runComm);
+  queuedTasks[worker] = next;
+  masterLog << "MASTER->WORKER: QUEUE_WORK ID:"<<worker<<"\n";
+  if(FLUSH) masterLog.flush();
+}
+
+//the worker ran dry and went on with its queued task
+bool startQueuedTask(unsigned worker, std::vector<int> &queuedTasks,
+    TaskCheckpoint &running, std::vector<std::string> &prefixes,
+    std::vector<int> &prefixTags, std::vector<bool> &dispatched,
+    std::ofstream &masterLog) {
+  if(queuedTasks[worker] == -1) {
+    return false;
+  }
+  unsigned next = queuedTasks[worker];
+  queuedTasks[worker] = -1;
+  dispatched[next] = true;
+  running.start(worker, prefixTags[next], prefixes[next]);
+  startTaskTimer(worker, prefixTags[next], prefixes[next]);
+  lastHeard[worker] = time(NULL);
+  masterLog << "MASTER->WORKER: START_WORK ID:"<<worker<<" (queued)\n";
+  if(FLUSH) masterLog.flush();
+  return true;
+}
+
+//with work stealing a worker is counted busy from the moment a task is
+//handed to it (by the master or a peer) until it reports FINISH. Counts
+//can go negative when a FINISH overtakes the STEAL_GIVEN of its task.
+bool allTasksDone(const std::vector<int> &pendingTasks) {
+  for(unsigned x=FIRST_WORKER; x<pendingTasks.size(); ++x) {
+    if(pendingTasks[x] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//the instructions the workers newly cover (--plateau-window), and the
+//times the heuristics were switched at a plateau
+CoveragePlateau coveragePlateau(0, 0, 0);
+unsigned plateauRounds = 0;
+
+//periodic worker status (--heartbeat-interval), the ready flag and the
+//work estimate are used for scheduling: queue size, ready, instructions,
+//covered delta, estimated nodes left
+void recvHeartbeat(int source, WorkerTracker &workers,
+    SearchPortfolio &portfolio) {
+  unsigned heartbeat[6];
+  MPI_Status status;
+  MPI_Recv(heartbeat, 6, MPI_UNSIGNED, source, HEARTBEAT, runComm, &status);
+  //a heartbeat can not overtake the FINISH of its sender, but ignore
+  //workers that are not running anything anyway
+  if(!workers.isBusy(source)) {
+    return;
+  }
+  workers.setWorkEstimate(source, heartbeat[4]);
+  workers.setTargetDistance(source, heartbeat[5]);
+  portfolio.recordCoverage(source, heartbeat[3]);
+  coveragePlateau.record(time(NULL), heartbeat[3]);
+  if(heartbeat[1]) {
+    workers.markReady(source);
+  } else {
+    workers.markNotReady(source);
+  }
+}
+
+//receive the frontier a worker expanded its task to, the prefixes are
+//terminated by dashes and the paths its seeds finished by pluses
+void recvFrontier(int num_cores, time_t deadline, std::ofstream &masterLog,
+    std::vector<std::string> &prefixes,
+    std::vector<std::string> *finished = 0) {
+  MPI_Status status;
+  if(!probeUntil(deadline, status)) {
+    timeOutWorkers(num_cores, masterLog, 0);
+  }
+  int count;
+  MPI_Get_count(&status, MPI_CHAR, &count);
+  std::vector<char> buffer(count+1);
+  MPI_Recv(&buffer[0], count, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG,
+      runComm, &status);
+  if(status.MPI_TAG == BUG_FOUND) {
+    masterLog << "WORKER->MASTER:  BUG FOUND:"<<status.MPI_SOURCE<<"\n";
+    shutdownWorkers(num_cores, masterLog, 0);
+  }
+  assert(status.MPI_TAG == SPLIT_RESP && "MASTER received an illegal tag");
+  masterLog << "WORKER->MASTER: SPLIT_RESP ID:"<<status.MPI_SOURCE<<" Length:"<<count<<"\n";
+
+  std::string prefix;
+  for(int x=0; x<count; ++x) {
+    if(buffer[x] == '-') {
+      prefixes.push_back(prefix);
+      prefix.clear();
+    } else if(buffer[x] == '+') {
+      if(finished) {
+        finished->push_back(prefix);
+      }
+      prefix.clear();
+    } else {
+      prefix.push_back(buffer[x]);
+    }
+  }
+}
+
+//hand one subtree to every worker and collect the prefixes they expand it
+//to, each worker grows its subtree to a share of phase1Depth states
+void splitFrontier(char** workList, std::vector<unsigned int> &pathSizes,
+    int num_cores, time_t deadline, std::ofstream &masterLog,
+    std::vector<std::string> &prefixes) {
+  int numSplits = pathSizes.size();
+  for(int i=0; i<numSplits; ++i) {
+    masterLog << "MASTER->WORKER: SPLIT_WORK ID:"<<FIRST_WORKER+i<<"\n";
+    MPI_Send(&(workList[i][0]), pathSizes[i], MPI_CHAR, FIRST_WORKER+i,
+        START_SPLIT_TASK, runComm);
+  }
+
+  for(int i=0; i<numSplits; ++i) {
+    recvFrontier(num_cores, deadline, masterLog, prefixes);
+  }
+}
+
+//deal the seeds out to the workers, each explores the whole tree along its
+//share of them and sends back the states it did not finish. the paths left
+//by every worker become the prefixes of the load balancing phase
+void seedFrontier(int num_cores, time_t deadline, std::ofstream &masterLog,
+    std::vector<std::string> &prefixes) {
+  std::vector<std::string> seedFiles(SeedOutFile.begin(), SeedOutFile.end());
+  for(unsigned i=0; i<SeedOutDir.size(); ++i) {
+    KleeHandler::getKTestFilesInDir(SeedOutDir[i], seedFiles);
+  }
+  if(seedFiles.empty()) {
+    klee_error("no seeds found in -seed-out or -seed-out-dir");
+  }
+  std::sort(seedFiles.begin(), seedFiles.end());
+
+  //the file names, one per line
+  unsigned numShares = std::min<size_t>(num_cores-FIRST_WORKER, seedFiles.size());
+  for(unsigned i=0; i<numShares; ++i) {
+    std::string share;
+    unsigned numSeeds = 0;
+    for(unsigned j=i; j<seedFiles.size(); j+=numShares) {
+      share += seedFiles[j];
+      share.push_back('\n');
+      ++numSeeds;
+    }
+    masterLog << "MASTER->WORKER: SEED_WORK ID:"<<FIRST_WORKER+i<<" Seeds:"<<numSeeds<<"\n";
+    MPI_Send(&share[0], share.size(), MPI_CHAR, FIRST_WORKER+i,
+        START_SEED_TASK, runComm);
+  }
+
+  //a generational task hands back the branches its seeds did not take,
+  //anything under those is left whichever worker sent them
+  if(GenerationalSeeds) {
+    GenerationFrontier generations;
+    for(unsigned i=0; i<numShares; ++i) {
+      std::vector<std::string> left, finished;
+      recvFrontier(num_cores, deadline, masterLog, left, &finished);
+      generations.add(left, finished);
+    }
+    prefixes = generations.getPrefixes();
+  } else {
+    SeedFrontier frontier;
+    for(unsigned i=0; i<numShares; ++i) {
+      std::vector<std::string> left;
+      recvFrontier(num_cores, deadline, masterLog, left);
+      frontier.add(left);
+    }
+    prefixes = frontier.getPrefixes();
+  }
+  masterLog << "MASTER: SEEDED Seeds:"<<seedFiles.size()<<" Prefixes:"<<prefixes.size()<<"\n";
+}
+
+int main(int argc, char **argv, char **envp) {
+  atexit(llvm_shutdown);  // Call llvm_shutdown() on exit.
+
+  llvm::InitializeNativeTarget();
+
+  parseArguments(argc, argv);
+  sys::PrintStackTraceOnErrorSignal();
+  if(TraceEvents) EventTrace::getProcessTrace().setCapacity(TraceEvents);
+
+  sys::SetInterruptFunction(interrupt_handle);
+
+	/*MPI Parallel Code should go here*/
+	if(OffloadProgressThread) {
+		int provided;
+		MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, &provided);
+	} else {
+		MPI_Init(NULL, NULL);
+	}
+
+	if(!CampaignFile.empty()) {
+		splitCampaign();
+	}
+	discoverTopology();
+
+	int world_rank;
+	MPI_Comm_rank(runComm, &world_rank);
+	if(getNumSolverRanks() < 0 || getNumInterpreterRanks() <= FIRST_WORKER) {
+		klee_error("--solver-ranks=%d leaves no rank for the workers",
+		           getNumSolverRanks());
+	}
+	//master rank 
+	if(world_rank == 0) {
+  	master(argc, argv, envp);
+		stopSolverService();
+	} else if(isSolverRank(world_rank)) {
+		runSolverService();
+	} else { //slaves
+  	slave(argc, argv, envp);
+	}
+
+	MPI_Finalize();
+	return 0;
+}
+
+//the policy of the next task, if the master picked one (--search-portfolio)
+std::string portfolioSearch;
+
+bool isSearchPolicy(const std::string &policy) {
+  return policy == "BFS" || policy == "DFS" || policy == "RAND" ||
+      policy == "COVNEW" || policy == "DIST";
+}
+
+//tell an idle worker the policy of the task it is sent next
+void sendSearchMode(SearchPortfolio &portfolio, unsigned rank,
+    std::ofstream &masterLog) {
+  if(portfolio.empty()) {
+    return;
+  }
+  const std::string &policy = portfolio.assign(rank);
+  masterLog << "MASTER->WORKER: SEARCH_MODE ID:"<<rank<<" "<<policy<<"\n";
+  MPI_Send(const_cast<char*>(policy.data()), policy.size(), MPI_CHAR, rank,
+      SEARCH_MODE, runComm);
+}
+
+//at a coverage plateau (--plateau-window) switch every busy worker to
+//another heuristic, --plateau-diversify times; returns true once the run
+//is to end
+bool checkCoveragePlateau(int num_cores, WorkerTracker &workers,
+    SearchPortfolio &portfolio, std::ofstream &masterLog) {
+  static const char *const fallback[] = {"DFS", "BFS", "RAND", "COVNEW"};
+  time_t now = time(NULL);
+  if(!coveragePlateau.isReached(now)) {
+    return false;
+  }
+  if(plateauRounds >= PlateauDiversify) {
+    masterLog << "MASTER: COVERAGE PLATEAU\n";
+    return true;
+  }
+  ++plateauRounds;
+  masterLog << "MASTER: COVERAGE PLATEAU ROUND:"<<plateauRounds<<"\n";
+  for(int x=FIRST_WORKER; x<num_cores; ++x) {
+    if(!workers.isBusy(x) || workers.isLost(x)) {
+      continue;
+    }
+    //without a portfolio the ranks spread over the plain heuristics
+    std::string policy = !portfolio.empty() ? portfolio.rotate(x) :
+        fallback[(x + plateauRounds) % 4];
+    masterLog << "MASTER->WORKER: SEARCH_MODE ID:"<<x<<" "<<policy<<"\n";
+    MPI_Send(const_cast<char*>(policy.data()), policy.size(), MPI_CHAR, x,
+        SEARCH_MODE, runComm);
+  }
+  coveragePlateau.reset(now);
+  return false;
+}
+
+std::string getNewSearch() {
+  if(!portfolioSearch.empty()) {
+    return portfolioSearch;
+  }
+  if(searchPolicy == "BFS") {
+    return "BFS";
+  } else if (searchPolicy == "DFS") {
+    return "DFS";
+  } else if (searchPolicy == "RAND") {
+    return "RAND";
+  } else if (searchPolicy == "COVNEW") {
+    return "COVNEW";
+  } else if (searchPolicy == "DIST") {
+    return "DIST";
+  } else {
+		return "DFS";
+	}
+}
+
+std::string getOffloadPolicy() {
+  if(offloadPolicy == "ADAPTIVE") {
+    return "ADAPTIVE";
+  } else {
+    return "DEFAULT";
+  }
+}
+
+int master(int argc, char **argv, char **envp) {
+
+  //setting up the workers, the solver ranks are not among them
+  int num_cores = getNumInterpreterRanks();
+	std::ofstream masterLog;
+	masterLog.open("log_master_"+OutputDir);
+	clusterStatsStart = util::getWallTime();
+	if(phase1Depth == 0) {
+		char buf[256];
+		time_t t[2];
 		t[0] = time(NULL);
 		strftime(buf, sizeof(buf), "Started: %Y-%m-%d %H:%M:%S\n", localtime(&t[0]));
     masterLog<<buf;
 		//used with 3 cores
 		char dummychar;
 		MPI_Status status3;
-		MPI_Status status4;
-		MPI_Send(&dummychar, 1, MPI_CHAR, 2, NORMAL_TASK, MPI_COMM_WORLD);
-		MPI_Recv(&dummychar, 1, MPI_CHAR, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status3);
+		MPI_Send(&dummychar, 1, MPI_CHAR, FIRST_WORKER, NORMAL_TASK, runComm);
+		if(!probeUntil(getDeadline(t[0]), status3)) {
+			masterLog << "MASTER_ELAPSED Timeout: \n";
+			//the job goes on with the other configurations of a campaign,
+			//so the worker has to stop
+			if(runComm != MPI_COMM_WORLD) {
+				shutdownWorkers(num_cores, masterLog, 0);
+			}
+		  masterLog.close();
+		  endRun();
+		}
+		MPI_Recv(&dummychar, 1, MPI_CHAR, status3.MPI_SOURCE, status3.MPI_TAG, runComm, &status3);
 		if(status3.MPI_TAG == FINISH) {
 			masterLog << "MASTER_ELAPSED Normal Mode \n";
+			logUniquePaths(masterLog);
+			logPrefixClaims(masterLog);
+			if(clusterStats.getNumReporting()) writeClusterStats();
 			if(FLUSH) masterLog.flush();
-			MPI_Send(&dummychar, 1, MPI_CHAR, 2, KILL, MPI_COMM_WORLD);
-			MPI_Recv(&dummychar, 1, MPI_CHAR, 2, KILL_COMP, MPI_COMM_WORLD, &status4);
-		  masterLog.close();
-		  MPI_Abort(MPI_COMM_WORLD, -1);
-		} else if(status3.MPI_TAG == TIMEOUT) {
-			masterLog << "MASTER_ELAPSED Timeout: \n";
+			MPI_Send(&dummychar, 1, MPI_CHAR, FIRST_WORKER, KILL, runComm);
+			recvKillComp(FIRST_WORKER);
+			//the other workers would wait for a task until the job ends,
+			//which a campaign does not do for them
+			if(runComm != MPI_COMM_WORLD) {
+				for(int x=FIRST_WORKER+1; x<num_cores; ++x) {
+					MPI_Send(&dummychar, 1, MPI_CHAR, x, KILL, runComm);
+					recvKillComp(x);
+				}
+			}
+			if(TraceEvents) writeTrace();
 		  masterLog.close();
-		  MPI_Abort(MPI_COMM_WORLD, -1);
+		  endRun();
 		} else if(status3.MPI_TAG == BUG_FOUND) {
 			masterLog << "WORKER->MASTER:  BUG FOUND:"<<status3.MPI_SOURCE<<"\n";
 			t[1] = time(NULL);
 			strcpy(buf, "Elapsed: ");
 			strcpy(format_tdiff(buf, t[1] - t[0]), "\n");
 			masterLog<<buf;
-			masterLog.close();
-			//MPI_Send(&dummychar, 1, MPI_CHAR, 2, KILL, MPI_COMM_WORLD);
-			//MPI_Recv(&dummychar, 1, MPI_CHAR, 2, KILL_COMP, MPI_COMM_WORLD, &status4);
-		  MPI_Abort(MPI_COMM_WORLD, -1);
+			shutdownWorkers(num_cores, masterLog, 0);
 		}
 
 	} else {	
 
-		std::string ErrorMsg;
-		Module *mainModule = 0;
-	#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
-		OwningPtr<MemoryBuffer> BufferPtr;
-		error_code ec=MemoryBuffer::getFileOrSTDIN(InputFile.c_str(), BufferPtr);
-		if (ec) {
-			klee_error("error loading program '%s': %s", InputFile.c_str(),
-								 ec.message().c_str());
-		} 
-
-		mainModule = getLazyBitcodeModule(BufferPtr.get(), getGlobalContext(), &ErrorMsg);
-
-		if (mainModule) {
-			if (mainModule->MaterializeAllPermanently(&ErrorMsg)) {
-				delete mainModule;
-				mainModule = 0;
-			} 
-		}   
-		if (!mainModule)
-			klee_error("error loading program '%s': %s", InputFile.c_str(),
-								 ErrorMsg.c_str());
-	#else
-		auto Buffer = MemoryBuffer::getFileOrSTDIN(InputFile.c_str());
-		if (!Buffer)
-			klee_error("error loading program '%s': %s", InputFile.c_str(),
-								 Buffer.getError().message().c_str());
-			
-		auto mainModuleOrError = getLazyBitcodeModule(Buffer->get(), getGlobalContext());
-
-		if (!mainModuleOrError) {
-			klee_error("error loading program '%s': %s", InputFile.c_str(),
-								 mainModuleOrError.getError().message().c_str());
-		} 
-		else {
-			// The module has taken ownership of the MemoryBuffer so release it
-			// from the std::unique_ptr
-			Buffer->release();
-		} 
-			
-		mainModule = *mainModuleOrError;
-		if (auto ec = mainModule->materializeAllPermanently()) {
-			klee_error("error loading program '%s': %s", InputFile.c_str(),
-								 ec.message().c_str());
-		} 
-	#endif
-	 
-		if (WithPOSIXRuntime || WithSymArgsRuntime) {
-			int r = initEnv(mainModule);
-			if (r != 0)
-				return r;
-		}
-
 		std::string LibraryDir = KleeHandler::getRunTimeLibraryPath(argv[0]);
 		Interpreter::ModuleOptions Opts(LibraryDir.c_str(), EntryPoint,
 																		/*Optimize=*/OptimizeModule,
 																		/*CheckDivZero=*/CheckDivZero,
 																		/*CheckOvershift=*/CheckOvershift);
-
-		switch (Libc) {
-		case NoLibc: /* silence compiler warning */
-			break;
-
-		case KleeLibc: {
-			// FIXME: Find a reasonable solution for this.
-			SmallString<128> Path(Opts.LibraryDir);
-	#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
-			llvm::sys::path::append(Path, "klee-libc.bc");
-	#else
-			llvm::sys::path::append(Path, "libklee-libc.bca");
-	#endif
-			mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
-			assert(mainModule && "unable to link with klee-libc");
-			break;
-		}
-
-		case UcLibc:
-			mainModule = linkWithUclibc(mainModule, LibraryDir);
-			break;
-		}
-
-		if (WithPOSIXRuntime) {
-			SmallString<128> Path(Opts.LibraryDir);
-			llvm::sys::path::append(Path, "libkleeRuntimePOSIX.bca");
-			klee_message("NOTE: Using model: %s", Path.c_str());
-			mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
-			assert(mainModule && "unable to link with simple model");
-		}
-
-		std::vector<std::string>::iterator libs_it;
-		std::vector<std::string>::iterator libs_ie;
-		for (libs_it = LinkLibraries.begin(), libs_ie = LinkLibraries.end();
-						libs_it != libs_ie; ++libs_it) {
-			const char * libFilename = libs_it->c_str();
-			klee_message("Linking in library: %s.\n", libFilename);
-			mainModule = klee::linkWithLibrary(mainModule, libFilename);
-		}
+		Module *mainModule = loadModule(Opts);
 		
 		// Get the desired main function.  klee_main initializes uClibc
 		// locale and other data and then calls main.
@@ -1613,7 +3016,7 @@ int master(int argc, char **argv, char **envp) {
 		}
 
 		std::vector<Interpreter::SkippedFunctionOption> skippingOptions;
-		parseSkippingParameter(mainModule, SkippedFunctions, skippingOptions);
+		parseSkippingParameter(mainModule, getSkippedFunctions(), skippingOptions);
 
 		std::vector<std::string> inlinedFunctions;
 		parseInlinedFunctions(mainModule, InlinedFunctions, inlinedFunctions);
@@ -1666,6 +3069,8 @@ int master(int argc, char **argv, char **envp) {
 		IOpts.inlinedFunctions = inlinedFunctions;
 		IOpts.errorLocations = errorLocationOptions;
 		IOpts.maxErrorCount = MaxErrorCount;
+	IOpts.offloadProgressThread = OffloadProgressThread;
+	IOpts.rankNodes = rankNodes;
 		KleeHandler *handler = new KleeHandler(pArgc, pArgv);
 		Interpreter *interpreter =
 			theInterpreter = Interpreter::create(IOpts, handler);
@@ -1678,6 +3083,7 @@ int master(int argc, char **argv, char **envp) {
 
 		const Module *finalModule =
 			interpreter->setModule(mainModule, Opts);
+		unlockModuleCache();
 		externalsAndGlobalsCheck(finalModule);
 
 		std::string output_dir_file;
@@ -1690,7 +3096,9 @@ int master(int argc, char **argv, char **envp) {
 		handler->getInfoStream() << buf;
 		handler->getInfoStream().flush();
 
-		interpreter->setExplorationDepth(phase1Depth);
+		int numWorkers = num_cores-FIRST_WORKER;
+		bool splitPhase1 = phase1Split && (numWorkers < phase1Depth);
+		interpreter->setExplorationDepth(splitPhase1 ? numWorkers : phase1Depth);
 
 		interpreter->setSearchMode("DFS");
 		pthfile = handler->getOutputDir()+"_pathFile_"+std::to_string(0);
@@ -1700,53 +3108,176 @@ int master(int argc, char **argv, char **envp) {
 		interpreter->setBrHistFile(output_dir_file+"_br_hist");
 		interpreter->setLogFile(output_dir_file+"_log_file");
 		int world_rank;
-		MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+		MPI_Comm_rank(runComm, &world_rank);
 		std::cout<<"DMap World Rank: "<<world_rank<<" File: " <<output_dir_file<<std::endl;
 		//std::cout.flush();
 		
-		char** workList;
-		std::vector<unsigned int> pathSizes;
+		time_t deadline = getDeadline(t[0]);
+		std::vector<std::string> prefixes;
+		std::vector<int> prefixTags;
+		if(ResumeCheckpoint != "") {
+			std::vector<TaskCheckpoint::Task> tasks;
+			std::string error;
+			if(!TaskCheckpoint::read(ResumeCheckpoint, tasks, error)) {
+				klee_error("cannot resume: %s", error.c_str());
+			}
+			if(tasks.empty()) {
+				klee_error("cannot resume: %s has no work left", ResumeCheckpoint.c_str());
+			}
+			for(unsigned i=0; i<tasks.size(); ++i) {
+				prefixes.push_back(tasks[i].data);
+				prefixTags.push_back(tasks[i].tag);
+			}
+			masterLog << "MASTER: RESUMED Tasks:"<<tasks.size()<<"\n";
+		} else if(PathIntervals) {
+			//the intervals need no replay to compute, there is no phase 1 here
+			std::vector<PathInterval> intervals;
+			PathInterval::split(PathIntervals, intervals);
+			for(unsigned i=0; i<intervals.size(); ++i) {
+				prefixes.push_back(intervals[i].encode());
+			}
+			prefixTags.assign(prefixes.size(), START_RANGE_TASK);
+			masterLog << "MASTER: PATH_INTERVALS "<<intervals.size()<<"\n";
+		} else if(!SeedOutFile.empty() || !SeedOutDir.empty()) {
+			//the workers explore from the root, there is no phase 1 here
+			seedFrontier(num_cores, deadline, masterLog, prefixes);
+			prefixTags.assign(prefixes.size(), START_PREFIX_TASK);
+		} else {
+			char** workList;
+			std::vector<unsigned int> pathSizes;
+
+			workList = interpreter->runFunctionAsMain2(mainFn, pArgc, pArgv, pEnvp, pathSizes);
 
-		workList = interpreter->runFunctionAsMain2(mainFn, pArgc, pArgv, pEnvp, pathSizes);
+			if(splitPhase1) {
+				splitFrontier(workList, pathSizes, num_cores, deadline, masterLog, prefixes);
+			} else {
+				//hand out the prefixes nearest to an --error-location target
+				//first, then the largest estimated subtrees, so that the small
+				//ones fill in at the end
+				std::vector<double> estimates;
+				interpreter->getWorkListEstimates(estimates);
+				std::vector<uint64_t> distances;
+				interpreter->getWorkListDistances(distances);
+				std::vector<std::pair<std::pair<uint64_t, double>, unsigned> > order;
+				for(unsigned i=0; i<pathSizes.size(); ++i) {
+					//0 is unreachable, the farthest
+					uint64_t distance = i < distances.size() && distances[i] ?
+					    distances[i] : ~(uint64_t) 0;
+					order.push_back(std::make_pair(std::make_pair(distance,
+					    i < estimates.size() ? -estimates[i] : 0.), i));
+				}
+				std::stable_sort(order.begin(), order.end());
+				for(unsigned i=0; i<order.size(); ++i) {
+					unsigned x = order[i].second;
+					prefixes.push_back(std::string(workList[x], pathSizes[x]));
+				}
+			}
+			for(unsigned i=0; i<pathSizes.size(); ++i) {
+				free(workList[i]);
+			}
+			free(workList);
+			prefixTags.assign(prefixes.size(), START_PREFIX_TASK);
+		}
+		std::vector<bool> dispatched(prefixes.size(), false);
+		TaskCheckpoint running(num_cores);
+		lastCheckpoint = time(NULL);
+		lastHeard.assign(num_cores, time(NULL));
+		leaving.assign(num_cores, false);
+		coveragePlateau = CoveragePlateau(PlateauWindow, PlateauMinCovered,
+		    time(NULL));
+		if(WorkerTimeout) {
+			//a dead worker must not take the master down with it
+			MPI_Comm_set_errhandler(runComm, MPI_ERRORS_RETURN);
+		}
+		WorkTree outstanding;
+		RNG workRNG;
+		if(GlobalRandomPath) {
+			for(unsigned i=0; i<prefixes.size(); ++i) {
+				outstanding.add(prefixes[i], i);
+			}
+		}
 	 
 		std::vector<unsigned char> dummyprefix;
 		std::deque<unsigned char> dummyWL;
-		std::deque<unsigned int> freeList;
-		std::deque<unsigned int> offloadActiveList;
-		std::deque<unsigned int> busyList;
-		std::deque<unsigned int> offloadReadyList;
-		MPI_Status status2;
+		WorkerTracker workers(FIRST_WORKER, num_cores);
+		for(int x=FIRST_WORKER; x<num_cores; ++x) {
+			workers.setNode(x, rankNodes[x]);
+		}
+		workers.setMinLocalWork(LocalDonorMinWork);
+		//the standby ranks wait in slave() until they join
+		if((int) StandbyWorkers >= numWorkers) {
+			klee_error("standby-workers option: needs at least one other worker");
+		}
+		int numActive = num_cores-StandbyWorkers;
+		for(int x=num_cores-1; x>=numActive; --x) {
+			workers.markLost(x);
+			standbyWorkers.push_back(x);
+		}
+		for(unsigned i=0; i<SearchPortfolioList.size(); ++i) {
+			if(!isSearchPolicy(SearchPortfolioList[i])) {
+				klee_error("search-portfolio option: invalid policy: %s",
+				    SearchPortfolioList[i].c_str());
+			}
+		}
+		SearchPortfolio portfolio(std::vector<std::string>(
+		    SearchPortfolioList.begin(), SearchPortfolioList.end()), num_cores);
+		std::vector<int> pendingTasks(num_cores, 0);
+		//the prefix each worker was handed early, -1 for none
+		std::vector<int> queuedTasks(num_cores, -1);
 		dummyWL.resize(phase1Depth);
 		//std::ofstream masterLog;
 		//masterLog.open("log_master_"+OutputDir);
 		masterLog << "MASTER_START \n";
 	 
 		//*************Seeding the slaves*************
-		int currRank = 2;
+		int currRank = FIRST_WORKER;
 		//auto wListIt = workList.begin();
-		int whileCnt = (num_cores-2)<pathSizes.size()?num_cores-2:pathSizes.size();
+		int whileCnt = numActive-FIRST_WORKER;
+		whileCnt = whileCnt<prefixes.size()?whileCnt:prefixes.size();
 
 		int cnt=0;
 		while(cnt<whileCnt) {
 			std::cout << "Starting worker: "<<currRank<<"\n";
 			masterLog << "MASTER->WORKER: START_WORK ID:"<<currRank<<"\n";
 			if(FLUSH) masterLog.flush();
-			MPI_Send(&(workList[cnt][0]), pathSizes[cnt], MPI_CHAR, currRank, START_PREFIX_TASK, 
-					MPI_COMM_WORLD);
-			busyList.push_back(currRank);
+			sendSearchMode(portfolio, currRank, masterLog);
+			unsigned next = takeNextTask(cnt, outstanding, workRNG, prefixes, prefixTags,
+			    dispatched);
+			MPI_Send(&(prefixes[next][0]), prefixes[next].size(), MPI_CHAR, currRank, prefixTags[next],
+					runComm);
+			dispatched[next] = true;
+			running.start(currRank, prefixTags[next], prefixes[next]);
+			startTaskTimer(currRank, prefixTags[next], prefixes[next]);
+			lastHeard[currRank] = time(NULL);
+			workers.markBusy(currRank);
+			if(LocalityAssignment && prefixTags[next] == START_PREFIX_TASK) {
+				workers.addPrefix(currRank, prefixes[next].data(), prefixes[next].size());
+			}
+			pendingTasks[currRank]++;
 			++currRank;
 			++cnt;
 		}
 	 
 		//If worklist size is smaller than cores, kill the rest of the processes
-		while(currRank < num_cores) {
+		while(currRank < numActive) {
+			if(workStealing) {
+				//starts without work and steals from the seeded workers
+				char dummy2;
+				sendSearchMode(portfolio, currRank, masterLog);
+				MPI_Send(&dummy2, 1, MPI_CHAR, currRank, START_STEAL_TASK, runComm);
+				masterLog << "MASTER->WORKER: START_STEAL ID:"<<currRank<<"\n";
+				workers.markBusy(currRank);
+				pendingTasks[currRank]++;
+				++currRank;
+				continue;
+			}
 			if(!lb) {
 				char dummy2;
-				MPI_Send(&dummy2, 1, MPI_CHAR, currRank, KILL, MPI_COMM_WORLD);
+				MPI_Send(&dummy2, 1, MPI_CHAR, currRank, KILL, runComm);
 				std::cout << "Killing(not required) worker: "<<currRank<<"\n";
 				masterLog << "MASTER->WORKER: KILL ID:"<<currRank<<"\n";
+				workers.markLost(currRank);
 			}
-			freeList.push_back(currRank);
 			++currRank;
 		}
 
@@ -1754,65 +3285,135 @@ int master(int argc, char **argv, char **envp) {
 		//from workers and offload further work
 		char dummyRecv;
 		MPI_Status status;
-		while(cnt < pathSizes.size()) {
-			MPI_Recv(&dummyRecv, 1, MPI_CHAR, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
-			if(status.MPI_TAG == FINISH) {
-				for(auto it = busyList.begin(); it != busyList.end(); ++it) {
-					if (*it == status.MPI_SOURCE) {
-						busyList.erase(it);
-						break;
-					 }
+		while(cnt < prefixes.size()) {
+			checkpointIfDue(running, prefixes, prefixTags, dispatched, masterLog);
+			pollElasticControl(workers, masterLog);
+			//a worker which joined does not wait for a FINISH
+			unsigned joined;
+			if(workers.getNumIdle() > 0) {
+				unsigned next = takeNextTask(cnt, outstanding, workRNG, prefixes, prefixTags,
+				    dispatched);
+				popIdleFor(workers, prefixTags[next], prefixes[next], joined);
+				sendSearchMode(portfolio, joined, masterLog);
+				MPI_Send(&(prefixes[next][0]), prefixes[next].size(), MPI_CHAR, joined,
+					prefixTags[next], runComm);
+				dispatched[next] = true;
+				running.start(joined, prefixTags[next], prefixes[next]);
+				startTaskTimer(joined, prefixTags[next], prefixes[next]);
+				lastHeard[joined] = time(NULL);
+				masterLog << "MASTER->WORKER: START_WORK ID:"<<joined<<"\n";
+				if(FLUSH) masterLog.flush();
+				pendingTasks[joined]++;
+				cnt++;
+				continue;
+			}
+			if(WorkerTimeout) {
+				reclaimLostWorkers(workers, portfolio, running, pendingTasks, prefixes,
+				    prefixTags, dispatched, queuedTasks, outstanding, masterLog);
+			}
+			if(!probeUntil(deadline, status)) {
+				if(CheckpointInterval) {
+					writeCheckpoint(running, prefixes, prefixTags, dispatched, masterLog);
 				}
-				//also remove from offloadReadyList if it exists
-				for(auto it = offloadActiveList.begin(); it != offloadActiveList.end(); ++it) {
-					if (*it == status.MPI_SOURCE) {
-						offloadActiveList.erase(it);
-						break;
+				timeOutWorkers(num_cores, masterLog, &workers);
+			}
+			if(status.MPI_TAG == STEAL_GIVEN) {
+				int thief;
+				MPI_Recv(&thief, 1, MPI_INT, status.MPI_SOURCE, STEAL_GIVEN, runComm, &status);
+				masterLog << "WORKER->WORKER: STOLEN ID:"<<status.MPI_SOURCE<<" BY:"<<thief<<"\n";
+				if(!workers.isLost(thief)) {
+					pendingTasks[thief]++;
+					running.steal(thief, status.MPI_SOURCE);
+				}
+				continue;
+			}
+			if(status.MPI_TAG == HEARTBEAT) {
+				recvHeartbeat(status.MPI_SOURCE, workers, portfolio);
+				if(checkCoveragePlateau(num_cores, workers, portfolio, masterLog)) {
+					if(CheckpointInterval) {
+						writeCheckpoint(running, prefixes, prefixTags, dispatched, masterLog);
 					}
+					shutdownWorkers(num_cores, masterLog, &workers);
 				}
-
-        /*for(auto it=offloadReadyList.begin(); it!=offloadReadyList.end(); ++it) {
-          if(*it==status.MPI_SOURCE) {
-            offloadReadyList.erase(it);
-            break;
-          }
-        }*/
-
-
+				continue;
+			}
+			if(status.MPI_TAG == LEAVE_RESP) {
+				int count;
+				MPI_Get_count(&status, MPI_CHAR, &count);
+				std::vector<char> packet(count);
+				MPI_Recv(&packet[0], count, MPI_CHAR, status.MPI_SOURCE, LEAVE_RESP,
+				    runComm, &status);
+				if(!workers.isLost(status.MPI_SOURCE)) {
+					retireWorker(status.MPI_SOURCE, packet, workers, portfolio, running,
+					    pendingTasks, prefixes, prefixTags, dispatched, queuedTasks,
+					    outstanding, masterLog);
+				}
+				continue;
+			}
+			MPI_Recv(&dummyRecv, 1, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG, runComm, &status);
+			if(workers.isLost(status.MPI_SOURCE)) {
+				//its task was handed out again
+				continue;
+			}
+			if(status.MPI_TAG == WORK_REQUEST) {
+				if(cnt < prefixes.size() && queuedTasks[status.MPI_SOURCE] == -1 &&
+				   !leaving[status.MPI_SOURCE]) {
+					unsigned next = takeNextTask(cnt, outstanding, workRNG, prefixes, prefixTags,
+					    dispatched);
+					sendQueuedTask(status.MPI_SOURCE, next, queuedTasks, prefixes, prefixTags,
+					    masterLog);
+					pendingTasks[status.MPI_SOURCE]++;
+					cnt++;
+				}
+			} else if(status.MPI_TAG == FINISH) {
+				pendingTasks[status.MPI_SOURCE]--;
 				masterLog << "WORKER->MASTER: FINISH ID:"<<status.MPI_SOURCE<<"\n";
+				stopTaskTimer(status.MPI_SOURCE);
+				if(startQueuedTask(status.MPI_SOURCE, queuedTasks, running, prefixes,
+				    prefixTags, dispatched, masterLog)) {
+					workers.markNotReady(status.MPI_SOURCE);
+					continue;
+				}
+				portfolio.release(status.MPI_SOURCE);
+				running.finish(status.MPI_SOURCE);
+				if(leaving[status.MPI_SOURCE]) {
+					//it gets no more work, its LEAVE_RESP follows
+					continue;
+				}
+				workers.markIdle(status.MPI_SOURCE);
+
 				if(FLUSH) masterLog.flush();
-				MPI_Send(&(workList[cnt][0]), pathSizes[cnt], MPI_CHAR, status.MPI_SOURCE,
-					START_PREFIX_TASK, MPI_COMM_WORLD);
-				masterLog << "MASTER->WORKER: START_WORK ID:"<<status.MPI_SOURCE<<"\n";
+				unsigned next = takeNextTask(cnt, outstanding, workRNG, prefixes, prefixTags,
+				    dispatched);
+				//usually the worker which just finished, unless others are idle
+				unsigned worker;
+				popIdleFor(workers, prefixTags[next], prefixes[next], worker);
+				sendSearchMode(portfolio, worker, masterLog);
+				MPI_Send(&(prefixes[next][0]), prefixes[next].size(), MPI_CHAR, worker,
+					prefixTags[next], runComm);
+				dispatched[next] = true;
+				running.start(worker, prefixTags[next], prefixes[next]);
+				startTaskTimer(worker, prefixTags[next], prefixes[next]);
+				lastHeard[worker] = time(NULL);
+				masterLog << "MASTER->WORKER: START_WORK ID:"<<worker<<"\n";
 				if(FLUSH) masterLog.flush();
 
-				busyList.push_back(status.MPI_SOURCE);
+				pendingTasks[worker]++;
 				cnt++;
 			} else if(status.MPI_TAG == BUG_FOUND) {
+				masterLog << "WORKER->MASTER:  BUG FOUND:"<<status.MPI_SOURCE<<"\n";
 				t[1] = time(NULL);
 				strcpy(buf, "Elapsed: ");
 				strcpy(format_tdiff(buf, t[1] - t[0]), "\n");
 				masterLog<<buf;
-				masterLog.close();
-
-				char dummy;
-				for(int x=2; x<num_cores; ++x) {
-					MPI_Send(&dummy, 1, MPI_CHAR, x, KILL, MPI_COMM_WORLD);
-				}
+				shutdownWorkers(num_cores, masterLog, &workers);
 			} else if(status.MPI_TAG == READY_TO_OFFLOAD) {
 				//masterLog << "WORKER->MASTER: READY TO OFFLOAD:"<<status.MPI_SOURCE<<"\n";
-				offloadReadyList.push_back(status.MPI_SOURCE);
+				workers.markReady(status.MPI_SOURCE);
 			} else if(status.MPI_TAG == NOT_READY_TO_OFFLOAD) {
-				bool found2Erase=false;
 				//masterLog << "WORKER->MASTER: NOT READY TO OFFLOAD:"<<status.MPI_SOURCE<<"\n";
-				for(auto it=offloadReadyList.begin(); it!=offloadReadyList.end(); ++it) {
-					if(*it==status.MPI_SOURCE) {
-						offloadReadyList.erase(it);
-						found2Erase=true;
-						break;
-					}
-				}
-				assert(found2Erase);
+				assert(workers.isReady(status.MPI_SOURCE));
+				workers.markNotReady(status.MPI_SOURCE);
 			} else {
 				//should not see any tags here
 				bool ok = false;
@@ -1825,7 +3426,6 @@ int master(int argc, char **argv, char **envp) {
 
 		std::cout << "Done with all prefixes\n";
 		masterLog << "MASTER: DONE_WITH_ALL_PREFIXES\n";
-		delete workList;
 		if(FLUSH) masterLog.flush();
 		bool offloadActive = false;
 		//masterLog.flush();
@@ -1834,137 +3434,152 @@ int master(int argc, char **argv, char **envp) {
 			int flag=false, count;
 			//char *buffer;
 			//see what the workers are saying
-			MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+			checkpointIfDue(running, prefixes, prefixTags, dispatched, masterLog);
+			pollElasticControl(workers, masterLog);
+			if(WorkerTimeout && reclaimLostWorkers(workers, portfolio, running,
+			    pendingTasks, prefixes, prefixTags, dispatched, queuedTasks, outstanding,
+			    masterLog)) {
+				offloadActive = false;
+			}
+			MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, runComm, &flag, &status);
+			if(flag) {
+				lastHeard[status.MPI_SOURCE] = time(NULL);
+			}
+
+			if(!flag && (time(NULL) >= deadline)) {
+				if(CheckpointInterval) {
+					writeCheckpoint(running, prefixes, prefixTags, dispatched, masterLog);
+				}
+				timeOutWorkers(num_cores, masterLog, &workers);
+			}
+
+			if(flag && (status.MPI_TAG == STEAL_GIVEN)) {
+				int thief;
+				MPI_Recv(&thief, 1, MPI_INT, status.MPI_SOURCE, STEAL_GIVEN, runComm, &status);
+				masterLog << "WORKER->WORKER: STOLEN ID:"<<status.MPI_SOURCE<<" BY:"<<thief<<"\n";
+				if(!workers.isLost(thief)) {
+					pendingTasks[thief]++;
+					running.steal(thief, status.MPI_SOURCE);
+				}
+				continue;
+			}
+
+			if(flag && (status.MPI_TAG == HEARTBEAT)) {
+				recvHeartbeat(status.MPI_SOURCE, workers, portfolio);
+				if(checkCoveragePlateau(num_cores, workers, portfolio, masterLog)) {
+					if(CheckpointInterval) {
+						writeCheckpoint(running, prefixes, prefixTags, dispatched, masterLog);
+					}
+					shutdownWorkers(num_cores, masterLog, &workers);
+				}
+				continue;
+			}
+
+			if(flag && (status.MPI_TAG == TEST_HASH)) {
+				answerTestHash(status.MPI_SOURCE);
+				continue;
+			}
+
+			if(flag && (status.MPI_TAG == PREFIX_CLAIM)) {
+				answerPrefixClaim(status.MPI_SOURCE);
+				continue;
+			}
+
+			if(flag && (status.MPI_TAG == CLUSTER_STATS)) {
+				recvClusterStats(status.MPI_SOURCE);
+				continue;
+			}
 
 			if(flag) {
 				MPI_Get_count(&status, MPI_CHAR, &count);
-				char buffer[count];
-				MPI_Recv(buffer, count, MPI_CHAR, status.MPI_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+				//shipped states can be large, keep them off the stack
+				std::vector<char> buffer(count);
+				MPI_Recv(&buffer[0], count, MPI_CHAR, status.MPI_SOURCE, MPI_ANY_TAG, runComm, &status);
 				//masterLog << "RECVD something: "<<status.MPI_SOURCE<<" "<<count <<"\n";
 				//masterLog.flush();
+				if(workers.isLost(status.MPI_SOURCE)) {
+					//its task was handed out again
+					continue;
+				}
 				if(status.MPI_TAG == BUG_FOUND) {
 					masterLog << "WORKER->MASTER:  BUG FOUND:"<<status.MPI_SOURCE<<"\n";
 					t[1] = time(NULL);
 					strcpy(buf, "Elapsed: ");
 					strcpy(format_tdiff(buf, t[1] - t[0]), "\n");
 					masterLog<<buf;
-					masterLog.close();
-					char dummy;
-					/*for(int x=2; x<num_cores; ++x) {
-						MPI_Send(&dummy, 1, MPI_CHAR, x, KILL, MPI_COMM_WORLD);
+					shutdownWorkers(num_cores, masterLog, &workers);
+				} else if(status.MPI_TAG == WORK_REQUEST) {
+					//only the tasks of lost workers can be left by now
+					if(cnt < prefixes.size() && queuedTasks[status.MPI_SOURCE] == -1 &&
+					   !leaving[status.MPI_SOURCE]) {
+						unsigned next = takeNextTask(cnt, outstanding, workRNG, prefixes, prefixTags,
+						    dispatched);
+						sendQueuedTask(status.MPI_SOURCE, next, queuedTasks, prefixes, prefixTags,
+						    masterLog);
+						pendingTasks[status.MPI_SOURCE]++;
+						cnt++;
 					}
-					for(int x=2; x<num_cores; ++x) {
-						MPI_Recv(&dummy, 1, MPI_CHAR, x, KILL_COMP, MPI_COMM_WORLD, &status2);
-					}*/
-					MPI_Abort(MPI_COMM_WORLD, -1);
 				} else if(status.MPI_TAG == FINISH) {
-					bool ffound=0;
-					for(auto it=freeList.begin(); it!=freeList.end(); ++it) {
-						if(*it == status.MPI_SOURCE) {
-							ffound=1;
-							break;
-						}
-					}
-					if(!ffound) freeList.push_back(status.MPI_SOURCE);
-
-					for(auto it = busyList.begin(); it != busyList.end(); ++it) {
-						if (*it == status.MPI_SOURCE) {
-							busyList.erase(it);
-							break;
-						 }
-					}
-
-					//also remove from offloadReadyList if it exists
-					for(auto it = offloadActiveList.begin(); it != offloadActiveList.end(); ++it) {
-						if (*it == status.MPI_SOURCE) {
-							offloadActiveList.erase(it);
-              offloadActive = false;
-							break;
-						}
-					}
-					
-          for(auto it=offloadReadyList.begin(); it!=offloadReadyList.end(); ++it) {
-						if(*it==status.MPI_SOURCE) {
-							offloadReadyList.erase(it);
-              break;
-						}
+					pendingTasks[status.MPI_SOURCE]--;
+					stopTaskTimer(status.MPI_SOURCE);
+					if(startQueuedTask(status.MPI_SOURCE, queuedTasks, running, prefixes,
+					    prefixTags, dispatched, masterLog)) {
+						workers.markNotReady(status.MPI_SOURCE);
+						masterLog << "WORKER->MASTER: FINISH ID:"<<status.MPI_SOURCE<<"\n";
+						continue;
 					}
-
+					portfolio.release(status.MPI_SOURCE);
+					running.finish(status.MPI_SOURCE);
 					masterLog << "WORKER->MASTER: FINISH ID:"<<status.MPI_SOURCE<<"\n";
-					masterLog << "WORKER->MASTER: FREELIST SIZE:"<<freeList.size()<<"\n";
-					if(FLUSH) masterLog.flush();
-					//if all workers finish then shut down the system
-					if(freeList.size() == (num_cores-2)) {
-						masterLog << "MASTER: ALL WORKERS FINISHED \n";
-						if(FLUSH) masterLog.flush();
-						//Kill all the workers
-						char dummy;
-						for(int x=2; x<num_cores; ++x) {
-							MPI_Send(&dummy, 1, MPI_CHAR, x, KILL, MPI_COMM_WORLD);
-						}
-
-						masterLog << "MASTER_ELAPSED: \n";
-						t[1] = time(NULL);
-						strcpy(buf, "Elapsed: ");
-						strcpy(format_tdiff(buf, t[1] - t[0]), "\n");
-						masterLog<<buf;
-						masterLog.close();
-
-						for(int x=2; x<num_cores; ++x) {
-							MPI_Recv(&dummy, 1, MPI_CHAR, x, KILL_COMP, MPI_COMM_WORLD, &status2);
-						}
-						MPI_Abort(MPI_COMM_WORLD, -1);
+					if(leaving[status.MPI_SOURCE]) {
+						//it gets no more work, its LEAVE_RESP follows
+						continue;
 					}
-				} else if(status.MPI_TAG == TIMEOUT) {
-					char dummy;
-					for(int x=2; x<num_cores; ++x) {
-						MPI_Send(&dummy, 1, MPI_CHAR, x, KILL, MPI_COMM_WORLD);
+					if(workers.markIdle(status.MPI_SOURCE)) {
+						//the request to it dies with its work
+						offloadActive = false;
 					}
-            
-          for(int x=2; x<num_cores; ++x) {
-              MPI_Recv(&dummy, 1, MPI_CHAR, x, KILL_COMP, MPI_COMM_WORLD, &status2);
-          } 
-          MPI_Abort(MPI_COMM_WORLD, -1);
 
+					masterLog << "WORKER->MASTER: FREELIST SIZE:"<<workers.getNumIdle()<<"\n";
+					if(FLUSH) masterLog.flush();
 				} else if(status.MPI_TAG == READY_TO_OFFLOAD) {
 					//masterLog << "WORKER->MASTER: READY TO OFFLOAD:"<<status.MPI_SOURCE<<"\n";
-					offloadReadyList.push_back(status.MPI_SOURCE);
+					workers.markReady(status.MPI_SOURCE);
 				} else if(status.MPI_TAG == NOT_READY_TO_OFFLOAD) {
-					bool found2Erase=false;
 					//masterLog << "WORKER->MASTER: NOT READY TO OFFLOAD:"<<status.MPI_SOURCE<<"\n";
-					for(auto it=offloadReadyList.begin(); it!=offloadReadyList.end(); ++it) {
-						if(*it==status.MPI_SOURCE) {
-							offloadReadyList.erase(it);
-							found2Erase=true;
-							break;
-						}
-					}
-					//assert(found2Erase);
-				} else if(status.MPI_TAG == OFFLOAD_RESP) {
+					workers.markNotReady(status.MPI_SOURCE);
+				} else if((status.MPI_TAG == OFFLOAD_RESP) || (status.MPI_TAG == OFFLOAD_STATE_RESP)) {
+					//complete states are forwarded as they are, prefixes get replayed
+					int taskTag = (status.MPI_TAG == OFFLOAD_STATE_RESP) ? START_STATE_TASK : START_PREFIX_TASK;
 					masterLog << "WORKER->MASTER: OFFLOAD RCVD ID:"<<status.MPI_SOURCE<<" Length:"<<count<<"\n";
+					EventTrace::getProcessTrace().record(EventTrace::OffloadResponse,
+					    EventTrace::now(), 0, status.MPI_SOURCE);
 					if(FLUSH) masterLog.flush();
 
-					//Removing the offload active list worker 
-					for(auto it = offloadActiveList.begin(); it != offloadActiveList.end(); ++it) {
-						if (*it == status.MPI_SOURCE) {
-							offloadActiveList.erase(it);
-							break;
-						}
-					}
+					workers.offloadDone(status.MPI_SOURCE);
 
 					//Send the offloaded work to the free worker 
 					if(count>4) {
 						//something should exist in free list
-						assert(freeList.size() > 0);
-						unsigned int pickedWorker = freeList.front();
+						unsigned int pickedWorker;
+						//preferably on the node of the donor
+						bool foundIdle = workers.popIdleNear(status.MPI_SOURCE, pickedWorker);
+						assert(foundIdle);
+						(void) foundIdle;
 						masterLog << "MASTER->WORKER: PREFIX_TASK_SEND ID:"<<pickedWorker<<" Length:"<<count<<"\n";
-						MPI_Send(buffer, count, MPI_CHAR, pickedWorker, START_PREFIX_TASK, MPI_COMM_WORLD);
+						sendSearchMode(portfolio, pickedWorker, masterLog);
+						MPI_Send(&buffer[0], count, MPI_CHAR, pickedWorker, taskTag, runComm);
+						running.start(pickedWorker, taskTag, std::string(&buffer[0], count));
+						lastHeard[pickedWorker] = time(NULL);
 						masterLog << "MASTER->WORKER: START_WORK ID:"<<pickedWorker<<"\n";
-						//pushing the worker busy list
-						busyList.push_back(pickedWorker);
-						freeList.pop_front();
 					}
 					offloadActive = false;
+				} else if(status.MPI_TAG == LEAVE_RESP) {
+					if(retireWorker(status.MPI_SOURCE, buffer, workers, portfolio, running,
+					    pendingTasks, prefixes, prefixTags, dispatched, queuedTasks,
+					    outstanding, masterLog)) {
+						offloadActive = false;
+					}
 				} else {
 					//should not see any tags here
 					std::cout << "ILLEGAL TAG: "<<status.MPI_TAG<<" "<<status.MPI_SOURCE<<"\n";
@@ -1973,37 +3588,79 @@ int master(int argc, char **argv, char **envp) {
 					(void) ok;
 					assert(ok && "MASTER received an illegal tag");
 				}
+				//if all workers finish then shut down the system
+				if((status.MPI_TAG == FINISH || status.MPI_TAG == LEAVE_RESP) &&
+				   (workStealing ? allTasksDone(pendingTasks) : workers.allIdle())
+				   && cnt == prefixes.size()) {
+					masterLog << "MASTER: ALL WORKERS FINISHED \n";
+					logUniquePaths(masterLog);
+					logPrefixClaims(masterLog);
+					//nothing is left to resume
+					if(CheckpointInterval) {
+						remove(("checkpoint_"+OutputDir).c_str());
+					}
+					if(clusterStats.getNumReporting()) writeClusterStats();
+					if(FLUSH) masterLog.flush();
+					//Kill all the workers
+					char dummy;
+					for(int x=FIRST_WORKER; x<num_cores; ++x) {
+						if(!workers.isLost(x)) {
+							MPI_Send(&dummy, 1, MPI_CHAR, x, KILL, runComm);
+						}
+					}
+
+					masterLog << "MASTER_ELAPSED: \n";
+					t[1] = time(NULL);
+					strcpy(buf, "Elapsed: ");
+					strcpy(format_tdiff(buf, t[1] - t[0]), "\n");
+					masterLog<<buf;
+					masterLog.close();
+
+					for(int x=FIRST_WORKER; x<num_cores; ++x) {
+						if(!workers.isLost(x)) {
+							recvKillComp(x);
+						}
+					}
+					if(TraceEvents) writeTrace();
+					endRun();
+				}
+			}
+
+			//the tasks of lost workers go to idle ones before any offload
+			unsigned idleWorker;
+			if(cnt < prefixes.size() && workers.getNumIdle() > 0) {
+				unsigned next = takeNextTask(cnt, outstanding, workRNG, prefixes, prefixTags,
+				    dispatched);
+				popIdleFor(workers, prefixTags[next], prefixes[next], idleWorker);
+				sendSearchMode(portfolio, idleWorker, masterLog);
+				MPI_Send(&(prefixes[next][0]), prefixes[next].size(), MPI_CHAR, idleWorker,
+					prefixTags[next], runComm);
+				masterLog << "MASTER->WORKER: START_WORK ID:"<<idleWorker<<"\n";
+				if(FLUSH) masterLog.flush();
+				dispatched[next] = true;
+				running.start(idleWorker, prefixTags[next], prefixes[next]);
+				startTaskTimer(idleWorker, prefixTags[next], prefixes[next]);
+				lastHeard[idleWorker] = time(NULL);
+				pendingTasks[idleWorker]++;
+				cnt++;
 			}
 
 			//if some workers are ready to offload and freelist has some workers
 			//offload some stuff
-			if(lb && (freeList.size()>0) && (freeList.size()<(num_cores-2))
-				 && (offloadReadyList.size()>0) && !offloadActive) {
+			if(lb && !workStealing && (workers.getNumIdle()>0) && !workers.allIdle()
+				 && workers.hasDonor() && !offloadActive) {
 
 				//pick out the worker that has been busy the longest and to whom an
 				//offload request in not yet sent
-				bool foundWorker2Offload = false;
 				unsigned int worker2offload;
-				for(auto it = offloadReadyList.begin(); it != offloadReadyList.end(); ++it) {
-					bool offloadAlreadySent = false;
-					for(auto it2 = offloadActiveList.begin(); it2 < offloadActiveList.end(); ++it2) {
-						if(*it == *it2) {
-							offloadAlreadySent = true;
-							break;
-						}
-					}
-					if(!offloadAlreadySent) {
-						foundWorker2Offload = true;
-						worker2offload = *it;
-						offloadActiveList.push_back(worker2offload);
-						break;
-					}
-				}
 				//found a valid busy worker
-				if(foundWorker2Offload) {
+				if(workers.pickDonor(worker2offload)) {
 					MPI_Status offloadStatus;
-					char dummyBuff;
-					MPI_Send(&dummyBuff, 1, MPI_CHAR, worker2offload, OFFLOAD, MPI_COMM_WORLD);
+					//the donor sizes the offload by the number of idle workers
+					int idleWorkers = workers.getNumIdle();
+					MPI_Send(&idleWorkers, 1, MPI_INT, worker2offload, OFFLOAD, runComm);
+					EventTrace::getProcessTrace().record(EventTrace::OffloadRequest,
+					    EventTrace::now(), 0, worker2offload);
 					masterLog << "MASTER->WORKER: OFFLOAD_SENT ID:"<<worker2offload<<"\n";
 					if(FLUSH) masterLog.flush();
 					offloadActive = true;
@@ -2036,6 +3693,7 @@ int master(int argc, char **argv, char **envp) {
 		if(ENABLE_CLEANUP) {
 			std::string brhist = output_dir_file+"_br_hist";
 			const char * c = brhist.c_str();
+			std::string brhistgz = brhist+".gz";
 			std::string logfile = output_dir_file+"_log_file";
 			const char * d = logfile.c_str();
 			const char * e = output_dir_file.c_str();
@@ -2052,6 +3710,7 @@ int master(int argc, char **argv, char **envp) {
 			std::string z2 = output_dir_file+"/sa.log";
 			const char * z3 = z2.c_str();
 			remove(c);
+			remove(brhistgz.c_str());
 			remove(d);
 			remove(f);
 			remove(a);
@@ -2074,25 +3733,39 @@ void slave(int argc, char **argv, char **envp) {
   char** dummyworkList;
 
   while(true) {
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_rank(runComm, &world_rank);
     //trying to check the TAG of incoming message
     MPI_Status status;
-    MPI_Probe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+    MPI_Probe(0, MPI_ANY_TAG, runComm, &status);
     int count;
     MPI_Get_count(&status, MPI_CHAR, &count);
 
     if(status.MPI_TAG == KILL) {
       std::deque<unsigned char> recv_prefix;
       recv_prefix.resize(phase1Depth);
-      MPI_Recv(&recv_prefix[0], phase1Depth, MPI_CHAR, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+      MPI_Recv(&recv_prefix[0], phase1Depth, MPI_CHAR, 0, MPI_ANY_TAG, runComm, &status);
       std::cout << "Killing Process: "<<world_rank<<"\n";
+      sendKillComp();
+      return;
+
+    } else if(status.MPI_TAG == LEAVE) {
+      //nothing to hand back before the first task
+      char dummy;
+      MPI_Recv(&dummy, 1, MPI_CHAR, 0, LEAVE, runComm, &status);
+      char none = 'x';
+      MPI_Send(&none, 1, MPI_CHAR, 0, LEAVE_RESP, runComm);
+      std::cout << "Leaving Process: "<<world_rank<<"\n";
       return;
 
+    } else if(status.MPI_TAG == SEARCH_MODE) {
+      std::vector<char> policy(count+1);
+      MPI_Recv(&policy[0], count, MPI_CHAR, 0, SEARCH_MODE, runComm, &status);
+      portfolioSearch.assign(&policy[0], count);
     } else if(status.MPI_TAG == START_PREFIX_TASK) {
       //std::vector<unsigned char> recv_prefix;
       //recv_prefix.resize(count);
       char* recv_prefix = (char*)malloc((count)*sizeof(char)); 
-      MPI_Recv(recv_prefix, count, MPI_CHAR, 0, START_PREFIX_TASK, MPI_COMM_WORLD, &status);
+      MPI_Recv(recv_prefix, count, MPI_CHAR, 0, START_PREFIX_TASK, runComm, &status);
       std::cout << "Process: "<<world_rank<<" Prefix Task: Length:"<<count<<" ";
       //std::cout.flush();
       for(unsigned int x=count-10;x<count;x++) {
@@ -2104,23 +3777,68 @@ void slave(int argc, char **argv, char **envp) {
       std::cout << "Finish: " << world_rank << std::endl;
       delete recv_prefix;
       //MPI_Send(&result, 1, MPI_CHAR, 0, FINISH, MPI_COMM_WORLD);
-      MPI_Send(&result, 1, MPI_CHAR, 0, KILL_COMP, MPI_COMM_WORLD);
+      sendKillComp();
+      return;
+		} else if(status.MPI_TAG == START_STATE_TASK) {
+      std::vector<char> packet(count);
+      MPI_Recv(&packet[0], count, MPI_CHAR, 0, START_STATE_TASK, runComm, &status);
+      std::cout << "Process: "<<world_rank<<" State Task: Size:"<<count<<"\n";
+      executeWorker(argc, argv, envp, dummyworkList, &packet[0], count, phase2Depth,
+          STATE_MODE, getNewSearch());
+      std::cout << "Finish: " << world_rank << std::endl;
+      sendKillComp();
+      return;
+		} else if(status.MPI_TAG == START_RANGE_TASK) {
+      std::vector<char> packet(count);
+      MPI_Recv(&packet[0], count, MPI_CHAR, 0, START_RANGE_TASK, runComm, &status);
+      std::cout << "Process: "<<world_rank<<" Range Task: "<<std::string(packet.begin(), packet.end())<<"\n";
+      executeWorker(argc, argv, envp, dummyworkList, &packet[0], count, phase2Depth,
+          RANGE_MODE, getNewSearch());
+      std::cout << "Finish: " << world_rank << std::endl;
+      sendKillComp();
+      return;
+		} else if(status.MPI_TAG == START_STEAL_TASK) {
+      char dummy;
+      MPI_Recv(&dummy, 1, MPI_CHAR, 0, START_STEAL_TASK, runComm, &status);
+      std::cout << "Process: "<<world_rank<<" Steal Task\n";
+      executeWorker(argc, argv, envp, dummyworkList, &dummy, 0, phase2Depth,
+          STEAL_MODE, getNewSearch());
+      std::cout << "Finish: " << world_rank << std::endl;
+      sendKillComp();
       return;
+		} else if(status.MPI_TAG == START_SPLIT_TASK) {
+      std::vector<char> recv_prefix(count+1);
+      MPI_Recv(&recv_prefix[0], count, MPI_CHAR, 0, START_SPLIT_TASK, runComm, &status);
+      int num_cores = getNumInterpreterRanks();
+      int numWorkers = num_cores-FIRST_WORKER;
+      int share = (phase1Depth+numWorkers-1)/numWorkers;
+      std::cout << "Process: "<<world_rank<<" Split Task: Length:"<<count<<" Share:"<<share<<"\n";
+      executeWorker(argc, argv, envp, dummyworkList, &recv_prefix[0], count, share,
+          SPLIT_MODE, "DFS");
+		} else if(status.MPI_TAG == START_SEED_TASK) {
+      std::vector<char> recv_seeds(count+1);
+      MPI_Recv(&recv_seeds[0], count, MPI_CHAR, 0, START_SEED_TASK, runComm, &status);
+      int num_cores = getNumInterpreterRanks();
+      int numWorkers = num_cores-FIRST_WORKER;
+      int share = (phase1Depth+numWorkers-1)/numWorkers;
+      std::cout << "Process: "<<world_rank<<" Seed Task: Length:"<<count<<" Share:"<<share<<"\n";
+      executeWorker(argc, argv, envp, dummyworkList, &recv_seeds[0], count, share,
+          SEED_MODE, "DFS");
 		} else if(status.MPI_TAG == NORMAL_TASK) {
       std::cout << "Process: "<<world_rank<<" Normal Task "<<"Prefix Depth: "<<phase2Depth<<"\n";
       char* recv_prefix = (char*)malloc((count+1)*sizeof(char)); 
-      MPI_Recv(recv_prefix, count, MPI_CHAR, 0, NORMAL_TASK, MPI_COMM_WORLD, &status);
+      MPI_Recv(recv_prefix, count, MPI_CHAR, 0, NORMAL_TASK, runComm, &status);
       executeWorker(argc, argv, envp, dummyworkList, recv_prefix, count, phase2Depth, 
           NO_MODE, getNewSearch());
-      MPI_Send(&result, 1, MPI_CHAR, 0, FINISH, MPI_COMM_WORLD);
+      MPI_Send(&result, 1, MPI_CHAR, 0, FINISH, runComm);
 
     } else if(status.MPI_TAG == OFFLOAD) {
       int count, buffer;
       MPI_Get_count(&status, MPI_INT, &count);
-      MPI_Recv(&buffer, count, MPI_INT, MASTER_NODE, OFFLOAD, MPI_COMM_WORLD, &status);
+      MPI_Recv(&buffer, count, MPI_INT, MASTER_NODE, OFFLOAD, runComm, &status);
       std::vector<unsigned char> packet2send;
       packet2send.push_back('x');
-      MPI_Send(&packet2send[0], packet2send.size(), MPI_CHAR, 0, OFFLOAD_RESP, MPI_COMM_WORLD);
+      MPI_Send(&packet2send[0], packet2send.size(), MPI_CHAR, 0, OFFLOAD_RESP, runComm);
 
     } 
   }
@@ -2129,103 +3847,14 @@ void slave(int argc, char **argv, char **envp) {
 int executeWorker(int argc, char **argv, char **envp, 
     char** workList, char* prefix, unsigned int count, 
 		int explorationDepth, int mode, std::string searchMode) {
-
-  std::string ErrorMsg;
-  Module *mainModule = 0;
-#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
-  OwningPtr<MemoryBuffer> BufferPtr;
-  error_code ec=MemoryBuffer::getFileOrSTDIN(InputFile.c_str(), BufferPtr);
-  if (ec) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ec.message().c_str());
-  }
-
-  mainModule = getLazyBitcodeModule(BufferPtr.get(), getGlobalContext(), &ErrorMsg);
-
-  if (mainModule) {
-    if (mainModule->MaterializeAllPermanently(&ErrorMsg)) {
-      delete mainModule;
-      mainModule = 0;
-    }
-  }
-  if (!mainModule)
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ErrorMsg.c_str());
-#else
-  auto Buffer = MemoryBuffer::getFileOrSTDIN(InputFile.c_str());
-  if (!Buffer)
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               Buffer.getError().message().c_str());
-
-  auto mainModuleOrError = getLazyBitcodeModule(Buffer->get(), getGlobalContext());
-
-  if (!mainModuleOrError) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               mainModuleOrError.getError().message().c_str());
-  }
-  else {
-    // The module has taken ownership of the MemoryBuffer so release it
-    // from the std::unique_ptr
-    Buffer->release();
-  }
-
-  mainModule = *mainModuleOrError;
-  if (auto ec = mainModule->materializeAllPermanently()) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ec.message().c_str());
-  }
-#endif
-
-  if (WithPOSIXRuntime || WithSymArgsRuntime) {
-    int r = initEnv(mainModule);
-    if (r != 0)
-      return r;
-  }
+  uint64_t taskStart = EventTrace::now();
 
   std::string LibraryDir = KleeHandler::getRunTimeLibraryPath(argv[0]);
   Interpreter::ModuleOptions Opts(LibraryDir.c_str(), EntryPoint,
                                   /*Optimize=*/OptimizeModule,
                                   /*CheckDivZero=*/CheckDivZero,
                                   /*CheckOvershift=*/CheckOvershift);
-
-  switch (Libc) {
-  case NoLibc: /* silence compiler warning */
-    break;
-
-  case KleeLibc: {
-    // FIXME: Find a reasonable solution for this.
-    SmallString<128> Path(Opts.LibraryDir);
-#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
-    llvm::sys::path::append(Path, "klee-libc.bc");
-#else
-    llvm::sys::path::append(Path, "libklee-libc.bca");
-#endif
-    mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
-    assert(mainModule && "unable to link with klee-libc");
-    break;
-  }
-
-  case UcLibc:
-    mainModule = linkWithUclibc(mainModule, LibraryDir);
-    break;
-  }
-
-  if (WithPOSIXRuntime) {
-    SmallString<128> Path(Opts.LibraryDir);
-    llvm::sys::path::append(Path, "libkleeRuntimePOSIX.bca");
-    klee_message("NOTE: Using model: %s", Path.c_str());
-    mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
-    assert(mainModule && "unable to link with simple model");
-  }
-
-  std::vector<std::string>::iterator libs_it;
-  std::vector<std::string>::iterator libs_ie;
-  for (libs_it = LinkLibraries.begin(), libs_ie = LinkLibraries.end();
-          libs_it != libs_ie; ++libs_it) {
-    const char * libFilename = libs_it->c_str();
-    klee_message("Linking in library: %s.\n", libFilename);
-    mainModule = klee::linkWithLibrary(mainModule, libFilename);
-  }
+  Module *mainModule = loadModule(Opts);
 
   // Get the desired main function.  klee_main initializes uClibc
   // locale and other data and then calls main.
@@ -2235,7 +3864,7 @@ int executeWorker(int argc, char **argv, char **envp,
   }
 
   std::vector<Interpreter::SkippedFunctionOption> skippingOptions;
-  parseSkippingParameter(mainModule, SkippedFunctions, skippingOptions);
+  parseSkippingParameter(mainModule, getSkippedFunctions(), skippingOptions);
 
   std::vector<std::string> inlinedFunctions;
   parseInlinedFunctions(mainModule, InlinedFunctions, inlinedFunctions);
@@ -2300,6 +3929,7 @@ int executeWorker(int argc, char **argv, char **envp,
 
 	const Module *finalModule =
 	  interpreter->setModule(mainModule, Opts);
+	unlockModuleCache();
 	externalsAndGlobalsCheck(finalModule);
 
 	std::string output_dir_file;
@@ -2314,7 +3944,7 @@ int executeWorker(int argc, char **argv, char **envp,
 
 	interpreter->setExplorationDepth(explorationDepth);
 
-	if(mode == PREFIX_MODE) {
+	if(mode == PREFIX_MODE || mode == SPLIT_MODE) {
 	  interpreter->setUpperBound(prefix);
 	  interpreter->setLowerBound(prefix);
 	  interpreter->enablePrefixChecking();
@@ -2324,11 +3954,63 @@ int executeWorker(int argc, char **argv, char **envp,
   if(mode == NO_MODE) {
     interpreter->setTestPrefixDepth(0);
   }
+
+  std::vector<bool> replayPath;
+  if(mode == NO_MODE && ReplayPathFile != "") {
+    KleeHandler::loadPathFile(ReplayPathFile, replayPath);
+    interpreter->setReplayPath(&replayPath);
+  }
+
+  if(mode == STATE_MODE) {
+    interpreter->setStartStates(prefix, count);
+  }
+
+  if(mode == SPLIT_MODE || mode == SEED_MODE) {
+    interpreter->enableSplitting();
+  }
+
+  //the prefix holds this worker's share of the seed files, one per line;
+  //they are mapped, their bytes are only read when a seed reaches them
+  std::vector<KTest *> seeds;
+  if(mode == SEED_MODE) {
+    std::string file;
+    for(unsigned i=0; i<count; ++i) {
+      if(prefix[i] != '\n') {
+        file.push_back(prefix[i]);
+        continue;
+      }
+      KTest *out = kTest_mapFile(file.c_str());
+      if(!out) {
+        klee_error("unable to open seed file: %s", file.c_str());
+      }
+      seeds.push_back(out);
+      file.clear();
+    }
+    klee_message("seeding with %u tests", (unsigned) seeds.size());
+    interpreter->useSeeds(&seeds);
+    interpreter->setTestPrefixDepth(0);
+    if(GenerationalSeeds) {
+      interpreter->enableGenerations();
+    }
+  }
+
+  if(mode == STEAL_MODE) {
+    interpreter->setStartIdle();
+    interpreter->setTestPrefixDepth(0);
+  }
+
+  if(mode == RANGE_MODE) {
+    interpreter->setPathRange(prefix, count);
+    interpreter->setTestPrefixDepth(0);
+  }
 	
 	int world_rank;
-	MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+	MPI_Comm_rank(runComm, &world_rank);
 
-	interpreter->enableLoadBalancing(lb);
+	bool splitting = mode == SPLIT_MODE || mode == SEED_MODE;
+	interpreter->enableLoadBalancing(lb && !workStealing && !splitting);
+	interpreter->enableWorkStealing(workStealing && !splitting);
+	interpreter->setOffloadPolicy(getOffloadPolicy());
 	interpreter->setSearchMode(searchMode);
 	pthfile = handler->getOutputDir()+"_pathFile_"+std::to_string(world_rank);
 	interpreter->setPathFile(pthfile);
@@ -2338,7 +4020,27 @@ int executeWorker(int argc, char **argv, char **envp,
 	interpreter->setLogFile(output_dir_file+"_log_file");
 	std::cout<<"DMap World Rank: "<<world_rank<<" File: " <<output_dir_file<<std::endl;
   std::vector<unsigned int> pathSizes;
-	interpreter->runFunctionAsMain2(mainFn, pArgc, pArgv, pEnvp, pathSizes);
+	char** splitList = interpreter->runFunctionAsMain2(mainFn, pArgc, pArgv, pEnvp, pathSizes);
+
+  //send the expanded frontier back, every prefix terminated by a dash
+  if(splitting) {
+    std::vector<char> packet;
+    for(unsigned i=0; i<pathSizes.size(); ++i) {
+      packet.insert(packet.end(), splitList[i], splitList[i]+pathSizes[i]);
+      packet.push_back('-');
+      free(splitList[i]);
+    }
+    free(splitList);
+    std::vector<std::string> finished;
+    interpreter->getSeedPaths(finished);
+    for(unsigned i=0; i<finished.size(); ++i) {
+      packet.insert(packet.end(), finished[i].begin(), finished[i].end());
+      packet.push_back('+');
+    }
+    char dummy;
+    MPI_Send(packet.empty() ? &dummy : &packet[0], packet.size(), MPI_CHAR,
+        MASTER_NODE, SPLIT_RESP, runComm);
+  }
 
   //time_t t;
   t[1] = time(NULL);
@@ -2357,6 +4059,9 @@ int executeWorker(int argc, char **argv, char **envp,
 
   delete interpreter;
 
+  for (unsigned i=0; i<seeds.size(); i++)
+    kTest_free(seeds[i]);
+
   uint64_t queries =
     *theStatisticManager->getStatisticByName("Queries");
   uint64_t queriesValid =
@@ -2395,6 +4100,17 @@ int executeWorker(int argc, char **argv, char **envp,
         << handler->getNumPathsExplored() << "\n";
   stats << "KLEE: done: generated tests = "
         << handler->getNumTestCases() << "\n";
+  if (DedupTests)
+    stats << "KLEE: done: duplicate tests = "
+          << handler->getNumDuplicateTests() << "\n";
+
+  //where the time of this worker went, in seconds
+  const char *phases[] = { "ReplayTime", "ExplorationTime", "RecoveryTime",
+                           "IdleTime", "SolverTime" };
+  for (unsigned i = 0; i < sizeof(phases) / sizeof(phases[0]); i++)
+    stats << "KLEE: done: " << phases[i] << " = "
+          << *theStatisticManager->getStatisticByName(phases[i]) / 1000000.
+          << "\n";
 
   /* these are relevant only when we have a slicing option */
   //TODO get IOptd
@@ -2428,6 +4144,8 @@ int executeWorker(int argc, char **argv, char **envp,
   BufferPtr.take();
 #endif
 
+  EventTrace::getProcessTrace().record(EventTrace::Task, taskStart,
+                                       EventTrace::now() - taskStart, mode);
   return 0;
 
 }
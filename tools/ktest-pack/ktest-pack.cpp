@@ -0,0 +1,144 @@
+//===-- ktest-pack.cpp ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <string>
+#include <unordered_set>
+
+#include "klee/Internal/ADT/KTest.h"
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s list <pack>\n"
+          "       %s extract <pack> <dir>\n"
+          "       %s merge <output pack> <pack>...\n"
+          "\n"
+          "extract writes the test cases of <pack> to <dir> as testNNNNNN.ktest\n"
+          "files for klee-replay and ktest-tool; merge appends the test cases\n"
+          "of every <pack> which are not in <output pack> yet to it, numbered\n"
+          "after the ones it has\n",
+          name, name, name);
+}
+
+static KTestPack *openPack(const char *path) {
+  KTestPack *pack = kTestPack_open(path);
+  if (!pack)
+    fprintf(stderr, "ERROR: unable to open test case container: %s\n", path);
+  return pack;
+}
+
+static int list(const char *path) {
+  KTestPack *pack = openPack(path);
+  if (!pack)
+    return 1;
+  for (unsigned i = 0; i < kTestPack_numTests(pack); i++) {
+    unsigned size;
+    kTestPack_getImage(pack, i, &size);
+    printf("test%06d.ktest\t%u bytes\n", kTestPack_getId(pack, i), size);
+  }
+  kTestPack_close(pack);
+  return 0;
+}
+
+static int extract(const char *path, const char *dir) {
+  KTestPack *pack = openPack(path);
+  if (!pack)
+    return 1;
+  mkdir(dir, 0775);
+
+  int res = 0;
+  for (unsigned i = 0; i < kTestPack_numTests(pack) && !res; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "/test%06d.ktest", kTestPack_getId(pack, i));
+    std::string file = std::string(dir) + name;
+
+    /* the image is the .ktest file as klee would have written it */
+    unsigned size;
+    const unsigned char *image = kTestPack_getImage(pack, i, &size);
+    FILE *f = fopen(file.c_str(), "wb");
+    if (!f || fwrite(image, 1, size, f) != size) {
+      fprintf(stderr, "ERROR: unable to write: %s\n", file.c_str());
+      res = 1;
+    }
+    if (f && fclose(f)) {
+      fprintf(stderr, "ERROR: unable to write: %s\n", file.c_str());
+      res = 1;
+    }
+  }
+  kTestPack_close(pack);
+  return res;
+}
+
+static int merge(const char *output, char **inputs, unsigned numInputs) {
+  std::unordered_set<std::string> seen;
+  unsigned nextId = 1;
+
+  /* keep what the output already has */
+  struct stat st;
+  if (!stat(output, &st)) {
+    KTestPack *pack = openPack(output);
+    if (!pack)
+      return 1;
+    for (unsigned i = 0; i < kTestPack_numTests(pack); i++) {
+      unsigned size;
+      const unsigned char *image = kTestPack_getImage(pack, i, &size);
+      seen.insert(std::string((const char*) image, size));
+      if (kTestPack_getId(pack, i) >= nextId)
+        nextId = kTestPack_getId(pack, i) + 1;
+    }
+    kTestPack_close(pack);
+  }
+
+  unsigned added = 0, duplicates = 0;
+  for (unsigned p = 0; p < numInputs; p++) {
+    KTestPack *pack = openPack(inputs[p]);
+    if (!pack)
+      return 1;
+    for (unsigned i = 0; i < kTestPack_numTests(pack); i++) {
+      unsigned size;
+      const unsigned char *image = kTestPack_getImage(pack, i, &size);
+      if (!seen.insert(std::string((const char*) image, size)).second) {
+        duplicates++;
+        continue;
+      }
+      KTest *test = kTestPack_getTest(pack, i);
+      if (!test || !kTest_appendToPack(test, nextId, output)) {
+        fprintf(stderr, "ERROR: unable to copy test%06d.ktest of %s\n",
+                kTestPack_getId(pack, i), inputs[p]);
+        if (test)
+          kTest_free(test);
+        kTestPack_close(pack);
+        return 1;
+      }
+      kTest_free(test);
+      nextId++;
+      added++;
+    }
+    kTestPack_close(pack);
+  }
+
+  printf("merged %u test cases, dropped %u duplicates\n", added, duplicates);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 3 && !strcmp(argv[1], "list"))
+    return list(argv[2]);
+  if (argc == 4 && !strcmp(argv[1], "extract"))
+    return extract(argv[2], argv[3]);
+  if (argc >= 4 && !strcmp(argv[1], "merge"))
+    return merge(argv[2], argv + 3, argc - 3);
+
+  usage(argv[0]);
+  return 1;
+}
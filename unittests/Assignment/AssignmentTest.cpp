@@ -1,5 +1,7 @@
 #include "klee/util/ArrayCache.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/AssignmentBatch.h"
+#include "klee/util/ConcreteEvaluator.h"
 #include "gtest/gtest.h"
 #include <iostream>
 #include <vector>
@@ -33,3 +35,145 @@ TEST(AssignmentTest, FoldNotOptimized)
   ASSERT_TRUE(asConstant != NULL);
   ASSERT_EQ(asConstant->getZExtValue(), (unsigned) 128);
 }
+
+TEST(AssignmentTest, BatchMatchesScalarEvaluation)
+{
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("batch_a", 4);
+  const Array *b = ac.CreateArray("batch_b", 2);
+  ref<Expr> x = Expr::createTempRead(a, Expr::Int32);
+  ref<Expr> y = ZExtExpr::create(Expr::createTempRead(b, Expr::Int8),
+                                 Expr::Int32);
+  ref<Expr> c3 = ConstantExpr::alloc(3, Expr::Int32);
+
+  std::vector<ref<Expr> > exprs;
+  exprs.push_back(UltExpr::create(AddExpr::create(x, y), c3));
+  exprs.push_back(EqExpr::create(URemExpr::create(x, y),
+                                 ConstantExpr::alloc(1, Expr::Int32)));
+  exprs.push_back(SltExpr::create(SDivExpr::create(x, y), c3));
+  exprs.push_back(NeExpr::create(AShrExpr::create(x, y),
+                                 ShlExpr::create(y, c3)));
+  exprs.push_back(SleExpr::create(SExtExpr::create(
+                                      ExtractExpr::create(x, 5, Expr::Int8),
+                                      Expr::Int32), y));
+  // a read through a symbolic update, and one past the binding of b
+  UpdateList ul(b, 0);
+  ul.extend(ExtractExpr::create(x, 0, Expr::Int32),
+            ConstantExpr::alloc(7, Expr::Int8));
+  exprs.push_back(EqExpr::create(
+      ReadExpr::create(ul, ConstantExpr::alloc(1, Expr::Int32)),
+      ConstantExpr::alloc(7, Expr::Int8)));
+  exprs.push_back(EqExpr::create(
+      ReadExpr::create(UpdateList(b, 0), ConstantExpr::alloc(5, Expr::Int32)),
+      ConstantExpr::alloc(0, Expr::Int8)));
+
+  std::vector<Assignment*> assignments;
+  AssignmentBatch batch;
+  unsigned seed = 1;
+  for (unsigned i = 0; i < AssignmentBatch::MaxLanes; i++) {
+    std::vector<const Array*> objects;
+    std::vector< std::vector<unsigned char> > values(2);
+    objects.push_back(a);
+    objects.push_back(b);
+    for (unsigned j = 0; j < 4; j++) {
+      seed = seed * 1103515245 + 12345;
+      // small values, so that divisions by zero and hits are common
+      values[0].push_back(j ? (seed >> 16) & 0xff : (seed >> 16) & 3);
+    }
+    for (unsigned j = 0; j < 2; j++) {
+      seed = seed * 1103515245 + 12345;
+      values[1].push_back((seed >> 16) % 3);
+    }
+    assignments.push_back(new Assignment(objects, values));
+    ASSERT_EQ(i, batch.add(assignments.back()));
+  }
+  ASSERT_TRUE(batch.isFull());
+
+  for (unsigned e = 0; e < exprs.size(); e++) {
+    uint64_t lanes = batch.satisfying(exprs.begin() + e, exprs.begin() + e + 1);
+    for (unsigned i = 0; i < assignments.size(); i++)
+      EXPECT_EQ(assignments[i]->satisfies(exprs.begin() + e,
+                                          exprs.begin() + e + 1),
+                (bool) ((lanes >> i) & 1)) << "expression " << e
+                                           << ", lane " << i;
+  }
+
+  uint64_t all = batch.satisfying(exprs.begin(), exprs.begin() + 2);
+  for (unsigned i = 0; i < assignments.size(); i++)
+    EXPECT_EQ(assignments[i]->satisfies(exprs.begin(), exprs.begin() + 2),
+              (bool) ((all >> i) & 1));
+
+  // removed lanes never satisfy
+  for (unsigned i = 0; i < assignments.size(); i++)
+    batch.remove(assignments[i]);
+  EXPECT_TRUE(batch.empty());
+  ref<Expr> t = ConstantExpr::alloc(1, Expr::Bool);
+  EXPECT_EQ(-1, batch.findSatisfying(&t, &t + 1));
+  for (unsigned i = 0; i < assignments.size(); i++)
+    delete assignments[i];
+}
+
+TEST(AssignmentTest, ConcreteMatchesExprEvaluator)
+{
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("concrete_a", 8);
+  Expr::Kind kinds[] = { Expr::Add, Expr::Sub, Expr::Mul, Expr::UDiv,
+                         Expr::SDiv, Expr::URem, Expr::SRem, Expr::And,
+                         Expr::Or, Expr::Xor, Expr::Shl, Expr::LShr,
+                         Expr::AShr, Expr::Eq, Expr::Ne, Expr::Ult,
+                         Expr::Ule, Expr::Ugt, Expr::Uge, Expr::Slt,
+                         Expr::Sle, Expr::Sgt, Expr::Sge };
+  // the widths with a kernel of their own, and a masked one
+  Expr::Width widths[] = { Expr::Bool, Expr::Int8, Expr::Int16, Expr::Int32,
+                           Expr::Int64, 24 };
+  ref<Expr> all = Expr::createTempRead(a, Expr::Int64);
+
+  // kept alive, the evaluator memoizes the nodes by address
+  std::vector<ref<Expr> > exprs;
+  for (unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+    ref<Expr> x = ExtractExpr::create(all, 0, widths[w]);
+    ref<Expr> y = ExtractExpr::create(all, 64 - widths[w], widths[w]);
+    std::vector<Expr::CreateArg> args;
+    args.push_back(x);
+    args.push_back(y);
+    for (unsigned k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+      exprs.push_back(Expr::createFromKind(kinds[k], args));
+    exprs.push_back(SExtExpr::create(x, Expr::Int64));
+    exprs.push_back(SelectExpr::create(SltExpr::create(x, y),
+                                       NotExpr::create(x),
+                                       SubExpr::create(y, x)));
+  }
+  exprs.push_back(ConcatExpr::create(ExtractExpr::create(all, 3, Expr::Bool),
+                                     ExtractExpr::create(all, 8, 16)));
+
+  unsigned seed = 7;
+  for (unsigned n = 0; n < 64; n++) {
+    std::vector<const Array*> objects(1, a);
+    std::vector< std::vector<unsigned char> > values(1);
+    for (unsigned j = 0; j < 8; j++) {
+      seed = seed * 1103515245 + 12345;
+      // mostly small values, so that divisions by zero and shifts past the
+      // width are common
+      unsigned char byte = (seed >> 16) & 0xff;
+      values[0].push_back(n % 2 ? byte : byte % 3);
+    }
+    Assignment assignment(objects, values);
+    ConcreteEvaluator concrete(assignment);
+
+    for (unsigned e = 0; e < exprs.size(); e++) {
+      ref<Expr> expected = AssignmentEvaluator(assignment).visit(exprs[e]);
+      ref<ConstantExpr> value = concrete.evaluate(exprs[e]);
+      if (value.isNull()) {
+        // only a division by zero is left to the ExprEvaluator
+        EXPECT_FALSE(isa<ConstantExpr>(expected)) << "expression " << e;
+        continue;
+      }
+      ASSERT_TRUE(isa<ConstantExpr>(expected)) << "expression " << e;
+      EXPECT_EQ(cast<ConstantExpr>(expected)->getZExtValue(),
+                value->getZExtValue()) << "expression " << e;
+      EXPECT_EQ(expected->getWidth(), value->getWidth());
+    }
+    EXPECT_EQ(assignment.satisfies(exprs.begin(), exprs.begin() + 1),
+              AssignmentEvaluator(assignment).visit(exprs[0])->isTrue());
+  }
+}
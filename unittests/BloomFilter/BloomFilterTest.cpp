@@ -0,0 +1,40 @@
+#include "klee/Internal/Support/BloomFilter.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(BloomFilterTest, InsertedAreFound) {
+  BloomFilter filter(1 << 16, 4);
+  for (uint64_t i = 0; i < 1000; i++)
+    EXPECT_TRUE(filter.insert(i * 0x9e3779b97f4a7c15ULL));
+  for (uint64_t i = 0; i < 1000; i++) {
+    EXPECT_TRUE(filter.contains(i * 0x9e3779b97f4a7c15ULL));
+    EXPECT_FALSE(filter.insert(i * 0x9e3779b97f4a7c15ULL));
+  }
+  EXPECT_EQ(1000u, filter.size());
+}
+
+TEST(BloomFilterTest, FalsePositives) {
+  BloomFilter filter(1 << 20, 4);
+  EXPECT_EQ(0., filter.getFalsePositiveRate());
+  for (uint64_t i = 0; i < 10000; i++)
+    filter.insert(i);
+  unsigned found = 0;
+  for (uint64_t i = 10000; i < 110000; i++)
+    found += filter.contains(i);
+  // the rate is about 2e-6 at this fill
+  EXPECT_LT(filter.getFalsePositiveRate(), 1e-5);
+  EXPECT_LT(found, 10u);
+}
+
+TEST(BloomFilterTest, SmallFilterSaturates) {
+  BloomFilter filter(1, 2);
+  for (uint64_t i = 0; i < 200; i++)
+    filter.insert(i);
+  EXPECT_GT(filter.getFalsePositiveRate(), 0.9);
+  EXPECT_LT(filter.size(), 200u);
+}
+
+}
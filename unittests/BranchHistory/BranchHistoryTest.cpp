@@ -0,0 +1,79 @@
+#include "klee/Config/config.h"
+#include "klee/Internal/Support/BranchHistory.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB_H
+
+using namespace klee;
+
+namespace {
+
+std::string tempPath() {
+  char path[] = "/tmp/BranchHistoryTest.XXXXXX";
+  int fd = mkstemp(path);
+  EXPECT_GE(fd, 0);
+  close(fd);
+  return path;
+}
+
+std::vector<char> toPath(const std::string &s) {
+  return std::vector<char>(s.begin(), s.end());
+}
+
+TEST(BranchHistoryTest, RoundTrip) {
+  std::string path = tempPath();
+  const char *paths[] = { "0010", "0011", "", "1", "0010203", "00102" };
+  unsigned numPaths = sizeof(paths) / sizeof(paths[0]);
+
+  {
+    std::string error;
+    BranchHistoryWriter writer(path, error);
+    ASSERT_EQ("", error);
+    for (unsigned i = 0; i < numPaths; i++)
+      writer.write(toPath(paths[i]));
+    /* long paths need more than one byte for their length */
+    writer.write(std::vector<char>(1000, '1'));
+  }
+
+  BranchHistoryReader reader(path);
+  ASSERT_TRUE(reader.good());
+  std::vector<char> read;
+  for (unsigned i = 0; i < numPaths; i++) {
+    ASSERT_TRUE(reader.next(read));
+    EXPECT_EQ(toPath(paths[i]), read);
+  }
+  ASSERT_TRUE(reader.next(read));
+  EXPECT_EQ(std::vector<char>(1000, '1'), read);
+  EXPECT_FALSE(reader.next(read));
+  unlink(path.c_str());
+}
+
+TEST(BranchHistoryTest, PlainLog) {
+  std::string path = tempPath();
+  FILE *f = fopen(path.c_str(), "w");
+  ASSERT_TRUE(f);
+  fputs("0010\n\n011\n", f);
+  fclose(f);
+
+  BranchHistoryReader reader(path);
+  ASSERT_TRUE(reader.good());
+  std::vector<char> read;
+  ASSERT_TRUE(reader.next(read));
+  EXPECT_EQ(toPath("0010"), read);
+  ASSERT_TRUE(reader.next(read));
+  EXPECT_TRUE(read.empty());
+  ASSERT_TRUE(reader.next(read));
+  EXPECT_EQ(toPath("011"), read);
+  EXPECT_FALSE(reader.next(read));
+  unlink(path.c_str());
+}
+
+}
+
+#endif
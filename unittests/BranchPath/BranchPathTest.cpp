@@ -0,0 +1,47 @@
+#include "klee/Internal/Support/BranchPath.h"
+#include "gtest/gtest.h"
+
+#include <string>
+
+using namespace klee;
+
+namespace {
+
+std::string str(const BranchPath &path) {
+  std::vector<char> branches = path.toVector();
+  return std::string(branches.begin(), branches.end());
+}
+
+TEST(BranchPathTest, Append) {
+  BranchPath path;
+  EXPECT_TRUE(path.empty());
+  std::string expected;
+  for (unsigned i = 0; i < 3 * BranchPath::ChunkSize + 5; i++) {
+    char branch = '0' + i % 3;
+    path.push_back(branch);
+    expected += branch;
+  }
+  EXPECT_EQ(expected.size(), path.size());
+  EXPECT_EQ(expected, str(path));
+}
+
+TEST(BranchPathTest, ForkedPathsShareTheirPrefix) {
+  BranchPath a;
+  a.assign("0101", "0101" + 4);
+  BranchPath b(a);
+  a.push_back('0');
+  b.push_back('1');
+  BranchPath c(b);
+  b.push_back('2');
+  c.push_back('3');
+
+  EXPECT_EQ("01010", str(a));
+  EXPECT_EQ("010112", str(b));
+  EXPECT_EQ("010113", str(c));
+
+  a.clear();
+  EXPECT_EQ("", str(a));
+  EXPECT_EQ("010112", str(b));
+}
+
+}
@@ -0,0 +1,70 @@
+#include "klee/Internal/Support/Campaign.h"
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+using namespace klee;
+
+namespace {
+
+TEST(CampaignTest, Parse) {
+  std::istringstream is(
+      "# name priority settings -- arguments\n"
+      "dfs-137 2 error-location=decoding.c:137 search=DFS -- 32\n"
+      "\n"
+      "bfs-1118 1 search=BFS timeout=1800 # no arguments\n");
+  Campaign campaign;
+  std::string error;
+  ASSERT_TRUE(campaign.parse(is, error)) << error;
+  ASSERT_EQ(2u, campaign.size());
+
+  EXPECT_EQ("dfs-137", campaign[0].name);
+  EXPECT_EQ(2u, campaign[0].priority);
+  EXPECT_EQ("decoding.c:137", campaign[0].errorLocation);
+  EXPECT_EQ("DFS", campaign[0].search);
+  EXPECT_EQ(0u, campaign[0].timeOut);
+  EXPECT_TRUE(campaign[0].hasArgs);
+  ASSERT_EQ(1u, campaign[0].args.size());
+  EXPECT_EQ("32", campaign[0].args[0]);
+
+  EXPECT_EQ("", campaign[1].errorLocation);
+  EXPECT_EQ(1800u, campaign[1].timeOut);
+  EXPECT_FALSE(campaign[1].hasArgs);
+}
+
+TEST(CampaignTest, Errors) {
+  Campaign campaign;
+  std::string error;
+  std::istringstream noPriority("dfs\n");
+  EXPECT_FALSE(campaign.parse(noPriority, error));
+  std::istringstream unknown("dfs 1 depth=3\n");
+  EXPECT_FALSE(campaign.parse(unknown, error));
+  EXPECT_NE(std::string::npos, error.find("line 1"));
+  std::istringstream repeated("dfs 1\ndfs 2\n");
+  EXPECT_FALSE(campaign.parse(repeated, error));
+  std::istringstream none("# nothing\n");
+  EXPECT_FALSE(campaign.parse(none, error));
+}
+
+TEST(CampaignTest, Partition) {
+  std::istringstream is("a 3\nb 1\nc 1\n");
+  Campaign campaign;
+  std::string error;
+  ASSERT_TRUE(campaign.parse(is, error)) << error;
+
+  std::vector<unsigned> blocks;
+  EXPECT_FALSE(campaign.partition(5, 2, blocks));
+  ASSERT_TRUE(campaign.partition(12, 2, blocks));
+  // 6 spare ranks: 3.6, 1.2 and 1.2, the remainder goes to a
+  ASSERT_EQ(3u, blocks.size());
+  EXPECT_EQ(6u, blocks[0]);
+  EXPECT_EQ(3u, blocks[1]);
+  EXPECT_EQ(3u, blocks[2]);
+
+  EXPECT_EQ(0u, Campaign::getConfig(blocks, 0));
+  EXPECT_EQ(0u, Campaign::getConfig(blocks, 5));
+  EXPECT_EQ(1u, Campaign::getConfig(blocks, 6));
+  EXPECT_EQ(2u, Campaign::getConfig(blocks, 11));
+}
+
+}
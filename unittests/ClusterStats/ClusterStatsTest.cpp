@@ -0,0 +1,57 @@
+#include "klee/Internal/Support/ClusterStats.h"
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+using namespace klee;
+
+namespace {
+
+TEST(ClusterStatsTest, LastRecordPerRank) {
+  ClusterStats stats;
+  EXPECT_EQ(0u, stats.getNumReporting());
+  EXPECT_EQ(0u, stats.getTotal(ClusterStats::Instructions));
+
+  uint64_t record[ClusterStats::NumFields] = { 100, 5, 1, 2000, 10, 4, 50, 1,
+                                               0, 0, 0, 0 };
+  stats.update(1, record);
+  record[ClusterStats::Instructions] = 300;
+  stats.update(3, record);
+  /* a newer record of rank 1 replaces its old one */
+  record[ClusterStats::Instructions] = 150;
+  record[ClusterStats::States] = 2;
+  stats.update(1, record);
+
+  EXPECT_EQ(2u, stats.getNumReporting());
+  EXPECT_EQ(450u, stats.getTotal(ClusterStats::Instructions));
+  EXPECT_EQ(7u, stats.getTotal(ClusterStats::States));
+  EXPECT_EQ(2u, stats.getTotal(ClusterStats::Offloads));
+}
+
+TEST(ClusterStatsTest, Output) {
+  ClusterStats stats;
+  uint64_t record[ClusterStats::NumFields] = { 1, 2, 3, 4, 5, 6, 7, 8,
+                                               9, 10, 11, 12, 13, 14, 15,
+                                               16, 17, 18, 19 };
+  stats.update(2, record);
+
+  std::ostringstream header, row, json;
+  stats.writeHeader(header);
+  EXPECT_EQ("Time\tWorkers\tInstructions\tStates\tSuspendedStates\t"
+            "SolverTime\tQueries\tCacheHits\tCoveredInstructions\tOffloads\t"
+            "ReplayTime\tExplorationTime\tRecoveryTime\tIdleTime\t"
+            "ExprMemory\tObjectMemory\tConstraintMemory\tSnapshotMemory\t"
+            "SolverCacheMemory\tPTreeMemory\tPrefixTreeMemory\n",
+            header.str());
+  stats.writeRow(row, 1.5);
+  EXPECT_EQ("1.5\t1\t1\t2\t3\t4\t5\t6\t7\t8\t9\t10\t11\t12\t13\t14\t15\t16"
+            "\t17\t18\t19\n", row.str());
+  stats.writeJSON(json, 1.5);
+  EXPECT_EQ(0u, json.str().find("{\"time\": 1.5, \"workers\": 1, "
+                                "\"total\": {\"Instructions\": 1, "));
+  EXPECT_NE(std::string::npos,
+            json.str().find("\"ranks\": {\"2\": {\"Instructions\": 1, "));
+}
+
+}
@@ -0,0 +1,36 @@
+#include "klee/Internal/ADT/CopyOnWrite.h"
+#include "gtest/gtest.h"
+
+#include <set>
+
+using namespace klee;
+
+namespace {
+
+TEST(CopyOnWriteTest, CopiesShareUntilWritten) {
+  CopyOnWrite< std::set<int> > a;
+  EXPECT_TRUE(a->empty());
+  a.write().insert(1);
+
+  CopyOnWrite< std::set<int> > b(a);
+  EXPECT_TRUE(a.isShared());
+  EXPECT_EQ(&*a, &*b);
+
+  b.write().insert(2);
+  EXPECT_FALSE(a.isShared());
+  EXPECT_NE(&*a, &*b);
+  EXPECT_EQ(1u, a->size());
+  EXPECT_EQ(2u, b->size());
+}
+
+TEST(CopyOnWriteTest, Clear) {
+  CopyOnWrite< std::set<int> > a;
+  a.write().insert(1);
+  CopyOnWrite< std::set<int> > b(a);
+  b.clear();
+  EXPECT_TRUE(b->empty());
+  EXPECT_EQ(1u, a->size());
+  EXPECT_FALSE(a.isShared());
+}
+
+}
@@ -0,0 +1,45 @@
+#include "klee/Internal/Support/CoveragePlateau.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(CoveragePlateauTest, Disabled) {
+  CoveragePlateau plateau(0, 1, 0);
+  EXPECT_FALSE(plateau.isEnabled());
+  EXPECT_FALSE(plateau.isReached(1000));
+}
+
+TEST(CoveragePlateauTest, FirstWindowIsNotJudged) {
+  CoveragePlateau plateau(60, 1, 100);
+  EXPECT_FALSE(plateau.isReached(100));
+  EXPECT_FALSE(plateau.isReached(159));
+  EXPECT_TRUE(plateau.isReached(160));
+}
+
+TEST(CoveragePlateauTest, SlidingWindow) {
+  CoveragePlateau plateau(60, 10, 0);
+  plateau.record(10, 4);
+  plateau.record(50, 8);
+  EXPECT_EQ(12u, plateau.getCovered(60));
+  EXPECT_FALSE(plateau.isReached(60));
+
+  // the first heartbeat leaves the window
+  EXPECT_EQ(8u, plateau.getCovered(70));
+  EXPECT_TRUE(plateau.isReached(70));
+  plateau.record(75, 2);
+  EXPECT_FALSE(plateau.isReached(75));
+  EXPECT_EQ(0u, plateau.getCovered(135));
+}
+
+TEST(CoveragePlateauTest, Reset) {
+  CoveragePlateau plateau(30, 1, 0);
+  EXPECT_TRUE(plateau.isReached(30));
+  plateau.reset(30);
+  EXPECT_EQ(0u, plateau.getCovered(30));
+  EXPECT_FALSE(plateau.isReached(59));
+  EXPECT_TRUE(plateau.isReached(60));
+}
+
+}
@@ -0,0 +1,85 @@
+#include "klee/Internal/Support/EventTrace.h"
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+using namespace klee;
+
+namespace {
+
+TEST(EventTraceTest, RingKeepsNewest) {
+  EventTrace disabled;
+  disabled.record(EventTrace::SolverCall, 1, 2, 0);
+  std::vector<EventTrace::Event> events;
+  disabled.getEvents(events);
+  EXPECT_TRUE(events.empty());
+
+  EventTrace trace(3);
+  for (unsigned i = 0; i < 5; i++)
+    trace.record(EventTrace::ReplayDone, 100 + i, 0, i);
+  trace.getEvents(events);
+  ASSERT_EQ(3u, events.size());
+  EXPECT_EQ(2u, events[0].arg);
+  EXPECT_EQ(4u, events[2].arg);
+  EXPECT_EQ(104u, events[2].start);
+  EXPECT_EQ(2u, trace.getNumDropped());
+}
+
+TEST(EventTraceTest, Encoding) {
+  EventTrace trace(4);
+  trace.record(EventTrace::Recovery, 1000, 50, 2);
+  trace.record(EventTrace::MemoryKill, 1100, 0, 7);
+  std::vector<char> packet;
+  trace.encode(2000, packet);
+
+  uint64_t sent, dropped;
+  std::vector<EventTrace::Event> events;
+  ASSERT_TRUE(EventTrace::decode(&packet[0], packet.size(), sent, dropped,
+                                 events));
+  EXPECT_EQ(2000u, sent);
+  EXPECT_EQ(0u, dropped);
+  ASSERT_EQ(2u, events.size());
+  EXPECT_EQ((uint32_t) EventTrace::Recovery, events[0].kind);
+  EXPECT_EQ(50u, events[0].duration);
+  EXPECT_EQ(7u, events[1].arg);
+
+  EXPECT_FALSE(EventTrace::decode(&packet[0], packet.size() - 1, sent,
+                                  dropped, events));
+  packet[0] = 'X';
+  EXPECT_FALSE(EventTrace::decode(&packet[0], packet.size(), sent, dropped,
+                                  events));
+}
+
+TEST(EventTraceTest, MergeCorrectsClocks) {
+  /* the worker clock is 500us ahead of the master's */
+  EventTrace worker(4);
+  worker.record(EventTrace::SolverCall, 1700, 100, 0);
+  std::vector<char> packet;
+  worker.encode(2500, packet);
+
+  TraceMerger merger;
+  std::vector<EventTrace::Event> master(1);
+  master[0].start = 1000;
+  master[0].duration = 0;
+  master[0].kind = EventTrace::OffloadRequest;
+  master[0].arg = 1;
+  merger.add(0, master, 0, 0);
+  ASSERT_TRUE(merger.addPacket(1, &packet[0], packet.size(), 2000));
+
+  std::ostringstream os;
+  merger.writeChromeTrace(os);
+  std::string json = os.str();
+  EXPECT_EQ(0u, json.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": ["));
+  EXPECT_NE(std::string::npos,
+            json.find("{\"name\": \"OffloadRequest\", \"pid\": 0, \"tid\": 0, "
+                      "\"ts\": 0, \"ph\": \"i\", \"s\": \"p\", "
+                      "\"args\": {\"arg\": 1}}"));
+  EXPECT_NE(std::string::npos,
+            json.find("{\"name\": \"SolverCall\", \"pid\": 1, \"tid\": 0, "
+                      "\"ts\": 200, \"ph\": \"X\", \"dur\": 100, "
+                      "\"args\": {\"arg\": 0}}"));
+  EXPECT_NE(std::string::npos, json.find("\"name\": \"worker 1\""));
+}
+
+}
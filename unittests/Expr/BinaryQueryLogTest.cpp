@@ -0,0 +1,174 @@
+//===-- BinaryQueryLogTest.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "expr/Parser.h"
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/ExprBuilder.h"
+#include "klee/Solver.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/BinaryQueryLog.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+
+using namespace klee;
+using namespace klee::expr;
+
+namespace {
+
+std::vector<QueryCommand*> parseLog(const std::string &log, ArrayCache &ac) {
+  std::unique_ptr<llvm::MemoryBuffer> MB(
+      llvm::MemoryBuffer::getMemBuffer(log, "log", false));
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  EXPECT_TRUE(isBinaryQueryLog(MB.get()));
+
+  std::unique_ptr<Parser> P(
+      Parser::Create("log", MB.get(), builder.get(), false, &ac));
+  std::vector<QueryCommand*> queries;
+  while (Decl *D = P->ParseTopLevelDecl())
+    queries.push_back(cast<QueryCommand>(D));
+  EXPECT_EQ(0u, P->GetNumErrors());
+  return queries;
+}
+
+TEST(BinaryQueryLogTest, RoundTrip) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  UpdateList ul(array, 0);
+  ul.extend(ConstantExpr::alloc(1, Expr::Int32),
+            ConstantExpr::alloc(7, Expr::Int8));
+  ref<Expr> read = ReadExpr::create(ul, ConstantExpr::alloc(0, Expr::Int32));
+  ref<Expr> wide = ZExtExpr::create(read, Expr::Int32);
+  ref<Expr> c1 = UltExpr::create(wide, ConstantExpr::alloc(10, Expr::Int32));
+  ref<Expr> c2 = NeExpr::create(ExtractExpr::create(wide, 0, Expr::Int8),
+                                ConstantExpr::alloc(3, Expr::Int8));
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(c1);
+  constraints.push_back(c2);
+  ConstraintManager cm(constraints);
+  std::vector<const Array*> objects(1, array);
+
+  ref<Expr> query = EqExpr::create(read, ConstantExpr::alloc(5, Expr::Int8));
+
+  std::string log, defs, record;
+  BinaryQueryLogWriter writer;
+  BinaryQueryLogWriter::writeHeader(log);
+  writer.writeQuery(defs, record, BinaryQueryLogWriter::Truth,
+                    Query(cm, query));
+  BinaryQueryLogWriter::writeResult(record, true, 0.5, 1);
+  log += defs + record;
+  size_t firstSize = log.size();
+
+  // The second query only refers to nodes which were already written.
+  defs.clear();
+  record.clear();
+  writer.writeQuery(defs, record, BinaryQueryLogWriter::Value,
+                    Query(cm, wide));
+  EXPECT_TRUE(defs.empty());
+  log += defs + record;
+
+  record.clear();
+  writer.writeQuery(defs, record, BinaryQueryLogWriter::InitialValues,
+                    Query(cm, c1), &objects);
+  log += defs + record;
+  EXPECT_LT(log.size() - firstSize, firstSize);
+
+  std::vector<QueryCommand*> queries = parseLog(log, ac);
+  ASSERT_EQ(3u, queries.size());
+
+  std::vector<ref<Expr> > logged;
+  for (ConstraintManager::const_iterator it = cm.begin(), ie = cm.end();
+       it != ie; ++it)
+    logged.push_back(*it);
+  ASSERT_EQ(logged.size(), queries[0]->Constraints.size());
+  for (unsigned i = 0; i < logged.size(); ++i)
+    EXPECT_EQ(logged[i], queries[0]->Constraints[i]);
+  EXPECT_EQ(query, queries[0]->Query);
+
+  EXPECT_TRUE(queries[1]->Query->isFalse());
+  ASSERT_EQ(1u, queries[1]->Values.size());
+  EXPECT_EQ(wide, queries[1]->Values[0]);
+
+  ASSERT_EQ(1u, queries[2]->Objects.size());
+  EXPECT_EQ(array, queries[2]->Objects[0]);
+
+  for (unsigned i = 0; i < queries.size(); ++i)
+    delete queries[i];
+}
+
+TEST(BinaryQueryLogTest, Truncated) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int32);
+  ConstraintManager cm;
+
+  std::string log, defs, record;
+  BinaryQueryLogWriter writer;
+  BinaryQueryLogWriter::writeHeader(log);
+  writer.writeQuery(defs, record, BinaryQueryLogWriter::Truth,
+                    Query(cm, UltExpr::create(read, ConstantExpr::alloc(
+                                                        5, Expr::Int32))));
+  log += defs.substr(0, defs.size() - 1);
+
+  std::unique_ptr<llvm::MemoryBuffer> MB(
+      llvm::MemoryBuffer::getMemBuffer(log, "log", false));
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  std::unique_ptr<Parser> P(
+      Parser::Create("log", MB.get(), builder.get(), false, &ac));
+  EXPECT_TRUE(P->ParseTopLevelDecl() == 0);
+  EXPECT_NE(0u, P->GetNumErrors());
+}
+
+TEST(BinaryQueryLogTest, Stream) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int32);
+  ref<Expr> c = UltExpr::create(read, ConstantExpr::alloc(5, Expr::Int32));
+  ConstraintManager cm;
+  cm.addConstraint(c);
+  std::vector<const Array*> objects(1, array);
+
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  BinaryQueryLogReader reader(builder.get(), &ac);
+  BinaryQueryLogWriter writer;
+  std::string defs, record;
+
+  // The chunks have no header, the second one only refers to the nodes
+  // the first one defined.
+  writer.writeQuery(defs, record, BinaryQueryLogWriter::InitialValues,
+                    Query(cm, c), &objects);
+  std::string chunk = defs + record;
+  std::unique_ptr<QueryCommand> first(
+      reader.readQuery(chunk.data(), chunk.size()));
+  ASSERT_TRUE(first.get() != 0);
+  ASSERT_EQ(1u, first->Constraints.size());
+  EXPECT_EQ(c, first->Query);
+  ASSERT_EQ(1u, first->Objects.size());
+  EXPECT_EQ(4u, first->Objects[0]->size);
+
+  defs.clear();
+  record.clear();
+  writer.writeQuery(defs, record, BinaryQueryLogWriter::InitialValues,
+                    Query(cm, Expr::createIsZero(c)), &objects);
+  chunk = defs + record;
+  std::unique_ptr<QueryCommand> second(
+      reader.readQuery(chunk.data(), chunk.size()));
+  ASSERT_TRUE(second.get() != 0);
+  EXPECT_EQ(first->Constraints[0], second->Constraints[0]);
+  EXPECT_EQ(first->Objects[0], second->Objects[0]);
+
+  // A chunk with a truncated record is an error.
+  EXPECT_TRUE(reader.readQuery(chunk.data(), chunk.size() - 1) == 0);
+}
+
+}
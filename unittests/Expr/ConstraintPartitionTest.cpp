@@ -0,0 +1,150 @@
+//===-- ConstraintPartitionTest.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/ConstraintPartition.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readAt(const Array *array, ref<Expr> index) {
+  return ReadExpr::create(UpdateList(array, 0), index);
+}
+
+ref<Expr> readAt(const Array *array, unsigned index) {
+  return readAt(array, ConstantExpr::alloc(index, Expr::Int32));
+}
+
+ref<Expr> equals(ref<Expr> e, unsigned value) {
+  return EqExpr::create(ConstantExpr::alloc(value, e->getWidth()), e);
+}
+
+TEST(ConstraintPartitionTest, Sets) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+
+  ConstraintPartition partition;
+  partition.add(0, equals(readAt(a, 0), 1));
+  partition.add(1, equals(readAt(b, 0), 2));
+  partition.add(2, equals(readAt(a, 1), 3));
+
+  std::vector< std::vector<unsigned> > sets;
+  partition.getSets(sets);
+  EXPECT_EQ(3u, sets.size());
+
+  std::vector<unsigned> dependent;
+  partition.getDependent(readAt(a, 0), dependent);
+  ASSERT_EQ(1u, dependent.size());
+  EXPECT_EQ(0u, dependent[0]);
+
+  /* a read at a symbolic index depends on every element of the array */
+  partition.getDependent(readAt(a, ZExtExpr::create(readAt(b, 3), Expr::Int32)),
+                         dependent);
+  EXPECT_EQ(2u, dependent.size());
+
+  ref<Expr> symbolic = readAt(a, ZExtExpr::create(readAt(b, 1), Expr::Int32));
+  partition.add(3, UltExpr::create(symbolic, ConstantExpr::alloc(5, Expr::Int8)));
+  partition.getSets(sets);
+  ASSERT_EQ(2u, sets.size());
+  EXPECT_EQ(1u, sets[1].size());
+  partition.getDependent(readAt(a, 2), dependent);
+  ASSERT_EQ(3u, dependent.size());
+  EXPECT_EQ(0u, dependent[0]);
+  EXPECT_EQ(2u, dependent[1]);
+  EXPECT_EQ(3u, dependent[2]);
+
+  partition.add(4, EqExpr::create(readAt(b, 0), readAt(b, 1)));
+  partition.getSets(sets);
+  EXPECT_EQ(1u, sets.size());
+}
+
+TEST(ConstraintPartitionTest, ConstraintManager) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+
+  ConstraintManager constraints;
+  constraints.addConstraint(UltExpr::create(readAt(a, 0), readAt(a, 1)));
+  EXPECT_EQ(1u, constraints.getPartition().size());
+
+  /* a forked copy is updated in place */
+  ConstraintManager forked(constraints);
+  forked.addConstraint(UltExpr::create(readAt(b, 0), readAt(b, 1)));
+  EXPECT_EQ(2u, forked.getPartition().size());
+  EXPECT_EQ(1u, constraints.getPartition().size());
+
+  /* rewriting an equality rebuilds the sets */
+  forked.addConstraint(equals(readAt(a, 0), 1));
+  std::vector<unsigned> dependent;
+  forked.getPartition().getDependent(readAt(b, 1), dependent);
+  ASSERT_EQ(1u, dependent.size());
+  EXPECT_EQ(forked.size(), forked.getPartition().size());
+}
+
+TEST(ConstraintPartitionTest, SharedChunks) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 256);
+
+  ConstraintManager constraints;
+  for (unsigned i = 0; i < 100; i++)
+    constraints.addConstraint(UltExpr::create(readAt(a, i), readAt(a, i + 1)));
+
+  /* forks which diverge in a shared chunk do not see each other */
+  ConstraintManager left(constraints), right(constraints);
+  left.addConstraint(UltExpr::create(readAt(a, 200), readAt(a, 201)));
+  right.addConstraint(UltExpr::create(readAt(a, 210), readAt(a, 211)));
+  ASSERT_EQ(101u, left.size());
+  ASSERT_EQ(101u, right.size());
+  EXPECT_EQ(100u, constraints.size());
+  EXPECT_NE(left[100], right[100]);
+  EXPECT_EQ(left[99], right[99]);
+  EXPECT_FALSE(left == right);
+
+  unsigned n = 0;
+  for (ConstraintManager::const_iterator it = left.begin(), ie = left.end();
+       it != ie; ++it, ++n)
+    EXPECT_EQ(left[n], *it);
+  EXPECT_EQ(101u, n);
+
+  ConstraintManager copy(left);
+  EXPECT_TRUE(copy == left);
+}
+
+TEST(ConstraintPartitionTest, SimplifyExpr) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  ref<Expr> lt = UltExpr::create(readAt(a, 0), readAt(a, 1));
+  ref<Expr> sum = AddExpr::create(readAt(a, 2), readAt(a, 3));
+
+  ConstraintManager constraints;
+  constraints.addConstraint(lt);
+  EXPECT_TRUE(constraints.simplifyExpr(lt)->isTrue());
+  EXPECT_EQ(sum, constraints.simplifyExpr(sum));
+
+  /* the replacements follow the constraints added since the last call */
+  ConstraintManager forked(constraints);
+  forked.addConstraint(equals(readAt(a, 2), 5));
+  EXPECT_EQ(AddExpr::create(ConstantExpr::alloc(5, Expr::Int8), readAt(a, 3)),
+            forked.simplifyExpr(sum));
+  EXPECT_EQ(sum, constraints.simplifyExpr(sum));
+
+  /* and the constraints rewritten by an equality */
+  forked.addConstraint(equals(readAt(a, 0), 1));
+  EXPECT_TRUE(forked.simplifyExpr(UltExpr::create(
+      ConstantExpr::alloc(1, Expr::Int8), readAt(a, 1)))->isTrue());
+  EXPECT_TRUE(forked.simplifyExpr(lt)->isTrue());
+}
+
+}
@@ -10,7 +10,14 @@
 #include <iostream>
 #include "gtest/gtest.h"
 
+#ifdef KLEE_ATOMIC_REFCOUNT
+#include <thread>
+#include <vector>
+#endif
+
+#include "klee/Constraints.h"
 #include "klee/Expr.h"
+#include "klee/Internal/System/MemoryUsage.h"
 #include "klee/util/ArrayCache.h"
 
 using namespace klee;
@@ -264,4 +271,206 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, ReadExprFoldingLongUpdateList) {
+  unsigned size = 64;
+
+  std::vector<ref<ConstantExpr> > Contents(size);
+  for (unsigned i = 0; i < size; ++i)
+    Contents[i] = ConstantExpr::create(i, Expr::Int8);
+  ArrayCache ac;
+  const Array *array =
+      ac.CreateArray("arr", size, &Contents[0], &Contents[0] + size);
+
+  // Long enough for the reads to go through the snapshots
+  UpdateList ul(array, 0);
+  std::vector<unsigned> expected(size);
+  for (unsigned i = 0; i < size; ++i)
+    expected[i] = i;
+  for (unsigned j = 0; j < 500; ++j) {
+    unsigned index = (j * 7) % size;
+    expected[index] = j & 0xFF;
+    ul.extend(ConstantExpr::create(index, Expr::Int32),
+              ConstantExpr::create(j & 0xFF, Expr::Int8));
+  }
+  for (unsigned i = 0; i < size; ++i) {
+    ref<Expr> read = ReadExpr::create(ul, ConstantExpr::create(i, Expr::Int32));
+    ASSERT_TRUE(isa<ConstantExpr>(read));
+    EXPECT_EQ(expected[i], cast<ConstantExpr>(read)->getZExtValue());
+  }
+
+  // Only the indices written since a symbolic write still fold
+  const Array *array2 = ac.CreateArray("arr2", 256);
+  ul.extend(ReadExpr::createTempRead(array2, Expr::Int32),
+            ConstantExpr::create(1, Expr::Int8));
+  for (unsigned j = 0; j < 100; ++j) {
+    expected[j % 8] = j;
+    ul.extend(ConstantExpr::create(j % 8, Expr::Int32),
+              ConstantExpr::create(j, Expr::Int8));
+  }
+  for (unsigned i = 0; i < size; ++i) {
+    ref<Expr> read = ReadExpr::create(ul, ConstantExpr::create(i, Expr::Int32));
+    if (i < 8) {
+      ASSERT_TRUE(isa<ConstantExpr>(read));
+      EXPECT_EQ(expected[i], cast<ConstantExpr>(read)->getZExtValue());
+    } else {
+      EXPECT_EQ(Expr::Read, read.get()->getKind());
+    }
+  }
+}
+
+TEST(ExprTest, Interning) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  Expr::internExprs = true;
+
+  ref<Expr> a = AddExpr::create(ReadExpr::createTempRead(array, Expr::Int32),
+                                ConstantExpr::create(1, Expr::Int32));
+  ref<Expr> b = AddExpr::create(ReadExpr::createTempRead(array, Expr::Int32),
+                                ConstantExpr::create(1, Expr::Int32));
+  EXPECT_EQ(a.get(), b.get());
+
+  ref<Expr> c = AddExpr::create(ReadExpr::createTempRead(array, Expr::Int32),
+                                ConstantExpr::create(2, Expr::Int32));
+  EXPECT_NE(a.get(), c.get());
+  EXPECT_NE(a, c);
+
+  /* dead expressions leave the table */
+  unsigned count = Expr::count;
+  a = b = c = 0;
+  EXPECT_GT(count, Expr::count);
+  ref<Expr> d = ConstantExpr::create(2, Expr::Int32);
+  EXPECT_EQ(d, ConstantExpr::create(2, Expr::Int32));
+
+  Expr::internExprs = false;
+}
+
+TEST(ExprTest, SharedSmallConstants) {
+  ref<ConstantExpr> a = ConstantExpr::create(7, Expr::Int32);
+  EXPECT_EQ(a.get(), ConstantExpr::create(7, Expr::Int32).get());
+  EXPECT_EQ(a.get(), ConstantExpr::create(3, Expr::Int32)
+                         ->Add(ConstantExpr::create(4, Expr::Int32)).get());
+  EXPECT_NE(a.get(), ConstantExpr::create(7, Expr::Int64).get());
+  EXPECT_EQ(ConstantExpr::create(1, Expr::Bool).get(),
+            ConstantExpr::create(5, Expr::Int8)
+                ->Ult(ConstantExpr::create(6, Expr::Int8)).get());
+
+  /* other constants are still allocated, and equal by value */
+  ref<ConstantExpr> big = ConstantExpr::create(1000, Expr::Int32);
+  EXPECT_EQ(big, ConstantExpr::create(1000, Expr::Int32));
+  EXPECT_EQ(ConstantExpr::create(7, 24)->getZExtValue(), 7u);
+}
+
+TEST(ExprTest, SharedNegativeConstants) {
+  ref<ConstantExpr> one = ConstantExpr::create(1, Expr::Int32);
+  ref<ConstantExpr> minusOne = ConstantExpr::create(0xffffffff, Expr::Int32);
+  EXPECT_EQ(minusOne.get(), ConstantExpr::create(0, Expr::Int32)
+                                ->Sub(one).get());
+  EXPECT_EQ(minusOne.get(), one->Neg().get());
+  EXPECT_EQ(ConstantExpr::create(-16ULL, Expr::Int64).get(),
+            ConstantExpr::create(16, Expr::Int64)->Neg().get());
+  EXPECT_EQ(ConstantExpr::create(0xffef, Expr::Int16)->getZExtValue(),
+            0xffefu);
+}
+
+/* the folding on machine words agrees with APInt */
+TEST(ExprTest, ConstantFolding) {
+  static const Expr::Width widths[] = { 1, 8, 13, 16, 32, 63, 64 };
+  static const uint64_t values[] = { 0, 1, 2, 5, 7, 0x7f, 0x80, 0xff,
+                                     0x7fffffff, 0x80000000, 0xfffffff0,
+                                     0x123456789abcdefULL, -1ULL, -2ULL,
+                                     0x8000000000000000ULL };
+  const unsigned numValues = sizeof(values) / sizeof(values[0]);
+  for (unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+    Expr::Width width = widths[w];
+    for (unsigned i = 0; i < numValues; i++)
+      for (unsigned j = 0; j < numValues; j++) {
+        llvm::APInt a(width, values[i]), b(width, values[j]);
+        ref<ConstantExpr> x = ConstantExpr::alloc(a), y = ConstantExpr::alloc(b);
+        EXPECT_EQ((a + b), x->Add(y)->getAPValue());
+        EXPECT_EQ((a - b), x->Sub(y)->getAPValue());
+        EXPECT_EQ((a * b), x->Mul(y)->getAPValue());
+        EXPECT_EQ((a & b), x->And(y)->getAPValue());
+        EXPECT_EQ((a | b), x->Or(y)->getAPValue());
+        EXPECT_EQ((a ^ b), x->Xor(y)->getAPValue());
+        if (b != 0) {
+          EXPECT_EQ(a.udiv(b), x->UDiv(y)->getAPValue());
+          EXPECT_EQ(a.urem(b), x->URem(y)->getAPValue());
+        }
+        EXPECT_EQ(a.shl(b), x->Shl(y)->getAPValue());
+        EXPECT_EQ(a.lshr(b), x->LShr(y)->getAPValue());
+        EXPECT_EQ(a.ashr(b), x->AShr(y)->getAPValue());
+        EXPECT_EQ(a.ult(b), x->Ult(y)->isTrue());
+        EXPECT_EQ(a.ule(b), x->Ule(y)->isTrue());
+        EXPECT_EQ(a.ugt(b), x->Ugt(y)->isTrue());
+        EXPECT_EQ(a.uge(b), x->Uge(y)->isTrue());
+        EXPECT_EQ(a.slt(b), x->Slt(y)->isTrue());
+        EXPECT_EQ(a.sle(b), x->Sle(y)->isTrue());
+        EXPECT_EQ(a.sgt(b), x->Sgt(y)->isTrue());
+        EXPECT_EQ(a.sge(b), x->Sge(y)->isTrue());
+        EXPECT_EQ(a.zext(2 * width).shl(width) | b.zext(2 * width),
+                  x->Concat(y)->getAPValue());
+      }
+    for (unsigned i = 0; i < numValues; i++) {
+      llvm::APInt a(width, values[i]);
+      ref<ConstantExpr> x = ConstantExpr::alloc(a);
+      EXPECT_EQ(-a, x->Neg()->getAPValue());
+      EXPECT_EQ(~a, x->Not()->getAPValue());
+      EXPECT_EQ(a.zext(64), x->ZExt(64)->getAPValue());
+      EXPECT_EQ(a.sext(64), x->SExt(64)->getAPValue());
+      EXPECT_EQ(a.zextOrTrunc(1), x->ZExt(1)->getAPValue());
+      if (width > 1)
+        EXPECT_EQ(a.lshr(1).trunc(width - 1),
+                  x->Extract(1, width - 1)->getAPValue());
+    }
+  }
+}
+
+TEST(ExprTest, MemoryAccounting) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  /* the shared small constants live on */
+  ConstantExpr::create(0, Expr::Bool);
+  size_t exprs = util::GetMemoryUsage(util::ExprMemory);
+  size_t constraints = util::GetMemoryUsage(util::ConstraintMemory);
+  {
+    ref<Expr> read = Expr::createTempRead(array, 32);
+    ref<Expr> cond = UltExpr::create(read, getConstant(1000, 32));
+    EXPECT_LT(exprs, util::GetMemoryUsage(util::ExprMemory));
+
+    ConstraintManager cm;
+    cm.addConstraint(cond);
+    EXPECT_LT(constraints, util::GetMemoryUsage(util::ConstraintMemory));
+  }
+  /* the nodes and chunks are given back to their categories */
+  EXPECT_EQ(exprs, util::GetMemoryUsage(util::ExprMemory));
+  EXPECT_EQ(constraints, util::GetMemoryUsage(util::ConstraintMemory));
+}
+
+#ifdef KLEE_ATOMIC_REFCOUNT
+TEST(ExprTest, SharedBetweenThreads) {
+  ArrayCache ac;
+  Expr::internExprs = true;
+  ref<Expr> shared = Expr::createTempRead(ac.CreateArray("arr", 4), 32);
+  unsigned refs = shared->refCount;
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 4; t++)
+    threads.push_back(std::thread([&ac, &shared] {
+      for (unsigned i = 0; i < 2000; i++) {
+        /* the same array and expressions from every thread */
+        const Array *array = ac.CreateArray("arr", 4);
+        ref<Expr> read = Expr::createTempRead(array, 32);
+        ref<Expr> sum = AddExpr::create(read, shared);
+        EXPECT_EQ(read, shared);
+        EXPECT_EQ(sum, AddExpr::create(shared, read));
+      }
+    }));
+  for (unsigned t = 0; t < threads.size(); t++)
+    threads[t].join();
+
+  EXPECT_EQ(refs, (unsigned) shared->refCount);
+  Expr::internExprs = false;
+}
+#endif
 }
@@ -0,0 +1,100 @@
+//===-- KnownBitsTest.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr.h"
+#include "klee/ExprBuilder.h"
+#include "klee/util/ArrayCache.h"
+
+using namespace klee;
+
+namespace {
+
+class KnownBitsTest : public ::testing::Test {
+protected:
+  ArrayCache cache;
+  const Array *array;
+  ExprBuilder *builder;
+  ref<Expr> byte0, byte1;
+
+  KnownBitsTest() {
+    array = cache.CreateArray("arr", 4);
+    builder = createKnownBitsExprBuilder(
+        createConstantFoldingExprBuilder(createDefaultExprBuilder()));
+    UpdateList updates(array, 0);
+    byte0 = builder->Read(updates, builder->Constant(0, Expr::Int32));
+    byte1 = builder->Read(updates, builder->Constant(1, Expr::Int32));
+  }
+
+  ~KnownBitsTest() { delete builder; }
+
+  ref<Expr> constant(uint64_t value) {
+    return builder->Constant(value, Expr::Int32);
+  }
+
+  /// byte0 << 8 | byte1, as a parser reads a big endian 16 bit field
+  ref<Expr> word() {
+    return builder->Or(
+        builder->Shl(builder->ZExt(byte0, Expr::Int32), constant(8)),
+        builder->ZExt(byte1, Expr::Int32));
+  }
+};
+
+TEST_F(KnownBitsTest, Propagation) {
+  uint64_t zero, one;
+  word()->getKnownBits(zero, one);
+  EXPECT_EQ(0xffff0000ULL, zero);
+  EXPECT_EQ(0ULL, one);
+
+  ref<Expr> odd = builder->Or(builder->ZExt(byte0, Expr::Int32), constant(1));
+  builder->Mul(odd, constant(4))->getKnownBits(zero, one);
+  EXPECT_EQ(3ULL, zero & 3);
+
+  // a quotient by 0 is all ones
+  builder->UDiv(builder->ZExt(byte0, Expr::Int32),
+                builder->ZExt(byte1, Expr::Int32))->getKnownBits(zero, one);
+  EXPECT_EQ(0ULL, zero);
+  builder->UDiv(builder->ZExt(byte0, Expr::Int32), odd)
+      ->getKnownBits(zero, one);
+  EXPECT_EQ(0xffffff00ULL, zero);
+}
+
+TEST_F(KnownBitsTest, RedundantMasks) {
+  ref<Expr> wide = builder->ZExt(byte0, Expr::Int32);
+  EXPECT_EQ(wide, builder->And(wide, constant(0xff)));
+  EXPECT_EQ(word(), builder->And(word(), constant(0xffff)));
+  // the mask keeps the low byte only
+  EXPECT_EQ(builder->ZExt(byte1, Expr::Int32),
+            builder->And(word(), constant(0xff)));
+  EXPECT_EQ(wide, builder->Or(wide, constant(0)));
+}
+
+TEST_F(KnownBitsTest, Extracts) {
+  EXPECT_EQ(byte0, builder->Extract(word(), 8, Expr::Int8));
+  EXPECT_EQ(byte1, builder->Extract(word(), 0, Expr::Int8));
+  EXPECT_EQ(byte0, builder->Extract(
+      builder->Shl(builder->ZExt(byte0, Expr::Int32), constant(16)), 16,
+      Expr::Int8));
+  EXPECT_EQ(byte1, builder->Extract(
+      builder->Concat(byte0, byte1), 0, Expr::Int8));
+  EXPECT_EQ(builder->ZExt(byte0, Expr::Int32),
+            builder->ZExt(builder->ZExt(byte0, Expr::Int16), Expr::Int32));
+}
+
+TEST_F(KnownBitsTest, Comparisons) {
+  ref<Expr> wide = builder->ZExt(byte0, Expr::Int32);
+  EXPECT_TRUE(builder->Eq(builder->And(wide, constant(0xf0)), constant(3))
+                  ->isFalse());
+  EXPECT_TRUE(builder->Ult(wide, constant(256))->isTrue());
+  EXPECT_TRUE(builder->Ule(constant(256), wide)->isFalse());
+  EXPECT_FALSE(isa<ConstantExpr>(builder->Ult(wide, constant(255))));
+}
+
+}
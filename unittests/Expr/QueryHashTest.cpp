@@ -0,0 +1,80 @@
+//===-- QueryHashTest.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/QueryHash.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readAt(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, 0),
+                          ConstantExpr::alloc(index, Expr::Int32));
+}
+
+ref<Expr> equals(ref<Expr> e, unsigned value) {
+  return EqExpr::create(ConstantExpr::alloc(value, e->getWidth()), e);
+}
+
+TEST(QueryHashTest, Canonical) {
+  ArrayCache ac;
+  const Array *x = ac.CreateArray("x", 4);
+  const Array *y = ac.CreateArray("y", 4);
+  const Array *p = ac.CreateArray("p", 4);
+  const Array *q = ac.CreateArray("q", 4);
+
+  ConstraintManager first, second;
+  first.addConstraint(equals(readAt(x, 0), 1));
+  first.addConstraint(equals(readAt(y, 0), 2));
+  /* the same constraints over renamed arrays, in the other order */
+  second.addConstraint(equals(readAt(q, 0), 2));
+  second.addConstraint(equals(readAt(p, 0), 1));
+
+  ref<Expr> sum = AddExpr::create(readAt(x, 1), readAt(y, 1));
+  ref<Expr> swapped = AddExpr::create(readAt(q, 1), readAt(p, 1));
+  QueryHasher::Hash h = QueryHasher(first).getHash(equals(sum, 5));
+  EXPECT_EQ(h, QueryHasher(second).getHash(equals(swapped, 5)));
+
+  std::vector<const Array *> objects(1, x), renamed(1, p);
+  EXPECT_EQ(QueryHasher(first).getHash(equals(sum, 5), objects),
+            QueryHasher(second).getHash(equals(swapped, 5), renamed));
+  EXPECT_NE(h, QueryHasher(first).getHash(equals(sum, 5), objects));
+}
+
+TEST(QueryHashTest, Different) {
+  ArrayCache ac;
+  const Array *x = ac.CreateArray("x", 4);
+  const Array *y = ac.CreateArray("y", 4);
+
+  ConstraintManager constraints, other;
+  constraints.addConstraint(equals(readAt(x, 0), 1));
+  other.addConstraint(equals(readAt(x, 0), 2));
+
+  QueryHasher hasher(constraints);
+  QueryHasher::Hash h = hasher.getHash(equals(readAt(x, 1), 3));
+  EXPECT_NE(h, hasher.getHash(equals(readAt(x, 1), 4)));
+  EXPECT_NE(h, hasher.getHash(equals(readAt(x, 2), 3)));
+  EXPECT_NE(h, QueryHasher(other).getHash(equals(readAt(x, 1), 3)));
+
+  /* reading another array is not a renaming */
+  EXPECT_NE(h, QueryHasher(constraints).getHash(equals(readAt(y, 1), 3)));
+
+  /* nor are arrays of another size */
+  const Array *z = ac.CreateArray("z", 8);
+  ConstraintManager wider;
+  wider.addConstraint(equals(readAt(z, 0), 1));
+  EXPECT_NE(h, QueryHasher(wider).getHash(equals(readAt(z, 1), 3)));
+}
+
+}
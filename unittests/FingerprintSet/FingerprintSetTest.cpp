@@ -0,0 +1,47 @@
+#include "klee/Internal/Support/FingerprintSet.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(FingerprintSetTest, SeenOnce) {
+  FingerprintSet set(16);
+  EXPECT_TRUE(set.insert(1));
+  EXPECT_TRUE(set.insert(2));
+  EXPECT_FALSE(set.insert(1));
+  EXPECT_TRUE(set.contains(2));
+  EXPECT_FALSE(set.contains(3));
+  EXPECT_EQ(2u, set.size());
+}
+
+TEST(FingerprintSetTest, Exchange) {
+  FingerprintSet a(16), b(16);
+  a.insert(7);
+  a.insert(0xdeadbeef00000001ULL);
+  std::vector<char> packet;
+  ASSERT_TRUE(a.takeOutgoing(packet));
+  EXPECT_EQ(2 * sizeof(uint64_t), packet.size());
+  // sent once
+  EXPECT_FALSE(a.takeOutgoing(packet));
+
+  ASSERT_TRUE(b.addPacket(&packet[0], packet.size()));
+  EXPECT_FALSE(b.insert(7));
+  EXPECT_FALSE(b.insert(0xdeadbeef00000001ULL));
+  // the fingerprints of others are not sent on
+  EXPECT_FALSE(b.takeOutgoing(packet));
+
+  EXPECT_FALSE(b.addPacket(&packet[0], 3));
+}
+
+TEST(FingerprintSetTest, Capacity) {
+  FingerprintSet set(2);
+  set.insert(1);
+  set.insert(2);
+  // not recorded past the capacity, so always new
+  EXPECT_TRUE(set.insert(3));
+  EXPECT_TRUE(set.insert(3));
+  EXPECT_EQ(2u, set.size());
+}
+
+}
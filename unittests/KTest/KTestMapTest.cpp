@@ -0,0 +1,84 @@
+#include "klee/Internal/ADT/KTest.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+std::string tempPath() {
+  char path[] = "/tmp/KTestMapTest.XXXXXX";
+  int fd = mkstemp(path);
+  EXPECT_GE(fd, 0);
+  close(fd);
+  return path;
+}
+
+TEST(KTestMapTest, MatchesRead) {
+  std::string path = tempPath();
+
+  char arg0[] = "prog";
+  char arg1[] = "--sym-arg";
+  char *args[] = { arg0, arg1 };
+  char name0[] = "a";
+  char name1[] = "model_version";
+  unsigned char bytes0[] = { 1, 2, 3 };
+  unsigned char bytes1[] = { 4 };
+  KTestObject objects[] = { { name0, 3, bytes0 }, { name1, 1, bytes1 } };
+  KTest test = { 3, 2, args, 1, 8, 2, objects };
+  ASSERT_TRUE(kTest_toFile(&test, path.c_str()));
+
+  KTest *read = kTest_fromFile(path.c_str());
+  KTest *mapped = kTest_mapFile(path.c_str());
+  ASSERT_TRUE(read);
+  ASSERT_TRUE(mapped);
+  EXPECT_EQ(read->version, mapped->version);
+  EXPECT_EQ(1u, mapped->symArgvs);
+  EXPECT_EQ(8u, mapped->symArgvLen);
+  ASSERT_EQ(2u, mapped->numArgs);
+  EXPECT_STREQ("prog", mapped->args[0]);
+  EXPECT_STREQ("--sym-arg", mapped->args[1]);
+  ASSERT_EQ(read->numObjects, mapped->numObjects);
+  for (unsigned i = 0; i < mapped->numObjects; i++) {
+    EXPECT_STREQ(read->objects[i].name, mapped->objects[i].name);
+    ASSERT_EQ(read->objects[i].numBytes, mapped->objects[i].numBytes);
+    for (unsigned j = 0; j < mapped->objects[i].numBytes; j++)
+      EXPECT_EQ(read->objects[i].bytes[j], mapped->objects[i].bytes[j]);
+  }
+  EXPECT_EQ(4u, kTest_numBytes(mapped));
+  kTest_free(read);
+  kTest_free(mapped);
+
+  unlink(path.c_str());
+}
+
+TEST(KTestMapTest, Truncated) {
+  std::string path = tempPath();
+
+  char name[] = "x";
+  unsigned char bytes[] = { 1, 2, 3, 4 };
+  KTestObject object = { name, 4, bytes };
+  KTest test = { 3, 0, 0, 0, 0, 1, &object };
+  ASSERT_TRUE(kTest_toFile(&test, path.c_str()));
+
+  /* the last byte of the object is missing */
+  FILE *f = fopen(path.c_str(), "rb");
+  ASSERT_TRUE(f);
+  char contents[256];
+  size_t size = fread(contents, 1, sizeof(contents), f);
+  fclose(f);
+  ASSERT_EQ(0, truncate(path.c_str(), size - 1));
+  EXPECT_FALSE(kTest_mapFile(path.c_str()));
+
+  /* an empty file is no test case either */
+  ASSERT_EQ(0, truncate(path.c_str(), 0));
+  EXPECT_FALSE(kTest_mapFile(path.c_str()));
+
+  unlink(path.c_str());
+  EXPECT_FALSE(kTest_mapFile(path.c_str()));
+}
+
+}
@@ -0,0 +1,109 @@
+#include "klee/Internal/ADT/KTest.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+std::string tempPath() {
+  char path[] = "/tmp/KTestPackTest.XXXXXX";
+  int fd = mkstemp(path);
+  EXPECT_GE(fd, 0);
+  close(fd);
+  unlink(path);
+  return path;
+}
+
+void removePack(const std::string &path) {
+  unlink(path.c_str());
+  unlink((path + ".idx").c_str());
+}
+
+TEST(KTestPackTest, AppendAndRead) {
+  std::string path = tempPath();
+
+  char arg[] = "prog";
+  char *args[] = { arg };
+  char name[] = "x";
+  unsigned char bytes[] = { 1, 2, 3, 4 };
+  KTestObject object = { name, 4, bytes };
+  KTest test = { 3, 1, args, 0, 0, 1, &object };
+  ASSERT_TRUE(kTest_appendToPack(&test, 7, path.c_str()));
+  bytes[0] = 9;
+  ASSERT_TRUE(kTest_appendToPack(&test, 8, path.c_str()));
+
+  KTestPack *pack = kTestPack_open(path.c_str());
+  ASSERT_TRUE(pack);
+  ASSERT_EQ(2u, kTestPack_numTests(pack));
+  EXPECT_EQ(7u, kTestPack_getId(pack, 0));
+  EXPECT_EQ(8u, kTestPack_getId(pack, 1));
+
+  KTest *read = kTestPack_getTest(pack, 1);
+  ASSERT_TRUE(read);
+  EXPECT_EQ(1u, read->numArgs);
+  EXPECT_STREQ("prog", read->args[0]);
+  ASSERT_EQ(1u, read->numObjects);
+  EXPECT_STREQ("x", read->objects[0].name);
+  ASSERT_EQ(4u, read->objects[0].numBytes);
+  EXPECT_EQ(9, read->objects[0].bytes[0]);
+  kTest_free(read);
+
+  /* the image is what kTest_toFile writes */
+  std::string file = path + ".ktest";
+  ASSERT_TRUE(kTest_toFile(&test, file.c_str()));
+  FILE *f = fopen(file.c_str(), "rb");
+  ASSERT_TRUE(f);
+  char contents[256];
+  size_t size = fread(contents, 1, sizeof(contents), f);
+  fclose(f);
+  unlink(file.c_str());
+  unsigned imageSize;
+  const unsigned char *image = kTestPack_getImage(pack, 1, &imageSize);
+  ASSERT_EQ(size, imageSize);
+  EXPECT_EQ(0, memcmp(contents, image, size));
+
+  kTestPack_close(pack);
+  removePack(path);
+}
+
+TEST(KTestPackTest, StaleIndex) {
+  std::string path = tempPath();
+
+  char name[] = "x";
+  unsigned char bytes[] = { 1 };
+  KTestObject object = { name, 1, bytes };
+  KTest test = { 3, 0, 0, 0, 0, 1, &object };
+  for (unsigned id = 1; id <= 3; id++)
+    ASSERT_TRUE(kTest_appendToPack(&test, id, path.c_str()));
+
+  /* lose the last index entry, and cut the container short in the middle
+     of a fourth record */
+  ASSERT_EQ(0, truncate((path + ".idx").c_str(), 2 * 12));
+  FILE *f = fopen(path.c_str(), "ab");
+  ASSERT_TRUE(f);
+  fwrite("\0\0\0\4\0\0\1\0", 8, 1, f);
+  fclose(f);
+
+  KTestPack *pack = kTestPack_open(path.c_str());
+  ASSERT_TRUE(pack);
+  ASSERT_EQ(3u, kTestPack_numTests(pack));
+  EXPECT_EQ(3u, kTestPack_getId(pack, 2));
+  kTestPack_close(pack);
+
+  /* without the index the records are walked */
+  unlink((path + ".idx").c_str());
+  pack = kTestPack_open(path.c_str());
+  ASSERT_TRUE(pack);
+  EXPECT_EQ(3u, kTestPack_numTests(pack));
+  kTestPack_close(pack);
+
+  removePack(path);
+  EXPECT_FALSE(kTestPack_open(path.c_str()));
+}
+
+}
@@ -0,0 +1,91 @@
+#include "klee/Internal/Support/PathInterval.h"
+#include "gtest/gtest.h"
+
+#include <string>
+
+using namespace klee;
+
+namespace {
+
+TEST(PathIntervalTest, Subtrees) {
+  // [0.0101, 0.11)
+  PathInterval interval("0101", "11");
+
+  EXPECT_TRUE(interval.overlaps(""));
+  EXPECT_TRUE(interval.overlaps("01"));
+  EXPECT_FALSE(interval.overlaps("00"));
+  EXPECT_FALSE(interval.overlaps("0100"));
+  EXPECT_TRUE(interval.overlaps("0101"));
+  EXPECT_TRUE(interval.overlaps("10"));
+  EXPECT_FALSE(interval.overlaps("11"));
+
+  EXPECT_FALSE(interval.contains("01"));
+  EXPECT_TRUE(interval.contains("011"));
+  EXPECT_TRUE(interval.contains("10"));
+  EXPECT_FALSE(interval.contains("1"));
+  EXPECT_TRUE(interval.contains("101111"));
+}
+
+TEST(PathIntervalTest, OneOwnerPerPath) {
+  std::vector<PathInterval> intervals;
+  PathInterval::split(3, intervals);
+  ASSERT_EQ(3u, intervals.size());
+  EXPECT_EQ("", intervals[0].getLower());
+  EXPECT_EQ("", intervals[2].getUpper());
+  EXPECT_EQ(intervals[0].getUpper(), intervals[1].getLower());
+  EXPECT_EQ(intervals[1].getUpper(), intervals[2].getLower());
+
+  // every path of 12 forks, and every prefix of them, has one owner
+  for (unsigned length = 0; length <= 12; length++) {
+    for (unsigned path = 0; path < (1u << length); path++) {
+      std::string bits;
+      for (unsigned b = length; b > 0; b--)
+        bits.push_back((path >> (b - 1)) & 1 ? '1' : '0');
+      unsigned owners = 0, overlapping = 0;
+      for (unsigned i = 0; i < intervals.size(); i++) {
+        owners += intervals[i].owns(bits);
+        overlapping += intervals[i].overlaps(bits);
+        if (intervals[i].contains(bits))
+          EXPECT_TRUE(intervals[i].owns(bits));
+      }
+      EXPECT_EQ(1u, owners) << bits;
+      EXPECT_LE(1u, overlapping) << bits;
+    }
+  }
+}
+
+TEST(PathIntervalTest, BalancedBeyondAnInt) {
+  std::vector<PathInterval> intervals;
+  PathInterval::split(1000, intervals);
+  ASSERT_EQ(1000u, intervals.size());
+  // 10 bits to tell 1000 apart, 8 to balance them
+  EXPECT_EQ(18u, intervals[1].getLower().size());
+  EXPECT_EQ("000000000100000110", intervals[1].getLower());
+
+  // a path 40 forks deep is owned by the interval of its first bits
+  std::string deep = intervals[500].getLower() + std::string(22, '1');
+  EXPECT_TRUE(intervals[500].owns(deep));
+  EXPECT_FALSE(intervals[499].owns(deep));
+  EXPECT_FALSE(intervals[501].overlaps(deep));
+}
+
+TEST(PathIntervalTest, Encoding) {
+  PathInterval interval("0011", "");
+  std::string s = interval.encode();
+  PathInterval decoded;
+  ASSERT_TRUE(PathInterval::decode(s.data(), s.size(), decoded));
+  EXPECT_EQ("0011", decoded.getLower());
+  EXPECT_EQ("", decoded.getUpper());
+  EXPECT_FALSE(decoded.isAll());
+  EXPECT_TRUE(PathInterval("000", "").isAll());
+
+  EXPECT_FALSE(PathInterval::decode("0102", 4, decoded));
+  EXPECT_FALSE(PathInterval::decode("01-1-0", 6, decoded));
+
+  std::vector<char> history;
+  const char branches[] = "0231-1";
+  history.assign(branches, branches + 6);
+  EXPECT_EQ("011", PathInterval::getForks(history));
+}
+
+}
@@ -0,0 +1,67 @@
+#include "klee/Internal/Support/PrefixTrie.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(PrefixTrieTest, Advance) {
+  PrefixTrie trie;
+  EXPECT_FALSE(trie.hasNext());
+  trie.add("0102", 4, 0);
+  trie.add("0113", 4, 0);
+  EXPECT_EQ(2u, trie.size());
+
+  trie.advance('0');
+  trie.advance('1');
+  EXPECT_TRUE(trie.hasNext('0'));
+  EXPECT_TRUE(trie.hasNext('1'));
+  EXPECT_FALSE(trie.hasNext('2'));
+
+  PrefixTrie other(trie);
+  trie.advance('0');
+  other.advance('1');
+  EXPECT_EQ(1u, trie.size());
+  EXPECT_EQ(1u, other.size());
+  EXPECT_TRUE(trie.hasNext('2'));
+  EXPECT_TRUE(other.hasNext('3'));
+
+  trie.advance('2');
+  EXPECT_EQ(1u, trie.size());
+  EXPECT_FALSE(trie.hasNext());
+  trie.advance('0');
+  EXPECT_EQ(0u, trie.size());
+}
+
+TEST(PrefixTrieTest, AddToSharedTrie) {
+  PrefixTrie trie;
+  trie.add("01", 2, 0);
+  PrefixTrie other(trie);
+  other.add("0011", 4, 1);
+  EXPECT_EQ(1u, trie.size());
+  EXPECT_EQ(2u, other.size());
+
+  trie.advance('0');
+  trie.advance('1');
+  EXPECT_FALSE(trie.hasNext());
+  other.advance('0');
+  other.advance('1');
+  EXPECT_EQ(2u, other.size());
+  EXPECT_TRUE(other.hasNext('1'));
+}
+
+TEST(PrefixTrieTest, MergedBranch) {
+  // the sides of the merged branch hold the rest until they merged
+  PrefixTrie trie;
+  trie.add("0410", 4, 0);
+  trie.advance('0');
+  EXPECT_TRUE(trie.hasNext('4'));
+  PrefixTrie joined(trie);
+  joined.advance('4');
+  trie.advance('0');
+  EXPECT_FALSE(trie.hasNext());
+  EXPECT_TRUE(joined.hasNext('1'));
+  EXPECT_EQ(1u, joined.size());
+}
+
+}
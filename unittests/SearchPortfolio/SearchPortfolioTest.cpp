@@ -0,0 +1,89 @@
+#include "klee/Internal/Support/SearchPortfolio.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+std::vector<std::string> mix() {
+  std::vector<std::string> heuristics;
+  heuristics.push_back("DFS");
+  heuristics.push_back("COVNEW");
+  return heuristics;
+}
+
+TEST(SearchPortfolioTest, RoundRobinWithoutMeasurements) {
+  SearchPortfolio portfolio(mix(), 5);
+  EXPECT_EQ("DFS", portfolio.assign(1));
+  EXPECT_EQ("COVNEW", portfolio.assign(2));
+  EXPECT_EQ("DFS", portfolio.assign(3));
+  EXPECT_EQ("COVNEW", portfolio.assign(4));
+
+  // a rank taking a new task does not count its old one
+  portfolio.release(2);
+  EXPECT_EQ(-1, portfolio.getAssigned(2));
+  EXPECT_EQ("COVNEW", portfolio.assign(2));
+  EXPECT_EQ("COVNEW", portfolio.assign(4));
+}
+
+TEST(SearchPortfolioTest, Rotate) {
+  SearchPortfolio portfolio(mix(), 3);
+  EXPECT_EQ("DFS", portfolio.assign(1));
+  EXPECT_EQ("COVNEW", portfolio.rotate(1));
+  EXPECT_EQ(1, portfolio.getAssigned(1));
+  EXPECT_EQ("DFS", portfolio.rotate(1));
+
+  // an idle rank is assigned as usual
+  EXPECT_EQ("COVNEW", portfolio.rotate(2));
+}
+
+TEST(SearchPortfolioTest, Rates) {
+  SearchPortfolio portfolio(mix(), 3);
+  portfolio.assign(1);
+  portfolio.assign(2);
+  portfolio.recordCoverage(1, 10);
+  portfolio.recordCoverage(1, 20);
+  portfolio.recordCoverage(2, 5);
+  EXPECT_DOUBLE_EQ(15, portfolio.getRate(0));
+  EXPECT_DOUBLE_EQ(5, portfolio.getRate(1));
+
+  // idle ranks report nothing
+  portfolio.release(1);
+  portfolio.recordCoverage(1, 100);
+  EXPECT_DOUBLE_EQ(15, portfolio.getRate(0));
+}
+
+TEST(SearchPortfolioTest, SharesFollowCoverage) {
+  SearchPortfolio portfolio(mix(), 9);
+  for (unsigned rank = 1; rank < 9; rank++)
+    portfolio.assign(rank);
+  // DFS covers three times as much as COVNEW
+  for (unsigned rank = 1; rank < 9; rank++)
+    portfolio.recordCoverage(rank, portfolio.getAssigned(rank) == 0 ? 30 : 10);
+
+  unsigned dfs = 0;
+  for (unsigned rank = 1; rank < 9; rank++)
+    if (portfolio.assign(rank) == "DFS")
+      ++dfs;
+  EXPECT_EQ(6u, dfs);
+}
+
+TEST(SearchPortfolioTest, MinimumShare) {
+  SearchPortfolio portfolio(mix(), 21);
+  portfolio.assign(1);
+  portfolio.assign(2);
+  portfolio.recordCoverage(1, 1000);
+  portfolio.recordCoverage(2, 0);
+  for (unsigned rank = 1; rank < 21; rank++)
+    portfolio.release(rank);
+
+  unsigned covnew = 0;
+  for (unsigned rank = 1; rank < 21; rank++)
+    if (portfolio.assign(rank) == "COVNEW")
+      ++covnew;
+  // COVNEW keeps a tenth of the weight of DFS
+  EXPECT_LE(1u, covnew);
+  EXPECT_GE(2u, covnew);
+}
+
+}
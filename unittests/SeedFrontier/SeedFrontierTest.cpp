@@ -0,0 +1,77 @@
+#include "klee/Internal/Support/SeedFrontier.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+std::vector<std::string> frontier(const char *a, const char *b = 0,
+                                  const char *c = 0, const char *d = 0) {
+  std::vector<std::string> f;
+  const char *paths[] = { a, b, c, d };
+  for (unsigned i = 0; i < 4 && paths[i]; i++)
+    f.push_back(paths[i]);
+  return f;
+}
+
+TEST(SeedFrontierTest, SingleWorker) {
+  SeedFrontier seeds;
+  // 01 is under 0
+  seeds.add(frontier("10", "0", "01", "10"));
+  ASSERT_EQ(2u, seeds.getPrefixes().size());
+  EXPECT_EQ("0", seeds.getPrefixes()[0]);
+  EXPECT_EQ("10", seeds.getPrefixes()[1]);
+}
+
+TEST(SeedFrontierTest, KeepsPathsLeftByAll) {
+  SeedFrontier seeds;
+  // the first worker finished 11, the second 00 and 10
+  seeds.add(frontier("0", "10"));
+  seeds.add(frontier("01", "11"));
+  ASSERT_EQ(1u, seeds.getPrefixes().size());
+  EXPECT_EQ("01", seeds.getPrefixes()[0]);
+
+  seeds.add(frontier("0"));
+  ASSERT_EQ(1u, seeds.getPrefixes().size());
+  EXPECT_EQ("01", seeds.getPrefixes()[0]);
+
+  seeds.add(frontier("010", "0112"));
+  ASSERT_EQ(2u, seeds.getPrefixes().size());
+  EXPECT_EQ("010", seeds.getPrefixes()[0]);
+  EXPECT_EQ("0112", seeds.getPrefixes()[1]);
+}
+
+TEST(SeedFrontierTest, FinishedTree) {
+  SeedFrontier seeds;
+  seeds.add(frontier("0", "1"));
+  seeds.add(std::vector<std::string>());
+  EXPECT_TRUE(seeds.getPrefixes().empty());
+}
+
+TEST(SeedFrontierTest, SamePrefixOnce) {
+  SeedFrontier seeds;
+  seeds.add(frontier("02", "13"));
+  seeds.add(frontier("02", "13"));
+  ASSERT_EQ(2u, seeds.getPrefixes().size());
+  EXPECT_EQ("02", seeds.getPrefixes()[0]);
+  EXPECT_EQ("13", seeds.getPrefixes()[1]);
+}
+
+TEST(SeedFrontierTest, GenerationBranches) {
+  GenerationFrontier generations;
+  // the first seed ran 0100 and did not take 1, 00, 011 and 0101
+  generations.add(frontier("1", "00", "011", "0101"), frontier("0100"));
+  // the second one ran 0110, which goes through 011
+  generations.add(frontier("1", "00", "0111", "010"), frontier("0110"));
+
+  std::vector<std::string> prefixes = generations.getPrefixes();
+  // the first seed went through 010 and the second one through 011, what
+  // is left of them is 0101 and 0111
+  ASSERT_EQ(4u, prefixes.size());
+  EXPECT_EQ("00", prefixes[0]);
+  EXPECT_EQ("0101", prefixes[1]);
+  EXPECT_EQ("0111", prefixes[2]);
+  EXPECT_EQ("1", prefixes[3]);
+}
+
+}
@@ -0,0 +1,119 @@
+//===-- KnownBitsSolverTest.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/Solver.h"
+#include "klee/SolverStats.h"
+#include "klee/util/ArrayCache.h"
+
+using namespace klee;
+
+namespace {
+
+ArrayCache knownBitsArrays;
+
+ref<Expr> c(uint64_t value, Expr::Width width) {
+  return ConstantExpr::create(value, width);
+}
+
+/* the dummy solver fails every query, so the answers are the known bits
+   solver's */
+class KnownBitsSolverTest : public ::testing::Test {
+protected:
+  Solver *solver;
+  ref<Expr> x, y;
+
+  KnownBitsSolverTest() : solver(createKnownBitsSolver(createDummySolver())) {
+    x = Expr::createTempRead(knownBitsArrays.CreateArray("kb_x", 1),
+                             Expr::Int8);
+    y = Expr::createTempRead(knownBitsArrays.CreateArray("kb_y", 4),
+                             Expr::Int32);
+  }
+  ~KnownBitsSolverTest() { delete solver; }
+};
+
+TEST_F(KnownBitsSolverTest, MaskedTag) {
+  std::vector<ref<Expr> > cs;
+  cs.push_back(EqExpr::create(c(0x10, Expr::Int8),
+                              AndExpr::create(c(0xf0, Expr::Int8), x)));
+  ConstraintManager constraints(cs);
+
+  Solver::Validity validity;
+  ASSERT_TRUE(solver->evaluate(
+      Query(constraints, UltExpr::create(x, c(0x20, Expr::Int8))), validity));
+  EXPECT_EQ(Solver::True, validity);
+  ASSERT_TRUE(solver->evaluate(
+      Query(constraints, EqExpr::create(c(5, Expr::Int8), x)), validity));
+  EXPECT_EQ(Solver::False, validity);
+  ASSERT_TRUE(solver->evaluate(
+      Query(constraints, EqExpr::create(c(1, Expr::Int8),
+                                        LShrExpr::create(x, c(4, Expr::Int8)))),
+      validity));
+  EXPECT_EQ(Solver::True, validity);
+
+  // the low bits are free, the core solver has to answer
+  uint64_t misses = stats::queryKnownBitsMisses;
+  EXPECT_FALSE(solver->evaluate(
+      Query(constraints, UltExpr::create(x, c(0x18, Expr::Int8))), validity));
+  EXPECT_EQ(misses + 1, (uint64_t) stats::queryKnownBitsMisses);
+}
+
+TEST_F(KnownBitsSolverTest, Intervals) {
+  std::vector<ref<Expr> > cs;
+  cs.push_back(UltExpr::create(y, c(100, Expr::Int32)));
+  cs.push_back(UleExpr::create(c(10, Expr::Int32), y));
+  ConstraintManager constraints(cs);
+
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(constraints, UltExpr::create(AddExpr::create(c(5, Expr::Int32), y),
+                                         c(105, Expr::Int32))), result));
+  EXPECT_TRUE(result);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(constraints, SltExpr::create(y, c(0, Expr::Int32))), result));
+  EXPECT_FALSE(result);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(constraints, EqExpr::create(c(0, Expr::Int8),
+                                        ExtractExpr::create(y, 24, Expr::Int8))),
+      result));
+  EXPECT_TRUE(result);
+
+  // a signed bound below zero is an unsigned interval too
+  std::vector<ref<Expr> > negative;
+  negative.push_back(SltExpr::create(y, c(0, Expr::Int32)));
+  ConstraintManager negativeConstraints(negative);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(negativeConstraints, UleExpr::create(c(0x80000000, Expr::Int32), y)),
+      result));
+  EXPECT_TRUE(result);
+}
+
+TEST_F(KnownBitsSolverTest, ComputeValue) {
+  std::vector<ref<Expr> > cs;
+  cs.push_back(EqExpr::create(c(0x2a, Expr::Int8), x));
+  ConstraintManager constraints(cs);
+
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(
+      Query(constraints, ZExtExpr::create(AddExpr::create(c(1, Expr::Int8), x),
+                                          Expr::Int32)), value));
+  EXPECT_EQ(0x2bu, value->getZExtValue());
+
+  // contradicting constraints are left to the core solver
+  cs.push_back(EqExpr::create(c(0x2b, Expr::Int8), x));
+  ConstraintManager contradiction(cs);
+  Solver::Validity validity;
+  EXPECT_FALSE(solver->evaluate(
+      Query(contradiction, EqExpr::create(c(0, Expr::Int8), x)), validity));
+}
+
+}
@@ -0,0 +1,217 @@
+//===-- SharedSolverCacheTest.cpp -----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SharedSolverCache.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/util/ArrayCache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+/// answers every query with the same byte for every object
+class FixedSolverImpl : public SolverImpl {
+  unsigned char value;
+
+public:
+  unsigned calls;
+
+  FixedSolverImpl(unsigned char _value) : value(_value), calls(0) {}
+
+  bool computeTruth(const Query &, bool &) { return false; }
+  bool computeValue(const Query &, ref<Expr> &) { return false; }
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    calls++;
+    values.clear();
+    for (unsigned i = 0; i < objects.size(); i++)
+      values.push_back(std::vector<unsigned char>(objects[i]->size, value));
+    hasSolution = true;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() { return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE; }
+};
+
+/// x[0] == byte, over an array named x in the given cache
+Query makeQuery(ArrayCache &ac, ConstraintManager &constraints,
+                std::vector<const Array *> &objects, uint8_t byte) {
+  const Array *array = ac.CreateArray("x", 1);
+  objects.push_back(array);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int8);
+  constraints.addConstraint(EqExpr::create(read, ConstantExpr::create(byte, Expr::Int8)));
+  return Query(constraints, ConstantExpr::alloc(0, Expr::Bool));
+}
+
+TEST(SharedSolverCacheTest, RemoteEntries) {
+  SharedSolverCache producerCache(16), consumerCache(16);
+  FixedSolverImpl *impl = new FixedSolverImpl(5);
+  Solver *producer = createSharedCacheSolver(new Solver(impl), producerCache);
+  Solver *consumer = createSharedCacheSolver(createDummySolver(), consumerCache);
+
+  /* the processes own different arrays with the same name */
+  ArrayCache producerArrays, consumerArrays;
+  ConstraintManager producerConstraints, consumerConstraints;
+  std::vector<const Array *> producerObjects, consumerObjects;
+  std::vector<std::vector<unsigned char> > values;
+
+  Query query = makeQuery(producerArrays, producerConstraints, producerObjects, 5);
+  ASSERT_TRUE(producer->getInitialValues(query, producerObjects, values));
+  ASSERT_TRUE(producer->getInitialValues(query, producerObjects, values));
+  EXPECT_EQ(1u, impl->calls);
+
+  std::vector<char> packet;
+  ASSERT_TRUE(producerCache.takeOutgoing(packet));
+  EXPECT_FALSE(producerCache.takeOutgoing(packet));
+
+  EXPECT_FALSE(consumerCache.addPacket(&packet[0], packet.size() - 1));
+  EXPECT_EQ(0u, consumerCache.size());
+  ASSERT_TRUE(consumerCache.addPacket(&packet[0], packet.size()));
+  EXPECT_EQ(1u, consumerCache.size());
+
+  /* remote entries are not published again */
+  std::vector<char> empty;
+  EXPECT_FALSE(consumerCache.takeOutgoing(empty));
+
+  values.clear();
+  Query remote = makeQuery(consumerArrays, consumerConstraints, consumerObjects, 5);
+  ASSERT_TRUE(consumer->getInitialValues(remote, consumerObjects, values));
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ(5, values[0][0]);
+
+  delete producer;
+  delete consumer;
+}
+
+TEST(SharedSolverCacheTest, OtherQueries) {
+  SharedSolverCache producerCache(16), consumerCache(16);
+  Solver *producer = createSharedCacheSolver(new Solver(new FixedSolverImpl(5)), producerCache);
+  Solver *consumer = createSharedCacheSolver(createDummySolver(), consumerCache);
+
+  ArrayCache producerArrays, consumerArrays;
+  ConstraintManager producerConstraints, consumerConstraints;
+  std::vector<const Array *> producerObjects, consumerObjects;
+  std::vector<std::vector<unsigned char> > values;
+
+  Query query = makeQuery(producerArrays, producerConstraints, producerObjects, 5);
+  ASSERT_TRUE(producer->getInitialValues(query, producerObjects, values));
+  std::vector<char> packet;
+  ASSERT_TRUE(producerCache.takeOutgoing(packet));
+  ASSERT_TRUE(consumerCache.addPacket(&packet[0], packet.size()));
+
+  /* a different query misses and reaches the (failing) solver */
+  Query other = makeQuery(consumerArrays, consumerConstraints, consumerObjects, 6);
+  EXPECT_FALSE(consumer->getInitialValues(other, consumerObjects, values));
+
+  delete producer;
+  delete consumer;
+}
+
+TEST(SharedSolverCacheTest, Seeds) {
+  SharedSolverCache::Seed seed;
+  seed["x"] = std::vector<unsigned char>(1, 5);
+  std::vector<SharedSolverCache::Seed> seeds(1, seed);
+
+  /* the seeds come in front of the prefix packet */
+  std::vector<char> packet;
+  SharedSolverCache::encodeSeeds(seeds, packet);
+  size_t length = packet.size();
+  packet.push_back('P');
+
+  std::vector<SharedSolverCache::Seed> received;
+  EXPECT_EQ(0u, SharedSolverCache::decodeSeeds(&packet[1], packet.size() - 1, received));
+  EXPECT_EQ(0u, SharedSolverCache::decodeSeeds(&packet[0], length - 1, received));
+  ASSERT_EQ(length, SharedSolverCache::decodeSeeds(&packet[0], packet.size(), received));
+  ASSERT_EQ(1u, received.size());
+  EXPECT_EQ(seed, received[0]);
+
+  SharedSolverCache cache(16, false);
+  cache.addSeed(received[0]);
+  Solver *solver = createSharedCacheSolver(createDummySolver(), cache);
+
+  ArrayCache arrays;
+  ConstraintManager satisfied, violated;
+  std::vector<const Array *> objects, otherObjects;
+  std::vector<std::vector<unsigned char> > values;
+  Query query = makeQuery(arrays, satisfied, objects, 5);
+  ASSERT_TRUE(solver->getInitialValues(query, objects, values));
+  EXPECT_EQ(5, values[0][0]);
+  Query other = makeQuery(arrays, violated, otherObjects, 6);
+  EXPECT_FALSE(solver->getInitialValues(other, otherObjects, values));
+
+  /* nothing is published */
+  std::vector<char> outgoing;
+  EXPECT_FALSE(cache.takeOutgoing(outgoing));
+
+  delete solver;
+}
+
+TEST(SharedSolverCacheTest, PersistentFile) {
+  char path[] = "/tmp/SharedSolverCacheTest.XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  SharedSolverCache producerCache(16);
+  Solver *producer = createSharedCacheSolver(new Solver(new FixedSolverImpl(5)), producerCache);
+  ArrayCache arrays;
+  ConstraintManager constraints, otherConstraints;
+  std::vector<const Array *> objects, otherObjects;
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(producer->getInitialValues(makeQuery(arrays, constraints, objects, 5),
+                                         objects, values));
+  std::vector<char> packet;
+  ASSERT_TRUE(producerCache.takeOutgoing(packet));
+  ASSERT_TRUE(SharedSolverCache::appendToFile(path, 42, packet));
+  ASSERT_TRUE(producer->getInitialValues(makeQuery(arrays, otherConstraints, otherObjects, 6),
+                                         otherObjects, values));
+  packet.clear();
+  ASSERT_TRUE(producerCache.takeOutgoing(packet));
+  ASSERT_TRUE(SharedSolverCache::appendToFile(path, 42, packet));
+
+  /* the file only holds for the program it was written for */
+  SharedSolverCache other(16);
+  EXPECT_FALSE(other.loadFile(path, 43));
+  EXPECT_EQ(0u, other.size());
+
+  SharedSolverCache cache(16);
+  ASSERT_TRUE(cache.loadFile(path, 42));
+  EXPECT_EQ(2u, cache.size());
+  std::vector<char> outgoing;
+  EXPECT_FALSE(cache.takeOutgoing(outgoing));
+
+  /* a record cut short ends the file */
+  struct stat st;
+  ASSERT_EQ(0, stat(path, &st));
+  ASSERT_EQ(0, truncate(path, st.st_size - 1));
+  SharedSolverCache truncated(16);
+  ASSERT_TRUE(truncated.loadFile(path, 42));
+  EXPECT_EQ(1u, truncated.size());
+
+  /* another program starts the file anew */
+  ASSERT_TRUE(SharedSolverCache::appendToFile(path, 43, packet));
+  SharedSolverCache restarted(16);
+  EXPECT_FALSE(restarted.loadFile(path, 42));
+  ASSERT_TRUE(restarted.loadFile(path, 43));
+  EXPECT_EQ(1u, restarted.size());
+
+  unlink(path);
+  delete producer;
+}
+
+}
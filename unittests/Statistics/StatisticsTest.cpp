@@ -0,0 +1,41 @@
+#include "klee/Statistic.h"
+#include "klee/Statistics.h"
+
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+Statistic counted("TestCounted", "Tc");
+
+TEST(StatisticsTest, ThreadsAddUp) {
+  uint64_t before = counted.getValue();
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < 4; i++)
+    threads.push_back(std::thread([] {
+      for (unsigned j = 0; j < 100000; j++)
+        counted += 1;
+    }));
+  for (unsigned i = 0; i < threads.size(); i++)
+    threads[i].join();
+  EXPECT_EQ(before + 400000u, counted.getValue());
+
+  // a later thread takes over a freed slot and its values
+  std::thread([] { counted += 5; }).join();
+  EXPECT_EQ(before + 400005u, counted.getValue());
+}
+
+TEST(StatisticsTest, IndexedOnlyForItsThread) {
+  theStatisticManager->useIndexedStats(2);
+  theStatisticManager->setIndex(1);
+  counted += 3;
+  std::thread([] { counted += 7; }).join();
+  EXPECT_EQ(3u, theStatisticManager->getIndexedValue(counted, 1));
+  EXPECT_EQ(0u, theStatisticManager->getIndexedValue(counted, 0));
+}
+
+}
@@ -0,0 +1,54 @@
+#include "klee/Internal/Support/SubtreeEstimator.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(SubtreeEstimatorTest, Unmeasured) {
+  SubtreeEstimator estimator;
+  EXPECT_DOUBLE_EQ(0, estimator.getRate(3));
+  EXPECT_DOUBLE_EQ(1, estimator.estimate(0));
+}
+
+TEST(SubtreeEstimatorTest, CompleteTree) {
+  // a complete binary tree with leaves at depth 3
+  SubtreeEstimator estimator;
+  for (unsigned depth = 0; depth < 3; ++depth)
+    for (unsigned i = 0; i < (1u << depth); ++i)
+      estimator.recordFork(depth);
+  for (unsigned i = 0; i < 8; ++i)
+    estimator.recordLeaf(3);
+
+  EXPECT_DOUBLE_EQ(2, estimator.getRate(0));
+  EXPECT_DOUBLE_EQ(0, estimator.getRate(3));
+  EXPECT_DOUBLE_EQ(15, estimator.estimate(0));
+  EXPECT_DOUBLE_EQ(7, estimator.estimate(1));
+  EXPECT_DOUBLE_EQ(1, estimator.estimate(3));
+}
+
+TEST(SubtreeEstimatorTest, MeasuredRates) {
+  SubtreeEstimator estimator;
+  estimator.recordFork(0);
+  // one child forks, the other ends
+  estimator.recordFork(1);
+  estimator.recordLeaf(1);
+  EXPECT_DOUBLE_EQ(1, estimator.getRate(1));
+  EXPECT_DOUBLE_EQ(2, estimator.estimate(1));
+  EXPECT_DOUBLE_EQ(5, estimator.estimate(0));
+
+  // new measurements are taken into account
+  estimator.recordFork(2);
+  estimator.recordFork(2);
+  EXPECT_DOUBLE_EQ(4, estimator.estimate(1));
+  EXPECT_DOUBLE_EQ(9, estimator.estimate(0));
+}
+
+TEST(SubtreeEstimatorTest, Capped) {
+  SubtreeEstimator estimator;
+  for (unsigned depth = 0; depth < 2000; ++depth)
+    estimator.recordFork(depth);
+  EXPECT_DOUBLE_EQ(SubtreeEstimator::MaxEstimate, estimator.estimate(0));
+}
+
+}
@@ -0,0 +1,81 @@
+#include "klee/Internal/Support/TaskCheckpoint.h"
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+std::string tempPath() {
+  char path[] = "/tmp/TaskCheckpointTest.XXXXXX";
+  int fd = mkstemp(path);
+  EXPECT_GE(fd, 0);
+  close(fd);
+  return path;
+}
+
+TEST(TaskCheckpointTest, RoundTrip) {
+  std::string path = tempPath();
+  TaskCheckpoint checkpoint(4);
+  checkpoint.start(1, 0, "0101");
+  /* state packets hold any bytes */
+  checkpoint.start(2, 12, std::string("a\n\0b", 4));
+  checkpoint.start(3, 0, "11");
+  checkpoint.finish(3);
+  /* a thief takes over the task of its victim */
+  checkpoint.steal(3, 1);
+  EXPECT_EQ(3u, checkpoint.getNumRunning());
+
+  std::vector<TaskCheckpoint::Task> queued;
+  queued.push_back(TaskCheckpoint::Task(0, "000"));
+  queued.push_back(TaskCheckpoint::Task(0, ""));
+  std::string error;
+  ASSERT_TRUE(checkpoint.write(path, queued, error)) << error;
+
+  std::vector<TaskCheckpoint::Task> tasks;
+  ASSERT_TRUE(TaskCheckpoint::read(path, tasks, error)) << error;
+  ASSERT_EQ(5u, tasks.size());
+  EXPECT_EQ("000", tasks[0].data);
+  EXPECT_EQ("", tasks[1].data);
+  EXPECT_EQ("0101", tasks[2].data);
+  EXPECT_EQ(12, tasks[3].tag);
+  EXPECT_EQ(std::string("a\n\0b", 4), tasks[3].data);
+  EXPECT_EQ(0, tasks[4].tag);
+  EXPECT_EQ("0101", tasks[4].data);
+  unlink(path.c_str());
+}
+
+TEST(TaskCheckpointTest, Truncated) {
+  std::string path = tempPath();
+  TaskCheckpoint checkpoint(2);
+  checkpoint.start(1, 0, "0101");
+  std::string error;
+  ASSERT_TRUE(checkpoint.write(path, std::vector<TaskCheckpoint::Task>(),
+                               error)) << error;
+
+  std::string contents;
+  {
+    std::ifstream is(path.c_str());
+    std::getline(is, contents, '\0');
+  }
+  {
+    std::ofstream os(path.c_str(), std::ios::trunc);
+    os << contents.substr(0, contents.size() - 3);
+  }
+  std::vector<TaskCheckpoint::Task> tasks;
+  EXPECT_FALSE(TaskCheckpoint::read(path, tasks, error));
+
+  {
+    std::ofstream os(path.c_str(), std::ios::trunc);
+    os << "not a checkpoint";
+  }
+  EXPECT_FALSE(TaskCheckpoint::read(path, tasks, error));
+  unlink(path.c_str());
+}
+
+}
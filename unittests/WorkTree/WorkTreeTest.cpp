@@ -0,0 +1,48 @@
+#include "klee/Internal/ADT/RNG.h"
+#include "klee/Internal/Support/WorkTree.h"
+#include "gtest/gtest.h"
+
+#include <set>
+
+using namespace klee;
+
+namespace {
+
+TEST(WorkTreeTest, TakesEveryPrefix) {
+  RNG rng;
+  WorkTree tree;
+  tree.add("0-1", 0);
+  tree.add("01", 1);
+  tree.add("3", 2);
+  tree.add("", 3);
+  EXPECT_EQ(4u, tree.size());
+
+  std::set<unsigned> taken;
+  while (!tree.empty())
+    taken.insert(tree.takeRandomPath(rng));
+  EXPECT_EQ(4u, taken.size());
+  EXPECT_EQ(3u, *taken.rbegin());
+}
+
+TEST(WorkTreeTest, UniformByPath) {
+  // one prefix on the left, seven in a subtree on the right
+  unsigned left = 0;
+  RNG rng;
+  for (unsigned run = 0; run < 2000; run++) {
+    WorkTree tree;
+    tree.add("0", 0);
+    for (unsigned i = 0; i < 7; i++) {
+      std::string path = "1";
+      for (unsigned bit = 4; bit; bit >>= 1)
+        path += (i & bit) ? '1' : '0';
+      tree.add(path, i + 1);
+    }
+    if (tree.takeRandomPath(rng) == 0)
+      ++left;
+  }
+  // half of the picks go left, not an eighth
+  EXPECT_LT(900u, left);
+  EXPECT_GT(1100u, left);
+}
+
+}
@@ -0,0 +1,248 @@
+#include "klee/Internal/Support/WorkerTracker.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(WorkerTrackerTest, IdleQueueIsFifo) {
+  WorkerTracker tracker(1, 5);
+  EXPECT_EQ(4u, tracker.getNumWorkers());
+  EXPECT_TRUE(tracker.allIdle());
+
+  unsigned rank;
+  ASSERT_TRUE(tracker.popIdle(rank));
+  EXPECT_EQ(1u, rank);
+  tracker.markBusy(2);
+  ASSERT_TRUE(tracker.popIdle(rank));
+  EXPECT_EQ(3u, rank);
+  EXPECT_EQ(1u, tracker.getNumIdle());
+
+  tracker.markIdle(1);
+  ASSERT_TRUE(tracker.popIdle(rank));
+  EXPECT_EQ(4u, rank);
+  ASSERT_TRUE(tracker.popIdle(rank));
+  EXPECT_EQ(1u, rank);
+  EXPECT_FALSE(tracker.popIdle(rank));
+}
+
+TEST(WorkerTrackerTest, FinishIsIdempotent) {
+  WorkerTracker tracker(1, 3);
+  tracker.markBusy(1);
+  tracker.markBusy(2);
+  tracker.markIdle(2);
+  tracker.markIdle(2);
+  EXPECT_EQ(1u, tracker.getNumIdle());
+  tracker.markIdle(1);
+  EXPECT_TRUE(tracker.allIdle());
+}
+
+TEST(WorkerTrackerTest, DonorsInReadyOrder) {
+  WorkerTracker tracker(1, 5);
+  for (unsigned rank = 1; rank < 5; ++rank)
+    tracker.markBusy(rank);
+  tracker.markReady(3);
+  tracker.markReady(1);
+  tracker.markReady(3);
+
+  unsigned donor;
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(3u, donor);
+  EXPECT_TRUE(tracker.isOffloadActive(3));
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(1u, donor);
+  // no request is sent twice to the same worker
+  EXPECT_FALSE(tracker.pickDonor(donor));
+
+  tracker.offloadDone(3);
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(3u, donor);
+}
+
+TEST(WorkerTrackerTest, DonorsWithMostWork) {
+  WorkerTracker tracker(1, 5);
+  for (unsigned rank = 1; rank < 5; ++rank) {
+    tracker.markBusy(rank);
+    tracker.markReady(rank);
+  }
+  tracker.setWorkEstimate(2, 10);
+  tracker.setWorkEstimate(4, 30);
+  tracker.setWorkEstimate(3, 30);
+
+  unsigned donor;
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(3u, donor);
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(4u, donor);
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(2u, donor);
+
+  // a finished worker has nothing left
+  tracker.markIdle(1);
+  EXPECT_EQ(0u, tracker.getWorkEstimate(1));
+}
+
+TEST(WorkerTrackerTest, DonorsNearestTheTarget) {
+  WorkerTracker tracker(1, 5);
+  for (unsigned rank = 1; rank < 5; ++rank) {
+    tracker.markBusy(rank);
+    tracker.markReady(rank);
+  }
+  tracker.setWorkEstimate(1, 50);
+  tracker.setWorkEstimate(2, 10);
+  tracker.setWorkEstimate(3, 20);
+  tracker.setWorkEstimate(4, 5);
+  tracker.setTargetDistance(2, 40);
+  tracker.setTargetDistance(3, 40);
+  tracker.setTargetDistance(4, 7);
+
+  // the nearest first, the richest among equals, no target in reach last
+  unsigned donor;
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(4u, donor);
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(3u, donor);
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(2u, donor);
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(1u, donor);
+}
+
+TEST(WorkerTrackerTest, WithdrawnDonors) {
+  WorkerTracker tracker(1, 4);
+  for (unsigned rank = 1; rank < 4; ++rank)
+    tracker.markBusy(rank);
+  tracker.markReady(1);
+  tracker.markReady(2);
+  tracker.markNotReady(1);
+
+  unsigned donor;
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(2u, donor);
+  // a donor that finishes before answering
+  EXPECT_TRUE(tracker.markIdle(2));
+  EXPECT_FALSE(tracker.isOffloadActive(2));
+  tracker.offloadDone(2);
+  EXPECT_FALSE(tracker.hasDonor());
+
+  tracker.markReady(3);
+  tracker.markIdle(3);
+  EXPECT_FALSE(tracker.hasDonor());
+}
+
+TEST(WorkerTrackerTest, LostWorkers) {
+  WorkerTracker tracker(1, 5);
+  tracker.markLost(4);
+  EXPECT_EQ(3u, tracker.getNumWorkers());
+  EXPECT_TRUE(tracker.allIdle());
+
+  for (unsigned rank = 1; rank < 4; ++rank)
+    tracker.markBusy(rank);
+  tracker.markReady(1);
+  tracker.markReady(2);
+  unsigned donor;
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(1u, donor);
+  // the request dies with the donor
+  EXPECT_TRUE(tracker.markLost(1));
+  EXPECT_FALSE(tracker.markLost(1));
+  // and so does the announcement of a ready worker
+  tracker.markLost(2);
+  EXPECT_FALSE(tracker.hasDonor());
+  tracker.markReady(2);
+  EXPECT_FALSE(tracker.hasDonor());
+
+  // late messages of lost workers change nothing
+  tracker.markIdle(2);
+  EXPECT_EQ(0u, tracker.getNumIdle());
+  tracker.markIdle(3);
+  EXPECT_TRUE(tracker.allIdle());
+  unsigned rank;
+  ASSERT_TRUE(tracker.popIdle(rank));
+  EXPECT_EQ(3u, rank);
+  EXPECT_FALSE(tracker.popIdle(rank));
+}
+
+TEST(WorkerTrackerTest, StandbyWorkers) {
+  WorkerTracker tracker(1, 4);
+  tracker.markLost(3);
+  tracker.markBusy(1);
+  tracker.markBusy(2);
+  EXPECT_EQ(2u, tracker.getNumWorkers());
+  unsigned rank;
+  EXPECT_FALSE(tracker.popIdle(rank));
+
+  tracker.markJoined(3);
+  tracker.markJoined(3);
+  EXPECT_EQ(3u, tracker.getNumWorkers());
+  EXPECT_FALSE(tracker.allIdle());
+  ASSERT_TRUE(tracker.popIdle(rank));
+  EXPECT_EQ(3u, rank);
+  // a worker which was never lost is not joined twice
+  tracker.markIdle(1);
+  tracker.markJoined(1);
+  EXPECT_EQ(1u, tracker.getNumIdle());
+}
+
+TEST(WorkerTrackerTest, NearestIdleWorker) {
+  WorkerTracker tracker(1, 5);
+  tracker.markBusy(1);
+  tracker.addPrefix(1, "0110", 4);
+  tracker.markBusy(2);
+  tracker.addPrefix(2, "0-3121", 6);
+  tracker.markIdle(2);
+  tracker.markIdle(1);
+
+  unsigned rank;
+  // shares all of it with rank 2 (unforked branches count as forked ones)
+  ASSERT_TRUE(tracker.popIdleNearest("01101", 5, rank));
+  EXPECT_EQ(2u, rank);
+  ASSERT_TRUE(tracker.popIdleNearest("0111", 4, rank));
+  EXPECT_EQ(1u, rank);
+  // nothing in common, the idle worker waiting the longest
+  ASSERT_TRUE(tracker.popIdleNearest("1", 1, rank));
+  EXPECT_EQ(3u, rank);
+
+  tracker.markIdle(1);
+  tracker.markLost(1);
+  ASSERT_TRUE(tracker.popIdleNearest("0110", 4, rank));
+  EXPECT_EQ(4u, rank);
+  EXPECT_FALSE(tracker.popIdleNearest("0110", 4, rank));
+}
+
+TEST(WorkerTrackerTest, DonorsOnTheNodeFirst) {
+  // ranks 1-2 on node 1, ranks 3-4 on node 3
+  WorkerTracker tracker(1, 5);
+  for (unsigned rank = 1; rank < 5; ++rank)
+    tracker.setNode(rank, rank < 3 ? 1 : 3);
+  tracker.setMinLocalWork(10);
+  tracker.markBusy(1);
+  tracker.markBusy(3);
+  tracker.markBusy(4);
+  tracker.markReady(1);
+  tracker.markReady(3);
+  tracker.setWorkEstimate(1, 100);
+  tracker.setWorkEstimate(3, 20);
+
+  // rank 2 idles on node 1
+  unsigned donor, rank;
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(1u, donor);
+  tracker.offloadDone(1);
+
+  // below the threshold the local donor loses to the remote one
+  tracker.setWorkEstimate(1, 5);
+  ASSERT_TRUE(tracker.pickDonor(donor));
+  EXPECT_EQ(3u, donor);
+  ASSERT_TRUE(tracker.popIdleNear(donor, rank));
+  EXPECT_EQ(2u, rank);
+
+  tracker.markIdle(4);
+  tracker.markIdle(1);
+  ASSERT_TRUE(tracker.popIdleNear(3, rank));
+  EXPECT_EQ(4u, rank);
+  ASSERT_TRUE(tracker.popIdleNear(3, rank));
+  EXPECT_EQ(1u, rank);
+}
+
+}
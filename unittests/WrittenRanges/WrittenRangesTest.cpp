@@ -0,0 +1,71 @@
+#include "klee/Internal/Support/WrittenRanges.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(WrittenRangesTest, MergesBytewiseWrites) {
+  WrittenRanges written;
+  unsigned epoch;
+  EXPECT_FALSE(written.covers(0x1000, 1, epoch));
+
+  for (uint64_t i = 0; i < 4096; i++)
+    written.add(0x1000 + i, 1, 2);
+  EXPECT_EQ(1u, written.size());
+  EXPECT_TRUE(written.covers(0x1000, 4096, epoch));
+  EXPECT_EQ(2u, epoch);
+  EXPECT_TRUE(written.covers(0x1800, 8, epoch));
+  EXPECT_FALSE(written.covers(0x0fff, 2, epoch));
+  EXPECT_FALSE(written.covers(0x1ffc, 8, epoch));
+
+  // written backwards and overlapping
+  written.add(0x3008, 8, 2);
+  written.add(0x3004, 8, 2);
+  written.add(0x3000, 4, 2);
+  EXPECT_EQ(2u, written.size());
+  EXPECT_TRUE(written.covers(0x3000, 16, epoch));
+}
+
+TEST(WrittenRangesTest, Epochs) {
+  WrittenRanges written;
+  unsigned epoch;
+  written.add(0x100, 16, 1);
+  // a later epoch splits the range
+  written.add(0x104, 4, 3);
+  EXPECT_EQ(3u, written.size());
+  EXPECT_TRUE(written.covers(0x104, 4, epoch));
+  EXPECT_EQ(3u, epoch);
+  EXPECT_TRUE(written.covers(0x102, 4, epoch));
+  EXPECT_EQ(1u, epoch);
+  EXPECT_TRUE(written.covers(0x100, 16, epoch));
+  EXPECT_EQ(1u, epoch);
+
+  // adjacent ranges of different epochs still cover a load together
+  written.add(0x110, 4, 3);
+  EXPECT_EQ(4u, written.size());
+  EXPECT_TRUE(written.covers(0x10c, 8, epoch));
+  EXPECT_EQ(1u, epoch);
+
+  // and a write over all of them leaves one range
+  written.add(0x100, 20, 4);
+  EXPECT_EQ(1u, written.size());
+  EXPECT_TRUE(written.covers(0x100, 20, epoch));
+  EXPECT_EQ(4u, epoch);
+  EXPECT_FALSE(written.covers(0x100, 21, epoch));
+}
+
+TEST(WrittenRangesTest, Gaps) {
+  WrittenRanges written;
+  unsigned epoch;
+  written.add(0x10, 4, 0);
+  written.add(0x18, 4, 0);
+  EXPECT_EQ(2u, written.size());
+  EXPECT_FALSE(written.covers(0x10, 12, epoch));
+  EXPECT_FALSE(written.covers(0x14, 4, epoch));
+  written.add(0x14, 4, 0);
+  EXPECT_EQ(1u, written.size());
+  EXPECT_TRUE(written.covers(0x10, 12, epoch));
+}
+
+}